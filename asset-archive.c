@@ -0,0 +1,272 @@
+#include "asset-archive.h"
+#include "lz4-block.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static inline uint64_t alignUp(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * Whether `size` bytes at `offset` fit in a file of `fileSize` bytes, at
+ * an offset aligned for their type.
+ */
+static bool rangeInFile(uint64_t fileSize, uint64_t offset, uint64_t size, uint64_t alignment) {
+	return offset % alignment == 0 && offset <= fileSize && size <= fileSize - offset;
+}
+
+// Reading
+
+struct AssetArchive * assetArchiveOpen(char const * path) {
+	struct MappedFile * file = mappedFileOpen(path);
+	if (!file) return NULL;
+	struct AssetArchive * archive = (struct AssetArchive *)calloc(1, sizeof(struct AssetArchive));
+	archive->file = file;
+	uint8_t const * bytes = (uint8_t const *)file->data;
+
+	char const * error = NULL;
+	struct AssetArchiveHeader const * header = (struct AssetArchiveHeader const *)bytes;
+	if (file->size < sizeof(struct AssetArchiveHeader) || memcmp(header->magic, ASSET_ARCHIVE_MAGIC, 4) != 0) {
+		error = "not an asset archive";
+	} else if (header->version != ASSET_ARCHIVE_VERSION) {
+		error = "unsupported version";
+	} else if (header->bucketCount == 0 || (header->bucketCount & (header->bucketCount - 1)) != 0 || header->bucketCount <= header->entryCount
+		|| !rangeInFile(file->size, header->entriesOffset, (uint64_t)header->entryCount * sizeof(struct AssetArchiveEntry), sizeof(uint64_t))
+		|| !rangeInFile(file->size, header->bucketsOffset, (uint64_t)header->bucketCount * sizeof(uint32_t), sizeof(uint32_t))
+		|| !rangeInFile(file->size, header->namesOffset, header->namesSize, 1)
+		|| (header->namesSize > 0 && bytes[header->namesOffset + header->namesSize - 1] != '\0')) {
+		error = "invalid tables";
+	} else {
+		struct AssetArchiveEntry const * entries = (struct AssetArchiveEntry const *)(bytes + header->entriesOffset);
+		for (uint32_t i = 0; i < header->entryCount && !error; ++i) {
+			struct AssetArchiveEntry const * entry = &entries[i];
+			if (entry->nameOffset >= header->namesSize || entry->compression >= AssetCompression_Count
+				|| (entry->compression == AssetCompression_None && entry->size != entry->uncompressedSize)
+				// LZ4 blocks expand at most 255 times, one byte of length per 255 bytes
+				|| (entry->compression == AssetCompression_LZ4 && entry->uncompressedSize / 255 > entry->size)
+				|| !rangeInFile(file->size, entry->offset, entry->size, ASSET_ARCHIVE_ALIGNMENT)) {
+				error = "invalid entries";
+			}
+		}
+		// Lookups stop at the first empty bucket, so there must be one
+		uint32_t const * buckets = (uint32_t const *)(bytes + header->bucketsOffset);
+		uint32_t usedBuckets = 0;
+		for (uint32_t i = 0; i < header->bucketCount && !error; ++i) {
+			if (buckets[i] > header->entryCount) error = "invalid hash table";
+			usedBuckets += buckets[i] != 0;
+		}
+		if (!error && usedBuckets != header->entryCount) error = "invalid hash table";
+	}
+
+	if (error) {
+		fprintf(stderr, "Could not load asset archive %s: %s\n", path, error);
+		assetArchiveClose(archive);
+		return NULL;
+	}
+	archive->header = header;
+	archive->entries = (struct AssetArchiveEntry const *)(bytes + header->entriesOffset);
+	archive->buckets = (uint32_t const *)(bytes + header->bucketsOffset);
+	archive->names = (char const *)(bytes + header->namesOffset);
+	return archive;
+}
+
+void assetArchiveClose(struct AssetArchive * archive) {
+	if (!archive) return;
+	mappedFileClose(archive->file);
+	free(archive);
+}
+
+struct AssetArchiveEntry const * assetArchiveFind(struct AssetArchive const * archive, char const * name) {
+	uint64_t hash = mappedFileHash(name, strlen(name));
+	uint32_t mask = archive->header->bucketCount - 1;
+	for (uint32_t bucket = (uint32_t)hash & mask;; bucket = (bucket + 1) & mask) {
+		uint32_t index = archive->buckets[bucket];
+		if (index == 0) return NULL;
+		struct AssetArchiveEntry const * entry = &archive->entries[index - 1];
+		if (entry->nameHash == hash && strcmp(archive->names + entry->nameOffset, name) == 0) return entry;
+	}
+}
+
+char const * assetArchiveEntryName(struct AssetArchive const * archive, struct AssetArchiveEntry const * entry) {
+	return archive->names + entry->nameOffset;
+}
+
+void const * assetArchiveData(struct AssetArchive const * archive, struct AssetArchiveEntry const * entry) {
+	if (entry->compression != AssetCompression_None) return NULL;
+	return (uint8_t const *)archive->file->data + entry->offset;
+}
+
+bool assetArchiveRead(struct AssetArchive const * archive, struct AssetArchiveEntry const * entry, void * destination) {
+	uint8_t const * blob = (uint8_t const *)archive->file->data + entry->offset;
+	if (entry->compression == AssetCompression_None) {
+		memcpy(destination, blob, (size_t)entry->size);
+		return true;
+	}
+	return lz4BlockDecompress(blob, (size_t)entry->size, destination, (size_t)entry->uncompressedSize);
+}
+
+bool assetArchiveLoad(struct AssetArchive const * archive, char const * name, struct AssetBlob * blob) {
+	memset(blob, 0, sizeof(struct AssetBlob));
+	struct AssetArchiveEntry const * entry = assetArchiveFind(archive, name);
+	if (!entry) {
+		fprintf(stderr, "Could not find asset %s\n", name);
+		return false;
+	}
+	if (entry->compression == AssetCompression_None) {
+		blob->data = assetArchiveData(archive, entry);
+		blob->size = (size_t)entry->size;
+		return true;
+	}
+	void * allocation = malloc(entry->uncompressedSize > 0 ? (size_t)entry->uncompressedSize : 1);
+	if (!allocation || !assetArchiveRead(archive, entry, allocation)) {
+		fprintf(stderr, "Could not decompress asset %s\n", name);
+		free(allocation);
+		return false;
+	}
+	blob->data = allocation;
+	blob->size = (size_t)entry->uncompressedSize;
+	blob->allocation = allocation;
+	return true;
+}
+
+void assetBlobRelease(struct AssetBlob * blob) {
+	free(blob->allocation);
+	memset(blob, 0, sizeof(struct AssetBlob));
+}
+
+// Packing
+
+static bool writePadding(FILE * file, uint64_t size) {
+	static const uint8_t zeros[ASSET_ARCHIVE_ALIGNMENT] = { 0 };
+	while (size > 0) {
+		size_t chunk = size < sizeof(zeros) ? (size_t)size : sizeof(zeros);
+		if (fwrite(zeros, 1, chunk, file) != chunk) return false;
+		size -= chunk;
+	}
+	return true;
+}
+
+/**
+ * Write the blob of `input` at `entry->offset`, where `file` is, and fill
+ * the rest of `entry`. `packed` is a buffer of `packedCapacity` bytes
+ * reused across inputs for their compressed blobs.
+ */
+static bool writeBlob(FILE * file, struct AssetArchiveInput const * input, struct AssetArchiveEntry * entry, uint8_t ** packed, size_t * packedCapacity) {
+	struct MappedFile * source = mappedFileOpen(input->path);
+	if (!source) return false;
+	void const * blob = source->data;
+	size_t size = source->size;
+	entry->uncompressedSize = source->size;
+	entry->contentHash = mappedFileHash(source->data, source->size);
+	entry->compression = AssetCompression_None;
+
+	if (input->compression == AssetCompression_LZ4 && source->size > 0) {
+		if (*packedCapacity < source->size) {
+			free(*packed);
+			*packed = (uint8_t *)malloc(source->size);
+			*packedCapacity = *packed ? source->size : 0;
+		}
+		// Compression gives up as soon as the block would not save enough
+		size_t packedSize = *packed ? lz4BlockCompress(source->data, source->size, *packed, source->size - source->size / ASSET_ARCHIVE_MIN_SAVING) : 0;
+		if (packedSize > 0) {
+			blob = *packed;
+			size = packedSize;
+			entry->compression = AssetCompression_LZ4;
+		}
+	}
+	entry->size = size;
+	// Empty files are not mapped, so their data is NULL
+	bool ok = (size == 0 || fwrite(blob, 1, size, file) == size)
+		&& writePadding(file, alignUp(size, ASSET_ARCHIVE_ALIGNMENT) - size);
+	mappedFileClose(source);
+	return ok;
+}
+
+bool assetArchiveWrite(char const * path, struct AssetArchiveInput const * inputs, uint32_t inputCount) {
+	struct AssetArchiveHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, ASSET_ARCHIVE_MAGIC, 4);
+	header.version = ASSET_ARCHIVE_VERSION;
+	header.entryCount = inputCount;
+	// At most half full, for short probe sequences
+	header.bucketCount = 1;
+	while (header.bucketCount < 2 * (uint64_t)inputCount) header.bucketCount *= 2;
+	for (uint32_t i = 0; i < inputCount; ++i) header.namesSize += strlen(inputs[i].name) + 1;
+	header.entriesOffset = alignUp(sizeof(header), sizeof(uint64_t));
+	header.bucketsOffset = header.entriesOffset + (uint64_t)inputCount * sizeof(struct AssetArchiveEntry);
+	header.namesOffset = header.bucketsOffset + (uint64_t)header.bucketCount * sizeof(uint32_t);
+	header.dataOffset = alignUp(header.namesOffset + header.namesSize, ASSET_ARCHIVE_ALIGNMENT);
+	if (header.namesSize > UINT32_MAX) {
+		fprintf(stderr, "Could not pack %s: names are too long\n", path);
+		return false;
+	}
+
+	struct AssetArchiveEntry * entries = (struct AssetArchiveEntry *)calloc(inputCount > 0 ? inputCount : 1, sizeof(struct AssetArchiveEntry));
+	uint32_t * buckets = (uint32_t *)calloc(header.bucketCount, sizeof(uint32_t));
+	char * names = (char *)malloc(header.namesSize > 0 ? (size_t)header.namesSize : 1);
+	uint8_t * packed = NULL;
+	size_t packedCapacity = 0;
+	bool ok = true;
+	uint32_t nameOffset = 0;
+	uint32_t mask = header.bucketCount - 1;
+	for (uint32_t i = 0; i < inputCount && ok; ++i) {
+		size_t length = strlen(inputs[i].name);
+		struct AssetArchiveEntry * entry = &entries[i];
+		entry->nameHash = mappedFileHash(inputs[i].name, length);
+		entry->nameOffset = nameOffset;
+		memcpy(names + nameOffset, inputs[i].name, length + 1);
+		nameOffset += (uint32_t)length + 1;
+		uint32_t bucket = (uint32_t)entry->nameHash & mask;
+		for (; buckets[bucket] != 0 && ok; bucket = (bucket + 1) & mask) {
+			struct AssetArchiveEntry const * other = &entries[buckets[bucket] - 1];
+			ok = other->nameHash != entry->nameHash || strcmp(names + other->nameOffset, inputs[i].name) != 0;
+		}
+		if (!ok) {
+			fprintf(stderr, "Could not pack %s: %s is there twice\n", path, inputs[i].name);
+			break;
+		}
+		buckets[bucket] = i + 1;
+	}
+
+	size_t pathLength = strlen(path);
+	char * temporaryPath = (char *)malloc(pathLength + 5);
+	memcpy(temporaryPath, path, pathLength);
+	memcpy(temporaryPath + pathLength, ".tmp", 5);
+	FILE * file = ok ? fopen(temporaryPath, "wb") : NULL;
+	if (ok && !file) {
+		fprintf(stderr, "Could not open %s for writing\n", temporaryPath);
+		ok = false;
+	}
+	if (file) {
+		// Blobs first, then the tables they complete, before them
+		ok = writePadding(file, header.dataOffset);
+		uint64_t offset = header.dataOffset;
+		for (uint32_t i = 0; i < inputCount && ok; ++i) {
+			entries[i].offset = offset;
+			ok = writeBlob(file, &inputs[i], &entries[i], &packed, &packedCapacity);
+			offset += alignUp(entries[i].size, ASSET_ARCHIVE_ALIGNMENT);
+		}
+		ok = ok && fseek(file, 0, SEEK_SET) == 0
+			&& fwrite(&header, sizeof(header), 1, file) == 1
+			&& writePadding(file, header.entriesOffset - sizeof(header))
+			&& fwrite(entries, sizeof(struct AssetArchiveEntry), inputCount, file) == inputCount
+			&& fwrite(buckets, sizeof(uint32_t), header.bucketCount, file) == header.bucketCount
+			&& fwrite(names, 1, (size_t)header.namesSize, file) == header.namesSize;
+		ok = fclose(file) == 0 && ok;
+		// rename does not replace existing files on Windows
+		if (ok) remove(path);
+		ok = ok && rename(temporaryPath, path) == 0;
+		if (!ok) {
+			fprintf(stderr, "Could not write asset archive %s\n", path);
+			remove(temporaryPath);
+		}
+	}
+	free(temporaryPath);
+	free(packed);
+	free(names);
+	free(buckets);
+	free(entries);
+	return ok;
+}
@@ -0,0 +1,163 @@
+/**
+ * Packed asset archive, so that the assets of the application (the OBJ
+ * meshes, textures and environment maps of the tutorial, or their caches,
+ * see mesh-cache.h and texture-cache.h) ship as a single file that is
+ * mapped once, instead of loose files and zips that each cost an open, a
+ * seek and a decompression.
+ *
+ * An archive is built offline by the AssetPacker tool (see
+ * tools/asset-packer.c) or assetArchiveWrite, from files given with the
+ * name they get in the archive, a relative path with '/' separators.
+ * Each blob starts at a ASSET_ARCHIVE_ALIGNMENT-aligned offset, so that
+ * it can be mapped or read directly, its content used in place as any
+ * file mapped with mapped-file.h and its 256-aligned offsets (as the ones
+ * of the cache formats) kept valid. Blobs can be compressed in the LZ4
+ * block format (see lz4-block.h), which is only kept when it saves at
+ * least 1 / ASSET_ARCHIVE_MIN_SAVING of the size, so that already
+ * compressed files (JPEGs, zips) stay readable in place.
+ *
+ * Names are found in O(1) through a hash table of the entries: bucket i
+ * holds the index + 1 of an entry (0 for none), entries being found by
+ * linear probing from the bucket of the mappedFileHash of their name,
+ * masked by the bucket count. Opening an archive maps it and checks its
+ * tables once, after which lookups and reads are thread-safe.
+ *
+ * File layout (little endian):
+ *     struct AssetArchiveHeader header;
+ *     struct AssetArchiveEntry entries[header.entryCount], at header.entriesOffset
+ *     uint32_t buckets[header.bucketCount], at header.bucketsOffset
+ *     char names[header.namesSize], at header.namesOffset: NUL terminated
+ *     ...padding...
+ *     blobs, from header.dataOffset, each at its entry's offset
+ *
+ * Typical use:
+ *     struct AssetArchive * archive = assetArchiveOpen("assets.wpak");
+ *     struct AssetBlob blob;
+ *     if (assetArchiveLoad(archive, "textures/autumn_park_4k.jpg", &blob)) {
+ *         pixels = jpegDecode(blob.data, blob.size, &width, &height);
+ *         assetBlobRelease(&blob);
+ *     }
+ *     assetArchiveClose(archive);
+ */
+
+#ifndef _asset_archive_h_
+#define _asset_archive_h_
+
+#include "mapped-file.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ASSET_ARCHIVE_MAGIC "WPAK"
+#define ASSET_ARCHIVE_VERSION 1
+#define ASSET_ARCHIVE_ALIGNMENT 4096 // page size, so blobs can be mapped alone
+#define ASSET_ARCHIVE_EXTENSION ".wpak"
+#define ASSET_ARCHIVE_MIN_SAVING 8 // compressed blobs are at most 7/8 of the size
+
+enum AssetCompression {
+	AssetCompression_None,
+	AssetCompression_LZ4, // LZ4 block format
+	AssetCompression_Count,
+};
+
+struct AssetArchiveHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t bucketCount; // power of two, more than entryCount
+	uint64_t entriesOffset;
+	uint64_t bucketsOffset;
+	uint64_t namesOffset;
+	uint64_t namesSize;
+	uint64_t dataOffset; // of the first blob, after the tables
+};
+
+struct AssetArchiveEntry {
+	uint64_t nameHash; // mappedFileHash of the name, without its NUL
+	uint64_t offset; // of the blob, multiple of ASSET_ARCHIVE_ALIGNMENT
+	uint64_t size; // of the blob as stored
+	uint64_t uncompressedSize;
+	uint64_t contentHash; // mappedFileHash of the uncompressed content
+	uint32_t nameOffset; // in the names table
+	uint32_t compression; // enum AssetCompression
+};
+
+struct AssetArchive {
+	struct MappedFile * file;
+	struct AssetArchiveHeader const * header;
+	struct AssetArchiveEntry const * entries;
+	uint32_t const * buckets;
+	char const * names;
+};
+
+/**
+ * Content of an asset, pointing into the archive for stored entries and
+ * to an allocation for compressed ones.
+ */
+struct AssetBlob {
+	void const * data;
+	size_t size;
+	void * allocation; // NULL when data points into the archive
+};
+
+struct AssetArchiveInput {
+	char const * name; // in the archive
+	char const * path; // of the file to pack
+	enum AssetCompression compression; // kept only if it saves enough
+};
+
+/**
+ * Map the archive at `path` and check its tables. Returns NULL and prints
+ * why if it cannot be opened or is invalid.
+ */
+struct AssetArchive * assetArchiveOpen(char const * path);
+
+void assetArchiveClose(struct AssetArchive * archive);
+
+/**
+ * Entry of the asset named `name`, or NULL if the archive has none.
+ */
+struct AssetArchiveEntry const * assetArchiveFind(struct AssetArchive const * archive, char const * name);
+
+char const * assetArchiveEntryName(struct AssetArchive const * archive, struct AssetArchiveEntry const * entry);
+
+/**
+ * Content of a stored entry, in place in the archive, or NULL for a
+ * compressed one.
+ */
+void const * assetArchiveData(struct AssetArchive const * archive, struct AssetArchiveEntry const * entry);
+
+/**
+ * Copy or decompress the content of `entry` to `destination`, which holds
+ * entry->uncompressedSize bytes. Returns false if a compressed blob is
+ * invalid.
+ */
+bool assetArchiveRead(struct AssetArchive const * archive, struct AssetArchiveEntry const * entry, void * destination);
+
+/**
+ * Content of the asset named `name`, without any copy when it is stored.
+ * Returns false and prints why if it is missing or invalid, with `blob`
+ * zeroed.
+ */
+bool assetArchiveLoad(struct AssetArchive const * archive, char const * name, struct AssetBlob * blob);
+
+void assetBlobRelease(struct AssetBlob * blob);
+
+/**
+ * Pack the files of `inputs` into an archive at `path`, through a
+ * temporary file so that a failed write keeps the previous archive.
+ * Returns false and prints why if a file cannot be read, names are not
+ * unique, or the archive cannot be written.
+ */
+bool assetArchiveWrite(char const * path, struct AssetArchiveInput const * inputs, uint32_t inputCount);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _asset_archive_h_
@@ -0,0 +1,230 @@
+#include "asset-jobs.h"
+
+#include <tinycthread.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+struct AssetJobQueue {
+	struct AssetJob * head;
+	struct AssetJob * tail;
+};
+
+struct AssetJobWorkers {
+	thrd_t threads[ASSET_JOBS_MAX_THREADS];
+	uint32_t threadCount;
+	mtx_t mutex;
+	// Signaled when jobs are queued or finished, or when stopping
+	cnd_t changed;
+	struct AssetJobQueue workerQueue;
+	struct AssetJobQueue deviceQueue;
+	bool stopping;
+	struct AssetJobGraph * graph;
+};
+
+static double now(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Scheduling, with the workers' mutex locked
+
+static void pushJob(struct AssetJobQueue * queue, struct AssetJob * job) {
+	job->nextReady = NULL;
+	if (queue->tail) {
+		queue->tail->nextReady = job;
+	} else {
+		queue->head = job;
+	}
+	queue->tail = job;
+}
+
+static struct AssetJob * popJob(struct AssetJobQueue * queue) {
+	struct AssetJob * job = queue->head;
+	if (!job) return NULL;
+	queue->head = job->nextReady;
+	if (!queue->head) queue->tail = NULL;
+	job->nextReady = NULL;
+	return job;
+}
+
+static void makeReady(struct AssetJobWorkers * workers, struct AssetJob * job) {
+	job->state = AssetJob_Ready;
+	pushJob(job->thread == AssetJobThread_Device ? &workers->deviceQueue : &workers->workerQueue, job);
+}
+
+/**
+ * Record the end of `job`, which makes ready the dependents it was the
+ * last to wait for, or fails all of them, recursively, if it failed.
+ */
+static void finishJob(struct AssetJobWorkers * workers, struct AssetJob * job, bool ok) {
+	struct AssetJobGraph * graph = workers->graph;
+	job->state = ok ? AssetJob_Done : AssetJob_Failed;
+	graph->finishedCount++;
+	if (!ok) graph->failedCount++;
+	for (uint32_t i = 0; i < job->dependentCount; ++i) {
+		struct AssetJob * dependent = job->dependents[i];
+		if (dependent->state != AssetJob_Waiting) continue; // already failed by another dependency
+		if (!ok) {
+			finishJob(workers, dependent, false);
+		} else if (--dependent->waitingCount == 0) {
+			makeReady(workers, dependent);
+		}
+	}
+	free(job->dependents);
+	job->dependents = NULL;
+	job->dependentCount = 0;
+	job->dependentCapacity = 0;
+	cnd_broadcast(&workers->changed);
+}
+
+/**
+ * Run `job`, which was popped from a ready queue, with the mutex unlocked.
+ */
+static void runJob(struct AssetJobWorkers * workers, struct AssetJob * job) {
+	job->state = AssetJob_Running;
+	mtx_unlock(&workers->mutex);
+	double start = now();
+	bool ok = job->function(job->userData);
+	double runTime = now() - start;
+	mtx_lock(&workers->mutex);
+	job->runTime = runTime;
+	finishJob(workers, job, ok);
+}
+
+static int workerThread(void * arg) {
+	struct AssetJobWorkers * workers = (struct AssetJobWorkers *)arg;
+	mtx_lock(&workers->mutex);
+	for (;;) {
+		while (!workers->workerQueue.head && !workers->stopping) {
+			cnd_wait(&workers->changed, &workers->mutex);
+		}
+		if (workers->stopping) break;
+		runJob(workers, popJob(&workers->workerQueue));
+	}
+	mtx_unlock(&workers->mutex);
+	return 0;
+}
+
+// Graph
+
+struct AssetJobGraph * assetJobGraphCreate(uint32_t threadCount) {
+	if (threadCount == 0) threadCount = ASSET_JOBS_DEFAULT_THREADS;
+	if (threadCount > ASSET_JOBS_MAX_THREADS) threadCount = ASSET_JOBS_MAX_THREADS;
+	struct AssetJobGraph * graph = (struct AssetJobGraph *)calloc(1, sizeof(struct AssetJobGraph));
+	struct AssetJobWorkers * workers = (struct AssetJobWorkers *)calloc(1, sizeof(struct AssetJobWorkers));
+	workers->graph = graph;
+	mtx_init(&workers->mutex, mtx_plain);
+	cnd_init(&workers->changed);
+	graph->workers = workers;
+	for (; workers->threadCount < threadCount; ++workers->threadCount) {
+		if (thrd_create(&workers->threads[workers->threadCount], workerThread, (void *)workers) != thrd_success) break;
+	}
+	if (workers->threadCount == 0) {
+		fprintf(stderr, "Could not start the asset job threads\n");
+		assetJobGraphRelease(graph);
+		return NULL;
+	}
+	return graph;
+}
+
+struct AssetJob * assetJobGraphAdd(struct AssetJobGraph * graph, enum AssetJobThread thread, AssetJobFunction function, void * userData,
+	struct AssetJob * const * dependencies, uint32_t dependencyCount, char const * label) {
+	struct AssetJob * job = (struct AssetJob *)calloc(1, sizeof(struct AssetJob));
+	job->function = function;
+	job->userData = userData;
+	job->label = label;
+	job->thread = thread;
+	job->state = AssetJob_Waiting;
+
+	struct AssetJobWorkers * workers = graph->workers;
+	mtx_lock(&workers->mutex);
+	job->nextInGraph = graph->jobs;
+	graph->jobs = job;
+	graph->jobCount++;
+	bool failed = false;
+	for (uint32_t i = 0; i < dependencyCount; ++i) {
+		struct AssetJob * dependency = dependencies[i];
+		if (dependency->state == AssetJob_Done) continue;
+		if (dependency->state == AssetJob_Failed) {
+			failed = true;
+			continue;
+		}
+		if (dependency->dependentCount == dependency->dependentCapacity) {
+			dependency->dependentCapacity = dependency->dependentCapacity > 0 ? 2 * dependency->dependentCapacity : 4;
+			dependency->dependents = (struct AssetJob **)realloc(dependency->dependents, dependency->dependentCapacity * sizeof(struct AssetJob *));
+		}
+		dependency->dependents[dependency->dependentCount++] = job;
+		job->waitingCount++;
+	}
+	if (failed) {
+		// Its pending dependencies skip it when they finish
+		finishJob(workers, job, false);
+	} else if (job->waitingCount == 0) {
+		makeReady(workers, job);
+		cnd_broadcast(&workers->changed);
+	}
+	mtx_unlock(&workers->mutex);
+	return job;
+}
+
+uint32_t assetJobGraphUpdate(struct AssetJobGraph * graph) {
+	struct AssetJobWorkers * workers = graph->workers;
+	uint32_t runCount = 0;
+	mtx_lock(&workers->mutex);
+	for (struct AssetJob * job; (job = popJob(&workers->deviceQueue)); ++runCount) {
+		runJob(workers, job);
+	}
+	mtx_unlock(&workers->mutex);
+	return runCount;
+}
+
+bool assetJobGraphWait(struct AssetJobGraph * graph) {
+	struct AssetJobWorkers * workers = graph->workers;
+	mtx_lock(&workers->mutex);
+	for (;;) {
+		struct AssetJob * job = popJob(&workers->deviceQueue);
+		if (job) {
+			runJob(workers, job);
+		} else if (graph->finishedCount == graph->jobCount) {
+			break;
+		} else {
+			cnd_wait(&workers->changed, &workers->mutex);
+		}
+	}
+	bool ok = graph->failedCount == 0;
+	mtx_unlock(&workers->mutex);
+	return ok;
+}
+
+void assetJobGraphReset(struct AssetJobGraph * graph) {
+	assetJobGraphWait(graph);
+	// All jobs are finished, so no worker touches them anymore
+	while (graph->jobs) {
+		struct AssetJob * job = graph->jobs;
+		graph->jobs = job->nextInGraph;
+		free(job);
+	}
+	graph->jobCount = 0;
+	graph->finishedCount = 0;
+	graph->failedCount = 0;
+}
+
+void assetJobGraphRelease(struct AssetJobGraph * graph) {
+	if (!graph) return;
+	struct AssetJobWorkers * workers = graph->workers;
+	if (workers->threadCount > 0) assetJobGraphReset(graph);
+	mtx_lock(&workers->mutex);
+	workers->stopping = true;
+	cnd_broadcast(&workers->changed);
+	mtx_unlock(&workers->mutex);
+	for (uint32_t i = 0; i < workers->threadCount; ++i) {
+		thrd_join(workers->threads[i], NULL);
+	}
+	cnd_destroy(&workers->changed);
+	mtx_destroy(&workers->mutex);
+	free(workers);
+	free(graph);
+}
@@ -0,0 +1,134 @@
+/**
+ * Dependency graph of asset loading jobs, so that loading a scene takes
+ * about as long as its slowest asset instead of the sum of all of them.
+ *
+ * Loading an asset is a chain of jobs: reading and decoding its file,
+ * transcoding it (see mesh-cache.h and texture-cache.h), uploading it and
+ * creating the objects that use it, such as bind groups that need both a
+ * mesh and its textures. Each job lists the jobs it depends on, and runs
+ * as soon as they are all done:
+ *  - worker jobs on a pool of threads, so that the CPU work of all the
+ *    assets overlaps;
+ *  - device jobs on the thread that updates the graph, the one that owns
+ *    the device, so that GPU uploads, object creation and submissions are
+ *    never made from several threads at once.
+ *
+ * A job returns false when it fails. Its dependents then fail too without
+ * running, so the whole chain of an asset stops at its first error while
+ * the other assets go on. Jobs can be added from any thread, including
+ * from jobs, and may depend on any job of the graph, finished or not.
+ *
+ * Jobs belong to the graph, which frees them when reset; their user data
+ * belongs to the caller, to release once the graph is done with them.
+ *
+ * Typical use:
+ *     struct AssetJob * mesh = assetJobGraphAdd(graph, AssetJobThread_Worker, loadMesh, asset, NULL, 0, "Suzanne mesh");
+ *     struct AssetJob * texture = assetJobGraphAdd(graph, AssetJobThread_Worker, loadTexture, asset, NULL, 0, "Suzanne texture");
+ *     struct AssetJob * buffers = assetJobGraphAdd(graph, AssetJobThread_Device, createBuffers, asset, &mesh, 1, "Suzanne buffers");
+ *     ...
+ *     struct AssetJob * const inputs[] = { buffers, textureView };
+ *     assetJobGraphAdd(graph, AssetJobThread_Device, createBindGroup, asset, inputs, 2, "Suzanne bind group");
+ *     assetJobGraphWait(graph); // or assetJobGraphUpdate(graph) once per frame
+ *     assetJobGraphReset(graph);
+ */
+
+#ifndef _asset_jobs_h_
+#define _asset_jobs_h_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ASSET_JOBS_DEFAULT_THREADS 4
+#define ASSET_JOBS_MAX_THREADS 16
+
+enum AssetJobThread {
+	AssetJobThread_Worker, // file reads, decoding, transcoding
+	AssetJobThread_Device, // GPU uploads and object creation
+};
+
+enum AssetJobState {
+	AssetJob_Waiting, // for its dependencies
+	AssetJob_Ready, // queued for its thread
+	AssetJob_Running,
+	AssetJob_Done,
+	AssetJob_Failed, // returned false, or a dependency failed
+};
+
+typedef bool (*AssetJobFunction)(void * userData);
+
+struct AssetJob {
+	AssetJobFunction function;
+	void * userData;
+	char const * label;
+	enum AssetJobThread thread;
+	// Guarded by the graph's mutex, final after assetJobGraphWait
+	enum AssetJobState state;
+	double runTime; // seconds spent in `function`
+	uint32_t waitingCount; // dependencies not done yet
+	struct AssetJob ** dependents;
+	uint32_t dependentCount;
+	uint32_t dependentCapacity;
+	struct AssetJob * nextReady;
+	struct AssetJob * nextInGraph;
+};
+
+// Threads, mutex and ready queues, private to asset-jobs.c
+struct AssetJobWorkers;
+
+struct AssetJobGraph {
+	struct AssetJobWorkers * workers;
+	struct AssetJob * jobs; // all of them, latest first
+
+	// Statistics, guarded by the graph's mutex, final after assetJobGraphWait
+	uint32_t jobCount;
+	uint32_t finishedCount; // done or failed
+	uint32_t failedCount;
+};
+
+/**
+ * Start `threadCount` worker threads, or ASSET_JOBS_DEFAULT_THREADS when
+ * 0. Device jobs run on the thread that updates or waits for the graph.
+ */
+struct AssetJobGraph * assetJobGraphCreate(uint32_t threadCount);
+
+/**
+ * Add a job running `function(userData)` on `thread` once the
+ * `dependencyCount` jobs of `dependencies` are done. `label` must outlive
+ * the job, which may start before this returns. Thread-safe.
+ */
+struct AssetJob * assetJobGraphAdd(struct AssetJobGraph * graph, enum AssetJobThread thread, AssetJobFunction function, void * userData,
+	struct AssetJob * const * dependencies, uint32_t dependencyCount, char const * label);
+
+/**
+ * Run the device jobs that are ready, and the ones they make ready,
+ * without waiting for workers. Call once per frame from the device
+ * thread to load in the background. Returns the number of jobs run.
+ */
+uint32_t assetJobGraphUpdate(struct AssetJobGraph * graph);
+
+/**
+ * Run device jobs as they get ready until all the jobs of the graph are
+ * finished. Call from the device thread. Returns false if any failed.
+ */
+bool assetJobGraphWait(struct AssetJobGraph * graph);
+
+/**
+ * Wait for all the jobs, then free them, so that the graph can load the
+ * next scene. Call from the device thread.
+ */
+void assetJobGraphReset(struct AssetJobGraph * graph);
+
+/**
+ * Wait for all the jobs, then stop the workers and free the graph.
+ */
+void assetJobGraphRelease(struct AssetJobGraph * graph);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _asset_jobs_h_
@@ -0,0 +1,152 @@
+/**
+ * Compare loading a set of assets from loose files, read with fread or
+ * mapped, with loading them from an asset archive (see asset-archive.h)
+ * whose blobs are all stored, used in place, or compressed with LZ4 when
+ * it saves enough. Each load touches every page of the content, and
+ * lookups of names in the archive are timed alone. Archives are written
+ * to the working directory and removed afterwards. Assets are the OBJ
+ * meshes and images of the tutorial by default.
+ *
+ * Usage: AssetArchiveBench [path...]
+ */
+
+#include "asset-archive.h"
+#include "bench-utils.h"
+#include "mapped-file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_PATH "asset-archive-bench" ASSET_ARCHIVE_EXTENSION
+#define PASSES 20
+#define LOOKUPS 1000000
+
+static char const * const defaultAssets[] = {
+	TUTORIAL_DOWNLOADS_DIR "/cde57d00bd47ad54b41b8ed2b9b4939d/cube.obj",
+	TUTORIAL_DOWNLOADS_DIR "/a807bbb5c9ad69e555e25d70b1fcf26e/cylinder.obj",
+	TUTORIAL_DOWNLOADS_DIR "/4336d1767fec66e6d2c5aca98e086357/plane.obj",
+	TUTORIAL_DOWNLOADS_DIR "/0e38411683f6c2ab2fc32cdba6c43686/pyramid.obj",
+	TUTORIAL_DOWNLOADS_DIR "/bc824d0b5d89c824c50c5cbe0bba5c19/quad-input.obj",
+	TUTORIAL_DOWNLOADS_DIR "/b029881ac5773fe32220cedfa2ed3397/suzanne.obj",
+	TUTORIAL_DOWNLOADS_DIR "/0c8abb5497048334504589e205b82d04/input.jpg",
+	TUTORIAL_DOWNLOADS_DIR "/5ebf7fba43b21baf167e7b5e8c8653e4/reference.png",
+	TUTORIAL_DOWNLOADS_DIR "/56f71f3c8d42e16a26b651e739608565/autumn_park_4k.jpg",
+	TUTORIAL_DOWNLOADS_DIR "/c69c56204b32f85418889a40235cf7f5/cobblestone_floor_08_diff_2k.jpg",
+};
+
+// Read one byte per page, as a loader would at least
+static uint64_t touch(void const * data, size_t size) {
+	uint64_t sum = 0;
+	for (size_t i = 0; i < size; i += 4096) sum += ((uint8_t const *)data)[i];
+	return sum;
+}
+
+static double loadLooseRead(char const * const * paths, int pathCount, uint64_t * checksum) {
+	double start = benchNow();
+	for (int i = 0; i < pathCount; ++i) {
+		FILE * file = fopen(paths[i], "rb");
+		if (!file) continue;
+		fseek(file, 0, SEEK_END);
+		long size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		void * data = malloc(size > 0 ? (size_t)size : 1);
+		if (fread(data, 1, (size_t)size, file) == (size_t)size) *checksum += touch(data, (size_t)size);
+		fclose(file);
+		free(data);
+	}
+	return benchNow() - start;
+}
+
+static double loadLooseMapped(char const * const * paths, int pathCount, uint64_t * checksum) {
+	double start = benchNow();
+	for (int i = 0; i < pathCount; ++i) {
+		struct MappedFile * file = mappedFileOpen(paths[i]);
+		if (!file) continue;
+		*checksum += touch(file->data, file->size);
+		mappedFileClose(file);
+	}
+	return benchNow() - start;
+}
+
+static double loadArchive(char const * path, char const * const * paths, int pathCount, uint64_t * checksum) {
+	double start = benchNow();
+	struct AssetArchive * archive = assetArchiveOpen(path);
+	if (!archive) return 0.0;
+	for (int i = 0; i < pathCount; ++i) {
+		struct AssetBlob blob;
+		if (!assetArchiveLoad(archive, paths[i], &blob)) continue;
+		*checksum += touch(blob.data, blob.size);
+		assetBlobRelease(&blob);
+	}
+	assetArchiveClose(archive);
+	return benchNow() - start;
+}
+
+int main(int argc, char** argv) {
+	char const * const * paths = argc > 1 ? (char const * const *)(argv + 1) : defaultAssets;
+	int pathCount = argc > 1 ? argc - 1 : (int)(sizeof(defaultAssets) / sizeof(defaultAssets[0]));
+
+	// Assets are named by their path, so that both sides use the same list
+	struct AssetArchiveInput * inputs = (struct AssetArchiveInput *)calloc(pathCount, sizeof(struct AssetArchiveInput));
+	for (int i = 0; i < pathCount; ++i) inputs[i] = (struct AssetArchiveInput) { paths[i], paths[i], AssetCompression_None };
+	double start = benchNow();
+	if (!assetArchiveWrite(BENCH_PATH, inputs, (uint32_t)pathCount)) return 1;
+	double storedPackTime = benchNow() - start;
+	struct AssetArchive * archive = assetArchiveOpen(BENCH_PATH);
+	if (!archive) return 1;
+	uint64_t storedArchiveSize = archive->file->size;
+	assetArchiveClose(archive);
+
+	for (int i = 0; i < pathCount; ++i) inputs[i].compression = AssetCompression_LZ4;
+	char const * lz4Path = "lz4-" BENCH_PATH;
+	start = benchNow();
+	if (!assetArchiveWrite(lz4Path, inputs, (uint32_t)pathCount)) return 1;
+	double lz4PackTime = benchNow() - start;
+	archive = assetArchiveOpen(lz4Path);
+	if (!archive) return 1;
+
+	printf("%-32s %10s %10s\n", "asset", "size", "lz4");
+	uint64_t totalSize = 0;
+	for (int i = 0; i < pathCount; ++i) {
+		struct AssetArchiveEntry const * entry = assetArchiveFind(archive, paths[i]);
+		char const * name = strrchr(paths[i], '/') ? strrchr(paths[i], '/') + 1 : paths[i];
+		char packedSize[24] = "stored";
+		if (entry->compression == AssetCompression_LZ4) snprintf(packedSize, sizeof(packedSize), "%llu", (unsigned long long)entry->size);
+		printf("%-32s %10llu %10s\n", name, (unsigned long long)entry->uncompressedSize, packedSize);
+		totalSize += entry->uncompressedSize;
+	}
+	printf("%d assets, %.2f MB: stored archive %.2f MB (packed in %.1f ms), lz4 archive %.2f MB (packed in %.1f ms)\n",
+		pathCount, (double)totalSize * 1e-6, (double)storedArchiveSize * 1e-6, storedPackTime * 1e3,
+		(double)archive->file->size * 1e-6, lz4PackTime * 1e3);
+
+	// Lookups alone, cycling through the names
+	uint64_t found = 0;
+	start = benchNow();
+	for (int i = 0; i < LOOKUPS; ++i) found += assetArchiveFind(archive, paths[i % pathCount]) != NULL;
+	double lookupTime = benchNow() - start;
+	assetArchiveClose(archive);
+	printf("lookup: %.1f ns (%llu found)\n", lookupTime * 1e9 / LOOKUPS, (unsigned long long)found);
+
+	// Best of PASSES loads of the whole set, the files being in the OS cache
+	double best[4] = { 1e30, 1e30, 1e30, 1e30 };
+	uint64_t checksums[4] = { 0 };
+	for (int pass = 0; pass < PASSES; ++pass) {
+		double times[4] = {
+			loadLooseRead(paths, pathCount, &checksums[0]),
+			loadLooseMapped(paths, pathCount, &checksums[1]),
+			loadArchive(BENCH_PATH, paths, pathCount, &checksums[2]),
+			loadArchive(lz4Path, paths, pathCount, &checksums[3]),
+		};
+		for (int i = 0; i < 4; ++i) best[i] = times[i] < best[i] ? times[i] : best[i];
+	}
+	static char const * const names[4] = { "loose, fread", "loose, mapped", "archive, stored", "archive, lz4" };
+	for (int i = 0; i < 4; ++i) {
+		printf("%-16s %8.3f ms%s\n", names[i], best[i] * 1e3, checksums[i] == checksums[0] ? "" : " (content differs!)");
+	}
+
+	free(inputs);
+	remove(BENCH_PATH);
+	remove(lz4Path);
+	return 0;
+}
@@ -0,0 +1,297 @@
+/**
+ * Compare loading a scene of the tutorial's meshes, each with a texture
+ * (see mesh-cache.h and texture-cache.h) and a bind group using both, one
+ * asset after the other with loading it through an asset job graph (see
+ * asset-jobs.h). Both are measured importing the assets, their caches
+ * being removed first, then from their caches, up to the end of the GPU
+ * work, along with the time of the slowest asset alone (the longest chain
+ * of its jobs) and of all the jobs, which the graph should approach and
+ * the sequential load pays.
+ *
+ * Sources are copied to the working directory first, so that the caches
+ * are written there, and removed afterwards.
+ *
+ * Usage: AssetJobsBench [threads]
+ */
+
+#include <webgpu/webgpu.h>
+#include "asset-jobs.h"
+#include "bench-utils.h"
+#include "mapped-file.h"
+#include "mesh-cache.h"
+#include "texture-cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MESH_DIR TUTORIAL_DOWNLOADS_DIR
+#define AUTUMN_PARK TUTORIAL_DOWNLOADS_DIR "/56f71f3c8d42e16a26b651e739608565/autumn_park_4k.jpg"
+#define COBBLESTONE TUTORIAL_DOWNLOADS_DIR "/c69c56204b32f85418889a40235cf7f5/cobblestone_floor_08_diff_2k.jpg"
+
+static char const * const sceneSources[][2] = {
+	{ MESH_DIR "/b029881ac5773fe32220cedfa2ed3397/suzanne.obj", COBBLESTONE },
+	{ MESH_DIR "/cde57d00bd47ad54b41b8ed2b9b4939d/cube.obj", AUTUMN_PARK },
+	{ MESH_DIR "/a807bbb5c9ad69e555e25d70b1fcf26e/cylinder.obj", COBBLESTONE },
+	{ MESH_DIR "/0e38411683f6c2ab2fc32cdba6c43686/pyramid.obj", AUTUMN_PARK },
+	{ MESH_DIR "/4336d1767fec66e6d2c5aca98e086357/plane.obj", COBBLESTONE },
+	{ MESH_DIR "/bc824d0b5d89c824c50c5cbe0bba5c19/quad-input.obj", AUTUMN_PARK },
+};
+#define ASSET_COUNT (sizeof(sceneSources) / sizeof(sceneSources[0]))
+
+struct Scene {
+	WGPUDevice device;
+	WGPUQueue queue;
+	enum TextureCompression compression;
+	WGPUBindGroupLayout layout;
+	WGPUSampler sampler;
+};
+
+struct SceneAsset {
+	struct Scene const * scene;
+	char meshPath[64];
+	char texturePath[64];
+	struct MeshCache * meshCache;
+	struct TextureCache * textureCache;
+	struct MeshBuffers buffers;
+	WGPUTexture texture;
+	WGPUTextureView view;
+	WGPUBindGroup bindGroup;
+};
+
+enum SceneJob {
+	SceneJob_LoadMesh,
+	SceneJob_LoadTexture,
+	SceneJob_CreateBuffers,
+	SceneJob_CreateTexture,
+	SceneJob_CreateBindGroup,
+	SceneJob_Count,
+};
+
+static bool copyFile(char const * from, char const * to) {
+	struct MappedFile * source = mappedFileOpen(from);
+	if (!source) return false;
+	FILE * file = fopen(to, "wb");
+	bool ok = file && fwrite(source->data, 1, source->size, file) == source->size;
+	ok = file && fclose(file) == 0 && ok;
+	mappedFileClose(source);
+	return ok;
+}
+
+static void removeCaches(struct SceneAsset const * asset) {
+	char cachePath[96];
+	snprintf(cachePath, sizeof(cachePath), "%s%s", asset->meshPath, MESH_CACHE_EXTENSION);
+	remove(cachePath);
+	snprintf(cachePath, sizeof(cachePath), "%s%s", asset->texturePath, textureCacheExtension(TextureCacheKind_Color, asset->scene->compression));
+	remove(cachePath);
+}
+
+// Jobs
+
+static bool loadMesh(void * userData) {
+	struct SceneAsset * asset = (struct SceneAsset *)userData;
+	asset->meshCache = meshCacheLoad(asset->meshPath, 0);
+	return asset->meshCache != NULL;
+}
+
+static bool loadTexture(void * userData) {
+	struct SceneAsset * asset = (struct SceneAsset *)userData;
+	asset->textureCache = textureCacheLoad(asset->texturePath, TextureCacheKind_Color, asset->scene->compression, 0);
+	return asset->textureCache != NULL;
+}
+
+static bool createBuffers(void * userData) {
+	struct SceneAsset * asset = (struct SceneAsset *)userData;
+	asset->buffers = meshCacheCreateBuffers(asset->scene->device, asset->meshCache, "Scene mesh");
+	meshCacheRelease(asset->meshCache);
+	asset->meshCache = NULL;
+	return asset->buffers.vertexBuffer != NULL;
+}
+
+static bool createTexture(void * userData) {
+	struct SceneAsset * asset = (struct SceneAsset *)userData;
+	asset->texture = textureCacheCreateTexture(asset->scene->device, asset->scene->queue, asset->textureCache, "Scene texture");
+	textureCacheRelease(asset->textureCache);
+	asset->textureCache = NULL;
+	if (!asset->texture) return false;
+	asset->view = wgpuTextureCreateView(asset->texture, NULL);
+	return true;
+}
+
+static bool createBindGroup(void * userData) {
+	struct SceneAsset * asset = (struct SceneAsset *)userData;
+	WGPUBindGroupEntry entries[2];
+	entries[0] = (WGPUBindGroupEntry) {};
+	entries[0].binding = 0;
+	entries[0].textureView = asset->view;
+	entries[1] = (WGPUBindGroupEntry) {};
+	entries[1].binding = 1;
+	entries[1].sampler = asset->scene->sampler;
+	WGPUBindGroupDescriptor desc = (WGPUBindGroupDescriptor) {};
+	desc.nextInChain = NULL;
+	desc.label = "Scene object";
+	desc.layout = asset->scene->layout;
+	desc.entryCount = 2;
+	desc.entries = entries;
+	asset->bindGroup = wgpuDeviceCreateBindGroup(asset->scene->device, &desc);
+	return asset->bindGroup != NULL;
+}
+
+static void releaseAsset(struct SceneAsset * asset) {
+	meshCacheRelease(asset->meshCache);
+	textureCacheRelease(asset->textureCache);
+	meshBuffersRelease(&asset->buffers);
+	if (asset->bindGroup) wgpuBindGroupRelease(asset->bindGroup);
+	if (asset->view) wgpuTextureViewRelease(asset->view);
+	if (asset->texture) {
+		wgpuTextureDestroy(asset->texture);
+		wgpuTextureRelease(asset->texture);
+	}
+	asset->meshCache = NULL;
+	asset->textureCache = NULL;
+	asset->bindGroup = NULL;
+	asset->view = NULL;
+	asset->texture = NULL;
+}
+
+// Scene loads
+
+static bool loadSequentially(struct Scene const * scene, struct SceneAsset * assets) {
+	bool ok = true;
+	for (uint32_t i = 0; i < ASSET_COUNT && ok; ++i) {
+		ok = loadMesh(&assets[i]) && loadTexture(&assets[i])
+			&& createBuffers(&assets[i]) && createTexture(&assets[i]) && createBindGroup(&assets[i]);
+	}
+	benchWaitForQueue(scene->device, scene->queue);
+	return ok;
+}
+
+/**
+ * Load the scene through `graph`, and return the run time of the longest
+ * chain of jobs of a single asset in `slowestAsset` and of all jobs in
+ * `allJobs`.
+ */
+static bool loadWithGraph(struct Scene const * scene, struct SceneAsset * assets, struct AssetJobGraph * graph, double * slowestAsset, double * allJobs) {
+	struct AssetJob * jobs[ASSET_COUNT][SceneJob_Count];
+	for (uint32_t i = 0; i < ASSET_COUNT; ++i) {
+		struct AssetJob ** j = jobs[i];
+		j[SceneJob_LoadMesh] = assetJobGraphAdd(graph, AssetJobThread_Worker, loadMesh, &assets[i], NULL, 0, "Load mesh");
+		j[SceneJob_LoadTexture] = assetJobGraphAdd(graph, AssetJobThread_Worker, loadTexture, &assets[i], NULL, 0, "Load texture");
+		j[SceneJob_CreateBuffers] = assetJobGraphAdd(graph, AssetJobThread_Device, createBuffers, &assets[i], &j[SceneJob_LoadMesh], 1, "Create buffers");
+		j[SceneJob_CreateTexture] = assetJobGraphAdd(graph, AssetJobThread_Device, createTexture, &assets[i], &j[SceneJob_LoadTexture], 1, "Create texture");
+		struct AssetJob * const uploads[] = { j[SceneJob_CreateBuffers], j[SceneJob_CreateTexture] };
+		j[SceneJob_CreateBindGroup] = assetJobGraphAdd(graph, AssetJobThread_Device, createBindGroup, &assets[i], uploads, 2, "Create bind group");
+	}
+	bool ok = assetJobGraphWait(graph);
+	benchWaitForQueue(scene->device, scene->queue);
+
+	*slowestAsset = 0.0;
+	*allJobs = 0.0;
+	for (uint32_t i = 0; i < ASSET_COUNT; ++i) {
+		struct AssetJob ** j = jobs[i];
+		double meshChain = j[SceneJob_LoadMesh]->runTime + j[SceneJob_CreateBuffers]->runTime;
+		double textureChain = j[SceneJob_LoadTexture]->runTime + j[SceneJob_CreateTexture]->runTime;
+		double chain = (meshChain > textureChain ? meshChain : textureChain) + j[SceneJob_CreateBindGroup]->runTime;
+		if (chain > *slowestAsset) *slowestAsset = chain;
+		for (int k = 0; k < SceneJob_Count; ++k) *allJobs += j[k]->runTime;
+	}
+	assetJobGraphReset(graph);
+	return ok;
+}
+
+int main(int argc, char** argv) {
+	uint32_t threadCount = argc > 1 ? (uint32_t)atoi(argv[1]) : 0;
+
+	struct BenchGpu gpu;
+	if (!benchGpuCreate(&gpu, DeviceProfile_Production)) return 1;
+	WGPUDevice device = gpu.device;
+
+	struct Scene scene;
+	memset(&scene, 0, sizeof(scene));
+	scene.device = device;
+	scene.queue = gpu.queue;
+	scene.compression = textureCompressionOf(device);
+
+	WGPUBindGroupLayoutEntry layoutEntries[2];
+	layoutEntries[0] = (WGPUBindGroupLayoutEntry) {};
+	layoutEntries[0].binding = 0;
+	layoutEntries[0].visibility = WGPUShaderStage_Fragment;
+	layoutEntries[0].texture.sampleType = WGPUTextureSampleType_Float;
+	layoutEntries[0].texture.viewDimension = WGPUTextureViewDimension_2D;
+	layoutEntries[0].texture.multisampled = false;
+	layoutEntries[1] = (WGPUBindGroupLayoutEntry) {};
+	layoutEntries[1].binding = 1;
+	layoutEntries[1].visibility = WGPUShaderStage_Fragment;
+	layoutEntries[1].sampler.type = WGPUSamplerBindingType_Filtering;
+	WGPUBindGroupLayoutDescriptor layoutDesc = (WGPUBindGroupLayoutDescriptor) {};
+	layoutDesc.nextInChain = NULL;
+	layoutDesc.label = "Scene object";
+	layoutDesc.entryCount = 2;
+	layoutDesc.entries = layoutEntries;
+	scene.layout = wgpuDeviceCreateBindGroupLayout(device, &layoutDesc);
+
+	WGPUSamplerDescriptor samplerDesc = (WGPUSamplerDescriptor) {};
+	samplerDesc.nextInChain = NULL;
+	samplerDesc.label = "Scene";
+	samplerDesc.addressModeU = WGPUAddressMode_Repeat;
+	samplerDesc.addressModeV = WGPUAddressMode_Repeat;
+	samplerDesc.addressModeW = WGPUAddressMode_Repeat;
+	samplerDesc.magFilter = WGPUFilterMode_Linear;
+	samplerDesc.minFilter = WGPUFilterMode_Linear;
+	samplerDesc.mipmapFilter = WGPUFilterMode_Linear;
+	samplerDesc.lodMinClamp = 0.0f;
+	samplerDesc.lodMaxClamp = 32.0f;
+	samplerDesc.compare = WGPUCompareFunction_Undefined;
+	samplerDesc.maxAnisotropy = 1;
+	scene.sampler = wgpuDeviceCreateSampler(device, &samplerDesc);
+
+	struct SceneAsset assets[ASSET_COUNT];
+	memset(assets, 0, sizeof(assets));
+	for (uint32_t i = 0; i < ASSET_COUNT; ++i) {
+		assets[i].scene = &scene;
+		snprintf(assets[i].meshPath, sizeof(assets[i].meshPath), "asset-jobs-bench-%u.obj", i);
+		snprintf(assets[i].texturePath, sizeof(assets[i].texturePath), "asset-jobs-bench-%u.jpg", i);
+		if (!copyFile(sceneSources[i][0], assets[i].meshPath) || !copyFile(sceneSources[i][1], assets[i].texturePath)) {
+			fprintf(stderr, "Could not copy the sources of asset %u\n", i);
+			return 1;
+		}
+	}
+
+	struct AssetJobGraph * graph = assetJobGraphCreate(threadCount);
+	if (!graph) return 1;
+	if (threadCount == 0) threadCount = ASSET_JOBS_DEFAULT_THREADS;
+	if (threadCount > ASSET_JOBS_MAX_THREADS) threadCount = ASSET_JOBS_MAX_THREADS;
+	printf("%u assets, %u threads\n", (unsigned)ASSET_COUNT, threadCount);
+	printf("%-8s %12s %12s %14s %12s\n", "caches", "sequential", "graph", "slowest asset", "all jobs");
+
+	bool ok = true;
+	for (int cached = 0; cached < 2 && ok; ++cached) {
+		if (!cached) for (uint32_t i = 0; i < ASSET_COUNT; ++i) removeCaches(&assets[i]);
+		double start = benchNow();
+		ok = loadSequentially(&scene, assets);
+		double sequentialTime = benchNow() - start;
+		for (uint32_t i = 0; i < ASSET_COUNT; ++i) releaseAsset(&assets[i]);
+
+		if (!cached) for (uint32_t i = 0; i < ASSET_COUNT; ++i) removeCaches(&assets[i]);
+		double slowestAsset, allJobs;
+		start = benchNow();
+		ok = ok && loadWithGraph(&scene, assets, graph, &slowestAsset, &allJobs);
+		double graphTime = benchNow() - start;
+		for (uint32_t i = 0; i < ASSET_COUNT; ++i) releaseAsset(&assets[i]);
+		if (!ok) break;
+
+		printf("%-8s %9.1f ms %9.1f ms %11.1f ms %9.1f ms\n", cached ? "used" : "removed",
+			sequentialTime * 1e3, graphTime * 1e3, slowestAsset * 1e3, allJobs * 1e3);
+	}
+
+	for (uint32_t i = 0; i < ASSET_COUNT; ++i) {
+		removeCaches(&assets[i]);
+		remove(assets[i].meshPath);
+		remove(assets[i].texturePath);
+	}
+	assetJobGraphRelease(graph);
+	wgpuSamplerRelease(scene.sampler);
+	wgpuBindGroupLayoutRelease(scene.layout);
+	benchGpuRelease(&gpu);
+	return ok ? 0 : 1;
+}
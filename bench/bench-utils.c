@@ -0,0 +1,102 @@
+#include "bench-utils.h"
+
+#include <stdio.h>
+#include <time.h>
+
+bool benchGpuCreateAdapter(struct BenchGpu * gpu) {
+	*gpu = (struct BenchGpu) {};
+	WGPUInstanceDescriptor desc = (WGPUInstanceDescriptor) {};
+	desc.nextInChain = NULL;
+	gpu->instance = wgpuCreateInstance(&desc);
+	if (!gpu->instance) {
+		fprintf(stderr, "Could not initialize WebGPU\n");
+		return false;
+	}
+
+	WGPURequestAdapterOptions adapterOpts = (WGPURequestAdapterOptions) {};
+	adapterOpts.nextInChain = NULL;
+	adapterOpts.compatibleSurface = NULL;
+	gpu->adapter = requestAdapter(gpu->instance, &adapterOpts);
+	if (!gpu->adapter) {
+		benchGpuRelease(gpu);
+		return false;
+	}
+	return true;
+}
+
+bool benchGpuCreate(struct BenchGpu * gpu, enum DeviceProfile profile) {
+	if (!benchGpuCreateAdapter(gpu)) return false;
+	gpu->device = createDeviceWithProfile(gpu->adapter, profile, "Bench device");
+	if (!gpu->device) {
+		benchGpuRelease(gpu);
+		return false;
+	}
+	gpu->queue = wgpuDeviceGetQueue(gpu->device);
+	return true;
+}
+
+bool benchGpuCreateWithMaxLimits(struct BenchGpu * gpu) {
+	if (!benchGpuCreateAdapter(gpu)) return false;
+	WGPUSupportedLimits adapterLimits = (WGPUSupportedLimits) {};
+	adapterLimits.nextInChain = NULL;
+	wgpuAdapterGetLimits(gpu->adapter, &adapterLimits);
+	WGPURequiredLimits requiredLimits = (WGPURequiredLimits) {};
+	requiredLimits.nextInChain = NULL;
+	requiredLimits.limits = adapterLimits.limits;
+
+	WGPUDeviceDescriptor deviceDesc = (WGPUDeviceDescriptor) {};
+	deviceDesc.nextInChain = NULL;
+	deviceDesc.label = "Bench device";
+	deviceDesc.requiredFeaturesCount = 0;
+	deviceDesc.requiredLimits = &requiredLimits;
+	deviceDesc.defaultQueue.nextInChain = NULL;
+	deviceDesc.defaultQueue.label = "The default queue";
+#ifdef WEBGPU_BACKEND_DAWN
+	WGPUDawnTogglesDescriptor toggles;
+	chainDeviceProfileToggles(&deviceDesc, DeviceProfile_Production, &toggles);
+#endif
+	gpu->device = requestDevice(gpu->adapter, &deviceDesc);
+	if (!gpu->device) {
+		benchGpuRelease(gpu);
+		return false;
+	}
+	gpu->queue = wgpuDeviceGetQueue(gpu->device);
+	return true;
+}
+
+void benchGpuRelease(struct BenchGpu * gpu) {
+	if (gpu->queue) wgpuQueueRelease(gpu->queue);
+	if (gpu->device) wgpuDeviceRelease(gpu->device);
+	if (gpu->adapter) wgpuAdapterRelease(gpu->adapter);
+	if (gpu->instance) wgpuInstanceRelease(gpu->instance);
+	*gpu = (struct BenchGpu) {};
+}
+
+double benchNow(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+void benchTick(WGPUDevice device) {
+#ifdef WEBGPU_BACKEND_DAWN
+	wgpuDeviceTick(device);
+#else
+	(void)device;
+#endif
+}
+
+void benchCountWorkDone(WGPUQueueWorkDoneStatus status, void * pUserData) {
+	(void)status;
+	++*(uint64_t *)pUserData;
+}
+
+void benchWaitForQueue(WGPUDevice device, WGPUQueue queue) {
+	uint64_t done = 0;
+	// An empty submit flushes writeBuffer and writeTexture
+	wgpuQueueSubmit(queue, 0, NULL);
+	wgpuQueueOnSubmittedWorkDone(queue, 0, benchCountWorkDone, &done);
+	while (done == 0) {
+		benchTick(device);
+	}
+}
@@ -0,0 +1,83 @@
+/**
+ * Helpers shared by the benchmarks: wall-clock time, the instance, adapter
+ * and device they run on, and waiting for the GPU.
+ *
+ * Typical use:
+ *     struct BenchGpu gpu;
+ *     if (!benchGpuCreate(&gpu, DeviceProfile_Production)) return 1;
+ *     double start = benchNow();
+ *     // encode and submit work
+ *     benchWaitForQueue(gpu.device, gpu.queue);
+ *     printf("%.3f ms\n", (benchNow() - start) * 1e3);
+ *     benchGpuRelease(&gpu);
+ */
+
+#ifndef _bench_utils_h_
+#define _bench_utils_h_
+
+#include <webgpu/webgpu.h>
+#include "device-creation.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct BenchGpu {
+	WGPUInstance instance;
+	WGPUAdapter adapter;
+	// NULL when created with benchGpuCreateAdapter
+	WGPUDevice device;
+	WGPUQueue queue;
+};
+
+/**
+ * Create an instance and request an adapter, without a surface, for
+ * benchmarks creating their devices themselves. Returns false if there is
+ * no adapter.
+ */
+bool benchGpuCreateAdapter(struct BenchGpu * gpu);
+
+/**
+ * Same, plus a device configured for `profile` and its queue.
+ */
+bool benchGpuCreate(struct BenchGpu * gpu, enum DeviceProfile profile);
+
+/**
+ * Same, with a production device requesting every limit of the adapter,
+ * for benchmarks binding more than the default 128 MB of storage.
+ */
+bool benchGpuCreateWithMaxLimits(struct BenchGpu * gpu);
+
+void benchGpuRelease(struct BenchGpu * gpu);
+
+/**
+ * Wall-clock time in seconds.
+ */
+double benchNow(void);
+
+/**
+ * Fire the callbacks of `device` that are ready, on backends that need to
+ * be asked to.
+ */
+void benchTick(WGPUDevice device);
+
+/**
+ * wgpuQueueOnSubmittedWorkDone callback incrementing the uint64_t that
+ * `pUserData` points to, for benchmarks keeping frames in flight.
+ */
+void benchCountWorkDone(WGPUQueueWorkDoneStatus status, void * pUserData);
+
+/**
+ * Flush `queue`, including pending writes, and block until all the work
+ * submitted to it is done.
+ */
+void benchWaitForQueue(WGPUDevice device, WGPUQueue queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _bench_utils_h_
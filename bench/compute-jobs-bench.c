@@ -0,0 +1,96 @@
+/**
+ * Measure the throughput of small compute jobs (see compute-jobs.h): each
+ * job squares a few floats and reads them back.
+ *
+ * Usage: ComputeJobsBench [jobCount] [floatsPerJob]
+ */
+
+#include <webgpu/webgpu.h>
+#include "bench-utils.h"
+#include "compute-jobs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char* squareSource = "\
+@group(0) @binding(0) var<storage, read> input: array<f32>;\n\
+@group(0) @binding(1) var<storage, read_write> output: array<f32>;\n\
+\n\
+@compute @workgroup_size(64)\n\
+fn main(@builtin(global_invocation_id) id: vec3u) {\n\
+    if (id.x >= arrayLength(&output)) { return; }\n\
+    output[id.x] = input[id.x] * input[id.x];\n\
+}\n\
+";
+
+struct BenchState {
+	uint32_t floatsPerJob;
+	uint32_t completed;
+	uint32_t errors;
+};
+
+static void onJobDone(void * userData, void const * const * outputs, size_t const * outputSizes) {
+	struct BenchState * state = (struct BenchState *)userData;
+	float const * output = (float const *)outputs[0];
+	(void)outputSizes;
+	if (!output || output[state->floatsPerJob - 1] != (float)(state->floatsPerJob - 1) * (float)(state->floatsPerJob - 1)) {
+		state->errors++;
+	}
+	state->completed++;
+}
+
+int main(int argc, char** argv) {
+	uint32_t jobCount = argc > 1 ? (uint32_t)atoi(argv[1]) : 10000;
+	uint32_t floatsPerJob = argc > 2 ? (uint32_t)atoi(argv[2]) : 256;
+	if (jobCount == 0 || floatsPerJob == 0) {
+		fprintf(stderr, "Usage: %s [jobCount] [floatsPerJob]\n", argv[0]);
+		return 1;
+	}
+
+	struct BenchGpu gpu;
+	if (!benchGpuCreate(&gpu, DeviceProfile_Production)) return 1;
+	WGPUDevice device = gpu.device;
+
+	struct ComputeRunner * runner = computeRunnerCreate(device, NULL);
+	struct ComputeKernel * kernel = computeRunnerCreateKernel(runner, squareSource, "main", 1, 1, "Square");
+	if (!kernel) return 1;
+
+	float * input = (float *)malloc(floatsPerJob * sizeof(float));
+	for (uint32_t i = 0; i < floatsPerJob; ++i) input[i] = (float)i;
+	struct ComputeJobInput jobInput = { input, floatsPerJob * sizeof(float) };
+	size_t outputSize = floatsPerJob * sizeof(float);
+
+	struct BenchState state = { floatsPerJob, 0, 0 };
+	struct ComputeJobDesc job = (struct ComputeJobDesc) {};
+	job.kernel = kernel;
+	job.inputs = &jobInput;
+	job.outputSizes = &outputSize;
+	job.workgroupCountX = (floatsPerJob + 63) / 64;
+	job.workgroupCountY = 1;
+	job.workgroupCountZ = 1;
+	job.callback = onJobDone;
+	job.userData = &state;
+
+	// Warm up pools and bind group cache
+	for (uint32_t i = 0; i < 2 * COMPUTE_RUNNER_DEFAULT_MAX_BATCH; ++i) computeRunnerSubmit(runner, &job);
+	computeRunnerWait(runner);
+	uint32_t warmupBuffers = runner->storagePool.createdCount + runner->readbackPool.createdCount;
+	state.completed = 0;
+
+	double start = benchNow();
+	for (uint32_t i = 0; i < jobCount; ++i) {
+		computeRunnerSubmit(runner, &job);
+		if (i % 64 == 63) computeRunnerPoll(runner);
+	}
+	computeRunnerWait(runner);
+	double elapsed = benchNow() - start;
+
+	uint32_t createdBuffers = runner->storagePool.createdCount + runner->readbackPool.createdCount - warmupBuffers;
+	printf("%u jobs of %u floats in %.3f s: %.0f jobs/s (%u errors, %u buffers created after warm-up)\n",
+		state.completed, floatsPerJob, elapsed, state.completed / elapsed, state.errors, createdBuffers);
+
+	free(input);
+	computeRunnerRelease(runner);
+	benchGpuRelease(&gpu);
+	return state.errors == 0 ? 0 : 1;
+}
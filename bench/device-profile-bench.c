@@ -0,0 +1,183 @@
+/**
+ * Measure the CPU cost of encoding draws and of submitting command buffers
+ * for each device validation profile (see device-creation.h).
+ *
+ * Usage: DeviceProfileBench [drawsPerPass] [submitCount]
+ */
+
+#include <webgpu/webgpu.h>
+#include "bench-utils.h"
+#include "device-creation.h"
+#include "webgpu-utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ITERATIONS 20
+#define WARMUP_ITERATIONS 3
+
+static const char* shaderSource = "\
+@vertex\n\
+fn vs_main(@builtin(vertex_index) in_vertex_index: u32) -> @builtin(position) vec4f {\n\
+    let p = vec2f(f32(in_vertex_index & 1u), f32(in_vertex_index >> 1u)) - 0.5;\n\
+    return vec4f(p, 0.0, 1.0);\n\
+}\n\
+\n\
+@fragment\n\
+fn fs_main() -> @location(0) vec4f {\n\
+    return vec4f(0.0, 0.4, 1.0, 1.0);\n\
+}\n\
+";
+
+static WGPURenderPipeline createPipeline(WGPUDevice device, WGPUTextureFormat format) {
+	WGPUShaderModule shaderModule = createWGSLShaderModule(device, shaderSource, "Bench shader");
+
+	WGPURenderPipelineDescriptor pipelineDesc = (WGPURenderPipelineDescriptor) {};
+	pipelineDesc.vertex.module = shaderModule;
+	pipelineDesc.vertex.entryPoint = "vs_main";
+	pipelineDesc.primitive.topology = WGPUPrimitiveTopology_TriangleList;
+	pipelineDesc.primitive.stripIndexFormat = WGPUIndexFormat_Undefined;
+	pipelineDesc.primitive.frontFace = WGPUFrontFace_CCW;
+	pipelineDesc.primitive.cullMode = WGPUCullMode_None;
+
+	WGPUColorTargetState colorTarget = (WGPUColorTargetState) {};
+	colorTarget.format = format;
+	colorTarget.blend = NULL;
+	colorTarget.writeMask = WGPUColorWriteMask_All;
+	WGPUFragmentState fragmentState = (WGPUFragmentState) {};
+	fragmentState.module = shaderModule;
+	fragmentState.entryPoint = "fs_main";
+	fragmentState.targetCount = 1;
+	fragmentState.targets = &colorTarget;
+	pipelineDesc.fragment = &fragmentState;
+
+	pipelineDesc.multisample.count = 1;
+	pipelineDesc.multisample.mask = ~0u;
+	pipelineDesc.layout = NULL;
+
+	WGPURenderPipeline pipeline = wgpuDeviceCreateRenderPipeline(device, &pipelineDesc);
+	wgpuShaderModuleRelease(shaderModule);
+	return pipeline;
+}
+
+static WGPURenderPassEncoder beginPass(WGPUCommandEncoder encoder, WGPUTextureView target) {
+	WGPURenderPassColorAttachment colorAttachment = (WGPURenderPassColorAttachment) {};
+	colorAttachment.view = target;
+	colorAttachment.resolveTarget = NULL;
+	colorAttachment.loadOp = WGPULoadOp_Clear;
+	colorAttachment.storeOp = WGPUStoreOp_Store;
+	colorAttachment.clearValue = (WGPUColor) { 0.0, 0.0, 0.0, 1.0 };
+
+	WGPURenderPassDescriptor renderPassDesc = (WGPURenderPassDescriptor) {};
+	renderPassDesc.colorAttachmentCount = 1;
+	renderPassDesc.colorAttachments = &colorAttachment;
+	renderPassDesc.depthStencilAttachment = NULL;
+	renderPassDesc.timestampWriteCount = 0;
+	renderPassDesc.timestampWrites = NULL;
+	return wgpuCommandEncoderBeginRenderPass(encoder, &renderPassDesc);
+}
+
+/**
+ * Returns the average CPU time, in nanoseconds, to encode, finish and
+ * submit one draw call.
+ */
+static double benchDraws(WGPUDevice device, WGPUQueue queue, WGPURenderPipeline pipeline, WGPUTextureView target, uint32_t drawCount) {
+	double total = 0.0;
+	for (int it = 0; it < WARMUP_ITERATIONS + ITERATIONS; ++it) {
+		double start = benchNow();
+		WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, NULL);
+		WGPURenderPassEncoder renderPass = beginPass(encoder, target);
+		wgpuRenderPassEncoderSetPipeline(renderPass, pipeline);
+		for (uint32_t i = 0; i < drawCount; ++i) {
+			wgpuRenderPassEncoderDraw(renderPass, 3, 1, 0, 0);
+		}
+		wgpuRenderPassEncoderEnd(renderPass);
+		WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, NULL);
+		wgpuQueueSubmit(queue, 1, &command);
+		double elapsed = benchNow() - start;
+
+		wgpuCommandBufferRelease(command);
+		wgpuRenderPassEncoderRelease(renderPass);
+		wgpuCommandEncoderRelease(encoder);
+		benchWaitForQueue(device, queue);
+		if (it >= WARMUP_ITERATIONS) total += elapsed;
+	}
+	return total / ITERATIONS / drawCount * 1e9;
+}
+
+/**
+ * Returns the average CPU time, in nanoseconds, to encode, finish and
+ * submit a command buffer containing a single render pass with one draw.
+ */
+static double benchSubmits(WGPUDevice device, WGPUQueue queue, WGPURenderPipeline pipeline, WGPUTextureView target, uint32_t submitCount) {
+	double total = 0.0;
+	for (int it = 0; it < WARMUP_ITERATIONS + ITERATIONS; ++it) {
+		double start = benchNow();
+		for (uint32_t i = 0; i < submitCount; ++i) {
+			WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, NULL);
+			WGPURenderPassEncoder renderPass = beginPass(encoder, target);
+			wgpuRenderPassEncoderSetPipeline(renderPass, pipeline);
+			wgpuRenderPassEncoderDraw(renderPass, 3, 1, 0, 0);
+			wgpuRenderPassEncoderEnd(renderPass);
+			WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, NULL);
+			wgpuQueueSubmit(queue, 1, &command);
+			wgpuCommandBufferRelease(command);
+			wgpuRenderPassEncoderRelease(renderPass);
+			wgpuCommandEncoderRelease(encoder);
+		}
+		double elapsed = benchNow() - start;
+		benchWaitForQueue(device, queue);
+		if (it >= WARMUP_ITERATIONS) total += elapsed;
+	}
+	return total / ITERATIONS / submitCount * 1e9;
+}
+
+int main(int argc, char** argv) {
+	uint32_t drawsPerPass = argc > 1 ? (uint32_t)atoi(argv[1]) : 10000;
+	uint32_t submitCount = argc > 2 ? (uint32_t)atoi(argv[2]) : 200;
+	if (drawsPerPass == 0 || submitCount == 0) {
+		fprintf(stderr, "Usage: %s [drawsPerPass] [submitCount]\n", argv[0]);
+		return 1;
+	}
+
+	// Each profile gets its own device on the same adapter
+	struct BenchGpu gpu;
+	if (!benchGpuCreateAdapter(&gpu)) return 1;
+
+	printf("%-12s %16s %16s\n", "profile", "ns/draw", "ns/submit");
+	for (int p = 0; p < DeviceProfile_Count; ++p) {
+		enum DeviceProfile profile = (enum DeviceProfile)p;
+		WGPUDevice device = createDeviceWithProfile(gpu.adapter, profile, "Bench device");
+		if (!device) return 1;
+		WGPUQueue queue = wgpuDeviceGetQueue(device);
+
+		WGPUTextureFormat format = WGPUTextureFormat_RGBA8Unorm;
+		WGPUTextureDescriptor textureDesc = (WGPUTextureDescriptor) {};
+		textureDesc.label = "Bench target";
+		textureDesc.usage = WGPUTextureUsage_RenderAttachment;
+		textureDesc.dimension = WGPUTextureDimension_2D;
+		textureDesc.size = (WGPUExtent3D) { 256, 256, 1 };
+		textureDesc.format = format;
+		textureDesc.mipLevelCount = 1;
+		textureDesc.sampleCount = 1;
+		textureDesc.viewFormatCount = 0;
+		textureDesc.viewFormats = NULL;
+		WGPUTexture target = wgpuDeviceCreateTexture(device, &textureDesc);
+		WGPUTextureView targetView = wgpuTextureCreateView(target, NULL);
+		WGPURenderPipeline pipeline = createPipeline(device, format);
+
+		double drawCost = benchDraws(device, queue, pipeline, targetView, drawsPerPass);
+		double submitCost = benchSubmits(device, queue, pipeline, targetView, submitCount);
+		printf("%-12s %16.1f %16.1f\n", deviceProfileName(profile), drawCost, submitCost);
+
+		wgpuRenderPipelineRelease(pipeline);
+		wgpuTextureViewRelease(targetView);
+		wgpuTextureDestroy(target);
+		wgpuTextureRelease(target);
+		wgpuQueueRelease(queue);
+		wgpuDeviceRelease(device);
+	}
+
+	benchGpuRelease(&gpu);
+	return 0;
+}
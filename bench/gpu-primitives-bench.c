@@ -0,0 +1,239 @@
+/**
+ * Measure the throughput of the GPU primitives (see gpu-primitives.h) on
+ * arrays of 1K to 100M u32 elements, in elements per second. Each timing
+ * covers encoding, submitting and waiting for a single operation. Results
+ * of arrays up to 1M elements are checked against the CPU.
+ *
+ * Usage: GpuPrimitivesBench [maxCount]
+ */
+
+#include <webgpu/webgpu.h>
+#include "bench-utils.h"
+#include "gpu-primitives.h"
+#include "webgpu-utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ITERATIONS 5
+#define VERIFY_MAX_COUNT 1000000
+
+static void onMapped(WGPUBufferMapAsyncStatus status, void * pUserData) {
+	*(int *)pUserData = status == WGPUBufferMapAsyncStatus_Success ? 1 : -1;
+}
+
+/**
+ * Read `size` bytes of `buffer` back into a malloc'd array.
+ */
+static uint32_t * readBack(WGPUDevice device, WGPUQueue queue, WGPUBuffer buffer, uint64_t size) {
+	WGPUBuffer staging = createBuffer(device, size, WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst, "Bench readback");
+	WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, NULL);
+	wgpuCommandEncoderCopyBufferToBuffer(encoder, buffer, 0, staging, 0, size);
+	WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, NULL);
+	wgpuQueueSubmit(queue, 1, &command);
+	wgpuCommandBufferRelease(command);
+	wgpuCommandEncoderRelease(encoder);
+
+	int mapped = 0;
+	wgpuBufferMapAsync(staging, WGPUMapMode_Read, 0, size, onMapped, &mapped);
+	while (mapped == 0) {
+#ifdef WEBGPU_BACKEND_DAWN
+		wgpuDeviceTick(device);
+#endif
+	}
+	uint32_t * data = NULL;
+	if (mapped > 0) {
+		data = (uint32_t *)malloc(size);
+		memcpy(data, wgpuBufferGetConstMappedRange(staging, 0, size), size);
+		wgpuBufferUnmap(staging);
+	}
+	wgpuBufferRelease(staging);
+	return data;
+}
+
+enum Operation {
+	Operation_Scan,
+	Operation_Reduce,
+	Operation_Compact,
+	Operation_Sort,
+	Operation_Count,
+};
+
+static char const * operationNames[Operation_Count] = { "scan", "reduce", "compact", "sort" };
+
+struct BenchBuffers {
+	WGPUBuffer input; // random keys
+	WGPUBuffer flags;
+	WGPUBuffer values;
+	WGPUBuffer output;
+	WGPUBuffer sortKeys;
+	WGPUBuffer sortValues;
+	WGPUBuffer result;
+};
+
+static void encodeOperation(struct GpuPrimitivesContext * context, WGPUCommandEncoder encoder, struct BenchBuffers const * b, enum Operation op, uint32_t count) {
+	switch (op) {
+	case Operation_Scan:
+		gpuPrimitivesEncodeScan(context, encoder, b->flags, b->output, count);
+		break;
+	case Operation_Reduce:
+		gpuPrimitivesEncodeReduce(context, encoder, b->flags, count, b->result, 0);
+		break;
+	case Operation_Compact:
+		gpuPrimitivesEncodeCompact(context, encoder, b->values, b->flags, count, b->output, b->result, 0);
+		break;
+	case Operation_Sort:
+		// Restore the unsorted keys first, so that each iteration sorts
+		// the same data. The copy is part of the timing.
+		wgpuCommandEncoderCopyBufferToBuffer(encoder, b->input, 0, b->sortKeys, 0, (uint64_t)count * sizeof(uint32_t));
+		wgpuCommandEncoderCopyBufferToBuffer(encoder, b->values, 0, b->sortValues, 0, (uint64_t)count * sizeof(uint32_t));
+		gpuPrimitivesEncodeSort(context, encoder, b->sortKeys, b->sortValues, count, 32);
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * Compare the outcome of `op` with the CPU. Returns true if it matches.
+ */
+static bool verify(WGPUDevice device, WGPUQueue queue, struct BenchBuffers const * b, enum Operation op, uint32_t count, uint32_t const * keys) {
+	uint64_t size = (uint64_t)count * sizeof(uint32_t);
+	bool ok = true;
+	uint32_t flagCount = count / 3 + (count % 3 != 0); // flags are set on multiples of 3
+	if (op == Operation_Scan) {
+		uint32_t * scanned = readBack(device, queue, b->output, size);
+		for (uint32_t i = 0; scanned && i < count && ok; ++i) {
+			ok = scanned[i] == i / 3 + (i % 3 != 0);
+		}
+		ok = ok && scanned;
+		free(scanned);
+	} else if (op == Operation_Reduce || op == Operation_Compact) {
+		uint32_t * result = readBack(device, queue, b->result, sizeof(uint32_t));
+		ok = result && result[0] == flagCount;
+		free(result);
+		if (ok && op == Operation_Compact) {
+			uint32_t * compacted = readBack(device, queue, b->output, (uint64_t)flagCount * sizeof(uint32_t));
+			for (uint32_t i = 0; compacted && i < flagCount && ok; ++i) {
+				ok = compacted[i] == 3 * i;
+			}
+			ok = ok && compacted;
+			free(compacted);
+		}
+	} else if (op == Operation_Sort) {
+		uint32_t * sorted = readBack(device, queue, b->sortKeys, size);
+		uint32_t * permutation = readBack(device, queue, b->sortValues, size);
+		for (uint32_t i = 0; sorted && permutation && i < count && ok; ++i) {
+			ok = (i == 0 || sorted[i - 1] <= sorted[i]) && keys[permutation[i]] == sorted[i];
+		}
+		ok = ok && sorted && permutation;
+		free(sorted);
+		free(permutation);
+	}
+	return ok;
+}
+
+int main(int argc, char** argv) {
+	uint32_t maxCount = argc > 1 ? (uint32_t)atoi(argv[1]) : 100000000;
+	if (maxCount == 0) {
+		fprintf(stderr, "Usage: %s [maxCount]\n", argv[0]);
+		return 1;
+	}
+
+	// Large arrays need more than the default 128 MB storage bindings
+	struct BenchGpu gpu;
+	if (!benchGpuCreateWithMaxLimits(&gpu)) return 1;
+	WGPUDevice device = gpu.device;
+	WGPUQueue queue = gpu.queue;
+
+	WGPUSupportedLimits deviceLimits = (WGPUSupportedLimits) {};
+	deviceLimits.nextInChain = NULL;
+	wgpuDeviceGetLimits(device, &deviceLimits);
+	uint64_t maxBinding = deviceLimits.limits.maxStorageBufferBindingSize;
+	if (deviceLimits.limits.maxBufferSize < maxBinding) maxBinding = deviceLimits.limits.maxBufferSize;
+	if ((uint64_t)maxCount * sizeof(uint32_t) > maxBinding) {
+		maxCount = (uint32_t)(maxBinding / sizeof(uint32_t));
+	}
+
+	// Inputs: random keys, a flag on every third element, values 0..n-1
+	uint32_t * keys = (uint32_t *)malloc((size_t)maxCount * sizeof(uint32_t));
+	uint32_t * flags = (uint32_t *)malloc((size_t)maxCount * sizeof(uint32_t));
+	uint32_t * values = (uint32_t *)malloc((size_t)maxCount * sizeof(uint32_t));
+	uint32_t state = 0x9e3779b9u;
+	for (uint32_t i = 0; i < maxCount; ++i) {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		keys[i] = state;
+		flags[i] = i % 3 == 0;
+		values[i] = i;
+	}
+
+	uint64_t size = (uint64_t)maxCount * sizeof(uint32_t);
+	WGPUBufferUsageFlags usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopySrc | WGPUBufferUsage_CopyDst;
+	struct BenchBuffers b;
+	b.input = createBuffer(device, size, usage, "Bench keys");
+	b.flags = createBuffer(device, size, usage, "Bench flags");
+	b.values = createBuffer(device, size, usage, "Bench values");
+	b.output = createBuffer(device, size, usage, "Bench output");
+	b.sortKeys = createBuffer(device, size, usage, "Bench sort keys");
+	b.sortValues = createBuffer(device, size, usage, "Bench sort values");
+	b.result = createBuffer(device, sizeof(uint32_t), usage, "Bench result");
+	wgpuQueueWriteBuffer(queue, b.input, 0, keys, size);
+	wgpuQueueWriteBuffer(queue, b.flags, 0, flags, size);
+	wgpuQueueWriteBuffer(queue, b.values, 0, values, size);
+
+	struct GpuPrimitives * primitives = gpuPrimitivesCreate(device);
+	struct GpuPrimitivesContext * context = gpuPrimitivesContextCreate(primitives, maxCount);
+
+	printf("%-12s", "elements");
+	for (int op = 0; op < Operation_Count; ++op) printf(" %14s", operationNames[op]);
+	printf("   (Melements/s)\n");
+
+	bool allOk = true;
+	uint32_t const counts[] = { 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+	for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+		uint32_t count = counts[c];
+		if (count > maxCount) {
+			printf("%-12u skipped (beyond device buffer limits or maxCount)\n", count);
+			continue;
+		}
+		printf("%-12u", count);
+		for (int op = 0; op < Operation_Count; ++op) {
+			double total = 0.0;
+			for (int it = 0; it < ITERATIONS + 1; ++it) {
+				double start = benchNow();
+				WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, NULL);
+				encodeOperation(context, encoder, &b, (enum Operation)op, count);
+				WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, NULL);
+				wgpuQueueSubmit(queue, 1, &command);
+				benchWaitForQueue(device, queue);
+				double elapsed = benchNow() - start;
+				wgpuCommandBufferRelease(command);
+				wgpuCommandEncoderRelease(encoder);
+				if (it > 0) total += elapsed; // first iteration is warm-up
+			}
+			bool ok = count > VERIFY_MAX_COUNT || verify(device, queue, &b, (enum Operation)op, count, keys);
+			allOk = allOk && ok;
+			printf(" %13.1f%s", count / (total / ITERATIONS) * 1e-6, ok ? " " : "!");
+		}
+		printf("\n");
+	}
+	if (!allOk) printf("! marks results that do not match the CPU\n");
+
+	gpuPrimitivesContextRelease(context);
+	gpuPrimitivesRelease(primitives);
+	wgpuBufferRelease(b.result);
+	wgpuBufferRelease(b.sortValues);
+	wgpuBufferRelease(b.sortKeys);
+	wgpuBufferRelease(b.output);
+	wgpuBufferRelease(b.values);
+	wgpuBufferRelease(b.flags);
+	wgpuBufferRelease(b.input);
+	free(values);
+	free(flags);
+	free(keys);
+	benchGpuRelease(&gpu);
+	return allOk ? 0 : 1;
+}
@@ -0,0 +1,92 @@
+/**
+ * Compare, for each environment map, the time to bake its image-based
+ * lighting (see ibl-baker.h) on the GPU with the time to load it from its
+ * cache, and the same for the BRDF LUT. Caches are written to the working
+ * directory and removed afterwards. Environments are the ones of the
+ * tutorial by default.
+ *
+ * Usage: IblBakerBench [path...]
+ */
+
+#include <webgpu/webgpu.h>
+#include "bench-utils.h"
+#include "ibl-baker.h"
+#include "jpeg-decoder.h"
+#include "mapped-file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static char const * const defaultEnvironments[] = {
+	TUTORIAL_DOWNLOADS_DIR "/56f71f3c8d42e16a26b651e739608565/autumn_park_4k.jpg",
+};
+
+int main(int argc, char** argv) {
+	char const * const * paths = argc > 1 ? (char const * const *)(argv + 1) : defaultEnvironments;
+	int pathCount = argc > 1 ? argc - 1 : (int)(sizeof(defaultEnvironments) / sizeof(defaultEnvironments[0]));
+
+	struct BenchGpu gpu;
+	if (!benchGpuCreate(&gpu, DeviceProfile_Production)) return 1;
+	WGPUDevice device = gpu.device;
+	WGPUQueue queue = gpu.queue;
+
+	// BRDF LUT: baked by the first baker, loaded by the second
+	remove("./" IBL_BRDF_LUT_CACHE_NAME);
+	double start = benchNow();
+	struct IblBaker * baker = iblBakerCreate(device, ".");
+	double bakeTime = benchNow() - start;
+	if (!baker) return 1;
+	iblBakerRelease(baker);
+	start = benchNow();
+	baker = iblBakerCreate(device, ".");
+	benchWaitForQueue(device, queue);
+	double loadTime = benchNow() - start;
+	if (!baker) return 1;
+	printf("BRDF LUT (%dx%d): bake %.1f ms, cached %.1f ms\n", IBL_BRDF_LUT_SIZE, IBL_BRDF_LUT_SIZE, bakeTime * 1e3, loadTime * 1e3);
+
+	for (int i = 0; i < pathCount; ++i) {
+		struct MappedFile * file = mappedFileOpen(paths[i]);
+		uint32_t width, height;
+		start = benchNow();
+		uint8_t * pixels = file && file->data ? jpegDecode(file->data, file->size, &width, &height) : NULL;
+		double decodeTime = benchNow() - start;
+		mappedFileClose(file);
+		if (!pixels) {
+			fprintf(stderr, "Could not load %s\n", paths[i]);
+			return 1;
+		}
+
+		struct IblEnvironment environment;
+		start = benchNow();
+		bool ok = iblBakerBake(baker, pixels, width, height, true, &environment);
+		bakeTime = benchNow() - start;
+		free(pixels);
+		iblEnvironmentRelease(&environment);
+
+		// First load bakes and writes the cache, the second one reads it
+		start = benchNow();
+		ok = ok && iblBakerLoad(baker, paths[i], &environment);
+		double firstLoadTime = benchNow() - start;
+		iblEnvironmentRelease(&environment);
+		start = benchNow();
+		ok = ok && iblBakerLoad(baker, paths[i], &environment);
+		benchWaitForQueue(device, queue);
+		loadTime = benchNow() - start;
+		if (!ok) return 1;
+
+		printf("%s (%ux%u)\n", paths[i], width, height);
+		printf("  decode %.1f ms, bake %.1f ms, first load %.1f ms, cached load %.1f ms (%s)\n",
+			decodeTime * 1e3, bakeTime * 1e3, firstLoadTime * 1e3, loadTime * 1e3, environment.baked ? "baked" : "from cache");
+		printf("  average diffuse radiance %.3f %.3f %.3f\n", environment.irradiance[0][0], environment.irradiance[0][1], environment.irradiance[0][2]);
+
+		char cachePath[64];
+		snprintf(cachePath, sizeof(cachePath), "./%016llx" IBL_CACHE_EXTENSION, (unsigned long long)environment.sourceHash);
+		iblEnvironmentRelease(&environment);
+		remove(cachePath);
+	}
+
+	remove("./" IBL_BRDF_LUT_CACHE_NAME);
+	iblBakerRelease(baker);
+	benchGpuRelease(&gpu);
+	return 0;
+}
@@ -0,0 +1,104 @@
+/**
+ * Measure the throughput of the image filter pipeline (see image-filters.h)
+ * on batches of synthetic RGBA8 images, in images and megapixels per
+ * second, for a single blur, a fused blur + Sobel chain and a chain long
+ * enough to need several stages.
+ *
+ * Usage: ImageFiltersBench [imageCount] [size]
+ */
+
+#include <webgpu/webgpu.h>
+#include "bench-utils.h"
+#include "image-filters.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+struct BatchResult {
+	uint32_t received;
+	uint32_t failed;
+	uint64_t checksum;
+};
+
+static void onFiltered(void * userData, uint32_t imageIndex, uint8_t const * pixels, uint32_t width, uint32_t height, uint32_t bytesPerRow) {
+	(void)imageIndex;
+	struct BatchResult * result = (struct BatchResult *)userData;
+	++result->received;
+	if (!pixels) {
+		++result->failed;
+		return;
+	}
+	// Touch the result as a real consumer would
+	result->checksum += pixels[(height / 2) * bytesPerRow + (width / 2) * 4];
+}
+
+int main(int argc, char** argv) {
+	uint32_t imageCount = argc > 1 ? (uint32_t)atoi(argv[1]) : 64;
+	uint32_t size = argc > 2 ? (uint32_t)atoi(argv[2]) : 1024;
+	if (imageCount == 0 || size == 0) {
+		fprintf(stderr, "Usage: %s [imageCount] [size]\n", argv[0]);
+		return 1;
+	}
+
+	struct BenchGpu gpu;
+	if (!benchGpuCreate(&gpu, DeviceProfile_Production)) return 1;
+	WGPUDevice device = gpu.device;
+
+	// A few distinct images so that uploads are not trivially cached
+	const uint32_t distinctImages = 4;
+	uint8_t * pixels = (uint8_t *)malloc((size_t)distinctImages * size * size * 4);
+	uint32_t state = 0x9e3779b9u;
+	for (size_t i = 0; i < (size_t)distinctImages * size * size * 4; ++i) {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		pixels[i] = (uint8_t)state;
+	}
+	struct ImageFilterImage * images = (struct ImageFilterImage *)malloc(imageCount * sizeof(struct ImageFilterImage));
+	for (uint32_t i = 0; i < imageCount; ++i) {
+		images[i].width = size;
+		images[i].height = size;
+		images[i].pixels = pixels + (size_t)(i % distinctImages) * size * size * 4;
+	}
+
+	struct ImageFilter blur[] = { imageFilterGaussian(2.0f) };
+	struct ImageFilter edges[] = { imageFilterGrayscale(), imageFilterGaussian(1.5f), imageFilterSobelX(), imageFilterAbs(), imageFilterScaleBias(4.0f, 0.0f) };
+	struct ImageFilter longChain[] = { imageFilterGaussian(2.5f), imageFilterGaussian(2.5f), imageFilterBox(4), imageFilterSobelY(), imageFilterAbs() };
+	struct {
+		char const * name;
+		struct ImageFilter const * filters;
+		uint32_t count;
+	} chains[] = {
+		{ "gaussian", blur, sizeof(blur) / sizeof(blur[0]) },
+		{ "fused edges", edges, sizeof(edges) / sizeof(edges[0]) },
+		{ "long chain", longChain, sizeof(longChain) / sizeof(longChain[0]) },
+	};
+
+	printf("%u images of %ux%u\n", imageCount, size, size);
+	printf("%-12s %7s %12s %12s\n", "chain", "stages", "images/s", "MPixel/s");
+	bool allOk = true;
+	for (size_t c = 0; c < sizeof(chains) / sizeof(chains[0]); ++c) {
+		struct ImageFilterPipeline * pipeline = imageFilterPipelineCreate(device, chains[c].filters, chains[c].count);
+		if (!pipeline) return 1;
+
+		// Warm-up: creates the slot resources and pipelines
+		struct BatchResult warmUp = { 0, 0, 0 };
+		imageFilterPipelineProcessBatch(pipeline, images, imageCount < 4 ? imageCount : 4, onFiltered, &warmUp);
+
+		struct BatchResult result = { 0, 0, 0 };
+		double start = benchNow();
+		bool ok = imageFilterPipelineProcessBatch(pipeline, images, imageCount, onFiltered, &result);
+		double elapsed = benchNow() - start;
+
+		ok = ok && result.received == imageCount && result.failed == 0;
+		allOk = allOk && ok;
+		printf("%-12s %7u %12.1f %12.1f%s\n", chains[c].name, pipeline->stageCount, imageCount / elapsed, (double)imageCount * size * size / elapsed * 1e-6, ok ? "" : " !");
+		imageFilterPipelineRelease(pipeline);
+	}
+	if (!allOk) printf("! marks batches where some images could not be read back\n");
+
+	free(images);
+	free(pixels);
+	benchGpuRelease(&gpu);
+	return allOk ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+/**
+ * Report the levels of detail built for OBJ meshes (see mesh-lod.h): the
+ * triangles and error of each level and the time to build the chain, then
+ * the triangles drawn for a scene of many instances of the mesh spread in
+ * depth, at full resolution, with levels selected for an error of one
+ * pixel, and with a triangle budget. Meshes are the ones of the tutorial
+ * by default.
+ *
+ * Usage: MeshLodBench [path...]
+ */
+
+#include "bench-utils.h"
+#include "mesh-lod.h"
+#include "mesh-optimizer.h"
+#include "obj-loader.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Scene: instances at distances of 1 to 100 mesh diagonals, seen at 1080p
+#define INSTANCE_COUNT 10000
+#define MIN_DISTANCE 1.0f
+#define MAX_DISTANCE 100.0f
+#define FOV_Y 1.0471976f // 60 degrees
+#define VIEWPORT_HEIGHT 1080.0f
+#define PIXEL_ERROR 1.0f
+// Budget, as a fraction of the triangles at full resolution
+#define BUDGET_FRACTION 0.08
+
+static char const * const defaultMeshes[] = {
+	TUTORIAL_DOWNLOADS_DIR "/b029881ac5773fe32220cedfa2ed3397/suzanne.obj",
+	TUTORIAL_DOWNLOADS_DIR "/bc824d0b5d89c824c50c5cbe0bba5c19/quad-input.obj",
+	TUTORIAL_DOWNLOADS_DIR "/0e38411683f6c2ab2fc32cdba6c43686/pyramid.obj",
+	TUTORIAL_DOWNLOADS_DIR "/a807bbb5c9ad69e555e25d70b1fcf26e/cylinder.obj",
+};
+
+static uint32_t nextRandom(uint32_t * state) {
+	*state = *state * 1664525u + 1013904223u;
+	return *state >> 8;
+}
+
+static uint64_t countTriangles(struct MeshLodChain const * chain, uint32_t const * lods) {
+	uint64_t triangles = 0;
+	for (uint32_t i = 0; i < INSTANCE_COUNT; ++i) {
+		triangles += chain->lods[lods[i]].indexCount / 3;
+	}
+	return triangles;
+}
+
+int main(int argc, char** argv) {
+	char const * const * paths = argc > 1 ? (char const * const *)(argv + 1) : defaultMeshes;
+	int pathCount = argc > 1 ? argc - 1 : (int)(sizeof(defaultMeshes) / sizeof(defaultMeshes[0]));
+
+	struct MeshLodInstance * instances = (struct MeshLodInstance *)malloc(INSTANCE_COUNT * sizeof(struct MeshLodInstance));
+	uint32_t * lods = (uint32_t *)malloc(INSTANCE_COUNT * sizeof(uint32_t));
+	if (!instances || !lods) return 1;
+	float projectionScale = meshLodProjectionScale(FOV_Y, VIEWPORT_HEIGHT);
+
+	for (int i = 0; i < pathCount; ++i) {
+		struct ObjMesh * mesh = objMeshLoad(paths[i], 0);
+		if (!mesh) continue;
+		meshOptimize(mesh);
+		struct MeshLodChain chain;
+		double start = benchNow();
+		uint32_t * indices = meshLodBuild(mesh->indices, mesh->indexCount, mesh->vertices[0].position, sizeof(struct ObjVertex), mesh->vertexCount, &chain);
+		double elapsed = benchNow() - start;
+		if (!indices) return 1;
+
+		float diagonal = 0.0f;
+		for (uint32_t k = 0; k < 3; ++k) {
+			float extent = mesh->boundsMax[k] - mesh->boundsMin[k];
+			diagonal += extent * extent;
+		}
+		diagonal = sqrtf(diagonal);
+		char const * name = paths[i];
+		for (char const * c = paths[i]; *c; ++c) {
+			if (*c == '/' || *c == '\\') name = c + 1;
+		}
+		printf("%s: %u levels in %.2f ms\n", name, chain.lodCount, elapsed * 1e3);
+		printf("  %5s %10s %14s\n", "level", "triangles", "error");
+		for (uint32_t l = 0; l < chain.lodCount; ++l) {
+			printf("  %5u %10u %13.3f%%\n", l, chain.lods[l].indexCount / 3,
+				diagonal > 0.0f ? 100.0f * chain.lods[l].error / diagonal : 0.0f);
+		}
+
+		// Same scene for every mesh, in units of its diagonal
+		uint32_t seed = 1;
+		for (uint32_t j = 0; j < INSTANCE_COUNT; ++j) {
+			float t = (float)nextRandom(&seed) / (float)(1u << 24);
+			instances[j] = (struct MeshLodInstance) { &chain, diagonal * (MIN_DISTANCE + t * (MAX_DISTANCE - MIN_DISTANCE)), 1.0f };
+		}
+		uint64_t full = (uint64_t)INSTANCE_COUNT * (chain.lods[0].indexCount / 3);
+		meshLodSelectBudget(instances, INSTANCE_COUNT, projectionScale, PIXEL_ERROR, 0, lods);
+		uint64_t selected = countTriangles(&chain, lods);
+		uint64_t budget = (uint64_t)((double)full * BUDGET_FRACTION);
+		float budgetError = meshLodSelectBudget(instances, INSTANCE_COUNT, projectionScale, PIXEL_ERROR, budget, lods);
+		uint64_t budgeted = countTriangles(&chain, lods);
+		printf("  %u instances: %llu triangles at full resolution, %llu (%.1fx fewer) at %.1f px, %llu at %.2f px for a budget of %llu\n\n",
+			INSTANCE_COUNT, (unsigned long long)full,
+			(unsigned long long)selected, selected > 0 ? (double)full / (double)selected : 0.0, PIXEL_ERROR,
+			(unsigned long long)budgeted, budgetError, (unsigned long long)budget);
+
+		free(indices);
+		objMeshRelease(mesh);
+	}
+	free(instances);
+	free(lods);
+	return 0;
+}
@@ -0,0 +1,298 @@
+/**
+ * Measure what each stage of the mesh optimisation (see mesh-optimizer.h)
+ * gains on OBJ meshes, by default the ones of the tutorial: the modelled
+ * ACMR, ATVR and vertex overfetch, and the GPU time of a frame drawing
+ * enough instances of the mesh to reach about 2M triangles, each rotated
+ * differently, into a 1024x1024 target with a depth test. Stages are
+ * cumulative: file order, vertex cache, overdraw, vertex fetch, then
+ * 16-bit indices when the mesh has fewer than 65536 vertices.
+ *
+ * Usage: MeshOptimizerBench [path...]
+ */
+
+#include <webgpu/webgpu.h>
+#include "bench-utils.h"
+#include "mesh-optimizer.h"
+#include "webgpu-utils.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ITERATIONS 20
+#define WARMUP_ITERATIONS 3
+#define TARGET_SIZE 1024
+#define TRIANGLES_PER_FRAME 2000000
+#define DEPTH_FORMAT WGPUTextureFormat_Depth24Plus
+
+static char const * const defaultMeshes[] = {
+	TUTORIAL_DOWNLOADS_DIR "/b029881ac5773fe32220cedfa2ed3397/suzanne.obj",
+	TUTORIAL_DOWNLOADS_DIR "/bc824d0b5d89c824c50c5cbe0bba5c19/quad-input.obj",
+	TUTORIAL_DOWNLOADS_DIR "/0e38411683f6c2ab2fc32cdba6c43686/pyramid.obj",
+	TUTORIAL_DOWNLOADS_DIR "/a807bbb5c9ad69e555e25d70b1fcf26e/cylinder.obj",
+};
+
+// Positions are normalized to [-1, 1] by the bench, and the fragment
+// shader does a bit of work so that overdraw costs something
+static const char* shaderSource = "\
+struct VertexOutput {\n\
+    @builtin(position) position: vec4f,\n\
+    @location(0) normal: vec3f,\n\
+};\n\
+\n\
+@vertex\n\
+fn vs_main(@location(0) position: vec3f, @location(1) normal: vec3f, @builtin(instance_index) instance: u32) -> VertexOutput {\n\
+    let angle = f32(instance) * 2.39996;\n\
+    let c = cos(angle);\n\
+    let s = sin(angle);\n\
+    let p = vec3f(c * position.x + s * position.z, position.y, c * position.z - s * position.x);\n\
+    var out: VertexOutput;\n\
+    out.position = vec4f(0.9 * p.xy, 0.5 + 0.45 * p.z, 1.0);\n\
+    out.normal = vec3f(c * normal.x + s * normal.z, normal.y, c * normal.z - s * normal.x);\n\
+    return out;\n\
+}\n\
+\n\
+@fragment\n\
+fn fs_main(in: VertexOutput) -> @location(0) vec4f {\n\
+    let n = normalize(in.normal);\n\
+    let l = normalize(vec3f(0.3, 0.8, -0.5));\n\
+    let h = normalize(l + vec3f(0.0, 0.0, -1.0));\n\
+    let diffuse = max(dot(n, l), 0.0);\n\
+    let specular = pow(max(dot(n, h), 0.0), 32.0);\n\
+    return vec4f(vec3f(0.2 + 0.7 * diffuse + specular), 1.0);\n\
+}\n\
+";
+
+static WGPURenderPipeline createPipeline(WGPUDevice device, WGPUTextureFormat format) {
+	WGPUShaderModule shaderModule = createWGSLShaderModule(device, shaderSource, "Bench shader");
+
+	WGPUVertexAttribute attributes[2];
+	attributes[0] = (WGPUVertexAttribute) { WGPUVertexFormat_Float32x3, offsetof(struct ObjVertex, position), 0 };
+	attributes[1] = (WGPUVertexAttribute) { WGPUVertexFormat_Float32x3, offsetof(struct ObjVertex, normal), 1 };
+	WGPUVertexBufferLayout vertexBufferLayout = (WGPUVertexBufferLayout) {};
+	vertexBufferLayout.arrayStride = sizeof(struct ObjVertex);
+	vertexBufferLayout.stepMode = WGPUVertexStepMode_Vertex;
+	vertexBufferLayout.attributeCount = 2;
+	vertexBufferLayout.attributes = attributes;
+
+	WGPURenderPipelineDescriptor pipelineDesc = (WGPURenderPipelineDescriptor) {};
+	pipelineDesc.vertex.module = shaderModule;
+	pipelineDesc.vertex.entryPoint = "vs_main";
+	pipelineDesc.vertex.bufferCount = 1;
+	pipelineDesc.vertex.buffers = &vertexBufferLayout;
+	pipelineDesc.primitive.topology = WGPUPrimitiveTopology_TriangleList;
+	pipelineDesc.primitive.stripIndexFormat = WGPUIndexFormat_Undefined;
+	pipelineDesc.primitive.frontFace = WGPUFrontFace_CCW;
+	pipelineDesc.primitive.cullMode = WGPUCullMode_None;
+
+	WGPUDepthStencilState depthStencilState = (WGPUDepthStencilState) {};
+	depthStencilState.format = DEPTH_FORMAT;
+	depthStencilState.depthWriteEnabled = true;
+	depthStencilState.depthCompare = WGPUCompareFunction_Less;
+	depthStencilState.stencilFront.compare = WGPUCompareFunction_Always;
+	depthStencilState.stencilBack.compare = WGPUCompareFunction_Always;
+	depthStencilState.stencilReadMask = 0;
+	depthStencilState.stencilWriteMask = 0;
+	pipelineDesc.depthStencil = &depthStencilState;
+
+	WGPUColorTargetState colorTarget = (WGPUColorTargetState) {};
+	colorTarget.format = format;
+	colorTarget.blend = NULL;
+	colorTarget.writeMask = WGPUColorWriteMask_All;
+	WGPUFragmentState fragmentState = (WGPUFragmentState) {};
+	fragmentState.module = shaderModule;
+	fragmentState.entryPoint = "fs_main";
+	fragmentState.targetCount = 1;
+	fragmentState.targets = &colorTarget;
+	pipelineDesc.fragment = &fragmentState;
+
+	pipelineDesc.multisample.count = 1;
+	pipelineDesc.multisample.mask = ~0u;
+	pipelineDesc.layout = NULL;
+
+	WGPURenderPipeline pipeline = wgpuDeviceCreateRenderPipeline(device, &pipelineDesc);
+	wgpuShaderModuleRelease(shaderModule);
+	return pipeline;
+}
+
+static WGPUTextureView createTarget(WGPUDevice device, WGPUTextureFormat format, WGPUTextureUsageFlags usage, char const * label, WGPUTexture * texture) {
+	WGPUTextureDescriptor textureDesc = (WGPUTextureDescriptor) {};
+	textureDesc.label = label;
+	textureDesc.usage = usage;
+	textureDesc.dimension = WGPUTextureDimension_2D;
+	textureDesc.size = (WGPUExtent3D) { TARGET_SIZE, TARGET_SIZE, 1 };
+	textureDesc.format = format;
+	textureDesc.mipLevelCount = 1;
+	textureDesc.sampleCount = 1;
+	textureDesc.viewFormatCount = 0;
+	textureDesc.viewFormats = NULL;
+	*texture = wgpuDeviceCreateTexture(device, &textureDesc);
+	return wgpuTextureCreateView(*texture, NULL);
+}
+
+static WGPUBuffer createFilledBuffer(WGPUDevice device, WGPUQueue queue, void const * data, uint64_t size, WGPUBufferUsageFlags usage, char const * label) {
+	// writeBuffer sizes must be multiples of 4, which 16-bit indices may not be
+	uint64_t alignedSize = alignUp(size, 4);
+	WGPUBuffer buffer = createBuffer(device, alignedSize, usage | WGPUBufferUsage_CopyDst, label);
+	void * padded = calloc(1, (size_t)alignedSize);
+	memcpy(padded, data, (size_t)size);
+	wgpuQueueWriteBuffer(queue, buffer, 0, padded, (size_t)alignedSize);
+	free(padded);
+	return buffer;
+}
+
+/**
+ * Returns the average time, in milliseconds, to render and wait for one
+ * frame drawing `instanceCount` instances of the mesh.
+ */
+static double benchFrames(WGPUDevice device, WGPUQueue queue, WGPURenderPipeline pipeline, WGPUTextureView colorView, WGPUTextureView depthView,
+	struct ObjMesh const * mesh, WGPUIndexFormat indexFormat, uint32_t instanceCount) {
+	uint64_t indexSize = (uint64_t)mesh->indexCount * (indexFormat == WGPUIndexFormat_Uint16 ? sizeof(uint16_t) : sizeof(uint32_t));
+	void * indices = mesh->indices;
+	uint16_t * indices16 = NULL;
+	if (indexFormat == WGPUIndexFormat_Uint16) {
+		indices16 = (uint16_t *)malloc((size_t)indexSize);
+		meshPackIndices16(indices16, mesh->indices, mesh->indexCount);
+		indices = indices16;
+	}
+	WGPUBuffer vertexBuffer = createFilledBuffer(device, queue, mesh->vertices, (uint64_t)mesh->vertexCount * sizeof(struct ObjVertex), WGPUBufferUsage_Vertex, "Bench vertices");
+	WGPUBuffer indexBuffer = createFilledBuffer(device, queue, indices, indexSize, WGPUBufferUsage_Index, "Bench indices");
+	free(indices16);
+
+	WGPURenderPassColorAttachment colorAttachment = (WGPURenderPassColorAttachment) {};
+	colorAttachment.view = colorView;
+	colorAttachment.resolveTarget = NULL;
+	colorAttachment.loadOp = WGPULoadOp_Clear;
+	colorAttachment.storeOp = WGPUStoreOp_Store;
+	colorAttachment.clearValue = (WGPUColor) { 0.0, 0.0, 0.0, 1.0 };
+	WGPURenderPassDepthStencilAttachment depthAttachment = (WGPURenderPassDepthStencilAttachment) {};
+	depthAttachment.view = depthView;
+	depthAttachment.depthLoadOp = WGPULoadOp_Clear;
+	depthAttachment.depthStoreOp = WGPUStoreOp_Discard;
+	depthAttachment.depthClearValue = 1.0f;
+	depthAttachment.depthReadOnly = false;
+	depthAttachment.stencilLoadOp = WGPULoadOp_Undefined;
+	depthAttachment.stencilStoreOp = WGPUStoreOp_Undefined;
+	depthAttachment.stencilReadOnly = true;
+	WGPURenderPassDescriptor renderPassDesc = (WGPURenderPassDescriptor) {};
+	renderPassDesc.colorAttachmentCount = 1;
+	renderPassDesc.colorAttachments = &colorAttachment;
+	renderPassDesc.depthStencilAttachment = &depthAttachment;
+	renderPassDesc.timestampWriteCount = 0;
+	renderPassDesc.timestampWrites = NULL;
+
+	double total = 0.0;
+	for (int it = 0; it < WARMUP_ITERATIONS + ITERATIONS; ++it) {
+		double start = benchNow();
+		WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, NULL);
+		WGPURenderPassEncoder renderPass = wgpuCommandEncoderBeginRenderPass(encoder, &renderPassDesc);
+		wgpuRenderPassEncoderSetPipeline(renderPass, pipeline);
+		wgpuRenderPassEncoderSetVertexBuffer(renderPass, 0, vertexBuffer, 0, (uint64_t)mesh->vertexCount * sizeof(struct ObjVertex));
+		wgpuRenderPassEncoderSetIndexBuffer(renderPass, indexBuffer, indexFormat, 0, indexSize);
+		wgpuRenderPassEncoderDrawIndexed(renderPass, mesh->indexCount, instanceCount, 0, 0, 0);
+		wgpuRenderPassEncoderEnd(renderPass);
+		WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, NULL);
+		wgpuQueueSubmit(queue, 1, &command);
+		wgpuCommandBufferRelease(command);
+		wgpuRenderPassEncoderRelease(renderPass);
+		wgpuCommandEncoderRelease(encoder);
+		benchWaitForQueue(device, queue);
+		if (it >= WARMUP_ITERATIONS) total += benchNow() - start;
+	}
+
+	wgpuBufferDestroy(indexBuffer);
+	wgpuBufferRelease(indexBuffer);
+	wgpuBufferDestroy(vertexBuffer);
+	wgpuBufferRelease(vertexBuffer);
+	return total / ITERATIONS * 1e3;
+}
+
+/**
+ * Fit the mesh in [-1, 1]^3, so that all meshes cover the target alike.
+ */
+static void normalizePositions(struct ObjMesh * mesh) {
+	float extent = 0.0f;
+	float center[3];
+	for (uint32_t k = 0; k < 3; ++k) {
+		center[k] = 0.5f * (mesh->boundsMin[k] + mesh->boundsMax[k]);
+		extent = fmaxf(extent, 0.5f * (mesh->boundsMax[k] - mesh->boundsMin[k]));
+	}
+	// Leave room for rotations about the vertical axis
+	float scale = extent > 0.0f ? 1.0f / (extent * sqrtf(2.0f)) : 1.0f;
+	for (uint32_t v = 0; v < mesh->vertexCount; ++v) {
+		for (uint32_t k = 0; k < 3; ++k) {
+			mesh->vertices[v].position[k] = (mesh->vertices[v].position[k] - center[k]) * scale;
+		}
+	}
+}
+
+static void printStage(char const * name, struct ObjMesh const * mesh, double frameTime, double baseTime) {
+	struct MeshVertexCacheStatistics cache = meshAnalyzeVertexCache(mesh->indices, mesh->indexCount, mesh->vertexCount, MESH_OPTIMIZER_ANALYSIS_CACHE_SIZE);
+	struct MeshVertexFetchStatistics fetch = meshAnalyzeVertexFetch(mesh->indices, mesh->indexCount, mesh->vertexCount, sizeof(struct ObjVertex));
+	printf("  %-14s %8.3f %8.3f %10.2f %10.3f ms %7.2fx\n", name, cache.acmr, cache.atvr, fetch.overfetch, frameTime, baseTime / frameTime);
+}
+
+int main(int argc, char** argv) {
+	char const * const * paths = argc > 1 ? (char const * const *)(argv + 1) : defaultMeshes;
+	int pathCount = argc > 1 ? argc - 1 : (int)(sizeof(defaultMeshes) / sizeof(defaultMeshes[0]));
+
+	struct BenchGpu gpu;
+	if (!benchGpuCreate(&gpu, DeviceProfile_Production)) return 1;
+	WGPUDevice device = gpu.device;
+	WGPUQueue queue = gpu.queue;
+
+	WGPUTextureFormat format = WGPUTextureFormat_RGBA8Unorm;
+	WGPUTexture colorTarget;
+	WGPUTexture depthTarget;
+	WGPUTextureView colorView = createTarget(device, format, WGPUTextureUsage_RenderAttachment, "Bench target", &colorTarget);
+	WGPUTextureView depthView = createTarget(device, DEPTH_FORMAT, WGPUTextureUsage_RenderAttachment, "Bench depth", &depthTarget);
+	WGPURenderPipeline pipeline = createPipeline(device, format);
+
+	for (int i = 0; i < pathCount; ++i) {
+		struct ObjMesh * mesh = objMeshLoad(paths[i], 0);
+		if (!mesh) continue;
+		uint32_t triangleCount = mesh->indexCount / 3;
+		if (triangleCount == 0) {
+			objMeshRelease(mesh);
+			continue;
+		}
+		normalizePositions(mesh);
+		uint32_t instanceCount = (TRIANGLES_PER_FRAME + triangleCount - 1) / triangleCount;
+		printf("%s: %u vertices, %u triangles, %u instances\n", paths[i], mesh->vertexCount, triangleCount, instanceCount);
+		printf("  %-14s %8s %8s %10s %13s %8s\n", "stage", "ACMR", "ATVR", "overfetch", "frame", "speedup");
+
+		double baseTime = benchFrames(device, queue, pipeline, colorView, depthView, mesh, WGPUIndexFormat_Uint32, instanceCount);
+		printStage("file order", mesh, baseTime, baseTime);
+
+		double start = benchNow();
+		meshOptimizeVertexCache(mesh->indices, mesh->indexCount, mesh->vertexCount);
+		double optimizeTime = benchNow() - start;
+		printStage("vertex cache", mesh, benchFrames(device, queue, pipeline, colorView, depthView, mesh, WGPUIndexFormat_Uint32, instanceCount), baseTime);
+
+		start = benchNow();
+		meshOptimizeOverdraw(mesh->indices, mesh->indexCount, mesh->vertices[0].position, sizeof(struct ObjVertex), mesh->vertexCount, MESH_OPTIMIZER_OVERDRAW_THRESHOLD);
+		optimizeTime += benchNow() - start;
+		printStage("overdraw", mesh, benchFrames(device, queue, pipeline, colorView, depthView, mesh, WGPUIndexFormat_Uint32, instanceCount), baseTime);
+
+		start = benchNow();
+		mesh->vertexCount = meshOptimizeVertexFetch(mesh->vertices, sizeof(struct ObjVertex), mesh->vertexCount, mesh->indices, mesh->indexCount);
+		optimizeTime += benchNow() - start;
+		printStage("vertex fetch", mesh, benchFrames(device, queue, pipeline, colorView, depthView, mesh, WGPUIndexFormat_Uint32, instanceCount), baseTime);
+
+		WGPUIndexFormat indexFormat = meshIndexFormat(mesh->vertexCount);
+		if (indexFormat == WGPUIndexFormat_Uint16) {
+			printStage("16-bit indices", mesh, benchFrames(device, queue, pipeline, colorView, depthView, mesh, indexFormat, instanceCount), baseTime);
+		}
+		printf("  optimised in %.1f ms\n", optimizeTime * 1e3);
+		objMeshRelease(mesh);
+	}
+
+	wgpuRenderPipelineRelease(pipeline);
+	wgpuTextureViewRelease(depthView);
+	wgpuTextureRelease(depthTarget);
+	wgpuTextureViewRelease(colorView);
+	wgpuTextureRelease(colorTarget);
+	benchGpuRelease(&gpu);
+	return 0;
+}
@@ -0,0 +1,253 @@
+/**
+ * Measure the throughput of the inference engine (see nn-inference.h) in
+ * GFLOP/s, for power-of-two batch sizes up to maxBatch, on two synthetic
+ * models: a multi-layer perceptron and a small convolutional network.
+ * Models are written to and memory mapped from model files, and the
+ * output of a batch of 2 is checked against a CPU evaluation, on the
+ * App's production device, which has ShaderF16 when the adapter does.
+ *
+ * Usage: NnInferenceBench [maxBatch]
+ */
+
+#include <webgpu/webgpu.h>
+#include "bench-utils.h"
+#include "half-float.h"
+#include "nn-inference.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ITERATIONS 10
+#define MAX_LAYERS 8
+
+static uint32_t randomState = 0x9e3779b9u;
+
+static float randomFloat(float scale) {
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return ((float)(randomState & 0xffffff) / (float)0x1000000 * 2.0f - 1.0f) * scale;
+}
+
+static float activate(float x, enum NnActivation activation) {
+	switch (activation) {
+	case NnActivation_ReLU: return x > 0.0f ? x : 0.0f;
+	case NnActivation_Sigmoid: return 1.0f / (1.0f + expf(-x));
+	case NnActivation_Tanh: return tanhf(x);
+	case NnActivation_GELU: return 0.5f * x * (1.0f + tanhf(0.7978845608f * (x + 0.044715f * x * x * x)));
+	default: return x;
+	}
+}
+
+static float roundToHalf(float x) {
+	return halfToFloat(floatToHalf(x));
+}
+
+/**
+ * Evaluate one input on the CPU, with weights rounded to halves as on the
+ * GPU. Returns a malloc'd output.
+ */
+static float * evaluateOnCpu(struct NnShape shape, struct NnLayerSpec const * layers, uint32_t layerCount, float const * input) {
+	float * current = (float *)malloc(shape.width * shape.height * shape.channels * sizeof(float));
+	memcpy(current, input, shape.width * shape.height * shape.channels * sizeof(float));
+	for (uint32_t l = 0; l < layerCount; ++l) {
+		struct NnLayerSpec const * layer = &layers[l];
+		struct NnShape out = shape;
+		float * next = NULL;
+		if (layer->type == NnLayer_Activation) {
+			next = current;
+			for (uint32_t i = 0; i < shape.width * shape.height * shape.channels; ++i) next[i] = activate(next[i], layer->activation);
+			continue;
+		}
+		uint32_t k = layer->kernelSize > 0 ? layer->kernelSize : 1;
+		uint32_t stride = layer->stride > 0 ? layer->stride : 1;
+		uint32_t padding = layer->padding;
+		if (layer->type == NnLayer_Dense) {
+			// A dense layer is a convolution covering the whole input
+			out = (struct NnShape) { 1, 1, layer->outChannels };
+			k = 0;
+		} else {
+			out = (struct NnShape) { (shape.width + 2 * padding - k) / stride + 1, (shape.height + 2 * padding - k) / stride + 1, layer->outChannels };
+		}
+		next = (float *)malloc(out.width * out.height * out.channels * sizeof(float));
+		uint32_t columns = k == 0 ? shape.width * shape.height * shape.channels : k * k * shape.channels;
+		for (uint32_t oy = 0; oy < out.height; ++oy) {
+			for (uint32_t ox = 0; ox < out.width; ++ox) {
+				for (uint32_t o = 0; o < out.channels; ++o) {
+					float sum = roundToHalf(layer->biases[o]);
+					for (uint32_t c = 0; c < columns; ++c) {
+						float value = 0.0f;
+						if (k == 0) {
+							value = current[c];
+						} else {
+							uint32_t channel = c % shape.channels;
+							int x = (int)(ox * stride + (c / shape.channels) % k) - (int)padding;
+							int y = (int)(oy * stride + c / (shape.channels * k)) - (int)padding;
+							if (x >= 0 && y >= 0 && x < (int)shape.width && y < (int)shape.height) {
+								value = current[((uint32_t)y * shape.width + (uint32_t)x) * shape.channels + channel];
+							}
+						}
+						sum += value * roundToHalf(layer->weights[(size_t)o * columns + c]);
+					}
+					next[(oy * out.width + ox) * out.channels + o] = activate(sum, layer->activation);
+				}
+			}
+		}
+		free(current);
+		current = next;
+		shape = out;
+	}
+	return current;
+}
+
+struct BenchModel {
+	char const * name;
+	char const * path;
+	struct NnShape inputShape;
+	struct NnLayerSpec layers[MAX_LAYERS];
+	uint32_t layerCount;
+	float * parameters[2 * MAX_LAYERS];
+};
+
+/**
+ * Fill the weights of `model` with random values, scaled so that
+ * activations keep about the same magnitude across layers.
+ */
+static void randomizeWeights(struct BenchModel * model) {
+	struct NnShape shape = model->inputShape;
+	for (uint32_t l = 0; l < model->layerCount; ++l) {
+		struct NnLayerSpec * layer = &model->layers[l];
+		if (layer->type == NnLayer_Activation) continue;
+		uint32_t columns = layer->type == NnLayer_Dense ? shape.width * shape.height * shape.channels : layer->kernelSize * layer->kernelSize * shape.channels;
+		float scale = 1.0f / sqrtf((float)columns);
+		float * weights = (float *)malloc((size_t)layer->outChannels * columns * sizeof(float));
+		float * biases = (float *)malloc(layer->outChannels * sizeof(float));
+		for (size_t i = 0; i < (size_t)layer->outChannels * columns; ++i) weights[i] = randomFloat(scale);
+		for (uint32_t i = 0; i < layer->outChannels; ++i) biases[i] = randomFloat(0.1f);
+		layer->weights = weights;
+		layer->biases = biases;
+		model->parameters[2 * l] = weights;
+		model->parameters[2 * l + 1] = biases;
+		if (layer->type == NnLayer_Dense) {
+			shape = (struct NnShape) { 1, 1, layer->outChannels };
+		} else {
+			shape.width = (shape.width + 2 * layer->padding - layer->kernelSize) / layer->stride + 1;
+			shape.height = (shape.height + 2 * layer->padding - layer->kernelSize) / layer->stride + 1;
+			shape.channels = layer->outChannels;
+		}
+	}
+}
+
+static struct NnLayerSpec denseLayer(uint32_t outChannels, enum NnActivation activation) {
+	struct NnLayerSpec layer = { NnLayer_Dense, activation, outChannels, 0, 0, 0, NULL, NULL };
+	return layer;
+}
+
+static struct NnLayerSpec convLayer(uint32_t outChannels, uint32_t kernelSize, uint32_t stride, enum NnActivation activation) {
+	struct NnLayerSpec layer = { NnLayer_Conv2d, activation, outChannels, kernelSize, stride, kernelSize / 2, NULL, NULL };
+	return layer;
+}
+
+static struct NnLayerSpec activationLayer(enum NnActivation activation) {
+	struct NnLayerSpec layer = { NnLayer_Activation, activation, 0, 0, 0, 0, NULL, NULL };
+	return layer;
+}
+
+int main(int argc, char** argv) {
+	uint32_t maxBatch = argc > 1 ? (uint32_t)atoi(argv[1]) : 256;
+	if (maxBatch == 0) {
+		fprintf(stderr, "Usage: %s [maxBatch]\n", argv[0]);
+		return 1;
+	}
+
+	struct BenchGpu gpu;
+	if (!benchGpuCreate(&gpu, DeviceProfile_Production)) return 1;
+	WGPUDevice device = gpu.device;
+	WGPUQueue queue = gpu.queue;
+
+	struct BenchModel models[2];
+	memset(models, 0, sizeof(models));
+	models[0].name = "mlp";
+	models[0].path = "nn-bench-mlp.wnn";
+	models[0].inputShape = (struct NnShape) { 1, 1, 1024 };
+	models[0].layers[0] = denseLayer(4096, NnActivation_None);
+	models[0].layers[1] = activationLayer(NnActivation_ReLU);
+	models[0].layers[2] = denseLayer(4096, NnActivation_GELU);
+	models[0].layers[3] = denseLayer(1000, NnActivation_None);
+	models[0].layerCount = 4;
+	models[1].name = "cnn";
+	models[1].path = "nn-bench-cnn.wnn";
+	models[1].inputShape = (struct NnShape) { 32, 32, 3 };
+	models[1].layers[0] = convLayer(32, 3, 1, NnActivation_ReLU);
+	models[1].layers[1] = convLayer(64, 3, 2, NnActivation_ReLU);
+	models[1].layers[2] = convLayer(128, 3, 2, NnActivation_None);
+	models[1].layers[3] = activationLayer(NnActivation_Tanh);
+	models[1].layers[4] = denseLayer(10, NnActivation_Sigmoid);
+	models[1].layerCount = 5;
+
+	bool allOk = true;
+	for (int m = 0; m < 2; ++m) {
+		struct BenchModel * bench = &models[m];
+		randomizeWeights(bench);
+		if (!nnModelWrite(bench->path, bench->inputShape, bench->layers, bench->layerCount)) return 1;
+		struct NnModel * model = nnModelLoad(bench->path);
+		if (!model) return 1;
+		struct NnEngine * engine = nnEngineCreate(device, model, maxBatch);
+		nnModelRelease(model);
+		remove(bench->path);
+
+		uint32_t inputSize = engine->inputShape.width * engine->inputShape.height * engine->inputShape.channels;
+		uint32_t outputSize = engine->outputShape.width * engine->outputShape.height * engine->outputShape.channels;
+		float * inputs = (float *)malloc((size_t)engine->maxBatch * inputSize * sizeof(float));
+		float * outputs = (float *)malloc((size_t)engine->maxBatch * outputSize * sizeof(float));
+		for (size_t i = 0; i < (size_t)engine->maxBatch * inputSize; ++i) inputs[i] = randomFloat(1.0f);
+
+		// Check a batch of 2, so that batch offsets are exercised
+		bool ok = true;
+		uint32_t checked = engine->maxBatch < 2 ? engine->maxBatch : 2;
+		ok = nnEngineRun(engine, inputs, checked, outputs);
+		float maxError = 0.0f;
+		for (uint32_t b = 0; ok && b < checked; ++b) {
+			float * expected = evaluateOnCpu(bench->inputShape, bench->layers, bench->layerCount, inputs + (size_t)b * inputSize);
+			for (uint32_t i = 0; i < outputSize; ++i) {
+				float error = fabsf(expected[i] - outputs[(size_t)b * outputSize + i]) / (1.0f + fabsf(expected[i]));
+				if (error > maxError) maxError = error;
+			}
+			free(expected);
+		}
+		ok = ok && maxError < 1e-3f;
+		allOk = allOk && ok;
+
+		printf("%s (%s weights, max error %.2g%s)\n", bench->name, engine->useF16 ? "f16" : "packed half", maxError, ok ? "" : ", does not match the CPU");
+		printf("%8s %10s %10s\n", "batch", "ms", "GFLOP/s");
+		for (uint32_t batch = 1; batch <= engine->maxBatch; batch *= 2) {
+			wgpuQueueWriteBuffer(queue, engine->input, 0, inputs, (size_t)batch * inputSize * sizeof(float));
+			double total = 0.0;
+			for (int it = 0; it <= ITERATIONS; ++it) {
+				double start = benchNow();
+				WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, NULL);
+				nnEngineEncode(engine, encoder, batch);
+				WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, NULL);
+				wgpuQueueSubmit(queue, 1, &command);
+				benchWaitForQueue(device, queue);
+				double elapsed = benchNow() - start;
+				wgpuCommandBufferRelease(command);
+				wgpuCommandEncoderRelease(encoder);
+				if (it > 0) total += elapsed; // first iteration is warm-up
+			}
+			double seconds = total / ITERATIONS;
+			printf("%8u %10.3f %10.1f\n", batch, seconds * 1e3, nnEngineFlops(engine, batch) / seconds * 1e-9);
+		}
+		printf("\n");
+
+		free(outputs);
+		free(inputs);
+		nnEngineRelease(engine);
+		for (int i = 0; i < 2 * MAX_LAYERS; ++i) free(bench->parameters[i]);
+	}
+
+	benchGpuRelease(&gpu);
+	return allOk ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+/**
+ * Measure how fast OBJ files load (see obj-loader.h) with more and more
+ * threads. Unless a file is given, a scan-like heightfield of
+ * `triangles` triangles is written first, with positions, texture
+ * coordinates and normals, and its vertex and index counts are checked.
+ *
+ * Usage: ObjLoaderBench [triangles] [path]
+ *        ObjLoaderBench --load path
+ */
+
+#include "bench-utils.h"
+#include "obj-loader.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Write a grid of `resolution` x `resolution` quads as a heightfield.
+ * Returns the size of the file, or 0 if it cannot be written.
+ */
+static long writeHeightfield(char const * path, uint32_t resolution) {
+	FILE * file = fopen(path, "wb");
+	if (!file) return 0;
+	fprintf(file, "# Heightfield of %u x %u quads\n", resolution, resolution);
+	uint32_t side = resolution + 1;
+	for (uint32_t y = 0; y < side; ++y) {
+		for (uint32_t x = 0; x < side; ++x) {
+			float u = (float)x / (float)resolution;
+			float v = (float)y / (float)resolution;
+			float h = 0.05f * sinf(20.0f * u) * cosf(17.0f * v);
+			fprintf(file, "v %.6f %.6f %.6f\n", 2.0f * u - 1.0f, h, 2.0f * v - 1.0f);
+		}
+	}
+	for (uint32_t y = 0; y < side; ++y) {
+		for (uint32_t x = 0; x < side; ++x) {
+			fprintf(file, "vt %.6f %.6f\n", (float)x / (float)resolution, (float)y / (float)resolution);
+		}
+	}
+	for (uint32_t y = 0; y < side; ++y) {
+		for (uint32_t x = 0; x < side; ++x) {
+			float u = (float)x / (float)resolution;
+			float v = (float)y / (float)resolution;
+			float dx = -0.05f * 20.0f * cosf(20.0f * u) * cosf(17.0f * v);
+			float dz = 0.05f * 17.0f * sinf(20.0f * u) * sinf(17.0f * v);
+			float length = sqrtf(dx * dx + 1.0f + dz * dz);
+			fprintf(file, "vn %.6f %.6f %.6f\n", dx / length, 1.0f / length, dz / length);
+		}
+	}
+	// Quads, split by the loader
+	for (uint32_t y = 0; y < resolution; ++y) {
+		for (uint32_t x = 0; x < resolution; ++x) {
+			uint32_t a = y * side + x + 1;
+			uint32_t b = a + side;
+			fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, b + 1, b + 1, b + 1, a + 1, a + 1, a + 1);
+		}
+	}
+	long size = ftell(file);
+	if (fclose(file) != 0) return 0;
+	return size;
+}
+
+int main(int argc, char** argv) {
+	char const * path = "obj-loader-bench.obj";
+	uint32_t resolution = 0;
+	if (argc > 2 && strcmp(argv[1], "--load") == 0) {
+		path = argv[2];
+	} else {
+		uint64_t triangles = argc > 1 ? strtoull(argv[1], NULL, 10) : 4000000;
+		if (argc > 2) path = argv[2];
+		resolution = (uint32_t)sqrt((double)triangles / 2.0);
+		if (resolution == 0) {
+			fprintf(stderr, "Usage: %s [triangles] [path]\n       %s --load path\n", argv[0], argv[0]);
+			return 1;
+		}
+		printf("Writing %s...\n", path);
+		if (writeHeightfield(path, resolution) == 0) {
+			fprintf(stderr, "Could not write %s\n", path);
+			return 1;
+		}
+	}
+
+	FILE * file = fopen(path, "rb");
+	if (!file) return 1;
+	fseek(file, 0, SEEK_END);
+	double megabytes = (double)ftell(file) * 1e-6;
+	fclose(file);
+
+	printf("%s, %.1f MB\n", path, megabytes);
+	printf("%8s %10s %10s %12s %12s\n", "threads", "ms", "MB/s", "Mtri/s", "vertices");
+	int status = 0;
+	uint32_t threadCounts[] = { 1, 2, 4, 8, 16 };
+	for (uint32_t t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); ++t) {
+		double start = benchNow();
+		struct ObjMesh * mesh = objMeshLoad(path, threadCounts[t]);
+		double elapsed = benchNow() - start;
+		if (!mesh) return 1;
+		uint32_t triangles = mesh->indexCount / 3;
+		printf("%8u %10.1f %10.1f %12.2f %12u\n", threadCounts[t], elapsed * 1e3, megabytes / elapsed, triangles / elapsed * 1e-6, mesh->vertexCount);
+		if (resolution > 0) {
+			uint32_t expectedVertices = (resolution + 1) * (resolution + 1);
+			uint32_t expectedIndices = 6 * resolution * resolution;
+			if (mesh->vertexCount != expectedVertices || mesh->indexCount != expectedIndices) {
+				fprintf(stderr, "Expected %u vertices and %u indices\n", expectedVertices, expectedIndices);
+				status = 1;
+			}
+		}
+		objMeshRelease(mesh);
+	}
+	return status;
+}
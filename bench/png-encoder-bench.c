@@ -0,0 +1,167 @@
+/**
+ * Measure the single-threaded PNG encoding throughput of stb_image_write
+ * with its SIMD filter, filter scoring and match kernels against the same
+ * encoder built without them (png-encoder-scalar.c), on a corpus of
+ * frames that compress like rendered ones. Both must produce the same
+ * bytes.
+ *
+ * Usage: PngEncoderBench [width] [height] [iterations]
+ */
+
+#include "bench-utils.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int scalarPngWriteToFunc(stbi_write_func * func, void * context, int width, int height, int channels, void const * pixels, int bytesPerRow);
+
+enum FrameKind {
+	Frame_Scene,
+	Frame_Shading,
+	Frame_Terrain,
+	Frame_Interface,
+	Frame_KindCount,
+};
+
+static char const * const frameNames[Frame_KindCount] = { "scene", "shading", "terrain", "interface" };
+
+static uint8_t clampByte(int value) {
+	return (uint8_t)(value < 0 ? 0 : value > 255 ? 255 : value);
+}
+
+static void makeFrame(enum FrameKind kind, uint8_t * pixels, uint32_t width, uint32_t height) {
+	uint32_t seed = 12345;
+	for (uint32_t y = 0; y < height; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			uint8_t * p = pixels + ((size_t)y * width + x) * 4;
+			seed = seed * 1664525u + 1013904223u;
+			int noise = (int)(seed >> 28) - 8;
+			int r = 0, g = 0, b = 0;
+			switch (kind) {
+			case Frame_Scene:
+				// Sky gradient, flat shaded boxes and a textured floor
+				r = 64 + 96 * (int)y / (int)height;
+				g = 128 + 64 * (int)y / (int)height;
+				b = 255 - 64 * (int)y / (int)height;
+				if ((x / 256 + y / 256) % 3 == 0 && y > height / 3) {
+					r = (int)(x / 256 * 37);
+					g = (int)(y / 256 * 53);
+					b = 90;
+				}
+				if (y > height * 3 / 4) {
+					r = 100 + 2 * noise;
+					g = 80 + 2 * noise;
+					b = 60 + 2 * noise;
+				}
+				break;
+			case Frame_Shading: {
+				// Diffuse lit spheres on a grid, with dithering noise
+				int cell = (int)(height / 4);
+				int dx = (int)(x % cell) - cell / 2;
+				int dy = (int)(y % cell) - cell / 2;
+				int d2 = dx * dx + dy * dy;
+				int radius = cell * 2 / 5;
+				if (d2 < radius * radius) {
+					int light = 255 - 255 * (dx + dy + radius) / (3 * radius);
+					r = light * (int)(1 + x / cell % 3) / 3;
+					g = light * (int)(1 + y / cell % 3) / 3;
+					b = light / 2;
+				} else {
+					r = g = b = 32;
+				}
+				r += noise / 4;
+				g += noise / 4;
+				b += noise / 4;
+				break;
+			}
+			case Frame_Terrain:
+				// Low-amplitude texture over slow height-based colors
+				r = 90 + (int)((x * 3 + y * 5) % 97) / 4 + noise;
+				g = 110 + (int)((x * 7 + y * 2) % 89) / 4 + noise;
+				b = 70 + noise;
+				break;
+			case Frame_Interface:
+				// Flat panels with thin lines, like text and widgets
+				r = g = b = 40;
+				if (x % 320 < 300 && y % 200 < 180) {
+					r = 220; g = 220; b = 225;
+					if (y % 20 < 12 && (x / 7 + y / 20) % 5 != 0 && (x % 7) < 5) r = g = b = 20;
+				}
+				break;
+			default:
+				break;
+			}
+			p[0] = clampByte(r);
+			p[1] = clampByte(g);
+			p[2] = clampByte(b);
+			p[3] = 255;
+		}
+	}
+}
+
+struct Output {
+	uint8_t * data;
+	size_t size;
+	size_t capacity;
+};
+
+static void appendOutput(void * context, void * data, int size) {
+	struct Output * output = (struct Output *)context;
+	if (output->size + (size_t)size > output->capacity) {
+		output->capacity = 2 * (output->size + (size_t)size);
+		output->data = (uint8_t *)realloc(output->data, output->capacity);
+	}
+	memcpy(output->data + output->size, data, (size_t)size);
+	output->size += (size_t)size;
+}
+
+int main(int argc, char** argv) {
+	uint32_t width = argc > 1 ? (uint32_t)atoi(argv[1]) : 1920;
+	uint32_t height = argc > 2 ? (uint32_t)atoi(argv[2]) : 1080;
+	uint32_t iterations = argc > 3 ? (uint32_t)atoi(argv[3]) : 3;
+	if (width == 0 || height == 0 || iterations == 0) {
+		fprintf(stderr, "Usage: %s [width] [height] [iterations]\n", argv[0]);
+		return 1;
+	}
+	uint8_t * pixels = (uint8_t *)malloc((size_t)width * height * 4);
+	double megabytes = (double)width * height * 4 * 1e-6;
+	struct Output scalar = (struct Output) {};
+	struct Output simd = (struct Output) {};
+	int mismatches = 0;
+
+	printf("%ux%u RGBA8, %u iterations\n", width, height, iterations);
+	printf("%12s %12s %12s %10s %10s\n", "frame", "scalar MB/s", "SIMD MB/s", "speedup", "KB");
+	for (int kind = 0; kind < Frame_KindCount; ++kind) {
+		makeFrame((enum FrameKind)kind, pixels, width, height);
+
+		double start = benchNow();
+		for (uint32_t i = 0; i < iterations; ++i) {
+			scalar.size = 0;
+			if (!scalarPngWriteToFunc(appendOutput, &scalar, (int)width, (int)height, 4, pixels, (int)width * 4)) return 1;
+		}
+		double scalarTime = (benchNow() - start) / iterations;
+
+		start = benchNow();
+		for (uint32_t i = 0; i < iterations; ++i) {
+			simd.size = 0;
+			if (!stbi_write_png_to_func(appendOutput, &simd, (int)width, (int)height, 4, pixels, (int)width * 4)) return 1;
+		}
+		double simdTime = (benchNow() - start) / iterations;
+
+		printf("%12s %12.1f %12.1f %9.2fx %10.1f\n", frameNames[kind], megabytes / scalarTime, megabytes / simdTime, scalarTime / simdTime, simd.size / 1024.0);
+		if (scalar.size != simd.size || memcmp(scalar.data, simd.data, simd.size) != 0) {
+			fprintf(stderr, "The SIMD encoder output differs on the %s frame\n", frameNames[kind]);
+			++mismatches;
+		}
+	}
+
+	free(scalar.data);
+	free(simd.data);
+	free(pixels);
+	return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,19 @@
+/**
+ * stb_image_write compiled without its SIMD kernels, as the reference for
+ * PngEncoderBench. Everything is static so that it coexists with the
+ * default build of the library.
+ */
+
+#if defined(__GNUC__) || defined(__clang__)
+// Only the PNG writer is used
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+
+#define STBIW_NO_SIMD
+#define STB_IMAGE_WRITE_STATIC
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+int scalarPngWriteToFunc(stbi_write_func * func, void * context, int width, int height, int channels, void const * pixels, int bytesPerRow) {
+	return stbi_write_png_to_func(func, context, width, height, channels, pixels, bytesPerRow);
+}
@@ -0,0 +1,93 @@
+/**
+ * Measure the throughput of the multithreaded PNG writer (see
+ * png-writer.h) against stbi_write_png_to_mem on synthetic frames that
+ * compress like rendered ones: smooth gradients, flat shapes and a noisy
+ * band. Reports MB/s of raw pixels and the size of the files.
+ *
+ * Usage: PngWriterBench [width] [height] [iterations]
+ */
+
+#include "bench-utils.h"
+#include "png-writer.h"
+
+#include <stb_image_write.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static uint8_t * makeFrame(uint32_t width, uint32_t height) {
+	uint8_t * pixels = (uint8_t *)malloc((size_t)width * height * 4);
+	uint32_t seed = 12345;
+	for (uint32_t y = 0; y < height; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			uint8_t * p = pixels + ((size_t)y * width + x) * 4;
+			// Sky gradient
+			p[0] = (uint8_t)(64 + 96 * y / height);
+			p[1] = (uint8_t)(128 + 64 * y / height);
+			p[2] = (uint8_t)(255 - 64 * y / height);
+			p[3] = 255;
+			// Flat shaded boxes
+			if ((x / 256 + y / 256) % 3 == 0 && y > height / 3) {
+				p[0] = (uint8_t)(x / 256 * 37);
+				p[1] = (uint8_t)(y / 256 * 53);
+				p[2] = 90;
+			}
+			// Noisy ground, like a textured floor
+			if (y > height * 3 / 4) {
+				seed = seed * 1664525u + 1013904223u;
+				uint8_t noise = (uint8_t)(seed >> 27);
+				p[0] = (uint8_t)(100 + noise);
+				p[1] = (uint8_t)(80 + noise);
+				p[2] = (uint8_t)(60 + noise);
+			}
+		}
+	}
+	return pixels;
+}
+
+static void countBytes(void * context, void * data, int size) {
+	(void)data;
+	*(size_t *)context += (size_t)size;
+}
+
+int main(int argc, char** argv) {
+	uint32_t width = argc > 1 ? (uint32_t)atoi(argv[1]) : 3840;
+	uint32_t height = argc > 2 ? (uint32_t)atoi(argv[2]) : 2160;
+	uint32_t iterations = argc > 3 ? (uint32_t)atoi(argv[3]) : 5;
+	if (width == 0 || height == 0 || iterations == 0) {
+		fprintf(stderr, "Usage: %s [width] [height] [iterations]\n", argv[0]);
+		return 1;
+	}
+	uint8_t * pixels = makeFrame(width, height);
+	double megabytes = (double)width * height * 4 * 1e-6;
+
+	printf("%ux%u RGBA8, %u iterations\n", width, height, iterations);
+	printf("%16s %10s %10s %10s\n", "writer", "ms", "MB/s", "KB");
+
+	double start = benchNow();
+	size_t size = 0;
+	for (uint32_t i = 0; i < iterations; ++i) {
+		size = 0;
+		if (!stbi_write_png_to_func(countBytes, &size, (int)width, (int)height, 4, pixels, (int)width * 4)) return 1;
+	}
+	double elapsed = (benchNow() - start) / iterations;
+	printf("%16s %10.1f %10.1f %10.1f\n", "stbi_write_png", elapsed * 1e3, megabytes / elapsed, size / 1024.0);
+
+	uint32_t threadCounts[] = { 1, 2, 4, 8, 16 };
+	for (uint32_t t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); ++t) {
+		size_t parallelSize = 0;
+		start = benchNow();
+		for (uint32_t i = 0; i < iterations; ++i) {
+			void * png = NULL;
+			if (!pngEncode(width, height, 4, pixels, width * 4, threadCounts[t], &png, &parallelSize)) return 1;
+			free(png);
+		}
+		elapsed = (benchNow() - start) / iterations;
+		char name[32];
+		snprintf(name, sizeof(name), "%u threads", threadCounts[t]);
+		printf("%16s %10.1f %10.1f %10.1f\n", name, elapsed * 1e3, megabytes / elapsed, parallelSize / 1024.0);
+	}
+
+	free(pixels);
+	return 0;
+}
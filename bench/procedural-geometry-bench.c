@@ -0,0 +1,72 @@
+/**
+ * Measure how long the GPU takes to mesh a procedural surface (see
+ * procedural-geometry.h) with marching cubes, for grids of 32^3 cells up
+ * to maxResolution^3. The surface is a gyroid clipped by a sphere, which
+ * has about 650K triangles at 128^3 cells and 2.6M at 256^3. Each timing
+ * covers encoding, submitting and waiting for one generation.
+ *
+ * Usage: ProceduralGeometryBench [maxResolution]
+ */
+
+#include <webgpu/webgpu.h>
+#include "bench-utils.h"
+#include "procedural-geometry.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ITERATIONS 10
+
+int main(int argc, char** argv) {
+	uint32_t maxResolution = argc > 1 ? (uint32_t)atoi(argv[1]) : 256;
+	if (maxResolution == 0) {
+		fprintf(stderr, "Usage: %s [maxResolution]\n", argv[0]);
+		return 1;
+	}
+
+	// Fine grids need more than the default 128 MB storage bindings
+	struct BenchGpu gpu;
+	if (!benchGpuCreateWithMaxLimits(&gpu)) return 1;
+	WGPUDevice device = gpu.device;
+	WGPUQueue queue = gpu.queue;
+
+	printf("%10s %12s %12s %10s %12s\n", "resolution", "vertices", "triangles", "ms", "Mtri/s");
+	for (uint32_t resolution = 32; resolution <= maxResolution; resolution *= 2) {
+		// A gyroid has much more area than the closed surfaces the defaults are sized for
+		struct ProceduralSurfaceDesc surfaceDesc = {
+			proceduralSdfGyroid,
+			resolution,
+			{ -1.0f, -1.0f, -1.0f },
+			{ 1.0f, 1.0f, 1.0f },
+			resolution * resolution * resolution,
+			3 * resolution * resolution * resolution,
+		};
+		struct ProceduralSurface * surface = proceduralSurfaceCreate(device, &surfaceDesc);
+		if (!surface) break;
+
+		double total = 0.0;
+		for (int it = 0; it <= ITERATIONS; ++it) {
+			double start = benchNow();
+			WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, NULL);
+			proceduralSurfaceEncode(surface, encoder, (float)it, 0.0f);
+			WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, NULL);
+			wgpuQueueSubmit(queue, 1, &command);
+			benchWaitForQueue(device, queue);
+			double elapsed = benchNow() - start;
+			wgpuCommandBufferRelease(command);
+			wgpuCommandEncoderRelease(encoder);
+			if (it > 0) total += elapsed; // first iteration is warm-up
+		}
+
+		uint32_t vertexCount = 0;
+		uint32_t indexCount = 0;
+		proceduralSurfaceReadCounts(surface, &vertexCount, &indexCount);
+		bool fits = vertexCount <= surface->maxVertices && indexCount <= surface->maxIndices;
+		double seconds = total / ITERATIONS;
+		printf("%10u %12u %12u %10.3f %12.1f%s\n", resolution, vertexCount, indexCount / 3, seconds * 1e3, indexCount / 3 / seconds * 1e-6, fits ? "" : " (truncated)");
+		proceduralSurfaceRelease(surface);
+	}
+
+	benchGpuRelease(&gpu);
+	return 0;
+}
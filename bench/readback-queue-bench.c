@@ -0,0 +1,201 @@
+/**
+ * Measure what capturing every frame costs to the frame rate (see
+ * readback-queue.h). Each frame clears an offscreen color target, with
+ * up to 2 frames in flight as with a swap chain. Frames are either not
+ * captured, captured by mapping the copy and waiting for it (like
+ * FileRenderer in save_image.h), or captured through the readback queue,
+ * whose worker thread checksums the pixels.
+ *
+ * Usage: ReadbackQueueBench [frameCount] [width] [height]
+ */
+
+#include <webgpu/webgpu.h>
+#include "bench-utils.h"
+#include "readback-queue.h"
+#include "webgpu-utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FRAMES_IN_FLIGHT 2
+
+enum CaptureMode {
+	Capture_None,
+	Capture_Blocking,
+	Capture_Queued,
+	Capture_ModeCount,
+};
+
+static char const * const modeNames[Capture_ModeCount] = { "none", "blocking", "readback queue" };
+
+struct CaptureStats {
+	uint64_t captured;
+	uint64_t wrongColor;
+	uint64_t checksum;
+};
+
+/**
+ * Red channel the target is cleared with in `frame`.
+ */
+static uint8_t frameRed(uint64_t frame) {
+	return (uint8_t)(frame % 251);
+}
+
+static void consumeFrame(struct CaptureStats * stats, uint8_t const * pixels, uint32_t width, uint32_t height, uint32_t bytesPerRow, uint64_t frame) {
+	uint64_t sum = 0;
+	for (uint32_t y = 0; y < height; ++y) {
+		uint32_t const * row = (uint32_t const *)(pixels + (size_t)y * bytesPerRow);
+		for (uint32_t x = 0; x < width; ++x) sum += row[x];
+	}
+	// Clear values are converted to unorm8, allow for rounding
+	int red = frameRed(frame);
+	if (pixels[0] < red - 1 || pixels[0] > red + 1) stats->wrongColor++;
+	stats->checksum += sum;
+	stats->captured++;
+}
+
+static void onCapture(struct ReadbackResult const * result, void * userData) {
+	struct CaptureStats * stats = (struct CaptureStats *)userData;
+	if (!result->data) return;
+	consumeFrame(stats, (uint8_t const *)result->data, result->width, result->height, result->bytesPerRow, result->frame);
+}
+
+struct BlockingReadback {
+	WGPUBuffer buffer;
+	uint32_t bytesPerRow;
+	int mapped;
+};
+
+static void onBlockingMapped(WGPUBufferMapAsyncStatus status, void * pUserData) {
+	*(int *)pUserData = status == WGPUBufferMapAsyncStatus_Success ? 1 : -1;
+}
+
+int main(int argc, char** argv) {
+	uint32_t frameCount = argc > 1 ? (uint32_t)atoi(argv[1]) : 600;
+	uint32_t width = argc > 2 ? (uint32_t)atoi(argv[2]) : 1920;
+	uint32_t height = argc > 3 ? (uint32_t)atoi(argv[3]) : 1080;
+	if (frameCount == 0 || width == 0 || height == 0) {
+		fprintf(stderr, "Usage: %s [frameCount] [width] [height]\n", argv[0]);
+		return 1;
+	}
+
+	struct BenchGpu gpu;
+	if (!benchGpuCreate(&gpu, DeviceProfile_Production)) return 1;
+	WGPUDevice device = gpu.device;
+	WGPUQueue queue = gpu.queue;
+
+	WGPUTextureDescriptor targetDesc = (WGPUTextureDescriptor) {};
+	targetDesc.nextInChain = NULL;
+	targetDesc.label = "Offscreen target";
+	targetDesc.usage = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_CopySrc;
+	targetDesc.dimension = WGPUTextureDimension_2D;
+	targetDesc.size = (WGPUExtent3D) { width, height, 1 };
+	targetDesc.format = WGPUTextureFormat_RGBA8Unorm;
+	targetDesc.mipLevelCount = 1;
+	targetDesc.sampleCount = 1;
+	targetDesc.viewFormatCount = 0;
+	targetDesc.viewFormats = NULL;
+	WGPUTexture target = wgpuDeviceCreateTexture(device, &targetDesc);
+	WGPUTextureView targetView = wgpuTextureCreateView(target, NULL);
+
+	WGPUImageCopyTexture source = (WGPUImageCopyTexture) {};
+	source.nextInChain = NULL;
+	source.texture = target;
+	source.mipLevel = 0;
+	source.origin = (WGPUOrigin3D) { 0, 0, 0 };
+	source.aspect = WGPUTextureAspect_All;
+
+	struct BlockingReadback blocking = (struct BlockingReadback) {};
+	blocking.bytesPerRow = (uint32_t)alignUp((uint64_t)width * 4, 256);
+	blocking.buffer = createBuffer(device, (uint64_t)blocking.bytesPerRow * height, WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst, "Blocking readback");
+
+	printf("%dx%d, %u frames, %d in flight\n", width, height, frameCount, FRAMES_IN_FLIGHT);
+	printf("%16s %10s %10s %10s %10s\n", "capture", "ms/frame", "fps", "captured", "dropped");
+	for (int mode = 0; mode < Capture_ModeCount; ++mode) {
+		struct CaptureStats stats = (struct CaptureStats) {};
+		struct ReadbackQueue * readback = mode == Capture_Queued ? readbackQueueCreate(device, NULL, 0) : NULL;
+		if (mode == Capture_Queued && !readback) return 1;
+		uint64_t submitted = 0;
+		uint64_t completed = 0;
+
+		double start = benchNow();
+		for (uint32_t frame = 0; frame < frameCount; ++frame) {
+			// What presenting does: wait for the oldest frame in flight
+			while (submitted - completed >= FRAMES_IN_FLIGHT) benchTick(device);
+
+			WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, NULL);
+			WGPURenderPassColorAttachment attachment = (WGPURenderPassColorAttachment) {};
+			attachment.view = targetView;
+			attachment.resolveTarget = NULL;
+			attachment.loadOp = WGPULoadOp_Clear;
+			attachment.storeOp = WGPUStoreOp_Store;
+			attachment.clearValue = (WGPUColor) { frameRed(frame) / 255.0, 0.5, 0.25, 1.0 };
+			WGPURenderPassDescriptor renderPassDesc = (WGPURenderPassDescriptor) {};
+			renderPassDesc.nextInChain = NULL;
+			renderPassDesc.colorAttachmentCount = 1;
+			renderPassDesc.colorAttachments = &attachment;
+			renderPassDesc.depthStencilAttachment = NULL;
+			renderPassDesc.timestampWriteCount = 0;
+			renderPassDesc.timestampWrites = NULL;
+			WGPURenderPassEncoder renderPass = wgpuCommandEncoderBeginRenderPass(encoder, &renderPassDesc);
+			wgpuRenderPassEncoderEnd(renderPass);
+			wgpuRenderPassEncoderRelease(renderPass);
+
+			WGPUExtent3D extent = { width, height, 1 };
+			if (mode == Capture_Blocking) {
+				WGPUImageCopyBuffer destination = (WGPUImageCopyBuffer) {};
+				destination.nextInChain = NULL;
+				destination.buffer = blocking.buffer;
+				destination.layout.nextInChain = NULL;
+				destination.layout.offset = 0;
+				destination.layout.bytesPerRow = blocking.bytesPerRow;
+				destination.layout.rowsPerImage = height;
+				wgpuCommandEncoderCopyTextureToBuffer(encoder, &source, &destination, &extent);
+			} else if (mode == Capture_Queued) {
+				readbackQueueCopyTexture(readback, encoder, &source, extent, onCapture, &stats);
+			}
+
+			WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, NULL);
+			wgpuQueueSubmit(queue, 1, &command);
+			wgpuCommandBufferRelease(command);
+			wgpuCommandEncoderRelease(encoder);
+			wgpuQueueOnSubmittedWorkDone(queue, 0, benchCountWorkDone, &completed);
+			++submitted;
+
+			if (mode == Capture_Blocking) {
+				blocking.mapped = 0;
+				size_t size = (size_t)blocking.bytesPerRow * height;
+				wgpuBufferMapAsync(blocking.buffer, WGPUMapMode_Read, 0, size, onBlockingMapped, &blocking.mapped);
+				while (blocking.mapped == 0) benchTick(device);
+				if (blocking.mapped > 0) {
+					uint8_t const * pixels = (uint8_t const *)wgpuBufferGetConstMappedRange(blocking.buffer, 0, size);
+					consumeFrame(&stats, pixels, width, height, blocking.bytesPerRow, frame);
+					wgpuBufferUnmap(blocking.buffer);
+				}
+			} else if (mode == Capture_Queued) {
+				readbackQueueAfterSubmit(readback);
+				benchTick(device);
+				readbackQueuePoll(readback);
+			}
+		}
+		while (completed < submitted) benchTick(device);
+		double elapsed = benchNow() - start;
+
+		uint64_t dropped = 0;
+		if (readback) {
+			readbackQueueWait(readback);
+			dropped = readback->droppedCount;
+			readbackQueueRelease(readback);
+		}
+		printf("%16s %10.3f %10.1f %10llu %10llu\n", modeNames[mode], elapsed / frameCount * 1e3, frameCount / elapsed, (unsigned long long)stats.captured, (unsigned long long)dropped);
+		if (stats.wrongColor > 0) {
+			fprintf(stderr, "%llu frames read back with the color of another frame\n", (unsigned long long)stats.wrongColor);
+		}
+	}
+
+	wgpuBufferRelease(blocking.buffer);
+	wgpuTextureViewRelease(targetView);
+	wgpuTextureRelease(target);
+	benchGpuRelease(&gpu);
+	return 0;
+}
@@ -0,0 +1,159 @@
+/**
+ * Compare, for each kind of texture (see texture-cache.h) and compression
+ * family, the time to import a JPEG into its KTX2 cache, to load the
+ * cache again and to upload it, with the GPU memory and the quality
+ * (PSNR of level 0 against the decoded JPEG) of the result. Uploads are
+ * only measured for the families the adapter supports; imports and loads
+ * run on the CPU for all of them.
+ *
+ * Each texture is copied to texture-cache-bench.jpg in the working
+ * directory first, so that the caches are written there. Textures are
+ * the baseline JPEGs of the tutorial by default.
+ *
+ * Usage: TextureCacheBench [path...]
+ */
+
+#include <webgpu/webgpu.h>
+#include "bench-utils.h"
+#include "block-compression.h"
+#include "jpeg-decoder.h"
+#include "mapped-file.h"
+#include "texture-cache.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_PATH "texture-cache-bench.jpg"
+
+static char const * const defaultTextures[] = {
+	TUTORIAL_DOWNLOADS_DIR "/56f71f3c8d42e16a26b651e739608565/autumn_park_4k.jpg",
+	TUTORIAL_DOWNLOADS_DIR "/c69c56204b32f85418889a40235cf7f5/cobblestone_floor_08_diff_2k.jpg",
+};
+
+static char const * const kindNames[TextureCacheKind_Count] = { "color", "color-compact", "linear", "normal" };
+static char const * const compressionNames[TextureCompression_Count] = { "none", "etc2", "bc" };
+
+static bool copyFile(char const * from, char const * to) {
+	struct MappedFile * source = mappedFileOpen(from);
+	if (!source) return false;
+	FILE * file = fopen(to, "wb");
+	bool ok = file && fwrite(source->data, 1, source->size, file) == source->size;
+	ok = file && fclose(file) == 0 && ok;
+	mappedFileClose(source);
+	return ok;
+}
+
+static bool blockFormatOf(WGPUTextureFormat format, enum BlockFormat * blockFormat) {
+	switch (format) {
+	case WGPUTextureFormat_BC1RGBAUnormSrgb: *blockFormat = BlockFormat_BC1; return true;
+	case WGPUTextureFormat_BC5RGUnorm: *blockFormat = BlockFormat_BC5; return true;
+	case WGPUTextureFormat_BC7RGBAUnorm:
+	case WGPUTextureFormat_BC7RGBAUnormSrgb: *blockFormat = BlockFormat_BC7; return true;
+	case WGPUTextureFormat_ETC2RGB8Unorm:
+	case WGPUTextureFormat_ETC2RGB8UnormSrgb: *blockFormat = BlockFormat_ETC2RGB8; return true;
+	case WGPUTextureFormat_EACRG11Unorm: *blockFormat = BlockFormat_EACRG11; return true;
+	default: return false;
+	}
+}
+
+/**
+ * PSNR of level 0 of `cache` against `pixels`, over the channels its
+ * format stores, or INFINITY when it is stored as is.
+ */
+static double levelPsnr(struct TextureCache const * cache, uint8_t const * pixels) {
+	enum BlockFormat format;
+	if (!blockFormatOf(cache->format, &format)) return INFINITY;
+	uint32_t channels = format == BlockFormat_BC5 || format == BlockFormat_EACRG11 ? 2 : 3;
+	uint32_t blocksWide = (cache->width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	uint32_t blocksHigh = (cache->height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	uint8_t const * blocks = (uint8_t const *)cache->levels[0];
+	double squaredError = 0.0;
+	for (uint32_t by = 0; by < blocksHigh; ++by) {
+		for (uint32_t bx = 0; bx < blocksWide; ++bx) {
+			uint8_t texels[BLOCK_SIZE * BLOCK_SIZE * 4];
+			blockDecompress(format, blocks + ((size_t)by * blocksWide + bx) * blockFormatSize(format), texels);
+			for (uint32_t y = 0; y < BLOCK_SIZE; ++y) {
+				for (uint32_t x = 0; x < BLOCK_SIZE; ++x) {
+					size_t source = ((size_t)(by * BLOCK_SIZE + y) * cache->width + bx * BLOCK_SIZE + x) * 4;
+					for (uint32_t c = 0; c < channels; ++c) {
+						double d = (double)texels[4 * (y * BLOCK_SIZE + x) + c] - (double)pixels[source + c];
+						squaredError += d * d;
+					}
+				}
+			}
+		}
+	}
+	double meanError = squaredError / ((double)cache->width * cache->height * channels);
+	return meanError > 0.0 ? 10.0 * log10(255.0 * 255.0 / meanError) : INFINITY;
+}
+
+int main(int argc, char** argv) {
+	char const * const * paths = argc > 1 ? (char const * const *)(argv + 1) : defaultTextures;
+	int pathCount = argc > 1 ? argc - 1 : (int)(sizeof(defaultTextures) / sizeof(defaultTextures[0]));
+
+	struct BenchGpu gpu;
+	if (!benchGpuCreate(&gpu, DeviceProfile_Production)) return 1;
+	WGPUDevice device = gpu.device;
+	WGPUQueue queue = gpu.queue;
+	bool supported[TextureCompression_Count] = {
+		true,
+		wgpuDeviceHasFeature(device, WGPUFeatureName_TextureCompressionETC2),
+		wgpuDeviceHasFeature(device, WGPUFeatureName_TextureCompressionBC),
+	};
+	printf("device compression: %s\n", compressionNames[textureCompressionOf(device)]);
+
+	for (int i = 0; i < pathCount; ++i) {
+		struct MappedFile * file = mappedFileOpen(paths[i]);
+		uint32_t width, height;
+		uint8_t * pixels = file && file->data ? jpegDecode(file->data, file->size, &width, &height) : NULL;
+		mappedFileClose(file);
+		if (!pixels || !copyFile(paths[i], BENCH_PATH)) {
+			fprintf(stderr, "Could not load %s\n", paths[i]);
+			return 1;
+		}
+		printf("%s (%ux%u)\n", paths[i], width, height);
+		printf("%-14s %-5s %10s %10s %10s %8s %8s\n", "kind", "comp", "import", "load", "upload", "GPU MB", "PSNR");
+
+		for (int kind = 0; kind < TextureCacheKind_Count; ++kind) {
+			for (int compression = 0; compression < TextureCompression_Count; ++compression) {
+				// Remove the cache of a previous run so that the first load imports
+				char cachePath[sizeof(BENCH_PATH) + 32];
+				snprintf(cachePath, sizeof(cachePath), "%s%s", BENCH_PATH, textureCacheExtension((enum TextureCacheKind)kind, (enum TextureCompression)compression));
+				remove(cachePath);
+
+				double start = benchNow();
+				struct TextureCache * cache = textureCacheLoad(BENCH_PATH, (enum TextureCacheKind)kind, (enum TextureCompression)compression, 0);
+				double importTime = benchNow() - start;
+				if (!cache) return 1;
+				textureCacheRelease(cache);
+				start = benchNow();
+				cache = textureCacheLoad(BENCH_PATH, (enum TextureCacheKind)kind, (enum TextureCompression)compression, 0);
+				double loadTime = benchNow() - start;
+				if (!cache) return 1;
+
+				double uploadTime = NAN;
+				if (supported[compression]) {
+					start = benchNow();
+					WGPUTexture texture = textureCacheCreateTexture(device, queue, cache, "Bench texture");
+					benchWaitForQueue(device, queue);
+					uploadTime = benchNow() - start;
+					wgpuTextureDestroy(texture);
+					wgpuTextureRelease(texture);
+				}
+				uint64_t gpuBytes = 0;
+				for (uint32_t level = 0; level < cache->levelCount; ++level) gpuBytes += cache->levelSizes[level];
+				printf("%-14s %-5s %7.1f ms %7.2f ms %7.1f ms %8.1f %8.1f\n", kindNames[kind], compressionNames[compression],
+					importTime * 1e3, loadTime * 1e3, uploadTime * 1e3, (double)gpuBytes * 1e-6, levelPsnr(cache, pixels));
+				textureCacheRelease(cache);
+				remove(cachePath);
+			}
+		}
+		free(pixels);
+	}
+
+	remove(BENCH_PATH);
+	benchGpuRelease(&gpu);
+	return 0;
+}
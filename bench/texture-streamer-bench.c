@@ -0,0 +1,209 @@
+/**
+ * Compare the frame hitches of loading textures synchronously (decoding
+ * the file, building the mip chain and writing it whole with
+ * wgpuQueueWriteTexture, all on the main thread) and with the texture
+ * streamer (see texture-streamer.h), which runs frames at 60 Hz while
+ * workers decode. Reports the longest frame of each and, for the
+ * streamer, when all textures became usable and fully resident. Textures
+ * are the baseline JPEGs of the tutorial by default, each loaded
+ * TEXTURE_COPIES times as a scene would.
+ *
+ * Usage: TextureStreamerBench [path...]
+ */
+
+#include <webgpu/webgpu.h>
+#include "bench-utils.h"
+#include "jpeg-decoder.h"
+#include "mapped-file.h"
+#include "mipmap-generator.h"
+#include "texture-streamer.h"
+
+#include <tinycthread.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TEXTURE_COPIES 4
+#define FRAME_SECONDS (1.0 / 60.0)
+
+static char const * const defaultTextures[] = {
+	TUTORIAL_DOWNLOADS_DIR "/56f71f3c8d42e16a26b651e739608565/autumn_park_4k.jpg",
+	TUTORIAL_DOWNLOADS_DIR "/c69c56204b32f85418889a40235cf7f5/cobblestone_floor_08_diff_2k.jpg",
+};
+
+/**
+ * Whether the decoder rejects Huffman tables with more codes of a length
+ * than fit in its bits (255 of length 1, or 5 of length 2), which must
+ * not touch memory out of its tables.
+ */
+static bool rejectsMalformedTables(void) {
+	for (uint32_t length = 1; length <= 2; ++length) {
+		uint8_t jpeg[2 + 4 + 17 + 255 + 13 + 2];
+		memset(jpeg, 0, sizeof(jpeg));
+		uint8_t * p = jpeg;
+		*p++ = 0xff; *p++ = 0xd8; // SOI
+		uint32_t codeCount = length == 1 ? 255 : 5;
+		uint32_t segmentLength = 2 + 17 + codeCount;
+		*p++ = 0xff; *p++ = 0xc4; // DHT
+		*p++ = (uint8_t)(segmentLength >> 8); *p++ = (uint8_t)segmentLength;
+		*p++ = 0x00; // DC table 0
+		p[length - 1] = (uint8_t)codeCount;
+		p += 16 + codeCount; // counts, then symbols 0
+		uint8_t const frame[13] = { 0xff, 0xc0, 0, 11, 8, 0, 8, 0, 8, 1, 1, 0x11, 0 }; // SOF0, 8x8 gray
+		memcpy(p, frame, sizeof(frame));
+		p += sizeof(frame);
+		*p++ = 0xff; *p++ = 0xd9; // EOI
+		size_t size = (size_t)(p - jpeg);
+
+		uint32_t width, height;
+		uint8_t * pixels = jpegDecode(jpeg, size, &width, &height);
+		bool rejected = !jpegReadSize(jpeg, size, &width, &height) && !pixels;
+		free(pixels);
+		if (!rejected) return false;
+	}
+	return true;
+}
+
+/**
+ * Load a texture the naive way, returning the texture or NULL.
+ */
+static WGPUTexture loadSynchronously(WGPUDevice device, WGPUQueue queue, char const * path) {
+	struct MappedFile * file = mappedFileOpen(path);
+	if (!file) return NULL;
+	uint32_t width, height;
+	uint8_t * pixels = jpegDecode(file->data, file->size, &width, &height);
+	mappedFileClose(file);
+	if (!pixels) return NULL;
+
+	WGPUTextureDescriptor desc = (WGPUTextureDescriptor) {};
+	desc.nextInChain = NULL;
+	desc.label = path;
+	desc.usage = WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst;
+	desc.dimension = WGPUTextureDimension_2D;
+	desc.size = (WGPUExtent3D) { width, height, 1 };
+	desc.format = WGPUTextureFormat_RGBA8UnormSrgb;
+	desc.mipLevelCount = mipmapLevelCount(width, height);
+	desc.sampleCount = 1;
+	desc.viewFormatCount = 0;
+	desc.viewFormats = NULL;
+	WGPUTexture texture = wgpuDeviceCreateTexture(device, &desc);
+
+	// Box-filtered chain, in place, as a plain loader would
+	uint8_t * level = pixels;
+	for (uint32_t l = 0; l < desc.mipLevelCount; ++l) {
+		uint32_t w = width >> l > 0 ? width >> l : 1;
+		uint32_t h = height >> l > 0 ? height >> l : 1;
+		if (l > 0) {
+			uint32_t pw = width >> (l - 1) > 0 ? width >> (l - 1) : 1;
+			uint32_t ph = height >> (l - 1) > 0 ? height >> (l - 1) : 1;
+			for (uint32_t y = 0; y < h; ++y) {
+				for (uint32_t x = 0; x < w; ++x) {
+					for (uint32_t c = 0; c < 4; ++c) {
+						uint32_t x0 = 2 * x < pw ? 2 * x : pw - 1, x1 = 2 * x + 1 < pw ? 2 * x + 1 : pw - 1;
+						uint32_t y0 = 2 * y < ph ? 2 * y : ph - 1, y1 = 2 * y + 1 < ph ? 2 * y + 1 : ph - 1;
+						uint32_t sum = level[(y0 * pw + x0) * 4 + c] + level[(y0 * pw + x1) * 4 + c] + level[(y1 * pw + x0) * 4 + c] + level[(y1 * pw + x1) * 4 + c];
+						level[(y * w + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+					}
+				}
+			}
+		}
+		WGPUImageCopyTexture destination = (WGPUImageCopyTexture) {};
+		destination.texture = texture;
+		destination.mipLevel = l;
+		destination.origin = (WGPUOrigin3D) { 0, 0, 0 };
+		destination.aspect = WGPUTextureAspect_All;
+		WGPUTextureDataLayout layout = (WGPUTextureDataLayout) {};
+		layout.offset = 0;
+		layout.bytesPerRow = 4 * w;
+		layout.rowsPerImage = h;
+		WGPUExtent3D size = (WGPUExtent3D) { w, h, 1 };
+		wgpuQueueWriteTexture(queue, &destination, level, (size_t)w * h * 4, &layout, &size);
+	}
+	free(pixels);
+	return texture;
+}
+
+int main(int argc, char** argv) {
+	char const * const * paths = argc > 1 ? (char const * const *)(argv + 1) : defaultTextures;
+	int pathCount = argc > 1 ? argc - 1 : (int)(sizeof(defaultTextures) / sizeof(defaultTextures[0]));
+
+	if (!rejectsMalformedTables()) {
+		fprintf(stderr, "The JPEG decoder accepts malformed Huffman tables\n");
+		return 1;
+	}
+
+	struct BenchGpu gpu;
+	if (!benchGpuCreate(&gpu, DeviceProfile_Production)) return 1;
+	WGPUDevice device = gpu.device;
+	WGPUQueue queue = gpu.queue;
+
+	// Synchronous: every texture is one long frame
+	double longestSync = 0.0;
+	double totalSync = 0.0;
+	for (int copy = 0; copy < TEXTURE_COPIES; ++copy) {
+		for (int i = 0; i < pathCount; ++i) {
+			double start = benchNow();
+			WGPUTexture texture = loadSynchronously(device, queue, paths[i]);
+			wgpuQueueSubmit(queue, 0, NULL);
+			double elapsed = benchNow() - start;
+			if (!texture) {
+				fprintf(stderr, "Could not load %s\n", paths[i]);
+				return 1;
+			}
+			if (elapsed > longestSync) longestSync = elapsed;
+			totalSync += elapsed;
+			benchWaitForQueue(device, queue);
+			wgpuTextureDestroy(texture);
+			wgpuTextureRelease(texture);
+		}
+	}
+	printf("synchronous: %d textures in %.1f ms, longest frame %.1f ms\n", TEXTURE_COPIES * pathCount, totalSync * 1e3, longestSync * 1e3);
+
+	// Streamed: frames keep running while the textures come in
+	struct TextureStreamer * streamer = textureStreamerCreate(device, 0, 0, 0);
+	if (!streamer) return 1;
+	struct StreamedTexture ** textures = (struct StreamedTexture **)malloc(sizeof(struct StreamedTexture *) * TEXTURE_COPIES * pathCount);
+	double start = benchNow();
+	for (int copy = 0; copy < TEXTURE_COPIES; ++copy) {
+		for (int i = 0; i < pathCount; ++i) {
+			textures[copy * pathCount + i] = textureStreamerLoad(streamer, paths[i], true);
+		}
+	}
+	double longestFrame = 0.0;
+	double usableTime = 0.0;
+	uint32_t frames = 0;
+	while (streamer->pendingCount > 0) {
+		double frameStart = benchNow();
+		textureStreamerUpdate(streamer);
+		wgpuQueueSubmit(queue, 0, NULL);
+#ifdef WEBGPU_BACKEND_DAWN
+		wgpuDeviceTick(device);
+#endif
+		double frameEnd = benchNow();
+		if (frameEnd - frameStart > longestFrame) longestFrame = frameEnd - frameStart;
+		++frames;
+
+		bool usable = true;
+		for (int i = 0; i < TEXTURE_COPIES * pathCount; ++i) {
+			usable = usable && textures[i]->state != StreamedTexture_Loading;
+		}
+		if (usable && usableTime == 0.0) usableTime = frameEnd - start;
+
+		double remaining = FRAME_SECONDS - (benchNow() - frameStart);
+		if (remaining > 0.0) {
+			struct timespec duration = { 0, (long)(remaining * 1e9) };
+			thrd_sleep(&duration, NULL);
+		}
+	}
+	benchWaitForQueue(device, queue);
+	double residentTime = benchNow() - start;
+	printf("streamed:    %d textures usable after %.1f ms, resident after %.1f ms (%u frames), longest frame %.2f ms, %.1f MB uploaded\n",
+		TEXTURE_COPIES * pathCount, usableTime * 1e3, residentTime * 1e3, frames, longestFrame * 1e3, (double)streamer->uploadedBytes * 1e-6);
+
+	free(textures);
+	textureStreamerRelease(streamer);
+	benchGpuRelease(&gpu);
+	return 0;
+}
@@ -0,0 +1,57 @@
+/**
+ * Report what quantizing the vertices of OBJ meshes (see
+ * vertex-quantization.h) saves and costs: the vertex size before and
+ * after, the largest error of each attribute, and the time to quantize.
+ * Meshes are the ones of the tutorial by default.
+ *
+ * Usage: VertexQuantizationBench [path...]
+ */
+
+#include "bench-utils.h"
+#include "vertex-quantization.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static char const * const defaultMeshes[] = {
+	TUTORIAL_DOWNLOADS_DIR "/b029881ac5773fe32220cedfa2ed3397/suzanne.obj",
+	TUTORIAL_DOWNLOADS_DIR "/bc824d0b5d89c824c50c5cbe0bba5c19/quad-input.obj",
+	TUTORIAL_DOWNLOADS_DIR "/0e38411683f6c2ab2fc32cdba6c43686/pyramid.obj",
+	TUTORIAL_DOWNLOADS_DIR "/a807bbb5c9ad69e555e25d70b1fcf26e/cylinder.obj",
+};
+
+int main(int argc, char** argv) {
+	char const * const * paths = argc > 1 ? (char const * const *)(argv + 1) : defaultMeshes;
+	int pathCount = argc > 1 ? argc - 1 : (int)(sizeof(defaultMeshes) / sizeof(defaultMeshes[0]));
+
+	printf("%-16s %9s %11s %17s %14s %12s %10s %9s\n", "mesh", "vertices", "bytes/vtx", "KB", "position err", "normal err", "uv err", "time");
+	for (int i = 0; i < pathCount; ++i) {
+		struct ObjMesh * mesh = objMeshLoad(paths[i], 0);
+		if (!mesh) continue;
+		double start = benchNow();
+		struct QuantizedVertices * q = quantizeObjMesh(mesh);
+		double elapsed = benchNow() - start;
+		if (!q) return 1;
+
+		// Position error relative to the diagonal of the bounds
+		float diagonal = 0.0f;
+		for (uint32_t k = 0; k < 3; ++k) {
+			float extent = mesh->boundsMax[k] - mesh->boundsMin[k];
+			diagonal += extent * extent;
+		}
+		diagonal = sqrtf(diagonal);
+		char const * name = paths[i];
+		for (char const * c = paths[i]; *c; ++c) {
+			if (*c == '/' || *c == '\\') name = c + 1;
+		}
+		printf("%-16s %9u %5u -> %-3u %7.1f -> %-7.1f %13.4f%% %9.4f deg %10.2e %6.2f ms\n", name, mesh->vertexCount,
+			(uint32_t)sizeof(struct ObjVertex), q->stride,
+			(double)mesh->vertexCount * sizeof(struct ObjVertex) * 1e-3, (double)q->vertexCount * q->stride * 1e-3,
+			diagonal > 0.0f ? 100.0f * q->positionError / diagonal : 0.0f, q->normalError, q->texcoordError, elapsed * 1e3);
+
+		quantizedVerticesRelease(q);
+		objMeshRelease(mesh);
+	}
+	return 0;
+}
@@ -0,0 +1,186 @@
+/**
+ * Measure the frame rate of video capture (see video-capture.h) against
+ * the same frames without capture. Each frame clears an offscreen target
+ * to a color changing over time, with up to 2 frames in flight as with a
+ * swap chain, and the capture is written to `path`. The first luma sample
+ * of every frame of the file is then checked against the expected color.
+ *
+ * Usage: VideoCaptureBench [frameCount] [width] [height] [path]
+ */
+
+#include <webgpu/webgpu.h>
+#include "bench-utils.h"
+#include "video-capture.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAMES_IN_FLIGHT 2
+
+static WGPUColor frameColor(uint32_t frame) {
+	double t = (double)(frame % 120) / 119.0;
+	return (WGPUColor) { t, 1.0 - t, 0.5, 1.0 };
+}
+
+/**
+ * BT.709 limited range luma, as computed by the conversion shader.
+ */
+static int expectedLuma(WGPUColor color) {
+	return (int)lround(16.0 + 219.0 * (0.2126 * color.r + 0.7152 * color.g + 0.0722 * color.b));
+}
+
+/**
+ * Render `frameCount` frames, captured if `capture` is not NULL. Returns
+ * the elapsed time in seconds.
+ */
+static double renderFrames(WGPUDevice device, WGPUQueue queue, WGPUTextureView target, uint32_t frameCount, struct VideoCapture * capture) {
+	uint64_t submitted = 0;
+	uint64_t completed = 0;
+	double start = benchNow();
+	for (uint32_t frame = 0; frame < frameCount; ++frame) {
+		// What presenting does: wait for the oldest frame in flight
+		while (submitted - completed >= FRAMES_IN_FLIGHT) benchTick(device);
+
+		WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, NULL);
+		WGPURenderPassColorAttachment attachment = (WGPURenderPassColorAttachment) {};
+		attachment.view = target;
+		attachment.resolveTarget = NULL;
+		attachment.loadOp = WGPULoadOp_Clear;
+		attachment.storeOp = WGPUStoreOp_Store;
+		attachment.clearValue = frameColor(frame);
+		WGPURenderPassDescriptor renderPassDesc = (WGPURenderPassDescriptor) {};
+		renderPassDesc.nextInChain = NULL;
+		renderPassDesc.colorAttachmentCount = 1;
+		renderPassDesc.colorAttachments = &attachment;
+		renderPassDesc.depthStencilAttachment = NULL;
+		renderPassDesc.timestampWriteCount = 0;
+		renderPassDesc.timestampWrites = NULL;
+		WGPURenderPassEncoder renderPass = wgpuCommandEncoderBeginRenderPass(encoder, &renderPassDesc);
+		wgpuRenderPassEncoderEnd(renderPass);
+		wgpuRenderPassEncoderRelease(renderPass);
+		if (capture) {
+			videoCaptureEncodeFrame(capture, encoder, target);
+		}
+
+		WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, NULL);
+		wgpuQueueSubmit(queue, 1, &command);
+		wgpuCommandBufferRelease(command);
+		wgpuCommandEncoderRelease(encoder);
+		wgpuQueueOnSubmittedWorkDone(queue, 0, benchCountWorkDone, &completed);
+		++submitted;
+
+		if (capture) {
+			videoCaptureAfterSubmit(capture);
+			benchTick(device);
+			videoCapturePoll(capture);
+		}
+	}
+	while (completed < submitted) benchTick(device);
+	return benchNow() - start;
+}
+
+/**
+ * Check the header and the first luma sample of each frame of the file.
+ * Returns the number of frames in the file, or -1 if it is malformed.
+ */
+static long checkCapture(char const * path, uint32_t width, uint32_t height, uint32_t frameCount, uint32_t * wrongFrames) {
+	FILE * file = fopen(path, "rb");
+	if (!file) return -1;
+	char header[256];
+	if (!fgets(header, sizeof(header), file) || strncmp(header, "YUV4MPEG2 ", 10) != 0) {
+		fclose(file);
+		return -1;
+	}
+	size_t frameSize = (size_t)width * height + 2 * (size_t)((width + 1) / 2) * ((height + 1) / 2);
+	unsigned char * frame = (unsigned char *)malloc(frameSize);
+	char frameHeader[6];
+	long frames = 0;
+	*wrongFrames = 0;
+	while (fread(frameHeader, 1, 6, file) == 6) {
+		if (memcmp(frameHeader, "FRAME\n", 6) != 0 || fread(frame, 1, frameSize, file) != frameSize) {
+			frames = -1;
+			break;
+		}
+		// Dropped frames shift the index, so compare with the closest match
+		// among the frames that could have been captured at this point
+		bool found = false;
+		for (uint32_t f = (uint32_t)frames; f < frameCount && !found; ++f) {
+			found = abs(frame[0] - expectedLuma(frameColor(f))) <= 1;
+		}
+		if (!found) ++*wrongFrames;
+		++frames;
+	}
+	free(frame);
+	fclose(file);
+	return frames;
+}
+
+int main(int argc, char** argv) {
+	uint32_t frameCount = argc > 1 ? (uint32_t)atoi(argv[1]) : 600;
+	uint32_t width = argc > 2 ? (uint32_t)atoi(argv[2]) : 1920;
+	uint32_t height = argc > 3 ? (uint32_t)atoi(argv[3]) : 1080;
+	char const * path = argc > 4 ? argv[4] : "video-capture-bench.y4m";
+	if (frameCount == 0 || width == 0 || height == 0) {
+		fprintf(stderr, "Usage: %s [frameCount] [width] [height] [path]\n", argv[0]);
+		return 1;
+	}
+
+	struct BenchGpu gpu;
+	if (!benchGpuCreate(&gpu, DeviceProfile_Production)) return 1;
+	WGPUDevice device = gpu.device;
+	WGPUQueue queue = gpu.queue;
+
+	WGPUTextureDescriptor targetDesc = (WGPUTextureDescriptor) {};
+	targetDesc.nextInChain = NULL;
+	targetDesc.label = "Offscreen target";
+	targetDesc.usage = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_TextureBinding;
+	targetDesc.dimension = WGPUTextureDimension_2D;
+	targetDesc.size = (WGPUExtent3D) { width, height, 1 };
+	targetDesc.format = WGPUTextureFormat_RGBA8Unorm;
+	targetDesc.mipLevelCount = 1;
+	targetDesc.sampleCount = 1;
+	targetDesc.viewFormatCount = 0;
+	targetDesc.viewFormats = NULL;
+	WGPUTexture target = wgpuDeviceCreateTexture(device, &targetDesc);
+	WGPUTextureView targetView = wgpuTextureCreateView(target, NULL);
+
+	struct VideoCaptureDesc captureDesc = (struct VideoCaptureDesc) {};
+	captureDesc.path = path;
+	captureDesc.width = width;
+	captureDesc.height = height;
+	captureDesc.format = targetDesc.format;
+	captureDesc.fpsNumerator = 60;
+	captureDesc.fpsDenominator = 1;
+	captureDesc.scheduler = NULL;
+	struct VideoCapture * capture = videoCaptureCreate(device, &captureDesc);
+	if (!capture) return 1;
+
+	// Warm-up, which also compiles the conversion pipeline
+	renderFrames(device, queue, targetView, 10, NULL);
+	double uncaptured = renderFrames(device, queue, targetView, frameCount, NULL);
+	double captured = renderFrames(device, queue, targetView, frameCount, capture);
+	uint64_t capturedFrames = capture->capturedFrames;
+	uint64_t droppedFrames = capture->droppedFrames;
+	double flushStart = benchNow();
+	bool written = videoCaptureRelease(capture);
+	double flush = benchNow() - flushStart;
+
+	double frameBytes = (double)width * height * 1.5;
+	printf("%ux%u, %u frames, %d in flight\n", width, height, frameCount, FRAMES_IN_FLIGHT);
+	printf("%-16s %10.1f fps\n", "no capture", frameCount / uncaptured);
+	printf("%-16s %10.1f fps, %llu frames written, %llu dropped, %.1f MB/s, %.1f ms to flush\n", "capture", frameCount / captured,
+		(unsigned long long)capturedFrames, (unsigned long long)droppedFrames, capturedFrames * frameBytes / (captured + flush) * 1e-6, flush * 1e3);
+
+	uint32_t wrongFrames = 0;
+	long fileFrames = written ? checkCapture(path, width, height, frameCount, &wrongFrames) : -1;
+	if (fileFrames != (long)capturedFrames || wrongFrames > 0) {
+		fprintf(stderr, "Capture file is wrong: %ld frames (expected %llu), %u with unexpected colors\n", fileFrames, (unsigned long long)capturedFrames, wrongFrames);
+	}
+
+	wgpuTextureViewRelease(targetView);
+	wgpuTextureRelease(target);
+	benchGpuRelease(&gpu);
+	return fileFrames == (long)capturedFrames && wrongFrames == 0 ? 0 : 1;
+}
@@ -0,0 +1,848 @@
+#include "block-compression.h"
+
+#include <tinycthread.h>
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t roundClamp(float x, uint32_t max) {
+	if (!(x > 0.0f)) return 0;
+	uint32_t value = (uint32_t)(x + 0.5f);
+	return value < max ? value : max;
+}
+
+static int clampInt(int x, int low, int high) {
+	return x < low ? low : (x > high ? high : x);
+}
+
+uint32_t blockFormatSize(enum BlockFormat format) {
+	switch (format) {
+	case BlockFormat_BC1:
+	case BlockFormat_ETC2RGB8:
+		return 8;
+	case BlockFormat_BC5:
+	case BlockFormat_BC7:
+	case BlockFormat_EACRG11:
+	default:
+		return 16;
+	}
+}
+
+uint64_t blockCompressedSize(enum BlockFormat format, uint32_t width, uint32_t height) {
+	uint64_t blocksWide = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	uint64_t blocksHigh = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	return blocksWide * blocksHigh * blockFormatSize(format);
+}
+
+// Endpoint fitting
+
+/**
+ * Mean and principal axis (unit length, or 0 when all points are equal)
+ * of 16 points of `channels` floats, by power iteration on their
+ * covariance.
+ */
+static void principalAxis(float const * points, uint32_t channels, float * mean, float * axis) {
+	float covariance[4][4] = { { 0 } };
+	for (uint32_t c = 0; c < channels; ++c) {
+		mean[c] = 0.0f;
+		for (uint32_t i = 0; i < 16; ++i) mean[c] += points[i * channels + c];
+		mean[c] /= 16.0f;
+	}
+	for (uint32_t i = 0; i < 16; ++i) {
+		for (uint32_t a = 0; a < channels; ++a) {
+			for (uint32_t b = 0; b < channels; ++b) {
+				covariance[a][b] += (points[i * channels + a] - mean[a]) * (points[i * channels + b] - mean[b]);
+			}
+		}
+	}
+	float vector[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	// Start from the widest channel, so that a gray axis is not orthogonal
+	for (uint32_t c = 0; c < channels; ++c) vector[c] = covariance[c][c] + 1e-3f;
+	float length = 0.0f;
+	for (uint32_t iteration = 0; iteration < 8; ++iteration) {
+		float next[4] = { 0 };
+		for (uint32_t a = 0; a < channels; ++a) {
+			for (uint32_t b = 0; b < channels; ++b) next[a] += covariance[a][b] * vector[b];
+		}
+		length = 0.0f;
+		for (uint32_t c = 0; c < channels; ++c) length += next[c] * next[c];
+		length = sqrtf(length);
+		if (length < 1e-6f) break;
+		for (uint32_t c = 0; c < channels; ++c) vector[c] = next[c] / length;
+	}
+	for (uint32_t c = 0; c < channels; ++c) axis[c] = length < 1e-6f ? 0.0f : vector[c];
+}
+
+/**
+ * Endpoints of the segment of the principal axis covering all points.
+ */
+static void fitEndpoints(float const * points, uint32_t channels, float * low, float * high) {
+	float mean[4], axis[4];
+	principalAxis(points, channels, mean, axis);
+	float minT = 0.0f, maxT = 0.0f;
+	for (uint32_t i = 0; i < 16; ++i) {
+		float t = 0.0f;
+		for (uint32_t c = 0; c < channels; ++c) t += (points[i * channels + c] - mean[c]) * axis[c];
+		if (t < minT) minT = t;
+		if (t > maxT) maxT = t;
+	}
+	for (uint32_t c = 0; c < channels; ++c) {
+		low[c] = mean[c] + minT * axis[c];
+		high[c] = mean[c] + maxT * axis[c];
+	}
+}
+
+/**
+ * Endpoints minimizing the squared error of points interpolated with
+ * `weights` (0 at `low`, 1 at `high`). Leaves them as is when all the
+ * weights are equal.
+ */
+static void refineEndpoints(float const * points, uint32_t channels, float const * weights, float * low, float * high) {
+	float a = 0.0f, b = 0.0f, c = 0.0f;
+	float x[4] = { 0 }, y[4] = { 0 };
+	for (uint32_t i = 0; i < 16; ++i) {
+		float w = weights[i];
+		a += (1.0f - w) * (1.0f - w);
+		b += (1.0f - w) * w;
+		c += w * w;
+		for (uint32_t k = 0; k < channels; ++k) {
+			x[k] += (1.0f - w) * points[i * channels + k];
+			y[k] += w * points[i * channels + k];
+		}
+	}
+	float determinant = a * c - b * b;
+	if (fabsf(determinant) < 1e-6f) return;
+	for (uint32_t k = 0; k < channels; ++k) {
+		low[k] = (c * x[k] - b * y[k]) / determinant;
+		high[k] = (a * y[k] - b * x[k]) / determinant;
+	}
+}
+
+// BC1
+
+static uint16_t packRgb565(float const * color) {
+	return (uint16_t)((roundClamp(color[0] * 31.0f / 255.0f, 31) << 11) | (roundClamp(color[1] * 63.0f / 255.0f, 63) << 5) | roundClamp(color[2] * 31.0f / 255.0f, 31));
+}
+
+static void unpackRgb565(uint16_t color, int * rgb) {
+	int r = color >> 11, g = (color >> 5) & 63, b = color & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+/**
+ * Opaque 4-color palette: both endpoints then the colors at 1/3 and 2/3.
+ */
+static void bc1Palette(uint16_t color0, uint16_t color1, int palette[4][3]) {
+	unpackRgb565(color0, palette[0]);
+	unpackRgb565(color1, palette[1]);
+	for (int c = 0; c < 3; ++c) {
+		palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	}
+}
+
+/**
+ * Nearest palette entry of each texel, and the total squared error.
+ */
+static uint32_t bc1Indices(uint8_t const * texels, uint16_t color0, uint16_t color1, uint8_t * indices) {
+	int palette[4][3];
+	bc1Palette(color0, color1, palette);
+	uint32_t error = 0;
+	for (uint32_t i = 0; i < 16; ++i) {
+		uint32_t bestError = UINT32_MAX;
+		for (uint8_t k = 0; k < 4; ++k) {
+			uint32_t e = 0;
+			for (int c = 0; c < 3; ++c) {
+				int d = palette[k][c] - texels[4 * i + c];
+				e += (uint32_t)(d * d);
+			}
+			if (e < bestError) {
+				bestError = e;
+				indices[i] = k;
+			}
+		}
+		error += bestError;
+	}
+	return error;
+}
+
+/**
+ * Endpoint pair of `bits` bits whose color at 1/3 is the closest to
+ * `value`, for blocks of a single color that 565 cannot represent.
+ */
+static void bc1SingleColor(int value, int bits, int * endpoint0, int * endpoint1) {
+	int max = (1 << bits) - 1;
+	int bestError = 256;
+	for (int a = 0; a <= max; ++a) {
+		int expandedA = bits == 5 ? (a << 3) | (a >> 2) : (a << 2) | (a >> 4);
+		// The color at 1/3 only needs to be a fraction of a step off `a`
+		for (int b = a > 2 ? a - 2 : 0; b <= max && b <= a + 2; ++b) {
+			int expandedB = bits == 5 ? (b << 3) | (b >> 2) : (b << 2) | (b >> 4);
+			int error = abs((2 * expandedA + expandedB) / 3 - value);
+			if (error < bestError) {
+				bestError = error;
+				*endpoint0 = a;
+				*endpoint1 = b;
+			}
+		}
+	}
+}
+
+static void compressBC1(uint8_t const * texels, uint8_t * block) {
+	static const float indexWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	bool singleColor = true;
+	for (uint32_t i = 1; i < 16 && singleColor; ++i) {
+		singleColor = texels[4 * i] == texels[0] && texels[4 * i + 1] == texels[1] && texels[4 * i + 2] == texels[2];
+	}
+	float points[16 * 3];
+	for (uint32_t i = 0; i < 16; ++i) {
+		for (uint32_t c = 0; c < 3; ++c) points[3 * i + c] = texels[4 * i + c];
+	}
+	float low[3], high[3];
+	fitEndpoints(points, 3, low, high);
+
+	uint32_t bestError = UINT32_MAX;
+	uint16_t bestColors[2] = { 0, 0 };
+	uint8_t bestIndices[16] = { 0 };
+	if (singleColor) {
+		int red[2], green[2], blue[2];
+		bc1SingleColor(texels[0], 5, &red[0], &red[1]);
+		bc1SingleColor(texels[1], 6, &green[0], &green[1]);
+		bc1SingleColor(texels[2], 5, &blue[0], &blue[1]);
+		bestColors[0] = (uint16_t)((red[0] << 11) | (green[0] << 5) | blue[0]);
+		bestColors[1] = (uint16_t)((red[1] << 11) | (green[1] << 5) | blue[1]);
+		bestError = bc1Indices(texels, bestColors[0], bestColors[1], bestIndices);
+	}
+	for (uint32_t iteration = 0; iteration < 3 && bestError > 0; ++iteration) {
+		uint16_t color0 = packRgb565(low), color1 = packRgb565(high);
+		uint8_t indices[16];
+		uint32_t error = bc1Indices(texels, color0, color1, indices);
+		if (error < bestError) {
+			bestError = error;
+			bestColors[0] = color0;
+			bestColors[1] = color1;
+			memcpy(bestIndices, indices, sizeof(indices));
+		}
+		float weights[16];
+		for (uint32_t i = 0; i < 16; ++i) weights[i] = indexWeights[indices[i]];
+		refineEndpoints(points, 3, weights, low, high);
+	}
+
+	// The first endpoint must be the greater for the opaque mode
+	if (bestColors[0] < bestColors[1]) {
+		uint16_t swap = bestColors[0];
+		bestColors[0] = bestColors[1];
+		bestColors[1] = swap;
+		for (uint32_t i = 0; i < 16; ++i) bestIndices[i] ^= 1;
+	} else if (bestColors[0] == bestColors[1]) {
+		memset(bestIndices, 0, sizeof(bestIndices));
+	}
+	uint32_t bits = 0;
+	for (uint32_t i = 0; i < 16; ++i) bits |= (uint32_t)bestIndices[i] << (2 * i);
+	block[0] = (uint8_t)bestColors[0];
+	block[1] = (uint8_t)(bestColors[0] >> 8);
+	block[2] = (uint8_t)bestColors[1];
+	block[3] = (uint8_t)(bestColors[1] >> 8);
+	for (uint32_t k = 0; k < 4; ++k) block[4 + k] = (uint8_t)(bits >> (8 * k));
+}
+
+static void decompressBC1(uint8_t const * block, uint8_t * texels) {
+	uint16_t color0 = (uint16_t)(block[0] | (block[1] << 8));
+	uint16_t color1 = (uint16_t)(block[2] | (block[3] << 8));
+	int palette[4][3];
+	bc1Palette(color0, color1, palette);
+	if (color0 <= color1) {
+		for (int c = 0; c < 3; ++c) {
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	uint32_t bits = (uint32_t)block[4] | ((uint32_t)block[5] << 8) | ((uint32_t)block[6] << 16) | ((uint32_t)block[7] << 24);
+	for (uint32_t i = 0; i < 16; ++i) {
+		uint32_t k = (bits >> (2 * i)) & 3;
+		for (int c = 0; c < 3; ++c) texels[4 * i + c] = (uint8_t)palette[k][c];
+		texels[4 * i + 3] = 255;
+	}
+}
+
+// BC4 and BC5
+
+static void bc4Palette(int value0, int value1, int palette[8]) {
+	palette[0] = value0;
+	palette[1] = value1;
+	if (value0 > value1) {
+		for (int k = 2; k < 8; ++k) palette[k] = ((8 - k) * value0 + (k - 1) * value1 + 3) / 7;
+	} else {
+		for (int k = 2; k < 6; ++k) palette[k] = ((6 - k) * value0 + (k - 1) * value1 + 2) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+/**
+ * One channel of 16 texels to a BC4 block, in the 8-level mode between
+ * the extremes of the block.
+ */
+static void compressBC4(uint8_t const * texels, uint32_t channel, uint8_t * block) {
+	int low = 255, high = 0;
+	for (uint32_t i = 0; i < 16; ++i) {
+		int value = texels[4 * i + channel];
+		if (value < low) low = value;
+		if (value > high) high = value;
+	}
+	memset(block, 0, 8);
+	block[0] = (uint8_t)high;
+	block[1] = (uint8_t)low;
+	if (high == low) return;
+	int palette[8];
+	bc4Palette(high, low, palette);
+	uint64_t bits = 0;
+	for (uint32_t i = 0; i < 16; ++i) {
+		int value = texels[4 * i + channel];
+		uint64_t best = 0;
+		int bestError = 256;
+		for (int k = 0; k < 8; ++k) {
+			int error = abs(palette[k] - value);
+			if (error < bestError) {
+				bestError = error;
+				best = (uint64_t)k;
+			}
+		}
+		bits |= best << (3 * i);
+	}
+	for (uint32_t k = 0; k < 6; ++k) block[2 + k] = (uint8_t)(bits >> (8 * k));
+}
+
+static void decompressBC4(uint8_t const * block, uint32_t channel, uint8_t * texels) {
+	int palette[8];
+	bc4Palette(block[0], block[1], palette);
+	uint64_t bits = 0;
+	for (uint32_t k = 0; k < 6; ++k) bits |= (uint64_t)block[2 + k] << (8 * k);
+	for (uint32_t i = 0; i < 16; ++i) texels[4 * i + channel] = (uint8_t)palette[(bits >> (3 * i)) & 7];
+}
+
+// BC7
+
+static const int bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct Bc7Endpoints {
+	uint32_t values[2][4]; // 7 bits
+	uint32_t pBits[2];
+};
+
+/**
+ * Quantize an RGBA endpoint to 7 bits per channel and the p-bit, shared
+ * by the channels, that is the closest.
+ */
+static void quantizeBc7Endpoint(float const * color, uint32_t * values, uint32_t * pBit) {
+	float bestError = FLT_MAX;
+	for (uint32_t p = 0; p < 2; ++p) {
+		uint32_t candidate[4];
+		float error = 0.0f;
+		for (uint32_t c = 0; c < 4; ++c) {
+			candidate[c] = roundClamp((color[c] - (float)p) * 0.5f, 127);
+			float d = (float)(candidate[c] * 2 + p) - color[c];
+			error += d * d;
+		}
+		if (error < bestError) {
+			bestError = error;
+			memcpy(values, candidate, sizeof(candidate));
+			*pBit = p;
+		}
+	}
+}
+
+static void bc7Palette(struct Bc7Endpoints const * endpoints, int palette[16][4]) {
+	for (uint32_t c = 0; c < 4; ++c) {
+		int value0 = (int)(endpoints->values[0][c] << 1 | endpoints->pBits[0]);
+		int value1 = (int)(endpoints->values[1][c] << 1 | endpoints->pBits[1]);
+		for (uint32_t k = 0; k < 16; ++k) {
+			palette[k][c] = ((64 - bc7Weights[k]) * value0 + bc7Weights[k] * value1 + 32) >> 6;
+		}
+	}
+}
+
+static uint32_t bc7Indices(uint8_t const * texels, struct Bc7Endpoints const * endpoints, uint8_t * indices) {
+	int palette[16][4];
+	bc7Palette(endpoints, palette);
+	uint32_t error = 0;
+	for (uint32_t i = 0; i < 16; ++i) {
+		uint32_t bestError = UINT32_MAX;
+		for (uint8_t k = 0; k < 16; ++k) {
+			uint32_t e = 0;
+			for (int c = 0; c < 4; ++c) {
+				int d = palette[k][c] - texels[4 * i + c];
+				e += (uint32_t)(d * d);
+			}
+			if (e < bestError) {
+				bestError = e;
+				indices[i] = k;
+			}
+		}
+		error += bestError;
+	}
+	return error;
+}
+
+struct BitWriter {
+	uint8_t * bytes;
+	uint32_t position;
+};
+
+static void writeBits(struct BitWriter * writer, uint32_t value, uint32_t count) {
+	for (uint32_t i = 0; i < count; ++i, ++writer->position) {
+		if ((value >> i) & 1) writer->bytes[writer->position >> 3] |= (uint8_t)(1 << (writer->position & 7));
+	}
+}
+
+static uint32_t readBits(uint8_t const * bytes, uint32_t * position, uint32_t count) {
+	uint32_t value = 0;
+	for (uint32_t i = 0; i < count; ++i, ++*position) {
+		value |= (uint32_t)((bytes[*position >> 3] >> (*position & 7)) & 1) << i;
+	}
+	return value;
+}
+
+static void compressBC7(uint8_t const * texels, uint8_t * block) {
+	float points[16 * 4];
+	for (uint32_t i = 0; i < 64; ++i) points[i] = texels[i];
+	float low[4], high[4];
+	fitEndpoints(points, 4, low, high);
+
+	uint32_t bestError = UINT32_MAX;
+	struct Bc7Endpoints best;
+	uint8_t bestIndices[16] = { 0 };
+	for (uint32_t iteration = 0; iteration < 3; ++iteration) {
+		struct Bc7Endpoints endpoints;
+		quantizeBc7Endpoint(low, endpoints.values[0], &endpoints.pBits[0]);
+		quantizeBc7Endpoint(high, endpoints.values[1], &endpoints.pBits[1]);
+		uint8_t indices[16];
+		uint32_t error = bc7Indices(texels, &endpoints, indices);
+		if (error < bestError) {
+			bestError = error;
+			best = endpoints;
+			memcpy(bestIndices, indices, sizeof(indices));
+		}
+		if (error == 0) break;
+		float weights[16];
+		for (uint32_t i = 0; i < 16; ++i) weights[i] = (float)bc7Weights[indices[i]] / 64.0f;
+		refineEndpoints(points, 4, weights, low, high);
+	}
+
+	// The index of the first texel is stored without its high bit
+	if (bestIndices[0] >= 8) {
+		struct Bc7Endpoints swapped;
+		memcpy(swapped.values[0], best.values[1], sizeof(swapped.values[0]));
+		memcpy(swapped.values[1], best.values[0], sizeof(swapped.values[1]));
+		swapped.pBits[0] = best.pBits[1];
+		swapped.pBits[1] = best.pBits[0];
+		best = swapped;
+		for (uint32_t i = 0; i < 16; ++i) bestIndices[i] = (uint8_t)(15 - bestIndices[i]);
+	}
+	memset(block, 0, 16);
+	struct BitWriter writer = { block, 0 };
+	writeBits(&writer, 1 << 6, 7); // mode 6
+	for (uint32_t c = 0; c < 4; ++c) {
+		writeBits(&writer, best.values[0][c], 7);
+		writeBits(&writer, best.values[1][c], 7);
+	}
+	writeBits(&writer, best.pBits[0], 1);
+	writeBits(&writer, best.pBits[1], 1);
+	writeBits(&writer, bestIndices[0], 3);
+	for (uint32_t i = 1; i < 16; ++i) writeBits(&writer, bestIndices[i], 4);
+}
+
+static void decompressBC7(uint8_t const * block, uint8_t * texels) {
+	memset(texels, 0, 64);
+	uint32_t position = 0;
+	if (readBits(block, &position, 7) != 1 << 6) return;
+	struct Bc7Endpoints endpoints;
+	for (uint32_t c = 0; c < 4; ++c) {
+		endpoints.values[0][c] = readBits(block, &position, 7);
+		endpoints.values[1][c] = readBits(block, &position, 7);
+	}
+	endpoints.pBits[0] = readBits(block, &position, 1);
+	endpoints.pBits[1] = readBits(block, &position, 1);
+	int palette[16][4];
+	bc7Palette(&endpoints, palette);
+	for (uint32_t i = 0; i < 16; ++i) {
+		uint32_t k = readBits(block, &position, i == 0 ? 3 : 4);
+		for (uint32_t c = 0; c < 4; ++c) texels[4 * i + c] = (uint8_t)palette[k][c];
+	}
+}
+
+// ETC2 RGB8, as ETC1
+
+static const int etcModifiers[8][2] = {
+	{ 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 },
+};
+
+/**
+ * Modifier of a 2-bit texel index in `table`: +a, +b, -a, -b.
+ */
+static int etcModifier(uint32_t table, uint32_t index) {
+	int modifier = etcModifiers[table][index & 1];
+	return index & 2 ? -modifier : modifier;
+}
+
+/**
+ * Texel numbers (4 * y + x) of the two halves of a block: columns 0-1
+ * and 2-3, or when flipped rows 0-1 and 2-3.
+ */
+static void etcSubblocks(uint32_t flip, uint32_t subblocks[2][8]) {
+	uint32_t counts[2] = { 0, 0 };
+	for (uint32_t y = 0; y < 4; ++y) {
+		for (uint32_t x = 0; x < 4; ++x) {
+			uint32_t half = flip ? y >= 2 : x >= 2;
+			subblocks[half][counts[half]++] = 4 * y + x;
+		}
+	}
+}
+
+/**
+ * Table and texel indices that best approximate a half block around
+ * `base`, and their squared error.
+ */
+static uint32_t etcFitSubblock(uint8_t const * texels, uint32_t const * subblock, int const * base, uint32_t * bestTable, uint8_t * bestIndices) {
+	uint32_t bestError = UINT32_MAX;
+	for (uint32_t table = 0; table < 8; ++table) {
+		uint32_t error = 0;
+		uint8_t indices[8];
+		for (uint32_t i = 0; i < 8 && error < bestError; ++i) {
+			uint8_t const * texel = texels + 4 * subblock[i];
+			uint32_t bestTexelError = UINT32_MAX;
+			for (uint32_t k = 0; k < 4; ++k) {
+				int modifier = etcModifier(table, k);
+				uint32_t e = 0;
+				for (int c = 0; c < 3; ++c) {
+					int d = clampInt(base[c] + modifier, 0, 255) - texel[c];
+					e += (uint32_t)(d * d);
+				}
+				if (e < bestTexelError) {
+					bestTexelError = e;
+					indices[i] = (uint8_t)k;
+				}
+			}
+			error += bestTexelError;
+		}
+		if (error < bestError) {
+			bestError = error;
+			*bestTable = table;
+			memcpy(bestIndices, indices, sizeof(indices));
+		}
+	}
+	return bestError;
+}
+
+static void compressETC2RGB8(uint8_t const * texels, uint8_t * block) {
+	uint32_t bestError = UINT32_MAX;
+	uint32_t bestHigh = 0, bestLow = 0;
+	for (uint32_t flip = 0; flip < 2; ++flip) {
+		uint32_t subblocks[2][8];
+		etcSubblocks(flip, subblocks);
+		float average[2][3] = { { 0 } };
+		for (uint32_t half = 0; half < 2; ++half) {
+			for (uint32_t i = 0; i < 8; ++i) {
+				for (uint32_t c = 0; c < 3; ++c) average[half][c] += texels[4 * subblocks[half][i] + c] / 8.0f;
+			}
+		}
+
+		// Individual mode: 4-bit base colors, and differential mode: a
+		// 5-bit base color and the second within -4..3 of it
+		for (uint32_t differential = 0; differential < 2; ++differential) {
+			int quantized[2][3];
+			int base[2][3];
+			for (uint32_t c = 0; c < 3; ++c) {
+				if (differential) {
+					quantized[0][c] = (int)roundClamp(average[0][c] * 31.0f / 255.0f, 31);
+					quantized[1][c] = clampInt((int)roundClamp(average[1][c] * 31.0f / 255.0f, 31), quantized[0][c] - 4, quantized[0][c] + 3);
+					quantized[1][c] = clampInt(quantized[1][c], 0, 31);
+					for (uint32_t half = 0; half < 2; ++half) base[half][c] = (quantized[half][c] << 3) | (quantized[half][c] >> 2);
+				} else {
+					for (uint32_t half = 0; half < 2; ++half) {
+						quantized[half][c] = (int)roundClamp(average[half][c] * 15.0f / 255.0f, 15);
+						base[half][c] = quantized[half][c] * 17;
+					}
+				}
+			}
+			uint32_t tables[2];
+			uint8_t indices[2][8];
+			uint32_t error = etcFitSubblock(texels, subblocks[0], base[0], &tables[0], indices[0]);
+			if (error >= bestError) continue;
+			error += etcFitSubblock(texels, subblocks[1], base[1], &tables[1], indices[1]);
+			if (error >= bestError) continue;
+
+			bestError = error;
+			bestHigh = (tables[0] << 5) | (tables[1] << 2) | (differential << 1) | flip;
+			for (uint32_t c = 0; c < 3; ++c) {
+				uint32_t shift = 24 - 8 * c;
+				if (differential) {
+					bestHigh |= (uint32_t)quantized[0][c] << (shift + 3);
+					bestHigh |= (uint32_t)((quantized[1][c] - quantized[0][c]) & 7) << shift;
+				} else {
+					bestHigh |= (uint32_t)quantized[0][c] << (shift + 4);
+					bestHigh |= (uint32_t)quantized[1][c] << shift;
+				}
+			}
+			// Texel indices are stored column after column, as two planes
+			// of 16 bits
+			bestLow = 0;
+			for (uint32_t half = 0; half < 2; ++half) {
+				for (uint32_t i = 0; i < 8; ++i) {
+					uint32_t texel = subblocks[half][i];
+					uint32_t bit = (texel % 4) * 4 + texel / 4;
+					bestLow |= (uint32_t)(indices[half][i] >> 1) << (bit + 16);
+					bestLow |= (uint32_t)(indices[half][i] & 1) << bit;
+				}
+			}
+		}
+	}
+	for (uint32_t k = 0; k < 4; ++k) {
+		block[k] = (uint8_t)(bestHigh >> (24 - 8 * k));
+		block[4 + k] = (uint8_t)(bestLow >> (24 - 8 * k));
+	}
+}
+
+static void decompressETC2RGB8(uint8_t const * block, uint8_t * texels) {
+	uint32_t high = ((uint32_t)block[0] << 24) | ((uint32_t)block[1] << 16) | ((uint32_t)block[2] << 8) | block[3];
+	uint32_t low = ((uint32_t)block[4] << 24) | ((uint32_t)block[5] << 16) | ((uint32_t)block[6] << 8) | block[7];
+	uint32_t flip = high & 1;
+	uint32_t differential = (high >> 1) & 1;
+	uint32_t tables[2] = { (high >> 5) & 7, (high >> 2) & 7 };
+	int base[2][3];
+	memset(texels, 0, 64);
+	for (uint32_t c = 0; c < 3; ++c) {
+		uint32_t shift = 24 - 8 * c;
+		if (differential) {
+			int value0 = (int)((high >> (shift + 3)) & 31);
+			int delta = (int)((high >> shift) & 7);
+			int value1 = value0 + (delta >= 4 ? delta - 8 : delta);
+			if (value1 < 0 || value1 > 31) return; // T, H or planar mode
+			base[0][c] = (value0 << 3) | (value0 >> 2);
+			base[1][c] = (value1 << 3) | (value1 >> 2);
+		} else {
+			base[0][c] = (int)((high >> (shift + 4)) & 15) * 17;
+			base[1][c] = (int)((high >> shift) & 15) * 17;
+		}
+	}
+	for (uint32_t texel = 0; texel < 16; ++texel) {
+		uint32_t x = texel % 4, y = texel / 4;
+		uint32_t half = flip ? y >= 2 : x >= 2;
+		uint32_t bit = x * 4 + y;
+		uint32_t index = (((low >> (bit + 16)) & 1) << 1) | ((low >> bit) & 1);
+		int modifier = etcModifier(tables[half], index);
+		for (uint32_t c = 0; c < 3; ++c) texels[4 * texel + c] = (uint8_t)clampInt(base[half][c] + modifier, 0, 255);
+		texels[4 * texel + 3] = 255;
+	}
+}
+
+// EAC RG11
+
+static const int eacModifiers[16][8] = {
+	{ -3, -6, -9, -15, 2, 5, 8, 14 },
+	{ -3, -7, -10, -13, 2, 6, 9, 12 },
+	{ -2, -5, -8, -13, 1, 4, 7, 12 },
+	{ -2, -4, -6, -13, 1, 3, 5, 12 },
+	{ -3, -6, -8, -12, 2, 5, 7, 11 },
+	{ -3, -7, -9, -11, 2, 6, 8, 10 },
+	{ -4, -7, -8, -11, 3, 6, 7, 10 },
+	{ -3, -5, -8, -11, 2, 4, 7, 10 },
+	{ -2, -6, -8, -10, 1, 5, 7, 9 },
+	{ -2, -5, -8, -10, 1, 4, 7, 9 },
+	{ -2, -4, -8, -10, 1, 3, 7, 9 },
+	{ -2, -5, -7, -10, 1, 4, 6, 9 },
+	{ -3, -4, -7, -10, 2, 3, 6, 9 },
+	{ -1, -2, -3, -10, 0, 1, 2, 9 },
+	{ -4, -6, -8, -9, 3, 5, 7, 8 },
+	{ -3, -5, -7, -9, 2, 4, 6, 8 },
+};
+
+static int eacValue(int base, int multiplier, uint32_t table, uint32_t index) {
+	int modifier = eacModifiers[table][index];
+	// A multiplier of 0 steps by single 11-bit units
+	return clampInt(base * 8 + 4 + (multiplier > 0 ? modifier * multiplier * 8 : modifier), 0, 2047);
+}
+
+/**
+ * One channel of 16 texels to an 11-bit EAC block, searching every table
+ * with the multipliers closest to the range of the block.
+ */
+static void compressEAC11(uint8_t const * texels, uint32_t channel, uint8_t * block) {
+	int values[16];
+	int low = 2047, high = 0;
+	for (uint32_t i = 0; i < 16; ++i) {
+		int value = texels[4 * i + channel];
+		values[i] = (value << 3) | (value >> 5);
+		if (values[i] < low) low = values[i];
+		if (values[i] > high) high = values[i];
+	}
+
+	uint32_t bestError = UINT32_MAX;
+	uint64_t bestBits = 0;
+	for (uint32_t table = 0; table < 16 && bestError > 0; ++table) {
+		int span = eacModifiers[table][7] - eacModifiers[table][3];
+		int middle = eacModifiers[table][7] + eacModifiers[table][3];
+		int closest = (int)((float)(high - low) / (float)(span * 8) + 0.5f);
+		for (int multiplier = closest - 1; multiplier <= closest + 1; ++multiplier) {
+			if (multiplier < 0 || multiplier > 15) continue;
+			float step = multiplier > 0 ? (float)(multiplier * 8) : 1.0f;
+			int base = (int)roundClamp(((float)(high + low) * 0.5f - 4.0f - (float)middle * step * 0.5f) / 8.0f, 255);
+			int palette[8];
+			for (uint32_t k = 0; k < 8; ++k) palette[k] = eacValue(base, multiplier, table, k);
+			uint32_t error = 0;
+			uint64_t bits = ((uint64_t)base << 56) | ((uint64_t)multiplier << 52) | ((uint64_t)table << 48);
+			for (uint32_t i = 0; i < 16 && error < bestError; ++i) {
+				uint32_t bestTexelError = UINT32_MAX;
+				uint64_t best = 0;
+				for (uint32_t k = 0; k < 8; ++k) {
+					int d = palette[k] - values[i];
+					if ((uint32_t)(d * d) < bestTexelError) {
+						bestTexelError = (uint32_t)(d * d);
+						best = k;
+					}
+				}
+				error += bestTexelError;
+				// Texels column after column, the first in the high bits
+				uint32_t bit = (i % 4) * 4 + i / 4;
+				bits |= best << (45 - 3 * bit);
+			}
+			if (error < bestError) {
+				bestError = error;
+				bestBits = bits;
+			}
+		}
+	}
+	for (uint32_t k = 0; k < 8; ++k) block[k] = (uint8_t)(bestBits >> (56 - 8 * k));
+}
+
+static void decompressEAC11(uint8_t const * block, uint32_t channel, uint8_t * texels) {
+	uint64_t bits = 0;
+	for (uint32_t k = 0; k < 8; ++k) bits = (bits << 8) | block[k];
+	int base = (int)(bits >> 56);
+	int multiplier = (int)((bits >> 52) & 15);
+	uint32_t table = (uint32_t)((bits >> 48) & 15);
+	for (uint32_t i = 0; i < 16; ++i) {
+		uint32_t bit = (i % 4) * 4 + i / 4;
+		int value = eacValue(base, multiplier, table, (uint32_t)((bits >> (45 - 3 * bit)) & 7));
+		texels[4 * i + channel] = (uint8_t)((value * 255 + 1023) / 2047);
+	}
+}
+
+// Blocks
+
+void blockCompress(enum BlockFormat format, uint8_t const * texels, uint8_t * block) {
+	switch (format) {
+	case BlockFormat_BC1:
+		compressBC1(texels, block);
+		break;
+	case BlockFormat_BC5:
+		compressBC4(texels, 0, block);
+		compressBC4(texels, 1, block + 8);
+		break;
+	case BlockFormat_BC7:
+		compressBC7(texels, block);
+		break;
+	case BlockFormat_ETC2RGB8:
+		compressETC2RGB8(texels, block);
+		break;
+	case BlockFormat_EACRG11:
+		compressEAC11(texels, 0, block);
+		compressEAC11(texels, 1, block + 8);
+		break;
+	default:
+		break;
+	}
+}
+
+void blockDecompress(enum BlockFormat format, uint8_t const * block, uint8_t * texels) {
+	switch (format) {
+	case BlockFormat_BC1:
+		decompressBC1(block, texels);
+		break;
+	case BlockFormat_BC5:
+	case BlockFormat_EACRG11:
+		for (uint32_t i = 0; i < 16; ++i) {
+			texels[4 * i + 2] = 0;
+			texels[4 * i + 3] = 255;
+		}
+		if (format == BlockFormat_BC5) {
+			decompressBC4(block, 0, texels);
+			decompressBC4(block + 8, 1, texels);
+		} else {
+			decompressEAC11(block, 0, texels);
+			decompressEAC11(block + 8, 1, texels);
+		}
+		break;
+	case BlockFormat_BC7:
+		decompressBC7(block, texels);
+		break;
+	case BlockFormat_ETC2RGB8:
+		decompressETC2RGB8(block, texels);
+		break;
+	default:
+		memset(texels, 0, 64);
+		break;
+	}
+}
+
+// Images
+
+struct CompressTask {
+	enum BlockFormat format;
+	uint8_t const * pixels;
+	uint32_t width;
+	uint32_t height;
+	uint8_t * blocks;
+	uint32_t firstRow; // of blocks
+	uint32_t endRow;
+};
+
+static int compressRows(void * argument) {
+	struct CompressTask const * task = (struct CompressTask const *)argument;
+	uint32_t blocksWide = (task->width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	uint32_t blockSize = blockFormatSize(task->format);
+	uint8_t texels[BLOCK_SIZE * BLOCK_SIZE * 4];
+	for (uint32_t row = task->firstRow; row < task->endRow; ++row) {
+		for (uint32_t column = 0; column < blocksWide; ++column) {
+			for (uint32_t y = 0; y < BLOCK_SIZE; ++y) {
+				uint32_t sourceY = row * BLOCK_SIZE + y < task->height ? row * BLOCK_SIZE + y : task->height - 1;
+				for (uint32_t x = 0; x < BLOCK_SIZE; ++x) {
+					uint32_t sourceX = column * BLOCK_SIZE + x < task->width ? column * BLOCK_SIZE + x : task->width - 1;
+					memcpy(texels + 4 * (y * BLOCK_SIZE + x), task->pixels + ((size_t)sourceY * task->width + sourceX) * 4, 4);
+				}
+			}
+			blockCompress(task->format, texels, task->blocks + ((size_t)row * blocksWide + column) * blockSize);
+		}
+	}
+	return 0;
+}
+
+void blockCompressImage(enum BlockFormat format, uint8_t const * pixels, uint32_t width, uint32_t height, uint8_t * blocks, uint32_t threadCount) {
+	if (threadCount == 0) threadCount = BLOCK_COMPRESSION_DEFAULT_THREADS;
+	if (threadCount > BLOCK_COMPRESSION_MAX_THREADS) threadCount = BLOCK_COMPRESSION_MAX_THREADS;
+	uint32_t rows = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	if (threadCount > rows) threadCount = rows;
+	if (threadCount == 0) return;
+
+	struct CompressTask tasks[BLOCK_COMPRESSION_MAX_THREADS];
+	thrd_t threads[BLOCK_COMPRESSION_MAX_THREADS];
+	bool started[BLOCK_COMPRESSION_MAX_THREADS] = { false };
+	for (uint32_t i = 0; i < threadCount; ++i) {
+		tasks[i] = (struct CompressTask) { format, pixels, width, height, blocks, (uint32_t)((uint64_t)rows * i / threadCount), (uint32_t)((uint64_t)rows * (i + 1) / threadCount) };
+	}
+	// The calling thread takes the first band, and any a thread could not
+	// be started for
+	for (uint32_t i = 1; i < threadCount; ++i) {
+		started[i] = thrd_create(&threads[i], compressRows, &tasks[i]) == thrd_success;
+	}
+	for (uint32_t i = 0; i < threadCount; ++i) {
+		if (!started[i]) compressRows(&tasks[i]);
+	}
+	for (uint32_t i = 1; i < threadCount; ++i) {
+		if (started[i]) thrd_join(threads[i], NULL);
+	}
+}
@@ -0,0 +1,87 @@
+/**
+ * CPU encoders of the block-compressed texture formats, for the import
+ * stage of the texture cache (see texture-cache.h).
+ *
+ * Each format stores 4x4 texels in a fixed-size block:
+ *  - BC1 (8 bytes): RGB, two 565 endpoints and 4 interpolated colors.
+ *    Always encoded in opaque 4-color mode.
+ *  - BC5 (16 bytes): RG, two BC4 blocks of 8 levels, for normal maps.
+ *  - BC7 (16 bytes): RGBA, encoded in mode 6 only: a single line of 16
+ *    colors between 7-bit endpoints with a p-bit each. The other modes
+ *    (partitions, separate alpha) would mostly improve blocks of sharp
+ *    color edges, at many times the encoding time.
+ *  - ETC2 RGB8 (8 bytes): RGB, encoded with the individual and
+ *    differential modes of ETC1, which ETC2 decoders read as is.
+ *  - EAC RG11 (16 bytes): RG, two 11-bit EAC blocks, for normal maps.
+ *
+ * Endpoints are fitted along the principal axis of the colors of a block
+ * and refined by least squares, and ETC and EAC search their tables, all
+ * minimizing the squared error of the 8-bit texels (as stored, so in
+ * sRGB space for sRGB formats). blockCompressImage splits the rows of
+ * blocks of an image between threads; texels past the right and bottom
+ * edges repeat the last column and row.
+ *
+ * Typical use:
+ *     uint8_t * blocks = malloc(blockCompressedSize(BlockFormat_BC7, width, height));
+ *     blockCompressImage(BlockFormat_BC7, pixels, width, height, blocks, 0);
+ *     // upload with rows of blockFormatSize(...) * ((width + 3) / 4) bytes
+ */
+
+#ifndef _block_compression_h_
+#define _block_compression_h_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BLOCK_COMPRESSION_DEFAULT_THREADS 8
+#define BLOCK_COMPRESSION_MAX_THREADS 64
+#define BLOCK_SIZE 4 // texels per side
+
+enum BlockFormat {
+	BlockFormat_BC1,
+	BlockFormat_BC5,
+	BlockFormat_BC7,
+	BlockFormat_ETC2RGB8,
+	BlockFormat_EACRG11,
+	BlockFormat_Count,
+};
+
+/**
+ * Bytes per block of `format`.
+ */
+uint32_t blockFormatSize(enum BlockFormat format);
+
+/**
+ * Bytes of an image of this size once compressed.
+ */
+uint64_t blockCompressedSize(enum BlockFormat format, uint32_t width, uint32_t height);
+
+/**
+ * Encode one block. `texels` are 4x4 RGBA8 texels, row after row.
+ */
+void blockCompress(enum BlockFormat format, uint8_t const * texels, uint8_t * block);
+
+/**
+ * Decode one block written by blockCompress to 4x4 RGBA8 texels, to
+ * measure the quality of an encoding. Channels a format does not store
+ * read 0, and alpha 255. The BC7 modes other than 6 and the T, H and
+ * planar modes of ETC2 decode to black.
+ */
+void blockDecompress(enum BlockFormat format, uint8_t const * block, uint8_t * texels);
+
+/**
+ * Encode an RGBA8 image, rows 4 * width bytes apart, to `blocks` (of
+ * blockCompressedSize bytes), on `threadCount` threads including the
+ * calling one, or BLOCK_COMPRESSION_DEFAULT_THREADS when 0.
+ */
+void blockCompressImage(enum BlockFormat format, uint8_t const * pixels, uint32_t width, uint32_t height, uint8_t * blocks, uint32_t threadCount);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _block_compression_h_
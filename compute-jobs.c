@@ -0,0 +1,387 @@
+#include "compute-jobs.h"
+#include "webgpu-utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Buffer pools
+
+static int poolBucket(uint64_t size) {
+	int log2 = COMPUTE_POOL_MIN_SIZE_LOG2;
+	while (((uint64_t)1 << log2) < size) ++log2;
+	return log2 - COMPUTE_POOL_MIN_SIZE_LOG2;
+}
+
+static struct ComputePooledBuffer * poolAcquire(struct ComputeBufferPool * pool, WGPUDevice device, uint64_t size) {
+	int bucket = poolBucket(size);
+	if (bucket >= COMPUTE_POOL_BUCKET_COUNT) {
+		fprintf(stderr, "Compute job buffer too large: %llu bytes\n", (unsigned long long)size);
+		return NULL;
+	}
+	struct ComputePooledBuffer * entry = pool->freeLists[bucket];
+	if (entry) {
+		pool->freeLists[bucket] = entry->next;
+		entry->next = NULL;
+		return entry;
+	}
+	entry = (struct ComputePooledBuffer *)calloc(1, sizeof(struct ComputePooledBuffer));
+	entry->size = (uint64_t)1 << (bucket + COMPUTE_POOL_MIN_SIZE_LOG2);
+	entry->buffer = createBuffer(device, entry->size, pool->usage, pool->label);
+	pool->createdCount++;
+	return entry;
+}
+
+static void poolReturn(struct ComputeBufferPool * pool, struct ComputePooledBuffer * entry) {
+	int bucket = poolBucket(entry->size);
+	entry->next = pool->freeLists[bucket];
+	pool->freeLists[bucket] = entry;
+}
+
+static void poolRelease(struct ComputeBufferPool * pool) {
+	for (int bucket = 0; bucket < COMPUTE_POOL_BUCKET_COUNT; ++bucket) {
+		struct ComputePooledBuffer * entry = pool->freeLists[bucket];
+		while (entry) {
+			struct ComputePooledBuffer * next = entry->next;
+			wgpuBufferDestroy(entry->buffer);
+			wgpuBufferRelease(entry->buffer);
+			free(entry);
+			entry = next;
+		}
+		pool->freeLists[bucket] = NULL;
+	}
+}
+
+// Runner
+
+struct ComputeRunner * computeRunnerCreate(WGPUDevice device, struct SubmitScheduler * scheduler) {
+	struct ComputeRunner * runner = (struct ComputeRunner *)calloc(1, sizeof(struct ComputeRunner));
+	runner->device = device;
+	runner->queue = wgpuDeviceGetQueue(device);
+	runner->scheduler = scheduler;
+	runner->storagePool.usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopyDst | WGPUBufferUsage_CopySrc;
+	runner->storagePool.label = "Compute job storage";
+	runner->readbackPool.usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst;
+	runner->readbackPool.label = "Compute job readback";
+	runner->maxBatchSize = COMPUTE_RUNNER_DEFAULT_MAX_BATCH;
+	return runner;
+}
+
+struct ComputeKernel * computeRunnerCreateKernel(struct ComputeRunner * runner, char const * wgslSource, char const * entryPoint, uint32_t inputCount, uint32_t outputCount, char const * label) {
+	if (inputCount + outputCount > COMPUTE_JOB_MAX_BUFFERS) {
+		fprintf(stderr, "Compute kernel '%s' uses more than %d buffers\n", label ? label : "", COMPUTE_JOB_MAX_BUFFERS);
+		return NULL;
+	}
+
+	WGPUBindGroupLayoutEntry entries[COMPUTE_JOB_MAX_BUFFERS];
+	for (uint32_t i = 0; i < inputCount + outputCount; ++i) {
+		WGPUBufferBindingType type = i < inputCount ? WGPUBufferBindingType_ReadOnlyStorage : WGPUBufferBindingType_Storage;
+		entries[i] = bufferLayoutEntry(i, WGPUShaderStage_Compute, type, false);
+	}
+	WGPUBindGroupLayoutDescriptor layoutDesc = (WGPUBindGroupLayoutDescriptor) {};
+	layoutDesc.nextInChain = NULL;
+	layoutDesc.label = label;
+	layoutDesc.entryCount = inputCount + outputCount;
+	layoutDesc.entries = entries;
+	WGPUBindGroupLayout layout = wgpuDeviceCreateBindGroupLayout(runner->device, &layoutDesc);
+
+	WGPUShaderModule module = createWGSLShaderModule(runner->device, wgslSource, label);
+	WGPUPipelineLayout pipelineLayout = createSingleGroupPipelineLayout(runner->device, layout, label);
+	WGPUComputePipeline pipeline = createComputePipeline(runner->device, pipelineLayout, module, entryPoint, label);
+	wgpuPipelineLayoutRelease(pipelineLayout);
+	wgpuShaderModuleRelease(module);
+	if (!pipeline) {
+		wgpuBindGroupLayoutRelease(layout);
+		return NULL;
+	}
+
+	struct ComputeKernel * kernel = (struct ComputeKernel *)calloc(1, sizeof(struct ComputeKernel));
+	kernel->pipeline = pipeline;
+	kernel->layout = layout;
+	kernel->inputCount = inputCount;
+	kernel->outputCount = outputCount;
+	kernel->next = runner->kernels;
+	runner->kernels = kernel;
+	return kernel;
+}
+
+/**
+ * Bind groups only depend on which pooled buffers a job got, so with jobs
+ * of recurring sizes the cache quickly covers all combinations.
+ */
+static WGPUBindGroup getBindGroup(struct ComputeRunner * runner, struct ComputeKernel * kernel, struct ComputePooledBuffer * const * buffers, uint64_t const * sizes) {
+	uint32_t bufferCount = kernel->inputCount + kernel->outputCount;
+	struct ComputeKernelBindGroup * oldest = NULL;
+	for (uint32_t i = 0; i < kernel->bindGroupCacheCount; ++i) {
+		struct ComputeKernelBindGroup * entry = &kernel->bindGroupCache[i];
+		bool match = true;
+		for (uint32_t b = 0; b < bufferCount && match; ++b) {
+			match = entry->buffers[b] == buffers[b]->buffer && entry->sizes[b] == sizes[b];
+		}
+		if (match) {
+			entry->lastUse = ++runner->useCounter;
+			return entry->bindGroup;
+		}
+		if (!oldest || entry->lastUse < oldest->lastUse) oldest = entry;
+	}
+
+	struct ComputeKernelBindGroup * entry;
+	if (kernel->bindGroupCacheCount < COMPUTE_KERNEL_BIND_GROUP_CACHE_SIZE) {
+		entry = &kernel->bindGroupCache[kernel->bindGroupCacheCount++];
+	} else {
+		// Bind groups hold a reference to what they use, so releasing it
+		// while a recorded dispatch uses it is fine.
+		entry = oldest;
+		wgpuBindGroupRelease(entry->bindGroup);
+	}
+
+	WGPUBindGroupEntry bindings[COMPUTE_JOB_MAX_BUFFERS];
+	for (uint32_t b = 0; b < bufferCount; ++b) {
+		bindings[b] = bufferBindGroupEntry(b, buffers[b]->buffer, 0, sizes[b]);
+		entry->buffers[b] = buffers[b]->buffer;
+		entry->sizes[b] = sizes[b];
+	}
+	WGPUBindGroupDescriptor bindGroupDesc = (WGPUBindGroupDescriptor) {};
+	bindGroupDesc.nextInChain = NULL;
+	bindGroupDesc.layout = kernel->layout;
+	bindGroupDesc.entryCount = bufferCount;
+	bindGroupDesc.entries = bindings;
+	entry->bindGroup = wgpuDeviceCreateBindGroup(runner->device, &bindGroupDesc);
+	entry->lastUse = ++runner->useCounter;
+	return entry->bindGroup;
+}
+
+static struct ComputeJob * allocJob(struct ComputeRunner * runner) {
+	struct ComputeJob * job = runner->freeJobs;
+	if (job) {
+		runner->freeJobs = job->next;
+	} else {
+		job = (struct ComputeJob *)malloc(sizeof(struct ComputeJob));
+	}
+	memset(job, 0, sizeof(struct ComputeJob));
+	job->runner = runner;
+	return job;
+}
+
+static void recycleJob(struct ComputeRunner * runner, struct ComputeJob * job) {
+	struct ComputeKernel * kernel = job->kernel;
+	for (uint32_t b = 0; b < kernel->inputCount + kernel->outputCount; ++b) {
+		if (job->buffers[b]) poolReturn(&runner->storagePool, job->buffers[b]);
+	}
+	for (uint32_t o = 0; o < kernel->outputCount; ++o) {
+		if (job->readbacks[o]) poolReturn(&runner->readbackPool, job->readbacks[o]);
+	}
+	job->next = runner->freeJobs;
+	runner->freeJobs = job;
+}
+
+bool computeRunnerSubmit(struct ComputeRunner * runner, struct ComputeJobDesc const * desc) {
+	struct ComputeKernel * kernel = desc->kernel;
+	struct ComputeJob * job = allocJob(runner);
+	job->kernel = kernel;
+	job->callback = desc->callback;
+	job->userData = desc->userData;
+
+	uint64_t sizes[COMPUTE_JOB_MAX_BUFFERS];
+	for (uint32_t i = 0; i < kernel->inputCount; ++i) {
+		sizes[i] = alignUp(desc->inputs[i].size, 4);
+		job->buffers[i] = poolAcquire(&runner->storagePool, runner->device, sizes[i]);
+		if (!job->buffers[i]) {
+			recycleJob(runner, job);
+			return false;
+		}
+		// Runs before the batch is submitted, and after any previously
+		// submitted job that used this buffer.
+		wgpuQueueWriteBuffer(runner->queue, job->buffers[i]->buffer, 0, desc->inputs[i].data, desc->inputs[i].size);
+	}
+	for (uint32_t o = 0; o < kernel->outputCount; ++o) {
+		uint32_t b = kernel->inputCount + o;
+		sizes[b] = alignUp(desc->outputSizes[o], 4);
+		job->outputSizes[o] = desc->outputSizes[o];
+		job->buffers[b] = poolAcquire(&runner->storagePool, runner->device, sizes[b]);
+		job->readbacks[o] = poolAcquire(&runner->readbackPool, runner->device, sizes[b]);
+		if (!job->buffers[b] || !job->readbacks[o]) {
+			recycleJob(runner, job);
+			return false;
+		}
+	}
+
+	if (!runner->encoder) {
+		WGPUCommandEncoderDescriptor encoderDesc = (WGPUCommandEncoderDescriptor) {};
+		encoderDesc.nextInChain = NULL;
+		encoderDesc.label = "Compute jobs";
+		runner->encoder = wgpuDeviceCreateCommandEncoder(runner->device, &encoderDesc);
+		WGPUComputePassDescriptor passDesc = (WGPUComputePassDescriptor) {};
+		passDesc.nextInChain = NULL;
+		passDesc.label = "Compute jobs";
+		passDesc.timestampWriteCount = 0;
+		passDesc.timestampWrites = NULL;
+		runner->pass = wgpuCommandEncoderBeginComputePass(runner->encoder, &passDesc);
+	}
+
+	WGPUBindGroup bindGroup = getBindGroup(runner, kernel, job->buffers, sizes);
+	wgpuComputePassEncoderSetPipeline(runner->pass, kernel->pipeline);
+	wgpuComputePassEncoderSetBindGroup(runner->pass, 0, bindGroup, 0, NULL);
+	wgpuComputePassEncoderDispatchWorkgroups(runner->pass, desc->workgroupCountX, desc->workgroupCountY, desc->workgroupCountZ);
+
+	if (runner->lastRecording) {
+		runner->lastRecording->next = job;
+	} else {
+		runner->recording = job;
+	}
+	runner->lastRecording = job;
+	runner->recordingCount++;
+	runner->inFlightCount++;
+
+	if (runner->recordingCount >= runner->maxBatchSize) {
+		computeRunnerFlush(runner);
+	}
+	return true;
+}
+
+static void completeJob(struct ComputeJob * job) {
+	struct ComputeRunner * runner = job->runner;
+	struct ComputeKernel * kernel = job->kernel;
+	void const * outputs[COMPUTE_JOB_MAX_BUFFERS];
+	for (uint32_t o = 0; o < kernel->outputCount; ++o) {
+		outputs[o] = job->mapFailed ? NULL : wgpuBufferGetConstMappedRange(job->readbacks[o]->buffer, 0, alignUp(job->outputSizes[o], 4));
+	}
+	if (job->callback) {
+		job->callback(job->userData, outputs, job->outputSizes);
+	}
+	if (!job->mapFailed) {
+		for (uint32_t o = 0; o < kernel->outputCount; ++o) {
+			wgpuBufferUnmap(job->readbacks[o]->buffer);
+		}
+	}
+	runner->inFlightCount--;
+	runner->completedCount++;
+	recycleJob(runner, job);
+}
+
+static void onReadbackMapped(WGPUBufferMapAsyncStatus status, void * pUserData) {
+	struct ComputeJob * job = (struct ComputeJob *)pUserData;
+	if (status != WGPUBufferMapAsyncStatus_Success) {
+		fprintf(stderr, "Could not map compute job output (status %d)\n", status);
+		job->mapFailed = true;
+	}
+	if (--job->pendingMaps == 0) {
+		completeJob(job);
+	}
+}
+
+/**
+ * Called once the commands of flushed jobs have been submitted.
+ */
+static void startReadbacks(void * userData) {
+	struct ComputeRunner * runner = (struct ComputeRunner *)userData;
+	struct ComputeJob * job = runner->awaitingSubmit;
+	runner->awaitingSubmit = NULL;
+	runner->lastAwaitingSubmit = NULL;
+	while (job) {
+		struct ComputeJob * next = job->next;
+		job->next = NULL;
+		uint32_t outputCount = job->kernel->outputCount;
+		job->pendingMaps = outputCount;
+		if (outputCount == 0) {
+			// Nothing to wait for: later writes to the input buffers are
+			// ordered after this job on the queue anyway.
+			completeJob(job);
+		}
+		for (uint32_t o = 0; o < outputCount; ++o) {
+			wgpuBufferMapAsync(job->readbacks[o]->buffer, WGPUMapMode_Read, 0, alignUp(job->outputSizes[o], 4), onReadbackMapped, (void *)job);
+		}
+		job = next;
+	}
+}
+
+void computeRunnerFlush(struct ComputeRunner * runner) {
+	if (!runner->encoder) return;
+
+	wgpuComputePassEncoderEnd(runner->pass);
+	wgpuComputePassEncoderRelease(runner->pass);
+	runner->pass = NULL;
+	for (struct ComputeJob * job = runner->recording; job; job = job->next) {
+		struct ComputeKernel * kernel = job->kernel;
+		for (uint32_t o = 0; o < kernel->outputCount; ++o) {
+			WGPUBuffer output = job->buffers[kernel->inputCount + o]->buffer;
+			wgpuCommandEncoderCopyBufferToBuffer(runner->encoder, output, 0, job->readbacks[o]->buffer, 0, alignUp(job->outputSizes[o], 4));
+		}
+	}
+
+	WGPUCommandBufferDescriptor cmdBufferDescriptor = (WGPUCommandBufferDescriptor) {};
+	cmdBufferDescriptor.nextInChain = NULL;
+	cmdBufferDescriptor.label = "Compute jobs";
+	WGPUCommandBuffer command = wgpuCommandEncoderFinish(runner->encoder, &cmdBufferDescriptor);
+	wgpuCommandEncoderRelease(runner->encoder);
+	runner->encoder = NULL;
+
+	if (runner->lastAwaitingSubmit) {
+		runner->lastAwaitingSubmit->next = runner->recording;
+	} else {
+		runner->awaitingSubmit = runner->recording;
+	}
+	runner->lastAwaitingSubmit = runner->lastRecording;
+	runner->recording = NULL;
+	runner->lastRecording = NULL;
+	runner->recordingCount = 0;
+
+	if (runner->scheduler) {
+		submitSchedulerEnqueue(runner->scheduler, SubmitStage_Compute, command);
+		submitSchedulerAfterSubmit(runner->scheduler, startReadbacks, (void *)runner);
+	} else {
+		wgpuQueueSubmit(runner->queue, 1, &command);
+		wgpuCommandBufferRelease(command);
+		startReadbacks(runner);
+	}
+}
+
+void computeRunnerPoll(struct ComputeRunner * runner) {
+#ifdef WEBGPU_BACKEND_DAWN
+	wgpuDeviceTick(runner->device);
+#else
+	(void)runner;
+#endif
+}
+
+void computeRunnerWait(struct ComputeRunner * runner) {
+	computeRunnerFlush(runner);
+	if (runner->scheduler) {
+		submitSchedulerFlush(runner->scheduler);
+	}
+	while (runner->inFlightCount > 0) {
+		computeRunnerPoll(runner);
+	}
+}
+
+static void freeJobList(struct ComputeJob * job) {
+	while (job) {
+		struct ComputeJob * next = job->next;
+		free(job);
+		job = next;
+	}
+}
+
+void computeRunnerRelease(struct ComputeRunner * runner) {
+	if (!runner) return;
+	// Readback maps and after-submit callbacks refer to the runner, so let
+	// every job call back first; all of them are then free
+	computeRunnerWait(runner);
+	freeJobList(runner->freeJobs);
+
+	struct ComputeKernel * kernel = runner->kernels;
+	while (kernel) {
+		struct ComputeKernel * next = kernel->next;
+		for (uint32_t i = 0; i < kernel->bindGroupCacheCount; ++i) {
+			wgpuBindGroupRelease(kernel->bindGroupCache[i].bindGroup);
+		}
+		wgpuBindGroupLayoutRelease(kernel->layout);
+		wgpuComputePipelineRelease(kernel->pipeline);
+		free(kernel);
+		kernel = next;
+	}
+	poolRelease(&runner->storagePool);
+	poolRelease(&runner->readbackPool);
+	wgpuQueueRelease(runner->queue);
+	free(runner);
+}
@@ -0,0 +1,184 @@
+/**
+ * General-purpose compute jobs.
+ *
+ * A kernel is a WGSL compute entry point whose group 0 binds the job's
+ * buffers: inputs first, as read-only storage buffers, then outputs, as
+ * read-write storage buffers:
+ *     @group(0) @binding(0) var<storage, read> input: array<f32>;
+ *     @group(0) @binding(1) var<storage, read_write> output: array<f32>;
+ *
+ * A job runs a kernel on some input data and calls back with the content
+ * of the outputs once they are read back. Storage and readback buffers
+ * come from pools bucketed by power-of-two sizes and bind groups are
+ * cached per kernel, so that once warmed up, jobs do not create any GPU
+ * object. Jobs recorded between two flushes share a single compute pass
+ * and command buffer; their readback is mapped asynchronously while the
+ * next batch is being recorded.
+ *
+ * Typical use:
+ *     struct ComputeKernel * kernel = computeRunnerCreateKernel(runner, source, "main", 1, 1, "Square");
+ *     computeRunnerSubmit(runner, &job);    // any number of times
+ *     computeRunnerFlush(runner);           // once per frame, or:
+ *     computeRunnerWait(runner);            // flush and wait for all callbacks
+ *
+ * Sizes of inputs and outputs must be multiples of 4 bytes.
+ */
+
+#ifndef _compute_jobs_h_
+#define _compute_jobs_h_
+
+#include <webgpu/webgpu.h>
+#include "submit-scheduler.h"
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Default limit on storage buffers per shader stage
+#define COMPUTE_JOB_MAX_BUFFERS 8
+#define COMPUTE_KERNEL_BIND_GROUP_CACHE_SIZE 32
+// Buffers of 256 B, 512 B, ..., 2 GB
+#define COMPUTE_POOL_MIN_SIZE_LOG2 8
+#define COMPUTE_POOL_BUCKET_COUNT 24
+// A batch is flushed automatically when it reaches this many jobs
+#define COMPUTE_RUNNER_DEFAULT_MAX_BATCH 256
+
+struct ComputePooledBuffer {
+	WGPUBuffer buffer;
+	uint64_t size;
+	struct ComputePooledBuffer * next;
+};
+
+struct ComputeBufferPool {
+	WGPUBufferUsageFlags usage;
+	char const * label;
+	struct ComputePooledBuffer * freeLists[COMPUTE_POOL_BUCKET_COUNT];
+	uint32_t createdCount;
+};
+
+struct ComputeKernelBindGroup {
+	WGPUBuffer buffers[COMPUTE_JOB_MAX_BUFFERS];
+	uint64_t sizes[COMPUTE_JOB_MAX_BUFFERS];
+	WGPUBindGroup bindGroup;
+	uint64_t lastUse;
+};
+
+struct ComputeKernel {
+	WGPUComputePipeline pipeline;
+	WGPUBindGroupLayout layout;
+	uint32_t inputCount;
+	uint32_t outputCount;
+	struct ComputeKernelBindGroup bindGroupCache[COMPUTE_KERNEL_BIND_GROUP_CACHE_SIZE];
+	uint32_t bindGroupCacheCount;
+	struct ComputeKernel * next;
+};
+
+struct ComputeJobInput {
+	void const * data;
+	size_t size;
+};
+
+/**
+ * Called once the outputs of a job have been read back. `outputs` is only
+ * valid during the call, and its entries are NULL if reading back failed.
+ */
+typedef void (*ComputeJobCallback)(void * userData, void const * const * outputs, size_t const * outputSizes);
+
+struct ComputeJobDesc {
+	struct ComputeKernel * kernel;
+	struct ComputeJobInput const * inputs; // kernel->inputCount entries
+	size_t const * outputSizes; // kernel->outputCount entries
+	uint32_t workgroupCountX;
+	uint32_t workgroupCountY;
+	uint32_t workgroupCountZ;
+	ComputeJobCallback callback;
+	void * userData;
+};
+
+struct ComputeJob {
+	struct ComputeRunner * runner;
+	struct ComputeKernel * kernel;
+	// Inputs then outputs
+	struct ComputePooledBuffer * buffers[COMPUTE_JOB_MAX_BUFFERS];
+	struct ComputePooledBuffer * readbacks[COMPUTE_JOB_MAX_BUFFERS];
+	size_t outputSizes[COMPUTE_JOB_MAX_BUFFERS];
+	uint32_t pendingMaps;
+	bool mapFailed;
+	ComputeJobCallback callback;
+	void * userData;
+	struct ComputeJob * next;
+};
+
+struct ComputeRunner {
+	WGPUDevice device;
+	WGPUQueue queue;
+	struct SubmitScheduler * scheduler; // may be NULL
+
+	struct ComputeBufferPool storagePool;
+	struct ComputeBufferPool readbackPool;
+	struct ComputeKernel * kernels;
+
+	// Batch being recorded
+	WGPUCommandEncoder encoder;
+	WGPUComputePassEncoder pass;
+	struct ComputeJob * recording;
+	struct ComputeJob * lastRecording;
+	uint32_t recordingCount;
+	uint32_t maxBatchSize;
+
+	// Jobs flushed whose readback is mapped once they are submitted
+	struct ComputeJob * awaitingSubmit;
+	struct ComputeJob * lastAwaitingSubmit;
+	struct ComputeJob * freeJobs;
+	uint32_t inFlightCount;
+	uint64_t completedCount;
+	uint64_t useCounter;
+};
+
+/**
+ * If `scheduler` is not NULL, batches are enqueued there in the Compute
+ * stage and submitted with the rest of the frame, otherwise they are
+ * submitted directly by computeRunnerFlush.
+ */
+struct ComputeRunner * computeRunnerCreate(WGPUDevice device, struct SubmitScheduler * scheduler);
+
+/**
+ * Compile a kernel once, to be used by any number of jobs. Kernels are
+ * owned by the runner.
+ */
+struct ComputeKernel * computeRunnerCreateKernel(struct ComputeRunner * runner, char const * wgslSource, char const * entryPoint, uint32_t inputCount, uint32_t outputCount, char const * label);
+
+/**
+ * Record a job in the current batch. Input data is copied, so it may be
+ * freed as soon as this returns.
+ */
+bool computeRunnerSubmit(struct ComputeRunner * runner, struct ComputeJobDesc const * desc);
+
+/**
+ * Submit (or enqueue in the scheduler) the current batch.
+ */
+void computeRunnerFlush(struct ComputeRunner * runner);
+
+/**
+ * Process completed readbacks, calling job callbacks. Does not block.
+ */
+void computeRunnerPoll(struct ComputeRunner * runner);
+
+/**
+ * Flush and block until every job submitted so far has called back.
+ */
+void computeRunnerWait(struct ComputeRunner * runner);
+
+/**
+ * Wait for the jobs in flight, which all call back, then release the
+ * runner.
+ */
+void computeRunnerRelease(struct ComputeRunner * runner);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _compute_jobs_h_
@@ -0,0 +1,194 @@
+#include "device-creation.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+// A simple structure holding the local information shared with the
+// onAdapterRequestEnded callback.
+struct AdapterUserData {
+	WGPUAdapter adapter;
+	bool requestEnded;
+};
+
+static void onAdapterRequestEnded(WGPURequestAdapterStatus status, WGPUAdapter adapter, char const * message, void * pUserData) {
+	struct AdapterUserData * userData = (struct AdapterUserData*)(pUserData);
+	if (status == WGPURequestAdapterStatus_Success) {
+		userData->adapter = adapter;
+	} else {
+		printf("Could not get WebGPU adapter: %s\n", message);
+	}
+	userData->requestEnded = true;
+}
+
+WGPUAdapter requestAdapter(WGPUInstance instance, WGPURequestAdapterOptions const * options) {
+	struct AdapterUserData userData = { NULL, false };
+
+	// Call to the WebGPU request adapter procedure
+	wgpuInstanceRequestAdapter(
+		instance /* equivalent of navigator.gpu */,
+		options,
+		onAdapterRequestEnded,
+		(void*)&userData
+	);
+
+	// In theory we should wait until onAdapterReady has been called, which
+	// could take some time (what the 'await' keyword does in the JavaScript
+	// code). In practice, we know that when the wgpuInstanceRequestAdapter()
+	// function returns its callback has been called.
+	assert(userData.requestEnded);
+
+	return userData.adapter;
+}
+
+struct DeviceUserData {
+	WGPUDevice device;
+	bool requestEnded;
+};
+
+static void onDeviceError(WGPUErrorType type, char const* message, void* pUserData) {
+	(void)pUserData;
+	printf("Uncaptured device error: type %u", type);
+	if (message) printf(" (%s)", message);
+	printf("\n");
+}
+
+static void onDeviceRequestEnded(WGPURequestDeviceStatus status, WGPUDevice device, char const * message, void * pUserData) {
+	struct DeviceUserData * userData = (struct DeviceUserData*)(pUserData);
+	if (status == WGPURequestDeviceStatus_Success) {
+		userData->device = device;
+		wgpuDeviceSetUncapturedErrorCallback(device, onDeviceError, NULL /* pUserData */);
+	} else {
+		printf("Could not get WebGPU device: %s\n", message);
+	}
+	userData->requestEnded = true;
+}
+
+WGPUDevice requestDevice(WGPUAdapter adapter, WGPUDeviceDescriptor const * descriptor) {
+	struct DeviceUserData userData = { NULL, false };
+
+	wgpuAdapterRequestDevice(
+		adapter,
+		descriptor,
+		onDeviceRequestEnded,
+		(void*)&userData
+	);
+
+	assert(userData.requestEnded);
+
+	return userData.device;
+}
+
+static char const * const profileNames[DeviceProfile_Count] = {
+	"debug",
+	"profile",
+	"production",
+};
+
+char const * deviceProfileName(enum DeviceProfile profile) {
+	return profile < DeviceProfile_Count ? profileNames[profile] : "unknown";
+}
+
+bool deviceProfileFromName(char const * name, enum DeviceProfile * profile) {
+	for (int i = 0; i < DeviceProfile_Count; ++i) {
+		if (strcmp(name, profileNames[i]) == 0) {
+			*profile = (enum DeviceProfile)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+#ifdef WEBGPU_BACKEND_DAWN
+
+// Toggle names are those of Dawn's src/dawn/native/Toggles.cpp
+static char const * const debugEnabledToggles[] = {
+	"use_user_defined_labels_in_backend",
+	"disable_symbol_renaming",
+	"lazy_clear_resource_on_first_use",
+};
+static char const * const debugDisabledToggles[] = {
+	"skip_validation",
+	"disable_robustness",
+};
+
+static char const * const profileEnabledToggles[] = {
+	"use_user_defined_labels_in_backend",
+	"disable_robustness",
+	"disable_lazy_clear_for_mapped_at_creation_buffer",
+};
+static char const * const profileDisabledToggles[] = {
+	"skip_validation",
+	"lazy_clear_resource_on_first_use",
+};
+
+static char const * const productionEnabledToggles[] = {
+	"skip_validation",
+	"disable_robustness",
+	"disable_lazy_clear_for_mapped_at_creation_buffer",
+};
+static char const * const productionDisabledToggles[] = {
+	"lazy_clear_resource_on_first_use",
+	"use_user_defined_labels_in_backend",
+};
+
+#define ARRAY_COUNT(array) (sizeof(array) / sizeof((array)[0]))
+
+void chainDeviceProfileToggles(WGPUDeviceDescriptor * descriptor, enum DeviceProfile profile, WGPUDawnTogglesDescriptor * toggles) {
+	*toggles = (WGPUDawnTogglesDescriptor) {};
+	toggles->chain.next = descriptor->nextInChain;
+	toggles->chain.sType = WGPUSType_DawnTogglesDescriptor;
+
+	switch (profile) {
+	case DeviceProfile_Production:
+		toggles->enabledTogglesCount = ARRAY_COUNT(productionEnabledToggles);
+		toggles->enabledToggles = productionEnabledToggles;
+		toggles->disabledTogglesCount = ARRAY_COUNT(productionDisabledToggles);
+		toggles->disabledToggles = productionDisabledToggles;
+		break;
+	case DeviceProfile_Profile:
+		toggles->enabledTogglesCount = ARRAY_COUNT(profileEnabledToggles);
+		toggles->enabledToggles = profileEnabledToggles;
+		toggles->disabledTogglesCount = ARRAY_COUNT(profileDisabledToggles);
+		toggles->disabledToggles = profileDisabledToggles;
+		break;
+	case DeviceProfile_Debug:
+	default:
+		toggles->enabledTogglesCount = ARRAY_COUNT(debugEnabledToggles);
+		toggles->enabledToggles = debugEnabledToggles;
+		toggles->disabledTogglesCount = ARRAY_COUNT(debugDisabledToggles);
+		toggles->disabledToggles = debugDisabledToggles;
+		break;
+	}
+
+	descriptor->nextInChain = &toggles->chain;
+}
+
+#endif // WEBGPU_BACKEND_DAWN
+
+WGPUDevice createDeviceWithProfile(WGPUAdapter adapter, enum DeviceProfile profile, char const * label) {
+	WGPUDeviceDescriptor deviceDesc = (WGPUDeviceDescriptor) {};
+	deviceDesc.nextInChain = NULL;
+	deviceDesc.label = label;
+	// Block-compressed formats (see texture-cache.h) and f16 in shaders
+	// (see nn-inference.h), when the adapter has them
+	WGPUFeatureName features[3];
+	uint32_t featureCount = 0;
+	if (wgpuAdapterHasFeature(adapter, WGPUFeatureName_TextureCompressionBC)) features[featureCount++] = WGPUFeatureName_TextureCompressionBC;
+	if (wgpuAdapterHasFeature(adapter, WGPUFeatureName_TextureCompressionETC2)) features[featureCount++] = WGPUFeatureName_TextureCompressionETC2;
+	if (wgpuAdapterHasFeature(adapter, WGPUFeatureName_ShaderF16)) features[featureCount++] = WGPUFeatureName_ShaderF16;
+	deviceDesc.requiredFeaturesCount = featureCount;
+	deviceDesc.requiredFeatures = features;
+	deviceDesc.requiredLimits = NULL; // we do not require any specific limit
+	deviceDesc.defaultQueue.nextInChain = NULL;
+	deviceDesc.defaultQueue.label = "The default queue";
+
+#ifdef WEBGPU_BACKEND_DAWN
+	WGPUDawnTogglesDescriptor toggles;
+	chainDeviceProfileToggles(&deviceDesc, profile, &toggles);
+#else
+	(void)profile;
+#endif
+
+	return requestDevice(adapter, &deviceDesc);
+}
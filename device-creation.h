@@ -0,0 +1,85 @@
+/**
+ * Adapter and device creation, with validation profiles chaining Dawn
+ * toggles onto the device descriptor.
+ *
+ * Profiles trade safety for CPU time:
+ *  - "debug": full validation, robust buffer access and lazy clearing of
+ *    resources, plus readable labels and shader symbols in GPU captures.
+ *  - "profile": validation is kept so that errors are still reported, but
+ *    robustness and lazy clearing are disabled so that timings are close to
+ *    production. Labels are kept for captures.
+ *  - "production": no validation, no robustness, no lazy clearing. The App
+ *    must be known to be valid and to initialize every resource it reads.
+ *
+ * Toggles are a Dawn extension; on other backends all profiles create the
+ * same default device.
+ */
+
+#ifndef _device_creation_h_
+#define _device_creation_h_
+
+#include <webgpu/webgpu.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum DeviceProfile {
+	DeviceProfile_Debug,
+	DeviceProfile_Profile,
+	DeviceProfile_Production,
+	DeviceProfile_Count,
+};
+
+#ifdef NDEBUG
+#define DEVICE_PROFILE_DEFAULT DeviceProfile_Production
+#else
+#define DEVICE_PROFILE_DEFAULT DeviceProfile_Debug
+#endif
+
+/**
+ * Name of a profile, as accepted by deviceProfileFromName.
+ */
+char const * deviceProfileName(enum DeviceProfile profile);
+
+/**
+ * Look up a profile by name. Returns false if the name is unknown.
+ */
+bool deviceProfileFromName(char const * name, enum DeviceProfile * profile);
+
+/**
+ * Utility function to get a WebGPU adapter, so that
+ *     WGPUAdapter adapter = requestAdapter(options);
+ * is roughly equivalent to
+ *     const adapter = await navigator.gpu.requestAdapter(options);
+ */
+WGPUAdapter requestAdapter(WGPUInstance instance, WGPURequestAdapterOptions const * options);
+
+/**
+ * Utility function to get a WebGPU device, so that
+ *     WGPUAdapter device = requestDevice(adapter, options);
+ * is roughly equivalent to
+ *     const device = await adapter.requestDevice(descriptor);
+ * It is very similar to requestAdapter
+ */
+WGPUDevice requestDevice(WGPUAdapter adapter, WGPUDeviceDescriptor const * descriptor);
+
+#ifdef WEBGPU_BACKEND_DAWN
+/**
+ * Chain the toggles of `profile` onto `descriptor`. `toggles` is storage
+ * provided by the caller that must outlive the call to requestDevice.
+ */
+void chainDeviceProfileToggles(WGPUDeviceDescriptor * descriptor, enum DeviceProfile profile, WGPUDawnTogglesDescriptor * toggles);
+#endif
+
+/**
+ * Request a device configured for `profile`, with the texture compression
+ * and ShaderF16 features of the adapter and without any required limit.
+ */
+WGPUDevice createDeviceWithProfile(WGPUAdapter adapter, enum DeviceProfile profile, char const * label);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _device_creation_h_
@@ -0,0 +1,692 @@
+#include "device-recovery.h"
+#include "webgpu-utils.h"
+
+#include <tinycthread.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_LOADER_THREADS 8
+
+struct RecordedStage {
+	struct TrackedResource * module;
+	char * entryPoint;
+	WGPUConstantEntry * constants;
+	size_t constantCount;
+};
+
+struct RecordedComputePipeline {
+	struct TrackedResource * layout; // NULL for an automatic layout
+	struct RecordedStage compute;
+};
+
+struct RecordedRenderPipeline {
+	struct TrackedResource * layout; // NULL for an automatic layout
+	struct RecordedStage vertex;
+	WGPUVertexBufferLayout * buffers;
+	size_t bufferCount;
+	WGPUPrimitiveState primitive;
+	bool hasDepthStencil;
+	WGPUDepthStencilState depthStencil;
+	WGPUMultisampleState multisample;
+	bool hasFragment;
+	struct RecordedStage fragment;
+	WGPUColorTargetState * targets;
+	WGPUBlendState * blends; // one per target, used when the target blends
+	size_t targetCount;
+};
+
+static double now(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static char * copyString(char const * str) {
+	if (!str) return NULL;
+	size_t len = strlen(str);
+	char * copy = (char *)malloc(len + 1);
+	memcpy(copy, str, len + 1);
+	return copy;
+}
+
+static void * copyArray(void const * data, size_t count, size_t elementSize) {
+	if (!data || count == 0) return NULL;
+	void * copy = malloc(count * elementSize);
+	memcpy(copy, data, count * elementSize);
+	return copy;
+}
+
+static void * readFile(char const * path, size_t * size) {
+	FILE * file = fopen(path, "rb");
+	if (!file) {
+		fprintf(stderr, "Could not open '%s'\n", path);
+		return NULL;
+	}
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	void * data = length > 0 ? malloc((size_t)length) : NULL;
+	if (data && fread(data, 1, (size_t)length, file) != (size_t)length) {
+		fprintf(stderr, "Could not read '%s'\n", path);
+		free(data);
+		data = NULL;
+	}
+	fclose(file);
+	*size = data ? (size_t)length : 0;
+	return data;
+}
+
+/**
+ * Load the initial content of a resource into `res->loadedData`. Thread
+ * safe as long as generators are.
+ */
+static void loadSource(struct TrackedResource * res, size_t expectedSize) {
+	struct ResourceDataSource const * source = &res->source;
+	res->loadedData = NULL;
+	res->loadedSize = 0;
+	res->ownsLoadedData = false;
+	if (source->data) {
+		res->loadedData = (void *)source->data;
+		res->loadedSize = source->size;
+	} else if (source->path) {
+		res->loadedData = readFile(source->path, &res->loadedSize);
+		res->ownsLoadedData = true;
+	} else if (source->generate) {
+		res->loadedData = malloc(expectedSize);
+		res->ownsLoadedData = true;
+		if (source->generate(source->userData, res->loadedData, expectedSize)) {
+			res->loadedSize = expectedSize;
+		} else {
+			fprintf(stderr, "Could not generate content of '%s'\n", res->label ? res->label : "resource");
+			free(res->loadedData);
+			res->loadedData = NULL;
+		}
+	}
+}
+
+static void freeLoadedSource(struct TrackedResource * res) {
+	if (res->ownsLoadedData) free(res->loadedData);
+	res->loadedData = NULL;
+	res->loadedSize = 0;
+	res->ownsLoadedData = false;
+}
+
+static size_t textureLevel0Size(WGPUTextureDescriptor const * desc) {
+	return (size_t)textureFormatBytesPerTexel(desc->format) * desc->size.width * desc->size.height * desc->size.depthOrArrayLayers;
+}
+
+static void const * rawHandle(struct TrackedResource const * res) {
+	switch (res->type) {
+	case TrackedResource_Buffer: return res->handle.buffer;
+	case TrackedResource_Texture: return res->handle.texture;
+	case TrackedResource_Sampler: return res->handle.sampler;
+	case TrackedResource_ShaderModule: return res->handle.shaderModule;
+	case TrackedResource_BindGroupLayout: return res->handle.bindGroupLayout;
+	case TrackedResource_PipelineLayout: return res->handle.pipelineLayout;
+	case TrackedResource_ComputePipeline: return res->handle.computePipeline;
+	case TrackedResource_RenderPipeline: return res->handle.renderPipeline;
+	}
+	return NULL;
+}
+
+static struct TrackedResource * findTracked(struct DeviceRecovery * recovery, enum TrackedResourceType type, void const * handle) {
+	if (!handle) return NULL;
+	for (struct TrackedResource * res = recovery->resources; res; res = res->next) {
+		if (res->type == type && rawHandle(res) == handle) return res;
+	}
+	fprintf(stderr, "Device recovery: object %p was not created through device-recovery and cannot be recorded\n", handle);
+	return NULL;
+}
+
+static struct TrackedResource * addTracked(struct DeviceRecovery * recovery, enum TrackedResourceType type, char const * label) {
+	struct TrackedResource * res = (struct TrackedResource *)calloc(1, sizeof(struct TrackedResource));
+	res->type = type;
+	res->label = copyString(label);
+	if (recovery->lastResource) {
+		recovery->lastResource->next = res;
+	} else {
+		recovery->resources = res;
+	}
+	recovery->lastResource = res;
+	return res;
+}
+
+static void onDeviceLost(WGPUDeviceLostReason reason, char const * message, void * pUserData) {
+	struct DeviceRecovery * recovery = (struct DeviceRecovery *)pUserData;
+	// Destroyed means the App released the device on purpose
+	if (reason == WGPUDeviceLostReason_Destroyed) return;
+	printf("Device lost: reason %u", reason);
+	if (message) printf(" (%s)", message);
+	printf("\n");
+	recovery->lost = true;
+}
+
+struct DeviceRecovery * deviceRecoveryCreate(WGPUInstance instance, WGPUAdapter adapter, WGPUSurface compatibleSurface, WGPUDevice device, enum DeviceProfile profile) {
+	struct DeviceRecovery * recovery = (struct DeviceRecovery *)calloc(1, sizeof(struct DeviceRecovery));
+	recovery->instance = instance;
+	recovery->adapter = adapter;
+	recovery->compatibleSurface = compatibleSurface;
+	recovery->device = device;
+	recovery->profile = profile;
+	// Recovering replaces the device, so hold a reference of our own
+	wgpuDeviceReference(device);
+	wgpuDeviceSetDeviceLostCallback(device, onDeviceLost, (void *)recovery);
+	return recovery;
+}
+
+// Creation of the GPU object of a recorded resource. These are used both
+// when first creating the resource and when recovering.
+
+static void createBufferObject(WGPUDevice device, struct TrackedResource * res) {
+	WGPUBufferDescriptor desc = res->bufferDesc;
+	desc.label = res->label;
+	desc.size = alignUp(desc.size, 4);
+	desc.mappedAtCreation = res->loadedData != NULL;
+	res->handle.buffer = wgpuDeviceCreateBuffer(device, &desc);
+	if (res->loadedData) {
+		size_t size = res->loadedSize < desc.size ? res->loadedSize : (size_t)desc.size;
+		void * mapped = wgpuBufferGetMappedRange(res->handle.buffer, 0, (size_t)desc.size);
+		if (mapped) memcpy(mapped, res->loadedData, size);
+		wgpuBufferUnmap(res->handle.buffer);
+	}
+}
+
+static void createTextureObject(WGPUDevice device, struct TrackedResource * res) {
+	WGPUTextureDescriptor desc = res->textureDesc;
+	desc.label = res->label;
+	res->handle.texture = wgpuDeviceCreateTexture(device, &desc);
+	if (!res->loadedData) return;
+
+	uint32_t bytesPerTexel = textureFormatBytesPerTexel(desc.format);
+	if (bytesPerTexel == 0 || res->loadedSize < textureLevel0Size(&desc)) {
+		fprintf(stderr, "Device recovery: cannot upload content of texture '%s'\n", res->label ? res->label : "");
+		return;
+	}
+	WGPUImageCopyTexture destination = (WGPUImageCopyTexture) {};
+	destination.texture = res->handle.texture;
+	destination.mipLevel = 0;
+	destination.origin = (WGPUOrigin3D) { 0, 0, 0 };
+	destination.aspect = WGPUTextureAspect_All;
+	WGPUTextureDataLayout layout = (WGPUTextureDataLayout) {};
+	layout.offset = 0;
+	layout.bytesPerRow = bytesPerTexel * desc.size.width;
+	layout.rowsPerImage = desc.size.height;
+	WGPUQueue queue = wgpuDeviceGetQueue(device);
+	wgpuQueueWriteTexture(queue, &destination, res->loadedData, res->loadedSize, &layout, &desc.size);
+	wgpuQueueRelease(queue);
+}
+
+static void createSamplerObject(WGPUDevice device, struct TrackedResource * res) {
+	WGPUSamplerDescriptor desc = res->samplerDesc;
+	desc.label = res->label;
+	res->handle.sampler = wgpuDeviceCreateSampler(device, &desc);
+}
+
+static void createBindGroupLayoutObject(WGPUDevice device, struct TrackedResource * res) {
+	WGPUBindGroupLayoutDescriptor desc = (WGPUBindGroupLayoutDescriptor) {};
+	desc.label = res->label;
+	desc.entryCount = res->layoutEntryCount;
+	desc.entries = res->layoutEntries;
+	res->handle.bindGroupLayout = wgpuDeviceCreateBindGroupLayout(device, &desc);
+}
+
+static void createPipelineLayoutObject(WGPUDevice device, struct TrackedResource * res) {
+	WGPUBindGroupLayout * layouts = (WGPUBindGroupLayout *)calloc(res->bindGroupLayoutCount + 1, sizeof(WGPUBindGroupLayout));
+	for (uint32_t i = 0; i < res->bindGroupLayoutCount; ++i) {
+		layouts[i] = res->bindGroupLayouts[i] ? res->bindGroupLayouts[i]->handle.bindGroupLayout : NULL;
+	}
+	WGPUPipelineLayoutDescriptor desc = (WGPUPipelineLayoutDescriptor) {};
+	desc.label = res->label;
+	desc.bindGroupLayoutCount = res->bindGroupLayoutCount;
+	desc.bindGroupLayouts = layouts;
+	res->handle.pipelineLayout = wgpuDeviceCreatePipelineLayout(device, &desc);
+	free(layouts);
+}
+
+static void recordStage(struct DeviceRecovery * recovery, struct RecordedStage * stage, WGPUShaderModule module, char const * entryPoint, WGPUConstantEntry const * constants, size_t constantCount) {
+	stage->module = findTracked(recovery, TrackedResource_ShaderModule, module);
+	stage->entryPoint = copyString(entryPoint);
+	stage->constantCount = constantCount;
+	stage->constants = (WGPUConstantEntry *)copyArray(constants, constantCount, sizeof(WGPUConstantEntry));
+	for (size_t i = 0; i < constantCount; ++i) {
+		stage->constants[i].nextInChain = NULL;
+		stage->constants[i].key = copyString(constants[i].key);
+	}
+}
+
+static void freeStage(struct RecordedStage * stage) {
+	for (size_t i = 0; i < stage->constantCount; ++i) {
+		free((void *)stage->constants[i].key);
+	}
+	free(stage->constants);
+	free(stage->entryPoint);
+}
+
+static WGPUComputePipelineDescriptor buildComputePipelineDescriptor(struct TrackedResource const * res) {
+	struct RecordedComputePipeline const * rec = res->computeDesc;
+	WGPUComputePipelineDescriptor desc = (WGPUComputePipelineDescriptor) {};
+	desc.label = res->label;
+	desc.layout = rec->layout ? rec->layout->handle.pipelineLayout : NULL;
+	desc.compute.module = rec->compute.module ? rec->compute.module->handle.shaderModule : NULL;
+	desc.compute.entryPoint = rec->compute.entryPoint;
+	desc.compute.constantCount = rec->compute.constantCount;
+	desc.compute.constants = rec->compute.constants;
+	return desc;
+}
+
+/**
+ * Build a render pipeline descriptor from its record. The returned
+ * descriptor points into `res` and into `fragmentState`.
+ */
+static WGPURenderPipelineDescriptor buildRenderPipelineDescriptor(struct TrackedResource const * res, WGPUFragmentState * fragmentState) {
+	struct RecordedRenderPipeline const * rec = res->renderDesc;
+	WGPURenderPipelineDescriptor desc = (WGPURenderPipelineDescriptor) {};
+	desc.label = res->label;
+	desc.layout = rec->layout ? rec->layout->handle.pipelineLayout : NULL;
+	desc.vertex.module = rec->vertex.module ? rec->vertex.module->handle.shaderModule : NULL;
+	desc.vertex.entryPoint = rec->vertex.entryPoint;
+	desc.vertex.constantCount = rec->vertex.constantCount;
+	desc.vertex.constants = rec->vertex.constants;
+	desc.vertex.bufferCount = rec->bufferCount;
+	desc.vertex.buffers = rec->buffers;
+	desc.primitive = rec->primitive;
+	desc.depthStencil = rec->hasDepthStencil ? &rec->depthStencil : NULL;
+	desc.multisample = rec->multisample;
+	if (rec->hasFragment) {
+		*fragmentState = (WGPUFragmentState) {};
+		fragmentState->module = rec->fragment.module ? rec->fragment.module->handle.shaderModule : NULL;
+		fragmentState->entryPoint = rec->fragment.entryPoint;
+		fragmentState->constantCount = rec->fragment.constantCount;
+		fragmentState->constants = rec->fragment.constants;
+		fragmentState->targetCount = rec->targetCount;
+		fragmentState->targets = rec->targets;
+		desc.fragment = fragmentState;
+	} else {
+		desc.fragment = NULL;
+	}
+	return desc;
+}
+
+// Public creation functions
+
+struct TrackedResource * deviceRecoveryCreateBuffer(struct DeviceRecovery * recovery, WGPUBufferDescriptor const * descriptor, struct ResourceDataSource const * source) {
+	struct TrackedResource * res = addTracked(recovery, TrackedResource_Buffer, descriptor->label);
+	res->bufferDesc = *descriptor;
+	res->bufferDesc.nextInChain = NULL;
+	res->bufferDesc.label = NULL;
+	if (source) res->source = *source;
+	loadSource(res, (size_t)descriptor->size);
+	createBufferObject(recovery->device, res);
+	freeLoadedSource(res);
+	return res;
+}
+
+struct TrackedResource * deviceRecoveryCreateTexture(struct DeviceRecovery * recovery, WGPUTextureDescriptor const * descriptor, struct ResourceDataSource const * source) {
+	struct TrackedResource * res = addTracked(recovery, TrackedResource_Texture, descriptor->label);
+	res->textureDesc = *descriptor;
+	res->textureDesc.nextInChain = NULL;
+	res->textureDesc.label = NULL;
+	res->textureDesc.viewFormats = (WGPUTextureFormat const *)copyArray(descriptor->viewFormats, descriptor->viewFormatCount, sizeof(WGPUTextureFormat));
+	if (source) res->source = *source;
+	loadSource(res, textureLevel0Size(descriptor));
+	createTextureObject(recovery->device, res);
+	freeLoadedSource(res);
+	return res;
+}
+
+struct TrackedResource * deviceRecoveryCreateSampler(struct DeviceRecovery * recovery, WGPUSamplerDescriptor const * descriptor) {
+	struct TrackedResource * res = addTracked(recovery, TrackedResource_Sampler, descriptor->label);
+	res->samplerDesc = *descriptor;
+	res->samplerDesc.nextInChain = NULL;
+	res->samplerDesc.label = NULL;
+	createSamplerObject(recovery->device, res);
+	return res;
+}
+
+struct TrackedResource * deviceRecoveryCreateShaderModule(struct DeviceRecovery * recovery, char const * wgslSource, char const * label) {
+	struct TrackedResource * res = addTracked(recovery, TrackedResource_ShaderModule, label);
+	res->wgslSource = copyString(wgslSource);
+	res->handle.shaderModule = createWGSLShaderModule(recovery->device, res->wgslSource, res->label);
+	return res;
+}
+
+struct TrackedResource * deviceRecoveryCreateBindGroupLayout(struct DeviceRecovery * recovery, WGPUBindGroupLayoutDescriptor const * descriptor) {
+	struct TrackedResource * res = addTracked(recovery, TrackedResource_BindGroupLayout, descriptor->label);
+	res->layoutEntryCount = descriptor->entryCount;
+	res->layoutEntries = (WGPUBindGroupLayoutEntry *)copyArray(descriptor->entries, descriptor->entryCount, sizeof(WGPUBindGroupLayoutEntry));
+	for (uint32_t i = 0; i < res->layoutEntryCount; ++i) {
+		res->layoutEntries[i].nextInChain = NULL;
+	}
+	createBindGroupLayoutObject(recovery->device, res);
+	return res;
+}
+
+struct TrackedResource * deviceRecoveryCreatePipelineLayout(struct DeviceRecovery * recovery, WGPUPipelineLayoutDescriptor const * descriptor) {
+	struct TrackedResource * res = addTracked(recovery, TrackedResource_PipelineLayout, descriptor->label);
+	res->bindGroupLayoutCount = descriptor->bindGroupLayoutCount;
+	res->bindGroupLayouts = (struct TrackedResource **)calloc(descriptor->bindGroupLayoutCount + 1, sizeof(struct TrackedResource *));
+	for (uint32_t i = 0; i < descriptor->bindGroupLayoutCount; ++i) {
+		res->bindGroupLayouts[i] = findTracked(recovery, TrackedResource_BindGroupLayout, descriptor->bindGroupLayouts[i]);
+	}
+	createPipelineLayoutObject(recovery->device, res);
+	return res;
+}
+
+struct TrackedResource * deviceRecoveryCreateComputePipeline(struct DeviceRecovery * recovery, WGPUComputePipelineDescriptor const * descriptor) {
+	struct TrackedResource * res = addTracked(recovery, TrackedResource_ComputePipeline, descriptor->label);
+	struct RecordedComputePipeline * rec = (struct RecordedComputePipeline *)calloc(1, sizeof(struct RecordedComputePipeline));
+	rec->layout = findTracked(recovery, TrackedResource_PipelineLayout, descriptor->layout);
+	WGPUProgrammableStageDescriptor const * stage = &descriptor->compute;
+	recordStage(recovery, &rec->compute, stage->module, stage->entryPoint, stage->constants, stage->constantCount);
+	res->computeDesc = rec;
+
+	WGPUComputePipelineDescriptor desc = buildComputePipelineDescriptor(res);
+	res->handle.computePipeline = wgpuDeviceCreateComputePipeline(recovery->device, &desc);
+	return res;
+}
+
+struct TrackedResource * deviceRecoveryCreateRenderPipeline(struct DeviceRecovery * recovery, WGPURenderPipelineDescriptor const * descriptor) {
+	struct TrackedResource * res = addTracked(recovery, TrackedResource_RenderPipeline, descriptor->label);
+	struct RecordedRenderPipeline * rec = (struct RecordedRenderPipeline *)calloc(1, sizeof(struct RecordedRenderPipeline));
+	rec->layout = findTracked(recovery, TrackedResource_PipelineLayout, descriptor->layout);
+
+	WGPUVertexState const * vertex = &descriptor->vertex;
+	recordStage(recovery, &rec->vertex, vertex->module, vertex->entryPoint, vertex->constants, vertex->constantCount);
+	rec->bufferCount = vertex->bufferCount;
+	rec->buffers = (WGPUVertexBufferLayout *)copyArray(vertex->buffers, vertex->bufferCount, sizeof(WGPUVertexBufferLayout));
+	for (size_t i = 0; i < rec->bufferCount; ++i) {
+		rec->buffers[i].attributes = (WGPUVertexAttribute const *)copyArray(vertex->buffers[i].attributes, vertex->buffers[i].attributeCount, sizeof(WGPUVertexAttribute));
+	}
+
+	rec->primitive = descriptor->primitive;
+	rec->primitive.nextInChain = NULL;
+	rec->hasDepthStencil = descriptor->depthStencil != NULL;
+	if (rec->hasDepthStencil) {
+		rec->depthStencil = *descriptor->depthStencil;
+		rec->depthStencil.nextInChain = NULL;
+	}
+	rec->multisample = descriptor->multisample;
+	rec->multisample.nextInChain = NULL;
+
+	WGPUFragmentState const * fragment = descriptor->fragment;
+	rec->hasFragment = fragment != NULL;
+	if (fragment) {
+		recordStage(recovery, &rec->fragment, fragment->module, fragment->entryPoint, fragment->constants, fragment->constantCount);
+		rec->targetCount = fragment->targetCount;
+		rec->targets = (WGPUColorTargetState *)copyArray(fragment->targets, fragment->targetCount, sizeof(WGPUColorTargetState));
+		rec->blends = (WGPUBlendState *)calloc(fragment->targetCount + 1, sizeof(WGPUBlendState));
+		for (size_t i = 0; i < rec->targetCount; ++i) {
+			rec->targets[i].nextInChain = NULL;
+			if (fragment->targets[i].blend) {
+				rec->blends[i] = *fragment->targets[i].blend;
+				rec->targets[i].blend = &rec->blends[i];
+			}
+		}
+	}
+	res->renderDesc = rec;
+
+	WGPUFragmentState fragmentState;
+	WGPURenderPipelineDescriptor desc = buildRenderPipelineDescriptor(res, &fragmentState);
+	res->handle.renderPipeline = wgpuDeviceCreateRenderPipeline(recovery->device, &desc);
+	return res;
+}
+
+void deviceRecoveryAddListener(struct DeviceRecovery * recovery, DeviceRecoveryListener callback, void * userData) {
+	recovery->listeners = (struct DeviceRecoveryListenerEntry *)realloc(recovery->listeners, (recovery->listenerCount + 1) * sizeof(struct DeviceRecoveryListenerEntry));
+	recovery->listeners[recovery->listenerCount].callback = callback;
+	recovery->listeners[recovery->listenerCount].userData = userData;
+	recovery->listenerCount++;
+}
+
+bool deviceRecoveryIsLost(struct DeviceRecovery const * recovery) {
+	return recovery->lost;
+}
+
+// Recovery
+
+static void releaseHandle(struct TrackedResource * res) {
+	switch (res->type) {
+	case TrackedResource_Buffer: if (res->handle.buffer) wgpuBufferRelease(res->handle.buffer); break;
+	case TrackedResource_Texture: if (res->handle.texture) wgpuTextureRelease(res->handle.texture); break;
+	case TrackedResource_Sampler: if (res->handle.sampler) wgpuSamplerRelease(res->handle.sampler); break;
+	case TrackedResource_ShaderModule: if (res->handle.shaderModule) wgpuShaderModuleRelease(res->handle.shaderModule); break;
+	case TrackedResource_BindGroupLayout: if (res->handle.bindGroupLayout) wgpuBindGroupLayoutRelease(res->handle.bindGroupLayout); break;
+	case TrackedResource_PipelineLayout: if (res->handle.pipelineLayout) wgpuPipelineLayoutRelease(res->handle.pipelineLayout); break;
+	case TrackedResource_ComputePipeline: if (res->handle.computePipeline) wgpuComputePipelineRelease(res->handle.computePipeline); break;
+	case TrackedResource_RenderPipeline: if (res->handle.renderPipeline) wgpuRenderPipelineRelease(res->handle.renderPipeline); break;
+	}
+	memset(&res->handle, 0, sizeof(res->handle));
+}
+
+struct LoadQueue {
+	struct TrackedResource ** items;
+	uint32_t count;
+	uint32_t next;
+	mtx_t mutex;
+};
+
+static int loaderThread(void * arg) {
+	struct LoadQueue * queue = (struct LoadQueue *)arg;
+	for (;;) {
+		mtx_lock(&queue->mutex);
+		uint32_t i = queue->next++;
+		mtx_unlock(&queue->mutex);
+		if (i >= queue->count) break;
+
+		struct TrackedResource * res = queue->items[i];
+		size_t expectedSize = res->type == TrackedResource_Buffer ? (size_t)res->bufferDesc.size : textureLevel0Size(&res->textureDesc);
+		loadSource(res, expectedSize);
+	}
+	return 0;
+}
+
+struct PendingPipeline {
+	struct TrackedResource * res;
+	uint32_t * pendingCount;
+	uint32_t * failedCount;
+};
+
+static void onComputePipelineRecreated(WGPUCreatePipelineAsyncStatus status, WGPUComputePipeline pipeline, char const * message, void * pUserData) {
+	struct PendingPipeline * pending = (struct PendingPipeline *)pUserData;
+	if (status == WGPUCreatePipelineAsyncStatus_Success) {
+		pending->res->handle.computePipeline = pipeline;
+	} else {
+		fprintf(stderr, "Could not recreate compute pipeline '%s': %s\n", pending->res->label ? pending->res->label : "", message ? message : "");
+		(*pending->failedCount)++;
+	}
+	(*pending->pendingCount)--;
+}
+
+static void onRenderPipelineRecreated(WGPUCreatePipelineAsyncStatus status, WGPURenderPipeline pipeline, char const * message, void * pUserData) {
+	struct PendingPipeline * pending = (struct PendingPipeline *)pUserData;
+	if (status == WGPUCreatePipelineAsyncStatus_Success) {
+		pending->res->handle.renderPipeline = pipeline;
+	} else {
+		fprintf(stderr, "Could not recreate render pipeline '%s': %s\n", pending->res->label ? pending->res->label : "", message ? message : "");
+		(*pending->failedCount)++;
+	}
+	(*pending->pendingCount)--;
+}
+
+static WGPUDevice acquireNewDevice(struct DeviceRecovery * recovery) {
+	WGPUDevice device = createDeviceWithProfile(recovery->adapter, recovery->profile, "Recovered device");
+	if (device) return device;
+
+	// The adapter itself may have been lost with the device (e.g. GPU reset)
+	WGPURequestAdapterOptions adapterOpts = (WGPURequestAdapterOptions) {};
+	adapterOpts.nextInChain = NULL;
+	adapterOpts.compatibleSurface = recovery->compatibleSurface;
+	WGPUAdapter adapter = requestAdapter(recovery->instance, &adapterOpts);
+	if (!adapter) return NULL;
+	// The adapter given at creation belongs to the App, the ones requested
+	// here to us
+	if (recovery->ownsAdapter) wgpuAdapterRelease(recovery->adapter);
+	recovery->adapter = adapter;
+	recovery->ownsAdapter = true;
+	return createDeviceWithProfile(recovery->adapter, recovery->profile, "Recovered device");
+}
+
+bool deviceRecoveryRecover(struct DeviceRecovery * recovery) {
+	double start = now();
+
+	for (struct TrackedResource * res = recovery->resources; res; res = res->next) {
+		releaseHandle(res);
+	}
+	wgpuDeviceRelease(recovery->device);
+	recovery->device = NULL;
+
+	WGPUDevice device = acquireNewDevice(recovery);
+	if (!device) {
+		fprintf(stderr, "Device recovery: could not acquire a new device\n");
+		return false;
+	}
+	recovery->device = device;
+	wgpuDeviceSetDeviceLostCallback(device, onDeviceLost, (void *)recovery);
+
+	// 1. Reload the initial content of buffers and textures on worker threads
+	struct LoadQueue loadQueue;
+	loadQueue.count = 0;
+	loadQueue.next = 0;
+	uint32_t resourceCount = 0;
+	for (struct TrackedResource * res = recovery->resources; res; res = res->next) ++resourceCount;
+	loadQueue.items = (struct TrackedResource **)calloc(resourceCount + 1, sizeof(struct TrackedResource *));
+	for (struct TrackedResource * res = recovery->resources; res; res = res->next) {
+		bool hasContent = res->type == TrackedResource_Buffer || res->type == TrackedResource_Texture;
+		if (hasContent && (res->source.data || res->source.path || res->source.generate)) {
+			loadQueue.items[loadQueue.count++] = res;
+		}
+	}
+	mtx_init(&loadQueue.mutex, mtx_plain);
+	thrd_t threads[MAX_LOADER_THREADS];
+	uint32_t threadCount = loadQueue.count < MAX_LOADER_THREADS ? loadQueue.count : MAX_LOADER_THREADS;
+	for (uint32_t i = 0; i < threadCount; ++i) {
+		if (thrd_create(&threads[i], loaderThread, &loadQueue) != thrd_success) {
+			threadCount = i;
+			break;
+		}
+	}
+
+	// 2. Meanwhile, recreate lightweight objects in creation order, which
+	// respects their dependencies, and start compiling pipelines in the
+	// background.
+	uint32_t pendingPipelines = 0;
+	uint32_t failedPipelines = 0;
+	struct PendingPipeline * pending = (struct PendingPipeline *)calloc(resourceCount + 1, sizeof(struct PendingPipeline));
+	uint32_t pendingIndex = 0;
+	for (struct TrackedResource * res = recovery->resources; res; res = res->next) {
+		switch (res->type) {
+		case TrackedResource_Sampler:
+			createSamplerObject(device, res);
+			break;
+		case TrackedResource_ShaderModule:
+			res->handle.shaderModule = createWGSLShaderModule(device, res->wgslSource, res->label);
+			break;
+		case TrackedResource_BindGroupLayout:
+			createBindGroupLayoutObject(device, res);
+			break;
+		case TrackedResource_PipelineLayout:
+			createPipelineLayoutObject(device, res);
+			break;
+		case TrackedResource_ComputePipeline: {
+			WGPUComputePipelineDescriptor desc = buildComputePipelineDescriptor(res);
+			pending[pendingIndex] = (struct PendingPipeline) { res, &pendingPipelines, &failedPipelines };
+			++pendingPipelines;
+			wgpuDeviceCreateComputePipelineAsync(device, &desc, onComputePipelineRecreated, &pending[pendingIndex++]);
+			break;
+		}
+		case TrackedResource_RenderPipeline: {
+			WGPUFragmentState fragmentState;
+			WGPURenderPipelineDescriptor desc = buildRenderPipelineDescriptor(res, &fragmentState);
+			pending[pendingIndex] = (struct PendingPipeline) { res, &pendingPipelines, &failedPipelines };
+			++pendingPipelines;
+			wgpuDeviceCreateRenderPipelineAsync(device, &desc, onRenderPipelineRecreated, &pending[pendingIndex++]);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	// 3. Create buffers and textures once their content is available
+	if (threadCount == 0) {
+		loaderThread(&loadQueue);
+	}
+	for (uint32_t i = 0; i < threadCount; ++i) {
+		thrd_join(threads[i], NULL);
+	}
+	mtx_destroy(&loadQueue.mutex);
+	free(loadQueue.items);
+	for (struct TrackedResource * res = recovery->resources; res; res = res->next) {
+		if (res->type == TrackedResource_Buffer) {
+			createBufferObject(device, res);
+			freeLoadedSource(res);
+		} else if (res->type == TrackedResource_Texture) {
+			createTextureObject(device, res);
+			freeLoadedSource(res);
+		}
+	}
+
+	// 4. Wait for pipelines
+	while (pendingPipelines > 0) {
+#ifdef WEBGPU_BACKEND_DAWN
+		wgpuDeviceTick(device);
+#else
+		wgpuInstanceProcessEvents(recovery->instance);
+#endif
+	}
+	free(pending);
+	if (failedPipelines > 0) {
+		// The App would bind missing pipelines, so stay lost
+		fprintf(stderr, "Device recovery: could not recreate %u pipelines\n", failedPipelines);
+		return false;
+	}
+
+	recovery->lost = false;
+	recovery->recoveryCount++;
+	recovery->lastRecoverySeconds = now() - start;
+	printf("Device recovered in %.3f s (%u resources)\n", recovery->lastRecoverySeconds, resourceCount);
+
+	for (uint32_t i = 0; i < recovery->listenerCount; ++i) {
+		recovery->listeners[i].callback(device, recovery->listeners[i].userData);
+	}
+	return true;
+}
+
+void deviceRecoveryRelease(struct DeviceRecovery * recovery) {
+	if (!recovery) return;
+	struct TrackedResource * res = recovery->resources;
+	while (res) {
+		struct TrackedResource * next = res->next;
+		releaseHandle(res);
+		free(res->label);
+		free((void *)res->textureDesc.viewFormats);
+		free(res->wgslSource);
+		free(res->layoutEntries);
+		free(res->bindGroupLayouts);
+		if (res->computeDesc) {
+			freeStage(&res->computeDesc->compute);
+			free(res->computeDesc);
+		}
+		if (res->renderDesc) {
+			struct RecordedRenderPipeline * rec = res->renderDesc;
+			freeStage(&rec->vertex);
+			for (size_t i = 0; i < rec->bufferCount; ++i) {
+				free((void *)rec->buffers[i].attributes);
+			}
+			free(rec->buffers);
+			if (rec->hasFragment) freeStage(&rec->fragment);
+			free(rec->targets);
+			free(rec->blends);
+			free(rec);
+		}
+		free(res);
+		res = next;
+	}
+	if (recovery->device) wgpuDeviceRelease(recovery->device);
+	if (recovery->ownsAdapter) wgpuAdapterRelease(recovery->adapter);
+	free(recovery->listeners);
+	free(recovery);
+}
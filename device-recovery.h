@@ -0,0 +1,182 @@
+/**
+ * Device-loss recovery.
+ *
+ * Resources created through this module record a copy of their descriptor
+ * and where their initial content comes from. When the device is lost, a
+ * new device is acquired and every recorded resource is recreated: initial
+ * data is reloaded on worker threads while shader modules and layouts are
+ * rebuilt on the calling thread and pipelines compile asynchronously in
+ * the driver, so recovery costs roughly the slowest of these rather than
+ * a full cold start.
+ *
+ * Recorded resources are referred to through `struct TrackedResource`,
+ * whose handle changes when recovering: always read it from there rather
+ * than keeping a copy of the raw handle. Objects that are cheap to rebuild
+ * from tracked resources (bind groups, texture views, swap chain) are not
+ * recorded; rebuild them in a listener registered with
+ * deviceRecoveryAddListener.
+ *
+ * Chained structs (nextInChain) of recorded descriptors are not preserved.
+ */
+
+#ifndef _device_recovery_h_
+#define _device_recovery_h_
+
+#include <webgpu/webgpu.h>
+#include "device-creation.h"
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Where the initial content of a buffer, or of mip level 0 of a texture,
+ * comes from. At most one of `data`, `path` and `generate` is set; if none
+ * is, the resource starts zero-initialized. Texture data is tightly packed.
+ */
+struct ResourceDataSource {
+	// Memory owned by the caller, which must outlive the tracked resource
+	void const * data;
+	size_t size;
+	// Or a file read again when recovering
+	char const * path;
+	// Or a function filling `size` bytes at `destination`, possibly called
+	// from a worker thread
+	bool (*generate)(void * userData, void * destination, size_t size);
+	void * userData;
+};
+
+enum TrackedResourceType {
+	TrackedResource_Buffer,
+	TrackedResource_Texture,
+	TrackedResource_Sampler,
+	TrackedResource_ShaderModule,
+	TrackedResource_BindGroupLayout,
+	TrackedResource_PipelineLayout,
+	TrackedResource_ComputePipeline,
+	TrackedResource_RenderPipeline,
+};
+
+struct RecordedRenderPipeline;
+struct RecordedComputePipeline;
+
+struct TrackedResource {
+	enum TrackedResourceType type;
+	union {
+		WGPUBuffer buffer;
+		WGPUTexture texture;
+		WGPUSampler sampler;
+		WGPUShaderModule shaderModule;
+		WGPUBindGroupLayout bindGroupLayout;
+		WGPUPipelineLayout pipelineLayout;
+		WGPUComputePipeline computePipeline;
+		WGPURenderPipeline renderPipeline;
+	} handle;
+
+	// Recorded descriptor, depending on the type
+	char * label;
+	WGPUBufferDescriptor bufferDesc;
+	WGPUTextureDescriptor textureDesc;
+	WGPUSamplerDescriptor samplerDesc;
+	char * wgslSource;
+	WGPUBindGroupLayoutEntry * layoutEntries;
+	uint32_t layoutEntryCount;
+	struct TrackedResource ** bindGroupLayouts;
+	uint32_t bindGroupLayoutCount;
+	struct RecordedComputePipeline * computeDesc;
+	struct RecordedRenderPipeline * renderDesc;
+
+	struct ResourceDataSource source;
+	// Content loaded by a worker thread while recovering
+	void * loadedData;
+	size_t loadedSize;
+	bool ownsLoadedData;
+
+	struct TrackedResource * next;
+};
+
+typedef void (*DeviceRecoveryListener)(WGPUDevice device, void * userData);
+
+struct DeviceRecoveryListenerEntry {
+	DeviceRecoveryListener callback;
+	void * userData;
+};
+
+struct DeviceRecovery {
+	WGPUInstance instance;
+	WGPUAdapter adapter;
+	bool ownsAdapter; // requested when recovering, not the App's
+	WGPUSurface compatibleSurface;
+	WGPUDevice device;
+	enum DeviceProfile profile;
+
+	bool lost;
+	uint32_t recoveryCount;
+	double lastRecoverySeconds;
+
+	struct TrackedResource * resources; // in creation order
+	struct TrackedResource * lastResource;
+
+	struct DeviceRecoveryListenerEntry * listeners;
+	uint32_t listenerCount;
+};
+
+/**
+ * Start watching `device` for loss. The recovery object holds its own
+ * reference to the device, which it replaces when recovering; it does not
+ * take ownership of the instance, adapter and surface, which must outlive
+ * it.
+ */
+struct DeviceRecovery * deviceRecoveryCreate(WGPUInstance instance, WGPUAdapter adapter, WGPUSurface compatibleSurface, WGPUDevice device, enum DeviceProfile profile);
+
+struct TrackedResource * deviceRecoveryCreateBuffer(struct DeviceRecovery * recovery, WGPUBufferDescriptor const * descriptor, struct ResourceDataSource const * source);
+struct TrackedResource * deviceRecoveryCreateTexture(struct DeviceRecovery * recovery, WGPUTextureDescriptor const * descriptor, struct ResourceDataSource const * source);
+struct TrackedResource * deviceRecoveryCreateSampler(struct DeviceRecovery * recovery, WGPUSamplerDescriptor const * descriptor);
+struct TrackedResource * deviceRecoveryCreateShaderModule(struct DeviceRecovery * recovery, char const * wgslSource, char const * label);
+struct TrackedResource * deviceRecoveryCreateBindGroupLayout(struct DeviceRecovery * recovery, WGPUBindGroupLayoutDescriptor const * descriptor);
+
+/**
+ * The bind group layouts of `descriptor` must have been created through
+ * deviceRecoveryCreateBindGroupLayout.
+ */
+struct TrackedResource * deviceRecoveryCreatePipelineLayout(struct DeviceRecovery * recovery, WGPUPipelineLayoutDescriptor const * descriptor);
+
+/**
+ * The shader modules and explicit layout of `descriptor`, if any, must have
+ * been created through this module.
+ */
+struct TrackedResource * deviceRecoveryCreateComputePipeline(struct DeviceRecovery * recovery, WGPUComputePipelineDescriptor const * descriptor);
+struct TrackedResource * deviceRecoveryCreateRenderPipeline(struct DeviceRecovery * recovery, WGPURenderPipelineDescriptor const * descriptor);
+
+/**
+ * Register a callback invoked after recovery, once all tracked resources
+ * have been recreated on the new device.
+ */
+void deviceRecoveryAddListener(struct DeviceRecovery * recovery, DeviceRecoveryListener callback, void * userData);
+
+/**
+ * Whether the device has been lost and deviceRecoveryRecover must be called.
+ */
+bool deviceRecoveryIsLost(struct DeviceRecovery const * recovery);
+
+/**
+ * Acquire a new device and recreate all tracked resources. On success,
+ * `recovery->device` is the new device and listeners have been notified.
+ * Returns false, still lost, if no device could be acquired or a
+ * pipeline could not be recreated. References held by the App to the
+ * lost device stay valid, and are the App's to release.
+ */
+bool deviceRecoveryRecover(struct DeviceRecovery * recovery);
+
+/**
+ * Release all tracked resources.
+ */
+void deviceRecoveryRelease(struct DeviceRecovery * recovery);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _device_recovery_h_
@@ -99,6 +99,29 @@ USAGE:
    PNG allows you to set the deflate compression level by setting the global
    variable 'stbi_write_png_compression_level' (it defaults to 8).
 
+   Large PNGs can be encoded on several threads with
+
+     int stbi_write_png_parallel(char const *filename, int w, int h, int comp, const void *data, int stride_in_bytes,
+                                 int num_bands, stbi_write_parallel_func *parallel, void *parallel_context);
+     int stbi_write_png_to_func_parallel(stbi_write_func *func, void *context, int w, int h, int comp, const void *data,
+                                         int stride_in_bytes, int num_bands, stbi_write_parallel_func *parallel, void *parallel_context);
+
+   which split the image in 'num_bands' bands of rows, each filtered and
+   deflated independently. Bands are joined as sync-flushed deflate blocks
+   under a single zlib header and Adler-32, so any decoder reads the result.
+   Matches never span bands, so files are slightly larger than with
+   stbi_write_png; bands of at least a few dozen rows keep that negligible.
+   This library does not create threads: 'parallel' must call
+   task(task_data, i) once for each i in [0, count), in any order and on any
+   threads, and return once all calls have returned. If 'parallel' is NULL
+   the bands are encoded one after the other. If STBIW_ZLIB_COMPRESS is
+   defined, these fall back to the single-threaded writers.
+
+   PNG filtering, filter selection and deflate match finding use SSE2 on
+   x86-64, AVX2 when the compiler targets it (e.g. -mavx2 or /arch:AVX2),
+   and NEON on ARM. The output is the same bytes as the scalar code, which
+   you get everywhere by defining STBIW_NO_SIMD.
+
    HDR expects linear float data. Since the format is always 32-bit rgb(e)
    data, alpha (if provided) is discarded, and for monochrome data it is
    replicated across all three channels.
@@ -192,6 +215,14 @@ STBIWDEF int stbi_write_tga_to_func(stbi_write_func *func, void *context, int w,
 STBIWDEF int stbi_write_hdr_to_func(stbi_write_func *func, void *context, int w, int h, int comp, const float *data);
 STBIWDEF int stbi_write_jpg_to_func(stbi_write_func *func, void *context, int x, int y, int comp, const void  *data, int quality);
 
+typedef void stbi_write_task(void *task_data, int index);
+typedef void stbi_write_parallel_func(void *context, stbi_write_task *task, void *task_data, int count);
+
+#ifndef STBI_WRITE_NO_STDIO
+STBIWDEF int stbi_write_png_parallel(char const *filename, int w, int h, int comp, const void *data, int stride_in_bytes, int num_bands, stbi_write_parallel_func *parallel, void *parallel_context);
+#endif
+STBIWDEF int stbi_write_png_to_func_parallel(stbi_write_func *func, void *context, int w, int h, int comp, const void *data, int stride_in_bytes, int num_bands, stbi_write_parallel_func *parallel, void *parallel_context);
+
 STBIWDEF void stbi_flip_vertically_on_write(int flip_boolean);
 
 #endif//INCLUDE_STB_IMAGE_WRITE_H
@@ -247,6 +278,43 @@ STBIWDEF void stbi_flip_vertically_on_write(int flip_boolean);
 
 #define STBIW_UCHAR(x) (unsigned char) ((x) & 0xff)
 
+#ifndef STBIW_NO_SIMD
+#if defined(__AVX2__)
+#define STBIW_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STBIW_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define STBIW_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+#if defined(STBIW_AVX2) || defined(STBIW_SSE2) || defined(STBIW_NEON)
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+// index of the lowest set bit, x != 0
+static int stbiw__ctz64(unsigned long long x)
+{
+#ifdef _MSC_VER
+#if defined(_M_X64) || defined(_M_ARM64)
+   unsigned long index;
+   _BitScanForward64(&index, x);
+   return (int) index;
+#else
+   unsigned long index;
+   if (_BitScanForward(&index, (unsigned long) x)) return (int) index;
+   _BitScanForward(&index, (unsigned long) (x >> 32));
+   return 32 + (int) index;
+#endif
+#else
+   return __builtin_ctzll(x);
+#endif
+}
+#endif
+
 #ifdef STB_IMAGE_WRITE_STATIC
 static int stbi_write_png_compression_level = 8;
 static int stbi_write_tga_with_rle = 1;
@@ -858,8 +926,29 @@ static int stbiw__zlib_bitrev(int code, int codebits)
 
 static unsigned int stbiw__zlib_countm(unsigned char *a, unsigned char *b, int limit)
 {
-   int i;
-   for (i=0; i < limit && i < 258; ++i)
+   int i = 0;
+   if (limit > 258) limit = 258;
+#if defined(STBIW_AVX2)
+   for (; i+32 <= limit; i += 32) {
+      __m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i const *) (a+i)), _mm256_loadu_si256((__m256i const *) (b+i)));
+      unsigned int diff = ~(unsigned int) _mm256_movemask_epi8(eq);
+      if (diff) return i + stbiw__ctz64(diff);
+   }
+#elif defined(STBIW_SSE2)
+   for (; i+16 <= limit; i += 16) {
+      __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i const *) (a+i)), _mm_loadu_si128((__m128i const *) (b+i)));
+      unsigned int diff = ~(unsigned int) _mm_movemask_epi8(eq) & 0xffff;
+      if (diff) return i + stbiw__ctz64(diff);
+   }
+#elif defined(STBIW_NEON)
+   for (; i+16 <= limit; i += 16) {
+      uint8x16_t eq = vceqq_u8(vld1q_u8(a+i), vld1q_u8(b+i));
+      // narrow to 4 bits per byte to get a 64-bit mask
+      unsigned long long diff = ~vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+      if (diff) return i + stbiw__ctz64(diff) / 4;
+   }
+#endif
+   for (; i < limit; ++i)
       if (a[i] != b[i]) break;
    return i;
 }
@@ -890,29 +979,26 @@ static unsigned int stbiw__zhash(unsigned char *data)
 
 #define stbiw__ZHASH   16384
 
-#endif // STBIW_ZLIB_COMPRESS
-
-STBIWDEF unsigned char * stbi_zlib_compress(unsigned char *data, int data_len, int *out_len, int quality)
+// Append the deflate stream of data to the stretchy buffer out, without
+// zlib header or Adler-32. Unless is_last, the stream ends with a sync
+// flush, byte aligned and not final, so that another one can follow.
+static unsigned char *stbiw__zlib_deflate(unsigned char *out, unsigned char *data, int data_len, int quality, int is_last)
 {
-#ifdef STBIW_ZLIB_COMPRESS
-   // user provided a zlib compress implementation, use that
-   return STBIW_ZLIB_COMPRESS(data, data_len, out_len, quality);
-#else // use builtin
    static unsigned short lengthc[] = { 3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258, 259 };
    static unsigned char  lengtheb[]= { 0,0,0,0,0,0,0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4,  4,  5,  5,  5,  5,  0 };
    static unsigned short distc[]   = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577, 32768 };
    static unsigned char  disteb[]  = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
    unsigned int bitbuf=0;
    int i,j, bitcount=0;
-   unsigned char *out = NULL;
+   int start = stbiw__sbcount(out);
    unsigned char ***hash_table = (unsigned char***) STBIW_MALLOC(stbiw__ZHASH * sizeof(unsigned char**));
-   if (hash_table == NULL)
+   if (hash_table == NULL) {
+      (void) stbiw__sbfree(out);
       return NULL;
+   }
    if (quality < 5) quality = 5;
 
-   stbiw__sbpush(out, 0x78);   // DEFLATE 32K window
-   stbiw__sbpush(out, 0x5e);   // FLEVEL = 1
-   stbiw__zlib_add(1,1);  // BFINAL = 1
+   stbiw__zlib_add(is_last,1);  // BFINAL
    stbiw__zlib_add(1,2);  // BTYPE = 1 -- fixed huffman
 
    for (i=0; i < stbiw__ZHASH; ++i)
@@ -973,21 +1059,32 @@ STBIWDEF unsigned char * stbi_zlib_compress(unsigned char *data, int data_len, i
    for (;i < data_len; ++i)
       stbiw__zlib_huffb(data[i]);
    stbiw__zlib_huff(256); // end of block
+   if (!is_last) {
+      // sync flush: an empty stored block, so that more blocks can follow
+      stbiw__zlib_add(0,1);  // BFINAL = 0
+      stbiw__zlib_add(0,2);  // BTYPE = 0 -- no compression
+   }
    // pad with 0 bits to byte boundary
    while (bitcount)
       stbiw__zlib_add(0,1);
+   if (!is_last) {
+      stbiw__sbpush(out, 0x00); // LEN
+      stbiw__sbpush(out, 0x00);
+      stbiw__sbpush(out, 0xff); // NLEN
+      stbiw__sbpush(out, 0xff);
+   }
 
    for (i=0; i < stbiw__ZHASH; ++i)
       (void) stbiw__sbfree(hash_table[i]);
    STBIW_FREE(hash_table);
 
    // store uncompressed instead if compression was worse
-   if (stbiw__sbn(out) > data_len + 2 + ((data_len+32766)/32767)*5) {
-      stbiw__sbn(out) = 2;  // truncate to DEFLATE 32K window and FLEVEL = 1
+   if (stbiw__sbn(out) > start + data_len + ((data_len+32766)/32767)*5) {
+      stbiw__sbn(out) = start;  // truncate to what preceded this stream
       for (j = 0; j < data_len;) {
          int blocklen = data_len - j;
          if (blocklen > 32767) blocklen = 32767;
-         stbiw__sbpush(out, data_len - j == blocklen); // BFINAL = ?, BTYPE = 0 -- no compression
+         stbiw__sbpush(out, is_last && data_len - j == blocklen); // BFINAL = ?, BTYPE = 0 -- no compression
          stbiw__sbpush(out, STBIW_UCHAR(blocklen)); // LEN
          stbiw__sbpush(out, STBIW_UCHAR(blocklen >> 8));
          stbiw__sbpush(out, STBIW_UCHAR(~blocklen)); // NLEN
@@ -998,22 +1095,62 @@ STBIWDEF unsigned char * stbi_zlib_compress(unsigned char *data, int data_len, i
       }
    }
 
-   {
-      // compute adler32 on input
-      unsigned int s1=1, s2=0;
-      int blocklen = (int) (data_len % 5552);
-      j=0;
-      while (j < data_len) {
-         for (i=0; i < blocklen; ++i) { s1 += data[j+i]; s2 += s1; }
-         s1 %= 65521; s2 %= 65521;
-         j += blocklen;
-         blocklen = 5552;
-      }
-      stbiw__sbpush(out, STBIW_UCHAR(s2 >> 8));
-      stbiw__sbpush(out, STBIW_UCHAR(s2));
-      stbiw__sbpush(out, STBIW_UCHAR(s1 >> 8));
-      stbiw__sbpush(out, STBIW_UCHAR(s1));
+   return out;
+}
+
+static unsigned int stbiw__adler32(unsigned char *data, int data_len)
+{
+   unsigned int s1=1, s2=0;
+   int i, j=0;
+   int blocklen = (int) (data_len % 5552);
+   while (j < data_len) {
+      for (i=0; i < blocklen; ++i) { s1 += data[j+i]; s2 += s1; }
+      s1 %= 65521; s2 %= 65521;
+      j += blocklen;
+      blocklen = 5552;
    }
+   return (s2 << 16) | s1;
+}
+
+// Adler-32 of the concatenation of two buffers, from their Adler-32 and
+// the length of the second one (as adler32_combine in zlib)
+static unsigned int stbiw__adler32_combine(unsigned int adler1, unsigned int adler2, unsigned int len2)
+{
+   unsigned int base = 65521;
+   unsigned int rem = len2 % base;
+   unsigned int sum1 = adler1 & 0xffff;
+   unsigned int sum2 = (rem * sum1) % base;
+   sum1 += (adler2 & 0xffff) + base - 1;
+   sum2 += (adler1 >> 16) + (adler2 >> 16) + base - rem;
+   if (sum1 >= base) sum1 -= base;
+   if (sum1 >= base) sum1 -= base;
+   if (sum2 >= (base << 1)) sum2 -= (base << 1);
+   if (sum2 >= base) sum2 -= base;
+   return sum1 | (sum2 << 16);
+}
+
+#endif // STBIW_ZLIB_COMPRESS
+
+STBIWDEF unsigned char * stbi_zlib_compress(unsigned char *data, int data_len, int *out_len, int quality)
+{
+#ifdef STBIW_ZLIB_COMPRESS
+   // user provided a zlib compress implementation, use that
+   return STBIW_ZLIB_COMPRESS(data, data_len, out_len, quality);
+#else // use builtin
+   unsigned int adler;
+   unsigned char *out = NULL;
+
+   stbiw__sbpush(out, 0x78);   // DEFLATE 32K window
+   stbiw__sbpush(out, 0x5e);   // FLEVEL = 1
+   out = stbiw__zlib_deflate(out, data, data_len, quality, 1);
+   if (out == NULL)
+      return NULL;
+
+   adler = stbiw__adler32(data, data_len);
+   stbiw__sbpush(out, STBIW_UCHAR(adler >> 24));
+   stbiw__sbpush(out, STBIW_UCHAR(adler >> 16));
+   stbiw__sbpush(out, STBIW_UCHAR(adler >> 8));
+   stbiw__sbpush(out, STBIW_UCHAR(adler));
    *out_len = stbiw__sbn(out);
    // make returned pointer freeable
    STBIW_MEMMOVE(stbiw__sbraw(out), out, *out_len);
@@ -1088,6 +1225,204 @@ static unsigned char stbiw__paeth(int a, int b, int c)
    return STBIW_UCHAR(c);
 }
 
+#if defined(STBIW_AVX2) || defined(STBIW_SSE2)
+#ifdef STBIW_AVX2
+#define stbiw__vec              __m256i
+#define stbiw__vec_bytes        32
+#define stbiw__load(p)          _mm256_loadu_si256((__m256i const *) (p))
+#define stbiw__store(p,v)       _mm256_storeu_si256((__m256i *) (p), v)
+#define stbiw__set1_8(x)        _mm256_set1_epi8(x)
+#define stbiw__zero()           _mm256_setzero_si256()
+#define stbiw__and(a,b)         _mm256_and_si256(a,b)
+#define stbiw__andnot(a,b)      _mm256_andnot_si256(a,b)
+#define stbiw__or(a,b)          _mm256_or_si256(a,b)
+#define stbiw__xor(a,b)         _mm256_xor_si256(a,b)
+#define stbiw__sub8(a,b)        _mm256_sub_epi8(a,b)
+#define stbiw__avgu8(a,b)       _mm256_avg_epu8(a,b)
+#define stbiw__minu8(a,b)       _mm256_min_epu8(a,b)
+#define stbiw__sad(a,b)         _mm256_sad_epu8(a,b)
+#define stbiw__add64(a,b)       _mm256_add_epi64(a,b)
+#define stbiw__srli16(a,c)      _mm256_srli_epi16(a,c)
+#define stbiw__lo8to16(a)       _mm256_unpacklo_epi8(a, _mm256_setzero_si256())
+#define stbiw__hi8to16(a)       _mm256_unpackhi_epi8(a, _mm256_setzero_si256())
+#define stbiw__pack16to8(a,b)   _mm256_packus_epi16(a,b)
+#define stbiw__add16(a,b)       _mm256_add_epi16(a,b)
+#define stbiw__sub16(a,b)       _mm256_sub_epi16(a,b)
+#define stbiw__abs16(a)         _mm256_abs_epi16(a)
+#define stbiw__cmpgt16(a,b)     _mm256_cmpgt_epi16(a,b)
+#else
+#define stbiw__vec              __m128i
+#define stbiw__vec_bytes        16
+#define stbiw__load(p)          _mm_loadu_si128((__m128i const *) (p))
+#define stbiw__store(p,v)       _mm_storeu_si128((__m128i *) (p), v)
+#define stbiw__set1_8(x)        _mm_set1_epi8(x)
+#define stbiw__zero()           _mm_setzero_si128()
+#define stbiw__and(a,b)         _mm_and_si128(a,b)
+#define stbiw__andnot(a,b)      _mm_andnot_si128(a,b)
+#define stbiw__or(a,b)          _mm_or_si128(a,b)
+#define stbiw__xor(a,b)         _mm_xor_si128(a,b)
+#define stbiw__sub8(a,b)        _mm_sub_epi8(a,b)
+#define stbiw__avgu8(a,b)       _mm_avg_epu8(a,b)
+#define stbiw__minu8(a,b)       _mm_min_epu8(a,b)
+#define stbiw__sad(a,b)         _mm_sad_epu8(a,b)
+#define stbiw__add64(a,b)       _mm_add_epi64(a,b)
+#define stbiw__srli16(a,c)      _mm_srli_epi16(a,c)
+#define stbiw__lo8to16(a)       _mm_unpacklo_epi8(a, _mm_setzero_si128())
+#define stbiw__hi8to16(a)       _mm_unpackhi_epi8(a, _mm_setzero_si128())
+#define stbiw__pack16to8(a,b)   _mm_packus_epi16(a,b)
+#define stbiw__add16(a,b)       _mm_add_epi16(a,b)
+#define stbiw__sub16(a,b)       _mm_sub_epi16(a,b)
+#define stbiw__abs16(a)         _mm_max_epi16(a, _mm_sub_epi16(_mm_setzero_si128(), a)) // no pabsw before SSSE3
+#define stbiw__cmpgt16(a,b)     _mm_cmpgt_epi16(a,b)
+#endif
+
+// paeth predictor on 16-bit lanes, same ties as stbiw__paeth
+static stbiw__vec stbiw__paeth16(stbiw__vec a, stbiw__vec b, stbiw__vec c)
+{
+   stbiw__vec pa = stbiw__sub16(b, c);
+   stbiw__vec pb = stbiw__sub16(a, c);
+   stbiw__vec pc = stbiw__abs16(stbiw__add16(pa, pb));
+   stbiw__vec not_a, not_b;
+   pa = stbiw__abs16(pa);
+   pb = stbiw__abs16(pb);
+   not_a = stbiw__or(stbiw__cmpgt16(pa, pb), stbiw__cmpgt16(pa, pc));
+   not_b = stbiw__cmpgt16(pb, pc);
+   a = stbiw__andnot(not_a, a);
+   b = stbiw__and(stbiw__andnot(not_b, not_a), b);
+   c = stbiw__and(stbiw__and(not_b, not_a), c);
+   return stbiw__or(a, stbiw__or(b, c));
+}
+
+// filter bytes [n, len) of a row, as far as whole vectors go; returns where it stopped
+static int stbiw__encode_png_line_simd(unsigned char *z, int signed_stride, int n, int len, int type, signed char *line_buffer)
+{
+   int i = n;
+   stbiw__vec x, a, b, c;
+   switch (type) {
+      case 1: case 6: // paeth(a,0,0) is a
+         for (; i+stbiw__vec_bytes <= len; i += stbiw__vec_bytes)
+            stbiw__store(line_buffer+i, stbiw__sub8(stbiw__load(z+i), stbiw__load(z+i-n)));
+         break;
+      case 2:
+         for (; i+stbiw__vec_bytes <= len; i += stbiw__vec_bytes)
+            stbiw__store(line_buffer+i, stbiw__sub8(stbiw__load(z+i), stbiw__load(z+i-signed_stride)));
+         break;
+      case 3:
+         for (; i+stbiw__vec_bytes <= len; i += stbiw__vec_bytes) {
+            a = stbiw__load(z+i-n);
+            b = stbiw__load(z+i-signed_stride);
+            // pavgb rounds up, (a+b)>>1 rounds down
+            c = stbiw__sub8(stbiw__avgu8(a, b), stbiw__and(stbiw__xor(a, b), stbiw__set1_8(1)));
+            stbiw__store(line_buffer+i, stbiw__sub8(stbiw__load(z+i), c));
+         }
+         break;
+      case 4:
+         for (; i+stbiw__vec_bytes <= len; i += stbiw__vec_bytes) {
+            x = stbiw__load(z+i);
+            a = stbiw__load(z+i-n);
+            b = stbiw__load(z+i-signed_stride);
+            c = stbiw__load(z+i-signed_stride-n);
+            c = stbiw__pack16to8(stbiw__paeth16(stbiw__lo8to16(a), stbiw__lo8to16(b), stbiw__lo8to16(c)),
+                                 stbiw__paeth16(stbiw__hi8to16(a), stbiw__hi8to16(b), stbiw__hi8to16(c)));
+            stbiw__store(line_buffer+i, stbiw__sub8(x, c));
+         }
+         break;
+      case 5:
+         for (; i+stbiw__vec_bytes <= len; i += stbiw__vec_bytes) {
+            a = stbiw__and(stbiw__srli16(stbiw__load(z+i-n), 1), stbiw__set1_8(0x7f));
+            stbiw__store(line_buffer+i, stbiw__sub8(stbiw__load(z+i), a));
+         }
+         break;
+   }
+   return i;
+}
+
+// sum of abs((signed char) line_buffer[i]) over whole vectors; *i is where it stopped
+static int stbiw__png_line_score_simd(signed char *line_buffer, int len, int *i)
+{
+   stbiw__vec sum = stbiw__zero(), zero = stbiw__zero(), v;
+   long long lanes[stbiw__vec_bytes/8];
+   int k, est = 0;
+   for (*i = 0; *i+stbiw__vec_bytes <= len; *i += stbiw__vec_bytes) {
+      v = stbiw__load(line_buffer+*i);
+      // |v| as unsigned is min(v, -v), 128 included
+      sum = stbiw__add64(sum, stbiw__sad(stbiw__minu8(v, stbiw__sub8(zero, v)), zero));
+   }
+   stbiw__store(lanes, sum);
+   for (k = 0; k < stbiw__vec_bytes/8; ++k)
+      est += (int) lanes[k];
+   return est;
+}
+#elif defined(STBIW_NEON)
+static uint8x16_t stbiw__paeth_neon(uint8x8_t a, uint8x8_t b, uint8x8_t c, uint8x8_t a_hi, uint8x8_t b_hi, uint8x8_t c_hi)
+{
+   uint8x8_t half[2];
+   int k;
+   for (k = 0; k < 2; ++k) {
+      int16x8_t pa = vreinterpretq_s16_u16(vsubl_u8(b, c));
+      int16x8_t pb = vreinterpretq_s16_u16(vsubl_u8(a, c));
+      int16x8_t pc = vabsq_s16(vaddq_s16(pa, pb));
+      uint8x8_t use_a, use_b;
+      pa = vabsq_s16(pa);
+      pb = vabsq_s16(pb);
+      use_a = vmovn_u16(vandq_u16(vcleq_s16(pa, pb), vcleq_s16(pa, pc)));
+      use_b = vmovn_u16(vcleq_s16(pb, pc));
+      half[k] = vbsl_u8(use_a, a, vbsl_u8(use_b, b, c));
+      a = a_hi; b = b_hi; c = c_hi;
+   }
+   return vcombine_u8(half[0], half[1]);
+}
+
+static int stbiw__encode_png_line_simd(unsigned char *z, int signed_stride, int n, int len, int type, signed char *line_buffer)
+{
+   int i = n;
+   uint8x16_t a, b, c;
+   switch (type) {
+      case 1: case 6: // paeth(a,0,0) is a
+         for (; i+16 <= len; i += 16)
+            vst1q_s8(line_buffer+i, vreinterpretq_s8_u8(vsubq_u8(vld1q_u8(z+i), vld1q_u8(z+i-n))));
+         break;
+      case 2:
+         for (; i+16 <= len; i += 16)
+            vst1q_s8(line_buffer+i, vreinterpretq_s8_u8(vsubq_u8(vld1q_u8(z+i), vld1q_u8(z+i-signed_stride))));
+         break;
+      case 3:
+         for (; i+16 <= len; i += 16) {
+            c = vhaddq_u8(vld1q_u8(z+i-n), vld1q_u8(z+i-signed_stride));
+            vst1q_s8(line_buffer+i, vreinterpretq_s8_u8(vsubq_u8(vld1q_u8(z+i), c)));
+         }
+         break;
+      case 4:
+         for (; i+16 <= len; i += 16) {
+            a = vld1q_u8(z+i-n);
+            b = vld1q_u8(z+i-signed_stride);
+            c = vld1q_u8(z+i-signed_stride-n);
+            c = stbiw__paeth_neon(vget_low_u8(a), vget_low_u8(b), vget_low_u8(c), vget_high_u8(a), vget_high_u8(b), vget_high_u8(c));
+            vst1q_s8(line_buffer+i, vreinterpretq_s8_u8(vsubq_u8(vld1q_u8(z+i), c)));
+         }
+         break;
+      case 5:
+         for (; i+16 <= len; i += 16)
+            vst1q_s8(line_buffer+i, vreinterpretq_s8_u8(vsubq_u8(vld1q_u8(z+i), vshrq_n_u8(vld1q_u8(z+i-n), 1))));
+         break;
+   }
+   return i;
+}
+
+static int stbiw__png_line_score_simd(signed char *line_buffer, int len, int *i)
+{
+   uint32x4_t sum = vdupq_n_u32(0);
+   uint64x2_t sum64;
+   for (*i = 0; *i+16 <= len; *i += 16) {
+      // vabsq_s8 wraps -128 to -128, which is 128 as unsigned
+      uint8x16_t v = vreinterpretq_u8_s8(vabsq_s8(vld1q_s8(line_buffer+*i)));
+      sum = vpadalq_u16(sum, vpaddlq_u8(v));
+   }
+   sum64 = vpaddlq_u32(sum);
+   return (int) (vgetq_lane_u64(sum64, 0) + vgetq_lane_u64(sum64, 1));
+}
+#endif
+
 // @OPTIMIZE: provide an option that always forces left-predict or paeth predict
 static void stbiw__encode_png_line(unsigned char *pixels, int stride_bytes, int width, int height, int y, int n, int filter_type, signed char *line_buffer)
 {
@@ -1115,71 +1450,69 @@ static void stbiw__encode_png_line(unsigned char *pixels, int stride_bytes, int
          case 6: line_buffer[i] = z[i]; break;
       }
    }
+#if defined(STBIW_AVX2) || defined(STBIW_SSE2) || defined(STBIW_NEON)
+   i = stbiw__encode_png_line_simd(z, signed_stride, n, width*n, type, line_buffer);
+#else
+   i = n;
+#endif
    switch (type) {
-      case 1: for (i=n; i < width*n; ++i) line_buffer[i] = z[i] - z[i-n]; break;
-      case 2: for (i=n; i < width*n; ++i) line_buffer[i] = z[i] - z[i-signed_stride]; break;
-      case 3: for (i=n; i < width*n; ++i) line_buffer[i] = z[i] - ((z[i-n] + z[i-signed_stride])>>1); break;
-      case 4: for (i=n; i < width*n; ++i) line_buffer[i] = z[i] - stbiw__paeth(z[i-n], z[i-signed_stride], z[i-signed_stride-n]); break;
-      case 5: for (i=n; i < width*n; ++i) line_buffer[i] = z[i] - (z[i-n]>>1); break;
-      case 6: for (i=n; i < width*n; ++i) line_buffer[i] = z[i] - stbiw__paeth(z[i-n], 0,0); break;
+      case 1: for (; i < width*n; ++i) line_buffer[i] = z[i] - z[i-n]; break;
+      case 2: for (; i < width*n; ++i) line_buffer[i] = z[i] - z[i-signed_stride]; break;
+      case 3: for (; i < width*n; ++i) line_buffer[i] = z[i] - ((z[i-n] + z[i-signed_stride])>>1); break;
+      case 4: for (; i < width*n; ++i) line_buffer[i] = z[i] - stbiw__paeth(z[i-n], z[i-signed_stride], z[i-signed_stride-n]); break;
+      case 5: for (; i < width*n; ++i) line_buffer[i] = z[i] - (z[i-n]>>1); break;
+      case 6: for (; i < width*n; ++i) line_buffer[i] = z[i] - stbiw__paeth(z[i-n], 0,0); break;
    }
 }
 
-STBIWDEF unsigned char *stbi_write_png_to_mem(const unsigned char *pixels, int stride_bytes, int x, int y, int n, int *out_len)
+// Filter row y of the image into filt: the filter type byte, then the
+// filtered row. line_buffer holds x*n bytes.
+static void stbiw__png_filter_row(const unsigned char *pixels, int stride_bytes, int x, int y, int n, int j, int force_filter, signed char *line_buffer, unsigned char *filt)
 {
-   int force_filter = stbi_write_force_png_filter;
-   int ctype[5] = { -1, 0, 4, 2, 6 };
-   unsigned char sig[8] = { 137,80,78,71,13,10,26,10 };
-   unsigned char *out,*o, *filt, *zlib;
-   signed char *line_buffer;
-   int j,zlen;
-
-   if (stride_bytes == 0)
-      stride_bytes = x * n;
-
-   if (force_filter >= 5) {
-      force_filter = -1;
-   }
-
-   filt = (unsigned char *) STBIW_MALLOC((x*n+1) * y); if (!filt) return 0;
-   line_buffer = (signed char *) STBIW_MALLOC(x * n); if (!line_buffer) { STBIW_FREE(filt); return 0; }
-   for (j=0; j < y; ++j) {
-      int filter_type;
-      if (force_filter > -1) {
-         filter_type = force_filter;
-         stbiw__encode_png_line((unsigned char*)(pixels), stride_bytes, x, y, j, n, force_filter, line_buffer);
-      } else { // Estimate the best filter by running through all of them:
-         int best_filter = 0, best_filter_val = 0x7fffffff, est, i;
-         for (filter_type = 0; filter_type < 5; filter_type++) {
-            stbiw__encode_png_line((unsigned char*)(pixels), stride_bytes, x, y, j, n, filter_type, line_buffer);
-
-            // Estimate the entropy of the line using this filter; the less, the better.
-            est = 0;
-            for (i = 0; i < x*n; ++i) {
-               est += abs((signed char) line_buffer[i]);
-            }
-            if (est < best_filter_val) {
-               best_filter_val = est;
-               best_filter = filter_type;
-            }
+   int filter_type;
+   if (force_filter > -1) {
+      filter_type = force_filter;
+      stbiw__encode_png_line((unsigned char*)(pixels), stride_bytes, x, y, j, n, force_filter, line_buffer);
+   } else { // Estimate the best filter by running through all of them:
+      int best_filter = 0, best_filter_val = 0x7fffffff, est, i;
+      for (filter_type = 0; filter_type < 5; filter_type++) {
+         stbiw__encode_png_line((unsigned char*)(pixels), stride_bytes, x, y, j, n, filter_type, line_buffer);
+
+         // Estimate the entropy of the line using this filter; the less, the better.
+#if defined(STBIW_AVX2) || defined(STBIW_SSE2) || defined(STBIW_NEON)
+         est = stbiw__png_line_score_simd(line_buffer, x*n, &i);
+#else
+         est = 0;
+         i = 0;
+#endif
+         for (; i < x*n; ++i) {
+            est += abs((signed char) line_buffer[i]);
          }
-         if (filter_type != best_filter) {  // If the last iteration already got us the best filter, don't redo it
-            stbiw__encode_png_line((unsigned char*)(pixels), stride_bytes, x, y, j, n, best_filter, line_buffer);
-            filter_type = best_filter;
+         if (est < best_filter_val) {
+            best_filter_val = est;
+            best_filter = filter_type;
          }
       }
-      // when we get here, filter_type contains the filter type, and line_buffer contains the data
-      filt[j*(x*n+1)] = (unsigned char) filter_type;
-      STBIW_MEMMOVE(filt+j*(x*n+1)+1, line_buffer, x*n);
+      if (filter_type != best_filter) {  // If the last iteration already got us the best filter, don't redo it
+         stbiw__encode_png_line((unsigned char*)(pixels), stride_bytes, x, y, j, n, best_filter, line_buffer);
+         filter_type = best_filter;
+      }
    }
-   STBIW_FREE(line_buffer);
-   zlib = stbi_zlib_compress(filt, y*( x*n+1), &zlen, stbi_write_png_compression_level);
-   STBIW_FREE(filt);
-   if (!zlib) return 0;
+   // when we get here, filter_type contains the filter type, and line_buffer contains the data
+   filt[0] = (unsigned char) filter_type;
+   STBIW_MEMMOVE(filt+1, line_buffer, x*n);
+}
+
+// Wrap a zlib stream in the chunks of a PNG file. Frees zlib.
+static unsigned char *stbiw__png_from_zlib(unsigned char *zlib, int zlen, int x, int y, int n, int *out_len)
+{
+   int ctype[5] = { -1, 0, 4, 2, 6 };
+   unsigned char sig[8] = { 137,80,78,71,13,10,26,10 };
+   unsigned char *out,*o;
 
    // each tag requires 12 bytes of overhead
    out = (unsigned char *) STBIW_MALLOC(8 + 12+13 + 12+zlen + 12);
-   if (!out) return 0;
+   if (!out) { STBIW_FREE(zlib); return 0; }
    *out_len = 8 + 12+13 + 12+zlen + 12;
 
    o=out;
@@ -1211,6 +1544,137 @@ STBIWDEF unsigned char *stbi_write_png_to_mem(const unsigned char *pixels, int s
    return out;
 }
 
+STBIWDEF unsigned char *stbi_write_png_to_mem(const unsigned char *pixels, int stride_bytes, int x, int y, int n, int *out_len)
+{
+   int force_filter = stbi_write_force_png_filter;
+   unsigned char *filt, *zlib;
+   signed char *line_buffer;
+   int j,zlen;
+
+   if (stride_bytes == 0)
+      stride_bytes = x * n;
+
+   if (force_filter >= 5) {
+      force_filter = -1;
+   }
+
+   filt = (unsigned char *) STBIW_MALLOC((x*n+1) * y); if (!filt) return 0;
+   line_buffer = (signed char *) STBIW_MALLOC(x * n); if (!line_buffer) { STBIW_FREE(filt); return 0; }
+   for (j=0; j < y; ++j) {
+      stbiw__png_filter_row(pixels, stride_bytes, x, y, n, j, force_filter, line_buffer, filt+j*(x*n+1));
+   }
+   STBIW_FREE(line_buffer);
+   zlib = stbi_zlib_compress(filt, y*( x*n+1), &zlen, stbi_write_png_compression_level);
+   STBIW_FREE(filt);
+   if (!zlib) return 0;
+
+   return stbiw__png_from_zlib(zlib, zlen, x, y, n, out_len);
+}
+
+#ifndef STBIW_ZLIB_COMPRESS
+typedef struct
+{
+   const unsigned char *pixels;
+   int stride_bytes, x, y, n;
+   int force_filter, quality;
+   int num_bands;
+   unsigned char **band_zlib; // stretchy buffers of raw deflate data
+   unsigned int *band_adler;
+} stbiw__png_bands;
+
+static void stbiw__png_encode_band(void *task_data, int band)
+{
+   stbiw__png_bands *b = (stbiw__png_bands *) task_data;
+   int y0 = (int) ((long long) b->y * band / b->num_bands);
+   int y1 = (int) ((long long) b->y * (band+1) / b->num_bands);
+   int row_len = b->x*b->n+1, j;
+   unsigned char *filt;
+   signed char *line_buffer;
+
+   filt = (unsigned char *) STBIW_MALLOC(row_len * (y1-y0)); if (!filt) return;
+   line_buffer = (signed char *) STBIW_MALLOC(b->x * b->n); if (!line_buffer) { STBIW_FREE(filt); return; }
+   // rows are filtered against the row above even across bands, so the
+   // filtered data is the same as with a single band
+   for (j=y0; j < y1; ++j) {
+      stbiw__png_filter_row(b->pixels, b->stride_bytes, b->x, b->y, b->n, j, b->force_filter, line_buffer, filt+(j-y0)*row_len);
+   }
+   STBIW_FREE(line_buffer);
+   b->band_adler[band] = stbiw__adler32(filt, row_len * (y1-y0));
+   b->band_zlib[band] = stbiw__zlib_deflate(NULL, filt, row_len * (y1-y0), b->quality, band == b->num_bands-1);
+   STBIW_FREE(filt);
+}
+#endif // STBIW_ZLIB_COMPRESS
+
+static unsigned char *stbiw__write_png_to_mem_parallel(const unsigned char *pixels, int stride_bytes, int x, int y, int n, int *out_len, int num_bands, stbi_write_parallel_func *parallel, void *parallel_context)
+{
+#ifdef STBIW_ZLIB_COMPRESS
+   // a custom compressor cannot append independent streams
+   (void) num_bands; (void) parallel; (void) parallel_context;
+   return stbi_write_png_to_mem(pixels, stride_bytes, x, y, n, out_len);
+#else
+   stbiw__png_bands b;
+   unsigned char *zlib = NULL;
+   unsigned int adler = 1;
+   int i, failed = 0, row_len = x*n+1;
+
+   if (stride_bytes == 0)
+      stride_bytes = x * n;
+   if (num_bands > y) num_bands = y;
+   if (num_bands < 1) num_bands = 1;
+
+   b.pixels = pixels;
+   b.stride_bytes = stride_bytes;
+   b.x = x;
+   b.y = y;
+   b.n = n;
+   b.force_filter = stbi_write_force_png_filter >= 5 ? -1 : stbi_write_force_png_filter;
+   b.quality = stbi_write_png_compression_level;
+   b.num_bands = num_bands;
+   b.band_zlib = (unsigned char **) STBIW_MALLOC(num_bands * sizeof(unsigned char *)); if (!b.band_zlib) return 0;
+   b.band_adler = (unsigned int *) STBIW_MALLOC(num_bands * sizeof(unsigned int)); if (!b.band_adler) { STBIW_FREE(b.band_zlib); return 0; }
+   for (i=0; i < num_bands; ++i)
+      b.band_zlib[i] = NULL;
+
+   if (parallel) {
+      parallel(parallel_context, stbiw__png_encode_band, &b, num_bands);
+   } else {
+      for (i=0; i < num_bands; ++i)
+         stbiw__png_encode_band(&b, i);
+   }
+
+   stbiw__sbpush(zlib, 0x78);   // DEFLATE 32K window
+   stbiw__sbpush(zlib, 0x5e);   // FLEVEL = 1
+   for (i=0; i < num_bands; ++i) {
+      int band_len = stbiw__sbcount(b.band_zlib[i]);
+      int y0 = (int) ((long long) y * i / num_bands);
+      int y1 = (int) ((long long) y * (i+1) / num_bands);
+      if (!b.band_zlib[i]) { failed = 1; continue; }
+      if (!failed) {
+         if (stbiw__sbneedgrow(zlib, band_len)) stbiw__sbgrow(zlib, band_len);
+         memcpy(zlib+stbiw__sbn(zlib), b.band_zlib[i], band_len);
+         stbiw__sbn(zlib) += band_len;
+         adler = stbiw__adler32_combine(adler, b.band_adler[i], (unsigned int) (row_len * (y1-y0)));
+      }
+      (void) stbiw__sbfree(b.band_zlib[i]);
+   }
+   STBIW_FREE(b.band_zlib);
+   STBIW_FREE(b.band_adler);
+   if (failed) {
+      (void) stbiw__sbfree(zlib);
+      return 0;
+   }
+   stbiw__sbpush(zlib, STBIW_UCHAR(adler >> 24));
+   stbiw__sbpush(zlib, STBIW_UCHAR(adler >> 16));
+   stbiw__sbpush(zlib, STBIW_UCHAR(adler >> 8));
+   stbiw__sbpush(zlib, STBIW_UCHAR(adler));
+
+   i = stbiw__sbn(zlib);
+   // make the buffer freeable
+   STBIW_MEMMOVE(stbiw__sbraw(zlib), zlib, i);
+   return stbiw__png_from_zlib((unsigned char *) stbiw__sbraw(zlib), i, x, y, n, out_len);
+#endif // STBIW_ZLIB_COMPRESS
+}
+
 #ifndef STBI_WRITE_NO_STDIO
 STBIWDEF int stbi_write_png(char const *filename, int x, int y, int comp, const void *data, int stride_bytes)
 {
@@ -1238,6 +1702,33 @@ STBIWDEF int stbi_write_png_to_func(stbi_write_func *func, void *context, int x,
    return 1;
 }
 
+#ifndef STBI_WRITE_NO_STDIO
+STBIWDEF int stbi_write_png_parallel(char const *filename, int x, int y, int comp, const void *data, int stride_bytes, int num_bands, stbi_write_parallel_func *parallel, void *parallel_context)
+{
+   FILE *f;
+   int len;
+   unsigned char *png = stbiw__write_png_to_mem_parallel((const unsigned char *) data, stride_bytes, x, y, comp, &len, num_bands, parallel, parallel_context);
+   if (png == NULL) return 0;
+
+   f = stbiw__fopen(filename, "wb");
+   if (!f) { STBIW_FREE(png); return 0; }
+   fwrite(png, 1, len, f);
+   fclose(f);
+   STBIW_FREE(png);
+   return 1;
+}
+#endif
+
+STBIWDEF int stbi_write_png_to_func_parallel(stbi_write_func *func, void *context, int x, int y, int comp, const void *data, int stride_bytes, int num_bands, stbi_write_parallel_func *parallel, void *parallel_context)
+{
+   int len;
+   unsigned char *png = stbiw__write_png_to_mem_parallel((const unsigned char *) data, stride_bytes, x, y, comp, &len, num_bands, parallel, parallel_context);
+   if (png == NULL) return 0;
+   func(context, png, len);
+   STBIW_FREE(png);
+   return 1;
+}
+
 
 /* ***************************************************************************
  *
@@ -0,0 +1,359 @@
+#include "gpu-culling.h"
+#include "webgpu-utils.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Visible lists are bound with a dynamic offset, which must be a multiple
+// of minStorageBufferOffsetAlignment (256 bytes by default).
+#define REGION_ALIGNMENT_ELEMENTS 64
+#define WORKGROUP_SIZE 64
+
+// Matches the WGSL `Uniforms` struct.
+struct CullingUniforms {
+	float planes[6][4];
+	uint32_t objectCount;
+	uint32_t drawCount;
+	uint32_t _pad[2];
+};
+
+// Matches the WGSL `DrawInfo` struct.
+struct CullingDrawInfo {
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t baseVertex;
+	uint32_t regionBase;
+};
+
+// Size of a DrawIndexedIndirect argument record.
+#define DRAW_ARGS_SIZE (5 * sizeof(uint32_t))
+
+static const char* cullingShaderSource = "\
+struct Uniforms {\n\
+    planes: array<vec4f, 6>,\n\
+    objectCount: u32,\n\
+    drawCount: u32,\n\
+}\n\
+struct Object {\n\
+    center: vec3f,\n\
+    radius: f32,\n\
+    drawIndex: u32,\n\
+}\n\
+struct DrawInfo {\n\
+    indexCount: u32,\n\
+    firstIndex: u32,\n\
+    baseVertex: i32,\n\
+    regionBase: u32,\n\
+}\n\
+struct DrawArgs {\n\
+    indexCount: u32,\n\
+    instanceCount: atomic<u32>,\n\
+    firstIndex: u32,\n\
+    baseVertex: i32,\n\
+    firstInstance: u32,\n\
+}\n\
+\n\
+@group(0) @binding(0) var<uniform> uniforms: Uniforms;\n\
+@group(0) @binding(1) var<storage, read> objects: array<Object>;\n\
+@group(0) @binding(2) var<storage, read> draws: array<DrawInfo>;\n\
+@group(0) @binding(3) var<storage, read_write> args: array<DrawArgs>;\n\
+@group(0) @binding(4) var<storage, read_write> visible: array<u32>;\n\
+@group(0) @binding(5) var<storage, read_write> stats: atomic<u32>;\n\
+\n\
+@compute @workgroup_size(64)\n\
+fn reset(@builtin(global_invocation_id) id: vec3u) {\n\
+    let d = id.x;\n\
+    if (d == 0u) {\n\
+        atomicStore(&stats, 0u);\n\
+    }\n\
+    if (d >= uniforms.drawCount) {\n\
+        return;\n\
+    }\n\
+    args[d].indexCount = draws[d].indexCount;\n\
+    atomicStore(&args[d].instanceCount, 0u);\n\
+    args[d].firstIndex = draws[d].firstIndex;\n\
+    args[d].baseVertex = draws[d].baseVertex;\n\
+    args[d].firstInstance = 0u;\n\
+}\n\
+\n\
+@compute @workgroup_size(64)\n\
+fn cull(@builtin(global_invocation_id) id: vec3u) {\n\
+    let i = id.x;\n\
+    if (i >= uniforms.objectCount) {\n\
+        return;\n\
+    }\n\
+    let object = objects[i];\n\
+    for (var p = 0u; p < 6u; p = p + 1u) {\n\
+        let plane = uniforms.planes[p];\n\
+        if (dot(plane.xyz, object.center) + plane.w < -object.radius) {\n\
+            return;\n\
+        }\n\
+    }\n\
+    let d = object.drawIndex;\n\
+    let slot = atomicAdd(&args[d].instanceCount, 1u);\n\
+    visible[draws[d].regionBase + slot] = i;\n\
+    atomicAdd(&stats, 1u);\n\
+}\n\
+";
+
+/**
+ * Extract the six frustum planes of a column-major view-projection matrix,
+ * normalized so that plane distances are in world units. Clip space depth
+ * is in [0, 1] as in WebGPU.
+ */
+static void extractFrustumPlanes(float const m[16], float planes[6][4]) {
+	for (int i = 0; i < 4; ++i) {
+		float r0 = m[i * 4 + 0];
+		float r1 = m[i * 4 + 1];
+		float r2 = m[i * 4 + 2];
+		float r3 = m[i * 4 + 3];
+		planes[0][i] = r3 + r0; // left
+		planes[1][i] = r3 - r0; // right
+		planes[2][i] = r3 + r1; // bottom
+		planes[3][i] = r3 - r1; // top
+		planes[4][i] = r2;      // near
+		planes[5][i] = r3 - r2; // far
+	}
+	for (int p = 0; p < 6; ++p) {
+		float len = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+		if (len > 0.0f) {
+			for (int i = 0; i < 4; ++i) planes[p][i] /= len;
+		}
+	}
+}
+
+static uint32_t visibleCapacity(struct GpuCulling const * culling) {
+	return culling->maxObjects + culling->drawCount * REGION_ALIGNMENT_ELEMENTS;
+}
+
+static uint64_t visibleBindingSize(struct GpuCulling const * culling) {
+	return alignUp(culling->maxObjects, REGION_ALIGNMENT_ELEMENTS) * sizeof(uint32_t);
+}
+
+struct GpuCulling * gpuCullingCreate(WGPUDevice device, struct GpuCullingDraw const * draws, uint32_t drawCount, uint32_t maxObjects) {
+	if (drawCount == 0 || maxObjects == 0) {
+		fprintf(stderr, "GPU culling needs at least one draw and one object\n");
+		return NULL;
+	}
+
+	struct GpuCulling * culling = (struct GpuCulling *)calloc(1, sizeof(struct GpuCulling));
+	culling->device = device;
+	culling->queue = wgpuDeviceGetQueue(device);
+	culling->maxObjects = maxObjects;
+	culling->drawCount = drawCount;
+	culling->regionBase = (uint32_t *)calloc(drawCount, sizeof(uint32_t));
+
+	culling->uniformBuffer = createBuffer(device, sizeof(struct CullingUniforms), WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst, "Culling uniforms");
+	culling->objectBuffer = createBuffer(device, (uint64_t)maxObjects * sizeof(struct GpuCullingObject), WGPUBufferUsage_Storage | WGPUBufferUsage_CopyDst, "Culling objects");
+	culling->drawInfoBuffer = createBuffer(device, (uint64_t)drawCount * sizeof(struct CullingDrawInfo), WGPUBufferUsage_Storage | WGPUBufferUsage_CopyDst, "Culling draw info");
+	culling->argsBuffer = createBuffer(device, (uint64_t)drawCount * DRAW_ARGS_SIZE, WGPUBufferUsage_Storage | WGPUBufferUsage_Indirect, "Culling indirect args");
+	uint64_t visibleSize = (uint64_t)visibleCapacity(culling) * sizeof(uint32_t) + visibleBindingSize(culling);
+	culling->visibleBuffer = createBuffer(device, visibleSize, WGPUBufferUsage_Storage, "Culling visible objects");
+	culling->statsBuffer = createBuffer(device, sizeof(uint32_t), WGPUBufferUsage_Storage | WGPUBufferUsage_CopySrc, "Culling stats");
+	for (int i = 0; i < GPU_CULLING_STATS_RING_SIZE; ++i) {
+		culling->statsRing[i].buffer = createBuffer(device, sizeof(uint32_t), WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst, "Culling stats readback");
+		culling->statsRing[i].culling = culling;
+	}
+
+	// Draw ranges are static, only their visible list base depends on the
+	// objects and is filled in by gpuCullingSetObjects.
+	struct CullingDrawInfo * drawInfo = (struct CullingDrawInfo *)calloc(drawCount, sizeof(struct CullingDrawInfo));
+	for (uint32_t d = 0; d < drawCount; ++d) {
+		drawInfo[d].indexCount = draws[d].indexCount;
+		drawInfo[d].firstIndex = draws[d].firstIndex;
+		drawInfo[d].baseVertex = draws[d].baseVertex;
+		drawInfo[d].regionBase = 0;
+	}
+	wgpuQueueWriteBuffer(culling->queue, culling->drawInfoBuffer, 0, drawInfo, drawCount * sizeof(struct CullingDrawInfo));
+	free(drawInfo);
+
+	// Compute side
+	WGPUBindGroupLayoutEntry cullEntries[6];
+	cullEntries[0] = bufferLayoutEntry(0, WGPUShaderStage_Compute, WGPUBufferBindingType_Uniform, false);
+	cullEntries[1] = bufferLayoutEntry(1, WGPUShaderStage_Compute, WGPUBufferBindingType_ReadOnlyStorage, false);
+	cullEntries[2] = bufferLayoutEntry(2, WGPUShaderStage_Compute, WGPUBufferBindingType_ReadOnlyStorage, false);
+	cullEntries[3] = bufferLayoutEntry(3, WGPUShaderStage_Compute, WGPUBufferBindingType_Storage, false);
+	cullEntries[4] = bufferLayoutEntry(4, WGPUShaderStage_Compute, WGPUBufferBindingType_Storage, false);
+	cullEntries[5] = bufferLayoutEntry(5, WGPUShaderStage_Compute, WGPUBufferBindingType_Storage, false);
+	WGPUBindGroupLayoutDescriptor cullLayoutDesc = (WGPUBindGroupLayoutDescriptor) {};
+	cullLayoutDesc.label = "Culling bind group layout";
+	cullLayoutDesc.entryCount = 6;
+	cullLayoutDesc.entries = cullEntries;
+	culling->cullLayout = wgpuDeviceCreateBindGroupLayout(device, &cullLayoutDesc);
+
+	WGPUBindGroupEntry cullBindings[6];
+	cullBindings[0] = bufferBindGroupEntry(0, culling->uniformBuffer, 0, sizeof(struct CullingUniforms));
+	cullBindings[1] = bufferBindGroupEntry(1, culling->objectBuffer, 0, (uint64_t)maxObjects * sizeof(struct GpuCullingObject));
+	cullBindings[2] = bufferBindGroupEntry(2, culling->drawInfoBuffer, 0, (uint64_t)drawCount * sizeof(struct CullingDrawInfo));
+	cullBindings[3] = bufferBindGroupEntry(3, culling->argsBuffer, 0, (uint64_t)drawCount * DRAW_ARGS_SIZE);
+	cullBindings[4] = bufferBindGroupEntry(4, culling->visibleBuffer, 0, visibleSize);
+	cullBindings[5] = bufferBindGroupEntry(5, culling->statsBuffer, 0, sizeof(uint32_t));
+	WGPUBindGroupDescriptor cullBindGroupDesc = (WGPUBindGroupDescriptor) {};
+	cullBindGroupDesc.label = "Culling bind group";
+	cullBindGroupDesc.layout = culling->cullLayout;
+	cullBindGroupDesc.entryCount = 6;
+	cullBindGroupDesc.entries = cullBindings;
+	culling->cullBindGroup = wgpuDeviceCreateBindGroup(device, &cullBindGroupDesc);
+
+	WGPUShaderModule shaderModule = createWGSLShaderModule(device, cullingShaderSource, "Culling shader");
+	WGPUPipelineLayout pipelineLayout = createSingleGroupPipelineLayout(device, culling->cullLayout, "Culling pipeline layout");
+	culling->resetPipeline = createComputePipeline(device, pipelineLayout, shaderModule, "reset", "Culling reset pipeline");
+	culling->cullPipeline = createComputePipeline(device, pipelineLayout, shaderModule, "cull", "Culling pipeline");
+	wgpuPipelineLayoutRelease(pipelineLayout);
+	wgpuShaderModuleRelease(shaderModule);
+
+	// Render side
+	WGPUBindGroupLayoutEntry visibleEntry = bufferLayoutEntry(0, WGPUShaderStage_Vertex, WGPUBufferBindingType_ReadOnlyStorage, true);
+	WGPUBindGroupLayoutDescriptor visibleLayoutDesc = (WGPUBindGroupLayoutDescriptor) {};
+	visibleLayoutDesc.label = "Visible objects bind group layout";
+	visibleLayoutDesc.entryCount = 1;
+	visibleLayoutDesc.entries = &visibleEntry;
+	culling->visibleLayout = wgpuDeviceCreateBindGroupLayout(device, &visibleLayoutDesc);
+
+	WGPUBindGroupEntry visibleBinding = bufferBindGroupEntry(0, culling->visibleBuffer, 0, visibleBindingSize(culling));
+	WGPUBindGroupDescriptor visibleBindGroupDesc = (WGPUBindGroupDescriptor) {};
+	visibleBindGroupDesc.label = "Visible objects bind group";
+	visibleBindGroupDesc.layout = culling->visibleLayout;
+	visibleBindGroupDesc.entryCount = 1;
+	visibleBindGroupDesc.entries = &visibleBinding;
+	culling->visibleBindGroup = wgpuDeviceCreateBindGroup(device, &visibleBindGroupDesc);
+
+	return culling;
+}
+
+void gpuCullingSetObjects(struct GpuCulling * culling, struct GpuCullingObject const * objects, uint32_t objectCount) {
+	if (objectCount > culling->maxObjects) {
+		fprintf(stderr, "GPU culling: %u objects exceed the capacity of %u, extra objects are ignored\n", objectCount, culling->maxObjects);
+		objectCount = culling->maxObjects;
+	}
+
+	// Give each draw a visible list large enough for all its objects
+	uint32_t * counts = (uint32_t *)calloc(culling->drawCount, sizeof(uint32_t));
+	for (uint32_t i = 0; i < objectCount; ++i) {
+		assert(objects[i].drawIndex < culling->drawCount);
+		counts[objects[i].drawIndex]++;
+	}
+	uint32_t base = 0;
+	for (uint32_t d = 0; d < culling->drawCount; ++d) {
+		culling->regionBase[d] = base;
+		base += (uint32_t)alignUp(counts[d], REGION_ALIGNMENT_ELEMENTS);
+	}
+	free(counts);
+
+	for (uint32_t d = 0; d < culling->drawCount; ++d) {
+		uint64_t offset = d * sizeof(struct CullingDrawInfo) + offsetof(struct CullingDrawInfo, regionBase);
+		wgpuQueueWriteBuffer(culling->queue, culling->drawInfoBuffer, offset, &culling->regionBase[d], sizeof(uint32_t));
+	}
+	if (objectCount > 0) {
+		wgpuQueueWriteBuffer(culling->queue, culling->objectBuffer, 0, objects, objectCount * sizeof(struct GpuCullingObject));
+	}
+	culling->objectCount = objectCount;
+}
+
+void gpuCullingEncode(struct GpuCulling * culling, WGPUCommandEncoder encoder, float const viewProj[16]) {
+	struct CullingUniforms uniforms;
+	memset(&uniforms, 0, sizeof(uniforms));
+	extractFrustumPlanes(viewProj, uniforms.planes);
+	uniforms.objectCount = culling->objectCount;
+	uniforms.drawCount = culling->drawCount;
+	wgpuQueueWriteBuffer(culling->queue, culling->uniformBuffer, 0, &uniforms, sizeof(uniforms));
+
+	WGPUComputePassDescriptor passDesc = (WGPUComputePassDescriptor) {};
+	passDesc.label = "Culling pass";
+	passDesc.timestampWriteCount = 0;
+	passDesc.timestampWrites = NULL;
+	WGPUComputePassEncoder computePass = wgpuCommandEncoderBeginComputePass(encoder, &passDesc);
+	wgpuComputePassEncoderSetBindGroup(computePass, 0, culling->cullBindGroup, 0, NULL);
+
+	wgpuComputePassEncoderSetPipeline(computePass, culling->resetPipeline);
+	wgpuComputePassEncoderDispatchWorkgroups(computePass, (culling->drawCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+	if (culling->objectCount > 0) {
+		wgpuComputePassEncoderSetPipeline(computePass, culling->cullPipeline);
+		wgpuComputePassEncoderDispatchWorkgroups(computePass, (culling->objectCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+	}
+
+	wgpuComputePassEncoderEnd(computePass);
+	wgpuComputePassEncoderRelease(computePass);
+
+	// Copy the visible count into a free readback slot. If all slots are
+	// still being mapped, this frame's count is simply not reported.
+	struct GpuCullingStatsSlot * slot = &culling->statsRing[culling->statsFrame % GPU_CULLING_STATS_RING_SIZE];
+	if (!slot->inFlight) {
+		wgpuCommandEncoderCopyBufferToBuffer(encoder, culling->statsBuffer, 0, slot->buffer, 0, sizeof(uint32_t));
+		slot->inFlight = true;
+		slot->pendingMap = true;
+		culling->lastObjectCount = culling->objectCount;
+	}
+}
+
+void gpuCullingDraw(struct GpuCulling * culling, WGPURenderPassEncoder renderPass, uint32_t groupIndex) {
+	for (uint32_t d = 0; d < culling->drawCount; ++d) {
+		uint32_t dynamicOffset = culling->regionBase[d] * sizeof(uint32_t);
+		wgpuRenderPassEncoderSetBindGroup(renderPass, groupIndex, culling->visibleBindGroup, 1, &dynamicOffset);
+		wgpuRenderPassEncoderDrawIndexedIndirect(renderPass, culling->argsBuffer, d * DRAW_ARGS_SIZE);
+	}
+}
+
+static void onStatsMapped(WGPUBufferMapAsyncStatus status, void * pUserData) {
+	struct GpuCullingStatsSlot * slot = (struct GpuCullingStatsSlot *)pUserData;
+	if (status == WGPUBufferMapAsyncStatus_Success) {
+		uint32_t const * count = (uint32_t const *)wgpuBufferGetConstMappedRange(slot->buffer, 0, sizeof(uint32_t));
+		if (count) slot->culling->lastVisibleCount = *count;
+		wgpuBufferUnmap(slot->buffer);
+	}
+	slot->inFlight = false;
+}
+
+void gpuCullingAfterSubmit(struct GpuCulling * culling) {
+	struct GpuCullingStatsSlot * slot = &culling->statsRing[culling->statsFrame % GPU_CULLING_STATS_RING_SIZE];
+	if (slot->pendingMap) {
+		slot->pendingMap = false;
+		wgpuBufferMapAsync(slot->buffer, WGPUMapMode_Read, 0, sizeof(uint32_t), onStatsMapped, (void *)slot);
+	}
+	culling->statsFrame++;
+}
+
+void gpuCullingRelease(struct GpuCulling * culling) {
+	if (!culling) return;
+	// Pending maps call back into the ring: cancel them by unmapping, then
+	// tick until their callbacks have run
+	for (int i = 0; i < GPU_CULLING_STATS_RING_SIZE; ++i) {
+		struct GpuCullingStatsSlot * slot = &culling->statsRing[i];
+		if (slot->pendingMap) {
+			slot->pendingMap = false;
+			slot->inFlight = false;
+		} else if (slot->inFlight) {
+			wgpuBufferUnmap(slot->buffer);
+		}
+	}
+	for (int i = 0; i < GPU_CULLING_STATS_RING_SIZE; ++i) {
+		while (culling->statsRing[i].inFlight) {
+#ifdef WEBGPU_BACKEND_DAWN
+			wgpuDeviceTick(culling->device);
+#endif
+		}
+	}
+	wgpuBindGroupRelease(culling->visibleBindGroup);
+	wgpuBindGroupLayoutRelease(culling->visibleLayout);
+	wgpuComputePipelineRelease(culling->cullPipeline);
+	wgpuComputePipelineRelease(culling->resetPipeline);
+	wgpuBindGroupRelease(culling->cullBindGroup);
+	wgpuBindGroupLayoutRelease(culling->cullLayout);
+	for (int i = 0; i < GPU_CULLING_STATS_RING_SIZE; ++i) {
+		wgpuBufferRelease(culling->statsRing[i].buffer);
+	}
+	wgpuBufferRelease(culling->statsBuffer);
+	wgpuBufferRelease(culling->visibleBuffer);
+	wgpuBufferRelease(culling->argsBuffer);
+	wgpuBufferRelease(culling->drawInfoBuffer);
+	wgpuBufferRelease(culling->objectBuffer);
+	wgpuBufferRelease(culling->uniformBuffer);
+	wgpuQueueRelease(culling->queue);
+	free(culling->regionBase);
+	free(culling);
+}
@@ -0,0 +1,126 @@
+/**
+ * GPU-driven frustum culling.
+ *
+ * A compute pass tests the bounding sphere of every object against the view
+ * frustum, compacts the indices of visible objects into one list per draw
+ * and writes the matching DrawIndexedIndirect arguments, so that the render
+ * pass never waits on the CPU to know what to draw.
+ *
+ * Typical frame:
+ *     gpuCullingEncode(culling, encoder, viewProj);   // before the render pass
+ *     gpuCullingDraw(culling, renderPass, 1);         // inside the render pass
+ *     wgpuQueueSubmit(...);
+ *     gpuCullingAfterSubmit(culling);                 // starts stats readback
+ *
+ * The render pipeline must use `culling->visibleLayout` at the group index
+ * given to gpuCullingDraw, and its vertex shader looks up the object drawn
+ * by each instance with:
+ *     @group(1) @binding(0) var<storage, read> visibleObjects: array<u32>;
+ *     let objectIndex = visibleObjects[in_instance_index];
+ */
+
+#ifndef _gpu_culling_h_
+#define _gpu_culling_h_
+
+#include <webgpu/webgpu.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GPU_CULLING_STATS_RING_SIZE 3
+
+/**
+ * A range of the index buffer shared by all objects that reference it.
+ */
+struct GpuCullingDraw {
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t baseVertex;
+};
+
+/**
+ * Bounds of an object, matching the layout of the WGSL `Object` struct.
+ */
+struct GpuCullingObject {
+	float center[3];
+	float radius;
+	uint32_t drawIndex;
+	uint32_t _pad[3];
+};
+
+struct GpuCullingStatsSlot {
+	WGPUBuffer buffer;
+	bool inFlight; // copied to or being mapped
+	bool pendingMap; // copied this frame, mapAsync not issued yet
+	struct GpuCulling * culling;
+};
+
+struct GpuCulling {
+	WGPUDevice device;
+	WGPUQueue queue;
+	uint32_t maxObjects;
+	uint32_t drawCount;
+	uint32_t objectCount;
+
+	WGPUBuffer uniformBuffer;
+	WGPUBuffer objectBuffer;
+	WGPUBuffer drawInfoBuffer;
+	WGPUBuffer argsBuffer;
+	WGPUBuffer visibleBuffer;
+	WGPUBuffer statsBuffer;
+
+	WGPUBindGroupLayout cullLayout;
+	WGPUBindGroup cullBindGroup;
+	WGPUComputePipeline resetPipeline;
+	WGPUComputePipeline cullPipeline;
+
+	// Bind group layout for the render pipeline, with the visible list of
+	// each draw selected through a dynamic offset.
+	WGPUBindGroupLayout visibleLayout;
+	WGPUBindGroup visibleBindGroup;
+	uint32_t * regionBase; // first element of each draw's visible list
+
+	struct GpuCullingStatsSlot statsRing[GPU_CULLING_STATS_RING_SIZE];
+	uint32_t statsFrame;
+
+	// Profiling counters, lagging a few frames behind the GPU
+	uint32_t lastVisibleCount;
+	uint32_t lastObjectCount;
+};
+
+/**
+ * Create the culling buffers and pipelines for at most `maxObjects` objects
+ * spread over the given draws. Returns NULL on failure.
+ */
+struct GpuCulling * gpuCullingCreate(WGPUDevice device, struct GpuCullingDraw const * draws, uint32_t drawCount, uint32_t maxObjects);
+
+/**
+ * Upload the bounds of the objects to cull. Only needed when they change.
+ */
+void gpuCullingSetObjects(struct GpuCulling * culling, struct GpuCullingObject const * objects, uint32_t objectCount);
+
+/**
+ * Record the culling compute pass. `viewProj` is a column-major matrix.
+ */
+void gpuCullingEncode(struct GpuCulling * culling, WGPUCommandEncoder encoder, float const viewProj[16]);
+
+/**
+ * Issue one indirect draw per draw range. The caller sets the pipeline and
+ * the vertex and index buffers beforehand.
+ */
+void gpuCullingDraw(struct GpuCulling * culling, WGPURenderPassEncoder renderPass, uint32_t groupIndex);
+
+/**
+ * Must be called once the command buffer containing gpuCullingEncode has
+ * been submitted, to start reading back the visible instance count.
+ */
+void gpuCullingAfterSubmit(struct GpuCulling * culling);
+
+void gpuCullingRelease(struct GpuCulling * culling);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _gpu_culling_h_
@@ -0,0 +1,503 @@
+#include "gpu-primitives.h"
+#include "webgpu-utils.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PARAMS_SLOT_SIZE 256
+
+// Split in chunks of less than the 4095 characters a C99 string literal
+// is guaranteed to support.
+static const char* primitivesShaderChunks[] = {
+"\
+struct Params {\n\
+    count: u32,\n\
+    blockCount: u32,\n\
+    shift: u32,\n\
+    hasValues: u32,\n\
+    digitMask: u32,\n\
+}\n\
+@group(0) @binding(0) var<uniform> params: Params;\n\
+@group(0) @binding(1) var<storage, read> in0: array<u32>;\n\
+@group(0) @binding(2) var<storage, read> in1: array<u32>;\n\
+@group(0) @binding(3) var<storage, read> in2: array<u32>;\n\
+@group(0) @binding(4) var<storage, read_write> out0: array<u32>;\n\
+@group(0) @binding(5) var<storage, read_write> out1: array<u32>;\n\
+\n\
+const WORKGROUP_SIZE = 256u;\n\
+const ITEMS_PER_THREAD = 4u;\n\
+const BLOCK_SIZE = 1024u;\n\
+const RADIX = 16u;\n\
+\n\
+var<workgroup> scratch: array<u32, 256>;\n\
+var<workgroup> blockTotal: u32;\n\
+// Per-digit counts of the radix sort, 16 bits per digit\n\
+var<workgroup> packedLo: array<vec4u, 256>;\n\
+var<workgroup> packedHi: array<vec4u, 256>;\n\
+var<workgroup> digitCounts: array<atomic<u32>, 16>;\n\
+\n\
+// Blocks may be spread over 2 dimensions when there are more than the\n\
+// maximum number of workgroups per dimension.\n\
+fn blockIndex(wid: vec3u, nwg: vec3u) -> u32 {\n\
+    return wid.x + wid.y * nwg.x;\n\
+}\n\
+\n\
+// Work-efficient (Blelloch) exclusive scan across the workgroup. Also sets\n\
+// blockTotal.\n\
+fn exclusiveScan(lid: u32, value: u32) -> u32 {\n\
+    scratch[lid] = value;\n\
+    var offset = 1u;\n\
+    for (var d = WORKGROUP_SIZE >> 1u; d > 0u; d = d >> 1u) {\n\
+        workgroupBarrier();\n\
+        if (lid < d) {\n\
+            let ai = offset * (2u * lid + 1u) - 1u;\n\
+            let bi = offset * (2u * lid + 2u) - 1u;\n\
+            scratch[bi] += scratch[ai];\n\
+        }\n\
+        offset = offset * 2u;\n\
+    }\n\
+    workgroupBarrier();\n\
+    if (lid == 0u) {\n\
+        blockTotal = scratch[WORKGROUP_SIZE - 1u];\n\
+        scratch[WORKGROUP_SIZE - 1u] = 0u;\n\
+    }\n\
+    for (var d = 1u; d < WORKGROUP_SIZE; d = d * 2u) {\n\
+        offset = offset >> 1u;\n\
+        workgroupBarrier();\n\
+        if (lid < d) {\n\
+            let ai = offset * (2u * lid + 1u) - 1u;\n\
+            let bi = offset * (2u * lid + 2u) - 1u;\n\
+            let t = scratch[ai];\n\
+            scratch[ai] = scratch[bi];\n\
+            scratch[bi] += t;\n\
+        }\n\
+    }\n\
+    workgroupBarrier();\n\
+    return scratch[lid];\n\
+}\n\
+\n\
+",
+"\
+// Same as exclusiveScan on the 16 packed digit counters of each invocation,\n\
+// leaving the result in packedLo/packedHi.\n\
+fn exclusiveScanPacked(lid: u32, lo: vec4u, hi: vec4u) {\n\
+    packedLo[lid] = lo;\n\
+    packedHi[lid] = hi;\n\
+    var offset = 1u;\n\
+    for (var d = WORKGROUP_SIZE >> 1u; d > 0u; d = d >> 1u) {\n\
+        workgroupBarrier();\n\
+        if (lid < d) {\n\
+            let ai = offset * (2u * lid + 1u) - 1u;\n\
+            let bi = offset * (2u * lid + 2u) - 1u;\n\
+            packedLo[bi] += packedLo[ai];\n\
+            packedHi[bi] += packedHi[ai];\n\
+        }\n\
+        offset = offset * 2u;\n\
+    }\n\
+    workgroupBarrier();\n\
+    if (lid == 0u) {\n\
+        packedLo[WORKGROUP_SIZE - 1u] = vec4u(0u);\n\
+        packedHi[WORKGROUP_SIZE - 1u] = vec4u(0u);\n\
+    }\n\
+    for (var d = 1u; d < WORKGROUP_SIZE; d = d * 2u) {\n\
+        offset = offset >> 1u;\n\
+        workgroupBarrier();\n\
+        if (lid < d) {\n\
+            let ai = offset * (2u * lid + 1u) - 1u;\n\
+            let bi = offset * (2u * lid + 2u) - 1u;\n\
+            let tLo = packedLo[ai];\n\
+            let tHi = packedHi[ai];\n\
+            packedLo[ai] = packedLo[bi];\n\
+            packedHi[ai] = packedHi[bi];\n\
+            packedLo[bi] += tLo;\n\
+            packedHi[bi] += tHi;\n\
+        }\n\
+    }\n\
+    workgroupBarrier();\n\
+}\n\
+\n\
+// in0: input, out0: scanned input, out1: block totals\n\
+@compute @workgroup_size(256)\n\
+fn scanBlocks(@builtin(workgroup_id) wid: vec3u, @builtin(num_workgroups) nwg: vec3u, @builtin(local_invocation_index) lid: u32) {\n\
+    let block = blockIndex(wid, nwg);\n\
+    let base = block * BLOCK_SIZE + lid * ITEMS_PER_THREAD;\n\
+    var items: array<u32, 4>;\n\
+    var sum = 0u;\n\
+    for (var k = 0u; k < ITEMS_PER_THREAD; k++) {\n\
+        items[k] = sum;\n\
+        if (base + k < params.count) { sum += in0[base + k]; }\n\
+    }\n\
+    let prefix = exclusiveScan(lid, sum);\n\
+    for (var k = 0u; k < ITEMS_PER_THREAD; k++) {\n\
+        if (base + k < params.count) { out0[base + k] = prefix + items[k]; }\n\
+    }\n\
+    if (lid == 0u && block < params.blockCount) { out1[block] = blockTotal; }\n\
+}\n\
+\n\
+// in0: scanned block totals, out0: scanned input\n\
+@compute @workgroup_size(256)\n\
+fn addBlockSums(@builtin(workgroup_id) wid: vec3u, @builtin(num_workgroups) nwg: vec3u, @builtin(local_invocation_index) lid: u32) {\n\
+    let block = blockIndex(wid, nwg);\n\
+    if (block >= params.blockCount) { return; }\n\
+    let add = in0[block];\n\
+    let base = block * BLOCK_SIZE + lid * ITEMS_PER_THREAD;\n\
+    for (var k = 0u; k < ITEMS_PER_THREAD; k++) {\n\
+        if (base + k < params.count) { out0[base + k] += add; }\n\
+    }\n\
+}\n\
+\n\
+// in0: input, out0: block totals\n\
+@compute @workgroup_size(256)\n\
+fn reduceBlocks(@builtin(workgroup_id) wid: vec3u, @builtin(num_workgroups) nwg: vec3u, @builtin(local_invocation_index) lid: u32) {\n\
+    let block = blockIndex(wid, nwg);\n\
+    let base = block * BLOCK_SIZE + lid * ITEMS_PER_THREAD;\n\
+    var sum = 0u;\n\
+    for (var k = 0u; k < ITEMS_PER_THREAD; k++) {\n\
+        if (base + k < params.count) { sum += in0[base + k]; }\n\
+    }\n\
+    exclusiveScan(lid, sum);\n\
+    if (lid == 0u && block < params.blockCount) { out0[block] = blockTotal; }\n\
+}\n\
+\n\
+",
+"\
+// in0: values, in1: flags, in2: scanned flags, out0: output, out1: count\n\
+@compute @workgroup_size(256)\n\
+fn compactScatter(@builtin(global_invocation_id) gid: vec3u, @builtin(num_workgroups) nwg: vec3u) {\n\
+    let i = gid.x + gid.y * nwg.x * WORKGROUP_SIZE;\n\
+    if (i >= params.count) { return; }\n\
+    let position = in2[i];\n\
+    let flag = in1[i];\n\
+    if (flag != 0u) { out0[position] = in0[i]; }\n\
+    if (i == params.count - 1u) { out1[0] = position + flag; }\n\
+}\n\
+\n\
+// in0: keys, out0: histogram, digit-major\n\
+@compute @workgroup_size(256)\n\
+fn radixHistogram(@builtin(workgroup_id) wid: vec3u, @builtin(num_workgroups) nwg: vec3u, @builtin(local_invocation_index) lid: u32) {\n\
+    let block = blockIndex(wid, nwg);\n\
+    if (lid < RADIX) { atomicStore(&digitCounts[lid], 0u); }\n\
+    workgroupBarrier();\n\
+    let i = block * WORKGROUP_SIZE + lid;\n\
+    if (i < params.count) {\n\
+        atomicAdd(&digitCounts[(in0[i] >> params.shift) & params.digitMask], 1u);\n\
+    }\n\
+    workgroupBarrier();\n\
+    if (lid < RADIX && block < params.blockCount) {\n\
+        out0[lid * params.blockCount + block] = atomicLoad(&digitCounts[lid]);\n\
+    }\n\
+}\n\
+\n\
+// in0: keys, in1: values, in2: scanned histogram, out0: sorted keys,\n\
+// out1: sorted values\n\
+@compute @workgroup_size(256)\n\
+fn radixScatter(@builtin(workgroup_id) wid: vec3u, @builtin(num_workgroups) nwg: vec3u, @builtin(local_invocation_index) lid: u32) {\n\
+    let block = blockIndex(wid, nwg);\n\
+    let i = block * WORKGROUP_SIZE + lid;\n\
+    let active = i < params.count;\n\
+    var key = 0u;\n\
+    var digit = 0u;\n\
+    var lo = vec4u(0u);\n\
+    var hi = vec4u(0u);\n\
+    if (active) {\n\
+        key = in0[i];\n\
+        digit = (key >> params.shift) & params.digitMask;\n\
+        let word = digit / 2u;\n\
+        let bit = 1u << (16u * (digit % 2u));\n\
+        if (word < 4u) { lo[word] = bit; } else { hi[word - 4u] = bit; }\n\
+    }\n\
+    exclusiveScanPacked(lid, lo, hi);\n\
+    if (!active) { return; }\n\
+    let word = digit / 2u;\n\
+    var counters = 0u;\n\
+    if (word < 4u) { counters = packedLo[lid][word]; } else { counters = packedHi[lid][word - 4u]; }\n\
+    let rank = (counters >> (16u * (digit % 2u))) & 0xffffu;\n\
+    let destination = in2[digit * params.blockCount + block] + rank;\n\
+    out0[destination] = key;\n\
+    if (params.hasValues != 0u) { out1[destination] = in1[i]; }\n\
+}\n\
+",
+};
+
+static uint32_t ceilDiv(uint32_t a, uint32_t b) {
+	return (a + b - 1) / b;
+}
+
+struct GpuPrimitives * gpuPrimitivesCreate(WGPUDevice device) {
+	struct GpuPrimitives * primitives = (struct GpuPrimitives *)calloc(1, sizeof(struct GpuPrimitives));
+	primitives->device = device;
+	primitives->queue = wgpuDeviceGetQueue(device);
+
+	WGPUSupportedLimits supportedLimits = (WGPUSupportedLimits) {};
+	supportedLimits.nextInChain = NULL;
+	wgpuDeviceGetLimits(device, &supportedLimits);
+	primitives->maxWorkgroupsPerDimension = supportedLimits.limits.maxComputeWorkgroupsPerDimension;
+	if (primitives->maxWorkgroupsPerDimension == 0) primitives->maxWorkgroupsPerDimension = 65535;
+
+	WGPUBindGroupLayoutEntry entries[6];
+	entries[0] = bufferLayoutEntry(0, WGPUShaderStage_Compute, WGPUBufferBindingType_Uniform, true);
+	entries[1] = bufferLayoutEntry(1, WGPUShaderStage_Compute, WGPUBufferBindingType_ReadOnlyStorage, false);
+	entries[2] = bufferLayoutEntry(2, WGPUShaderStage_Compute, WGPUBufferBindingType_ReadOnlyStorage, false);
+	entries[3] = bufferLayoutEntry(3, WGPUShaderStage_Compute, WGPUBufferBindingType_ReadOnlyStorage, false);
+	entries[4] = bufferLayoutEntry(4, WGPUShaderStage_Compute, WGPUBufferBindingType_Storage, false);
+	entries[5] = bufferLayoutEntry(5, WGPUShaderStage_Compute, WGPUBufferBindingType_Storage, false);
+	WGPUBindGroupLayoutDescriptor layoutDesc = (WGPUBindGroupLayoutDescriptor) {};
+	layoutDesc.nextInChain = NULL;
+	layoutDesc.label = "GPU primitives";
+	layoutDesc.entryCount = 6;
+	layoutDesc.entries = entries;
+	primitives->layout = wgpuDeviceCreateBindGroupLayout(device, &layoutDesc);
+
+	size_t chunkCount = sizeof(primitivesShaderChunks) / sizeof(primitivesShaderChunks[0]);
+	size_t sourceSize = 1;
+	for (size_t i = 0; i < chunkCount; ++i) sourceSize += strlen(primitivesShaderChunks[i]);
+	char * source = (char *)malloc(sourceSize);
+	source[0] = '\0';
+	for (size_t i = 0; i < chunkCount; ++i) strcat(source, primitivesShaderChunks[i]);
+	WGPUShaderModule module = createWGSLShaderModule(device, source, "GPU primitives");
+	free(source);
+	WGPUPipelineLayout pipelineLayout = createSingleGroupPipelineLayout(device, primitives->layout, "GPU primitives");
+	primitives->scanBlocksPipeline = createComputePipeline(device, pipelineLayout, module, "scanBlocks", "Scan blocks");
+	primitives->addBlockSumsPipeline = createComputePipeline(device, pipelineLayout, module, "addBlockSums", "Add block sums");
+	primitives->reduceBlocksPipeline = createComputePipeline(device, pipelineLayout, module, "reduceBlocks", "Reduce blocks");
+	primitives->compactScatterPipeline = createComputePipeline(device, pipelineLayout, module, "compactScatter", "Compact scatter");
+	primitives->radixHistogramPipeline = createComputePipeline(device, pipelineLayout, module, "radixHistogram", "Radix histogram");
+	primitives->radixScatterPipeline = createComputePipeline(device, pipelineLayout, module, "radixScatter", "Radix scatter");
+	wgpuPipelineLayoutRelease(pipelineLayout);
+	wgpuShaderModuleRelease(module);
+
+	WGPUBufferUsageFlags storage = WGPUBufferUsage_Storage;
+	primitives->dummyInput = createBuffer(device, 4, storage, "GPU primitives dummy input");
+	primitives->dummyOutputs[0] = createBuffer(device, 4, storage, "GPU primitives dummy output 0");
+	primitives->dummyOutputs[1] = createBuffer(device, 4, storage, "GPU primitives dummy output 1");
+	return primitives;
+}
+
+void gpuPrimitivesRelease(struct GpuPrimitives * primitives) {
+	if (!primitives) return;
+	wgpuBufferRelease(primitives->dummyOutputs[1]);
+	wgpuBufferRelease(primitives->dummyOutputs[0]);
+	wgpuBufferRelease(primitives->dummyInput);
+	wgpuComputePipelineRelease(primitives->radixScatterPipeline);
+	wgpuComputePipelineRelease(primitives->radixHistogramPipeline);
+	wgpuComputePipelineRelease(primitives->compactScatterPipeline);
+	wgpuComputePipelineRelease(primitives->reduceBlocksPipeline);
+	wgpuComputePipelineRelease(primitives->addBlockSumsPipeline);
+	wgpuComputePipelineRelease(primitives->scanBlocksPipeline);
+	wgpuBindGroupLayoutRelease(primitives->layout);
+	wgpuQueueRelease(primitives->queue);
+	free(primitives);
+}
+
+static WGPUBuffer createScratch(struct GpuPrimitives * primitives, uint64_t elementCount, char const * label) {
+	WGPUBufferUsageFlags usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopySrc | WGPUBufferUsage_CopyDst;
+	return createBuffer(primitives->device, (elementCount > 0 ? elementCount : 1) * sizeof(uint32_t), usage, label);
+}
+
+struct GpuPrimitivesContext * gpuPrimitivesContextCreate(struct GpuPrimitives * primitives, uint32_t maxCount) {
+	struct GpuPrimitivesContext * context = (struct GpuPrimitivesContext *)calloc(1, sizeof(struct GpuPrimitivesContext));
+	context->primitives = primitives;
+	context->maxCount = maxCount;
+
+	context->paramsBuffer = createBuffer(primitives->device, GPU_PRIMITIVES_MAX_DISPATCHES * PARAMS_SLOT_SIZE, WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst, "GPU primitives params");
+	context->params = (uint8_t *)calloc(GPU_PRIMITIVES_MAX_DISPATCHES, PARAMS_SLOT_SIZE);
+
+	// The largest array scanned is either the input or the sort histogram
+	uint32_t histogramSize = (1 << GPU_PRIMITIVES_RADIX_BITS) * ceilDiv(maxCount, GPU_PRIMITIVES_SORT_BLOCK_SIZE);
+	uint32_t n = maxCount > histogramSize ? maxCount : histogramSize;
+	for (int level = 0; level < GPU_PRIMITIVES_MAX_LEVELS; ++level) {
+		uint32_t blocks = ceilDiv(n, GPU_PRIMITIVES_SCAN_BLOCK_SIZE);
+		context->blockSums[level] = createScratch(primitives, blocks, "Block sums");
+		context->scannedBlockSums[level] = createScratch(primitives, blocks, "Scanned block sums");
+		if (blocks <= 1) break;
+		n = blocks;
+	}
+	return context;
+}
+
+void gpuPrimitivesContextRelease(struct GpuPrimitivesContext * context) {
+	if (!context) return;
+	WGPUBuffer buffers[] = {
+		context->positions, context->compactCount,
+		context->sortKeys, context->sortValues, context->histogram, context->scannedHistogram,
+	};
+	for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); ++i) {
+		if (buffers[i]) wgpuBufferRelease(buffers[i]);
+	}
+	for (int level = 0; level < GPU_PRIMITIVES_MAX_LEVELS; ++level) {
+		if (context->blockSums[level]) wgpuBufferRelease(context->blockSums[level]);
+		if (context->scannedBlockSums[level]) wgpuBufferRelease(context->scannedBlockSums[level]);
+	}
+	wgpuBufferRelease(context->paramsBuffer);
+	free(context->params);
+	free(context);
+}
+
+// Dispatch helpers
+
+struct DispatchBuffers {
+	WGPUBuffer in0;
+	WGPUBuffer in1;
+	WGPUBuffer in2;
+	WGPUBuffer out0;
+	WGPUBuffer out1;
+};
+
+static void dispatch(struct GpuPrimitivesContext * context, WGPUComputePassEncoder pass, WGPUComputePipeline pipeline, struct DispatchBuffers buffers, uint32_t count, uint32_t blockCount, uint32_t shift, uint32_t digitMask, uint32_t workgroupCount) {
+	struct GpuPrimitives * primitives = context->primitives;
+	assert(context->paramsCount < GPU_PRIMITIVES_MAX_DISPATCHES);
+	uint32_t paramsOffset = context->paramsCount++ * PARAMS_SLOT_SIZE;
+	uint32_t * params = (uint32_t *)(context->params + paramsOffset);
+	params[0] = count;
+	params[1] = blockCount;
+	params[2] = shift;
+	params[3] = buffers.in1 != NULL;
+	params[4] = digitMask;
+
+	WGPUBindGroupEntry bindings[6];
+	bindings[0] = bufferBindGroupEntry(0, context->paramsBuffer, 0, 5 * sizeof(uint32_t));
+	bindings[1] = bufferBindGroupEntry(1, buffers.in0 ? buffers.in0 : primitives->dummyInput, 0, WGPU_WHOLE_SIZE);
+	bindings[2] = bufferBindGroupEntry(2, buffers.in1 ? buffers.in1 : primitives->dummyInput, 0, WGPU_WHOLE_SIZE);
+	bindings[3] = bufferBindGroupEntry(3, buffers.in2 ? buffers.in2 : primitives->dummyInput, 0, WGPU_WHOLE_SIZE);
+	bindings[4] = bufferBindGroupEntry(4, buffers.out0 ? buffers.out0 : primitives->dummyOutputs[0], 0, WGPU_WHOLE_SIZE);
+	bindings[5] = bufferBindGroupEntry(5, buffers.out1 ? buffers.out1 : primitives->dummyOutputs[1], 0, WGPU_WHOLE_SIZE);
+	WGPUBindGroupDescriptor bindGroupDesc = (WGPUBindGroupDescriptor) {};
+	bindGroupDesc.nextInChain = NULL;
+	bindGroupDesc.layout = primitives->layout;
+	bindGroupDesc.entryCount = 6;
+	bindGroupDesc.entries = bindings;
+	WGPUBindGroup bindGroup = wgpuDeviceCreateBindGroup(primitives->device, &bindGroupDesc);
+
+	uint32_t x = workgroupCount < primitives->maxWorkgroupsPerDimension ? workgroupCount : primitives->maxWorkgroupsPerDimension;
+	uint32_t y = ceilDiv(workgroupCount, x);
+	wgpuComputePassEncoderSetPipeline(pass, pipeline);
+	wgpuComputePassEncoderSetBindGroup(pass, 0, bindGroup, 1, &paramsOffset);
+	wgpuComputePassEncoderDispatchWorkgroups(pass, x, y, 1);
+	wgpuBindGroupRelease(bindGroup);
+}
+
+static WGPUComputePassEncoder beginPass(struct GpuPrimitivesContext * context, WGPUCommandEncoder encoder, char const * label) {
+	context->paramsCount = 0;
+	WGPUComputePassDescriptor passDesc = (WGPUComputePassDescriptor) {};
+	passDesc.nextInChain = NULL;
+	passDesc.label = label;
+	passDesc.timestampWriteCount = 0;
+	passDesc.timestampWrites = NULL;
+	return wgpuCommandEncoderBeginComputePass(encoder, &passDesc);
+}
+
+static void endPass(struct GpuPrimitivesContext * context, WGPUComputePassEncoder pass) {
+	wgpuComputePassEncoderEnd(pass);
+	wgpuComputePassEncoderRelease(pass);
+	// Lands before the submit containing the pass
+	wgpuQueueWriteBuffer(context->primitives->queue, context->paramsBuffer, 0, context->params, context->paramsCount * PARAMS_SLOT_SIZE);
+}
+
+static void encodeScanLevel(struct GpuPrimitivesContext * context, WGPUComputePassEncoder pass, WGPUBuffer input, WGPUBuffer output, uint32_t count, int level) {
+	struct GpuPrimitives * primitives = context->primitives;
+	assert(level < GPU_PRIMITIVES_MAX_LEVELS && context->blockSums[level]);
+	uint32_t blocks = ceilDiv(count, GPU_PRIMITIVES_SCAN_BLOCK_SIZE);
+	struct DispatchBuffers scanBuffers = { input, NULL, NULL, output, context->blockSums[level] };
+	dispatch(context, pass, primitives->scanBlocksPipeline, scanBuffers, count, blocks, 0, 0, blocks);
+	if (blocks > 1) {
+		encodeScanLevel(context, pass, context->blockSums[level], context->scannedBlockSums[level], blocks, level + 1);
+		struct DispatchBuffers addBuffers = { context->scannedBlockSums[level], NULL, NULL, output, NULL };
+		dispatch(context, pass, primitives->addBlockSumsPipeline, addBuffers, count, blocks, 0, 0, blocks);
+	}
+}
+
+// Operations
+
+void gpuPrimitivesEncodeScan(struct GpuPrimitivesContext * context, WGPUCommandEncoder encoder, WGPUBuffer input, WGPUBuffer output, uint32_t count) {
+	assert(count <= context->maxCount);
+	if (count == 0) return;
+	WGPUComputePassEncoder pass = beginPass(context, encoder, "Scan");
+	encodeScanLevel(context, pass, input, output, count, 0);
+	endPass(context, pass);
+}
+
+void gpuPrimitivesEncodeReduce(struct GpuPrimitivesContext * context, WGPUCommandEncoder encoder, WGPUBuffer input, uint32_t count, WGPUBuffer result, uint64_t resultOffset) {
+	assert(count <= context->maxCount);
+	WGPUComputePassEncoder pass = beginPass(context, encoder, "Reduce");
+	WGPUBuffer source = input;
+	int level = 0;
+	do {
+		// An empty input still writes a zero total
+		uint32_t blocks = count > 0 ? ceilDiv(count, GPU_PRIMITIVES_SCAN_BLOCK_SIZE) : 1;
+		struct DispatchBuffers buffers = { source, NULL, NULL, context->blockSums[level], NULL };
+		dispatch(context, pass, context->primitives->reduceBlocksPipeline, buffers, count, blocks, 0, 0, blocks);
+		source = context->blockSums[level];
+		count = blocks;
+		++level;
+	} while (count > 1);
+	endPass(context, pass);
+	wgpuCommandEncoderCopyBufferToBuffer(encoder, source, 0, result, resultOffset, sizeof(uint32_t));
+}
+
+void gpuPrimitivesEncodeCompact(struct GpuPrimitivesContext * context, WGPUCommandEncoder encoder, WGPUBuffer values, WGPUBuffer flags, uint32_t count, WGPUBuffer output, WGPUBuffer countBuffer, uint64_t countOffset) {
+	assert(count <= context->maxCount);
+	struct GpuPrimitives * primitives = context->primitives;
+	if (!context->positions) {
+		context->positions = createScratch(primitives, context->maxCount, "Compaction positions");
+		context->compactCount = createScratch(primitives, 1, "Compaction count");
+	}
+	wgpuCommandEncoderClearBuffer(encoder, context->compactCount, 0, sizeof(uint32_t));
+	if (count > 0) {
+		WGPUComputePassEncoder pass = beginPass(context, encoder, "Compact");
+		encodeScanLevel(context, pass, flags, context->positions, count, 0);
+		struct DispatchBuffers buffers = { values, flags, context->positions, output, context->compactCount };
+		dispatch(context, pass, primitives->compactScatterPipeline, buffers, count, 0, 0, 0, ceilDiv(count, 256));
+		endPass(context, pass);
+	}
+	wgpuCommandEncoderCopyBufferToBuffer(encoder, context->compactCount, 0, countBuffer, countOffset, sizeof(uint32_t));
+}
+
+void gpuPrimitivesEncodeSort(struct GpuPrimitivesContext * context, WGPUCommandEncoder encoder, WGPUBuffer keys, WGPUBuffer values, uint32_t count, uint32_t keyBits) {
+	assert(count <= context->maxCount);
+	struct GpuPrimitives * primitives = context->primitives;
+	if (count <= 1 || keyBits == 0) return;
+	if (keyBits > 32) keyBits = 32;
+	uint32_t blocks = ceilDiv(count, GPU_PRIMITIVES_SORT_BLOCK_SIZE);
+	uint32_t histogramSize = (1 << GPU_PRIMITIVES_RADIX_BITS) * blocks;
+	if (!context->sortKeys) {
+		uint32_t maxBlocks = ceilDiv(context->maxCount, GPU_PRIMITIVES_SORT_BLOCK_SIZE);
+		context->sortKeys = createScratch(primitives, context->maxCount, "Sort keys");
+		context->histogram = createScratch(primitives, (1 << GPU_PRIMITIVES_RADIX_BITS) * maxBlocks, "Sort histogram");
+		context->scannedHistogram = createScratch(primitives, (1 << GPU_PRIMITIVES_RADIX_BITS) * maxBlocks, "Sort scanned histogram");
+	}
+	if (values && !context->sortValues) {
+		context->sortValues = createScratch(primitives, context->maxCount, "Sort values");
+	}
+
+	WGPUBuffer srcKeys = keys;
+	WGPUBuffer dstKeys = context->sortKeys;
+	WGPUBuffer srcValues = values;
+	WGPUBuffer dstValues = values ? context->sortValues : NULL;
+	uint32_t passCount = ceilDiv(keyBits, GPU_PRIMITIVES_RADIX_BITS);
+	WGPUComputePassEncoder pass = beginPass(context, encoder, "Radix sort");
+	for (uint32_t p = 0; p < passCount; ++p) {
+		uint32_t shift = p * GPU_PRIMITIVES_RADIX_BITS;
+		// The last digit may be narrower, so that higher bits do not count
+		uint32_t digitBits = keyBits - shift < GPU_PRIMITIVES_RADIX_BITS ? keyBits - shift : GPU_PRIMITIVES_RADIX_BITS;
+		uint32_t digitMask = (1u << digitBits) - 1;
+		struct DispatchBuffers histogramBuffers = { srcKeys, NULL, NULL, context->histogram, NULL };
+		dispatch(context, pass, primitives->radixHistogramPipeline, histogramBuffers, count, blocks, shift, digitMask, blocks);
+		encodeScanLevel(context, pass, context->histogram, context->scannedHistogram, histogramSize, 0);
+		struct DispatchBuffers scatterBuffers = { srcKeys, srcValues, context->scannedHistogram, dstKeys, dstValues };
+		dispatch(context, pass, primitives->radixScatterPipeline, scatterBuffers, count, blocks, shift, digitMask, blocks);
+
+		WGPUBuffer tmp = srcKeys; srcKeys = dstKeys; dstKeys = tmp;
+		tmp = srcValues; srcValues = dstValues; dstValues = tmp;
+	}
+	endPass(context, pass);
+
+	if (passCount % 2 == 1) {
+		// The result ended up in the scratch buffers
+		wgpuCommandEncoderCopyBufferToBuffer(encoder, context->sortKeys, 0, keys, 0, count * sizeof(uint32_t));
+		if (values) {
+			wgpuCommandEncoderCopyBufferToBuffer(encoder, context->sortValues, 0, values, 0, count * sizeof(uint32_t));
+		}
+	}
+}
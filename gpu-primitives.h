@@ -0,0 +1,121 @@
+/**
+ * GPU-wide parallel primitives on arrays of u32: exclusive prefix sum,
+ * sum reduction, stream compaction and key/value radix sort.
+ *
+ * All primitives are built on the same work-efficient block scan: a
+ * workgroup of 256 invocations scans 1024 elements (4 per invocation
+ * serially, then a Blelloch up-sweep/down-sweep in workgroup memory) and
+ * writes the total of its block. Block totals are scanned recursively and
+ * added back, so a scan of n elements does O(n) work in
+ * O(log n / log 1024) levels of dispatches.
+ *
+ * The radix sort is a least-significant-digit sort on 4-bit digits: for
+ * each digit, a histogram of every 256-element block is laid out
+ * digit-major so that its exclusive scan gives the output offset of each
+ * (digit, block), and a stable scatter ranks elements within their block.
+ *
+ * Operations record into a caller-provided encoder. Their parameters live
+ * in a context, written with queue writes: encode a given context at most
+ * once per submit, and use one context per operation that must be in the
+ * same submit. Input and output buffers must be distinct and need the
+ * Storage usage; results copied out (reduction, compaction count) need
+ * CopyDst on their destination.
+ */
+
+#ifndef _gpu_primitives_h_
+#define _gpu_primitives_h_
+
+#include <webgpu/webgpu.h>
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GPU_PRIMITIVES_SCAN_BLOCK_SIZE 1024
+#define GPU_PRIMITIVES_SORT_BLOCK_SIZE 256
+#define GPU_PRIMITIVES_RADIX_BITS 4
+// Enough levels for 2^32 elements
+#define GPU_PRIMITIVES_MAX_LEVELS 4
+#define GPU_PRIMITIVES_MAX_DISPATCHES 256
+
+/**
+ * Pipelines, shared by all contexts of a device.
+ */
+struct GpuPrimitives {
+	WGPUDevice device;
+	WGPUQueue queue;
+	WGPUBindGroupLayout layout;
+	WGPUComputePipeline scanBlocksPipeline;
+	WGPUComputePipeline addBlockSumsPipeline;
+	WGPUComputePipeline reduceBlocksPipeline;
+	WGPUComputePipeline compactScatterPipeline;
+	WGPUComputePipeline radixHistogramPipeline;
+	WGPUComputePipeline radixScatterPipeline;
+	// Bound to the slots an entry point does not use
+	WGPUBuffer dummyInput;
+	WGPUBuffer dummyOutputs[2];
+	uint32_t maxWorkgroupsPerDimension;
+};
+
+/**
+ * Scratch memory and parameters of operations on up to `maxCount`
+ * elements. Sort and compaction buffers are created on first use.
+ */
+struct GpuPrimitivesContext {
+	struct GpuPrimitives * primitives;
+	uint32_t maxCount;
+
+	WGPUBuffer paramsBuffer;
+	uint8_t * params; // CPU copy, written at the end of each operation
+	uint32_t paramsCount;
+
+	// Per level of the scan hierarchy: block totals and their scan
+	WGPUBuffer blockSums[GPU_PRIMITIVES_MAX_LEVELS];
+	WGPUBuffer scannedBlockSums[GPU_PRIMITIVES_MAX_LEVELS];
+
+	WGPUBuffer positions; // scanned compaction flags
+	WGPUBuffer compactCount;
+
+	WGPUBuffer sortKeys;
+	WGPUBuffer sortValues;
+	WGPUBuffer histogram;
+	WGPUBuffer scannedHistogram;
+};
+
+struct GpuPrimitives * gpuPrimitivesCreate(WGPUDevice device);
+void gpuPrimitivesRelease(struct GpuPrimitives * primitives);
+
+struct GpuPrimitivesContext * gpuPrimitivesContextCreate(struct GpuPrimitives * primitives, uint32_t maxCount);
+void gpuPrimitivesContextRelease(struct GpuPrimitivesContext * context);
+
+/**
+ * output[i] = input[0] + ... + input[i - 1]
+ */
+void gpuPrimitivesEncodeScan(struct GpuPrimitivesContext * context, WGPUCommandEncoder encoder, WGPUBuffer input, WGPUBuffer output, uint32_t count);
+
+/**
+ * Write the sum of `input` (modulo 2^32) as a u32 at `resultOffset` in
+ * `result`.
+ */
+void gpuPrimitivesEncodeReduce(struct GpuPrimitivesContext * context, WGPUCommandEncoder encoder, WGPUBuffer input, uint32_t count, WGPUBuffer result, uint64_t resultOffset);
+
+/**
+ * Copy, in order, the values whose flag is 1 (flags are 0 or 1) to the
+ * beginning of `output`, and write how many there are as a u32 at
+ * `countOffset` in `countBuffer`.
+ */
+void gpuPrimitivesEncodeCompact(struct GpuPrimitivesContext * context, WGPUCommandEncoder encoder, WGPUBuffer values, WGPUBuffer flags, uint32_t count, WGPUBuffer output, WGPUBuffer countBuffer, uint64_t countOffset);
+
+/**
+ * Stable sort of `keys` in place, considering their `keyBits` lowest bits,
+ * permuting `values` (may be NULL) alike. Both need CopySrc and CopyDst.
+ */
+void gpuPrimitivesEncodeSort(struct GpuPrimitivesContext * context, WGPUCommandEncoder encoder, WGPUBuffer keys, WGPUBuffer values, uint32_t count, uint32_t keyBits);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _gpu_primitives_h_
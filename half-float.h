@@ -0,0 +1,82 @@
+/**
+ * Conversions between 32-bit floats and IEEE 754 half precision floats
+ * (binary16), as stored in buffers read by WGSL as f16 or through
+ * unpack2x16float.
+ *
+ * Rounding is to nearest, ties to even, as GPUs convert f32 to f16, and
+ * subnormal halves are kept. This differs from the float16_t.hpp header
+ * of the tutorial, which rounds ties away from zero. Values too large for
+ * a half become infinities and NaNs stay NaNs.
+ */
+
+#ifndef _half_float_h_
+#define _half_float_h_
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline uint16_t floatToHalf(float value) {
+	uint32_t f;
+	memcpy(&f, &value, sizeof(f));
+	uint32_t sign = (f >> 16) & 0x8000;
+	uint32_t exponent = (f >> 23) & 0xff;
+	uint32_t mantissa = f & 0x7fffff;
+	if (exponent == 0xff) {
+		return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+	}
+	int32_t halfExponent = (int32_t)exponent - 127 + 15;
+	if (halfExponent >= 31) {
+		return (uint16_t)(sign | 0x7c00);
+	}
+	if (halfExponent <= 0) {
+		// Subnormal half, or zero
+		if (halfExponent < -10) return (uint16_t)sign;
+		mantissa |= 0x800000;
+		uint32_t shift = (uint32_t)(14 - halfExponent);
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (half & 1))) ++half;
+		return (uint16_t)(sign | half);
+	}
+	uint32_t half = ((uint32_t)halfExponent << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1fff;
+	// A carry out of the mantissa correctly bumps the exponent, up to infinity
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) ++half;
+	return (uint16_t)(sign | half);
+}
+
+static inline float halfToFloat(uint16_t half) {
+	uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+	uint32_t exponent = (half >> 10) & 0x1f;
+	uint32_t mantissa = half & 0x3ff;
+	uint32_t f;
+	if (exponent == 0x1f) {
+		f = sign | 0x7f800000 | (mantissa << 13);
+	} else if (exponent != 0) {
+		f = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	} else if (mantissa == 0) {
+		f = sign;
+	} else {
+		// Subnormal half, normal float
+		exponent = 113;
+		while (!(mantissa & 0x400)) {
+			mantissa <<= 1;
+			--exponent;
+		}
+		f = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+	}
+	float value;
+	memcpy(&value, &f, sizeof(value));
+	return value;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _half_float_h_
@@ -0,0 +1,957 @@
+#include "ibl-baker.h"
+#include "jpeg-decoder.h"
+#include "mapped-file.h"
+#include "webgpu-utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PARAMS_SLOT_SIZE 256
+// Specular level i uses slot i, which level 0 does not need
+#define BRDF_LUT_PARAMS_SLOT 0
+#define SPECULAR_TEXEL_SIZE 8 // RGBA16Float
+#define BRDF_LUT_TEXEL_SIZE 4 // RG16Float
+#define IRRADIANCE_SIZE (IBL_SH_COEFFICIENTS * 4 * sizeof(float))
+// Largest equirectangular map, the default maxTextureDimension2D
+#define MAX_SOURCE_SIZE 8192
+
+struct SpecularParams {
+	float roughness;
+	uint32_t sampleCount;
+	float environmentSize;
+	uint32_t padding;
+};
+
+struct BrdfLutParams {
+	uint32_t size;
+	uint32_t sampleCount;
+};
+
+// Shaders
+
+// Directions of the texels of cube faces, and GGX importance sampling
+#define COMMON_WGSL "\
+const pi = 3.14159265359;\n\
+\n\
+// Direction through (s, t) in [-1, 1] of cube face `face`, not normalized\n\
+fn cubeDirection(face: u32, st: vec2f) -> vec3f {\n\
+    switch face {\n\
+        case 0u: { return vec3f(1.0, -st.y, -st.x); }\n\
+        case 1u: { return vec3f(-1.0, -st.y, st.x); }\n\
+        case 2u: { return vec3f(st.x, 1.0, st.y); }\n\
+        case 3u: { return vec3f(st.x, -1.0, -st.y); }\n\
+        case 4u: { return vec3f(st.x, -st.y, 1.0); }\n\
+        default: { return vec3f(-st.x, -st.y, -1.0); }\n\
+    }\n\
+}\n\
+\n\
+fn hammersley(i: u32, n: u32) -> vec2f {\n\
+    return vec2f(f32(i) / f32(n), f32(reverseBits(i)) * 2.3283064365386963e-10);\n\
+}\n\
+\n\
+// Half vector around n of the GGX distribution of roughness alpha\n\
+fn importanceSampleGgx(xi: vec2f, n: vec3f, alpha: f32) -> vec3f {\n\
+    let a2 = alpha * alpha;\n\
+    let phi = 2.0 * pi * xi.x;\n\
+    let cosTheta = sqrt((1.0 - xi.y) / (1.0 + (a2 - 1.0) * xi.y));\n\
+    let sinTheta = sqrt(1.0 - cosTheta * cosTheta);\n\
+    let up = select(vec3f(1.0, 0.0, 0.0), vec3f(0.0, 0.0, 1.0), abs(n.z) < 0.999);\n\
+    let tangent = normalize(cross(up, n));\n\
+    let bitangent = cross(n, tangent);\n\
+    return normalize(tangent * (sinTheta * cos(phi)) + bitangent * (sinTheta * sin(phi)) + n * cosTheta);\n\
+}\n\
+\n\
+fn ggxDistribution(nh: f32, alpha: f32) -> f32 {\n\
+    let a2 = alpha * alpha;\n\
+    let d = nh * nh * (a2 - 1.0) + 1.0;\n\
+    return a2 / (pi * d * d);\n\
+}\n\
+"
+
+static const char* equirectShaderSource = COMMON_WGSL "\
+@group(0) @binding(0) var source: texture_2d<f32>;\n\
+@group(0) @binding(1) var sourceSampler: sampler;\n\
+@group(0) @binding(2) var environment: texture_storage_2d_array<rgba16float, write>;\n\
+\n\
+@compute @workgroup_size(8, 8)\n\
+fn main(@builtin(global_invocation_id) id: vec3u) {\n\
+    let size = textureDimensions(environment);\n\
+    if (any(id.xy >= size)) { return; }\n\
+    // 2x2 samples per texel, sources being usually finer than the cubemap\n\
+    var color = vec3f(0.0);\n\
+    for (var j = 0u; j < 2u; j++) {\n\
+        for (var i = 0u; i < 2u; i++) {\n\
+            let p = (vec2f(id.xy) + vec2f(0.25 + 0.5 * f32(i), 0.25 + 0.5 * f32(j))) / vec2f(size);\n\
+            let d = normalize(cubeDirection(id.z, 2.0 * p - 1.0));\n\
+            let uv = vec2f(atan2(d.y, d.x) / (2.0 * pi) + 0.5, acos(clamp(d.z, -1.0, 1.0)) / pi);\n\
+            color += textureSampleLevel(source, sourceSampler, uv, 0.0).rgb;\n\
+        }\n\
+    }\n\
+    textureStore(environment, id.xy, id.z, vec4f(0.25 * color, 1.0));\n\
+}\n\
+";
+
+static const char* specularShaderSource = COMMON_WGSL "\
+struct Params {\n\
+    roughness: f32,\n\
+    sampleCount: u32,\n\
+    environmentSize: f32,\n\
+}\n\
+@group(0) @binding(0) var environment: texture_cube<f32>;\n\
+@group(0) @binding(1) var environmentSampler: sampler;\n\
+@group(0) @binding(2) var specular: texture_storage_2d_array<rgba16float, write>;\n\
+@group(0) @binding(3) var<uniform> params: Params;\n\
+\n\
+@compute @workgroup_size(8, 8)\n\
+fn main(@builtin(global_invocation_id) id: vec3u) {\n\
+    let size = textureDimensions(specular);\n\
+    if (any(id.xy >= size)) { return; }\n\
+    let n = normalize(cubeDirection(id.z, 2.0 * (vec2f(id.xy) + 0.5) / vec2f(size) - 1.0));\n\
+    let alpha = params.roughness * params.roughness;\n\
+    let texelSolidAngle = 4.0 * pi / (6.0 * params.environmentSize * params.environmentSize);\n\
+    var color = vec3f(0.0);\n\
+    var weight = 0.0;\n\
+    for (var i = 0u; i < params.sampleCount; i++) {\n\
+        // With V = N, as the split-sum approximation assumes\n\
+        let h = importanceSampleGgx(hammersley(i, params.sampleCount), n, alpha);\n\
+        let nh = dot(n, h);\n\
+        let l = 2.0 * nh * h - n;\n\
+        let nl = dot(n, l);\n\
+        if (nl > 0.0) {\n\
+            // Read the level whose texels cover the solid angle of the\n\
+            // sample, of pdf D * nh / (4 * vh) = D / 4\n\
+            let sampleSolidAngle = 4.0 / (f32(params.sampleCount) * ggxDistribution(nh, alpha) + 1e-4);\n\
+            let level = max(0.5 * log2(sampleSolidAngle / texelSolidAngle) + 1.0, 0.0);\n\
+            color += textureSampleLevel(environment, environmentSampler, l, level).rgb * nl;\n\
+            weight += nl;\n\
+        }\n\
+    }\n\
+    textureStore(specular, id.xy, id.z, vec4f(color / max(weight, 1e-4), 1.0));\n\
+}\n\
+";
+
+static const char* irradianceShaderSource = COMMON_WGSL "\
+@group(0) @binding(0) var environment: texture_2d_array<f32>;\n\
+@group(0) @binding(1) var<storage, read_write> irradiance: array<vec4f, 9>;\n\
+\n\
+const threadCount = 64u;\n\
+// Coefficients of each thread, 9 values apart\n\
+var<workgroup> sums: array<vec4f, 576>;\n\
+\n\
+// Real spherical harmonics of bands 0 to 2\n\
+fn shBasis(n: vec3f) -> array<f32, 9> {\n\
+    return array<f32, 9>(\n\
+        0.282095,\n\
+        0.488603 * n.y, 0.488603 * n.z, 0.488603 * n.x,\n\
+        1.092548 * n.x * n.y, 1.092548 * n.y * n.z, 0.315392 * (3.0 * n.z * n.z - 1.0),\n\
+        1.092548 * n.x * n.z, 0.546274 * (n.x * n.x - n.y * n.y));\n\
+}\n\
+\n\
+@compute @workgroup_size(64)\n\
+fn main(@builtin(local_invocation_index) index: u32) {\n\
+    let size = textureDimensions(environment).x;\n\
+    let faceTexels = size * size;\n\
+    var c: array<vec4f, 9>;\n\
+    var weight = 0.0;\n\
+    for (var t = index; t < 6u * faceTexels; t += threadCount) {\n\
+        let face = t / faceTexels;\n\
+        let p = vec2u(t % size, (t % faceTexels) / size);\n\
+        let d = cubeDirection(face, 2.0 * (vec2f(p) + 0.5) / f32(size) - 1.0);\n\
+        // Solid angle of the texel: its area on the face over its distance cubed\n\
+        let r2 = dot(d, d);\n\
+        let w = 4.0 / (f32(faceTexels) * r2 * sqrt(r2));\n\
+        let radiance = textureLoad(environment, p, face, 0).rgb * w;\n\
+        var y = shBasis(d / sqrt(r2));\n\
+        for (var k = 0u; k < 9u; k++) {\n\
+            c[k] += vec4f(radiance * y[k], 0.0);\n\
+        }\n\
+        weight += w;\n\
+    }\n\
+    c[0].w = weight;\n\
+    for (var k = 0u; k < 9u; k++) {\n\
+        sums[index * 9u + k] = c[k];\n\
+    }\n\
+    for (var stride = threadCount / 2u; stride > 0u; stride /= 2u) {\n\
+        workgroupBarrier();\n\
+        if (index < stride) {\n\
+            for (var k = 0u; k < 9u; k++) {\n\
+                sums[index * 9u + k] += sums[(index + stride) * 9u + k];\n\
+            }\n\
+        }\n\
+    }\n\
+    workgroupBarrier();\n\
+    if (index < 9u) {\n\
+        // Convolution with the cosine lobe (pi, 2 pi / 3 and pi / 4 per band)\n\
+        // divided by pi, and constants of the basis, so that iblIrradiance\n\
+        // is a polynomial. Weights are normalized to the whole sphere.\n\
+        var band = array<f32, 9>(1.0, 2.0 / 3.0, 2.0 / 3.0, 2.0 / 3.0, 0.25, 0.25, 0.25, 0.25, 0.25);\n\
+        var basis = array<f32, 9>(0.282095, 0.488603, 0.488603, 0.488603, 1.092548, 1.092548, 0.315392, 1.092548, 0.546274);\n\
+        let normalization = 4.0 * pi / sums[0].w;\n\
+        irradiance[index] = vec4f(sums[index].rgb * (band[index] * basis[index] * normalization), 0.0);\n\
+    }\n\
+}\n\
+";
+
+static const char* brdfLutShaderSource = COMMON_WGSL "\
+struct Params {\n\
+    size: u32,\n\
+    sampleCount: u32,\n\
+}\n\
+@group(0) @binding(0) var<storage, read_write> lut: array<u32>;\n\
+@group(0) @binding(1) var<uniform> params: Params;\n\
+\n\
+fn smithG1(nx: f32, k: f32) -> f32 {\n\
+    return nx / (nx * (1.0 - k) + k);\n\
+}\n\
+\n\
+@compute @workgroup_size(8, 8)\n\
+fn main(@builtin(global_invocation_id) id: vec3u) {\n\
+    if (any(id.xy >= vec2u(params.size))) { return; }\n\
+    let nv = (f32(id.x) + 0.5) / f32(params.size);\n\
+    let roughness = (f32(id.y) + 0.5) / f32(params.size);\n\
+    let alpha = roughness * roughness;\n\
+    // Schlick-Smith k of image-based lighting\n\
+    let k = alpha / 2.0;\n\
+    let v = vec3f(sqrt(1.0 - nv * nv), 0.0, nv);\n\
+    var scaleBias = vec2f(0.0);\n\
+    for (var i = 0u; i < params.sampleCount; i++) {\n\
+        let h = importanceSampleGgx(hammersley(i, params.sampleCount), vec3f(0.0, 0.0, 1.0), alpha);\n\
+        let vh = max(dot(v, h), 0.0);\n\
+        let l = 2.0 * vh * h - v;\n\
+        if (l.z > 0.0) {\n\
+            // BRDF times nl over the pdf of l, without F\n\
+            let visibility = smithG1(nv, k) * smithG1(l.z, k) * vh / (h.z * nv);\n\
+            let fresnel = pow(1.0 - vh, 5.0);\n\
+            scaleBias += vec2f(1.0 - fresnel, fresnel) * visibility;\n\
+        }\n\
+    }\n\
+    lut[id.x + id.y * params.size] = pack2x16float(scaleBias / f32(params.sampleCount));\n\
+}\n\
+";
+
+// Pipelines
+
+static WGPUBindGroupLayoutEntry textureLayoutEntry(uint32_t binding, WGPUTextureSampleType sampleType, WGPUTextureViewDimension viewDimension) {
+	WGPUBindGroupLayoutEntry entry = (WGPUBindGroupLayoutEntry) {};
+	entry.binding = binding;
+	entry.visibility = WGPUShaderStage_Compute;
+	entry.texture.sampleType = sampleType;
+	entry.texture.viewDimension = viewDimension;
+	entry.texture.multisampled = false;
+	return entry;
+}
+
+static WGPUBindGroupLayoutEntry samplerLayoutEntry(uint32_t binding) {
+	WGPUBindGroupLayoutEntry entry = (WGPUBindGroupLayoutEntry) {};
+	entry.binding = binding;
+	entry.visibility = WGPUShaderStage_Compute;
+	entry.sampler.type = WGPUSamplerBindingType_Filtering;
+	return entry;
+}
+
+static WGPUBindGroupLayoutEntry cubeStorageLayoutEntry(uint32_t binding) {
+	WGPUBindGroupLayoutEntry entry = (WGPUBindGroupLayoutEntry) {};
+	entry.binding = binding;
+	entry.visibility = WGPUShaderStage_Compute;
+	entry.storageTexture.access = WGPUStorageTextureAccess_WriteOnly;
+	entry.storageTexture.format = WGPUTextureFormat_RGBA16Float;
+	entry.storageTexture.viewDimension = WGPUTextureViewDimension_2DArray;
+	return entry;
+}
+
+static bool createPipeline(WGPUDevice device, struct IblPipeline * p, WGPUBindGroupLayoutEntry const * entries, uint32_t entryCount, char const * source, char const * label) {
+	WGPUBindGroupLayoutDescriptor layoutDesc = (WGPUBindGroupLayoutDescriptor) {};
+	layoutDesc.nextInChain = NULL;
+	layoutDesc.label = label;
+	layoutDesc.entryCount = entryCount;
+	layoutDesc.entries = entries;
+	p->layout = wgpuDeviceCreateBindGroupLayout(device, &layoutDesc);
+
+	WGPUShaderModule module = createWGSLShaderModule(device, source, label);
+	WGPUPipelineLayout pipelineLayout = createSingleGroupPipelineLayout(device, p->layout, label);
+	p->pipeline = createComputePipeline(device, pipelineLayout, module, "main", label);
+	wgpuPipelineLayoutRelease(pipelineLayout);
+	wgpuShaderModuleRelease(module);
+	return p->pipeline != NULL;
+}
+
+static void releasePipeline(struct IblPipeline * p) {
+	if (p->pipeline) wgpuComputePipelineRelease(p->pipeline);
+	if (p->layout) wgpuBindGroupLayoutRelease(p->layout);
+}
+
+static bool createPipelines(struct IblBaker * baker) {
+	WGPUBindGroupLayoutEntry equirect[3] = {
+		textureLayoutEntry(0, WGPUTextureSampleType_Float, WGPUTextureViewDimension_2D),
+		samplerLayoutEntry(1),
+		cubeStorageLayoutEntry(2),
+	};
+	WGPUBindGroupLayoutEntry specular[4] = {
+		textureLayoutEntry(0, WGPUTextureSampleType_Float, WGPUTextureViewDimension_Cube),
+		samplerLayoutEntry(1),
+		cubeStorageLayoutEntry(2),
+		bufferLayoutEntry(3, WGPUShaderStage_Compute, WGPUBufferBindingType_Uniform, true),
+	};
+	WGPUBindGroupLayoutEntry irradiance[2] = {
+		textureLayoutEntry(0, WGPUTextureSampleType_UnfilterableFloat, WGPUTextureViewDimension_2DArray),
+		bufferLayoutEntry(1, WGPUShaderStage_Compute, WGPUBufferBindingType_Storage, false),
+	};
+	WGPUBindGroupLayoutEntry brdfLut[2] = {
+		bufferLayoutEntry(0, WGPUShaderStage_Compute, WGPUBufferBindingType_Storage, false),
+		bufferLayoutEntry(1, WGPUShaderStage_Compute, WGPUBufferBindingType_Uniform, true),
+	};
+	bool ok = createPipeline(baker->device, &baker->equirectPipeline, equirect, 3, equirectShaderSource, "IBL equirectangular to cube");
+	ok = createPipeline(baker->device, &baker->specularPipeline, specular, 4, specularShaderSource, "IBL specular") && ok;
+	ok = createPipeline(baker->device, &baker->irradiancePipeline, irradiance, 2, irradianceShaderSource, "IBL irradiance") && ok;
+	ok = createPipeline(baker->device, &baker->brdfLutPipeline, brdfLut, 2, brdfLutShaderSource, "IBL BRDF LUT") && ok;
+	return ok;
+}
+
+// GPU resources
+
+static WGPUTexture createSquareTexture(WGPUDevice device, WGPUTextureFormat format, uint32_t size, uint32_t layerCount, uint32_t mipLevelCount, WGPUTextureUsageFlags usage, char const * label) {
+	WGPUTextureDescriptor desc = (WGPUTextureDescriptor) {};
+	desc.nextInChain = NULL;
+	desc.label = label;
+	desc.usage = usage;
+	desc.dimension = WGPUTextureDimension_2D;
+	desc.size = (WGPUExtent3D) { size, size, layerCount };
+	desc.format = format;
+	desc.mipLevelCount = mipLevelCount;
+	desc.sampleCount = 1;
+	desc.viewFormatCount = 0;
+	desc.viewFormats = NULL;
+	return wgpuDeviceCreateTexture(device, &desc);
+}
+
+static WGPUTextureView createView(WGPUTexture texture, WGPUTextureFormat format, WGPUTextureViewDimension dimension, uint32_t baseMipLevel, uint32_t mipLevelCount, uint32_t layerCount, char const * label) {
+	WGPUTextureViewDescriptor viewDesc = (WGPUTextureViewDescriptor) {};
+	viewDesc.nextInChain = NULL;
+	viewDesc.label = label;
+	viewDesc.format = format;
+	viewDesc.dimension = dimension;
+	viewDesc.baseMipLevel = baseMipLevel;
+	viewDesc.mipLevelCount = mipLevelCount;
+	viewDesc.baseArrayLayer = 0;
+	viewDesc.arrayLayerCount = layerCount;
+	viewDesc.aspect = WGPUTextureAspect_All;
+	return wgpuTextureCreateView(texture, &viewDesc);
+}
+
+static WGPUBindGroupEntry textureBindGroupEntry(uint32_t binding, WGPUTextureView view) {
+	WGPUBindGroupEntry entry = (WGPUBindGroupEntry) {};
+	entry.binding = binding;
+	entry.textureView = view;
+	return entry;
+}
+
+static WGPUBindGroupEntry samplerBindGroupEntry(uint32_t binding, WGPUSampler sampler) {
+	WGPUBindGroupEntry entry = (WGPUBindGroupEntry) {};
+	entry.binding = binding;
+	entry.sampler = sampler;
+	return entry;
+}
+
+static WGPUBindGroup createBindGroup(WGPUDevice device, struct IblPipeline const * p, WGPUBindGroupEntry const * entries, uint32_t entryCount, char const * label) {
+	WGPUBindGroupDescriptor desc = (WGPUBindGroupDescriptor) {};
+	desc.nextInChain = NULL;
+	desc.label = label;
+	desc.layout = p->layout;
+	desc.entryCount = entryCount;
+	desc.entries = entries;
+	return wgpuDeviceCreateBindGroup(device, &desc);
+}
+
+static WGPUComputePassEncoder beginPass(WGPUCommandEncoder encoder, char const * label) {
+	WGPUComputePassDescriptor passDesc = (WGPUComputePassDescriptor) {};
+	passDesc.nextInChain = NULL;
+	passDesc.label = label;
+	passDesc.timestampWriteCount = 0;
+	passDesc.timestampWrites = NULL;
+	return wgpuCommandEncoderBeginComputePass(encoder, &passDesc);
+}
+
+static uint32_t specularLevelSize(uint32_t level) {
+	return IBL_SPECULAR_SIZE >> level;
+}
+
+/**
+ * Bytes of the specular levels of a cache, tightly packed.
+ */
+static uint64_t specularDataSize(void) {
+	uint64_t size = 0;
+	for (uint32_t level = 0; level < IBL_SPECULAR_LEVELS; ++level) {
+		size += (uint64_t)specularLevelSize(level) * specularLevelSize(level) * 6 * SPECULAR_TEXEL_SIZE;
+	}
+	return size;
+}
+
+static void onMapped(WGPUBufferMapAsyncStatus status, void * pUserData) {
+	*(int *)pUserData = status == WGPUBufferMapAsyncStatus_Success ? 1 : -1;
+}
+
+/**
+ * Submit `command`, then map `readback` and wait for it. Returns the
+ * mapped range, or NULL if mapping failed.
+ */
+static void const * submitAndMap(struct IblBaker * baker, WGPUCommandBuffer command, WGPUBuffer readback, uint64_t size) {
+	wgpuQueueSubmit(baker->queue, 1, &command);
+	wgpuCommandBufferRelease(command);
+	int mapped = 0;
+	wgpuBufferMapAsync(readback, WGPUMapMode_Read, 0, (size_t)size, onMapped, &mapped);
+	while (mapped == 0) {
+#ifdef WEBGPU_BACKEND_DAWN
+		wgpuDeviceTick(baker->device);
+#endif
+	}
+	return mapped > 0 ? wgpuBufferGetConstMappedRange(readback, 0, (size_t)size) : NULL;
+}
+
+// Cache files
+
+static struct IblCacheHeader cacheHeader(uint64_t sourceHash) {
+	struct IblCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, IBL_CACHE_MAGIC, 4);
+	header.version = IBL_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.dataOffset = alignUp(sizeof(header), IBL_CACHE_ALIGNMENT);
+	if (sourceHash != 0) {
+		header.specularSize = IBL_SPECULAR_SIZE;
+		header.specularLevelCount = IBL_SPECULAR_LEVELS;
+		header.specularSampleCount = IBL_SPECULAR_SAMPLES;
+		header.dataSize = specularDataSize();
+	} else {
+		header.brdfLutSize = IBL_BRDF_LUT_SIZE;
+		header.brdfLutSampleCount = IBL_BRDF_LUT_SAMPLES;
+		header.dataSize = (uint64_t)IBL_BRDF_LUT_SIZE * IBL_BRDF_LUT_SIZE * BRDF_LUT_TEXEL_SIZE;
+	}
+	return header;
+}
+
+static char * cachePath(struct IblBaker const * baker, char const * name) {
+	size_t directoryLength = strlen(baker->cacheDirectory);
+	size_t nameLength = strlen(name);
+	char * path = (char *)malloc(directoryLength + nameLength + 2);
+	memcpy(path, baker->cacheDirectory, directoryLength);
+	path[directoryLength] = '/';
+	memcpy(path + directoryLength + 1, name, nameLength + 1);
+	return path;
+}
+
+/**
+ * Map the cache at `path` if it was baked from the source and with the
+ * settings of `expected`. Returns NULL when it is missing or stale, and
+ * prints why when it is invalid.
+ */
+static struct MappedFile * openCache(char const * path, struct IblCacheHeader const * expected) {
+	uint64_t size = 0;
+	int64_t modified = 0;
+	if (!mappedFileStat(path, &size, &modified)) return NULL;
+	struct MappedFile * file = mappedFileOpen(path);
+	if (!file) return NULL;
+
+	char const * error = NULL;
+	bool stale = false;
+	struct IblCacheHeader const * header = (struct IblCacheHeader const *)file->data;
+	if (file->size < sizeof(struct IblCacheHeader) || memcmp(header->magic, IBL_CACHE_MAGIC, 4) != 0) {
+		error = "not an IBL cache";
+	} else if (header->version != IBL_CACHE_VERSION) {
+		error = "unsupported version";
+	} else if (header->sourceHash != expected->sourceHash
+		|| header->specularSize != expected->specularSize
+		|| header->specularLevelCount != expected->specularLevelCount
+		|| header->specularSampleCount != expected->specularSampleCount
+		|| header->brdfLutSize != expected->brdfLutSize
+		|| header->brdfLutSampleCount != expected->brdfLutSampleCount) {
+		stale = true;
+	} else if (header->dataOffset % IBL_CACHE_ALIGNMENT != 0 || header->dataSize != expected->dataSize
+		|| header->dataOffset > file->size || header->dataSize > file->size - header->dataOffset) {
+		error = "invalid data range";
+	}
+
+	if (error || stale) {
+		if (error) fprintf(stderr, "Could not load IBL cache %s: %s\n", path, error);
+		mappedFileClose(file);
+		return NULL;
+	}
+	return file;
+}
+
+/**
+ * Write a cache through a temporary file, so that it is never seen half
+ * written.
+ */
+static bool writeCache(char const * path, struct IblCacheHeader const * header, void const * data) {
+	static const uint8_t zeros[IBL_CACHE_ALIGNMENT] = { 0 };
+	size_t pathLength = strlen(path);
+	char * temporaryPath = (char *)malloc(pathLength + 5);
+	memcpy(temporaryPath, path, pathLength);
+	memcpy(temporaryPath + pathLength, ".tmp", 5);
+	FILE * file = fopen(temporaryPath, "wb");
+	if (!file) {
+		fprintf(stderr, "Could not open %s for writing\n", temporaryPath);
+		free(temporaryPath);
+		return false;
+	}
+	size_t padding = (size_t)header->dataOffset - sizeof(*header);
+	bool ok = fwrite(header, sizeof(*header), 1, file) == 1
+		&& fwrite(zeros, 1, padding, file) == padding
+		&& fwrite(data, 1, (size_t)header->dataSize, file) == header->dataSize;
+	ok = fclose(file) == 0 && ok;
+	// rename does not replace existing files on Windows
+	remove(path);
+	ok = ok && rename(temporaryPath, path) == 0;
+	if (!ok) {
+		fprintf(stderr, "Could not write IBL cache %s\n", path);
+		remove(temporaryPath);
+	}
+	free(temporaryPath);
+	return ok;
+}
+
+// BRDF LUT
+
+static void writeBrdfLut(struct IblBaker * baker, void const * data) {
+	WGPUImageCopyTexture destination = (WGPUImageCopyTexture) {};
+	destination.texture = baker->brdfLut;
+	destination.mipLevel = 0;
+	destination.origin = (WGPUOrigin3D) { 0, 0, 0 };
+	destination.aspect = WGPUTextureAspect_All;
+	WGPUTextureDataLayout layout = (WGPUTextureDataLayout) {};
+	layout.offset = 0;
+	layout.bytesPerRow = IBL_BRDF_LUT_SIZE * BRDF_LUT_TEXEL_SIZE;
+	layout.rowsPerImage = IBL_BRDF_LUT_SIZE;
+	WGPUExtent3D size = { IBL_BRDF_LUT_SIZE, IBL_BRDF_LUT_SIZE, 1 };
+	wgpuQueueWriteTexture(baker->queue, &destination, data, (size_t)IBL_BRDF_LUT_SIZE * IBL_BRDF_LUT_SIZE * BRDF_LUT_TEXEL_SIZE, &layout, &size);
+}
+
+/**
+ * Bake the LUT into baker->brdfLut, and into `header` and the cache file
+ * at `path`.
+ */
+static bool bakeBrdfLut(struct IblBaker * baker, struct IblCacheHeader const * header, char const * path) {
+	uint64_t lutSize = header->dataSize;
+	WGPUBuffer lut = createBuffer(baker->device, lutSize, WGPUBufferUsage_Storage | WGPUBufferUsage_CopySrc, "IBL BRDF LUT");
+	WGPUBuffer readback = createBuffer(baker->device, lutSize, WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst, "IBL BRDF LUT readback");
+	WGPUBindGroupEntry entries[2] = {
+		bufferBindGroupEntry(0, lut, 0, lutSize),
+		bufferBindGroupEntry(1, baker->paramsBuffer, 0, sizeof(struct BrdfLutParams)),
+	};
+	WGPUBindGroup bindGroup = createBindGroup(baker->device, &baker->brdfLutPipeline, entries, 2, "IBL BRDF LUT");
+
+	WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(baker->device, NULL);
+	WGPUComputePassEncoder pass = beginPass(encoder, "IBL BRDF LUT");
+	uint32_t paramsOffset = BRDF_LUT_PARAMS_SLOT * PARAMS_SLOT_SIZE;
+	wgpuComputePassEncoderSetPipeline(pass, baker->brdfLutPipeline.pipeline);
+	wgpuComputePassEncoderSetBindGroup(pass, 0, bindGroup, 1, &paramsOffset);
+	wgpuComputePassEncoderDispatchWorkgroups(pass, IBL_BRDF_LUT_SIZE / 8, IBL_BRDF_LUT_SIZE / 8, 1);
+	wgpuComputePassEncoderEnd(pass);
+	wgpuComputePassEncoderRelease(pass);
+
+	WGPUImageCopyBuffer source = (WGPUImageCopyBuffer) {};
+	source.buffer = lut;
+	source.layout.offset = 0;
+	source.layout.bytesPerRow = IBL_BRDF_LUT_SIZE * BRDF_LUT_TEXEL_SIZE;
+	source.layout.rowsPerImage = IBL_BRDF_LUT_SIZE;
+	WGPUImageCopyTexture destination = (WGPUImageCopyTexture) {};
+	destination.texture = baker->brdfLut;
+	destination.mipLevel = 0;
+	destination.origin = (WGPUOrigin3D) { 0, 0, 0 };
+	destination.aspect = WGPUTextureAspect_All;
+	WGPUExtent3D size = { IBL_BRDF_LUT_SIZE, IBL_BRDF_LUT_SIZE, 1 };
+	wgpuCommandEncoderCopyBufferToTexture(encoder, &source, &destination, &size);
+	wgpuCommandEncoderCopyBufferToBuffer(encoder, lut, 0, readback, 0, lutSize);
+	WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, NULL);
+	wgpuCommandEncoderRelease(encoder);
+	wgpuBindGroupRelease(bindGroup);
+
+	void const * data = submitAndMap(baker, command, readback, lutSize);
+	if (data) {
+		writeCache(path, header, data);
+		wgpuBufferUnmap(readback);
+	}
+	wgpuBufferDestroy(readback);
+	wgpuBufferRelease(readback);
+	wgpuBufferDestroy(lut);
+	wgpuBufferRelease(lut);
+	return data != NULL;
+}
+
+struct IblBaker * iblBakerCreate(WGPUDevice device, char const * cacheDirectory) {
+	struct IblBaker * baker = (struct IblBaker *)calloc(1, sizeof(struct IblBaker));
+	baker->device = device;
+	baker->queue = wgpuDeviceGetQueue(device);
+	if (!cacheDirectory) cacheDirectory = ".";
+	baker->cacheDirectory = (char *)malloc(strlen(cacheDirectory) + 1);
+	memcpy(baker->cacheDirectory, cacheDirectory, strlen(cacheDirectory) + 1);
+	baker->mipmaps = mipmapGeneratorCreate(device);
+
+	WGPUSamplerDescriptor samplerDesc = (WGPUSamplerDescriptor) {};
+	samplerDesc.nextInChain = NULL;
+	samplerDesc.label = "IBL";
+	samplerDesc.addressModeU = WGPUAddressMode_Repeat;
+	samplerDesc.addressModeV = WGPUAddressMode_ClampToEdge;
+	samplerDesc.addressModeW = WGPUAddressMode_ClampToEdge;
+	samplerDesc.magFilter = WGPUFilterMode_Linear;
+	samplerDesc.minFilter = WGPUFilterMode_Linear;
+	samplerDesc.mipmapFilter = WGPUFilterMode_Linear;
+	samplerDesc.lodMinClamp = 0.0f;
+	samplerDesc.lodMaxClamp = 32.0f;
+	samplerDesc.compare = WGPUCompareFunction_Undefined;
+	samplerDesc.maxAnisotropy = 1;
+	baker->sampler = wgpuDeviceCreateSampler(device, &samplerDesc);
+
+	// Parameters do not change between bakes
+	uint8_t params[IBL_SPECULAR_LEVELS * PARAMS_SLOT_SIZE];
+	memset(params, 0, sizeof(params));
+	struct BrdfLutParams brdfLutParams = { IBL_BRDF_LUT_SIZE, IBL_BRDF_LUT_SAMPLES };
+	memcpy(params + BRDF_LUT_PARAMS_SLOT * PARAMS_SLOT_SIZE, &brdfLutParams, sizeof(brdfLutParams));
+	for (uint32_t level = 1; level < IBL_SPECULAR_LEVELS; ++level) {
+		struct SpecularParams specularParams = (struct SpecularParams) {};
+		specularParams.roughness = (float)level / (float)(IBL_SPECULAR_LEVELS - 1);
+		specularParams.sampleCount = IBL_SPECULAR_SAMPLES;
+		specularParams.environmentSize = (float)IBL_ENVIRONMENT_SIZE;
+		memcpy(params + level * PARAMS_SLOT_SIZE, &specularParams, sizeof(specularParams));
+	}
+	baker->paramsBuffer = createBuffer(device, sizeof(params), WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst, "IBL params");
+	wgpuQueueWriteBuffer(baker->queue, baker->paramsBuffer, 0, params, sizeof(params));
+
+	if (!createPipelines(baker)) {
+		fprintf(stderr, "Could not create the IBL pipelines\n");
+		iblBakerRelease(baker);
+		return NULL;
+	}
+
+	baker->brdfLut = createSquareTexture(device, WGPUTextureFormat_RG16Float, IBL_BRDF_LUT_SIZE, 1, 1, WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst, "IBL BRDF LUT");
+	baker->brdfLutView = createView(baker->brdfLut, WGPUTextureFormat_RG16Float, WGPUTextureViewDimension_2D, 0, 1, 1, "IBL BRDF LUT");
+	struct IblCacheHeader header = cacheHeader(0);
+	char * path = cachePath(baker, IBL_BRDF_LUT_CACHE_NAME);
+	struct MappedFile * cache = openCache(path, &header);
+	bool ok = true;
+	if (cache) {
+		writeBrdfLut(baker, (uint8_t const *)cache->data + ((struct IblCacheHeader const *)cache->data)->dataOffset);
+		mappedFileClose(cache);
+	} else {
+		ok = bakeBrdfLut(baker, &header, path);
+	}
+	free(path);
+	if (!ok) {
+		fprintf(stderr, "Could not bake the BRDF LUT\n");
+		iblBakerRelease(baker);
+		return NULL;
+	}
+	return baker;
+}
+
+// Environments
+
+static WGPUTexture createSpecularTexture(struct IblBaker * baker, WGPUTextureUsageFlags usage, struct IblEnvironment * environment) {
+	environment->specular = createSquareTexture(baker->device, WGPUTextureFormat_RGBA16Float, IBL_SPECULAR_SIZE, 6, IBL_SPECULAR_LEVELS, WGPUTextureUsage_TextureBinding | usage, "IBL specular");
+	environment->specularView = createView(environment->specular, WGPUTextureFormat_RGBA16Float, WGPUTextureViewDimension_Cube, 0, IBL_SPECULAR_LEVELS, 6, "IBL specular");
+	return environment->specular;
+}
+
+/**
+ * Bake into `environment`, and read the specular levels back into
+ * `*specularData` (of specularDataSize() bytes, to free) unless it is
+ * NULL.
+ */
+static bool bakeEnvironment(struct IblBaker * baker, uint8_t const * pixels, uint32_t width, uint32_t height, bool srgb, struct IblEnvironment * environment, void ** specularData) {
+	memset(environment, 0, sizeof(*environment));
+	if (width == 0 || height == 0 || width > MAX_SOURCE_SIZE || height > MAX_SOURCE_SIZE) {
+		fprintf(stderr, "Could not bake an environment of %ux%u texels\n", width, height);
+		return false;
+	}
+	WGPUDevice device = baker->device;
+
+	WGPUTextureDescriptor sourceDesc = (WGPUTextureDescriptor) {};
+	sourceDesc.nextInChain = NULL;
+	sourceDesc.label = "IBL source";
+	sourceDesc.usage = WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst;
+	sourceDesc.dimension = WGPUTextureDimension_2D;
+	sourceDesc.size = (WGPUExtent3D) { width, height, 1 };
+	sourceDesc.format = srgb ? WGPUTextureFormat_RGBA8UnormSrgb : WGPUTextureFormat_RGBA8Unorm;
+	sourceDesc.mipLevelCount = 1;
+	sourceDesc.sampleCount = 1;
+	sourceDesc.viewFormatCount = 0;
+	sourceDesc.viewFormats = NULL;
+	WGPUTexture source = wgpuDeviceCreateTexture(device, &sourceDesc);
+	WGPUImageCopyTexture destination = (WGPUImageCopyTexture) {};
+	destination.texture = source;
+	destination.mipLevel = 0;
+	destination.origin = (WGPUOrigin3D) { 0, 0, 0 };
+	destination.aspect = WGPUTextureAspect_All;
+	WGPUTextureDataLayout layout = (WGPUTextureDataLayout) {};
+	layout.offset = 0;
+	layout.bytesPerRow = 4 * width;
+	layout.rowsPerImage = height;
+	wgpuQueueWriteTexture(baker->queue, &destination, pixels, (size_t)width * height * 4, &layout, &sourceDesc.size);
+
+	// Environment cubemap, with the full chain that specular samples read
+	WGPUTextureDescriptor environmentDesc = (WGPUTextureDescriptor) {};
+	environmentDesc.nextInChain = NULL;
+	environmentDesc.label = "IBL environment";
+	environmentDesc.usage = WGPUTextureUsage_StorageBinding | WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopySrc;
+	environmentDesc.dimension = WGPUTextureDimension_2D;
+	environmentDesc.size = (WGPUExtent3D) { IBL_ENVIRONMENT_SIZE, IBL_ENVIRONMENT_SIZE, 6 };
+	environmentDesc.format = WGPUTextureFormat_RGBA16Float;
+	environmentDesc.mipLevelCount = mipmapLevelCount(IBL_ENVIRONMENT_SIZE, IBL_ENVIRONMENT_SIZE);
+	environmentDesc.sampleCount = 1;
+	environmentDesc.viewFormatCount = 0;
+	environmentDesc.viewFormats = NULL;
+	WGPUTexture environmentTexture = wgpuDeviceCreateTexture(device, &environmentDesc);
+	WGPUTexture specular = createSpecularTexture(baker, WGPUTextureUsage_StorageBinding | WGPUTextureUsage_CopySrc | WGPUTextureUsage_CopyDst, environment);
+
+	uint64_t readbackSize = alignUp(IRRADIANCE_SIZE, IBL_CACHE_ALIGNMENT);
+	uint64_t levelOffsets[IBL_SPECULAR_LEVELS];
+	for (uint32_t level = 0; level < IBL_SPECULAR_LEVELS && specularData; ++level) {
+		uint32_t size = specularLevelSize(level);
+		levelOffsets[level] = readbackSize;
+		readbackSize += (uint64_t)alignUp(size * SPECULAR_TEXEL_SIZE, 256) * size * 6;
+	}
+	WGPUBuffer irradiance = createBuffer(device, IRRADIANCE_SIZE, WGPUBufferUsage_Storage | WGPUBufferUsage_CopySrc, "IBL irradiance");
+	WGPUBuffer readback = createBuffer(device, readbackSize, WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst, "IBL readback");
+
+	// Views and bind groups, released once encoded
+	uint32_t irradianceLevel = environmentDesc.mipLevelCount - mipmapLevelCount(IBL_IRRADIANCE_SIZE, IBL_IRRADIANCE_SIZE);
+	WGPUTextureView sourceView = createView(source, sourceDesc.format, WGPUTextureViewDimension_2D, 0, 1, 1, "IBL source");
+	WGPUTextureView environmentStorageView = createView(environmentTexture, WGPUTextureFormat_RGBA16Float, WGPUTextureViewDimension_2DArray, 0, 1, 6, "IBL environment level 0");
+	WGPUTextureView environmentView = createView(environmentTexture, WGPUTextureFormat_RGBA16Float, WGPUTextureViewDimension_Cube, 0, environmentDesc.mipLevelCount, 6, "IBL environment");
+	WGPUTextureView irradianceView = createView(environmentTexture, WGPUTextureFormat_RGBA16Float, WGPUTextureViewDimension_2DArray, irradianceLevel, 1, 6, "IBL environment irradiance level");
+	WGPUTextureView specularViews[IBL_SPECULAR_LEVELS];
+	WGPUBindGroup specularBindGroups[IBL_SPECULAR_LEVELS];
+	for (uint32_t level = 1; level < IBL_SPECULAR_LEVELS; ++level) {
+		specularViews[level] = createView(specular, WGPUTextureFormat_RGBA16Float, WGPUTextureViewDimension_2DArray, level, 1, 6, "IBL specular level");
+		WGPUBindGroupEntry entries[4] = {
+			textureBindGroupEntry(0, environmentView),
+			samplerBindGroupEntry(1, baker->sampler),
+			textureBindGroupEntry(2, specularViews[level]),
+			bufferBindGroupEntry(3, baker->paramsBuffer, 0, sizeof(struct SpecularParams)),
+		};
+		specularBindGroups[level] = createBindGroup(device, &baker->specularPipeline, entries, 4, "IBL specular");
+	}
+	WGPUBindGroupEntry equirectEntries[3] = {
+		textureBindGroupEntry(0, sourceView),
+		samplerBindGroupEntry(1, baker->sampler),
+		textureBindGroupEntry(2, environmentStorageView),
+	};
+	WGPUBindGroup equirectBindGroup = createBindGroup(device, &baker->equirectPipeline, equirectEntries, 3, "IBL equirectangular to cube");
+	WGPUBindGroupEntry irradianceEntries[2] = {
+		textureBindGroupEntry(0, irradianceView),
+		bufferBindGroupEntry(1, irradiance, 0, IRRADIANCE_SIZE),
+	};
+	WGPUBindGroup irradianceBindGroup = createBindGroup(device, &baker->irradiancePipeline, irradianceEntries, 2, "IBL irradiance");
+
+	WGPUCommandEncoderDescriptor encoderDesc = (WGPUCommandEncoderDescriptor) {};
+	encoderDesc.nextInChain = NULL;
+	encoderDesc.label = "IBL bake";
+	WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, &encoderDesc);
+
+	// 1. Resample the source into the environment cubemap and its chain
+	WGPUComputePassEncoder pass = beginPass(encoder, "IBL equirectangular to cube");
+	wgpuComputePassEncoderSetPipeline(pass, baker->equirectPipeline.pipeline);
+	wgpuComputePassEncoderSetBindGroup(pass, 0, equirectBindGroup, 0, NULL);
+	wgpuComputePassEncoderDispatchWorkgroups(pass, IBL_ENVIRONMENT_SIZE / 8, IBL_ENVIRONMENT_SIZE / 8, 6);
+	wgpuComputePassEncoderEnd(pass);
+	wgpuComputePassEncoderRelease(pass);
+	bool ok = mipmapGeneratorEncode(baker->mipmaps, encoder, environmentTexture, &environmentDesc);
+
+	// 2. Level 0 of the specular cubemap is level 1 of the environment
+	WGPUImageCopyTexture copySource = (WGPUImageCopyTexture) {};
+	copySource.texture = environmentTexture;
+	copySource.mipLevel = 1;
+	copySource.origin = (WGPUOrigin3D) { 0, 0, 0 };
+	copySource.aspect = WGPUTextureAspect_All;
+	WGPUImageCopyTexture copyDestination = copySource;
+	copyDestination.texture = specular;
+	copyDestination.mipLevel = 0;
+	WGPUExtent3D copySize = { IBL_SPECULAR_SIZE, IBL_SPECULAR_SIZE, 6 };
+	wgpuCommandEncoderCopyTextureToTexture(encoder, &copySource, &copyDestination, &copySize);
+
+	// 3. Prefilter the other levels, and project the irradiance
+	pass = beginPass(encoder, "IBL specular and irradiance");
+	wgpuComputePassEncoderSetPipeline(pass, baker->specularPipeline.pipeline);
+	for (uint32_t level = 1; level < IBL_SPECULAR_LEVELS; ++level) {
+		uint32_t paramsOffset = level * PARAMS_SLOT_SIZE;
+		uint32_t size = specularLevelSize(level);
+		wgpuComputePassEncoderSetBindGroup(pass, 0, specularBindGroups[level], 1, &paramsOffset);
+		wgpuComputePassEncoderDispatchWorkgroups(pass, (size + 7) / 8, (size + 7) / 8, 6);
+	}
+	wgpuComputePassEncoderSetPipeline(pass, baker->irradiancePipeline.pipeline);
+	wgpuComputePassEncoderSetBindGroup(pass, 0, irradianceBindGroup, 0, NULL);
+	wgpuComputePassEncoderDispatchWorkgroups(pass, 1, 1, 1);
+	wgpuComputePassEncoderEnd(pass);
+	wgpuComputePassEncoderRelease(pass);
+
+	// 4. Read back the irradiance, and the specular levels to cache them
+	wgpuCommandEncoderCopyBufferToBuffer(encoder, irradiance, 0, readback, 0, IRRADIANCE_SIZE);
+	for (uint32_t level = 0; level < IBL_SPECULAR_LEVELS && specularData; ++level) {
+		uint32_t size = specularLevelSize(level);
+		copySource.texture = specular;
+		copySource.mipLevel = level;
+		WGPUImageCopyBuffer copyBuffer = (WGPUImageCopyBuffer) {};
+		copyBuffer.buffer = readback;
+		copyBuffer.layout.offset = levelOffsets[level];
+		copyBuffer.layout.bytesPerRow = (uint32_t)alignUp(size * SPECULAR_TEXEL_SIZE, 256);
+		copyBuffer.layout.rowsPerImage = size;
+		WGPUExtent3D levelSize = { size, size, 6 };
+		wgpuCommandEncoderCopyTextureToBuffer(encoder, &copySource, &copyBuffer, &levelSize);
+	}
+	WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, NULL);
+	wgpuCommandEncoderRelease(encoder);
+
+	// Encoded commands keep what they use alive
+	wgpuBindGroupRelease(equirectBindGroup);
+	wgpuBindGroupRelease(irradianceBindGroup);
+	for (uint32_t level = 1; level < IBL_SPECULAR_LEVELS; ++level) {
+		wgpuBindGroupRelease(specularBindGroups[level]);
+		wgpuTextureViewRelease(specularViews[level]);
+	}
+	wgpuTextureViewRelease(sourceView);
+	wgpuTextureViewRelease(environmentStorageView);
+	wgpuTextureViewRelease(environmentView);
+	wgpuTextureViewRelease(irradianceView);
+
+	uint8_t const * data = (uint8_t const *)submitAndMap(baker, command, readback, readbackSize);
+	if (data) {
+		memcpy(environment->irradiance, data, IRRADIANCE_SIZE);
+		if (specularData) {
+			// Without the padding of rows
+			uint8_t * packed = (uint8_t *)malloc((size_t)specularDataSize());
+			uint8_t * out = packed;
+			for (uint32_t level = 0; level < IBL_SPECULAR_LEVELS; ++level) {
+				uint32_t size = specularLevelSize(level);
+				size_t rowSize = (size_t)size * SPECULAR_TEXEL_SIZE;
+				size_t paddedRowSize = (size_t)alignUp(rowSize, 256);
+				for (uint32_t row = 0; row < 6 * size; ++row) {
+					memcpy(out, data + levelOffsets[level] + row * paddedRowSize, rowSize);
+					out += rowSize;
+				}
+			}
+			*specularData = packed;
+		}
+		wgpuBufferUnmap(readback);
+	}
+	ok = ok && data != NULL;
+	if (!ok) fprintf(stderr, "Could not bake the environment\n");
+
+	wgpuBufferDestroy(readback);
+	wgpuBufferRelease(readback);
+	wgpuBufferDestroy(irradiance);
+	wgpuBufferRelease(irradiance);
+	wgpuTextureDestroy(environmentTexture);
+	wgpuTextureRelease(environmentTexture);
+	wgpuTextureDestroy(source);
+	wgpuTextureRelease(source);
+	environment->baked = true;
+	if (!ok) iblEnvironmentRelease(environment);
+	return ok;
+}
+
+bool iblBakerBake(struct IblBaker * baker, uint8_t const * pixels, uint32_t width, uint32_t height, bool srgb, struct IblEnvironment * environment) {
+	return bakeEnvironment(baker, pixels, width, height, srgb, environment, NULL);
+}
+
+/**
+ * Create the textures of `environment` from the mapped cache `cache`.
+ */
+static void uploadEnvironment(struct IblBaker * baker, struct MappedFile const * cache, struct IblEnvironment * environment) {
+	struct IblCacheHeader const * header = (struct IblCacheHeader const *)cache->data;
+	WGPUTexture specular = createSpecularTexture(baker, WGPUTextureUsage_CopyDst, environment);
+	memcpy(environment->irradiance, header->irradiance, sizeof(environment->irradiance));
+	environment->sourceHash = header->sourceHash;
+	environment->baked = false;
+
+	uint8_t const * data = (uint8_t const *)cache->data + header->dataOffset;
+	WGPUImageCopyTexture destination = (WGPUImageCopyTexture) {};
+	destination.texture = specular;
+	destination.origin = (WGPUOrigin3D) { 0, 0, 0 };
+	destination.aspect = WGPUTextureAspect_All;
+	for (uint32_t level = 0; level < IBL_SPECULAR_LEVELS; ++level) {
+		uint32_t size = specularLevelSize(level);
+		size_t levelBytes = (size_t)size * size * 6 * SPECULAR_TEXEL_SIZE;
+		destination.mipLevel = level;
+		WGPUTextureDataLayout layout = (WGPUTextureDataLayout) {};
+		layout.offset = 0;
+		layout.bytesPerRow = size * SPECULAR_TEXEL_SIZE;
+		layout.rowsPerImage = size;
+		WGPUExtent3D levelSize = { size, size, 6 };
+		wgpuQueueWriteTexture(baker->queue, &destination, data, levelBytes, &layout, &levelSize);
+		data += levelBytes;
+	}
+}
+
+bool iblBakerLoad(struct IblBaker * baker, char const * sourcePath, struct IblEnvironment * environment) {
+	memset(environment, 0, sizeof(*environment));
+	struct MappedFile * sourceFile = mappedFileOpen(sourcePath);
+	if (!sourceFile) return false;
+	uint64_t hash = mappedFileHash(sourceFile->data, sourceFile->size);
+	// 0 identifies the BRDF LUT
+	if (hash == 0) hash = 1;
+
+	// 1. Use the cache of this content if there is one
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx" IBL_CACHE_EXTENSION, (unsigned long long)hash);
+	char * path = cachePath(baker, name);
+	struct IblCacheHeader header = cacheHeader(hash);
+	struct MappedFile * cache = openCache(path, &header);
+	if (cache) {
+		mappedFileClose(sourceFile);
+		uploadEnvironment(baker, cache, environment);
+		mappedFileClose(cache);
+		free(path);
+		return true;
+	}
+
+	// 2. Otherwise bake it
+	uint32_t width = 0, height = 0;
+	uint8_t * pixels = sourceFile->data ? jpegDecode(sourceFile->data, sourceFile->size, &width, &height) : NULL;
+	mappedFileClose(sourceFile);
+	if (!pixels) {
+		fprintf(stderr, "Could not decode %s\n", sourcePath);
+		free(path);
+		return false;
+	}
+	void * specularData = NULL;
+	bool ok = bakeEnvironment(baker, pixels, width, height, true, environment, &specularData);
+	free(pixels);
+	if (ok) {
+		environment->sourceHash = hash;
+		memcpy(header.irradiance, environment->irradiance, sizeof(header.irradiance));
+		// Failing to write the cache only costs the next load a bake
+		writeCache(path, &header, specularData);
+	}
+	free(specularData);
+	free(path);
+	return ok;
+}
+
+void iblEnvironmentRelease(struct IblEnvironment * environment) {
+	if (environment->specularView) wgpuTextureViewRelease(environment->specularView);
+	if (environment->specular) {
+		wgpuTextureDestroy(environment->specular);
+		wgpuTextureRelease(environment->specular);
+	}
+	memset(environment, 0, sizeof(*environment));
+}
+
+void iblBakerRelease(struct IblBaker * baker) {
+	if (!baker) return;
+	if (baker->brdfLutView) wgpuTextureViewRelease(baker->brdfLutView);
+	if (baker->brdfLut) {
+		wgpuTextureDestroy(baker->brdfLut);
+		wgpuTextureRelease(baker->brdfLut);
+	}
+	releasePipeline(&baker->equirectPipeline);
+	releasePipeline(&baker->specularPipeline);
+	releasePipeline(&baker->irradiancePipeline);
+	releasePipeline(&baker->brdfLutPipeline);
+	wgpuBufferRelease(baker->paramsBuffer);
+	wgpuSamplerRelease(baker->sampler);
+	mipmapGeneratorRelease(baker->mipmaps);
+	wgpuQueueRelease(baker->queue);
+	free(baker->cacheDirectory);
+	free(baker);
+}
@@ -0,0 +1,179 @@
+/**
+ * Image-based lighting precomputation on the GPU, with disk caching.
+ *
+ * From an equirectangular environment map, such as the autumn_park_4k.jpg
+ * of the tutorial, compute passes build the three inputs of split-sum
+ * image-based lighting:
+ *  - a prefiltered specular cubemap, whose level i holds the environment
+ *    convolved with a GGX lobe of roughness i / (IBL_SPECULAR_LEVELS - 1),
+ *    level 0 being the environment itself;
+ *  - the irradiance, as 9 spherical harmonics coefficients;
+ *  - the BRDF LUT, scale and bias of F0 in the split-sum approximation,
+ *    which does not depend on the environment and is shared by all.
+ *
+ * The source is first resampled into an RGBA16Float cubemap of
+ * IBL_ENVIRONMENT_SIZE with a full mip chain (see mipmap-generator.h).
+ * Specular levels then importance-sample the GGX lobe, reading each sample
+ * from the level whose texels cover the solid angle it represents, so
+ * that few samples per texel suffice. The irradiance is projected from a
+ * IBL_IRRADIANCE_SIZE level by a single workgroup.
+ *
+ * Directions follow the tutorial: Z is up, and the equirectangular map
+ * covers atan2(y, x) along U and acos(z) along V. Cube faces follow the
+ * usual layer order (+X, -X, +Y, -Y, +Z, -Z), so that the cubemap is
+ * sampled with world-space directions.
+ *
+ * Results are read back and cached in cacheDirectory, the environment in
+ * `<hash>.wibl` where <hash> is the content hash of the source (see
+ * mappedFileHash), the BRDF LUT in IBL_BRDF_LUT_CACHE_NAME. Loading an
+ * environment whose cache exists is a hash of the source and an upload,
+ * so switching environments does not decode nor convolve anything. Caches
+ * baked with other settings are baked again.
+ *
+ * File layout (little endian):
+ *     struct IblCacheHeader header;
+ *     ...padding...
+ *     data[header.dataSize], at header.dataOffset: the specular levels,
+ *     finest first, each of 6 faces of tightly packed RGBA16Float rows, or
+ *     the RG16Float rows of the BRDF LUT
+ *
+ * Shaders evaluate the results with the functions of IBL_WGSL:
+ *     let diffuse = albedo * iblIrradiance(irradiance, n);
+ *     let prefiltered = textureSampleLevel(specular, s, r, iblSpecularLevel(roughness)).rgb;
+ *     let brdf = textureSampleLevel(brdfLut, s, vec2f(nv, roughness), 0.0).rg;
+ *     let specular = prefiltered * (f0 * brdf.x + brdf.y);
+ *
+ * Typical use:
+ *     struct IblBaker * baker = iblBakerCreate(device, "cache");
+ *     struct IblEnvironment environment;
+ *     if (iblBakerLoad(baker, "autumn_park_4k.jpg", &environment)) {
+ *         // bind environment.specularView, baker->brdfLutView and
+ *         // environment.irradiance (in a uniform buffer)
+ *     }
+ *     iblEnvironmentRelease(&environment);
+ *     iblBakerRelease(baker);
+ */
+
+#ifndef _ibl_baker_h_
+#define _ibl_baker_h_
+
+#include <webgpu/webgpu.h>
+#include "mipmap-generator.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IBL_CACHE_MAGIC "WIBL"
+#define IBL_CACHE_VERSION 1
+#define IBL_CACHE_ALIGNMENT 256
+#define IBL_CACHE_EXTENSION ".wibl"
+#define IBL_BRDF_LUT_CACHE_NAME "brdf-lut.wibl"
+
+// Face size of level 0 of the specular cubemap, whose levels go down to 8
+#define IBL_SPECULAR_SIZE 256
+#define IBL_SPECULAR_LEVELS 6 // iblSpecularLevel of IBL_WGSL depends on it
+#define IBL_SPECULAR_SAMPLES 64
+// Level 1 of the environment is level 0 of the specular cubemap
+#define IBL_ENVIRONMENT_SIZE (2 * IBL_SPECULAR_SIZE)
+#define IBL_IRRADIANCE_SIZE 32
+#define IBL_SH_COEFFICIENTS 9
+#define IBL_BRDF_LUT_SIZE 256
+#define IBL_BRDF_LUT_SAMPLES 1024
+
+/**
+ * Evaluation of the results, to prepend to shaders using them.
+ * `irradiance` is IblEnvironment::irradiance, the returned value the
+ * diffuse radiance of a white Lambertian surface of normal `n`.
+ */
+#define IBL_WGSL "\
+fn iblIrradiance(sh: array<vec4f, 9>, n: vec3f) -> vec3f {\n\
+    return (sh[0] + sh[1] * n.y + sh[2] * n.z + sh[3] * n.x\n\
+        + sh[4] * (n.x * n.y) + sh[5] * (n.y * n.z) + sh[6] * (3.0 * n.z * n.z - 1.0)\n\
+        + sh[7] * (n.x * n.z) + sh[8] * (n.x * n.x - n.y * n.y)).rgb;\n\
+}\n\
+fn iblSpecularLevel(roughness: f32) -> f32 {\n\
+    return roughness * 5.0;\n\
+}\n\
+"
+
+struct IblCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceHash; // 0 for the BRDF LUT
+	// Settings the cache was baked with, 0 for what it does not hold
+	uint32_t specularSize;
+	uint32_t specularLevelCount;
+	uint32_t specularSampleCount;
+	uint32_t brdfLutSize;
+	uint32_t brdfLutSampleCount;
+	uint32_t reserved;
+	float irradiance[IBL_SH_COEFFICIENTS][4];
+	uint64_t dataOffset;
+	uint64_t dataSize;
+};
+
+struct IblEnvironment {
+	WGPUTexture specular; // RGBA16Float, 6 layers, IBL_SPECULAR_LEVELS levels
+	WGPUTextureView specularView; // Cube
+	// Irradiance divided by pi in the polynomial basis of iblIrradiance,
+	// as a WGSL array<vec4f, 9> (alpha unused)
+	float irradiance[IBL_SH_COEFFICIENTS][4];
+	uint64_t sourceHash;
+	bool baked; // false when loaded from its cache
+};
+
+struct IblPipeline {
+	WGPUBindGroupLayout layout;
+	WGPUComputePipeline pipeline;
+};
+
+struct IblBaker {
+	WGPUDevice device;
+	WGPUQueue queue;
+	char * cacheDirectory;
+	struct MipmapGenerator * mipmaps;
+	WGPUSampler sampler; // linear, repeating along U for equirectangular maps
+	WGPUBuffer paramsBuffer; // one slot per dispatch of a bake
+	struct IblPipeline equirectPipeline;
+	struct IblPipeline specularPipeline;
+	struct IblPipeline irradiancePipeline;
+	struct IblPipeline brdfLutPipeline;
+	WGPUTexture brdfLut; // RG16Float, NdotV along U, roughness along V
+	WGPUTextureView brdfLutView;
+};
+
+/**
+ * Create the pipelines, and load the BRDF LUT from `cacheDirectory`
+ * (which must exist, "." if NULL) or bake and cache it. Returns NULL if
+ * the LUT could not be baked.
+ */
+struct IblBaker * iblBakerCreate(WGPUDevice device, char const * cacheDirectory);
+
+/**
+ * Load the environment of the JPEG equirectangular map at `sourcePath`
+ * from its cache, or decode and bake it and write the cache, which blocks
+ * until the results are read back. Returns false and prints why on
+ * failure, with `environment` zeroed.
+ */
+bool iblBakerLoad(struct IblBaker * baker, char const * sourcePath, struct IblEnvironment * environment);
+
+/**
+ * Bake the environment of an RGBA8 equirectangular map, rows 4 * width
+ * bytes apart, sRGB encoded if `srgb`, without touching the cache.
+ * Blocks until the irradiance is read back.
+ */
+bool iblBakerBake(struct IblBaker * baker, uint8_t const * pixels, uint32_t width, uint32_t height, bool srgb, struct IblEnvironment * environment);
+
+void iblEnvironmentRelease(struct IblEnvironment * environment);
+
+void iblBakerRelease(struct IblBaker * baker);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _ibl_baker_h_
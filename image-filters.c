@@ -0,0 +1,507 @@
+#include "image-filters.h"
+#include "webgpu-utils.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TILE_SIZE 16
+
+// Must match struct Op and struct Stage in the shader
+struct StageOpUniform {
+	uint32_t kind;
+	uint32_t radius;
+	uint32_t _pad[2];
+	float params[4];
+	float weightsH[4 * ((IMAGE_FILTER_MAX_TAPS + 3) / 4)];
+	float weightsV[4 * ((IMAGE_FILTER_MAX_TAPS + 3) / 4)];
+};
+
+struct StageUniform {
+	uint32_t opCount;
+	uint32_t _pad[3];
+	struct StageOpUniform ops[IMAGE_FILTER_MAX_OPS_PER_STAGE];
+};
+
+static const char* imageFilterBindingsTemplate = "\
+@group(0) @binding(0) var src: texture_2d<f32>;\n\
+@group(0) @binding(1) var dst: texture_storage_2d<%s, write>;\n\
+";
+
+static const char* imageFilterShaderSource = "\
+struct Op {\n\
+    kind: u32,\n\
+    radius: u32,\n\
+    params: vec4f,\n\
+    weightsH: array<vec4f, 5>,\n\
+    weightsV: array<vec4f, 5>,\n\
+}\n\
+struct Stage {\n\
+    opCount: u32,\n\
+    ops: array<Op, 8>,\n\
+}\n\
+@group(0) @binding(2) var<uniform> stage: Stage;\n\
+\n\
+const TILE = 16u;\n\
+const HALO = 8u;\n\
+const SIZE = 32u;\n\
+const TEXELS_PER_THREAD = 4u;\n\
+\n\
+var<workgroup> tile: array<vec4f, 1024>;\n\
+\n\
+fn tileCoords(t: u32) -> vec2i {\n\
+    return vec2i(i32(t % SIZE), i32(t / SIZE));\n\
+}\n\
+\n\
+// One pass of a separable convolution over the whole tile. Texels near the\n\
+// tile edge read clamped neighbors and become wrong, which is why the halo\n\
+// must cover the sum of the radii of a stage.\n\
+fn convolve(lid: u32, o: u32, horizontal: bool) {\n\
+    let r = i32(stage.ops[o].radius);\n\
+    var results: array<vec4f, 4>;\n\
+    for (var k = 0u; k < TEXELS_PER_THREAD; k++) {\n\
+        let t = lid + k * 256u;\n\
+        let p = tileCoords(t);\n\
+        var sum = vec3f(0.0);\n\
+        for (var i = -r; i <= r; i++) {\n\
+            let j = u32(i + r);\n\
+            if (horizontal) {\n\
+                let q = clamp(p.x + i, 0, i32(SIZE) - 1) + p.y * i32(SIZE);\n\
+                sum += stage.ops[o].weightsH[j / 4u][j % 4u] * tile[q].rgb;\n\
+            } else {\n\
+                let q = p.x + clamp(p.y + i, 0, i32(SIZE) - 1) * i32(SIZE);\n\
+                sum += stage.ops[o].weightsV[j / 4u][j % 4u] * tile[q].rgb;\n\
+            }\n\
+        }\n\
+        results[k] = vec4f(sum, tile[t].a);\n\
+    }\n\
+    workgroupBarrier();\n\
+    for (var k = 0u; k < TEXELS_PER_THREAD; k++) {\n\
+        tile[lid + k * 256u] = results[k];\n\
+    }\n\
+    workgroupBarrier();\n\
+}\n\
+\n\
+// Replace texels outside of the image by the nearest texel inside, as if\n\
+// each filter was run separately with clamp-to-edge addressing.\n\
+fn clampToImage(lid: u32, origin: vec2i, imageSize: vec2i) {\n\
+    var results: array<vec4f, 4>;\n\
+    for (var k = 0u; k < TEXELS_PER_THREAD; k++) {\n\
+        let t = lid + k * 256u;\n\
+        let c = clamp(origin + tileCoords(t), vec2i(0), imageSize - 1) - origin;\n\
+        results[k] = tile[c.x + c.y * i32(SIZE)];\n\
+    }\n\
+    workgroupBarrier();\n\
+    for (var k = 0u; k < TEXELS_PER_THREAD; k++) {\n\
+        tile[lid + k * 256u] = results[k];\n\
+    }\n\
+    workgroupBarrier();\n\
+}\n\
+\n\
+fn pointwise(kind: u32, params: vec4f, c: vec4f) -> vec4f {\n\
+    switch kind {\n\
+        case 1u: { return vec4f(vec3f(dot(c.rgb, vec3f(0.2126, 0.7152, 0.0722))), c.a); }\n\
+        case 2u: { return vec4f(c.rgb * params.x + params.y, c.a); }\n\
+        case 3u: { return vec4f(abs(c.rgb), c.a); }\n\
+        default: { return c; }\n\
+    }\n\
+}\n\
+\n\
+@compute @workgroup_size(16, 16)\n\
+fn main(@builtin(workgroup_id) wid: vec3u, @builtin(local_invocation_index) lid: u32) {\n\
+    let imageSize = vec2i(textureDimensions(src, 0));\n\
+    let origin = vec2i(wid.xy * TILE) - vec2i(HALO);\n\
+    for (var k = 0u; k < TEXELS_PER_THREAD; k++) {\n\
+        let t = lid + k * 256u;\n\
+        let p = clamp(origin + tileCoords(t), vec2i(0), imageSize - 1);\n\
+        tile[t] = textureLoad(src, p, 0);\n\
+    }\n\
+    workgroupBarrier();\n\
+\n\
+    for (var o = 0u; o < stage.opCount; o++) {\n\
+        let kind = stage.ops[o].kind;\n\
+        if (kind == 0u) {\n\
+            convolve(lid, o, true);\n\
+            convolve(lid, o, false);\n\
+            clampToImage(lid, origin, imageSize);\n\
+        } else {\n\
+            for (var k = 0u; k < TEXELS_PER_THREAD; k++) {\n\
+                let t = lid + k * 256u;\n\
+                tile[t] = pointwise(kind, stage.ops[o].params, tile[t]);\n\
+            }\n\
+            workgroupBarrier();\n\
+        }\n\
+    }\n\
+\n\
+    let texel = vec2u(lid % TILE, lid / TILE);\n\
+    let p = vec2i(wid.xy * TILE + texel);\n\
+    if (all(p < imageSize)) {\n\
+        textureStore(dst, p, tile[(texel.y + HALO) * SIZE + texel.x + HALO]);\n\
+    }\n\
+}\n\
+";
+
+// Filter constructors
+
+static struct ImageFilter convolution(uint32_t radius) {
+	struct ImageFilter filter;
+	memset(&filter, 0, sizeof(filter));
+	filter.kind = ImageFilter_Convolution;
+	filter.radius = radius;
+	return filter;
+}
+
+struct ImageFilter imageFilterGaussian(float sigma) {
+	uint32_t radius = (uint32_t)ceilf(3.0f * sigma);
+	if (radius > IMAGE_FILTER_MAX_RADIUS) radius = IMAGE_FILTER_MAX_RADIUS;
+	if (radius < 1) radius = 1;
+	struct ImageFilter filter = convolution(radius);
+	float total = 0.0f;
+	for (uint32_t i = 0; i <= 2 * radius; ++i) {
+		float x = (float)i - (float)radius;
+		filter.weightsH[i] = expf(-x * x / (2.0f * sigma * sigma));
+		total += filter.weightsH[i];
+	}
+	for (uint32_t i = 0; i <= 2 * radius; ++i) {
+		filter.weightsH[i] /= total;
+		filter.weightsV[i] = filter.weightsH[i];
+	}
+	return filter;
+}
+
+struct ImageFilter imageFilterBox(uint32_t radius) {
+	if (radius > IMAGE_FILTER_MAX_RADIUS) radius = IMAGE_FILTER_MAX_RADIUS;
+	struct ImageFilter filter = convolution(radius);
+	for (uint32_t i = 0; i <= 2 * radius; ++i) {
+		filter.weightsH[i] = 1.0f / (float)(2 * radius + 1);
+		filter.weightsV[i] = filter.weightsH[i];
+	}
+	return filter;
+}
+
+// Sobel kernels are the outer product of a derivative and a smoothing
+// kernel, each normalized so that results stay within [-1, 1].
+
+struct ImageFilter imageFilterSobelX(void) {
+	struct ImageFilter filter = convolution(1);
+	float derivative[3] = { -0.5f, 0.0f, 0.5f };
+	float smoothing[3] = { 0.25f, 0.5f, 0.25f };
+	memcpy(filter.weightsH, derivative, sizeof(derivative));
+	memcpy(filter.weightsV, smoothing, sizeof(smoothing));
+	return filter;
+}
+
+struct ImageFilter imageFilterSobelY(void) {
+	struct ImageFilter filter = convolution(1);
+	float derivative[3] = { -0.5f, 0.0f, 0.5f };
+	float smoothing[3] = { 0.25f, 0.5f, 0.25f };
+	memcpy(filter.weightsH, smoothing, sizeof(smoothing));
+	memcpy(filter.weightsV, derivative, sizeof(derivative));
+	return filter;
+}
+
+struct ImageFilter imageFilterGrayscale(void) {
+	struct ImageFilter filter;
+	memset(&filter, 0, sizeof(filter));
+	filter.kind = ImageFilter_Grayscale;
+	return filter;
+}
+
+struct ImageFilter imageFilterScaleBias(float scale, float bias) {
+	struct ImageFilter filter;
+	memset(&filter, 0, sizeof(filter));
+	filter.kind = ImageFilter_ScaleBias;
+	filter.scale = scale;
+	filter.bias = bias;
+	return filter;
+}
+
+struct ImageFilter imageFilterAbs(void) {
+	struct ImageFilter filter;
+	memset(&filter, 0, sizeof(filter));
+	filter.kind = ImageFilter_Abs;
+	return filter;
+}
+
+// Pipeline
+
+static uint32_t stageSlotSize(void) {
+	return (uint32_t)alignUp(sizeof(struct StageUniform), 256);
+}
+
+static void createStagePipeline(struct ImageFilterPipeline * pipeline, int index, WGPUTextureFormat format, char const * wgslFormat) {
+	WGPUBindGroupLayoutEntry entries[3];
+	entries[0] = (WGPUBindGroupLayoutEntry) {};
+	entries[0].binding = 0;
+	entries[0].visibility = WGPUShaderStage_Compute;
+	entries[0].texture.sampleType = WGPUTextureSampleType_Float;
+	entries[0].texture.viewDimension = WGPUTextureViewDimension_2D;
+	entries[0].texture.multisampled = false;
+	entries[1] = (WGPUBindGroupLayoutEntry) {};
+	entries[1].binding = 1;
+	entries[1].visibility = WGPUShaderStage_Compute;
+	entries[1].storageTexture.access = WGPUStorageTextureAccess_WriteOnly;
+	entries[1].storageTexture.format = format;
+	entries[1].storageTexture.viewDimension = WGPUTextureViewDimension_2D;
+	entries[2] = bufferLayoutEntry(2, WGPUShaderStage_Compute, WGPUBufferBindingType_Uniform, true);
+
+	WGPUBindGroupLayoutDescriptor layoutDesc = (WGPUBindGroupLayoutDescriptor) {};
+	layoutDesc.nextInChain = NULL;
+	layoutDesc.label = "Image filter";
+	layoutDesc.entryCount = 3;
+	layoutDesc.entries = entries;
+	pipeline->layouts[index] = wgpuDeviceCreateBindGroupLayout(pipeline->device, &layoutDesc);
+
+	size_t sourceSize = strlen(imageFilterBindingsTemplate) + strlen(wgslFormat) + strlen(imageFilterShaderSource) + 1;
+	char * source = (char *)malloc(sourceSize);
+	int written = snprintf(source, sourceSize, imageFilterBindingsTemplate, wgslFormat);
+	memcpy(source + written, imageFilterShaderSource, strlen(imageFilterShaderSource) + 1);
+	WGPUShaderModule module = createWGSLShaderModule(pipeline->device, source, "Image filter");
+	WGPUPipelineLayout pipelineLayout = createSingleGroupPipelineLayout(pipeline->device, pipeline->layouts[index], "Image filter");
+	pipeline->pipelines[index] = createComputePipeline(pipeline->device, pipelineLayout, module, "main", "Image filter");
+	wgpuPipelineLayoutRelease(pipelineLayout);
+	wgpuShaderModuleRelease(module);
+	free(source);
+}
+
+struct ImageFilterPipeline * imageFilterPipelineCreate(WGPUDevice device, struct ImageFilter const * filters, uint32_t filterCount) {
+	// Group filters in stages fitting in the tile halo
+	struct StageUniform * stages = (struct StageUniform *)calloc(filterCount + 1, sizeof(struct StageUniform));
+	uint32_t stageCount = 1;
+	uint32_t haloUsed = 0;
+	for (uint32_t i = 0; i < filterCount; ++i) {
+		struct ImageFilter const * filter = &filters[i];
+		uint32_t radius = filter->kind == ImageFilter_Convolution ? filter->radius : 0;
+		if (radius > IMAGE_FILTER_MAX_RADIUS) {
+			fprintf(stderr, "Image filter %u has a radius of %u, more than the maximum of %d\n", i, radius, IMAGE_FILTER_MAX_RADIUS);
+			free(stages);
+			return NULL;
+		}
+		struct StageUniform * stage = &stages[stageCount - 1];
+		if (stage->opCount == IMAGE_FILTER_MAX_OPS_PER_STAGE || haloUsed + radius > IMAGE_FILTER_MAX_RADIUS) {
+			stage = &stages[stageCount++];
+			haloUsed = 0;
+		}
+		struct StageOpUniform * op = &stage->ops[stage->opCount++];
+		op->kind = (uint32_t)filter->kind;
+		op->radius = radius;
+		op->params[0] = filter->scale;
+		op->params[1] = filter->bias;
+		memcpy(op->weightsH, filter->weightsH, sizeof(filter->weightsH));
+		memcpy(op->weightsV, filter->weightsV, sizeof(filter->weightsV));
+		haloUsed += radius;
+	}
+
+	struct ImageFilterPipeline * pipeline = (struct ImageFilterPipeline *)calloc(1, sizeof(struct ImageFilterPipeline));
+	pipeline->device = device;
+	pipeline->queue = wgpuDeviceGetQueue(device);
+	pipeline->stageCount = stageCount;
+	createStagePipeline(pipeline, 0, WGPUTextureFormat_RGBA16Float, "rgba16float");
+	createStagePipeline(pipeline, 1, WGPUTextureFormat_RGBA8Unorm, "rgba8unorm");
+
+	uint32_t slotSize = stageSlotSize();
+	pipeline->stageBuffer = createBuffer(device, (uint64_t)stageCount * slotSize, WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst, "Image filter stages");
+	for (uint32_t s = 0; s < stageCount; ++s) {
+		wgpuQueueWriteBuffer(pipeline->queue, pipeline->stageBuffer, (uint64_t)s * slotSize, &stages[s], sizeof(struct StageUniform));
+	}
+	free(stages);
+
+	for (int i = 0; i < IMAGE_FILTER_SLOT_COUNT; ++i) {
+		pipeline->slots[i].pipeline = pipeline;
+	}
+	return pipeline;
+}
+
+static WGPUTexture createSlotTexture(WGPUDevice device, uint32_t width, uint32_t height, WGPUTextureFormat format, WGPUTextureUsageFlags usage, char const * label) {
+	WGPUTextureDescriptor textureDesc = (WGPUTextureDescriptor) {};
+	textureDesc.nextInChain = NULL;
+	textureDesc.label = label;
+	textureDesc.usage = usage;
+	textureDesc.dimension = WGPUTextureDimension_2D;
+	textureDesc.size = (WGPUExtent3D) { width, height, 1 };
+	textureDesc.format = format;
+	textureDesc.mipLevelCount = 1;
+	textureDesc.sampleCount = 1;
+	textureDesc.viewFormatCount = 0;
+	textureDesc.viewFormats = NULL;
+	return wgpuDeviceCreateTexture(device, &textureDesc);
+}
+
+static void releaseSlotResources(struct ImageFilterSlot * slot) {
+	if (slot->input) wgpuTextureRelease(slot->input);
+	for (int i = 0; i < 2; ++i) {
+		if (slot->intermediates[i]) wgpuTextureRelease(slot->intermediates[i]);
+	}
+	if (slot->output) wgpuTextureRelease(slot->output);
+	if (slot->readback) wgpuBufferRelease(slot->readback);
+	slot->input = NULL;
+	slot->intermediates[0] = slot->intermediates[1] = NULL;
+	slot->output = NULL;
+	slot->readback = NULL;
+}
+
+/**
+ * Make sure the textures of a slot match the size of the next image. Slots
+ * are reused as long as images keep the same size.
+ */
+static void prepareSlot(struct ImageFilterSlot * slot, uint32_t width, uint32_t height) {
+	if (slot->input && slot->width == width && slot->height == height) return;
+	WGPUDevice device = slot->pipeline->device;
+	releaseSlotResources(slot);
+	slot->width = width;
+	slot->height = height;
+	slot->input = createSlotTexture(device, width, height, WGPUTextureFormat_RGBA8Unorm, WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst, "Image filter input");
+	if (slot->pipeline->stageCount > 1) {
+		WGPUTextureUsageFlags usage = WGPUTextureUsage_TextureBinding | WGPUTextureUsage_StorageBinding;
+		slot->intermediates[0] = createSlotTexture(device, width, height, WGPUTextureFormat_RGBA16Float, usage, "Image filter intermediate");
+		if (slot->pipeline->stageCount > 2) {
+			slot->intermediates[1] = createSlotTexture(device, width, height, WGPUTextureFormat_RGBA16Float, usage, "Image filter intermediate");
+		}
+	}
+	slot->output = createSlotTexture(device, width, height, WGPUTextureFormat_RGBA8Unorm, WGPUTextureUsage_StorageBinding | WGPUTextureUsage_CopySrc, "Image filter output");
+	slot->bytesPerRow = (uint32_t)alignUp((uint64_t)width * 4, 256);
+	slot->readback = createBuffer(device, (uint64_t)slot->bytesPerRow * height, WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst, "Image filter readback");
+}
+
+static void onReadbackMapped(WGPUBufferMapAsyncStatus status, void * pUserData) {
+	struct ImageFilterSlot * slot = (struct ImageFilterSlot *)pUserData;
+	uint64_t size = (uint64_t)slot->bytesPerRow * slot->height;
+	uint8_t const * pixels = NULL;
+	if (status == WGPUBufferMapAsyncStatus_Success) {
+		pixels = (uint8_t const *)wgpuBufferGetConstMappedRange(slot->readback, 0, size);
+	} else {
+		fprintf(stderr, "Could not read back filtered image %u (status %d)\n", slot->imageIndex, status);
+		if (status == WGPUBufferMapAsyncStatus_DeviceLost) slot->pipeline->lost = true;
+	}
+	slot->callback(slot->userData, slot->imageIndex, pixels, slot->width, slot->height, slot->bytesPerRow);
+	if (pixels) wgpuBufferUnmap(slot->readback);
+	slot->busy = false;
+}
+
+/**
+ * Returns false if the device was lost, whose maps may never complete.
+ */
+static bool waitForSlot(struct ImageFilterSlot * slot) {
+	while (slot->busy) {
+		if (slot->pipeline->lost) return false;
+#ifdef WEBGPU_BACKEND_DAWN
+		wgpuDeviceTick(slot->pipeline->device);
+#endif
+	}
+	return !slot->pipeline->lost;
+}
+
+static void encodeStages(struct ImageFilterPipeline * pipeline, WGPUCommandEncoder encoder, struct ImageFilterSlot * slot) {
+	WGPUComputePassDescriptor passDesc = (WGPUComputePassDescriptor) {};
+	passDesc.nextInChain = NULL;
+	passDesc.label = "Image filter";
+	passDesc.timestampWriteCount = 0;
+	passDesc.timestampWrites = NULL;
+	WGPUComputePassEncoder pass = wgpuCommandEncoderBeginComputePass(encoder, &passDesc);
+
+	for (uint32_t s = 0; s < pipeline->stageCount; ++s) {
+		bool last = s + 1 == pipeline->stageCount;
+		WGPUTexture source = s == 0 ? slot->input : slot->intermediates[(s - 1) % 2];
+		WGPUTexture destination = last ? slot->output : slot->intermediates[s % 2];
+		WGPUTextureView sourceView = wgpuTextureCreateView(source, NULL);
+		WGPUTextureView destinationView = wgpuTextureCreateView(destination, NULL);
+
+		WGPUBindGroupEntry bindings[3];
+		bindings[0] = (WGPUBindGroupEntry) {};
+		bindings[0].binding = 0;
+		bindings[0].textureView = sourceView;
+		bindings[1] = (WGPUBindGroupEntry) {};
+		bindings[1].binding = 1;
+		bindings[1].textureView = destinationView;
+		bindings[2] = bufferBindGroupEntry(2, pipeline->stageBuffer, 0, sizeof(struct StageUniform));
+		WGPUBindGroupDescriptor bindGroupDesc = (WGPUBindGroupDescriptor) {};
+		bindGroupDesc.nextInChain = NULL;
+		bindGroupDesc.layout = pipeline->layouts[last ? 1 : 0];
+		bindGroupDesc.entryCount = 3;
+		bindGroupDesc.entries = bindings;
+		WGPUBindGroup bindGroup = wgpuDeviceCreateBindGroup(pipeline->device, &bindGroupDesc);
+
+		uint32_t stageOffset = s * stageSlotSize();
+		wgpuComputePassEncoderSetPipeline(pass, pipeline->pipelines[last ? 1 : 0]);
+		wgpuComputePassEncoderSetBindGroup(pass, 0, bindGroup, 1, &stageOffset);
+		wgpuComputePassEncoderDispatchWorkgroups(pass, (slot->width + TILE_SIZE - 1) / TILE_SIZE, (slot->height + TILE_SIZE - 1) / TILE_SIZE, 1);
+
+		wgpuBindGroupRelease(bindGroup);
+		wgpuTextureViewRelease(destinationView);
+		wgpuTextureViewRelease(sourceView);
+	}
+
+	wgpuComputePassEncoderEnd(pass);
+	wgpuComputePassEncoderRelease(pass);
+}
+
+bool imageFilterPipelineProcessBatch(struct ImageFilterPipeline * pipeline, struct ImageFilterImage const * images, uint32_t imageCount, ImageFilterCallback callback, void * userData) {
+	for (uint32_t i = 0; i < imageCount; ++i) {
+		struct ImageFilterImage const * image = &images[i];
+		// Only blocks when IMAGE_FILTER_SLOT_COUNT images are in flight
+		struct ImageFilterSlot * slot = &pipeline->slots[pipeline->nextSlot];
+		pipeline->nextSlot = (pipeline->nextSlot + 1) % IMAGE_FILTER_SLOT_COUNT;
+		if (!waitForSlot(slot)) return false;
+		prepareSlot(slot, image->width, image->height);
+		slot->imageIndex = i;
+		slot->callback = callback;
+		slot->userData = userData;
+
+		WGPUImageCopyTexture destination = (WGPUImageCopyTexture) {};
+		destination.texture = slot->input;
+		destination.mipLevel = 0;
+		destination.origin = (WGPUOrigin3D) { 0, 0, 0 };
+		destination.aspect = WGPUTextureAspect_All;
+		WGPUTextureDataLayout layout = (WGPUTextureDataLayout) {};
+		layout.offset = 0;
+		layout.bytesPerRow = 4 * image->width;
+		layout.rowsPerImage = image->height;
+		WGPUExtent3D size = { image->width, image->height, 1 };
+		wgpuQueueWriteTexture(pipeline->queue, &destination, image->pixels, (size_t)4 * image->width * image->height, &layout, &size);
+
+		WGPUCommandEncoderDescriptor encoderDesc = (WGPUCommandEncoderDescriptor) {};
+		encoderDesc.nextInChain = NULL;
+		encoderDesc.label = "Image filter";
+		WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(pipeline->device, &encoderDesc);
+		encodeStages(pipeline, encoder, slot);
+
+		WGPUImageCopyTexture source = (WGPUImageCopyTexture) {};
+		source.texture = slot->output;
+		source.mipLevel = 0;
+		source.origin = (WGPUOrigin3D) { 0, 0, 0 };
+		source.aspect = WGPUTextureAspect_All;
+		WGPUImageCopyBuffer readback = (WGPUImageCopyBuffer) {};
+		readback.buffer = slot->readback;
+		readback.layout.offset = 0;
+		readback.layout.bytesPerRow = slot->bytesPerRow;
+		readback.layout.rowsPerImage = slot->height;
+		wgpuCommandEncoderCopyTextureToBuffer(encoder, &source, &readback, &size);
+
+		WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, NULL);
+		wgpuQueueSubmit(pipeline->queue, 1, &command);
+		wgpuCommandBufferRelease(command);
+		wgpuCommandEncoderRelease(encoder);
+
+		slot->busy = true;
+		wgpuBufferMapAsync(slot->readback, WGPUMapMode_Read, 0, (size_t)slot->bytesPerRow * slot->height, onReadbackMapped, (void *)slot);
+	}
+	for (int i = 0; i < IMAGE_FILTER_SLOT_COUNT; ++i) {
+		if (!waitForSlot(&pipeline->slots[i])) return false;
+	}
+	return true;
+}
+
+void imageFilterPipelineRelease(struct ImageFilterPipeline * pipeline) {
+	if (!pipeline) return;
+	for (int i = 0; i < IMAGE_FILTER_SLOT_COUNT; ++i) {
+		releaseSlotResources(&pipeline->slots[i]);
+	}
+	wgpuBufferRelease(pipeline->stageBuffer);
+	for (int i = 0; i < 2; ++i) {
+		wgpuComputePipelineRelease(pipeline->pipelines[i]);
+		wgpuBindGroupLayoutRelease(pipeline->layouts[i]);
+	}
+	wgpuQueueRelease(pipeline->queue);
+	free(pipeline);
+}
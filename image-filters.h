@@ -0,0 +1,121 @@
+/**
+ * Tiled image filter pipeline.
+ *
+ * A pipeline applies a chain of filters to RGBA8 images: separable
+ * convolutions (Gaussian, box, Sobel, or any horizontal x vertical pair of
+ * 1D kernels) and per-pixel operations. Each workgroup loads a 32x32 tile
+ * (16x16 output texels plus an 8 texel halo) in workgroup memory once and
+ * runs as many filters of the chain on it as the halo allows, so a chain
+ * whose convolution radii add up to at most 8 runs in a single dispatch
+ * without intermediate texture traffic. Longer chains are split in stages
+ * whose intermediate results are kept in RGBA16Float textures, so signed
+ * results (e.g. Sobel) are only clamped when writing the final image.
+ *
+ * Batches of images go through a ring of slots so that uploading an image,
+ * filtering the previous one and reading back the one before overlap.
+ */
+
+#ifndef _image_filters_h_
+#define _image_filters_h_
+
+#include <webgpu/webgpu.h>
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IMAGE_FILTER_MAX_RADIUS 8
+#define IMAGE_FILTER_MAX_TAPS (2 * IMAGE_FILTER_MAX_RADIUS + 1)
+#define IMAGE_FILTER_MAX_OPS_PER_STAGE 8
+#define IMAGE_FILTER_SLOT_COUNT 3
+
+enum ImageFilterKind {
+	ImageFilter_Convolution,
+	ImageFilter_Grayscale,
+	ImageFilter_ScaleBias, // rgb * scale + bias
+	ImageFilter_Abs,
+};
+
+struct ImageFilter {
+	enum ImageFilterKind kind;
+	uint32_t radius;
+	float weightsH[IMAGE_FILTER_MAX_TAPS];
+	float weightsV[IMAGE_FILTER_MAX_TAPS];
+	float scale;
+	float bias;
+};
+
+struct ImageFilter imageFilterGaussian(float sigma);
+struct ImageFilter imageFilterBox(uint32_t radius);
+struct ImageFilter imageFilterSobelX(void);
+struct ImageFilter imageFilterSobelY(void);
+struct ImageFilter imageFilterGrayscale(void);
+struct ImageFilter imageFilterScaleBias(float scale, float bias);
+struct ImageFilter imageFilterAbs(void);
+
+/**
+ * A tightly packed RGBA8 image.
+ */
+struct ImageFilterImage {
+	uint32_t width;
+	uint32_t height;
+	uint8_t const * pixels;
+};
+
+/**
+ * Called with the filtered image, whose rows are `bytesPerRow` apart.
+ * `pixels` is only valid during the call, and NULL if reading back failed.
+ */
+typedef void (*ImageFilterCallback)(void * userData, uint32_t imageIndex, uint8_t const * pixels, uint32_t width, uint32_t height, uint32_t bytesPerRow);
+
+struct ImageFilterSlot {
+	struct ImageFilterPipeline * pipeline;
+	uint32_t width;
+	uint32_t height;
+	WGPUTexture input;
+	WGPUTexture intermediates[2];
+	WGPUTexture output;
+	WGPUBuffer readback;
+	uint32_t bytesPerRow;
+	bool busy;
+	uint32_t imageIndex;
+	ImageFilterCallback callback;
+	void * userData;
+};
+
+struct ImageFilterPipeline {
+	WGPUDevice device;
+	WGPUQueue queue;
+	// [0] writes RGBA16Float intermediates, [1] writes the RGBA8Unorm result
+	WGPUBindGroupLayout layouts[2];
+	WGPUComputePipeline pipelines[2];
+	WGPUBuffer stageBuffer;
+	uint32_t stageCount;
+	struct ImageFilterSlot slots[IMAGE_FILTER_SLOT_COUNT];
+	uint32_t nextSlot;
+	bool lost; // a readback reported the device lost
+};
+
+/**
+ * Compile a chain of filters, applied in order. Fails if a convolution has
+ * a radius larger than IMAGE_FILTER_MAX_RADIUS.
+ */
+struct ImageFilterPipeline * imageFilterPipelineCreate(WGPUDevice device, struct ImageFilter const * filters, uint32_t filterCount);
+
+/**
+ * Filter `imageCount` images. `callback` is called once for each of them
+ * before this returns. Returns false, skipping the remaining images, if
+ * the device is lost: recreate the pipeline on the recovered device (see
+ * device-recovery.h).
+ */
+bool imageFilterPipelineProcessBatch(struct ImageFilterPipeline * pipeline, struct ImageFilterImage const * images, uint32_t imageCount, ImageFilterCallback callback, void * userData);
+
+void imageFilterPipelineRelease(struct ImageFilterPipeline * pipeline);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _image_filters_h_
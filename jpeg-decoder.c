@@ -0,0 +1,572 @@
+#include "jpeg-decoder.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_COMPONENTS 3
+#define MAX_SAMPLING 4
+// Huffman codes up to this length are decoded with a single lookup
+#define FAST_BITS 9
+// Larger images are refused rather than risking overflows
+#define MAX_DIMENSION 32768
+
+// Markers
+#define MARKER_SOF0 0xc0
+#define MARKER_SOF1 0xc1
+#define MARKER_DHT 0xc4
+#define MARKER_RST0 0xd0
+#define MARKER_RST7 0xd7
+#define MARKER_SOI 0xd8
+#define MARKER_EOI 0xd9
+#define MARKER_SOS 0xda
+#define MARKER_DQT 0xdb
+#define MARKER_DRI 0xdd
+
+static uint8_t const zigzag[64] = {
+	0, 1, 8, 16, 9, 2, 3, 10,
+	17, 24, 32, 25, 18, 11, 4, 5,
+	12, 19, 26, 33, 40, 48, 41, 34,
+	27, 20, 13, 6, 7, 14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36,
+	29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46,
+	53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+struct HuffmanTable {
+	bool defined;
+	// Indexed by the next FAST_BITS bits: symbol and code length, 0 when
+	// the code is longer
+	uint8_t fastSymbols[1 << FAST_BITS];
+	uint8_t fastLengths[1 << FAST_BITS];
+	// Canonical decoding of longer codes, per code length
+	int32_t maxCode[18]; // -1 when there are no codes of that length
+	int32_t firstCode[17];
+	int32_t firstSymbol[17];
+	uint8_t symbols[256];
+};
+
+struct JpegComponent {
+	uint8_t id;
+	uint32_t h, v; // sampling factors
+	uint32_t quantTable;
+	uint32_t dcTable, acTable;
+	int32_t dcPredictor;
+	// Decoded samples, covering whole MCUs
+	uint8_t * plane;
+	uint32_t planeWidth, planeHeight;
+};
+
+struct BitReader {
+	uint8_t const * p;
+	uint8_t const * end;
+	uint32_t bits; // next bits in the high end
+	int32_t count;
+	// A marker ends the entropy-coded data; zeros are fed past it
+	bool atMarker;
+};
+
+struct Jpeg {
+	uint8_t const * p;
+	uint8_t const * end;
+	// Dequantization multipliers, in zigzag order, with the scaling of
+	// the AAN inverse DCT folded in
+	float quantTables[4][64];
+	bool quantDefined[4];
+	struct HuffmanTable dcTables[4];
+	struct HuffmanTable acTables[4];
+	uint32_t width, height;
+	uint32_t componentCount;
+	struct JpegComponent components[MAX_COMPONENTS];
+	uint32_t hMax, vMax;
+	uint32_t mcusX, mcusY;
+	uint32_t restartInterval;
+	bool frameRead;
+};
+
+// Parsing
+
+static uint32_t read16(uint8_t const * p) {
+	return ((uint32_t)p[0] << 8) | p[1];
+}
+
+/**
+ * Move to the next marker and return it, or 0 at the end of the data.
+ */
+static uint32_t nextMarker(struct Jpeg * jpeg) {
+	while (jpeg->p + 1 < jpeg->end) {
+		if (jpeg->p[0] == 0xff && jpeg->p[1] != 0x00 && jpeg->p[1] != 0xff) {
+			uint32_t marker = jpeg->p[1];
+			jpeg->p += 2;
+			return marker;
+		}
+		++jpeg->p;
+	}
+	return 0;
+}
+
+/**
+ * Payload of the segment at the current position, whose length field is
+ * included in its length. Returns NULL if it runs past the data.
+ */
+static uint8_t const * readSegment(struct Jpeg * jpeg, uint32_t * length) {
+	if (jpeg->end - jpeg->p < 2) return NULL;
+	uint32_t total = read16(jpeg->p);
+	if (total < 2 || (size_t)(jpeg->end - jpeg->p) < total) return NULL;
+	uint8_t const * payload = jpeg->p + 2;
+	*length = total - 2;
+	jpeg->p += total;
+	return payload;
+}
+
+static bool buildHuffmanTable(struct HuffmanTable * table, uint8_t const counts[16], uint8_t const * symbols, uint32_t symbolCount) {
+	memset(table, 0, sizeof(struct HuffmanTable));
+	memcpy(table->symbols, symbols, symbolCount);
+	int32_t code = 0;
+	uint32_t k = 0;
+	for (uint32_t length = 1; length <= 16; ++length) {
+		table->firstSymbol[length] = (int32_t)k;
+		table->firstCode[length] = code;
+		table->maxCode[length] = -1;
+		// Codes of a length must fit in that many bits, checked before
+		// they index the fast tables
+		if (code + counts[length - 1] > (1 << length)) return false;
+		for (uint32_t i = 0; i < counts[length - 1]; ++i, ++k, ++code) {
+			if (length <= FAST_BITS) {
+				uint32_t first = (uint32_t)code << (FAST_BITS - length);
+				for (uint32_t j = 0; j < (1u << (FAST_BITS - length)); ++j) {
+					table->fastSymbols[first + j] = symbols[k];
+					table->fastLengths[first + j] = (uint8_t)length;
+				}
+			}
+		}
+		if (counts[length - 1] > 0) table->maxCode[length] = code - 1;
+		code <<= 1;
+	}
+	table->maxCode[17] = INT32_MAX;
+	table->defined = true;
+	return true;
+}
+
+static bool readHuffmanTables(struct Jpeg * jpeg, uint8_t const * p, uint32_t length) {
+	uint8_t const * end = p + length;
+	while (p < end) {
+		if (end - p < 17) return false;
+		uint32_t tableClass = p[0] >> 4;
+		uint32_t id = p[0] & 15;
+		if (tableClass > 1 || id > 3) return false;
+		uint32_t symbolCount = 0;
+		for (uint32_t i = 0; i < 16; ++i) symbolCount += p[1 + i];
+		if (symbolCount > 256 || (size_t)(end - p) < 17 + symbolCount) return false;
+		struct HuffmanTable * table = tableClass == 0 ? &jpeg->dcTables[id] : &jpeg->acTables[id];
+		if (!buildHuffmanTable(table, p + 1, p + 17, symbolCount)) return false;
+		p += 17 + symbolCount;
+	}
+	return true;
+}
+
+static bool readQuantTables(struct Jpeg * jpeg, uint8_t const * p, uint32_t length) {
+	// Scale factors of the AAN inverse DCT, cos(k pi / 16) * sqrt(2) but 1 for k = 0
+	static float const aanScales[8] = {
+		1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
+		1.0f, 0.785694958f, 0.541196100f, 0.275899379f,
+	};
+	uint8_t const * end = p + length;
+	while (p < end) {
+		uint32_t precision = p[0] >> 4;
+		uint32_t id = p[0] & 15;
+		uint32_t size = precision ? 128 : 64;
+		if (id > 3 || precision > 1 || (size_t)(end - p) < 1 + size) return false;
+		for (uint32_t k = 0; k < 64; ++k) {
+			float q = precision ? (float)read16(p + 1 + 2 * k) : (float)p[1 + k];
+			uint32_t row = zigzag[k] / 8;
+			uint32_t column = zigzag[k] % 8;
+			jpeg->quantTables[id][k] = q * aanScales[row] * aanScales[column] * 0.125f;
+		}
+		jpeg->quantDefined[id] = true;
+		p += 1 + size;
+	}
+	return true;
+}
+
+static bool readFrame(struct Jpeg * jpeg, uint8_t const * p, uint32_t length) {
+	if (jpeg->frameRead || length < 6 || p[0] != 8) return false;
+	jpeg->height = read16(p + 1);
+	jpeg->width = read16(p + 3);
+	jpeg->componentCount = p[5];
+	// A height of 0 would be defined later by a DNL marker, not supported
+	if (jpeg->width == 0 || jpeg->height == 0 || jpeg->width > MAX_DIMENSION || jpeg->height > MAX_DIMENSION) return false;
+	if ((jpeg->componentCount != 1 && jpeg->componentCount != 3) || length < 6 + 3 * jpeg->componentCount) return false;
+	jpeg->hMax = 1;
+	jpeg->vMax = 1;
+	for (uint32_t i = 0; i < jpeg->componentCount; ++i) {
+		struct JpegComponent * component = &jpeg->components[i];
+		component->id = p[6 + 3 * i];
+		component->h = p[7 + 3 * i] >> 4;
+		component->v = p[7 + 3 * i] & 15;
+		component->quantTable = p[8 + 3 * i];
+		if (component->h == 0 || component->h > MAX_SAMPLING || component->v == 0 || component->v > MAX_SAMPLING || component->quantTable > 3) return false;
+		if (component->h > jpeg->hMax) jpeg->hMax = component->h;
+		if (component->v > jpeg->vMax) jpeg->vMax = component->v;
+	}
+	jpeg->mcusX = (jpeg->width + 8 * jpeg->hMax - 1) / (8 * jpeg->hMax);
+	jpeg->mcusY = (jpeg->height + 8 * jpeg->vMax - 1) / (8 * jpeg->vMax);
+	jpeg->frameRead = true;
+	return true;
+}
+
+/**
+ * Read the segments up to the frame header, which is all jpegReadSize
+ * needs, and the ones before the first scan go through the same path.
+ */
+static bool readHeaders(struct Jpeg * jpeg, bool untilScan) {
+	for (;;) {
+		uint32_t marker = nextMarker(jpeg);
+		if (marker == 0 || marker == MARKER_EOI) return false;
+		if (marker == MARKER_SOI || (marker >= MARKER_RST0 && marker <= MARKER_RST7)) continue;
+		if (marker == MARKER_SOS) {
+			// Back to the start of the scan, for decodeScan
+			jpeg->p -= 2;
+			return jpeg->frameRead;
+		}
+		uint32_t length;
+		uint8_t const * payload = readSegment(jpeg, &length);
+		if (!payload) return false;
+		bool ok = true;
+		switch (marker) {
+		case MARKER_SOF0:
+		case MARKER_SOF1:
+			ok = readFrame(jpeg, payload, length);
+			if (ok && !untilScan) return true;
+			break;
+		case MARKER_DHT:
+			ok = readHuffmanTables(jpeg, payload, length);
+			break;
+		case MARKER_DQT:
+			ok = readQuantTables(jpeg, payload, length);
+			break;
+		case MARKER_DRI:
+			ok = length >= 2;
+			if (ok) jpeg->restartInterval = read16(payload);
+			break;
+		default:
+			// Other frame types (progressive, lossless, arithmetic coding)
+			ok = !(marker >= 0xc0 && marker <= 0xcf && marker != MARKER_DHT && marker != 0xc8 && marker != 0xcc);
+			break;
+		}
+		if (!ok) return false;
+	}
+}
+
+// Entropy decoding
+
+static void fillBits(struct BitReader * reader) {
+	while (reader->count <= 24) {
+		uint32_t byte = 0;
+		if (!reader->atMarker && reader->p < reader->end) {
+			byte = reader->p[0];
+			if (byte == 0xff) {
+				uint32_t next = reader->p + 1 < reader->end ? reader->p[1] : 0;
+				if (next == 0x00) {
+					reader->p += 2;
+				} else {
+					reader->atMarker = true;
+					byte = 0;
+				}
+			} else {
+				++reader->p;
+			}
+		}
+		reader->bits |= byte << (24 - reader->count);
+		reader->count += 8;
+	}
+}
+
+static uint32_t readBits(struct BitReader * reader, uint32_t count) {
+	if (count == 0) return 0;
+	fillBits(reader);
+	uint32_t value = reader->bits >> (32 - count);
+	reader->bits <<= count;
+	reader->count -= (int32_t)count;
+	return value;
+}
+
+/**
+ * Value of a coefficient whose `count` magnitude bits follow.
+ */
+static int32_t readSigned(struct BitReader * reader, uint32_t count) {
+	if (count == 0) return 0;
+	int32_t value = (int32_t)readBits(reader, count);
+	return value < (1 << (count - 1)) ? value - (1 << count) + 1 : value;
+}
+
+static int32_t decodeSymbol(struct BitReader * reader, struct HuffmanTable const * table) {
+	fillBits(reader);
+	uint32_t fast = reader->bits >> (32 - FAST_BITS);
+	uint32_t length = table->fastLengths[fast];
+	if (length > 0) {
+		reader->bits <<= length;
+		reader->count -= (int32_t)length;
+		return table->fastSymbols[fast];
+	}
+	for (length = FAST_BITS + 1; length <= 16; ++length) {
+		int32_t code = (int32_t)(reader->bits >> (32 - length));
+		if (code <= table->maxCode[length]) {
+			reader->bits <<= length;
+			reader->count -= (int32_t)length;
+			int32_t index = table->firstSymbol[length] + code - table->firstCode[length];
+			return index >= 0 && index < 256 ? table->symbols[index] : -1;
+		}
+	}
+	return -1;
+}
+
+static bool decodeBlock(struct BitReader * reader, struct Jpeg const * jpeg, struct JpegComponent * component, float coefficients[64]) {
+	float const * quant = jpeg->quantTables[component->quantTable];
+	memset(coefficients, 0, 64 * sizeof(float));
+	int32_t size = decodeSymbol(reader, &jpeg->dcTables[component->dcTable]);
+	if (size < 0 || size > 11) return false;
+	component->dcPredictor += readSigned(reader, (uint32_t)size);
+	coefficients[0] = (float)component->dcPredictor * quant[0];
+	for (uint32_t k = 1; k < 64;) {
+		int32_t symbol = decodeSymbol(reader, &jpeg->acTables[component->acTable]);
+		if (symbol < 0) return false;
+		uint32_t run = (uint32_t)symbol >> 4;
+		uint32_t bits = (uint32_t)symbol & 15;
+		if (bits == 0) {
+			if (run != 15) break; // end of block
+			k += 16;
+			continue;
+		}
+		k += run;
+		if (k > 63) return false;
+		coefficients[zigzag[k]] = (float)readSigned(reader, bits) * quant[k];
+		++k;
+	}
+	return true;
+}
+
+static uint8_t clampSample(float value) {
+	int32_t i = (int32_t)(value + 128.5f);
+	return (uint8_t)(i < 0 ? 0 : i > 255 ? 255 : i);
+}
+
+/**
+ * AAN inverse DCT (as in libjpeg's jidctflt.c), of coefficients whose
+ * dequantization already applied its scale factors.
+ */
+static void inverseDct(float coefficients[64], uint8_t * out, uint32_t outStride) {
+	float * w = coefficients;
+	for (uint32_t pass = 0; pass < 2; ++pass) {
+		// Columns, then rows, in place
+		uint32_t step = pass == 0 ? 8 : 1;
+		uint32_t next = pass == 0 ? 1 : 8;
+		for (uint32_t i = 0; i < 8; ++i) {
+			float * c = w + i * next;
+			float tmp10 = c[0] + c[4 * step];
+			float tmp11 = c[0] - c[4 * step];
+			float tmp13 = c[2 * step] + c[6 * step];
+			float tmp12 = (c[2 * step] - c[6 * step]) * 1.414213562f - tmp13;
+			float tmp0 = tmp10 + tmp13;
+			float tmp3 = tmp10 - tmp13;
+			float tmp1 = tmp11 + tmp12;
+			float tmp2 = tmp11 - tmp12;
+
+			float z13 = c[5 * step] + c[3 * step];
+			float z10 = c[5 * step] - c[3 * step];
+			float z11 = c[1 * step] + c[7 * step];
+			float z12 = c[1 * step] - c[7 * step];
+			float tmp7 = z11 + z13;
+			tmp11 = (z11 - z13) * 1.414213562f;
+			float z5 = (z10 + z12) * 1.847759065f;
+			tmp10 = 1.082392200f * z12 - z5;
+			tmp12 = -2.613125930f * z10 + z5;
+			float tmp6 = tmp12 - tmp7;
+			float tmp5 = tmp11 - tmp6;
+			float tmp4 = tmp10 + tmp5;
+
+			c[0] = tmp0 + tmp7;
+			c[7 * step] = tmp0 - tmp7;
+			c[1 * step] = tmp1 + tmp6;
+			c[6 * step] = tmp1 - tmp6;
+			c[2 * step] = tmp2 + tmp5;
+			c[5 * step] = tmp2 - tmp5;
+			c[4 * step] = tmp3 + tmp4;
+			c[3 * step] = tmp3 - tmp4;
+		}
+	}
+	for (uint32_t y = 0; y < 8; ++y) {
+		for (uint32_t x = 0; x < 8; ++x) {
+			out[y * outStride + x] = clampSample(w[y * 8 + x]);
+		}
+	}
+}
+
+/**
+ * Skip to the restart marker expected after `restartInterval` MCUs and
+ * reset the decoder state it delimits.
+ */
+static bool restart(struct BitReader * reader, struct Jpeg * jpeg) {
+	if (!reader->atMarker) {
+		// Padding bits ran short of the marker: look for it
+		while (reader->p + 1 < reader->end && !(reader->p[0] == 0xff && reader->p[1] >= MARKER_RST0 && reader->p[1] <= MARKER_RST7)) ++reader->p;
+	}
+	if (reader->p + 1 >= reader->end || reader->p[1] < MARKER_RST0 || reader->p[1] > MARKER_RST7) return false;
+	reader->p += 2;
+	reader->bits = 0;
+	reader->count = 0;
+	reader->atMarker = false;
+	for (uint32_t i = 0; i < jpeg->componentCount; ++i) jpeg->components[i].dcPredictor = 0;
+	return true;
+}
+
+static bool decodeScan(struct Jpeg * jpeg) {
+	if (nextMarker(jpeg) != MARKER_SOS) return false;
+	uint32_t length;
+	uint8_t const * p = readSegment(jpeg, &length);
+	if (!p || length < 1) return false;
+	uint32_t scanCount = p[0];
+	if (scanCount == 0 || scanCount > jpeg->componentCount || length < 4 + 2 * scanCount) return false;
+	struct JpegComponent * scanComponents[MAX_COMPONENTS];
+	for (uint32_t i = 0; i < scanCount; ++i) {
+		scanComponents[i] = NULL;
+		for (uint32_t c = 0; c < jpeg->componentCount; ++c) {
+			if (jpeg->components[c].id == p[1 + 2 * i]) scanComponents[i] = &jpeg->components[c];
+		}
+		if (!scanComponents[i]) return false;
+		scanComponents[i]->dcTable = p[2 + 2 * i] >> 4;
+		scanComponents[i]->acTable = p[2 + 2 * i] & 15;
+		if (scanComponents[i]->dcTable > 3 || scanComponents[i]->acTable > 3) return false;
+		if (!jpeg->dcTables[scanComponents[i]->dcTable].defined || !jpeg->acTables[scanComponents[i]->acTable].defined) return false;
+		if (!jpeg->quantDefined[scanComponents[i]->quantTable]) return false;
+		scanComponents[i]->dcPredictor = 0;
+	}
+
+	struct BitReader reader = (struct BitReader) { jpeg->p, jpeg->end, 0, 0, false };
+	float coefficients[64];
+	// A scan of a single component is made of its blocks in raster
+	// order, as many as cover the component, not of whole MCUs
+	bool interleaved = scanCount > 1;
+	uint32_t unitsX = jpeg->mcusX;
+	uint32_t unitsY = jpeg->mcusY;
+	if (!interleaved) {
+		struct JpegComponent const * c = scanComponents[0];
+		uint32_t componentWidth = (jpeg->width * c->h + jpeg->hMax - 1) / jpeg->hMax;
+		uint32_t componentHeight = (jpeg->height * c->v + jpeg->vMax - 1) / jpeg->vMax;
+		unitsX = (componentWidth + 7) / 8;
+		unitsY = (componentHeight + 7) / 8;
+	}
+	uint32_t untilRestart = jpeg->restartInterval;
+	for (uint32_t uy = 0; uy < unitsY; ++uy) {
+		for (uint32_t ux = 0; ux < unitsX; ++ux) {
+			if (jpeg->restartInterval > 0) {
+				if (untilRestart == 0) {
+					if (!restart(&reader, jpeg)) return false;
+					untilRestart = jpeg->restartInterval;
+				}
+				--untilRestart;
+			}
+			for (uint32_t i = 0; i < scanCount; ++i) {
+				struct JpegComponent * c = scanComponents[i];
+				uint32_t blocksX = interleaved ? c->h : 1;
+				uint32_t blocksY = interleaved ? c->v : 1;
+				for (uint32_t by = 0; by < blocksY; ++by) {
+					for (uint32_t bx = 0; bx < blocksX; ++bx) {
+						if (!decodeBlock(&reader, jpeg, c, coefficients)) return false;
+						uint32_t x = 8 * (ux * blocksX + bx);
+						uint32_t y = 8 * (uy * blocksY + by);
+						inverseDct(coefficients, c->plane + (size_t)y * c->planeWidth + x, c->planeWidth);
+					}
+				}
+			}
+		}
+	}
+	// Continue after the entropy-coded data
+	jpeg->p = reader.p;
+	return true;
+}
+
+// Color conversion
+
+static uint8_t clampByte(int32_t value) {
+	return (uint8_t)(value < 0 ? 0 : value > 255 ? 255 : value);
+}
+
+static void convertToRgba(struct Jpeg const * jpeg, uint8_t * pixels) {
+	struct JpegComponent const * c = jpeg->components;
+	for (uint32_t y = 0; y < jpeg->height; ++y) {
+		uint8_t * out = pixels + (size_t)y * jpeg->width * 4;
+		uint8_t const * rows[MAX_COMPONENTS];
+		for (uint32_t i = 0; i < jpeg->componentCount; ++i) {
+			rows[i] = c[i].plane + (size_t)(y * c[i].v / jpeg->vMax) * c[i].planeWidth;
+		}
+		if (jpeg->componentCount == 1) {
+			for (uint32_t x = 0; x < jpeg->width; ++x) {
+				uint8_t gray = rows[0][x * c[0].h / jpeg->hMax];
+				out[4 * x + 0] = gray;
+				out[4 * x + 1] = gray;
+				out[4 * x + 2] = gray;
+				out[4 * x + 3] = 255;
+			}
+			continue;
+		}
+		for (uint32_t x = 0; x < jpeg->width; ++x) {
+			// JFIF YCbCr, in 16.16 fixed point
+			int32_t luma = (int32_t)rows[0][x * c[0].h / jpeg->hMax] << 16;
+			int32_t cb = (int32_t)rows[1][x * c[1].h / jpeg->hMax] - 128;
+			int32_t cr = (int32_t)rows[2][x * c[2].h / jpeg->hMax] - 128;
+			out[4 * x + 0] = clampByte((luma + 91881 * cr + 32768) >> 16);
+			out[4 * x + 1] = clampByte((luma - 22554 * cb - 46802 * cr + 32768) >> 16);
+			out[4 * x + 2] = clampByte((luma + 116130 * cb + 32768) >> 16);
+			out[4 * x + 3] = 255;
+		}
+	}
+}
+
+// Public API
+
+bool jpegReadSize(void const * data, size_t size, uint32_t * width, uint32_t * height) {
+	struct Jpeg jpeg = (struct Jpeg) {};
+	jpeg.p = (uint8_t const *)data;
+	jpeg.end = jpeg.p + size;
+	if (size < 2 || jpeg.p[0] != 0xff || jpeg.p[1] != MARKER_SOI) return false;
+	if (!readHeaders(&jpeg, false)) return false;
+	*width = jpeg.width;
+	*height = jpeg.height;
+	return true;
+}
+
+uint8_t * jpegDecode(void const * data, size_t size, uint32_t * width, uint32_t * height) {
+	struct Jpeg * jpeg = (struct Jpeg *)calloc(1, sizeof(struct Jpeg));
+	if (!jpeg) return NULL;
+	jpeg->p = (uint8_t const *)data;
+	jpeg->end = jpeg->p + size;
+	uint8_t * pixels = NULL;
+	bool ok = size >= 2 && jpeg->p[0] == 0xff && jpeg->p[1] == MARKER_SOI && readHeaders(jpeg, true);
+	for (uint32_t i = 0; ok && i < jpeg->componentCount; ++i) {
+		struct JpegComponent * c = &jpeg->components[i];
+		c->planeWidth = jpeg->mcusX * c->h * 8;
+		c->planeHeight = jpeg->mcusY * c->v * 8;
+		c->plane = (uint8_t *)calloc((size_t)c->planeWidth * c->planeHeight, 1);
+		ok = c->plane != NULL;
+	}
+	// Scans follow each other, possibly with tables in between, until EOI
+	bool decoded = false;
+	while (ok) {
+		ok = decodeScan(jpeg);
+		decoded = decoded || ok;
+		if (!ok) break;
+		ok = readHeaders(jpeg, true);
+	}
+	if (decoded) {
+		pixels = (uint8_t *)malloc((size_t)jpeg->width * jpeg->height * 4);
+		if (pixels) {
+			convertToRgba(jpeg, pixels);
+			*width = jpeg->width;
+			*height = jpeg->height;
+		}
+	}
+	for (uint32_t i = 0; i < jpeg->componentCount; ++i) free(jpeg->components[i].plane);
+	free(jpeg);
+	return pixels;
+}
@@ -0,0 +1,47 @@
+/**
+ * Baseline JPEG decoder, for the textures of the tutorial (photos and
+ * environment maps) and the texture streamer (see texture-streamer.h).
+ *
+ * Decodes sequential Huffman-coded 8-bit files (SOF0 and SOF1), gray or
+ * YCbCr with any chroma subsampling, with or without restart markers, to
+ * RGBA8 (alpha 255). Progressive and arithmetic-coded files are refused;
+ * chroma is upsampled by replication. The decoder holds no global state,
+ * so any number of threads can decode at once.
+ *
+ * Typical use:
+ *     struct MappedFile * file = mappedFileOpen("autumn_park_4k.jpg");
+ *     uint32_t width, height;
+ *     uint8_t * pixels = jpegDecode(file->data, file->size, &width, &height);
+ *     mappedFileClose(file);
+ *     // upload pixels, rows 4 * width bytes apart
+ *     free(pixels);
+ */
+
+#ifndef _jpeg_decoder_h_
+#define _jpeg_decoder_h_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Read the size of the image from the frame header, without decoding.
+ * Returns false if `data` is not a JPEG file this decoder supports.
+ */
+bool jpegReadSize(void const * data, size_t size, uint32_t * width, uint32_t * height);
+
+/**
+ * Decode a JPEG file held in memory to RGBA8. Returns the pixels, to
+ * free, or NULL if the file is invalid, unsupported or memory runs out.
+ */
+uint8_t * jpegDecode(void const * data, size_t size, uint32_t * width, uint32_t * height);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _jpeg_decoder_h_
@@ -0,0 +1,162 @@
+#include "lz4-block.h"
+
+#include <string.h>
+
+#define MIN_MATCH 4
+#define LAST_LITERALS 5 // the last bytes of a block are always literals
+#define MATCH_FIND_LIMIT 12 // and its last match starts before them
+#define MAX_OFFSET 65535
+#define MAX_INPUT_SIZE 0x7E000000 // as the reference implementation
+#define HASH_BITS 12 // 16 KB of table, on the stack
+#define SKIP_TRIGGER 6 // misses before the search step grows
+
+static inline uint32_t read32(uint8_t const * p) {
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static inline uint32_t hashSequence(uint32_t sequence) {
+	return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/**
+ * Write the bytes that extend a length whose 4 bits in the token are
+ * saturated.
+ */
+static inline uint8_t * writeLength(uint8_t * out, size_t length) {
+	for (; length >= 255; length -= 255) *out++ = 255;
+	*out++ = (uint8_t)length;
+	return out;
+}
+
+// Bytes that writeLength writes for a length saturating 4 bits from 15
+static inline size_t lengthSize(size_t length) {
+	return length >= 15 ? (length - 15) / 255 + 1 : 0;
+}
+
+static inline bool readLength(uint8_t const ** in, uint8_t const * end, size_t * length) {
+	uint8_t byte;
+	do {
+		if (*in >= end) return false;
+		byte = *(*in)++;
+		*length += byte;
+	} while (byte == 255);
+	return true;
+}
+
+size_t lz4BlockBound(size_t size) {
+	return size + size / 255 + 16;
+}
+
+// Compression
+
+size_t lz4BlockCompress(void const * source, size_t size, void * destination, size_t capacity) {
+	if (size == 0 || size > MAX_INPUT_SIZE) return 0;
+	uint8_t const * in = (uint8_t const *)source;
+	uint8_t const * end = in + size;
+	uint8_t const * anchor = in; // start of the pending literals
+	uint8_t * out = (uint8_t *)destination;
+	uint8_t * outEnd = out + capacity;
+
+	if (size > MATCH_FIND_LIMIT) {
+		uint8_t const * matchStartLimit = end - MATCH_FIND_LIMIT;
+		uint8_t const * matchEndLimit = end - LAST_LITERALS;
+		// Offsets from `in` of the last position of each hashed sequence,
+		// 0 for none, which at worst is a position that does not match
+		uint32_t table[1 << HASH_BITS];
+		memset(table, 0, sizeof(table));
+		uint8_t const * ip = in + 1;
+
+		for (;;) {
+			// Find a match, stepping faster the longer nothing matches
+			uint8_t const * match;
+			uint32_t attempts = 1 << SKIP_TRIGGER;
+			for (;;) {
+				if (ip > matchStartLimit) goto lastLiterals;
+				uint32_t hash = hashSequence(read32(ip));
+				match = in + table[hash];
+				table[hash] = (uint32_t)(ip - in);
+				if (match < ip && ip - match <= MAX_OFFSET && read32(match) == read32(ip)) break;
+				ip += attempts++ >> SKIP_TRIGGER;
+			}
+			while (ip > anchor && match > in && ip[-1] == match[-1]) {
+				--ip;
+				--match;
+			}
+			size_t length = MIN_MATCH;
+			while (ip + length < matchEndLimit && ip[length] == match[length]) ++length;
+
+			size_t literalCount = (size_t)(ip - anchor);
+			size_t sequenceSize = 1 + lengthSize(literalCount) + literalCount + 2 + lengthSize(length - MIN_MATCH);
+			if (sequenceSize > (size_t)(outEnd - out)) return 0;
+			uint8_t * token = out++;
+			*token = (uint8_t)((literalCount < 15 ? literalCount : 15) << 4);
+			if (literalCount >= 15) out = writeLength(out, literalCount - 15);
+			memcpy(out, anchor, literalCount);
+			out += literalCount;
+			uint32_t offset = (uint32_t)(ip - match);
+			*out++ = (uint8_t)offset;
+			*out++ = (uint8_t)(offset >> 8);
+			size_t matchLength = length - MIN_MATCH;
+			*token |= (uint8_t)(matchLength < 15 ? matchLength : 15);
+			if (matchLength >= 15) out = writeLength(out, matchLength - 15);
+
+			ip += length;
+			anchor = ip;
+			if (ip > matchStartLimit) break;
+			// Keep the table fresh past the match, which was not hashed
+			table[hashSequence(read32(ip - 2))] = (uint32_t)(ip - 2 - in);
+		}
+	}
+
+lastLiterals:;
+	size_t literalCount = (size_t)(end - anchor);
+	if (1 + lengthSize(literalCount) + literalCount > (size_t)(outEnd - out)) return 0;
+	*out++ = (uint8_t)((literalCount < 15 ? literalCount : 15) << 4);
+	if (literalCount >= 15) out = writeLength(out, literalCount - 15);
+	memcpy(out, anchor, literalCount);
+	out += literalCount;
+	return (size_t)(out - (uint8_t *)destination);
+}
+
+// Decompression
+
+bool lz4BlockDecompress(void const * source, size_t size, void * destination, size_t decompressedSize) {
+	uint8_t const * in = (uint8_t const *)source;
+	uint8_t const * inEnd = in + size;
+	uint8_t * start = (uint8_t *)destination;
+	uint8_t * out = start;
+	uint8_t * outEnd = out + decompressedSize;
+
+	for (;;) {
+		if (in >= inEnd) return false;
+		uint8_t token = *in++;
+
+		size_t literalCount = token >> 4;
+		if (literalCount == 15 && !readLength(&in, inEnd, &literalCount)) return false;
+		if (literalCount > (size_t)(inEnd - in) || literalCount > (size_t)(outEnd - out)) return false;
+		memcpy(out, in, literalCount);
+		in += literalCount;
+		out += literalCount;
+		// The last sequence has no match
+		if (in == inEnd) return out == outEnd;
+
+		if (inEnd - in < 2) return false;
+		size_t offset = (size_t)in[0] | (size_t)in[1] << 8;
+		in += 2;
+		if (offset == 0 || offset > (size_t)(out - start)) return false;
+		size_t length = token & 15;
+		if (length == 15 && !readLength(&in, inEnd, &length)) return false;
+		length += MIN_MATCH;
+		if (length > (size_t)(outEnd - out)) return false;
+		// Copies of at most `offset` bytes never overlap, and repeat the
+		// last `offset` bytes when the match is longer than that
+		while (length > 0) {
+			size_t chunk = length < offset ? length : offset;
+			memcpy(out, out - offset, chunk);
+			out += chunk;
+			length -= chunk;
+		}
+	}
+}
@@ -0,0 +1,56 @@
+/**
+ * Compression and decompression of data in the LZ4 block format, so that
+ * text assets (such as the OBJ meshes of the tutorial) take less room in
+ * asset archives (see asset-archive.h) while decompressing at several
+ * GB/s, and so that the blocks can be read by any LZ4 implementation.
+ *
+ * A block is a sequence of commands, each a run of literal bytes followed
+ * by a copy of at least 4 bytes from up to 65535 bytes back; the last one
+ * only has literals. Compression is greedy, finding matches with a hash
+ * table of the 4-byte sequences seen so far, and skips faster through
+ * data that does not compress, so that already compressed files (JPEGs,
+ * zips) cost little to try.
+ *
+ * Typical use:
+ *     uint8_t * packed = (uint8_t *)malloc(lz4BlockBound(size));
+ *     size_t packedSize = lz4BlockCompress(data, size, packed, lz4BlockBound(size));
+ *     ...
+ *     lz4BlockDecompress(packed, packedSize, data, size);
+ */
+
+#ifndef _lz4_block_h_
+#define _lz4_block_h_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Largest compressed size of `size` bytes, for which lz4BlockCompress
+ * never fails.
+ */
+size_t lz4BlockBound(size_t size);
+
+/**
+ * Compress `size` bytes of `source` into `destination`. Returns the size
+ * of the block, or 0 if it does not fit in `capacity` bytes (or if `size`
+ * is 0).
+ */
+size_t lz4BlockCompress(void const * source, size_t size, void * destination, size_t capacity);
+
+/**
+ * Decompress the block of `size` bytes at `source`, which must produce
+ * exactly `decompressedSize` bytes. Returns false if the block is invalid,
+ * without ever reading or writing out of bounds.
+ */
+bool lz4BlockDecompress(void const * source, size_t size, void * destination, size_t decompressedSize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _lz4_block_h_
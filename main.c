@@ -1,102 +1,36 @@
 #include <GLFW/glfw3.h>
 #include <webgpu/webgpu.h>
 #include <glfw3webgpu.h>
+#include "device-creation.h"
+#include "device-recovery.h"
+#include "submit-scheduler.h"
+#include "video-capture.h"
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
-
-// A simple structure holding the local information shared with the
-// onAdapterRequestEnded callback.
-struct AdapterUserData {
-	WGPUAdapter adapter;
-	bool requestEnded;
-};
-
-void onAdapterRequestEnded(WGPURequestAdapterStatus status, WGPUAdapter adapter, char const * message, void * pUserData) {
-	struct AdapterUserData * userData = (struct AdapterUserData*)(pUserData);
-	if (status == WGPURequestAdapterStatus_Success) {
-		userData->adapter = adapter;
-	} else {
-        printf("Could not get WebGPU adapter: %s\n", message);
-	}
-	userData->requestEnded = true;
-}
-
-/**
- * Utility function to get a WebGPU adapter, so that
- *     WGPUAdapter adapter = requestAdapter(options);
- * is roughly equivalent to
- *     const adapter = await navigator.gpu.requestAdapter(options);
- */
-WGPUAdapter requestAdapter(WGPUInstance instance, WGPURequestAdapterOptions const * options) {
-    struct AdapterUserData userData;
-
-    // Call to the WebGPU request adapter procedure
-    wgpuInstanceRequestAdapter(
-        instance /* equivalent of navigator.gpu */,
-        options,
-        onAdapterRequestEnded,
-        (void*)&userData
-    );
-
-    // In theory we should wait until onAdapterReady has been called, which
-    // could take some time (what the 'await' keyword does in the JavaScript
-    // code). In practice, we know that when the wgpuInstanceRequestAdapter()
-    // function returns its callback has been called.
-    assert(userData.requestEnded);
-
-    return userData.adapter;
-}
-
-struct DeviceUserData {
-	WGPUDevice device;
-	bool requestEnded;
-};
-
-void onDeviceError(WGPUErrorType type, char const* message, void* pUserData) {
-    printf("Uncaptured device error: type %u", type);
-    if (message) printf(" (%s)", message);
-    printf("\n");
-}
-
-void onDeviceRequestEnded(WGPURequestDeviceStatus status, WGPUDevice device, char const * message, void * pUserData) { 
-	struct DeviceUserData * userData = (struct DeviceUserData*)(pUserData);
-	if (status == WGPURequestDeviceStatus_Success) {
-		userData->device = device;
-		wgpuDeviceSetUncapturedErrorCallback(device, onDeviceError, NULL /* pUserData */);
-	} else {
-        printf("Could not get WebGPU device: %s\n", message);
-	}
-	userData->requestEnded = true;
-}
-
-/**
- * Utility function to get a WebGPU device, so that
- *     WGPUAdapter device = requestDevice(adapter, options);
- * is roughly equivalent to
- *     const device = await adapter.requestDevice(descriptor);
- * It is very similar to requestAdapter
- */
-WGPUDevice requestDevice(WGPUAdapter adapter, WGPUDeviceDescriptor const * descriptor) {
-    struct DeviceUserData userData;
-
-    wgpuAdapterRequestDevice(
-        adapter,
-        descriptor,
-        onDeviceRequestEnded,
-        (void*)&userData
-    );
-
-    assert(userData.requestEnded);
-
-    return userData.device;
-}
+#include <string.h>
 
 void onQueueWorkDone(WGPUQueueWorkDoneStatus status, void* pUserData) {
     printf("Queued work finished with status: %d\n", status);
 }
 
 int main (int argc, char** argv) {
+	// Validation profile, e.g. `App --device-profile production`
+	enum DeviceProfile profile = DEVICE_PROFILE_DEFAULT;
+	// Video capture of every frame, e.g. `App --capture session.y4m`
+	char const * capturePath = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--device-profile") == 0 && i + 1 < argc) {
+			if (!deviceProfileFromName(argv[++i], &profile)) {
+				fprintf(stderr, "Unknown device profile '%s'\n", argv[i]);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+			capturePath = argv[++i];
+		}
+	}
+	printf("Device profile: %s\n", deviceProfileName(profile));
+
     glfwInit();
 
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
@@ -114,14 +48,7 @@ int main (int argc, char** argv) {
 	WGPUAdapter adapter = requestAdapter(instance, &adapterOpts);
     printf("Got adapter: %p\n", (void*)adapter);
 
-	WGPUDeviceDescriptor deviceDesc = (WGPUDeviceDescriptor) {};
-	deviceDesc.nextInChain = NULL;
-	deviceDesc.label = "My Device"; // anything works here, that's your call
-	deviceDesc.requiredFeaturesCount = 0; // we do not require any specific feature
-	deviceDesc.requiredLimits = NULL; // we do not require any specific limit
-	deviceDesc.defaultQueue.nextInChain = NULL;
-	deviceDesc.defaultQueue.label = "The default queue";
-	WGPUDevice device = requestDevice(adapter, &deviceDesc);
+	WGPUDevice device = createDeviceWithProfile(adapter, profile, "My Device");
     printf("Got device: %p\n", (void*)adapter);
 
 	WGPUFeatureName * features;
@@ -134,12 +61,18 @@ int main (int argc, char** argv) {
 	}
     free(features);
 
+	// Resources created through `recovery` are recreated if the device is lost
+	struct DeviceRecovery * recovery = deviceRecoveryCreate(instance, adapter, surface, device, profile);
+
 	WGPUQueue queue = wgpuDeviceGetQueue(device);
 	// why does below give status 3 at the end of the program?
 	// maybe something to do with the fact that we must provide the extra status
 	// argument in the second slot? is zero the right value?
 	wgpuQueueOnSubmittedWorkDone(queue, 0, onQueueWorkDone, NULL /* pUserData */);
 
+	// All command buffers of a frame go through a single submit
+	struct SubmitScheduler * scheduler = submitSchedulerCreate(device);
+
 	WGPUSwapChainDescriptor swapChainDesc = (WGPUSwapChainDescriptor) {};
 	swapChainDesc.nextInChain = NULL;
 	swapChainDesc.width = 640;
@@ -147,10 +80,29 @@ int main (int argc, char** argv) {
 
 	swapChainDesc.format = WGPUTextureFormat_BGRA8Unorm;
 	swapChainDesc.usage = WGPUTextureUsage_RenderAttachment;
+	if (capturePath) {
+		// The capture reads the swap chain images from a compute pass
+		swapChainDesc.usage |= WGPUTextureUsage_TextureBinding;
+	}
 	swapChainDesc.presentMode = WGPUPresentMode_Fifo;
 	WGPUSwapChain swapChain = wgpuDeviceCreateSwapChain(device, surface, &swapChainDesc);
     printf("Swapchain: %p\n", (void*)swapChain);
 
+	struct VideoCapture * capture = NULL;
+	if (capturePath) {
+		struct VideoCaptureDesc captureDesc = (struct VideoCaptureDesc) {};
+		captureDesc.path = capturePath;
+		captureDesc.width = swapChainDesc.width;
+		captureDesc.height = swapChainDesc.height;
+		captureDesc.format = swapChainDesc.format;
+		// Fifo presents at the refresh rate, assumed to be 60 Hz
+		captureDesc.fpsNumerator = 60;
+		captureDesc.fpsDenominator = 1;
+		captureDesc.scheduler = scheduler;
+		capture = videoCaptureCreate(device, &captureDesc);
+		if (!capture) return 1;
+	}
+
 	// shaderModule defined here
 	const char* shaderSource = "@vertex\n\
 fn vs_main(@builtin(vertex_index) in_vertex_index: u32) -> @builtin(position) vec4f {\n\
@@ -170,13 +122,8 @@ fn fs_main() -> @location(0) vec4f {\n\
     return vec4f(0.0, 0.4, 1.0, 1.0);\n\
 }";
 
-	WGPUShaderModuleDescriptor shaderDesc = (WGPUShaderModuleDescriptor) {};
-	WGPUShaderModuleWGSLDescriptor shaderCodeDesc = (WGPUShaderModuleWGSLDescriptor) {}; 
-	shaderCodeDesc.chain.next = NULL;
-	shaderCodeDesc.chain.sType = WGPUSType_ShaderModuleWGSLDescriptor;
-	shaderCodeDesc.source = shaderSource;
-	shaderDesc.nextInChain = &shaderCodeDesc.chain;
-	WGPUShaderModule shaderModule = wgpuDeviceCreateShaderModule(device, &shaderDesc);
+	struct TrackedResource * trackedShaderModule = deviceRecoveryCreateShaderModule(recovery, shaderSource, "Shader module");
+	WGPUShaderModule shaderModule = trackedShaderModule->handle.shaderModule;
 
     WGPURenderPipelineDescriptor pipelineDesc = (WGPURenderPipelineDescriptor) {};
     pipelineDesc.nextInChain = NULL;
@@ -227,7 +174,7 @@ fn fs_main() -> @location(0) vec4f {\n\
 
 	pipelineDesc.layout = NULL;
 
-    WGPURenderPipeline pipeline = wgpuDeviceCreateRenderPipeline(device, &pipelineDesc);
+    struct TrackedResource * pipeline = deviceRecoveryCreateRenderPipeline(recovery, &pipelineDesc);
 
 
 
@@ -235,6 +182,25 @@ fn fs_main() -> @location(0) vec4f {\n\
 
     while (!glfwWindowShouldClose(window)) {
         glfwPollEvents();
+		if (deviceRecoveryIsLost(recovery)) {
+			if (capture) {
+				// Its pipeline and buffers belong to the lost device, which
+				// recovering releases
+				videoCaptureRelease(capture);
+				capture = NULL;
+				fprintf(stderr, "Video capture stopped by device loss\n");
+			}
+			if (!deviceRecoveryRecover(recovery)) break;
+			// The swap chain and queue belong to the lost device
+			wgpuSwapChainRelease(swapChain);
+			wgpuQueueRelease(queue);
+			wgpuDeviceRelease(device);
+			device = recovery->device;
+			wgpuDeviceReference(device);
+			queue = wgpuDeviceGetQueue(device);
+			swapChain = wgpuDeviceCreateSwapChain(device, surface, &swapChainDesc);
+			submitSchedulerSetDevice(scheduler, device);
+		}
 		WGPUTextureView nextTexture = wgpuSwapChainGetCurrentTextureView(swapChain);
         printf("nextTexture: %p\n", (void*)nextTexture);
 		if (!nextTexture) {
@@ -265,24 +231,50 @@ fn fs_main() -> @location(0) vec4f {\n\
  		WGPURenderPassEncoder renderPass = wgpuCommandEncoderBeginRenderPass(encoder, &renderPassDesc);
 
 		// actually run the render pass i guess
-		wgpuRenderPassEncoderSetPipeline(renderPass, pipeline);
+		wgpuRenderPassEncoderSetPipeline(renderPass, pipeline->handle.renderPipeline);
 		wgpuRenderPassEncoderDraw(renderPass, 3, 1, 0, 0);
 
 
 
  		wgpuRenderPassEncoderEnd(renderPass);
 
+		if (capture) {
+			videoCaptureEncodeFrame(capture, encoder, nextTexture);
+		}
+
 		wgpuTextureViewRelease(nextTexture);
 
 		WGPUCommandBufferDescriptor cmdBufferDescriptor = (WGPUCommandBufferDescriptor) {};
 		cmdBufferDescriptor.nextInChain = NULL;
 		cmdBufferDescriptor.label = "Command buffer";
 		WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, &cmdBufferDescriptor);
-		wgpuQueueSubmit(queue, 1, &command);
+		submitSchedulerEnqueue(scheduler, SubmitStage_Render, command);
+		submitSchedulerEndFrame(scheduler);
+		if (scheduler->frameCount % 120 == 0) {
+			printf("Submits per frame: %u (%u command buffers)\n", scheduler->lastFrameSubmitCount, scheduler->lastFrameCommandCount);
+		}
 
 		wgpuSwapChainPresent(swapChain);
+
+#ifdef WEBGPU_BACKEND_DAWN
+		// Dawn only fires asynchronous callbacks (e.g. mapAsync) when ticked
+		wgpuDeviceTick(device);
+#endif
+		if (capture) {
+			videoCapturePoll(capture);
+		}
     }
 
+	if (capture) {
+		uint64_t capturedFrames = capture->capturedFrames;
+		uint64_t droppedFrames = capture->droppedFrames;
+		if (videoCaptureRelease(capture)) {
+			printf("Captured %llu frames to %s (%llu dropped)\n", (unsigned long long)capturedFrames, capturePath, (unsigned long long)droppedFrames);
+		}
+	}
+
+	submitSchedulerRelease(scheduler);
+	deviceRecoveryRelease(recovery);
 	wgpuSwapChainRelease(swapChain);
 	wgpuDeviceRelease(device);
 	wgpuAdapterRelease(adapter);
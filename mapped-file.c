@@ -0,0 +1,151 @@
+#include "mapped-file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+struct MappedFile * mappedFileOpen(char const * path) {
+	HANDLE fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE) {
+		fprintf(stderr, "Could not open %s\n", path);
+		return NULL;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(fileHandle, &size)) {
+		CloseHandle(fileHandle);
+		return NULL;
+	}
+	struct MappedFile * file = (struct MappedFile *)calloc(1, sizeof(struct MappedFile));
+	file->fileHandle = fileHandle;
+	file->size = (size_t)size.QuadPart;
+	if (file->size == 0) return file;
+
+	file->mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	file->data = file->mappingHandle ? MapViewOfFile(file->mappingHandle, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (!file->data) {
+		fprintf(stderr, "Could not map %s\n", path);
+		mappedFileClose(file);
+		return NULL;
+	}
+	return file;
+}
+
+void mappedFileClose(struct MappedFile * file) {
+	if (!file) return;
+	if (file->data) UnmapViewOfFile(file->data);
+	if (file->mappingHandle) CloseHandle(file->mappingHandle);
+	CloseHandle(file->fileHandle);
+	free(file);
+}
+
+#else // _WIN32
+
+struct MappedFile * mappedFileOpen(char const * path) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Could not open %s\n", path);
+		return NULL;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		return NULL;
+	}
+	struct MappedFile * file = (struct MappedFile *)calloc(1, sizeof(struct MappedFile));
+	file->size = (size_t)info.st_size;
+	if (file->size > 0) {
+		void * data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			fprintf(stderr, "Could not map %s\n", path);
+			close(fd);
+			free(file);
+			return NULL;
+		}
+		file->data = data;
+	}
+	// The mapping stays valid once the descriptor is closed
+	close(fd);
+	return file;
+}
+
+void mappedFileClose(struct MappedFile * file) {
+	if (!file) return;
+	if (file->data) munmap((void *)file->data, file->size);
+	free(file);
+}
+
+#endif // _WIN32
+
+bool mappedFileStat(char const * path, uint64_t * size, int64_t * modified) {
+#ifdef _WIN32
+	// stat has a 32-bit size and whole seconds there
+	WIN32_FILE_ATTRIBUTE_DATA info;
+	if (!GetFileAttributesExA(path, GetFileExInfoStandard, &info)) return false;
+	*size = ((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+	// 100 ns ticks since 1601
+	int64_t ticks = (int64_t)(((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime);
+	*modified = (ticks - 116444736000000000ll) * 100;
+#else
+	struct stat info;
+	if (stat(path, &info) != 0) return false;
+	*size = (uint64_t)info.st_size;
+#ifdef __APPLE__
+	*modified = (int64_t)info.st_mtimespec.tv_sec * 1000000000ll + info.st_mtimespec.tv_nsec;
+#else
+	*modified = (int64_t)info.st_mtim.tv_sec * 1000000000ll + info.st_mtim.tv_nsec;
+#endif
+#endif
+	return true;
+}
+
+// Content hash
+
+#define HASH_PRIME1 0x9e3779b185ebca87ull
+#define HASH_PRIME2 0xc2b2ae3d27d4eb4full
+#define HASH_PRIME3 0x165667b19e3779f9ull
+
+static uint64_t rotateLeft(uint64_t x, int bits) {
+	return (x << bits) | (x >> (64 - bits));
+}
+
+static uint64_t hashRound(uint64_t lane, uint64_t input) {
+	return rotateLeft(lane + input * HASH_PRIME2, 31) * HASH_PRIME1;
+}
+
+static uint64_t read64(uint8_t const * p) {
+	uint64_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+uint64_t mappedFileHash(void const * data, size_t size) {
+	uint8_t const * p = (uint8_t const *)data;
+	uint64_t lanes[4] = { HASH_PRIME1 + HASH_PRIME2, HASH_PRIME2, 0, (uint64_t)0 - HASH_PRIME1 };
+	size_t stripes = size / 32;
+	for (size_t i = 0; i < stripes; ++i, p += 32) {
+		for (int k = 0; k < 4; ++k) lanes[k] = hashRound(lanes[k], read64(p + 8 * k));
+	}
+	uint64_t hash = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) + rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+	hash += (uint64_t)size;
+	for (size_t i = stripes * 32; i < size; ++i) {
+		hash = rotateLeft(hash ^ ((uint64_t)((uint8_t const *)data)[i] * HASH_PRIME3), 11) * HASH_PRIME1;
+	}
+	hash ^= hash >> 33;
+	hash *= HASH_PRIME2;
+	hash ^= hash >> 29;
+	hash *= HASH_PRIME3;
+	hash ^= hash >> 32;
+	return hash;
+}
@@ -0,0 +1,55 @@
+/**
+ * Read-only memory mapping of whole files, so that large assets can be
+ * read (or uploaded straight to the GPU) without first copying them in a
+ * heap allocation. Pages are loaded by the OS as they are touched.
+ *
+ * Also holds what the caches of imported assets (see mesh-cache.h and
+ * texture-cache.h) need to tell whether their source changed: its size,
+ * modification time and content hash.
+ */
+
+#ifndef _mapped_file_h_
+#define _mapped_file_h_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct MappedFile {
+	void const * data; // NULL for an empty file
+	size_t size;
+#ifdef _WIN32
+	void * fileHandle;
+	void * mappingHandle;
+#endif
+};
+
+/**
+ * Map the file at `path`. Returns NULL if it cannot be opened or mapped.
+ */
+struct MappedFile * mappedFileOpen(char const * path);
+
+void mappedFileClose(struct MappedFile * file);
+
+/**
+ * Size and modification time (nanoseconds since the epoch, so that edits
+ * within a second are told apart) of the file at `path`, without opening
+ * it. Returns false if it does not exist.
+ */
+bool mappedFileStat(char const * path, uint64_t * size, int64_t * modified);
+
+/**
+ * 64-bit hash of the content of a file, as stored in caches: 4 lanes of
+ * the xxHash64 round over 32-byte stripes.
+ */
+uint64_t mappedFileHash(void const * data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _mapped_file_h_
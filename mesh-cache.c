@@ -0,0 +1,262 @@
+#include "mesh-cache.h"
+#include "mesh-optimizer.h"
+#include "webgpu-utils.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Cache files
+
+struct MeshCache * meshCacheOpen(char const * path) {
+	struct MappedFile * file = mappedFileOpen(path);
+	if (!file) return NULL;
+	struct MeshCache * cache = (struct MeshCache *)calloc(1, sizeof(struct MeshCache));
+	cache->file = file;
+	uint8_t const * bytes = (uint8_t const *)file->data;
+
+	char const * error = NULL;
+	struct MeshCacheHeader const * header = (struct MeshCacheHeader const *)bytes;
+	if (file->size < sizeof(struct MeshCacheHeader) || memcmp(header->magic, MESH_CACHE_MAGIC, 4) != 0) {
+		error = "not a mesh cache";
+	} else if (header->version != MESH_CACHE_VERSION) {
+		error = "unsupported version";
+	} else if (header->vertexStride != sizeof(struct ObjVertex)
+		|| (header->indexFormat != WGPUIndexFormat_Uint16 && header->indexFormat != WGPUIndexFormat_Uint32)) {
+		error = "unsupported vertex or index format";
+	} else if (header->vertexOffset % MESH_CACHE_ALIGNMENT != 0 || header->vertexSize % 4 != 0
+		|| header->vertexSize < (uint64_t)header->vertexCount * header->vertexStride
+		|| header->vertexOffset > file->size || header->vertexSize > file->size - header->vertexOffset) {
+		error = "invalid vertex range";
+	} else if (header->indexOffset % MESH_CACHE_ALIGNMENT != 0 || header->indexSize % 4 != 0
+		|| header->indexSize < (uint64_t)header->indexCount * (header->indexFormat == WGPUIndexFormat_Uint16 ? 2 : 4)
+		|| header->indexOffset > file->size || header->indexSize > file->size - header->indexOffset) {
+		error = "invalid index range";
+	} else if (header->lodCount == 0 || header->lodCount > MESH_LOD_MAX_LEVELS) {
+		error = "invalid levels of detail";
+	} else {
+		for (uint32_t i = 0; i < header->lodCount && !error; ++i) {
+			struct MeshLod const * lod = &header->lods[i];
+			if (lod->indexCount % 3 != 0 || lod->firstIndex > header->indexCount || lod->indexCount > header->indexCount - lod->firstIndex) {
+				error = "invalid levels of detail";
+			}
+		}
+	}
+
+	if (error) {
+		fprintf(stderr, "Could not load mesh cache %s: %s\n", path, error);
+		meshCacheRelease(cache);
+		return NULL;
+	}
+	cache->header = header;
+	cache->vertices = bytes + header->vertexOffset;
+	cache->indices = bytes + header->indexOffset;
+	return cache;
+}
+
+void meshCacheRelease(struct MeshCache * cache) {
+	if (!cache) return;
+	mappedFileClose(cache->file);
+	free(cache);
+}
+
+static bool writePadding(FILE * file, uint64_t size) {
+	static const uint8_t zeros[MESH_CACHE_ALIGNMENT] = { 0 };
+	while (size > 0) {
+		size_t chunk = size < sizeof(zeros) ? (size_t)size : sizeof(zeros);
+		if (fwrite(zeros, 1, chunk, file) != chunk) return false;
+		size -= chunk;
+	}
+	return true;
+}
+
+bool meshCacheWrite(char const * path, struct ObjMesh const * mesh, struct MeshLodChain const * lods, struct MeshCacheSource const * source) {
+	struct MeshCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MESH_CACHE_MAGIC, 4);
+	header.version = MESH_CACHE_VERSION;
+	header.sourceSize = source->size;
+	header.sourceModified = source->modified;
+	header.sourceHash = source->hash;
+	header.vertexCount = mesh->vertexCount;
+	header.vertexStride = sizeof(struct ObjVertex);
+	header.indexCount = mesh->indexCount;
+	header.indexFormat = meshIndexFormat(mesh->vertexCount);
+	header.flags = (mesh->hasTexcoords ? MeshCache_HasTexcoords : 0) | (mesh->hasNormals ? MeshCache_HasNormals : 0);
+	memcpy(header.boundsMin, mesh->boundsMin, sizeof(header.boundsMin));
+	memcpy(header.boundsMax, mesh->boundsMax, sizeof(header.boundsMax));
+	if (lods) {
+		header.lodCount = lods->lodCount;
+		memcpy(header.lods, lods->lods, sizeof(header.lods));
+	} else {
+		header.lodCount = 1;
+		header.lods[0] = (struct MeshLod) { 0, mesh->indexCount, 0.0f, 0 };
+	}
+	uint64_t vertexBytes = (uint64_t)mesh->vertexCount * sizeof(struct ObjVertex);
+	uint64_t indexBytes = (uint64_t)mesh->indexCount * (header.indexFormat == WGPUIndexFormat_Uint16 ? sizeof(uint16_t) : sizeof(uint32_t));
+	header.vertexOffset = alignUp(sizeof(header), MESH_CACHE_ALIGNMENT);
+	header.vertexSize = alignUp(vertexBytes, 4);
+	header.indexOffset = alignUp(header.vertexOffset + header.vertexSize, MESH_CACHE_ALIGNMENT);
+	header.indexSize = alignUp(indexBytes, 4);
+
+	void const * indices = mesh->indices;
+	uint16_t * indices16 = NULL;
+	if (header.indexFormat == WGPUIndexFormat_Uint16 && mesh->indexCount > 0) {
+		indices16 = (uint16_t *)malloc((size_t)indexBytes);
+		if (!indices16) {
+			fprintf(stderr, "Could not allocate the indices of mesh cache %s\n", path);
+			return false;
+		}
+		meshPackIndices16(indices16, mesh->indices, mesh->indexCount);
+		indices = indices16;
+	}
+
+	size_t pathLength = strlen(path);
+	char * temporaryPath = (char *)malloc(pathLength + 5);
+	memcpy(temporaryPath, path, pathLength);
+	memcpy(temporaryPath + pathLength, ".tmp", 5);
+	FILE * file = fopen(temporaryPath, "wb");
+	if (!file) {
+		fprintf(stderr, "Could not open %s for writing\n", temporaryPath);
+		free(temporaryPath);
+		free(indices16);
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+		&& writePadding(file, header.vertexOffset - sizeof(header))
+		&& fwrite(mesh->vertices, 1, (size_t)vertexBytes, file) == vertexBytes
+		&& writePadding(file, header.indexOffset - header.vertexOffset - vertexBytes)
+		&& fwrite(indices, 1, (size_t)indexBytes, file) == indexBytes
+		&& writePadding(file, header.indexSize - indexBytes);
+	ok = fclose(file) == 0 && ok;
+	// rename does not replace existing files on Windows
+	remove(path);
+	ok = ok && rename(temporaryPath, path) == 0;
+	if (!ok) {
+		fprintf(stderr, "Could not write mesh cache %s\n", path);
+		remove(temporaryPath);
+	}
+	free(temporaryPath);
+	free(indices16);
+	return ok;
+}
+
+/**
+ * Rewrite the recorded modification time of a cache whose source was
+ * touched but not changed, so that the next loads skip hashing it.
+ */
+static void updateSourceModified(char const * path, int64_t modified) {
+	FILE * file = fopen(path, "r+b");
+	if (!file) return;
+	if (fseek(file, (long)offsetof(struct MeshCacheHeader, sourceModified), SEEK_SET) == 0) {
+		fwrite(&modified, sizeof(modified), 1, file);
+	}
+	fclose(file);
+}
+
+struct MeshCache * meshCacheLoad(char const * sourcePath, uint32_t threadCount) {
+	size_t pathLength = strlen(sourcePath);
+	char * cachePath = (char *)malloc(pathLength + sizeof(MESH_CACHE_EXTENSION));
+	memcpy(cachePath, sourcePath, pathLength);
+	memcpy(cachePath + pathLength, MESH_CACHE_EXTENSION, sizeof(MESH_CACHE_EXTENSION));
+
+	struct MeshCacheSource source = (struct MeshCacheSource) {};
+	bool hasSource = mappedFileStat(sourcePath, &source.size, &source.modified);
+
+	// 1. Use the cache if it matches the source
+	uint64_t cacheSize = 0;
+	int64_t cacheModified = 0;
+	struct MeshCache * cache = mappedFileStat(cachePath, &cacheSize, &cacheModified) ? meshCacheOpen(cachePath) : NULL;
+	if (cache && (!hasSource || (cache->header->sourceSize == source.size && cache->header->sourceModified == source.modified))) {
+		free(cachePath);
+		return cache;
+	}
+	if (!hasSource) {
+		fprintf(stderr, "Could not find %s nor a valid cache of it\n", sourcePath);
+		free(cachePath);
+		return NULL;
+	}
+
+	// 2. Or if the content of the source did not change
+	struct MappedFile * sourceFile = mappedFileOpen(sourcePath);
+	if (!sourceFile) {
+		meshCacheRelease(cache);
+		free(cachePath);
+		return NULL;
+	}
+	source.hash = mappedFileHash(sourceFile->data, sourceFile->size);
+	mappedFileClose(sourceFile);
+	if (cache && cache->header->sourceSize == source.size && cache->header->sourceHash == source.hash) {
+		meshCacheRelease(cache);
+		updateSourceModified(cachePath, source.modified);
+		cache = meshCacheOpen(cachePath);
+		free(cachePath);
+		return cache;
+	}
+	meshCacheRelease(cache);
+
+	// 3. Otherwise import the source again
+	struct ObjMesh * mesh = objMeshLoad(sourcePath, threadCount);
+	if (!mesh) {
+		free(cachePath);
+		return NULL;
+	}
+	meshOptimize(mesh);
+	struct MeshLodChain lods;
+	uint32_t * lodIndices = meshLodBuild(mesh->indices, mesh->indexCount, mesh->vertices[0].position, sizeof(struct ObjVertex), mesh->vertexCount, &lods);
+	if (lodIndices) {
+		free(mesh->indices);
+		mesh->indices = lodIndices;
+		mesh->indexCount = lods.lods[lods.lodCount - 1].firstIndex + lods.lods[lods.lodCount - 1].indexCount;
+	}
+	bool written = meshCacheWrite(cachePath, mesh, lodIndices ? &lods : NULL, &source);
+	objMeshRelease(mesh);
+	cache = written ? meshCacheOpen(cachePath) : NULL;
+	free(cachePath);
+	return cache;
+}
+
+// GPU buffers
+
+static WGPUBuffer createFilledBuffer(WGPUDevice device, void const * data, uint64_t size, WGPUBufferUsageFlags usage, char const * label) {
+	WGPUBufferDescriptor desc = (WGPUBufferDescriptor) {};
+	desc.nextInChain = NULL;
+	desc.label = label;
+	desc.usage = usage | WGPUBufferUsage_CopyDst;
+	desc.size = size;
+	desc.mappedAtCreation = true;
+	WGPUBuffer buffer = wgpuDeviceCreateBuffer(device, &desc);
+	void * mapped = wgpuBufferGetMappedRange(buffer, 0, (size_t)size);
+	if (mapped) memcpy(mapped, data, (size_t)size);
+	wgpuBufferUnmap(buffer);
+	return buffer;
+}
+
+struct MeshBuffers meshCacheCreateBuffers(WGPUDevice device, struct MeshCache const * cache, char const * label) {
+	struct MeshCacheHeader const * header = cache->header;
+	struct MeshBuffers buffers = (struct MeshBuffers) {};
+	buffers.vertexBuffer = createFilledBuffer(device, cache->vertices, header->vertexSize, WGPUBufferUsage_Vertex, label);
+	buffers.indexBuffer = createFilledBuffer(device, cache->indices, header->indexSize, WGPUBufferUsage_Index, label);
+	buffers.indexFormat = (WGPUIndexFormat)header->indexFormat;
+	buffers.vertexCount = header->vertexCount;
+	buffers.vertexStride = header->vertexStride;
+	buffers.indexCount = header->indexCount;
+	memcpy(buffers.boundsMin, header->boundsMin, sizeof(buffers.boundsMin));
+	memcpy(buffers.boundsMax, header->boundsMax, sizeof(buffers.boundsMax));
+	buffers.lods.lodCount = header->lodCount;
+	memcpy(buffers.lods.lods, header->lods, sizeof(buffers.lods.lods));
+	return buffers;
+}
+
+void meshBuffersRelease(struct MeshBuffers * buffers) {
+	if (buffers->vertexBuffer) {
+		wgpuBufferDestroy(buffers->vertexBuffer);
+		wgpuBufferRelease(buffers->vertexBuffer);
+	}
+	if (buffers->indexBuffer) {
+		wgpuBufferDestroy(buffers->indexBuffer);
+		wgpuBufferRelease(buffers->indexBuffer);
+	}
+	*buffers = (struct MeshBuffers) {};
+}
@@ -0,0 +1,149 @@
+/**
+ * Binary mesh cache, so that meshes imported from OBJ files (see
+ * obj-loader.h) load at the speed of the disk on the next launches.
+ *
+ * The cache of `mesh.obj` is `mesh.obj.wmesh`, written next to it the
+ * first time the mesh is loaded. The mesh is optimised for the GPU when
+ * imported (see mesh-optimizer.h) and gets a chain of levels of detail
+ * (see mesh-lod.h), whose indices follow the ones of the full mesh in the
+ * same index stream. Vertex and index streams are stored exactly as the
+ * GPU reads them, with 16-bit indices when there are few enough vertices,
+ * at 256-byte aligned offsets. Loading maps the
+ * file and copies each stream straight into a buffer mapped at creation,
+ * without any conversion.
+ *
+ * A cache is up to date when the size and modification time of its
+ * source match the ones it recorded. When they differ, the content hash
+ * of the source decides: a file that was only touched keeps its cache,
+ * one whose content changed is imported again. A cache whose source is
+ * missing is used as is, so caches can be shipped alone.
+ *
+ * File layout (little endian):
+ *     struct MeshCacheHeader header;
+ *     ...padding...
+ *     vertices[header.vertexSize], at header.vertexOffset
+ *     ...padding...
+ *     indices[header.indexSize], at header.indexOffset
+ *
+ * Typical use:
+ *     struct MeshCache * cache = meshCacheLoad("suzanne.obj", 0);
+ *     struct MeshBuffers buffers = meshCacheCreateBuffers(device, cache, "Suzanne");
+ *     meshCacheRelease(cache);
+ *     struct MeshLod const * lod = &buffers.lods.lods[meshLodSelect(&buffers.lods, ...)];
+ *     // draw lod->indexCount indices of buffers.indexBuffer from lod->firstIndex
+ *     meshBuffersRelease(&buffers);
+ */
+
+#ifndef _mesh_cache_h_
+#define _mesh_cache_h_
+
+#include <webgpu/webgpu.h>
+#include "mapped-file.h"
+#include "mesh-lod.h"
+#include "obj-loader.h"
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MESH_CACHE_MAGIC "WMSH"
+#define MESH_CACHE_VERSION 3
+#define MESH_CACHE_ALIGNMENT 256
+#define MESH_CACHE_EXTENSION ".wmesh"
+
+enum MeshCacheFlags {
+	MeshCache_HasTexcoords = 1 << 0,
+	MeshCache_HasNormals = 1 << 1, // else computed
+};
+
+struct MeshCacheHeader {
+	char magic[4];
+	uint32_t version;
+	// Source the cache was built from
+	uint64_t sourceSize;
+	int64_t sourceModified; // nanoseconds since the epoch
+	uint64_t sourceHash;
+	uint32_t vertexCount;
+	uint32_t vertexStride; // sizeof(struct ObjVertex)
+	uint32_t indexCount;
+	uint32_t indexFormat; // WGPUIndexFormat
+	uint32_t flags; // enum MeshCacheFlags
+	float boundsMin[3];
+	float boundsMax[3];
+	uint32_t lodCount;
+	uint64_t vertexOffset;
+	uint64_t vertexSize; // multiple of 4
+	uint64_t indexOffset;
+	uint64_t indexSize; // multiple of 4
+	struct MeshLod lods[MESH_LOD_MAX_LEVELS]; // ranges of the index stream
+};
+
+/**
+ * A cache, as mapped from its file. Pointers are into the mapping.
+ */
+struct MeshCache {
+	struct MappedFile * file;
+	struct MeshCacheHeader const * header;
+	void const * vertices;
+	void const * indices;
+};
+
+struct MeshBuffers {
+	WGPUBuffer vertexBuffer; // Vertex | CopyDst
+	WGPUBuffer indexBuffer; // Index | CopyDst
+	WGPUIndexFormat indexFormat;
+	uint32_t vertexCount;
+	uint32_t vertexStride;
+	uint32_t indexCount; // of all levels
+	float boundsMin[3];
+	float boundsMax[3];
+	struct MeshLodChain lods;
+};
+
+/**
+ * Map the cache of the OBJ file at `sourcePath`, importing the OBJ on
+ * `threadCount` threads (see objMeshLoad), optimising it and writing the
+ * cache first if it is missing or out of date. Returns NULL and prints
+ * why if neither the cache nor the source can be loaded.
+ */
+struct MeshCache * meshCacheLoad(char const * sourcePath, uint32_t threadCount);
+
+/**
+ * Map and validate the cache file at `path`, without checking its source.
+ */
+struct MeshCache * meshCacheOpen(char const * path);
+
+void meshCacheRelease(struct MeshCache * cache);
+
+/**
+ * Identity of the source of a cache, see MeshCacheHeader.
+ */
+struct MeshCacheSource {
+	uint64_t size;
+	int64_t modified;
+	uint64_t hash;
+};
+
+/**
+ * Write `mesh` to a cache file at `path`, as is but with 16-bit indices
+ * when meshIndexFormat allows it, through a temporary file so that a
+ * cache is never seen half written. `lods` describes the levels in the
+ * indices of the mesh, or is NULL when they are a single level.
+ */
+bool meshCacheWrite(char const * path, struct ObjMesh const * mesh, struct MeshLodChain const * lods, struct MeshCacheSource const * source);
+
+/**
+ * Create the vertex and index buffers of a cached mesh, mapped at
+ * creation and filled straight from the cache file.
+ */
+struct MeshBuffers meshCacheCreateBuffers(WGPUDevice device, struct MeshCache const * cache, char const * label);
+
+void meshBuffersRelease(struct MeshBuffers * buffers);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _mesh_cache_h_
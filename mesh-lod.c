@@ -0,0 +1,614 @@
+#include "mesh-lod.h"
+#include "mesh-optimizer.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Weight of the quadrics keeping borders in place, relative to the ones
+// of the faces
+#define BORDER_WEIGHT 10.0
+// Largest cost of a pass, relative to the cost of the collapse that would
+// reach the target if none was skipped
+#define ERROR_GOAL_FACTOR 1.5
+// Bisection steps of the global pixel error to fit a triangle budget
+#define BUDGET_ITERATIONS 20
+// 4 passes, so that the sorted order ends in the array it started in
+#define RADIX_BITS 8
+#define NO_INDEX UINT32_MAX
+#define NO_EDGE UINT64_MAX
+
+enum VertexKind {
+	VertexKind_Manifold, // may move to any neighbor
+	VertexKind_Border, // may move along its border
+	VertexKind_Locked,
+};
+
+// Quadrics
+
+/**
+ * Sum of weighted squared distances to planes, as the symmetric matrix A,
+ * vector b and constant c of p^T A p + 2 b.p + c, and the total weight.
+ */
+struct Quadric {
+	double a00, a11, a22, a01, a02, a12;
+	double b0, b1, b2;
+	double c;
+	double w;
+};
+
+static void quadricAddPlane(struct Quadric * q, double const n[3], double d, double w) {
+	q->a00 += w * n[0] * n[0];
+	q->a11 += w * n[1] * n[1];
+	q->a22 += w * n[2] * n[2];
+	q->a01 += w * n[0] * n[1];
+	q->a02 += w * n[0] * n[2];
+	q->a12 += w * n[1] * n[2];
+	q->b0 += w * n[0] * d;
+	q->b1 += w * n[1] * d;
+	q->b2 += w * n[2] * d;
+	q->c += w * d * d;
+	q->w += w;
+}
+
+static void quadricAdd(struct Quadric * q, struct Quadric const * r) {
+	q->a00 += r->a00;
+	q->a11 += r->a11;
+	q->a22 += r->a22;
+	q->a01 += r->a01;
+	q->a02 += r->a02;
+	q->a12 += r->a12;
+	q->b0 += r->b0;
+	q->b1 += r->b1;
+	q->b2 += r->b2;
+	q->c += r->c;
+	q->w += r->w;
+}
+
+/**
+ * Weighted mean of the squared distances of `p` to the planes of the sum
+ * of `q` and `r`.
+ */
+static double quadricError(struct Quadric const * q, struct Quadric const * r, float const p[3]) {
+	double x = p[0], y = p[1], z = p[2];
+	double a00 = q->a00 + r->a00, a11 = q->a11 + r->a11, a22 = q->a22 + r->a22;
+	double a01 = q->a01 + r->a01, a02 = q->a02 + r->a02, a12 = q->a12 + r->a12;
+	double e = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+		+ 2.0 * ((q->b0 + r->b0) * x + (q->b1 + r->b1) * y + (q->b2 + r->b2) * z) + q->c + r->c;
+	double w = q->w + r->w;
+	return w > 0.0 ? fabs(e) / w : 0.0;
+}
+
+// Geometry
+
+static float const * positionOf(float const * positions, size_t positionStride, uint32_t v) {
+	return (float const *)((char const *)positions + (size_t)v * positionStride);
+}
+
+static void cross(double const a[3], double const b[3], double n[3]) {
+	n[0] = a[1] * b[2] - a[2] * b[1];
+	n[1] = a[2] * b[0] - a[0] * b[2];
+	n[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static void triangleNormal(float const * p0, float const * p1, float const * p2, double n[3]) {
+	double e1[3] = { (double)p1[0] - p0[0], (double)p1[1] - p0[1], (double)p1[2] - p0[2] };
+	double e2[3] = { (double)p2[0] - p0[0], (double)p2[1] - p0[1], (double)p2[2] - p0[2] };
+	cross(e1, e2, n);
+}
+
+// Hashing
+
+static uint64_t mixHash(uint64_t x) {
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdull;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ull;
+	x ^= x >> 33;
+	return x;
+}
+
+static uint32_t tableCapacity(uint32_t count) {
+	uint32_t capacity = 16;
+	while (capacity < 2 * (uint64_t)count) capacity *= 2;
+	return capacity;
+}
+
+/**
+ * Map each vertex to the first vertex with the same position.
+ */
+static bool weldPositions(float const * positions, size_t positionStride, uint32_t vertexCount, uint32_t * representatives) {
+	uint32_t capacity = tableCapacity(vertexCount);
+	uint32_t * table = (uint32_t *)malloc((size_t)capacity * sizeof(uint32_t));
+	if (!table) return false;
+	memset(table, 0xff, (size_t)capacity * sizeof(uint32_t));
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		float const * p = positionOf(positions, positionStride, v);
+		// + 0.0f turns -0 into 0
+		float key[3] = { p[0] + 0.0f, p[1] + 0.0f, p[2] + 0.0f };
+		uint32_t bits[3];
+		memcpy(bits, key, sizeof(bits));
+		uint64_t hash = mixHash(((uint64_t)bits[0] << 32 | bits[1]) ^ mixHash(bits[2]));
+		uint32_t slot = (uint32_t)hash & (capacity - 1);
+		for (;;) {
+			uint32_t other = table[slot];
+			if (other == NO_INDEX) {
+				table[slot] = v;
+				representatives[v] = v;
+				break;
+			}
+			float const * q = positionOf(positions, positionStride, other);
+			if (key[0] == q[0] && key[1] == q[1] && key[2] == q[2]) {
+				representatives[v] = other;
+				break;
+			}
+			slot = (slot + 1) & (capacity - 1);
+		}
+	}
+	free(table);
+	return true;
+}
+
+/**
+ * Set of directed edges between representatives, counting duplicates.
+ */
+struct EdgeSet {
+	uint64_t * keys;
+	uint8_t * counts;
+	uint32_t capacity;
+};
+
+static uint64_t edgeKey(uint32_t a, uint32_t b) {
+	return (uint64_t)a << 32 | b;
+}
+
+static uint32_t edgeSlot(struct EdgeSet const * set, uint64_t key) {
+	uint32_t slot = (uint32_t)mixHash(key) & (set->capacity - 1);
+	while (set->keys[slot] != NO_EDGE && set->keys[slot] != key) slot = (slot + 1) & (set->capacity - 1);
+	return slot;
+}
+
+static void edgeSetInsert(struct EdgeSet * set, uint64_t key) {
+	uint32_t slot = edgeSlot(set, key);
+	set->keys[slot] = key;
+	if (set->counts[slot] < 255) ++set->counts[slot];
+}
+
+static uint32_t edgeSetCount(struct EdgeSet const * set, uint64_t key) {
+	uint32_t slot = edgeSlot(set, key);
+	return set->keys[slot] == key ? set->counts[slot] : 0;
+}
+
+// Simplification
+
+struct Collapse {
+	double cost;
+	uint32_t from;
+	uint32_t to;
+};
+
+/**
+ * Order collapses by increasing cost with a stable radix sort of their
+ * costs as floats, whose bits sort like integers when positive.
+ */
+static void sortCollapses(struct Collapse const * collapses, uint32_t count, uint32_t * keys, uint32_t * order, uint32_t * scratch) {
+	for (uint32_t i = 0; i < count; ++i) {
+		float cost = (float)collapses[i].cost;
+		memcpy(&keys[i], &cost, sizeof(cost));
+		order[i] = i;
+	}
+	for (uint32_t shift = 0; shift < 32; shift += RADIX_BITS) {
+		uint32_t histogram[1 << RADIX_BITS] = { 0 };
+		for (uint32_t i = 0; i < count; ++i) ++histogram[(keys[order[i]] >> shift) & ((1 << RADIX_BITS) - 1)];
+		uint32_t sum = 0;
+		for (uint32_t b = 0; b < (1 << RADIX_BITS); ++b) {
+			uint32_t h = histogram[b];
+			histogram[b] = sum;
+			sum += h;
+		}
+		for (uint32_t i = 0; i < count; ++i) {
+			uint32_t o = order[i];
+			scratch[histogram[(keys[o] >> shift) & ((1 << RADIX_BITS) - 1)]++] = o;
+		}
+		uint32_t * swap = order;
+		order = scratch;
+		scratch = swap;
+	}
+}
+
+struct Simplifier {
+	float const * positions;
+	size_t positionStride;
+	uint32_t vertexCount;
+	uint32_t * representatives;
+	uint32_t * wedgeCounts; // vertices sharing the position, per representative
+	uint8_t * kinds;
+	struct Quadric * quadrics; // per representative
+	struct EdgeSet edges;
+	// Triangles around each vertex
+	uint32_t * offsets;
+	uint32_t * adjacency;
+	uint32_t * remap;
+	uint8_t * collapseLocked;
+	struct Collapse * collapses;
+	uint32_t * sortKeys;
+	uint32_t * collapseOrder;
+	uint32_t * sortScratch;
+};
+
+static bool isBorderEdge(struct Simplifier const * s, uint32_t a, uint32_t b) {
+	uint32_t ra = s->representatives[a];
+	uint32_t rb = s->representatives[b];
+	return (edgeSetCount(&s->edges, edgeKey(ra, rb)) > 0) != (edgeSetCount(&s->edges, edgeKey(rb, ra)) > 0);
+}
+
+/**
+ * Classify vertices from the topology of the current triangles, and list
+ * the triangles around each vertex.
+ */
+static void analyzeTopology(struct Simplifier * s, uint32_t const * indices, uint32_t indexCount) {
+	memset(s->edges.keys, 0xff, (size_t)s->edges.capacity * sizeof(uint64_t));
+	memset(s->edges.counts, 0, s->edges.capacity);
+	for (uint32_t i = 0; i < indexCount; i += 3) {
+		for (uint32_t c = 0; c < 3; ++c) {
+			uint32_t a = s->representatives[indices[i + c]];
+			uint32_t b = s->representatives[indices[i + (c + 1) % 3]];
+			edgeSetInsert(&s->edges, edgeKey(a, b));
+		}
+	}
+
+	// Count the border edges leaving and entering each position, reusing
+	// the remap array as counters
+	uint32_t * borderCounts = s->remap;
+	memset(borderCounts, 0, (size_t)s->vertexCount * sizeof(uint32_t));
+	memset(s->kinds, VertexKind_Manifold, s->vertexCount);
+	for (uint32_t i = 0; i < indexCount; i += 3) {
+		for (uint32_t c = 0; c < 3; ++c) {
+			uint32_t a = s->representatives[indices[i + c]];
+			uint32_t b = s->representatives[indices[i + (c + 1) % 3]];
+			uint32_t forward = edgeSetCount(&s->edges, edgeKey(a, b));
+			uint32_t backward = edgeSetCount(&s->edges, edgeKey(b, a));
+			if (forward > 1 || backward > 1) {
+				// Non-manifold edge
+				s->kinds[a] = VertexKind_Locked;
+				s->kinds[b] = VertexKind_Locked;
+			} else if (backward == 0) {
+				borderCounts[a] += 1; // leaving
+				borderCounts[b] += 1 << 16; // entering
+			}
+		}
+	}
+	for (uint32_t v = 0; v < s->vertexCount; ++v) {
+		uint32_t r = s->representatives[v];
+		if (s->kinds[r] == VertexKind_Locked || s->wedgeCounts[r] > 1) {
+			s->kinds[v] = VertexKind_Locked;
+		} else if (borderCounts[r] == 0) {
+			s->kinds[v] = VertexKind_Manifold;
+		} else {
+			s->kinds[v] = borderCounts[r] == (1 | 1 << 16) ? VertexKind_Border : VertexKind_Locked;
+		}
+	}
+
+	memset(s->offsets, 0, ((size_t)s->vertexCount + 1) * sizeof(uint32_t));
+	for (uint32_t i = 0; i < indexCount; ++i) ++s->offsets[indices[i] + 1];
+	for (uint32_t v = 0; v < s->vertexCount; ++v) s->offsets[v + 1] += s->offsets[v];
+	for (uint32_t i = 0; i < indexCount; ++i) s->adjacency[s->offsets[indices[i]]++] = i / 3;
+	// Filling shifted each offset to the next vertex's
+	for (uint32_t v = s->vertexCount; v > 0; --v) s->offsets[v] = s->offsets[v - 1];
+	s->offsets[0] = 0;
+}
+
+static void initQuadrics(struct Simplifier * s, uint32_t const * indices, uint32_t indexCount) {
+	memset(s->quadrics, 0, (size_t)s->vertexCount * sizeof(struct Quadric));
+	for (uint32_t i = 0; i < indexCount; i += 3) {
+		float const * p[3];
+		for (uint32_t c = 0; c < 3; ++c) p[c] = positionOf(s->positions, s->positionStride, indices[i + c]);
+		double n[3];
+		triangleNormal(p[0], p[1], p[2], n);
+		double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length == 0.0) continue;
+		for (uint32_t k = 0; k < 3; ++k) n[k] /= length;
+		double d = -(n[0] * p[0][0] + n[1] * p[0][1] + n[2] * p[0][2]);
+		for (uint32_t c = 0; c < 3; ++c) {
+			quadricAddPlane(&s->quadrics[s->representatives[indices[i + c]]], n, d, 0.5 * length);
+		}
+
+		// Planes through border edges, orthogonal to the face
+		for (uint32_t c = 0; c < 3; ++c) {
+			uint32_t a = indices[i + c];
+			uint32_t b = indices[i + (c + 1) % 3];
+			if (!isBorderEdge(s, a, b)) continue;
+			float const * pa = p[c];
+			float const * pb = p[(c + 1) % 3];
+			double edge[3] = { (double)pb[0] - pa[0], (double)pb[1] - pa[1], (double)pb[2] - pa[2] };
+			double m[3];
+			cross(edge, n, m);
+			double mLength = sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+			if (mLength == 0.0) continue;
+			for (uint32_t k = 0; k < 3; ++k) m[k] /= mLength;
+			double md = -(m[0] * pa[0] + m[1] * pa[1] + m[2] * pa[2]);
+			double w = BORDER_WEIGHT * (edge[0] * edge[0] + edge[1] * edge[1] + edge[2] * edge[2]);
+			quadricAddPlane(&s->quadrics[s->representatives[a]], m, md, w);
+			quadricAddPlane(&s->quadrics[s->representatives[b]], m, md, w);
+		}
+	}
+}
+
+static bool canCollapse(struct Simplifier const * s, uint32_t from, uint32_t to) {
+	if (s->representatives[from] == s->representatives[to]) return false;
+	if (s->kinds[from] == VertexKind_Manifold) return true;
+	return s->kinds[from] == VertexKind_Border && isBorderEdge(s, from, to);
+}
+
+/**
+ * Whether moving `from` onto `to` turns a remaining triangle around
+ * `from` over.
+ */
+static bool collapseFlips(struct Simplifier const * s, uint32_t const * indices, uint32_t from, uint32_t to) {
+	uint32_t target = s->representatives[to];
+	float const * destination = positionOf(s->positions, s->positionStride, to);
+	for (uint32_t j = s->offsets[from]; j < s->offsets[from + 1]; ++j) {
+		uint32_t const * triangle = indices + 3 * s->adjacency[j];
+		float const * before[3];
+		float const * after[3];
+		bool degenerate = false;
+		for (uint32_t c = 0; c < 3; ++c) {
+			degenerate = degenerate || s->representatives[triangle[c]] == target;
+			before[c] = positionOf(s->positions, s->positionStride, triangle[c]);
+			after[c] = triangle[c] == from ? destination : before[c];
+		}
+		if (degenerate) continue;
+		double n0[3];
+		double n1[3];
+		triangleNormal(before[0], before[1], before[2], n0);
+		triangleNormal(after[0], after[1], after[2], n1);
+		if (n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0.0) return true;
+	}
+	return false;
+}
+
+static void freeSimplifier(struct Simplifier * s) {
+	free(s->sortScratch);
+	free(s->collapseOrder);
+	free(s->sortKeys);
+	free(s->collapses);
+	free(s->collapseLocked);
+	free(s->remap);
+	free(s->adjacency);
+	free(s->offsets);
+	free(s->edges.counts);
+	free(s->edges.keys);
+	free(s->quadrics);
+	free(s->kinds);
+	free(s->wedgeCounts);
+	free(s->representatives);
+}
+
+uint32_t meshSimplify(uint32_t * destination, uint32_t const * indices, uint32_t indexCount, float const * positions, size_t positionStride, uint32_t vertexCount, uint32_t targetIndexCount, float * error) {
+	uint32_t count = indexCount / 3 * 3;
+	memmove(destination, indices, (size_t)count * sizeof(uint32_t));
+	if (error) *error = 0.0f;
+	if (count <= targetIndexCount || count == 0) return count;
+
+	struct Simplifier s = (struct Simplifier) {};
+	s.positions = positions;
+	s.positionStride = positionStride;
+	s.vertexCount = vertexCount;
+	s.representatives = (uint32_t *)malloc((size_t)vertexCount * sizeof(uint32_t));
+	s.wedgeCounts = (uint32_t *)calloc(vertexCount, sizeof(uint32_t));
+	s.kinds = (uint8_t *)malloc(vertexCount);
+	s.quadrics = (struct Quadric *)malloc((size_t)vertexCount * sizeof(struct Quadric));
+	s.edges.capacity = tableCapacity(count);
+	s.edges.keys = (uint64_t *)malloc((size_t)s.edges.capacity * sizeof(uint64_t));
+	s.edges.counts = (uint8_t *)malloc(s.edges.capacity);
+	s.offsets = (uint32_t *)malloc(((size_t)vertexCount + 1) * sizeof(uint32_t));
+	s.adjacency = (uint32_t *)malloc((size_t)count * sizeof(uint32_t));
+	s.remap = (uint32_t *)malloc((size_t)vertexCount * sizeof(uint32_t));
+	s.collapseLocked = (uint8_t *)malloc(vertexCount);
+	s.collapses = (struct Collapse *)malloc((size_t)vertexCount * sizeof(struct Collapse));
+	s.sortKeys = (uint32_t *)malloc((size_t)vertexCount * sizeof(uint32_t));
+	s.collapseOrder = (uint32_t *)malloc((size_t)vertexCount * sizeof(uint32_t));
+	s.sortScratch = (uint32_t *)malloc((size_t)vertexCount * sizeof(uint32_t));
+	if (!s.representatives || !s.wedgeCounts || !s.kinds || !s.quadrics || !s.edges.keys || !s.edges.counts
+		|| !s.offsets || !s.adjacency || !s.remap || !s.collapseLocked || !s.collapses
+		|| !s.sortKeys || !s.collapseOrder || !s.sortScratch
+		|| !weldPositions(positions, positionStride, vertexCount, s.representatives)) {
+		freeSimplifier(&s);
+		return count;
+	}
+
+	// Positions with several vertices are seams, which stay in place
+	for (uint32_t i = 0; i < count; ++i) s.remap[indices[i]] = 1;
+	for (uint32_t i = 0; i < count; ++i) {
+		uint32_t v = indices[i];
+		if (s.remap[v] == 1) {
+			s.remap[v] = 0;
+			++s.wedgeCounts[s.representatives[v]];
+		}
+	}
+	analyzeTopology(&s, destination, count);
+	initQuadrics(&s, destination, count);
+
+	double largestCost = 0.0;
+	while (count > targetIndexCount) {
+		// Candidates: the cheapest collapse of each vertex, cheapest first
+		for (uint32_t v = 0; v < vertexCount; ++v) {
+			s.collapses[v] = (struct Collapse) { INFINITY, v, NO_INDEX };
+		}
+		for (uint32_t i = 0; i < count; i += 3) {
+			for (uint32_t c = 0; c < 3; ++c) {
+				uint32_t a = destination[i + c];
+				uint32_t b = destination[i + (c + 1) % 3];
+				// Interior edges are seen from both of their triangles
+				if (s.representatives[a] > s.representatives[b] && !isBorderEdge(&s, a, b)) continue;
+				for (uint32_t direction = 0; direction < 2; ++direction) {
+					uint32_t from = direction ? b : a;
+					uint32_t to = direction ? a : b;
+					if (!canCollapse(&s, from, to)) continue;
+					double cost = quadricError(&s.quadrics[s.representatives[from]], &s.quadrics[s.representatives[to]], positionOf(positions, positionStride, to));
+					if (cost < s.collapses[from].cost) {
+						s.collapses[from].cost = cost;
+						s.collapses[from].to = to;
+					}
+				}
+			}
+		}
+		uint32_t candidateCount = 0;
+		for (uint32_t v = 0; v < vertexCount; ++v) {
+			if (s.collapses[v].to != NO_INDEX) s.collapses[candidateCount++] = s.collapses[v];
+		}
+		if (candidateCount == 0) break;
+		sortCollapses(s.collapses, candidateCount, s.sortKeys, s.collapseOrder, s.sortScratch);
+
+		// Apply independent collapses until enough triangles are gone
+		for (uint32_t v = 0; v < vertexCount; ++v) s.remap[v] = v;
+		memset(s.collapseLocked, 0, vertexCount);
+		uint32_t triangles = count / 3;
+		uint32_t targetTriangles = targetIndexCount / 3;
+		// Many collapses get locked by their neighbors, so a pass accepts
+		// costs somewhat above the one of the last collapse it needs
+		uint32_t collapseGoal = (triangles - targetTriangles) / 2;
+		double costLimit = collapseGoal < candidateCount ? ERROR_GOAL_FACTOR * s.collapses[s.collapseOrder[collapseGoal]].cost : INFINITY;
+		uint32_t collapseCount = 0;
+		for (uint32_t k = 0; k < candidateCount && triangles > targetTriangles; ++k) {
+			struct Collapse const * collapse = &s.collapses[s.collapseOrder[k]];
+			if (collapse->cost > costLimit) break;
+			uint32_t from = collapse->from;
+			uint32_t to = collapse->to;
+			if (s.collapseLocked[from] || s.collapseLocked[to]) continue;
+			if (collapseFlips(&s, destination, from, to)) continue;
+
+			s.remap[from] = to;
+			quadricAdd(&s.quadrics[s.representatives[to]], &s.quadrics[s.representatives[from]]);
+			if (collapse->cost > largestCost) largestCost = collapse->cost;
+			++collapseCount;
+			// Triangles around `from` change, so none of their vertices may
+			// move in this pass
+			s.collapseLocked[to] = 1;
+			for (uint32_t j = s.offsets[from]; j < s.offsets[from + 1]; ++j) {
+				uint32_t const * triangle = destination + 3 * s.adjacency[j];
+				bool degenerate = false;
+				for (uint32_t c = 0; c < 3; ++c) {
+					s.collapseLocked[triangle[c]] = 1;
+					degenerate = degenerate || s.representatives[triangle[c]] == s.representatives[to];
+				}
+				if (degenerate) --triangles;
+			}
+		}
+		if (collapseCount == 0) break;
+
+		uint32_t newCount = 0;
+		for (uint32_t i = 0; i < count; i += 3) {
+			uint32_t a = s.remap[destination[i + 0]];
+			uint32_t b = s.remap[destination[i + 1]];
+			uint32_t c = s.remap[destination[i + 2]];
+			uint32_t ra = s.representatives[a];
+			uint32_t rb = s.representatives[b];
+			uint32_t rc = s.representatives[c];
+			if (ra == rb || rb == rc || rc == ra) continue;
+			destination[newCount++] = a;
+			destination[newCount++] = b;
+			destination[newCount++] = c;
+		}
+		count = newCount;
+		analyzeTopology(&s, destination, count);
+	}
+
+	freeSimplifier(&s);
+	if (error) *error = (float)sqrt(largestCost);
+	return count;
+}
+
+// Chain
+
+uint32_t * meshLodBuild(uint32_t const * indices, uint32_t indexCount, float const * positions, size_t positionStride, uint32_t vertexCount, struct MeshLodChain * chain) {
+	indexCount = indexCount / 3 * 3;
+	// Levels halve, so the chain rarely needs more than twice level 0
+	size_t capacity = 2 * (size_t)indexCount + 3;
+	uint32_t * all = (uint32_t *)malloc(capacity * sizeof(uint32_t));
+	if (!all) return NULL;
+	memcpy(all, indices, (size_t)indexCount * sizeof(uint32_t));
+	memset(chain, 0, sizeof(struct MeshLodChain));
+	chain->lodCount = 1;
+	chain->lods[0] = (struct MeshLod) { 0, indexCount, 0.0f, 0 };
+	uint32_t total = indexCount;
+
+	while (chain->lodCount < MESH_LOD_MAX_LEVELS) {
+		struct MeshLod const * previous = &chain->lods[chain->lodCount - 1];
+		uint32_t previousTriangles = previous->indexCount / 3;
+		if (previousTriangles <= MESH_LOD_MIN_TRIANGLES) break;
+		if (total + (size_t)previous->indexCount > capacity) {
+			capacity = 2 * capacity;
+			uint32_t * grown = (uint32_t *)realloc(all, capacity * sizeof(uint32_t));
+			if (!grown) break;
+			all = grown;
+			previous = &chain->lods[chain->lodCount - 1];
+		}
+		uint32_t target = (uint32_t)((float)previousTriangles * MESH_LOD_RATIO) * 3;
+		float error = 0.0f;
+		uint32_t count = meshSimplify(all + total, all + previous->firstIndex, previous->indexCount, positions, positionStride, vertexCount, target, &error);
+		if (count == 0 || count / 3 > previousTriangles - previousTriangles / 10) break;
+		meshOptimizeVertexCache(all + total, count, vertexCount);
+		// Each level is simplified from the previous one, so errors add up
+		chain->lods[chain->lodCount] = (struct MeshLod) { total, count, previous->error + error, 0 };
+		++chain->lodCount;
+		total += count;
+	}
+	return all;
+}
+
+// Selection
+
+float meshLodProjectionScale(float fovY, float viewportHeight) {
+	return viewportHeight / (2.0f * tanf(0.5f * fovY));
+}
+
+uint32_t meshLodSelect(struct MeshLodChain const * chain, float distance, float scale, float projectionScale, float pixelError) {
+	if (distance <= 0.0f) return 0;
+	float pixelsPerUnit = projectionScale * scale / distance;
+	uint32_t lod = 0;
+	// Errors grow with the level
+	while (lod + 1 < chain->lodCount && chain->lods[lod + 1].error * pixelsPerUnit <= pixelError) ++lod;
+	return lod;
+}
+
+static uint64_t selectAll(struct MeshLodInstance const * instances, uint32_t instanceCount, float projectionScale, float pixelError, uint32_t * lods) {
+	uint64_t triangles = 0;
+	for (uint32_t i = 0; i < instanceCount; ++i) {
+		struct MeshLodInstance const * instance = &instances[i];
+		lods[i] = meshLodSelect(instance->chain, instance->distance, instance->scale, projectionScale, pixelError);
+		triangles += instance->chain->lods[lods[i]].indexCount / 3;
+	}
+	return triangles;
+}
+
+float meshLodSelectBudget(struct MeshLodInstance const * instances, uint32_t instanceCount, float projectionScale, float pixelError, uint64_t triangleBudget, uint32_t * lods) {
+	if (selectAll(instances, instanceCount, projectionScale, pixelError, lods) <= triangleBudget || triangleBudget == 0) {
+		return pixelError;
+	}
+	// At the largest error of a coarsest level on screen, all instances
+	// draw their coarsest level: if that is still over the budget, it is
+	// the best that can be done, otherwise bisect down to the budget
+	float low = pixelError;
+	float high = pixelError;
+	for (uint32_t i = 0; i < instanceCount; ++i) {
+		struct MeshLodInstance const * instance = &instances[i];
+		if (instance->distance <= 0.0f) continue;
+		float coarsestError = instance->chain->lods[instance->chain->lodCount - 1].error;
+		high = fmaxf(high, coarsestError * projectionScale * instance->scale / instance->distance);
+	}
+	if (selectAll(instances, instanceCount, projectionScale, high, lods) > triangleBudget) {
+		return high;
+	}
+	for (uint32_t i = 0; i < BUDGET_ITERATIONS; ++i) {
+		float middle = 0.5f * (low + high);
+		if (selectAll(instances, instanceCount, projectionScale, middle, lods) > triangleBudget) {
+			low = middle;
+		} else {
+			high = middle;
+		}
+	}
+	selectAll(instances, instanceCount, projectionScale, high, lods);
+	return high;
+}
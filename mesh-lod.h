@@ -0,0 +1,115 @@
+/**
+ * Levels of detail of meshes: an import-time simplifier builds a chain of
+ * coarser and coarser index lists over the vertices of the mesh, and a
+ * runtime selector picks for each instance the coarsest level whose error
+ * stays below a number of pixels on screen.
+ *
+ * Simplification collapses edges in the order of their quadric error
+ * (Garland and Heckbert), in passes of independent collapses. Quadrics
+ * are area weighted and accumulated per position, so that both sides of
+ * a UV or normal seam share them, and open borders get extra quadrics
+ * that keep their shape. Vertices only ever move onto a neighbor, never
+ * to a new position, so all levels index the same vertex buffer. Vertices
+ * on seams or non-manifold edges do not move, and border vertices only
+ * move along their border; collapses that would flip a triangle are
+ * skipped.
+ *
+ * The error of a collapse is the distance from the moved vertex to the
+ * planes it accumulated, in mesh units (the square root of its
+ * area-normalized quadric error). Each level is simplified from the
+ * previous one, and its error is the largest error of its collapses plus
+ * the error of the previous level: a bound of how far its surface is from
+ * level 0, which grows with the level.
+ *
+ * Levels are concatenated in a single index list, level 0 first, and
+ * each one is optimised for the vertex cache (see mesh-optimizer.h).
+ *
+ * Typical frame:
+ *     float projectionScale = meshLodProjectionScale(fovY, viewportHeight);
+ *     for each instance i:
+ *         instances[i] = (struct MeshLodInstance) { &chain, distance, scale };
+ *     meshLodSelectBudget(instances, count, projectionScale, 1.0f, triangleBudget, lods);
+ *     for each instance i:
+ *         struct MeshLod const * lod = &chain.lods[lods[i]];
+ *         wgpuRenderPassEncoderDrawIndexed(renderPass, lod->indexCount, 1, lod->firstIndex, 0, i);
+ */
+
+#ifndef _mesh_lod_h_
+#define _mesh_lod_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MESH_LOD_MAX_LEVELS 8
+// Triangles of each level relative to the previous one
+#define MESH_LOD_RATIO 0.5f
+// The chain stops at levels smaller than this, or that simplification
+// could not reduce by at least a tenth
+#define MESH_LOD_MIN_TRIANGLES 32
+
+struct MeshLod {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error; // in mesh units
+	uint32_t _pad;
+};
+
+struct MeshLodChain {
+	uint32_t lodCount;
+	struct MeshLod lods[MESH_LOD_MAX_LEVELS];
+};
+
+/**
+ * Simplify the triangle list `indices` to `targetIndexCount` indices or
+ * as close as collapses allow, writing the result to `destination`,
+ * which must hold `indexCount` indices and may alias `indices`.
+ * `positions` points to the position (3 floats) of vertex 0, and
+ * `positionStride` is the distance in bytes between the positions of
+ * consecutive vertices. Returns the number of indices written, and the
+ * error of the result in `*error` if not NULL.
+ */
+uint32_t meshSimplify(uint32_t * destination, uint32_t const * indices, uint32_t indexCount, float const * positions, size_t positionStride, uint32_t vertexCount, uint32_t targetIndexCount, float * error);
+
+/**
+ * Build the level chain of a mesh whose level 0 is `indices`, kept as is.
+ * Returns the indices of all levels, to free, or NULL if memory runs out.
+ */
+uint32_t * meshLodBuild(uint32_t const * indices, uint32_t indexCount, float const * positions, size_t positionStride, uint32_t vertexCount, struct MeshLodChain * chain);
+
+/**
+ * Pixels covered by one mesh unit at a distance of one, for a perspective
+ * projection of vertical field of view `fovY` (radians).
+ */
+float meshLodProjectionScale(float fovY, float viewportHeight);
+
+/**
+ * Coarsest level of `chain` whose error, for an instance scaled by
+ * `scale` at `distance` from the camera, covers at most `pixelError`
+ * pixels.
+ */
+uint32_t meshLodSelect(struct MeshLodChain const * chain, float distance, float scale, float projectionScale, float pixelError);
+
+struct MeshLodInstance {
+	struct MeshLodChain const * chain;
+	float distance;
+	float scale;
+};
+
+/**
+ * Select the level of each instance with meshLodSelect, raising the
+ * pixel error of all instances alike as much as needed to draw at most
+ * `triangleBudget` triangles (0 for no budget), or until all instances
+ * draw their coarsest level. Writes the levels to `lods` and returns the
+ * pixel error used.
+ */
+float meshLodSelectBudget(struct MeshLodInstance const * instances, uint32_t instanceCount, float projectionScale, float pixelError, uint64_t triangleBudget, uint32_t * lods);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _mesh_lod_h_
@@ -0,0 +1,428 @@
+#include "mesh-optimizer.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// LRU cache the vertex cache optimisation targets, and its scoring
+// parameters, as tuned by Forsyth
+#define VERTEX_CACHE_SIZE 32
+#define LAST_TRIANGLE_SCORE 0.75f
+#define CACHE_DECAY_POWER 1.5f
+#define VALENCE_BOOST_SCALE 2.0f
+#define VALENCE_BOOST_POWER 0.5f
+#define VALENCE_TABLE_SIZE 32
+// Vertex fetch model
+#define FETCH_LINE_SIZE 64
+#define FETCH_LINE_COUNT 256
+#define NO_INDEX UINT32_MAX
+
+// Vertex cache
+
+struct VertexScoreTables {
+	float cache[VERTEX_CACHE_SIZE];
+	float valence[VALENCE_TABLE_SIZE];
+};
+
+static void initScoreTables(struct VertexScoreTables * tables) {
+	for (uint32_t i = 0; i < VERTEX_CACHE_SIZE; ++i) {
+		// The vertices of the last triangle get the same score, so that
+		// the next one does not favor any of its edges
+		tables->cache[i] = i < 3
+			? LAST_TRIANGLE_SCORE
+			: powf(1.0f - (float)(i - 3) / (float)(VERTEX_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+	}
+	tables->valence[0] = 0.0f;
+	for (uint32_t i = 1; i < VALENCE_TABLE_SIZE; ++i) {
+		tables->valence[i] = VALENCE_BOOST_SCALE * powf((float)i, -VALENCE_BOOST_POWER);
+	}
+}
+
+/**
+ * Score of a vertex at `cachePosition` (-1 when out of the cache) that
+ * still has `liveTriangles` triangles to emit. Vertices with few triangles
+ * left are boosted, to finish them off rather than leave isolated ones.
+ */
+static float vertexScore(struct VertexScoreTables const * tables, int32_t cachePosition, uint32_t liveTriangles) {
+	if (liveTriangles == 0) return -1.0f;
+	float score = cachePosition < 0 ? 0.0f : tables->cache[cachePosition];
+	return score + (liveTriangles < VALENCE_TABLE_SIZE
+		? tables->valence[liveTriangles]
+		: VALENCE_BOOST_SCALE * powf((float)liveTriangles, -VALENCE_BOOST_POWER));
+}
+
+void meshOptimizeVertexCache(uint32_t * indices, uint32_t indexCount, uint32_t vertexCount) {
+	uint32_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) return;
+
+	// Triangles around each vertex, the first liveCounts[v] of which are
+	// not emitted yet
+	uint32_t * offsets = (uint32_t *)calloc((size_t)vertexCount + 1, sizeof(uint32_t));
+	uint32_t * liveCounts = (uint32_t *)calloc(vertexCount, sizeof(uint32_t));
+	uint32_t * adjacency = (uint32_t *)malloc((size_t)triangleCount * 3 * sizeof(uint32_t));
+	int32_t * cachePositions = (int32_t *)malloc((size_t)vertexCount * sizeof(int32_t));
+	float * scores = (float *)malloc((size_t)vertexCount * sizeof(float));
+	uint8_t * emitted = (uint8_t *)calloc(triangleCount, 1);
+	uint32_t * output = (uint32_t *)malloc((size_t)triangleCount * 3 * sizeof(uint32_t));
+	if (!offsets || !liveCounts || !adjacency || !cachePositions || !scores || !emitted || !output) {
+		// Keep the input order
+		triangleCount = 0;
+	}
+
+	struct VertexScoreTables tables;
+	initScoreTables(&tables);
+	if (triangleCount > 0) {
+		for (uint32_t i = 0; i < triangleCount * 3; ++i) ++liveCounts[indices[i]];
+		for (uint32_t v = 0; v < vertexCount; ++v) {
+			offsets[v + 1] = offsets[v] + liveCounts[v];
+			liveCounts[v] = 0;
+		}
+		for (uint32_t i = 0; i < triangleCount * 3; ++i) {
+			uint32_t v = indices[i];
+			adjacency[offsets[v] + liveCounts[v]++] = i / 3;
+		}
+		for (uint32_t v = 0; v < vertexCount; ++v) {
+			cachePositions[v] = -1;
+			scores[v] = vertexScore(&tables, -1, liveCounts[v]);
+		}
+	}
+
+	uint32_t cache[VERTEX_CACHE_SIZE + 3];
+	uint32_t newCache[VERTEX_CACHE_SIZE + 3];
+	uint32_t cacheCount = 0;
+	uint32_t nextUnemitted = 0;
+	int64_t best = -1;
+	for (uint32_t out = 0; out < triangleCount; ++out) {
+		// When no triangle touches the cache, resume where the input is
+		if (best < 0) {
+			while (emitted[nextUnemitted]) ++nextUnemitted;
+			best = nextUnemitted;
+		}
+		uint32_t const * triangle = indices + 3 * best;
+		memcpy(output + 3 * out, triangle, 3 * sizeof(uint32_t));
+		emitted[best] = 1;
+		for (uint32_t c = 0; c < 3; ++c) {
+			uint32_t v = triangle[c];
+			uint32_t * around = adjacency + offsets[v];
+			for (uint32_t i = 0; i < liveCounts[v]; ++i) {
+				if (around[i] == (uint32_t)best) {
+					around[i] = around[--liveCounts[v]];
+					break;
+				}
+			}
+		}
+
+		// Move the vertices of the triangle to the front of the cache
+		uint32_t newCount = 0;
+		for (uint32_t c = 0; c < 3; ++c) {
+			uint32_t v = triangle[c];
+			bool seen = false;
+			for (uint32_t i = 0; i < newCount; ++i) seen = seen || newCache[i] == v;
+			if (!seen) newCache[newCount++] = v;
+		}
+		for (uint32_t i = 0; i < cacheCount; ++i) {
+			uint32_t v = cache[i];
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2]) newCache[newCount++] = v;
+		}
+		for (uint32_t i = VERTEX_CACHE_SIZE; i < newCount; ++i) {
+			uint32_t v = newCache[i];
+			cachePositions[v] = -1;
+			scores[v] = vertexScore(&tables, -1, liveCounts[v]);
+		}
+		cacheCount = newCount < VERTEX_CACHE_SIZE ? newCount : VERTEX_CACHE_SIZE;
+		for (uint32_t i = 0; i < cacheCount; ++i) {
+			uint32_t v = newCache[i];
+			cache[i] = v;
+			cachePositions[v] = (int32_t)i;
+			scores[v] = vertexScore(&tables, (int32_t)i, liveCounts[v]);
+		}
+
+		// Only triangles around cached vertices changed score, so the best
+		// one is among them unless none is left
+		best = -1;
+		float bestScore = -FLT_MAX;
+		for (uint32_t i = 0; i < cacheCount; ++i) {
+			uint32_t v = cache[i];
+			uint32_t const * around = adjacency + offsets[v];
+			for (uint32_t j = 0; j < liveCounts[v]; ++j) {
+				uint32_t const * candidate = indices + 3 * around[j];
+				float score = scores[candidate[0]] + scores[candidate[1]] + scores[candidate[2]];
+				if (score > bestScore) {
+					bestScore = score;
+					best = around[j];
+				}
+			}
+		}
+	}
+	if (triangleCount > 0) {
+		memcpy(indices, output, (size_t)triangleCount * 3 * sizeof(uint32_t));
+	}
+
+	free(output);
+	free(emitted);
+	free(scores);
+	free(cachePositions);
+	free(adjacency);
+	free(liveCounts);
+	free(offsets);
+}
+
+// Overdraw
+
+/**
+ * FIFO cache of `cacheSize` vertices, where a vertex is cached if it was
+ * last missed less than `cacheSize` misses ago. Increasing `*timestamp`
+ * by `cacheSize + 1` empties the cache. Returns the misses of a triangle.
+ */
+static uint32_t updateFifoCache(uint32_t const * triangle, uint32_t cacheSize, uint32_t * timestamps, uint32_t * timestamp) {
+	uint32_t misses = 0;
+	for (uint32_t c = 0; c < 3; ++c) {
+		uint32_t v = triangle[c];
+		if (*timestamp - timestamps[v] > cacheSize) {
+			timestamps[v] = (*timestamp)++;
+			++misses;
+		}
+	}
+	return misses;
+}
+
+struct ClusterKey {
+	float key;
+	uint32_t cluster;
+};
+
+static int compareClusterKeys(void const * a, void const * b) {
+	struct ClusterKey const * ka = (struct ClusterKey const *)a;
+	struct ClusterKey const * kb = (struct ClusterKey const *)b;
+	// Outward facing first, then in input order so that the result does
+	// not depend on the sort
+	if (ka->key != kb->key) return ka->key > kb->key ? -1 : 1;
+	return ka->cluster < kb->cluster ? -1 : ka->cluster > kb->cluster;
+}
+
+static float const * positionOf(float const * positions, size_t positionStride, uint32_t v) {
+	return (float const *)((char const *)positions + (size_t)v * positionStride);
+}
+
+void meshOptimizeOverdraw(uint32_t * indices, uint32_t indexCount, float const * positions, size_t positionStride, uint32_t vertexCount, float threshold) {
+	uint32_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) return;
+	uint32_t cacheSize = MESH_OPTIMIZER_ANALYSIS_CACHE_SIZE;
+
+	uint32_t * timestamps = (uint32_t *)calloc(vertexCount, sizeof(uint32_t));
+	uint32_t * hardClusters = (uint32_t *)malloc(((size_t)triangleCount + 1) * sizeof(uint32_t));
+	uint32_t * clusters = (uint32_t *)malloc(((size_t)triangleCount + 1) * sizeof(uint32_t));
+	struct ClusterKey * keys = (struct ClusterKey *)malloc((size_t)triangleCount * sizeof(struct ClusterKey));
+	uint32_t * output = (uint32_t *)malloc((size_t)triangleCount * 3 * sizeof(uint32_t));
+	if (!timestamps || !hardClusters || !clusters || !keys || !output) {
+		free(output);
+		free(keys);
+		free(clusters);
+		free(hardClusters);
+		free(timestamps);
+		return;
+	}
+
+	// A triangle missing all its vertices starts a new patch of the vertex
+	// cache order: reordering patches costs nothing in cache hits
+	uint32_t timestamp = cacheSize + 1;
+	uint32_t hardCount = 0;
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		if (updateFifoCache(indices + 3 * t, cacheSize, timestamps, &timestamp) == 3 || t == 0) {
+			hardClusters[hardCount++] = t;
+		}
+	}
+	hardClusters[hardCount] = triangleCount;
+
+	// Cut patches further, after each prefix whose ACMR is within
+	// `threshold` of the whole patch's
+	uint32_t clusterCount = 0;
+	for (uint32_t h = 0; h < hardCount; ++h) {
+		uint32_t begin = hardClusters[h];
+		uint32_t end = hardClusters[h + 1];
+		timestamp += cacheSize + 1;
+		uint32_t misses = 0;
+		for (uint32_t t = begin; t < end; ++t) {
+			misses += updateFifoCache(indices + 3 * t, cacheSize, timestamps, &timestamp);
+		}
+		float clusterThreshold = threshold * (float)misses / (float)(end - begin);
+
+		uint32_t first = clusterCount;
+		clusters[clusterCount++] = begin;
+		timestamp += cacheSize + 1;
+		uint32_t runningMisses = 0;
+		uint32_t runningTriangles = 0;
+		for (uint32_t t = begin; t < end; ++t) {
+			runningMisses += updateFifoCache(indices + 3 * t, cacheSize, timestamps, &timestamp);
+			++runningTriangles;
+			if ((float)runningMisses <= clusterThreshold * (float)runningTriangles) {
+				clusters[clusterCount++] = t + 1;
+				timestamp += cacheSize + 1;
+				runningMisses = 0;
+				runningTriangles = 0;
+			}
+		}
+		// What remains after the last cut is the worst cluster, so merge it
+		// with the previous one (or drop the empty one at the end)
+		if (clusterCount > first + 1) --clusterCount;
+	}
+	clusters[clusterCount] = triangleCount;
+
+	float meshCenter[3] = { 0.0f, 0.0f, 0.0f };
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		float const * p = positionOf(positions, positionStride, v);
+		for (uint32_t k = 0; k < 3; ++k) meshCenter[k] += p[k];
+	}
+	for (uint32_t k = 0; k < 3; ++k) meshCenter[k] /= (float)(vertexCount > 0 ? vertexCount : 1);
+
+	// Key of a cluster: how far its area weighted center is in front of
+	// the mesh center, along its average normal
+	for (uint32_t c = 0; c < clusterCount; ++c) {
+		float center[3] = { 0.0f, 0.0f, 0.0f };
+		float normal[3] = { 0.0f, 0.0f, 0.0f };
+		float area = 0.0f;
+		for (uint32_t t = clusters[c]; t < clusters[c + 1]; ++t) {
+			float const * p0 = positionOf(positions, positionStride, indices[3 * t + 0]);
+			float const * p1 = positionOf(positions, positionStride, indices[3 * t + 1]);
+			float const * p2 = positionOf(positions, positionStride, indices[3 * t + 2]);
+			float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float n[3] = {
+				e1[1] * e2[2] - e1[2] * e2[1],
+				e1[2] * e2[0] - e1[0] * e2[2],
+				e1[0] * e2[1] - e1[1] * e2[0],
+			};
+			float triangleArea = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (uint32_t k = 0; k < 3; ++k) {
+				center[k] += (p0[k] + p1[k] + p2[k]) * (triangleArea / 3.0f);
+				normal[k] += n[k];
+			}
+			area += triangleArea;
+		}
+		float normalLength = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		float key = 0.0f;
+		if (area > 0.0f && normalLength > 0.0f) {
+			for (uint32_t k = 0; k < 3; ++k) {
+				key += (center[k] / area - meshCenter[k]) * (normal[k] / normalLength);
+			}
+		}
+		keys[c] = (struct ClusterKey) { key, c };
+	}
+	qsort(keys, clusterCount, sizeof(struct ClusterKey), compareClusterKeys);
+
+	uint32_t out = 0;
+	for (uint32_t i = 0; i < clusterCount; ++i) {
+		uint32_t c = keys[i].cluster;
+		uint32_t count = clusters[c + 1] - clusters[c];
+		memcpy(output + 3 * out, indices + 3 * clusters[c], (size_t)count * 3 * sizeof(uint32_t));
+		out += count;
+	}
+	memcpy(indices, output, (size_t)triangleCount * 3 * sizeof(uint32_t));
+
+	free(output);
+	free(keys);
+	free(clusters);
+	free(hardClusters);
+	free(timestamps);
+}
+
+// Vertex fetch
+
+uint32_t meshOptimizeVertexFetch(void * vertices, size_t vertexSize, uint32_t vertexCount, uint32_t * indices, uint32_t indexCount) {
+	uint32_t * remap = (uint32_t *)malloc((size_t)vertexCount * sizeof(uint32_t));
+	if (!remap) return vertexCount;
+	memset(remap, 0xff, (size_t)vertexCount * sizeof(uint32_t));
+	uint32_t newCount = 0;
+	for (uint32_t i = 0; i < indexCount; ++i) {
+		if (remap[indices[i]] == NO_INDEX) remap[indices[i]] = newCount++;
+	}
+	char * reordered = (char *)malloc((size_t)newCount * vertexSize);
+	if (!reordered) {
+		free(remap);
+		return vertexCount;
+	}
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		if (remap[v] != NO_INDEX) {
+			memcpy(reordered + (size_t)remap[v] * vertexSize, (char const *)vertices + (size_t)v * vertexSize, vertexSize);
+		}
+	}
+	memcpy(vertices, reordered, (size_t)newCount * vertexSize);
+	for (uint32_t i = 0; i < indexCount; ++i) indices[i] = remap[indices[i]];
+	free(reordered);
+	free(remap);
+	return newCount;
+}
+
+void meshOptimize(struct ObjMesh * mesh) {
+	if (mesh->indexCount == 0) return;
+	meshOptimizeVertexCache(mesh->indices, mesh->indexCount, mesh->vertexCount);
+	meshOptimizeOverdraw(mesh->indices, mesh->indexCount, mesh->vertices[0].position, sizeof(struct ObjVertex), mesh->vertexCount, MESH_OPTIMIZER_OVERDRAW_THRESHOLD);
+	mesh->vertexCount = meshOptimizeVertexFetch(mesh->vertices, sizeof(struct ObjVertex), mesh->vertexCount, mesh->indices, mesh->indexCount);
+}
+
+// Analysis
+
+struct MeshVertexCacheStatistics meshAnalyzeVertexCache(uint32_t const * indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize) {
+	struct MeshVertexCacheStatistics stats = (struct MeshVertexCacheStatistics) {};
+	uint32_t triangleCount = indexCount / 3;
+	uint32_t * timestamps = (uint32_t *)calloc(vertexCount, sizeof(uint32_t));
+	if (triangleCount == 0 || !timestamps) {
+		free(timestamps);
+		return stats;
+	}
+	uint32_t timestamp = cacheSize + 1;
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		stats.vertexTransforms += updateFifoCache(indices + 3 * t, cacheSize, timestamps, &timestamp);
+	}
+	stats.acmr = (float)stats.vertexTransforms / (float)triangleCount;
+	stats.atvr = vertexCount > 0 ? (float)stats.vertexTransforms / (float)vertexCount : 0.0f;
+	free(timestamps);
+	return stats;
+}
+
+struct MeshVertexFetchStatistics meshAnalyzeVertexFetch(uint32_t const * indices, uint32_t indexCount, uint32_t vertexCount, size_t vertexSize) {
+	struct MeshVertexFetchStatistics stats = (struct MeshVertexFetchStatistics) {};
+	uint32_t cacheSize = MESH_OPTIMIZER_ANALYSIS_CACHE_SIZE;
+	uint32_t * timestamps = (uint32_t *)calloc(vertexCount, sizeof(uint32_t));
+	if (indexCount < 3 || !timestamps) {
+		free(timestamps);
+		return stats;
+	}
+	// Direct mapped cache of lines
+	uint64_t lines[FETCH_LINE_COUNT];
+	memset(lines, 0xff, sizeof(lines));
+	uint32_t timestamp = cacheSize + 1;
+	for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+		for (uint32_t c = 0; c < 3; ++c) {
+			uint32_t v = indices[i + c];
+			// Only transformed vertices are fetched
+			if (timestamp - timestamps[v] <= cacheSize) continue;
+			timestamps[v] = timestamp++;
+			uint64_t begin = (uint64_t)v * vertexSize / FETCH_LINE_SIZE;
+			uint64_t end = ((uint64_t)v * vertexSize + vertexSize - 1) / FETCH_LINE_SIZE;
+			for (uint64_t line = begin; line <= end; ++line) {
+				if (lines[line % FETCH_LINE_COUNT] != line) {
+					lines[line % FETCH_LINE_COUNT] = line;
+					stats.bytesFetched += FETCH_LINE_SIZE;
+				}
+			}
+		}
+	}
+	uint64_t bufferSize = (uint64_t)vertexCount * vertexSize;
+	stats.overfetch = bufferSize > 0 ? (float)((double)stats.bytesFetched / (double)bufferSize) : 0.0f;
+	free(timestamps);
+	return stats;
+}
+
+// Index format
+
+WGPUIndexFormat meshIndexFormat(uint32_t vertexCount) {
+	return vertexCount < 65536 ? WGPUIndexFormat_Uint16 : WGPUIndexFormat_Uint32;
+}
+
+void meshPackIndices16(uint16_t * destination, uint32_t const * indices, uint32_t indexCount) {
+	// Forward, so that packing in place never overwrites unread indices
+	for (uint32_t i = 0; i < indexCount; ++i) destination[i] = (uint16_t)indices[i];
+}
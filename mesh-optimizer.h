@@ -0,0 +1,111 @@
+/**
+ * Import-time optimisation of indexed triangle meshes, so that they reach
+ * the GPU in an order that suits it rather than in the order of the file.
+ *
+ * Three passes are meant to run in this order:
+ *  1. meshOptimizeVertexCache reorders triangles so that consecutive ones
+ *     share vertices, which the GPU then finds in its post-transform
+ *     cache instead of shading them again (Forsyth's linear-speed vertex
+ *     cache optimisation, with an LRU cache of 32 entries).
+ *  2. meshOptimizeOverdraw cuts this order into clusters wherever it
+ *     costs little in cache hits, then sorts clusters so that the ones
+ *     facing away from the center of the mesh, which tend to occlude the
+ *     others, are drawn first (Sander et al., "Fast Triangle Reordering
+ *     for Vertex Locality and Reduced Overdraw").
+ *  3. meshOptimizeVertexFetch renumbers vertices in the order triangles
+ *     first use them, so that the vertex buffer is read sequentially.
+ *
+ * meshAnalyzeVertexCache and meshAnalyzeVertexFetch measure the result
+ * with a simple model of the hardware. Index buffers should then use
+ * meshIndexFormat, i.e. 16-bit indices when there are few enough vertices.
+ *
+ * Typical use:
+ *     struct ObjMesh * mesh = objMeshLoad("suzanne.obj", 0);
+ *     meshOptimize(mesh);
+ *     if (meshIndexFormat(mesh->vertexCount) == WGPUIndexFormat_Uint16) {
+ *         meshPackIndices16(indices16, mesh->indices, mesh->indexCount);
+ *     }
+ */
+
+#ifndef _mesh_optimizer_h_
+#define _mesh_optimizer_h_
+
+#include <webgpu/webgpu.h>
+#include "obj-loader.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Post-transform cache model of the analysis: FIFO of 16 vertices
+#define MESH_OPTIMIZER_ANALYSIS_CACHE_SIZE 16
+// Maximum ratio between the ACMR of an overdraw cluster and the one of
+// the vertex cache order it is cut from
+#define MESH_OPTIMIZER_OVERDRAW_THRESHOLD 1.05f
+
+struct MeshVertexCacheStatistics {
+	uint32_t vertexTransforms; // post-transform cache misses
+	float acmr; // transforms per triangle, 0.5 at best, 3 at worst
+	float atvr; // transforms per vertex, 1 at best
+};
+
+struct MeshVertexFetchStatistics {
+	uint64_t bytesFetched;
+	float overfetch; // bytes fetched per byte of vertex buffer, 1 at best
+};
+
+/**
+ * Reorder the triangles of a triangle list, in place, for the
+ * post-transform vertex cache.
+ */
+void meshOptimizeVertexCache(uint32_t * indices, uint32_t indexCount, uint32_t vertexCount);
+
+/**
+ * Reorder clusters of triangles of a list optimised by
+ * meshOptimizeVertexCache, in place, to reduce overdraw. `positions`
+ * points to the position (3 floats) of vertex 0, and `positionStride` is
+ * the distance in bytes between the positions of consecutive vertices.
+ * `threshold` is how much worse than the input each cluster's ACMR may
+ * get, e.g. MESH_OPTIMIZER_OVERDRAW_THRESHOLD.
+ */
+void meshOptimizeOverdraw(uint32_t * indices, uint32_t indexCount, float const * positions, size_t positionStride, uint32_t vertexCount, float threshold);
+
+/**
+ * Renumber the vertices of a mesh, in place, in the order of their first
+ * use by `indices`, dropping the unused ones. Returns the new number of
+ * vertices.
+ */
+uint32_t meshOptimizeVertexFetch(void * vertices, size_t vertexSize, uint32_t vertexCount, uint32_t * indices, uint32_t indexCount);
+
+/**
+ * Run the three passes above on a loaded mesh.
+ */
+void meshOptimize(struct ObjMesh * mesh);
+
+struct MeshVertexCacheStatistics meshAnalyzeVertexCache(uint32_t const * indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize);
+
+/**
+ * Model of the vertex fetch of the post-transform cache misses through a
+ * 16 KB cache of 64-byte lines.
+ */
+struct MeshVertexFetchStatistics meshAnalyzeVertexFetch(uint32_t const * indices, uint32_t indexCount, uint32_t vertexCount, size_t vertexSize);
+
+/**
+ * Smallest index format that can address `vertexCount` vertices.
+ */
+WGPUIndexFormat meshIndexFormat(uint32_t vertexCount);
+
+/**
+ * Convert indices that are all below 65536 to 16 bits. `destination` may
+ * alias `indices`.
+ */
+void meshPackIndices16(uint16_t * destination, uint32_t const * indices, uint32_t indexCount);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _mesh_optimizer_h_
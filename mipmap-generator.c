@@ -0,0 +1,466 @@
+#include "mipmap-generator.h"
+#include "webgpu-utils.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PARAMS_SLOT_SIZE 256
+
+// Storage texture bindings depend on the format, the rest of the shader
+// does not.
+static const char* mipmapBindingsTemplate = "\
+@group(0) @binding(0) var src: texture_2d<f32>;\n\
+@group(0) @binding(1) var dst1: texture_storage_2d<%s, write>;\n\
+@group(0) @binding(2) var dst2: texture_storage_2d<%s, write>;\n\
+@group(0) @binding(3) var dst3: texture_storage_2d<%s, write>;\n\
+@group(0) @binding(4) var dst4: texture_storage_2d<%s, write>;\n\
+";
+
+static const char* mipmapShaderSource = "\
+struct Params {\n\
+    levelCount: u32,\n\
+    srgb: u32,\n\
+}\n\
+@group(0) @binding(5) var<uniform> params: Params;\n\
+\n\
+// Level being reduced, 8 values apart between rows\n\
+var<workgroup> tile: array<vec4f, 64>;\n\
+\n\
+fn toLinear(c: vec4f) -> vec4f {\n\
+    if (params.srgb == 0u) { return c; }\n\
+    let rgb = select(pow((c.rgb + 0.055) / 1.055, vec3f(2.4)), c.rgb / 12.92, c.rgb <= vec3f(0.04045));\n\
+    return vec4f(rgb, c.a);\n\
+}\n\
+\n\
+fn fromLinear(c: vec4f) -> vec4f {\n\
+    if (params.srgb == 0u) { return c; }\n\
+    let rgb = select(1.055 * pow(c.rgb, vec3f(1.0 / 2.4)) - 0.055, c.rgb * 12.92, c.rgb <= vec3f(0.0031308));\n\
+    return vec4f(rgb, c.a);\n\
+}\n\
+\n\
+// Weights of source texels 2i, 2i+1 and 2i+2 in destination texel i along\n\
+// an axis. Odd sizes cover 2 + 1/dstSize texels per destination texel.\n\
+fn weights(i: i32, srcSize: i32, dstSize: i32) -> vec3f {\n\
+    if (srcSize == 1) { return vec3f(1.0, 0.0, 0.0); }\n\
+    if (srcSize == 2 * dstSize) { return vec3f(0.5, 0.5, 0.0); }\n\
+    let n = f32(srcSize);\n\
+    return vec3f(f32(dstSize - i) / n, f32(dstSize) / n, f32(i + 1) / n);\n\
+}\n\
+\n\
+fn store(level: u32, p: vec2i, color: vec4f) {\n\
+    let c = fromLinear(color);\n\
+    switch level {\n\
+        case 1u: { if (all(p < vec2i(textureDimensions(dst1)))) { textureStore(dst1, p, c); } }\n\
+        case 2u: { if (all(p < vec2i(textureDimensions(dst2)))) { textureStore(dst2, p, c); } }\n\
+        case 3u: { if (all(p < vec2i(textureDimensions(dst3)))) { textureStore(dst3, p, c); } }\n\
+        default: { if (all(p < vec2i(textureDimensions(dst4)))) { textureStore(dst4, p, c); } }\n\
+    }\n\
+}\n\
+\n\
+@compute @workgroup_size(8, 8)\n\
+fn main(@builtin(workgroup_id) wid: vec3u, @builtin(local_invocation_id) lid: vec3u) {\n\
+    let srcSize = vec2i(textureDimensions(src, 0));\n\
+    let dstSize = vec2i(textureDimensions(dst1));\n\
+    let p = vec2i(wid.xy * 8u + lid.xy);\n\
+    let wx = weights(p.x, srcSize.x, dstSize.x);\n\
+    let wy = weights(p.y, srcSize.y, dstSize.y);\n\
+    var color = vec4f(0.0);\n\
+    for (var j = 0; j < 3; j++) {\n\
+        for (var i = 0; i < 3; i++) {\n\
+            let w = wx[i] * wy[j];\n\
+            if (w > 0.0) {\n\
+                let q = clamp(2 * p + vec2i(i, j), vec2i(0), srcSize - 1);\n\
+                color += w * toLinear(textureLoad(src, q, 0));\n\
+            }\n\
+        }\n\
+    }\n\
+    store(1u, p, color);\n\
+    tile[lid.x + 8u * lid.y] = color;\n\
+\n\
+    // Following levels are exact halves (checked on the CPU), so each of\n\
+    // their texels only depends on texels of this workgroup.\n\
+    var size = 8u;\n\
+    for (var level = 2u; level <= params.levelCount; level++) {\n\
+        workgroupBarrier();\n\
+        size = size / 2u;\n\
+        let active = lid.x < size && lid.y < size;\n\
+        var c = vec4f(0.0);\n\
+        if (active) {\n\
+            let b = 2u * lid.x + 16u * lid.y;\n\
+            c = 0.25 * (tile[b] + tile[b + 1u] + tile[b + 8u] + tile[b + 9u]);\n\
+        }\n\
+        workgroupBarrier();\n\
+        if (active) {\n\
+            tile[lid.x + 8u * lid.y] = c;\n\
+            store(level, vec2i(wid.xy * size + lid.xy), c);\n\
+        }\n\
+    }\n\
+}\n\
+";
+
+static bool storageFormatOf(WGPUTextureFormat format, enum MipmapStorageFormat * storageFormat, bool * srgb) {
+	*srgb = false;
+	switch (format) {
+	case WGPUTextureFormat_RGBA8UnormSrgb:
+		*srgb = true;
+		*storageFormat = MipmapStorageFormat_RGBA8Unorm;
+		return true;
+	case WGPUTextureFormat_RGBA8Unorm:
+		*storageFormat = MipmapStorageFormat_RGBA8Unorm;
+		return true;
+	case WGPUTextureFormat_RGBA16Float:
+		*storageFormat = MipmapStorageFormat_RGBA16Float;
+		return true;
+	case WGPUTextureFormat_RGBA32Float:
+		*storageFormat = MipmapStorageFormat_RGBA32Float;
+		return true;
+	default:
+		return false;
+	}
+}
+
+static WGPUTextureFormat textureFormatOf(enum MipmapStorageFormat storageFormat) {
+	switch (storageFormat) {
+	case MipmapStorageFormat_RGBA16Float: return WGPUTextureFormat_RGBA16Float;
+	case MipmapStorageFormat_RGBA32Float: return WGPUTextureFormat_RGBA32Float;
+	default: return WGPUTextureFormat_RGBA8Unorm;
+	}
+}
+
+static char const * wgslFormatOf(enum MipmapStorageFormat storageFormat) {
+	switch (storageFormat) {
+	case MipmapStorageFormat_RGBA16Float: return "rgba16float";
+	case MipmapStorageFormat_RGBA32Float: return "rgba32float";
+	default: return "rgba8unorm";
+	}
+}
+
+uint32_t mipmapLevelCount(uint32_t width, uint32_t height) {
+	uint32_t size = width > height ? width : height;
+	uint32_t count = 1;
+	while (size > 1) {
+		size >>= 1;
+		++count;
+	}
+	return count;
+}
+
+static uint32_t levelSize(uint32_t size, uint32_t level) {
+	uint32_t s = size >> level;
+	return s > 0 ? s : 1;
+}
+
+// CPU chains
+
+#define LINEAR_TO_SRGB_SIZE 4096
+
+uint64_t mipmapChainSize(uint32_t width, uint32_t height) {
+	uint64_t bytes = 0;
+	for (uint32_t level = 0; level < mipmapLevelCount(width, height); ++level) {
+		bytes += (uint64_t)levelSize(width, level) * levelSize(height, level) * 4;
+	}
+	return bytes;
+}
+
+void mipmapBuildChain(uint8_t * chain, uint32_t width, uint32_t height, bool srgb) {
+	// Small enough to build per chain, which takes far longer
+	float toLinear[256];
+	uint8_t toSrgb[LINEAR_TO_SRGB_SIZE];
+	if (srgb) {
+		for (uint32_t i = 0; i < 256; ++i) {
+			float c = (float)i / 255.0f;
+			toLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (uint32_t i = 0; i < LINEAR_TO_SRGB_SIZE; ++i) {
+			float l = (float)i / (float)(LINEAR_TO_SRGB_SIZE - 1);
+			float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+			toSrgb[i] = (uint8_t)(c * 255.0f + 0.5f);
+		}
+	}
+
+	uint32_t levelCount = mipmapLevelCount(width, height);
+	uint8_t const * source = chain;
+	for (uint32_t level = 1; level < levelCount; ++level) {
+		uint32_t sourceWidth = levelSize(width, level - 1);
+		uint32_t sourceHeight = levelSize(height, level - 1);
+		uint32_t levelWidth = levelSize(width, level);
+		uint32_t levelHeight = levelSize(height, level);
+		uint8_t * destination = (uint8_t *)source + (size_t)sourceWidth * sourceHeight * 4;
+		for (uint32_t y = 0; y < levelHeight; ++y) {
+			uint8_t const * row0 = source + (size_t)(2 * y < sourceHeight ? 2 * y : sourceHeight - 1) * sourceWidth * 4;
+			uint8_t const * row1 = source + (size_t)(2 * y + 1 < sourceHeight ? 2 * y + 1 : sourceHeight - 1) * sourceWidth * 4;
+			uint8_t * out = destination + (size_t)y * levelWidth * 4;
+			for (uint32_t x = 0; x < levelWidth; ++x) {
+				uint32_t x0 = 4 * (2 * x < sourceWidth ? 2 * x : sourceWidth - 1);
+				uint32_t x1 = 4 * (2 * x + 1 < sourceWidth ? 2 * x + 1 : sourceWidth - 1);
+				for (uint32_t c = 0; c < 4; ++c) {
+					if (srgb && c < 3) {
+						float linear = 0.25f * (toLinear[row0[x0 + c]] + toLinear[row0[x1 + c]] + toLinear[row1[x0 + c]] + toLinear[row1[x1 + c]]);
+						out[4 * x + c] = toSrgb[(uint32_t)(linear * (LINEAR_TO_SRGB_SIZE - 1) + 0.5f)];
+					} else {
+						out[4 * x + c] = (uint8_t)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+					}
+				}
+			}
+		}
+		source = destination;
+	}
+}
+
+struct MipmapGenerator * mipmapGeneratorCreate(WGPUDevice device) {
+	struct MipmapGenerator * generator = (struct MipmapGenerator *)calloc(1, sizeof(struct MipmapGenerator));
+	generator->device = device;
+	generator->queue = wgpuDeviceGetQueue(device);
+
+	uint32_t slotCount = 2 * MIPMAP_LEVELS_PER_DISPATCH;
+	generator->paramsBuffer = createBuffer(device, slotCount * PARAMS_SLOT_SIZE, WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst, "Mipmap params");
+	uint8_t params[2 * MIPMAP_LEVELS_PER_DISPATCH * PARAMS_SLOT_SIZE];
+	memset(params, 0, sizeof(params));
+	for (uint32_t srgb = 0; srgb < 2; ++srgb) {
+		for (uint32_t levelCount = 1; levelCount <= MIPMAP_LEVELS_PER_DISPATCH; ++levelCount) {
+			uint32_t * slot = (uint32_t *)(params + (srgb * MIPMAP_LEVELS_PER_DISPATCH + levelCount - 1) * PARAMS_SLOT_SIZE);
+			slot[0] = levelCount;
+			slot[1] = srgb;
+		}
+	}
+	wgpuQueueWriteBuffer(generator->queue, generator->paramsBuffer, 0, params, sizeof(params));
+	return generator;
+}
+
+static WGPUTextureView createLevelView(WGPUTexture texture, WGPUTextureFormat format, uint32_t level, uint32_t layer) {
+	WGPUTextureViewDescriptor viewDesc = (WGPUTextureViewDescriptor) {};
+	viewDesc.nextInChain = NULL;
+	viewDesc.label = "Mip level";
+	viewDesc.format = format;
+	viewDesc.dimension = WGPUTextureViewDimension_2D;
+	viewDesc.baseMipLevel = level;
+	viewDesc.mipLevelCount = 1;
+	viewDesc.baseArrayLayer = layer;
+	viewDesc.arrayLayerCount = 1;
+	viewDesc.aspect = WGPUTextureAspect_All;
+	return wgpuTextureCreateView(texture, &viewDesc);
+}
+
+static struct MipmapPipeline * getPipeline(struct MipmapGenerator * generator, enum MipmapStorageFormat storageFormat) {
+	struct MipmapPipeline * p = &generator->pipelines[storageFormat];
+	if (p->pipeline) return p;
+
+	WGPUTextureFormat format = textureFormatOf(storageFormat);
+	WGPUBindGroupLayoutEntry entries[2 + MIPMAP_LEVELS_PER_DISPATCH];
+	entries[0] = (WGPUBindGroupLayoutEntry) {};
+	entries[0].binding = 0;
+	entries[0].visibility = WGPUShaderStage_Compute;
+	entries[0].texture.sampleType = WGPUTextureSampleType_UnfilterableFloat;
+	entries[0].texture.viewDimension = WGPUTextureViewDimension_2D;
+	entries[0].texture.multisampled = false;
+	for (uint32_t i = 1; i <= MIPMAP_LEVELS_PER_DISPATCH; ++i) {
+		entries[i] = (WGPUBindGroupLayoutEntry) {};
+		entries[i].binding = i;
+		entries[i].visibility = WGPUShaderStage_Compute;
+		entries[i].storageTexture.access = WGPUStorageTextureAccess_WriteOnly;
+		entries[i].storageTexture.format = format;
+		entries[i].storageTexture.viewDimension = WGPUTextureViewDimension_2D;
+	}
+	entries[1 + MIPMAP_LEVELS_PER_DISPATCH] = bufferLayoutEntry(1 + MIPMAP_LEVELS_PER_DISPATCH, WGPUShaderStage_Compute, WGPUBufferBindingType_Uniform, true);
+
+	WGPUBindGroupLayoutDescriptor layoutDesc = (WGPUBindGroupLayoutDescriptor) {};
+	layoutDesc.nextInChain = NULL;
+	layoutDesc.label = "Mipmap generation";
+	layoutDesc.entryCount = 2 + MIPMAP_LEVELS_PER_DISPATCH;
+	layoutDesc.entries = entries;
+	p->layout = wgpuDeviceCreateBindGroupLayout(generator->device, &layoutDesc);
+
+	char const * wgslFormat = wgslFormatOf(storageFormat);
+	size_t bindingsSize = strlen(mipmapBindingsTemplate) + 4 * strlen(wgslFormat);
+	size_t sourceSize = bindingsSize + strlen(mipmapShaderSource) + 1;
+	char * source = (char *)malloc(sourceSize);
+	int written = snprintf(source, sourceSize, mipmapBindingsTemplate, wgslFormat, wgslFormat, wgslFormat, wgslFormat);
+	memcpy(source + written, mipmapShaderSource, strlen(mipmapShaderSource) + 1);
+
+	WGPUShaderModule module = createWGSLShaderModule(generator->device, source, "Mipmap generation");
+	WGPUPipelineLayout pipelineLayout = createSingleGroupPipelineLayout(generator->device, p->layout, "Mipmap generation");
+	p->pipeline = createComputePipeline(generator->device, pipelineLayout, module, "main", "Mipmap generation");
+	wgpuPipelineLayoutRelease(pipelineLayout);
+	wgpuShaderModuleRelease(module);
+	free(source);
+
+	WGPUTextureDescriptor dummyDesc = (WGPUTextureDescriptor) {};
+	dummyDesc.nextInChain = NULL;
+	dummyDesc.label = "Mipmap dummy";
+	dummyDesc.usage = WGPUTextureUsage_StorageBinding;
+	dummyDesc.dimension = WGPUTextureDimension_2D;
+	dummyDesc.size = (WGPUExtent3D) { 1, 1, MIPMAP_LEVELS_PER_DISPATCH };
+	dummyDesc.format = format;
+	dummyDesc.mipLevelCount = 1;
+	dummyDesc.sampleCount = 1;
+	dummyDesc.viewFormatCount = 0;
+	dummyDesc.viewFormats = NULL;
+	p->dummyTexture = wgpuDeviceCreateTexture(generator->device, &dummyDesc);
+	for (uint32_t i = 0; i < MIPMAP_LEVELS_PER_DISPATCH; ++i) {
+		p->dummyViews[i] = createLevelView(p->dummyTexture, format, 0, i);
+	}
+	return p;
+}
+
+/**
+ * Generate the chain of a texture that can be bound as storage.
+ */
+static void encodeChain(struct MipmapGenerator * generator, WGPUCommandEncoder encoder, struct MipmapPipeline * p, WGPUTexture texture, WGPUTextureFormat format, WGPUTextureDescriptor const * desc, bool srgb) {
+	uint32_t width = desc->size.width;
+	uint32_t height = desc->size.height;
+	uint32_t mipLevelCount = desc->mipLevelCount;
+
+	WGPUComputePassDescriptor passDesc = (WGPUComputePassDescriptor) {};
+	passDesc.nextInChain = NULL;
+	passDesc.label = "Mipmap generation";
+	passDesc.timestampWriteCount = 0;
+	passDesc.timestampWrites = NULL;
+	WGPUComputePassEncoder pass = wgpuCommandEncoderBeginComputePass(encoder, &passDesc);
+	wgpuComputePassEncoderSetPipeline(pass, p->pipeline);
+
+	for (uint32_t layer = 0; layer < desc->size.depthOrArrayLayers; ++layer) {
+		uint32_t base = 0;
+		while (base + 1 < mipLevelCount) {
+			// Chain levels as long as the next one is an exact half of the
+			// previous, which the workgroup reduction assumes.
+			uint32_t levelCount = 1;
+			while (levelCount < MIPMAP_LEVELS_PER_DISPATCH && base + levelCount + 1 < mipLevelCount) {
+				uint32_t w = levelSize(width, base + levelCount);
+				uint32_t h = levelSize(height, base + levelCount);
+				if (w % 2 != 0 || h % 2 != 0) break;
+				++levelCount;
+			}
+
+			WGPUBindGroupEntry bindings[2 + MIPMAP_LEVELS_PER_DISPATCH];
+			WGPUTextureView views[1 + MIPMAP_LEVELS_PER_DISPATCH];
+			for (uint32_t i = 0; i <= MIPMAP_LEVELS_PER_DISPATCH; ++i) {
+				views[i] = i <= levelCount ? createLevelView(texture, format, base + i, layer) : NULL;
+				bindings[i] = (WGPUBindGroupEntry) {};
+				bindings[i].binding = i;
+				bindings[i].textureView = views[i] ? views[i] : p->dummyViews[i - 1];
+			}
+			bindings[1 + MIPMAP_LEVELS_PER_DISPATCH] = bufferBindGroupEntry(1 + MIPMAP_LEVELS_PER_DISPATCH, generator->paramsBuffer, 0, 2 * sizeof(uint32_t));
+
+			WGPUBindGroupDescriptor bindGroupDesc = (WGPUBindGroupDescriptor) {};
+			bindGroupDesc.nextInChain = NULL;
+			bindGroupDesc.label = "Mipmap generation";
+			bindGroupDesc.layout = p->layout;
+			bindGroupDesc.entryCount = 2 + MIPMAP_LEVELS_PER_DISPATCH;
+			bindGroupDesc.entries = bindings;
+			WGPUBindGroup bindGroup = wgpuDeviceCreateBindGroup(generator->device, &bindGroupDesc);
+
+			uint32_t paramsOffset = ((srgb ? MIPMAP_LEVELS_PER_DISPATCH : 0) + levelCount - 1) * PARAMS_SLOT_SIZE;
+			wgpuComputePassEncoderSetBindGroup(pass, 0, bindGroup, 1, &paramsOffset);
+			uint32_t dstWidth = levelSize(width, base + 1);
+			uint32_t dstHeight = levelSize(height, base + 1);
+			wgpuComputePassEncoderDispatchWorkgroups(pass, (dstWidth + 7) / 8, (dstHeight + 7) / 8, 1);
+
+			// Encoded commands keep what they use alive
+			wgpuBindGroupRelease(bindGroup);
+			for (uint32_t i = 0; i <= levelCount; ++i) {
+				wgpuTextureViewRelease(views[i]);
+			}
+			base += levelCount;
+		}
+	}
+
+	wgpuComputePassEncoderEnd(pass);
+	wgpuComputePassEncoderRelease(pass);
+}
+
+bool mipmapGeneratorEncode(struct MipmapGenerator * generator, WGPUCommandEncoder encoder, WGPUTexture texture, WGPUTextureDescriptor const * desc) {
+	if (desc->mipLevelCount <= 1) return true;
+	enum MipmapStorageFormat storageFormat;
+	bool srgb;
+	if (desc->dimension != WGPUTextureDimension_2D || !storageFormatOf(desc->format, &storageFormat, &srgb)) {
+		fprintf(stderr, "Mipmap generation does not support texture '%s' (format %d)\n", desc->label ? desc->label : "", desc->format);
+		return false;
+	}
+	struct MipmapPipeline * p = getPipeline(generator, storageFormat);
+	if (!p->pipeline) return false;
+
+	if (!srgb) {
+		encodeChain(generator, encoder, p, texture, desc->format, desc, false);
+		return true;
+	}
+
+	// sRGB formats cannot be storage textures: reduce a copy of the raw
+	// bytes in a linear-format scratch texture, decoding in the shader.
+	WGPUTextureDescriptor scratchDesc = *desc;
+	scratchDesc.nextInChain = NULL;
+	scratchDesc.label = "Mipmap scratch";
+	scratchDesc.usage = WGPUTextureUsage_StorageBinding | WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopySrc | WGPUTextureUsage_CopyDst;
+	scratchDesc.format = textureFormatOf(storageFormat);
+	scratchDesc.viewFormatCount = 0;
+	scratchDesc.viewFormats = NULL;
+	WGPUTexture scratch = wgpuDeviceCreateTexture(generator->device, &scratchDesc);
+
+	WGPUImageCopyTexture source = (WGPUImageCopyTexture) {};
+	source.texture = texture;
+	source.mipLevel = 0;
+	source.origin = (WGPUOrigin3D) { 0, 0, 0 };
+	source.aspect = WGPUTextureAspect_All;
+	WGPUImageCopyTexture destination = source;
+	destination.texture = scratch;
+	wgpuCommandEncoderCopyTextureToTexture(encoder, &source, &destination, &desc->size);
+
+	encodeChain(generator, encoder, p, scratch, scratchDesc.format, &scratchDesc, true);
+
+	for (uint32_t level = 1; level < desc->mipLevelCount; ++level) {
+		source.texture = scratch;
+		source.mipLevel = level;
+		destination.texture = texture;
+		destination.mipLevel = level;
+		WGPUExtent3D size = { levelSize(desc->size.width, level), levelSize(desc->size.height, level), desc->size.depthOrArrayLayers };
+		wgpuCommandEncoderCopyTextureToTexture(encoder, &source, &destination, &size);
+	}
+	wgpuTextureRelease(scratch);
+	return true;
+}
+
+bool mipmapGeneratorUpload(struct MipmapGenerator * generator, struct SubmitScheduler * scheduler, WGPUTexture texture, WGPUTextureDescriptor const * desc, void const * data, size_t dataSize, uint32_t bytesPerRow) {
+	WGPUImageCopyTexture destination = (WGPUImageCopyTexture) {};
+	destination.texture = texture;
+	destination.mipLevel = 0;
+	destination.origin = (WGPUOrigin3D) { 0, 0, 0 };
+	destination.aspect = WGPUTextureAspect_All;
+	WGPUTextureDataLayout layout = (WGPUTextureDataLayout) {};
+	layout.offset = 0;
+	layout.bytesPerRow = bytesPerRow;
+	layout.rowsPerImage = desc->size.height;
+	wgpuQueueWriteTexture(generator->queue, &destination, data, dataSize, &layout, &desc->size);
+
+	WGPUCommandEncoderDescriptor encoderDesc = (WGPUCommandEncoderDescriptor) {};
+	encoderDesc.nextInChain = NULL;
+	encoderDesc.label = "Mipmap generation";
+	WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(generator->device, &encoderDesc);
+	bool success = mipmapGeneratorEncode(generator, encoder, texture, desc);
+	WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, NULL);
+	wgpuCommandEncoderRelease(encoder);
+	if (scheduler) {
+		submitSchedulerEnqueue(scheduler, SubmitStage_Upload, command);
+	} else {
+		wgpuQueueSubmit(generator->queue, 1, &command);
+		wgpuCommandBufferRelease(command);
+	}
+	return success;
+}
+
+void mipmapGeneratorRelease(struct MipmapGenerator * generator) {
+	if (!generator) return;
+	for (int i = 0; i < MipmapStorageFormat_Count; ++i) {
+		struct MipmapPipeline * p = &generator->pipelines[i];
+		if (!p->layout) continue;
+		for (uint32_t j = 0; j < MIPMAP_LEVELS_PER_DISPATCH; ++j) {
+			wgpuTextureViewRelease(p->dummyViews[j]);
+		}
+		wgpuTextureRelease(p->dummyTexture);
+		if (p->pipeline) wgpuComputePipelineRelease(p->pipeline);
+		wgpuBindGroupLayoutRelease(p->layout);
+	}
+	wgpuBufferRelease(generator->paramsBuffer);
+	wgpuQueueRelease(generator->queue);
+	free(generator);
+}
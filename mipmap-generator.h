@@ -0,0 +1,108 @@
+/**
+ * GPU mipmap generation.
+ *
+ * Fills mip levels 1 and up of a 2D texture (or of each layer of a 2D
+ * array) from level 0 with a compute shader, typically right after
+ * uploading level 0 with wgpuQueueWriteTexture. A single dispatch reduces
+ * up to 4 levels: each workgroup computes an 8x8 tile of the first level
+ * and keeps halving it in workgroup memory, so the source is read once.
+ *
+ * Filtering is a box filter in linear space: sRGB textures are decoded
+ * before averaging and encoded again when stored. Odd sizes (non power of
+ * two) use a 3-tap filter along that axis, so every source texel
+ * contributes with its exact coverage instead of an edge row or column
+ * being dropped.
+ *
+ * Supported formats are RGBA8Unorm, RGBA8UnormSrgb, RGBA16Float and
+ * RGBA32Float. The texture needs the StorageBinding and TextureBinding
+ * usages, except sRGB textures, which cannot be bound as storage and are
+ * processed in a scratch texture: they need CopySrc and CopyDst instead.
+ *
+ * mipmapBuildChain is the CPU counterpart, for loaders that build chains
+ * on worker threads (see texture-streamer.h and texture-cache.h): a 2x2
+ * box filter of RGBA8 pixels, also in linear space for sRGB, that drops
+ * the last row or column of odd sizes instead.
+ */
+
+#ifndef _mipmap_generator_h_
+#define _mipmap_generator_h_
+
+#include <webgpu/webgpu.h>
+#include "submit-scheduler.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Levels written per dispatch, limited by the default maximum number of
+// storage textures per shader stage.
+#define MIPMAP_LEVELS_PER_DISPATCH 4
+
+enum MipmapStorageFormat {
+	MipmapStorageFormat_RGBA8Unorm,
+	MipmapStorageFormat_RGBA16Float,
+	MipmapStorageFormat_RGBA32Float,
+	MipmapStorageFormat_Count,
+};
+
+struct MipmapPipeline {
+	WGPUBindGroupLayout layout;
+	WGPUComputePipeline pipeline;
+	// Bound to the storage slots of levels a dispatch does not write, one
+	// layer per slot so that no subresource is bound twice
+	WGPUTexture dummyTexture;
+	WGPUTextureView dummyViews[MIPMAP_LEVELS_PER_DISPATCH];
+};
+
+struct MipmapGenerator {
+	WGPUDevice device;
+	WGPUQueue queue;
+	// One parameter slot per (level count, sRGB) combination
+	WGPUBuffer paramsBuffer;
+	struct MipmapPipeline pipelines[MipmapStorageFormat_Count]; // created on first use
+};
+
+/**
+ * Number of levels of a full mip chain for a texture of this size.
+ */
+uint32_t mipmapLevelCount(uint32_t width, uint32_t height);
+
+/**
+ * Bytes of the full chain of an RGBA8 image, levels tightly packed.
+ */
+uint64_t mipmapChainSize(uint32_t width, uint32_t height);
+
+/**
+ * Fill levels 1 and up of the RGBA8 chain `chain`, of
+ * mipmapChainSize(width, height) bytes, from its level 0. Each level
+ * follows the previous one, rows 4 * levelWidth bytes apart.
+ */
+void mipmapBuildChain(uint8_t * chain, uint32_t width, uint32_t height, bool srgb);
+
+struct MipmapGenerator * mipmapGeneratorCreate(WGPUDevice device);
+
+/**
+ * Record the generation of levels 1 to `desc->mipLevelCount - 1` of
+ * `texture` from its level 0. `desc` is the descriptor the texture was
+ * created with.
+ */
+bool mipmapGeneratorEncode(struct MipmapGenerator * generator, WGPUCommandEncoder encoder, WGPUTexture texture, WGPUTextureDescriptor const * desc);
+
+/**
+ * Upload level 0 of every layer of `texture` (`data` holds the layers one
+ * after the other, rows `bytesPerRow` apart) and generate the rest of the
+ * chain. The commands are enqueued in the Upload stage of `scheduler`, or
+ * submitted right away if it is NULL.
+ */
+bool mipmapGeneratorUpload(struct MipmapGenerator * generator, struct SubmitScheduler * scheduler, WGPUTexture texture, WGPUTextureDescriptor const * desc, void const * data, size_t dataSize, uint32_t bytesPerRow);
+
+void mipmapGeneratorRelease(struct MipmapGenerator * generator);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _mipmap_generator_h_
@@ -0,0 +1,663 @@
+#include "nn-inference.h"
+#include "half-float.h"
+#include "webgpu-utils.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PARAMS_SLOT_SIZE 256
+#define MAX_DISPATCHES (2 * NN_MAX_LAYERS)
+#define MATMUL_TILE 64
+#define ELEMENTWISE_WORKGROUP_SIZE 256
+
+// Must match struct Params in the shader
+struct NnParams {
+	uint32_t m;
+	uint32_t n;
+	uint32_t k;
+	uint32_t weightStride;
+	uint32_t biasOffset;
+	uint32_t activation;
+	uint32_t count;
+	uint32_t _pad;
+	uint32_t inWidth;
+	uint32_t inHeight;
+	uint32_t inChannels;
+	uint32_t kernelSize;
+	uint32_t stride;
+	uint32_t padding;
+	uint32_t outWidth;
+	uint32_t outHeight;
+};
+
+// Weights are either read as f16, or as pairs of halves packed in a u32
+static const char* nnWeightsF16Source = "\
+enable f16;\n\
+alias Weight = f16;\n\
+@group(0) @binding(2) var<storage, read> weights: array<vec2<f16>>;\n\
+fn loadWeights(i: u32) -> vec2<Weight> {\n\
+    return weights[i];\n\
+}\n\
+";
+
+static const char* nnWeightsPackedSource = "\
+alias Weight = f32;\n\
+@group(0) @binding(2) var<storage, read> weights: array<u32>;\n\
+fn loadWeights(i: u32) -> vec2<Weight> {\n\
+    return unpack2x16float(weights[i]);\n\
+}\n\
+";
+
+static const char* nnCommonSource = "\
+struct Params {\n\
+    m: u32,\n\
+    n: u32,\n\
+    k: u32,\n\
+    weightStride: u32,\n\
+    biasOffset: u32,\n\
+    activation: u32,\n\
+    count: u32,\n\
+    _pad: u32,\n\
+    inWidth: u32,\n\
+    inHeight: u32,\n\
+    inChannels: u32,\n\
+    kernelSize: u32,\n\
+    stride: u32,\n\
+    padding: u32,\n\
+    outWidth: u32,\n\
+    outHeight: u32,\n\
+}\n\
+@group(0) @binding(0) var<uniform> params: Params;\n\
+@group(0) @binding(1) var<storage, read> input: array<f32>;\n\
+@group(0) @binding(3) var<storage, read_write> output: array<f32>;\n\
+\n\
+fn activate(x: f32, kind: u32) -> f32 {\n\
+    switch kind {\n\
+        case 1u: { return max(x, 0.0); }\n\
+        case 2u: { return 1.0 / (1.0 + exp(-x)); }\n\
+        case 3u: { return tanh(clamp(x, -10.0, 10.0)); }\n\
+        case 4u: {\n\
+            let inner = clamp(0.7978845608 * (x + 0.044715 * x * x * x), -10.0, 10.0);\n\
+            return 0.5 * x * (1.0 + tanh(inner));\n\
+        }\n\
+        default: { return x; }\n\
+    }\n\
+}\n\
+\n\
+// Elementwise kernels may be spread over 2 dimensions when there are more\n\
+// than the maximum number of workgroups per dimension.\n\
+fn elementIndex(gid: vec3u, nwg: vec3u) -> u32 {\n\
+    return gid.x + gid.y * nwg.x * 256u;\n\
+}\n\
+\n\
+@compute @workgroup_size(256)\n\
+fn im2col(@builtin(global_invocation_id) gid: vec3u, @builtin(num_workgroups) nwg: vec3u) {\n\
+    let i = elementIndex(gid, nwg);\n\
+    if (i >= params.count) {\n\
+        return;\n\
+    }\n\
+    let row = i / params.k;\n\
+    let column = i % params.k;\n\
+    let c = column % params.inChannels;\n\
+    let kx = (column / params.inChannels) % params.kernelSize;\n\
+    let ky = column / (params.inChannels * params.kernelSize);\n\
+    let pixelsPerItem = params.outWidth * params.outHeight;\n\
+    let item = row / pixelsPerItem;\n\
+    let pixel = row % pixelsPerItem;\n\
+    let x = i32((pixel % params.outWidth) * params.stride + kx) - i32(params.padding);\n\
+    let y = i32((pixel / params.outWidth) * params.stride + ky) - i32(params.padding);\n\
+    var value = 0.0;\n\
+    if (x >= 0 && y >= 0 && x < i32(params.inWidth) && y < i32(params.inHeight)) {\n\
+        value = input[((item * params.inHeight + u32(y)) * params.inWidth + u32(x)) * params.inChannels + c];\n\
+    }\n\
+    output[i] = value;\n\
+}\n\
+\n\
+@compute @workgroup_size(256)\n\
+fn activation(@builtin(global_invocation_id) gid: vec3u, @builtin(num_workgroups) nwg: vec3u) {\n\
+    let i = elementIndex(gid, nwg);\n\
+    if (i < params.count) {\n\
+        output[i] = activate(input[i], params.activation);\n\
+    }\n\
+}\n\
+";
+
+/**
+ * output[m][n] = activate(input[m][k] * weights[n][k] + bias[n])
+ * Each invocation accumulates a 4x4 block of a 64x64 tile in registers.
+ */
+static const char* nnMatmulSource = "\
+const TILE = 64u;\n\
+const TILE_K = 16u;\n\
+\n\
+// Slices of the tile, k-major so that each invocation reads 4 contiguous\n\
+// rows of A and 4 contiguous columns of B\n\
+var<workgroup> tileA: array<f32, 1024>;\n\
+var<workgroup> tileB: array<Weight, 1024>;\n\
+\n\
+@compute @workgroup_size(16, 16)\n\
+fn matmul(@builtin(workgroup_id) wid: vec3u, @builtin(local_invocation_id) lid: vec3u, @builtin(local_invocation_index) li: u32) {\n\
+    let rowBase = wid.y * TILE;\n\
+    let columnBase = wid.x * TILE;\n\
+    var acc: array<vec4f, 4>;\n\
+    for (var k0 = 0u; k0 < params.k; k0 += TILE_K) {\n\
+        // 64 rows x 16 of A, 4 per invocation\n\
+        for (var j = 0u; j < 4u; j++) {\n\
+            let e = li + j * 256u;\n\
+            let r = e / TILE_K;\n\
+            let kk = e % TILE_K;\n\
+            var a = 0.0;\n\
+            if (rowBase + r < params.m && k0 + kk < params.k) {\n\
+                a = input[(rowBase + r) * params.k + k0 + kk];\n\
+            }\n\
+            tileA[kk * TILE + r] = a;\n\
+        }\n\
+        // 64 columns x 16 of B, 2 pairs of halves per invocation. Rows of\n\
+        // weights are padded to an even length, so pairs never straddle rows.\n\
+        for (var j = 0u; j < 2u; j++) {\n\
+            let p = li + j * 256u;\n\
+            let c = p / 8u;\n\
+            let kk = (p % 8u) * 2u;\n\
+            var w = vec2<Weight>(0.0);\n\
+            if (columnBase + c < params.n && k0 + kk < params.k) {\n\
+                w = loadWeights(((columnBase + c) * params.weightStride + k0 + kk) / 2u);\n\
+            }\n\
+            tileB[kk * TILE + c] = w.x;\n\
+            tileB[(kk + 1u) * TILE + c] = w.y;\n\
+        }\n\
+        workgroupBarrier();\n\
+        for (var kk = 0u; kk < TILE_K; kk++) {\n\
+            let ao = kk * TILE + lid.y * 4u;\n\
+            let bo = kk * TILE + lid.x * 4u;\n\
+            let a = vec4f(tileA[ao], tileA[ao + 1u], tileA[ao + 2u], tileA[ao + 3u]);\n\
+            let b = vec4f(vec4<Weight>(tileB[bo], tileB[bo + 1u], tileB[bo + 2u], tileB[bo + 3u]));\n\
+            acc[0] += a.x * b;\n\
+            acc[1] += a.y * b;\n\
+            acc[2] += a.z * b;\n\
+            acc[3] += a.w * b;\n\
+        }\n\
+        workgroupBarrier();\n\
+    }\n\
+    for (var i = 0u; i < 4u; i++) {\n\
+        let row = rowBase + lid.y * 4u + i;\n\
+        if (row >= params.m) {\n\
+            break;\n\
+        }\n\
+        for (var j = 0u; j < 4u; j++) {\n\
+            let column = columnBase + lid.x * 4u + j;\n\
+            if (column < params.n) {\n\
+                let biasIndex = params.biasOffset + column;\n\
+                let bias = f32(loadWeights(biasIndex / 2u)[biasIndex % 2u]);\n\
+                output[row * params.n + column] = activate(acc[i][j] + bias, params.activation);\n\
+            }\n\
+        }\n\
+    }\n\
+}\n\
+";
+
+static uint32_t ceilDiv(uint32_t a, uint32_t b) {
+	return (a + b - 1) / b;
+}
+
+static uint32_t shapeSize(struct NnShape shape) {
+	return shape.width * shape.height * shape.channels;
+}
+
+/**
+ * Shape of the output of `layer`, and number of inputs of each of its
+ * output channels. Returns false if the layer does not apply to `input`.
+ */
+static bool layerOutputShape(struct NnLayerDesc const * layer, struct NnShape input, struct NnShape * output, uint32_t * inputColumns) {
+	switch (layer->type) {
+	case NnLayer_Dense:
+		if (layer->outChannels == 0) return false;
+		*output = (struct NnShape) { 1, 1, layer->outChannels };
+		*inputColumns = shapeSize(input);
+		return true;
+	case NnLayer_Conv2d: {
+		if (layer->outChannels == 0 || layer->kernelSize == 0 || layer->stride == 0) return false;
+		uint32_t paddedWidth = input.width + 2 * layer->padding;
+		uint32_t paddedHeight = input.height + 2 * layer->padding;
+		if (paddedWidth < layer->kernelSize || paddedHeight < layer->kernelSize) return false;
+		*output = (struct NnShape) {
+			(paddedWidth - layer->kernelSize) / layer->stride + 1,
+			(paddedHeight - layer->kernelSize) / layer->stride + 1,
+			layer->outChannels,
+		};
+		*inputColumns = layer->kernelSize * layer->kernelSize * input.channels;
+		return true;
+	}
+	case NnLayer_Activation:
+		*output = input;
+		*inputColumns = 0;
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Model files
+
+struct NnModel * nnModelLoad(char const * path) {
+	struct MappedFile * file = mappedFileOpen(path);
+	if (!file) return NULL;
+	struct NnModel * model = (struct NnModel *)calloc(1, sizeof(struct NnModel));
+	model->file = file;
+	uint8_t const * bytes = (uint8_t const *)file->data;
+
+	char const * error = NULL;
+	struct NnModelHeader const * header = (struct NnModelHeader const *)bytes;
+	if (file->size < sizeof(struct NnModelHeader) || memcmp(header->magic, NN_MODEL_MAGIC, 4) != 0) {
+		error = "not a model file";
+	} else if (header->version != NN_MODEL_VERSION) {
+		error = "unsupported version";
+	} else if (header->layerCount == 0 || header->layerCount > NN_MAX_LAYERS) {
+		error = "invalid layer count";
+	} else if (sizeof(struct NnModelHeader) + header->layerCount * sizeof(struct NnLayerDesc) > file->size) {
+		error = "truncated layer table";
+	} else if (header->dataOffset % NN_DATA_ALIGNMENT != 0 || header->dataSize % 4 != 0
+		|| header->dataOffset > file->size || header->dataSize > file->size - header->dataOffset) {
+		error = "invalid data range";
+	}
+
+	if (!error) {
+		model->header = header;
+		model->layers = (struct NnLayerDesc const *)(bytes + sizeof(struct NnModelHeader));
+		model->data = bytes + header->dataOffset;
+		model->inputShape = (struct NnShape) { header->inputWidth, header->inputHeight, header->inputChannels };
+		if (shapeSize(model->inputShape) == 0) error = "empty input shape";
+	}
+
+	struct NnShape shape = model->inputShape;
+	for (uint32_t i = 0; !error && i < header->layerCount; ++i) {
+		struct NnLayerDesc const * layer = &model->layers[i];
+		uint32_t inputColumns = 0;
+		if (layer->activation > NnActivation_GELU || !layerOutputShape(layer, shape, &shape, &inputColumns)) {
+			fprintf(stderr, "Layer %u: ", i);
+			error = "invalid layer";
+			break;
+		}
+		model->shapes[i] = shape;
+		if (layer->type == NnLayer_Activation) continue;
+		uint64_t weightsSize = ((uint64_t)layer->outChannels * layer->weightStride + layer->outChannels) * 2;
+		if (layer->weightStride % 2 != 0 || layer->weightStride < inputColumns) {
+			fprintf(stderr, "Layer %u: ", i);
+			error = "invalid weight stride";
+		} else if (layer->weightsOffset % NN_DATA_ALIGNMENT != 0 || layer->weightsSize < weightsSize || layer->weightsSize % 4 != 0
+			|| layer->weightsOffset > header->dataSize || layer->weightsSize > header->dataSize - layer->weightsOffset) {
+			fprintf(stderr, "Layer %u: ", i);
+			error = "invalid weights range";
+		}
+	}
+
+	if (error) {
+		fprintf(stderr, "Could not load model %s: %s\n", path, error);
+		nnModelRelease(model);
+		return NULL;
+	}
+	return model;
+}
+
+void nnModelRelease(struct NnModel * model) {
+	if (!model) return;
+	mappedFileClose(model->file);
+	free(model);
+}
+
+static bool writePadding(FILE * file, uint64_t size) {
+	static const uint8_t zeros[NN_DATA_ALIGNMENT] = { 0 };
+	while (size > 0) {
+		size_t chunk = size < sizeof(zeros) ? (size_t)size : sizeof(zeros);
+		if (fwrite(zeros, 1, chunk, file) != chunk) return false;
+		size -= chunk;
+	}
+	return true;
+}
+
+bool nnModelWrite(char const * path, struct NnShape inputShape, struct NnLayerSpec const * layers, uint32_t layerCount) {
+	if (layerCount == 0 || layerCount > NN_MAX_LAYERS) return false;
+
+	// Lay out the data section
+	struct NnLayerDesc descs[NN_MAX_LAYERS];
+	uint32_t inputColumns[NN_MAX_LAYERS];
+	memset(descs, 0, sizeof(descs));
+	struct NnShape shape = inputShape;
+	uint64_t dataSize = 0;
+	for (uint32_t i = 0; i < layerCount; ++i) {
+		struct NnLayerDesc * desc = &descs[i];
+		desc->type = (uint32_t)layers[i].type;
+		desc->activation = (uint32_t)layers[i].activation;
+		desc->outChannels = layers[i].outChannels;
+		desc->kernelSize = layers[i].kernelSize;
+		desc->stride = layers[i].stride;
+		desc->padding = layers[i].padding;
+		if (!layerOutputShape(desc, shape, &shape, &inputColumns[i])) {
+			fprintf(stderr, "Layer %u does not apply to the output of the previous layer\n", i);
+			return false;
+		}
+		if (desc->type == NnLayer_Activation) continue;
+		desc->weightStride = (uint32_t)alignUp(inputColumns[i], 2);
+		desc->weightsOffset = dataSize;
+		desc->weightsSize = alignUp(((uint64_t)desc->outChannels * desc->weightStride + desc->outChannels) * 2, 4);
+		dataSize = alignUp(desc->weightsOffset + desc->weightsSize, NN_DATA_ALIGNMENT);
+	}
+
+	FILE * file = fopen(path, "wb");
+	if (!file) {
+		fprintf(stderr, "Could not open %s for writing\n", path);
+		return false;
+	}
+	struct NnModelHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, NN_MODEL_MAGIC, 4);
+	header.version = NN_MODEL_VERSION;
+	header.layerCount = layerCount;
+	header.inputWidth = inputShape.width;
+	header.inputHeight = inputShape.height;
+	header.inputChannels = inputShape.channels;
+	uint64_t tableSize = sizeof(header) + layerCount * sizeof(struct NnLayerDesc);
+	header.dataOffset = alignUp(tableSize, NN_DATA_ALIGNMENT);
+	header.dataSize = dataSize;
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(descs, sizeof(struct NnLayerDesc), layerCount, file) == layerCount
+		&& writePadding(file, header.dataOffset - tableSize);
+
+	uint64_t written = 0;
+	uint16_t * row = NULL;
+	for (uint32_t i = 0; ok && i < layerCount; ++i) {
+		struct NnLayerDesc const * desc = &descs[i];
+		if (desc->type == NnLayer_Activation) continue;
+		ok = writePadding(file, desc->weightsOffset - written);
+		row = (uint16_t *)realloc(row, (desc->weightStride > desc->outChannels ? desc->weightStride : desc->outChannels) * sizeof(uint16_t));
+		for (uint32_t o = 0; ok && o < desc->outChannels; ++o) {
+			memset(row, 0, desc->weightStride * sizeof(uint16_t));
+			for (uint32_t k = 0; k < inputColumns[i]; ++k) {
+				row[k] = floatToHalf(layers[i].weights[(size_t)o * inputColumns[i] + k]);
+			}
+			ok = fwrite(row, sizeof(uint16_t), desc->weightStride, file) == desc->weightStride;
+		}
+		for (uint32_t o = 0; o < desc->outChannels; ++o) {
+			row[o] = layers[i].biases ? floatToHalf(layers[i].biases[o]) : 0;
+		}
+		ok = ok && fwrite(row, sizeof(uint16_t), desc->outChannels, file) == desc->outChannels;
+		written = desc->weightsOffset + ((uint64_t)desc->outChannels * desc->weightStride + desc->outChannels) * 2;
+	}
+	ok = ok && writePadding(file, dataSize - written);
+	free(row);
+	fclose(file);
+	if (!ok) fprintf(stderr, "Could not write model %s\n", path);
+	return ok;
+}
+
+// Engine
+
+static WGPUBindGroup createBindGroup(struct NnEngine * engine, WGPUBuffer input, uint64_t weightsOffset, uint64_t weightsSize, WGPUBuffer output) {
+	WGPUBindGroupEntry bindings[4];
+	bindings[0] = bufferBindGroupEntry(0, engine->paramsBuffer, 0, sizeof(struct NnParams));
+	bindings[1] = bufferBindGroupEntry(1, input, 0, WGPU_WHOLE_SIZE);
+	bindings[2] = bufferBindGroupEntry(2, engine->weights, weightsOffset, weightsSize);
+	bindings[3] = bufferBindGroupEntry(3, output, 0, WGPU_WHOLE_SIZE);
+	WGPUBindGroupDescriptor bindGroupDesc = (WGPUBindGroupDescriptor) {};
+	bindGroupDesc.nextInChain = NULL;
+	bindGroupDesc.layout = engine->layout;
+	bindGroupDesc.entryCount = 4;
+	bindGroupDesc.entries = bindings;
+	return wgpuDeviceCreateBindGroup(engine->device, &bindGroupDesc);
+}
+
+static void createPipelines(struct NnEngine * engine) {
+	WGPUBindGroupLayoutEntry entries[4];
+	entries[0] = bufferLayoutEntry(0, WGPUShaderStage_Compute, WGPUBufferBindingType_Uniform, true);
+	entries[1] = bufferLayoutEntry(1, WGPUShaderStage_Compute, WGPUBufferBindingType_ReadOnlyStorage, false);
+	entries[2] = bufferLayoutEntry(2, WGPUShaderStage_Compute, WGPUBufferBindingType_ReadOnlyStorage, false);
+	entries[3] = bufferLayoutEntry(3, WGPUShaderStage_Compute, WGPUBufferBindingType_Storage, false);
+	WGPUBindGroupLayoutDescriptor layoutDesc = (WGPUBindGroupLayoutDescriptor) {};
+	layoutDesc.nextInChain = NULL;
+	layoutDesc.label = "NN inference";
+	layoutDesc.entryCount = 4;
+	layoutDesc.entries = entries;
+	engine->layout = wgpuDeviceCreateBindGroupLayout(engine->device, &layoutDesc);
+
+	char const * weightsSource = engine->useF16 ? nnWeightsF16Source : nnWeightsPackedSource;
+	size_t sourceSize = strlen(weightsSource) + strlen(nnCommonSource) + strlen(nnMatmulSource) + 1;
+	char * source = (char *)malloc(sourceSize);
+	strcpy(source, weightsSource);
+	strcat(source, nnCommonSource);
+	strcat(source, nnMatmulSource);
+	WGPUShaderModule module = createWGSLShaderModule(engine->device, source, "NN inference");
+	free(source);
+	WGPUPipelineLayout pipelineLayout = createSingleGroupPipelineLayout(engine->device, engine->layout, "NN inference");
+	engine->matmulPipeline = createComputePipeline(engine->device, pipelineLayout, module, "matmul", "NN matmul");
+	engine->im2colPipeline = createComputePipeline(engine->device, pipelineLayout, module, "im2col", "NN im2col");
+	engine->activationPipeline = createComputePipeline(engine->device, pipelineLayout, module, "activation", "NN activation");
+	wgpuPipelineLayoutRelease(pipelineLayout);
+	wgpuShaderModuleRelease(module);
+}
+
+struct NnEngine * nnEngineCreate(WGPUDevice device, struct NnModel const * model, uint32_t maxBatch) {
+	struct NnEngine * engine = (struct NnEngine *)calloc(1, sizeof(struct NnEngine));
+	engine->device = device;
+	engine->queue = wgpuDeviceGetQueue(device);
+	engine->useF16 = wgpuDeviceHasFeature(device, WGPUFeatureName_ShaderF16);
+
+	WGPUSupportedLimits supportedLimits = (WGPUSupportedLimits) {};
+	supportedLimits.nextInChain = NULL;
+	wgpuDeviceGetLimits(device, &supportedLimits);
+	engine->maxWorkgroupsPerDimension = supportedLimits.limits.maxComputeWorkgroupsPerDimension;
+	if (engine->maxWorkgroupsPerDimension == 0) engine->maxWorkgroupsPerDimension = 65535;
+
+	// Layers, fusing activations into the matrix multiplication before them
+	engine->inputShape = model->inputShape;
+	engine->layerCount = model->header->layerCount;
+	struct NnShape shape = model->inputShape;
+	uint32_t maxActivationSize = 0;
+	uint32_t maxIm2colSize = 0;
+	uint32_t maxRowsPerItem = 1;
+	for (uint32_t i = 0; i < engine->layerCount; ++i) {
+		struct NnEngineLayer * layer = &engine->layers[i];
+		layer->desc = model->layers[i];
+		layer->inputShape = shape;
+		layer->outputShape = model->shapes[i];
+		layerOutputShape(&layer->desc, shape, &shape, &layer->inputColumns);
+		layer->rowsPerItem = layer->desc.type == NnLayer_Activation ? shapeSize(shape) : shape.width * shape.height;
+		if (layer->desc.type == NnLayer_Conv2d) {
+			uint32_t im2colSize = layer->rowsPerItem * layer->inputColumns;
+			if (im2colSize > maxIm2colSize) maxIm2colSize = im2colSize;
+		}
+		if (layer->desc.type != NnLayer_Activation && layer->rowsPerItem > maxRowsPerItem) {
+			maxRowsPerItem = layer->rowsPerItem;
+		}
+		struct NnEngineLayer * previous = i > 0 ? &engine->layers[i - 1] : NULL;
+		if (layer->desc.type == NnLayer_Activation && previous && !previous->fused
+			&& previous->desc.type != NnLayer_Activation && previous->desc.activation == NnActivation_None) {
+			previous->desc.activation = layer->desc.activation;
+			layer->fused = true;
+		}
+		if (i + 1 < engine->layerCount && shapeSize(shape) > maxActivationSize) maxActivationSize = shapeSize(shape);
+	}
+	engine->outputShape = shape;
+
+	// Matrix multiplications dispatch a row of workgroups per 64 rows
+	uint64_t maxRows = (uint64_t)engine->maxWorkgroupsPerDimension * MATMUL_TILE;
+	if ((uint64_t)maxBatch * maxRowsPerItem > maxRows) {
+		maxBatch = (uint32_t)(maxRows / maxRowsPerItem);
+		fprintf(stderr, "Warning: batches of this model are limited to %u items\n", maxBatch);
+	}
+	engine->maxBatch = maxBatch;
+
+	createPipelines(engine);
+
+	WGPUBufferUsageFlags storage = WGPUBufferUsage_Storage;
+	uint64_t dataSize = model->header->dataSize;
+	engine->weights = createBuffer(device, dataSize > NN_DATA_ALIGNMENT ? dataSize : NN_DATA_ALIGNMENT, storage | WGPUBufferUsage_CopyDst, "NN weights");
+	if (dataSize > 0) {
+		// Straight from the mapping: pages are read as the upload copies them
+		wgpuQueueWriteBuffer(engine->queue, engine->weights, 0, model->data, dataSize);
+	}
+	engine->input = createBuffer(device, (uint64_t)maxBatch * shapeSize(engine->inputShape) * sizeof(float), storage | WGPUBufferUsage_CopyDst, "NN input");
+	uint64_t outputSize = (uint64_t)maxBatch * shapeSize(engine->outputShape) * sizeof(float);
+	engine->output = createBuffer(device, outputSize, storage | WGPUBufferUsage_CopySrc, "NN output");
+	engine->readback = createBuffer(device, outputSize, WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst, "NN readback");
+	for (int i = 0; i < 2; ++i) {
+		engine->activations[i] = createBuffer(device, (uint64_t)maxBatch * (maxActivationSize > 0 ? maxActivationSize : 1) * sizeof(float), storage, "NN activations");
+	}
+	engine->im2col = createBuffer(device, (uint64_t)maxBatch * (maxIm2colSize > 0 ? maxIm2colSize : 1) * sizeof(float), storage, "NN im2col");
+	engine->paramsBuffer = createBuffer(device, MAX_DISPATCHES * PARAMS_SLOT_SIZE, WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst, "NN params");
+	engine->params = (uint8_t *)calloc(MAX_DISPATCHES, PARAMS_SLOT_SIZE);
+
+	// Layers ping-pong between the activation buffers, from the input to the output
+	uint32_t remaining = 0;
+	for (uint32_t i = 0; i < engine->layerCount; ++i) {
+		if (!engine->layers[i].fused) ++remaining;
+	}
+	WGPUBuffer current = engine->input;
+	uint32_t executed = 0;
+	for (uint32_t i = 0; i < engine->layerCount; ++i) {
+		struct NnEngineLayer * layer = &engine->layers[i];
+		if (layer->fused) continue;
+		WGPUBuffer destination = executed + 1 == remaining ? engine->output : engine->activations[executed % 2];
+		// Activation layers do not read weights, but the binding must not be empty
+		uint64_t weightsOffset = layer->desc.type == NnLayer_Activation ? 0 : layer->desc.weightsOffset;
+		uint64_t weightsSize = layer->desc.type == NnLayer_Activation ? NN_DATA_ALIGNMENT : layer->desc.weightsSize;
+		if (layer->desc.type == NnLayer_Conv2d) {
+			layer->im2colBindGroup = createBindGroup(engine, current, weightsOffset, weightsSize, engine->im2col);
+			layer->bindGroup = createBindGroup(engine, engine->im2col, weightsOffset, weightsSize, destination);
+		} else {
+			layer->bindGroup = createBindGroup(engine, current, weightsOffset, weightsSize, destination);
+		}
+		current = destination;
+		++executed;
+	}
+	return engine;
+}
+
+void nnEngineRelease(struct NnEngine * engine) {
+	if (!engine) return;
+	for (uint32_t i = 0; i < engine->layerCount; ++i) {
+		if (engine->layers[i].im2colBindGroup) wgpuBindGroupRelease(engine->layers[i].im2colBindGroup);
+		if (engine->layers[i].bindGroup) wgpuBindGroupRelease(engine->layers[i].bindGroup);
+	}
+	WGPUBuffer buffers[] = {
+		engine->weights, engine->input, engine->output, engine->activations[0], engine->activations[1],
+		engine->im2col, engine->readback, engine->paramsBuffer,
+	};
+	for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); ++i) {
+		wgpuBufferRelease(buffers[i]);
+	}
+	free(engine->params);
+	wgpuComputePipelineRelease(engine->activationPipeline);
+	wgpuComputePipelineRelease(engine->im2colPipeline);
+	wgpuComputePipelineRelease(engine->matmulPipeline);
+	wgpuBindGroupLayoutRelease(engine->layout);
+	wgpuQueueRelease(engine->queue);
+	free(engine);
+}
+
+static void dispatch(struct NnEngine * engine, WGPUComputePassEncoder pass, uint32_t * paramsCount, WGPUComputePipeline pipeline, WGPUBindGroup bindGroup, struct NnParams const * params, uint32_t x, uint32_t y) {
+	assert(*paramsCount < MAX_DISPATCHES);
+	uint32_t paramsOffset = (*paramsCount)++ * PARAMS_SLOT_SIZE;
+	memcpy(engine->params + paramsOffset, params, sizeof(struct NnParams));
+	wgpuComputePassEncoderSetPipeline(pass, pipeline);
+	wgpuComputePassEncoderSetBindGroup(pass, 0, bindGroup, 1, &paramsOffset);
+	wgpuComputePassEncoderDispatchWorkgroups(pass, x, y, 1);
+}
+
+static void dispatchElementwise(struct NnEngine * engine, WGPUComputePassEncoder pass, uint32_t * paramsCount, WGPUComputePipeline pipeline, WGPUBindGroup bindGroup, struct NnParams const * params) {
+	uint32_t workgroupCount = ceilDiv(params->count, ELEMENTWISE_WORKGROUP_SIZE);
+	uint32_t x = workgroupCount < engine->maxWorkgroupsPerDimension ? workgroupCount : engine->maxWorkgroupsPerDimension;
+	dispatch(engine, pass, paramsCount, pipeline, bindGroup, params, x, ceilDiv(workgroupCount, x));
+}
+
+void nnEngineEncode(struct NnEngine * engine, WGPUCommandEncoder encoder, uint32_t batchSize) {
+	assert(batchSize > 0 && batchSize <= engine->maxBatch);
+	WGPUComputePassDescriptor passDesc = (WGPUComputePassDescriptor) {};
+	passDesc.nextInChain = NULL;
+	passDesc.label = "NN inference";
+	passDesc.timestampWriteCount = 0;
+	passDesc.timestampWrites = NULL;
+	WGPUComputePassEncoder pass = wgpuCommandEncoderBeginComputePass(encoder, &passDesc);
+
+	uint32_t paramsCount = 0;
+	for (uint32_t i = 0; i < engine->layerCount; ++i) {
+		struct NnEngineLayer const * layer = &engine->layers[i];
+		if (layer->fused) continue;
+		struct NnParams params;
+		memset(&params, 0, sizeof(params));
+		params.activation = layer->desc.activation;
+
+		if (layer->desc.type == NnLayer_Activation) {
+			params.count = batchSize * layer->rowsPerItem;
+			dispatchElementwise(engine, pass, &paramsCount, engine->activationPipeline, layer->bindGroup, &params);
+			continue;
+		}
+
+		params.m = batchSize * layer->rowsPerItem;
+		params.n = layer->desc.outChannels;
+		params.k = layer->inputColumns;
+		params.weightStride = layer->desc.weightStride;
+		params.biasOffset = layer->desc.outChannels * layer->desc.weightStride;
+		if (layer->desc.type == NnLayer_Conv2d) {
+			params.count = params.m * params.k;
+			params.inWidth = layer->inputShape.width;
+			params.inHeight = layer->inputShape.height;
+			params.inChannels = layer->inputShape.channels;
+			params.kernelSize = layer->desc.kernelSize;
+			params.stride = layer->desc.stride;
+			params.padding = layer->desc.padding;
+			params.outWidth = layer->outputShape.width;
+			params.outHeight = layer->outputShape.height;
+			dispatchElementwise(engine, pass, &paramsCount, engine->im2colPipeline, layer->im2colBindGroup, &params);
+		}
+		dispatch(engine, pass, &paramsCount, engine->matmulPipeline, layer->bindGroup, &params, ceilDiv(params.n, MATMUL_TILE), ceilDiv(params.m, MATMUL_TILE));
+	}
+
+	wgpuComputePassEncoderEnd(pass);
+	wgpuComputePassEncoderRelease(pass);
+	// Lands before the submit containing the pass
+	wgpuQueueWriteBuffer(engine->queue, engine->paramsBuffer, 0, engine->params, paramsCount * PARAMS_SLOT_SIZE);
+}
+
+static void onReadbackMapped(WGPUBufferMapAsyncStatus status, void * pUserData) {
+	*(int *)pUserData = status == WGPUBufferMapAsyncStatus_Success ? 1 : -1;
+}
+
+bool nnEngineRun(struct NnEngine * engine, float const * inputs, uint32_t batchSize, float * outputs) {
+	wgpuQueueWriteBuffer(engine->queue, engine->input, 0, inputs, (size_t)batchSize * shapeSize(engine->inputShape) * sizeof(float));
+
+	WGPUCommandEncoderDescriptor encoderDesc = (WGPUCommandEncoderDescriptor) {};
+	encoderDesc.nextInChain = NULL;
+	encoderDesc.label = "NN inference";
+	WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(engine->device, &encoderDesc);
+	nnEngineEncode(engine, encoder, batchSize);
+	size_t outputSize = (size_t)batchSize * shapeSize(engine->outputShape) * sizeof(float);
+	wgpuCommandEncoderCopyBufferToBuffer(encoder, engine->output, 0, engine->readback, 0, outputSize);
+	WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, NULL);
+	wgpuQueueSubmit(engine->queue, 1, &command);
+	wgpuCommandBufferRelease(command);
+	wgpuCommandEncoderRelease(encoder);
+
+	int mapped = 0;
+	wgpuBufferMapAsync(engine->readback, WGPUMapMode_Read, 0, outputSize, onReadbackMapped, &mapped);
+	while (mapped == 0) {
+#ifdef WEBGPU_BACKEND_DAWN
+		wgpuDeviceTick(engine->device);
+#endif
+	}
+	if (mapped < 0) return false;
+	memcpy(outputs, wgpuBufferGetConstMappedRange(engine->readback, 0, outputSize), outputSize);
+	wgpuBufferUnmap(engine->readback);
+	return true;
+}
+
+double nnEngineFlops(struct NnEngine const * engine, uint32_t batchSize) {
+	double flops = 0.0;
+	for (uint32_t i = 0; i < engine->layerCount; ++i) {
+		struct NnEngineLayer const * layer = &engine->layers[i];
+		if (layer->desc.type == NnLayer_Activation) continue;
+		flops += 2.0 * batchSize * layer->rowsPerItem * layer->desc.outChannels * layer->inputColumns;
+	}
+	return flops;
+}
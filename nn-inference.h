@@ -0,0 +1,211 @@
+/**
+ * Small neural network inference engine: dense, 2D convolution and
+ * activation layers evaluated on batches of inputs.
+ *
+ * Dense and convolution layers all run on the same tiled matrix
+ * multiplication: a workgroup of 16x16 invocations computes a 64x64 tile
+ * of the output, each invocation accumulating a 4x4 block in registers
+ * while 16-deep slices of both operands are staged in workgroup memory.
+ * Convolutions are first unrolled (im2col) into a matrix whose rows are
+ * the receptive fields of the output pixels. Activations are fused into
+ * the matrix multiplication when they follow it, so that only standalone
+ * activation layers need their own dispatch.
+ *
+ * Activations are f32 and laid out as NHWC: a batch of images whose
+ * pixels store their channels contiguously. Weights and biases are stored
+ * as half precision floats, in the model file as well as on the GPU. When
+ * the device has the ShaderF16 feature they are read as f16 and staged in
+ * workgroup memory as such, otherwise they are unpacked from pairs with
+ * unpack2x16float.
+ *
+ * Model file layout (little endian), designed to be memory mapped:
+ *     struct NnModelHeader header;
+ *     struct NnLayerDesc layers[header.layerCount];
+ *     ...padding...
+ *     data[header.dataSize], at header.dataOffset, a multiple of 256
+ * The weights of a layer are a row-major [outChannels][weightStride]
+ * matrix of halves, whose columns are ordered (kernel y, kernel x, input
+ * channel) for convolutions, followed by outChannels bias halves. Each
+ * layer's weights start at a multiple of 256 bytes within the data, so
+ * the data is uploaded in a single copy straight from the mapping and
+ * each layer binds its own range.
+ *
+ * Typical use:
+ *     struct NnModel * model = nnModelLoad("model.wnn");
+ *     struct NnEngine * engine = nnEngineCreate(device, model, 64);
+ *     nnModelRelease(model);
+ *     nnEngineRun(engine, inputs, batchSize, outputs);
+ */
+
+#ifndef _nn_inference_h_
+#define _nn_inference_h_
+
+#include <webgpu/webgpu.h>
+#include "mapped-file.h"
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NN_MODEL_MAGIC "WNN1"
+#define NN_MODEL_VERSION 1
+#define NN_DATA_ALIGNMENT 256
+#define NN_MAX_LAYERS 64
+
+enum NnLayerType {
+	NnLayer_Dense,
+	NnLayer_Conv2d,
+	NnLayer_Activation,
+};
+
+enum NnActivation {
+	NnActivation_None,
+	NnActivation_ReLU,
+	NnActivation_Sigmoid,
+	NnActivation_Tanh,
+	NnActivation_GELU,
+};
+
+struct NnModelHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t layerCount;
+	// Shape of one input; dense-only models use 1x1xfeatures
+	uint32_t inputWidth;
+	uint32_t inputHeight;
+	uint32_t inputChannels;
+	uint64_t dataOffset;
+	uint64_t dataSize;
+};
+
+struct NnLayerDesc {
+	uint32_t type; // enum NnLayerType
+	uint32_t activation; // enum NnActivation
+	uint32_t outChannels; // output features of dense layers
+	uint32_t kernelSize;
+	uint32_t stride;
+	uint32_t padding;
+	uint32_t weightStride; // in halves, even
+	uint32_t _pad;
+	uint64_t weightsOffset; // relative to the data, in bytes
+	uint64_t weightsSize; // in bytes, including biases
+};
+
+struct NnShape {
+	uint32_t width;
+	uint32_t height;
+	uint32_t channels;
+};
+
+/**
+ * A model, as mapped from its file. Pointers are into the mapping.
+ */
+struct NnModel {
+	struct MappedFile * file;
+	struct NnModelHeader const * header;
+	struct NnLayerDesc const * layers;
+	uint8_t const * data;
+	// Shapes of the input and of the output of each layer
+	struct NnShape inputShape;
+	struct NnShape shapes[NN_MAX_LAYERS];
+};
+
+/**
+ * Map and validate a model file. Returns NULL and prints why if it is not
+ * a valid model.
+ */
+struct NnModel * nnModelLoad(char const * path);
+void nnModelRelease(struct NnModel * model);
+
+/**
+ * Layer description for nnModelWrite. Weights are f32, laid out as in the
+ * file but without row padding: [outChannels][inputs], where inputs is
+ * kernelSize * kernelSize * inChannels for convolutions. They are
+ * converted to halves when written. Activation layers have no weights.
+ */
+struct NnLayerSpec {
+	enum NnLayerType type;
+	enum NnActivation activation;
+	uint32_t outChannels;
+	uint32_t kernelSize;
+	uint32_t stride;
+	uint32_t padding;
+	float const * weights;
+	float const * biases;
+};
+
+bool nnModelWrite(char const * path, struct NnShape inputShape, struct NnLayerSpec const * layers, uint32_t layerCount);
+
+struct NnEngineLayer {
+	struct NnLayerDesc desc;
+	struct NnShape inputShape;
+	struct NnShape outputShape;
+	// Rows of the matrix multiplication per batch item, columns of its input
+	uint32_t rowsPerItem;
+	uint32_t inputColumns;
+	// The activation is applied by the previous matrix multiplication
+	bool fused;
+	WGPUBindGroup im2colBindGroup;
+	WGPUBindGroup bindGroup;
+};
+
+struct NnEngine {
+	WGPUDevice device;
+	WGPUQueue queue;
+	bool useF16;
+	uint32_t maxBatch;
+	uint32_t maxWorkgroupsPerDimension;
+
+	WGPUBindGroupLayout layout;
+	WGPUComputePipeline matmulPipeline;
+	WGPUComputePipeline im2colPipeline;
+	WGPUComputePipeline activationPipeline;
+
+	WGPUBuffer weights;
+	WGPUBuffer input; // Storage | CopyDst
+	WGPUBuffer output; // Storage | CopySrc
+	WGPUBuffer activations[2];
+	WGPUBuffer im2col;
+	WGPUBuffer readback;
+
+	WGPUBuffer paramsBuffer;
+	uint8_t * params;
+
+	struct NnShape inputShape;
+	struct NnShape outputShape;
+	uint32_t layerCount;
+	struct NnEngineLayer layers[NN_MAX_LAYERS];
+};
+
+/**
+ * Create the GPU resources to run `model` on batches of up to `maxBatch`
+ * inputs. The model can be released once this returns.
+ */
+struct NnEngine * nnEngineCreate(WGPUDevice device, struct NnModel const * model, uint32_t maxBatch);
+void nnEngineRelease(struct NnEngine * engine);
+
+/**
+ * Record the evaluation of `batchSize` inputs, read from engine->input,
+ * into engine->output. Parameters are written with a queue write: encode
+ * at most once per submit.
+ */
+void nnEngineEncode(struct NnEngine * engine, WGPUCommandEncoder encoder, uint32_t batchSize);
+
+/**
+ * Upload `inputs`, evaluate them and wait for `outputs`. Both are f32
+ * arrays of batchSize times the input or output shape.
+ */
+bool nnEngineRun(struct NnEngine * engine, float const * inputs, uint32_t batchSize, float * outputs);
+
+/**
+ * Multiply-adds times two of the evaluation of `batchSize` inputs.
+ */
+double nnEngineFlops(struct NnEngine const * engine, uint32_t batchSize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _nn_inference_h_
@@ -0,0 +1,637 @@
+#include "obj-loader.h"
+#include "mapped-file.h"
+
+#include <tinycthread.h>
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Chunks per thread, to even out chunks that parse slower than others
+#define CHUNKS_PER_THREAD 8
+#define MIN_CHUNK_SIZE (1 << 20)
+// Power of two, enough for each thread to always have shards to work on
+#define SHARD_COUNT 256
+#define NO_INDEX UINT32_MAX
+
+enum ObjElement {
+	ObjElement_Position,
+	ObjElement_Texcoord,
+	ObjElement_Normal,
+	ObjElement_Corner,
+	ObjElement_Count,
+};
+
+struct ObjChunk {
+	char const * begin;
+	char const * end;
+	// Filled by the counting pass
+	uint64_t counts[ObjElement_Count];
+	// Index of the chunk's first element of each kind in the whole file
+	uint64_t bases[ObjElement_Count];
+	float boundsMin[3];
+	float boundsMax[3];
+	// Offset in the file of the first malformed line, if any
+	bool failed;
+	size_t errorOffset;
+	// Corners of the chunk hashing to each shard, then where they go in
+	// the partition
+	uint32_t shardCounts[SHARD_COUNT];
+	uint32_t shardOffsets[SHARD_COUNT];
+};
+
+struct ObjShard {
+	uint32_t begin; // in partition
+	uint32_t count;
+	// Corner where each vertex of the shard first appears
+	uint32_t * firstCorners;
+	uint32_t vertexCount;
+	uint32_t vertexBase;
+	bool failed;
+};
+
+struct ObjLoad {
+	char const * data;
+	struct ObjChunk * chunks;
+	uint32_t chunkCount;
+	uint64_t totals[ObjElement_Count];
+
+	float * positions;
+	float * texcoords;
+	float * normals;
+	// (position, texcoord, normal) per corner, NO_INDEX when missing
+	uint32_t * corners;
+	// Corners sorted by shard
+	uint32_t * partition;
+	struct ObjShard shards[SHARD_COUNT];
+
+	struct ObjMesh * mesh;
+};
+
+// Parallel for
+
+struct TaskQueue {
+	void (*task)(struct ObjLoad * load, uint32_t index);
+	struct ObjLoad * load;
+	uint32_t count;
+	uint32_t next;
+	mtx_t mutex;
+};
+
+static int taskThread(void * arg) {
+	struct TaskQueue * queue = (struct TaskQueue *)arg;
+	for (;;) {
+		mtx_lock(&queue->mutex);
+		uint32_t i = queue->next++;
+		mtx_unlock(&queue->mutex);
+		if (i >= queue->count) break;
+		queue->task(queue->load, i);
+	}
+	return 0;
+}
+
+/**
+ * Run task(load, i) for each i in [0, count) on up to `threadCount`
+ * threads, the calling one included.
+ */
+static void parallelFor(uint32_t threadCount, uint32_t count, void (*task)(struct ObjLoad *, uint32_t), struct ObjLoad * load) {
+	struct TaskQueue queue = (struct TaskQueue) {};
+	queue.task = task;
+	queue.load = load;
+	queue.count = count;
+	queue.next = 0;
+	mtx_init(&queue.mutex, mtx_plain);
+	thrd_t threads[OBJ_LOADER_MAX_THREADS];
+	uint32_t started = 0;
+	for (; started + 1 < threadCount && started + 1 < count; ++started) {
+		if (thrd_create(&threads[started], taskThread, &queue) != thrd_success) break;
+	}
+	taskThread(&queue);
+	for (uint32_t i = 0; i < started; ++i) {
+		thrd_join(threads[i], NULL);
+	}
+	mtx_destroy(&queue.mutex);
+}
+
+// Parsing
+
+static bool isBlank(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static char const * skipBlanks(char const * p, char const * end) {
+	while (p < end && isBlank(*p)) ++p;
+	return p;
+}
+
+static bool atLineEnd(char const * p, char const * end) {
+	return p >= end || *p == '\n' || *p == '#';
+}
+
+static double const powersOf10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+	1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/**
+ * Parse a decimal float such as -1.25e-3, whatever the locale. Digits
+ * beyond the 19th only scale the result, which is plenty for a float.
+ */
+static bool parseFloat(char const ** cursor, char const * end, float * value) {
+	char const * p = *cursor;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+	uint64_t mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	char const * start = p;
+	for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+		if (digits < 19) {
+			mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+			if (mantissa != 0) ++digits;
+		} else {
+			++exponent;
+		}
+	}
+	if (p < end && *p == '.') {
+		for (++p; p < end && *p >= '0' && *p <= '9'; ++p) {
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+				if (mantissa != 0) ++digits;
+				--exponent;
+			}
+		}
+	}
+	if (p == start || (p == start + 1 && *start == '.')) return false;
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		char const * e = p + 1;
+		bool negativeExponent = false;
+		if (e < end && (*e == '-' || *e == '+')) negativeExponent = *e++ == '-';
+		if (e < end && *e >= '0' && *e <= '9') {
+			int explicitExponent = 0;
+			for (; e < end && *e >= '0' && *e <= '9'; ++e) {
+				if (explicitExponent < 10000) explicitExponent = explicitExponent * 10 + (*e - '0');
+			}
+			exponent += negativeExponent ? -explicitExponent : explicitExponent;
+			p = e;
+		}
+	}
+
+	double result = (double)mantissa;
+	if (mantissa != 0) {
+		// Float range is far within 1e-60..1e60, clamp to stay out of
+		// double denormals and infinities
+		if (exponent < -60) exponent = -60;
+		if (exponent > 60) exponent = 60;
+		while (exponent > 22) { result *= 1e22; exponent -= 22; }
+		while (exponent < -22) { result /= 1e22; exponent += 22; }
+		result = exponent >= 0 ? result * powersOf10[exponent] : result / powersOf10[-exponent];
+	}
+	*value = (float)(negative ? -result : result);
+	*cursor = p;
+	return true;
+}
+
+static bool parseIndex(char const ** cursor, char const * end, int64_t * value) {
+	char const * p = *cursor;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+	if (p >= end || *p < '0' || *p > '9') return false;
+	int64_t result = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+		if (result < ((int64_t)1 << 40)) result = result * 10 + (*p - '0');
+	}
+	*value = negative ? -result : result;
+	*cursor = p;
+	return true;
+}
+
+/**
+ * Turn a 1-based or relative OBJ index into a 0-based one, given how many
+ * elements precede this line. Returns false if it is out of range.
+ */
+static bool resolveIndex(int64_t index, uint64_t preceding, uint64_t total, uint32_t * resolved) {
+	int64_t i = index > 0 ? index - 1 : (int64_t)preceding + index;
+	if (index == 0 || i < 0 || (uint64_t)i >= total) return false;
+	*resolved = (uint32_t)i;
+	return true;
+}
+
+static void failChunk(struct ObjLoad * load, struct ObjChunk * chunk, char const * line) {
+	if (!chunk->failed) {
+		chunk->failed = true;
+		chunk->errorOffset = (size_t)(line - load->data);
+	}
+}
+
+/**
+ * Parse the chunk, only counting its elements if `fill` is false, or
+ * writing them to the arrays of the whole file otherwise.
+ */
+static void parseChunk(struct ObjLoad * load, struct ObjChunk * chunk, bool fill) {
+	uint64_t counts[ObjElement_Count] = { 0, 0, 0, 0 };
+	char const * end = chunk->end;
+	char const * line = chunk->begin;
+	while (line < end) {
+		char const * next = (char const *)memchr(line, '\n', (size_t)(end - line));
+		next = next ? next + 1 : end;
+		char const * p = skipBlanks(line, next);
+
+		if (p + 1 < next && p[0] == 'v' && isBlank(p[1])) {
+			if (fill) {
+				float * position = load->positions + 3 * (chunk->bases[ObjElement_Position] + counts[ObjElement_Position]);
+				p += 2;
+				for (int k = 0; k < 3; ++k) {
+					p = skipBlanks(p, next);
+					if (!parseFloat(&p, next, &position[k])) {
+						failChunk(load, chunk, line);
+						position[k] = 0.0f;
+					}
+					if (position[k] < chunk->boundsMin[k]) chunk->boundsMin[k] = position[k];
+					if (position[k] > chunk->boundsMax[k]) chunk->boundsMax[k] = position[k];
+				}
+			}
+			counts[ObjElement_Position]++;
+		} else if (p + 2 < next && p[0] == 'v' && p[1] == 't' && isBlank(p[2])) {
+			if (fill) {
+				float * texcoord = load->texcoords + 2 * (chunk->bases[ObjElement_Texcoord] + counts[ObjElement_Texcoord]);
+				p += 3;
+				for (int k = 0; k < 2; ++k) {
+					p = skipBlanks(p, next);
+					// A missing v is allowed and means 0
+					if (k == 1 && atLineEnd(p, next)) {
+						texcoord[k] = 0.0f;
+					} else if (!parseFloat(&p, next, &texcoord[k])) {
+						failChunk(load, chunk, line);
+						texcoord[k] = 0.0f;
+					}
+				}
+				// OBJ has v = 0 at the bottom
+				texcoord[1] = 1.0f - texcoord[1];
+			}
+			counts[ObjElement_Texcoord]++;
+		} else if (p + 2 < next && p[0] == 'v' && p[1] == 'n' && isBlank(p[2])) {
+			if (fill) {
+				float * normal = load->normals + 3 * (chunk->bases[ObjElement_Normal] + counts[ObjElement_Normal]);
+				p += 3;
+				for (int k = 0; k < 3; ++k) {
+					p = skipBlanks(p, next);
+					if (!parseFloat(&p, next, &normal[k])) {
+						failChunk(load, chunk, line);
+						normal[k] = 0.0f;
+					}
+				}
+			}
+			counts[ObjElement_Normal]++;
+		} else if (p + 1 < next && p[0] == 'f' && isBlank(p[1])) {
+			p += 2;
+			uint32_t faceVertexCount = 0;
+			uint32_t first[3] = { 0, 0, 0 };
+			uint32_t previous[3] = { 0, 0, 0 };
+			for (;;) {
+				p = skipBlanks(p, next);
+				if (atLineEnd(p, next)) break;
+				uint32_t tuple[3] = { NO_INDEX, NO_INDEX, NO_INDEX };
+				if (fill) {
+					// v, v/vt, v//vn or v/vt/vn
+					int64_t index;
+					bool valid = parseIndex(&p, next, &index)
+						&& resolveIndex(index, chunk->bases[ObjElement_Position] + counts[ObjElement_Position], load->totals[ObjElement_Position], &tuple[0]);
+					if (valid && p < next && *p == '/') {
+						++p;
+						if (p < next && *p != '/') {
+							valid = parseIndex(&p, next, &index)
+								&& resolveIndex(index, chunk->bases[ObjElement_Texcoord] + counts[ObjElement_Texcoord], load->totals[ObjElement_Texcoord], &tuple[1]);
+						}
+						if (valid && p < next && *p == '/') {
+							++p;
+							valid = parseIndex(&p, next, &index)
+								&& resolveIndex(index, chunk->bases[ObjElement_Normal] + counts[ObjElement_Normal], load->totals[ObjElement_Normal], &tuple[2]);
+						}
+					}
+					if (!valid || (p < next && !isBlank(*p) && *p != '\n')) {
+						failChunk(load, chunk, line);
+						while (p < next && !isBlank(*p) && *p != '\n') ++p;
+					}
+				} else {
+					while (p < next && !isBlank(*p) && *p != '\n') ++p;
+				}
+
+				// Fan triangulation: (first, previous, current)
+				if (faceVertexCount == 0) {
+					memcpy(first, tuple, sizeof(first));
+				} else if (faceVertexCount >= 2) {
+					if (fill) {
+						uint32_t * corner = load->corners + 3 * (chunk->bases[ObjElement_Corner] + counts[ObjElement_Corner]);
+						memcpy(corner, first, sizeof(first));
+						memcpy(corner + 3, previous, sizeof(previous));
+						memcpy(corner + 6, tuple, sizeof(tuple));
+					}
+					counts[ObjElement_Corner] += 3;
+				}
+				memcpy(previous, tuple, sizeof(previous));
+				++faceVertexCount;
+			}
+		}
+		line = next;
+	}
+	if (!fill) memcpy(chunk->counts, counts, sizeof(counts));
+}
+
+static void countChunk(struct ObjLoad * load, uint32_t index) {
+	parseChunk(load, &load->chunks[index], false);
+}
+
+static void fillChunk(struct ObjLoad * load, uint32_t index) {
+	parseChunk(load, &load->chunks[index], true);
+}
+
+// Deduplication
+
+static uint32_t hashCorner(uint32_t const * corner) {
+	uint32_t h = corner[0] * 0x9e3779b1u ^ corner[1] * 0x85ebca77u ^ corner[2] * 0xc2b2ae3du;
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+	return h;
+}
+
+static uint32_t shardOf(uint32_t hash) {
+	return hash & (SHARD_COUNT - 1);
+}
+
+static void countShards(struct ObjLoad * load, uint32_t index) {
+	struct ObjChunk * chunk = &load->chunks[index];
+	uint64_t first = chunk->bases[ObjElement_Corner];
+	uint64_t last = first + chunk->counts[ObjElement_Corner];
+	for (uint64_t c = first; c < last; ++c) {
+		chunk->shardCounts[shardOf(hashCorner(load->corners + 3 * c))]++;
+	}
+}
+
+static void scatterShards(struct ObjLoad * load, uint32_t index) {
+	struct ObjChunk * chunk = &load->chunks[index];
+	uint64_t first = chunk->bases[ObjElement_Corner];
+	uint64_t last = first + chunk->counts[ObjElement_Corner];
+	for (uint64_t c = first; c < last; ++c) {
+		uint32_t shard = shardOf(hashCorner(load->corners + 3 * c));
+		load->partition[chunk->shardOffsets[shard]++] = (uint32_t)c;
+	}
+}
+
+/**
+ * Deduplicate the corners of a shard, which come in file order. Each
+ * corner's index is set to the shard-local index of its vertex.
+ */
+static void dedupShard(struct ObjLoad * load, uint32_t index) {
+	struct ObjShard * shard = &load->shards[index];
+	if (shard->count == 0) return;
+	uint32_t capacity = 16;
+	while (capacity < 2 * (uint64_t)shard->count) capacity *= 2;
+	// Shard-local vertex index + 1 per slot, 0 when empty
+	uint32_t * table = (uint32_t *)calloc(capacity, sizeof(uint32_t));
+	shard->firstCorners = (uint32_t *)malloc((size_t)shard->count * sizeof(uint32_t));
+	if (!table || !shard->firstCorners) {
+		free(table);
+		shard->failed = true;
+		return;
+	}
+
+	uint32_t * indices = load->mesh->indices;
+	for (uint32_t i = 0; i < shard->count; ++i) {
+		uint32_t c = load->partition[shard->begin + i];
+		uint32_t const * corner = load->corners + 3 * (size_t)c;
+		// The low bits chose the shard
+		uint32_t slot = (hashCorner(corner) / SHARD_COUNT) & (capacity - 1);
+		for (;;) {
+			uint32_t entry = table[slot];
+			if (entry == 0) {
+				shard->firstCorners[shard->vertexCount] = c;
+				table[slot] = ++shard->vertexCount;
+				indices[c] = shard->vertexCount - 1;
+				break;
+			}
+			uint32_t const * other = load->corners + 3 * (size_t)shard->firstCorners[entry - 1];
+			if (other[0] == corner[0] && other[1] == corner[1] && other[2] == corner[2]) {
+				indices[c] = entry - 1;
+				break;
+			}
+			slot = (slot + 1) & (capacity - 1);
+		}
+	}
+	free(table);
+}
+
+/**
+ * Offset the indices of a shard's corners to their final value, and
+ * write the shard's vertices.
+ */
+static void emitShard(struct ObjLoad * load, uint32_t index) {
+	struct ObjShard * shard = &load->shards[index];
+	struct ObjMesh * mesh = load->mesh;
+	for (uint32_t i = 0; i < shard->count; ++i) {
+		mesh->indices[load->partition[shard->begin + i]] += shard->vertexBase;
+	}
+	for (uint32_t v = 0; v < shard->vertexCount; ++v) {
+		uint32_t const * corner = load->corners + 3 * (size_t)shard->firstCorners[v];
+		struct ObjVertex * vertex = &mesh->vertices[shard->vertexBase + v];
+		memcpy(vertex->position, load->positions + 3 * (size_t)corner[0], sizeof(vertex->position));
+		if (corner[1] != NO_INDEX) {
+			memcpy(vertex->uv, load->texcoords + 2 * (size_t)corner[1], sizeof(vertex->uv));
+		} else {
+			vertex->uv[0] = vertex->uv[1] = 0.0f;
+		}
+		if (corner[2] != NO_INDEX) {
+			memcpy(vertex->normal, load->normals + 3 * (size_t)corner[2], sizeof(vertex->normal));
+		} else {
+			vertex->normal[0] = vertex->normal[1] = vertex->normal[2] = 0.0f;
+		}
+	}
+}
+
+/**
+ * Area weighted normals, shared by all the vertices at a same position so
+ * that texture seams do not show in the shading.
+ */
+static bool computeNormals(struct ObjLoad * load) {
+	struct ObjMesh * mesh = load->mesh;
+	uint64_t positionCount = load->totals[ObjElement_Position];
+	float * normals = (float *)calloc(3 * positionCount, sizeof(float));
+	if (!normals) return false;
+	for (uint64_t c = 0; c < mesh->indexCount; c += 3) {
+		uint32_t const * corner = load->corners + 3 * c;
+		float const * a = load->positions + 3 * (size_t)corner[0];
+		float const * b = load->positions + 3 * (size_t)corner[3];
+		float const * d = load->positions + 3 * (size_t)corner[6];
+		float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float e2[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+		float n[3] = {
+			e1[1] * e2[2] - e1[2] * e2[1],
+			e1[2] * e2[0] - e1[0] * e2[2],
+			e1[0] * e2[1] - e1[1] * e2[0],
+		};
+		for (int k = 0; k < 3; ++k) {
+			float * target = normals + 3 * (size_t)corner[3 * k];
+			target[0] += n[0];
+			target[1] += n[1];
+			target[2] += n[2];
+		}
+	}
+	for (uint32_t s = 0; s < SHARD_COUNT; ++s) {
+		struct ObjShard * shard = &load->shards[s];
+		for (uint32_t v = 0; v < shard->vertexCount; ++v) {
+			float const * n = normals + 3 * (size_t)load->corners[3 * (size_t)shard->firstCorners[v]];
+			float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			float * normal = mesh->vertices[shard->vertexBase + v].normal;
+			for (int k = 0; k < 3; ++k) normal[k] = length > 0.0f ? n[k] / length : 0.0f;
+		}
+	}
+	free(normals);
+	return true;
+}
+
+static void freeLoad(struct ObjLoad * load) {
+	free(load->chunks);
+	free(load->positions);
+	free(load->texcoords);
+	free(load->normals);
+	free(load->corners);
+	free(load->partition);
+	for (uint32_t s = 0; s < SHARD_COUNT; ++s) {
+		free(load->shards[s].firstCorners);
+	}
+}
+
+struct ObjMesh * objMeshLoad(char const * path, uint32_t threadCount) {
+	if (threadCount == 0) threadCount = OBJ_LOADER_DEFAULT_THREADS;
+	if (threadCount > OBJ_LOADER_MAX_THREADS) threadCount = OBJ_LOADER_MAX_THREADS;
+	struct MappedFile * file = mappedFileOpen(path);
+	if (!file) return NULL;
+
+	struct ObjLoad load = (struct ObjLoad) {};
+	load.data = (char const *)file->data;
+	load.mesh = (struct ObjMesh *)calloc(1, sizeof(struct ObjMesh));
+	bool ok = true;
+
+	// 1. Cut the file in chunks, at line boundaries
+	uint64_t chunkCount = file->size / MIN_CHUNK_SIZE + 1;
+	if (chunkCount > (uint64_t)threadCount * CHUNKS_PER_THREAD) chunkCount = (uint64_t)threadCount * CHUNKS_PER_THREAD;
+	load.chunks = (struct ObjChunk *)calloc((size_t)chunkCount, sizeof(struct ObjChunk));
+	char const * end = load.data + file->size;
+	char const * begin = load.data;
+	for (uint64_t i = 0; i < chunkCount; ++i) {
+		char const * chunkEnd = i + 1 == chunkCount ? end : load.data + file->size * (i + 1) / chunkCount;
+		if (chunkEnd < begin) chunkEnd = begin;
+		if (chunkEnd < end) {
+			char const * newline = (char const *)memchr(chunkEnd, '\n', (size_t)(end - chunkEnd));
+			chunkEnd = newline ? newline + 1 : end;
+		}
+		struct ObjChunk * chunk = &load.chunks[load.chunkCount++];
+		chunk->begin = begin;
+		chunk->end = chunkEnd;
+		for (int k = 0; k < 3; ++k) {
+			chunk->boundsMin[k] = FLT_MAX;
+			chunk->boundsMax[k] = -FLT_MAX;
+		}
+		begin = chunkEnd;
+		if (begin == end) break;
+	}
+
+	// 2. Count the elements of each chunk, to know where they go
+	parallelFor(threadCount, load.chunkCount, countChunk, &load);
+	for (uint32_t i = 0; i < load.chunkCount; ++i) {
+		for (int e = 0; e < ObjElement_Count; ++e) {
+			load.chunks[i].bases[e] = load.totals[e];
+			load.totals[e] += load.chunks[i].counts[e];
+		}
+	}
+	if (load.totals[ObjElement_Corner] == 0 || load.totals[ObjElement_Corner] > UINT32_MAX || load.totals[ObjElement_Position] >= NO_INDEX
+		|| load.totals[ObjElement_Texcoord] >= NO_INDEX || load.totals[ObjElement_Normal] >= NO_INDEX) {
+		fprintf(stderr, "%s has no faces or too many for 32-bit indices\n", path);
+		ok = false;
+	}
+
+	// 3. Parse them in place
+	if (ok) {
+		load.positions = (float *)malloc((size_t)(3 * load.totals[ObjElement_Position]) * sizeof(float));
+		load.texcoords = (float *)malloc((size_t)(2 * load.totals[ObjElement_Texcoord] + 1) * sizeof(float));
+		load.normals = (float *)malloc((size_t)(3 * load.totals[ObjElement_Normal] + 1) * sizeof(float));
+		load.corners = (uint32_t *)malloc((size_t)(3 * load.totals[ObjElement_Corner]) * sizeof(uint32_t));
+		load.partition = (uint32_t *)malloc((size_t)load.totals[ObjElement_Corner] * sizeof(uint32_t));
+		load.mesh->indexCount = (uint32_t)load.totals[ObjElement_Corner];
+		load.mesh->indices = (uint32_t *)malloc((size_t)load.mesh->indexCount * sizeof(uint32_t));
+		ok = load.positions && load.texcoords && load.normals && load.corners && load.partition && load.mesh->indices;
+		if (!ok) fprintf(stderr, "Not enough memory to load %s\n", path);
+	}
+	if (ok) {
+		parallelFor(threadCount, load.chunkCount, fillChunk, &load);
+		for (uint32_t i = 0; i < load.chunkCount && ok; ++i) {
+			if (load.chunks[i].failed) {
+				fprintf(stderr, "Malformed line in %s at byte %zu\n", path, load.chunks[i].errorOffset);
+				ok = false;
+			}
+		}
+	}
+
+	// 4. Deduplicate corners into vertices, shard by shard
+	if (ok) {
+		parallelFor(threadCount, load.chunkCount, countShards, &load);
+		uint32_t offset = 0;
+		for (uint32_t s = 0; s < SHARD_COUNT; ++s) {
+			load.shards[s].begin = offset;
+			for (uint32_t i = 0; i < load.chunkCount; ++i) {
+				load.chunks[i].shardOffsets[s] = offset;
+				offset += load.chunks[i].shardCounts[s];
+			}
+			load.shards[s].count = offset - load.shards[s].begin;
+		}
+		parallelFor(threadCount, load.chunkCount, scatterShards, &load);
+		parallelFor(threadCount, SHARD_COUNT, dedupShard, &load);
+
+		uint32_t vertexCount = 0;
+		for (uint32_t s = 0; s < SHARD_COUNT; ++s) {
+			if (load.shards[s].failed) ok = false;
+			load.shards[s].vertexBase = vertexCount;
+			vertexCount += load.shards[s].vertexCount;
+		}
+		load.mesh->vertexCount = vertexCount;
+		load.mesh->vertices = ok ? (struct ObjVertex *)malloc((size_t)vertexCount * sizeof(struct ObjVertex)) : NULL;
+		if (!load.mesh->vertices) {
+			fprintf(stderr, "Not enough memory to load %s\n", path);
+			ok = false;
+		}
+	}
+	if (ok) {
+		parallelFor(threadCount, SHARD_COUNT, emitShard, &load);
+		load.mesh->hasTexcoords = load.totals[ObjElement_Texcoord] > 0;
+		load.mesh->hasNormals = load.totals[ObjElement_Normal] > 0;
+		if (!load.mesh->hasNormals) ok = computeNormals(&load);
+		for (int k = 0; k < 3; ++k) {
+			load.mesh->boundsMin[k] = FLT_MAX;
+			load.mesh->boundsMax[k] = -FLT_MAX;
+			for (uint32_t i = 0; i < load.chunkCount; ++i) {
+				if (load.chunks[i].boundsMin[k] < load.mesh->boundsMin[k]) load.mesh->boundsMin[k] = load.chunks[i].boundsMin[k];
+				if (load.chunks[i].boundsMax[k] > load.mesh->boundsMax[k]) load.mesh->boundsMax[k] = load.chunks[i].boundsMax[k];
+			}
+		}
+	}
+
+	freeLoad(&load);
+	mappedFileClose(file);
+	if (!ok) {
+		objMeshRelease(load.mesh);
+		return NULL;
+	}
+	return load.mesh;
+}
+
+void objMeshRelease(struct ObjMesh * mesh) {
+	if (!mesh) return;
+	free(mesh->vertices);
+	free(mesh->indices);
+	free(mesh);
+}
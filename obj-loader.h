@@ -0,0 +1,73 @@
+/**
+ * Wavefront OBJ loader for large meshes, e.g. 3D scans of 100M triangles.
+ *
+ * The file is memory mapped (see mapped-file.h) and cut into chunks at
+ * line boundaries that worker threads parse in two passes: the first
+ * counts the elements of each chunk, so that the second can parse them
+ * straight into their final place in shared arrays and resolve relative
+ * (negative) indices without any synchronization. Floats are parsed by a
+ * dedicated parser that ignores the locale.
+ *
+ * Faces are triangulated as fans, and the (position, texcoord, normal)
+ * tuples of their corners are deduplicated into an indexed mesh by a hash
+ * map partitioned in shards: corners are first scattered by the shard
+ * their tuple hashes to, then each thread deduplicates whole shards in a
+ * table of its own. The vertex order only depends on the file, not on the
+ * number of threads.
+ *
+ * Only v, vt, vn and f lines are read; objects, groups and materials are
+ * ignored. Texture coordinates are flipped vertically to WebGPU's
+ * convention (v = 0 at the top). When the file has no normals at all,
+ * smooth normals are computed from the faces around each position.
+ *
+ * Typical use:
+ *     struct ObjMesh * mesh = objMeshLoad("suzanne.obj", 0);
+ *     // upload mesh->vertices and mesh->indices
+ *     objMeshRelease(mesh);
+ */
+
+#ifndef _obj_loader_h_
+#define _obj_loader_h_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OBJ_LOADER_DEFAULT_THREADS 8
+#define OBJ_LOADER_MAX_THREADS 64
+
+struct ObjVertex {
+	float position[3];
+	float normal[3];
+	float uv[2];
+};
+
+struct ObjMesh {
+	struct ObjVertex * vertices;
+	uint32_t vertexCount;
+	// Triangle list, with the winding of the file
+	uint32_t * indices;
+	uint32_t indexCount;
+	bool hasTexcoords;
+	bool hasNormals; // false when they were computed
+	float boundsMin[3];
+	float boundsMax[3];
+};
+
+/**
+ * Load the OBJ file at `path` on `threadCount` threads, or
+ * OBJ_LOADER_DEFAULT_THREADS when 0. Returns NULL if the file cannot be
+ * read or is malformed.
+ */
+struct ObjMesh * objMeshLoad(char const * path, uint32_t threadCount);
+
+void objMeshRelease(struct ObjMesh * mesh);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _obj_loader_h_
@@ -0,0 +1,307 @@
+#include "occlusion-culling.h"
+#include "webgpu-utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_HYSTERESIS_FRAMES 3
+
+// Boxes closer than this to the camera may be clipped by the near plane,
+// which would wrongly report them as occluded.
+#define CAMERA_INSIDE_MARGIN 0.1f
+
+// Matches the WGSL `Box` struct.
+struct ProxyBox {
+	float min[4];
+	float max[4];
+};
+
+static const char* proxyShaderSource = "\
+struct Uniforms {\n\
+    viewProj: mat4x4f,\n\
+}\n\
+struct Box {\n\
+    min: vec4f,\n\
+    max: vec4f,\n\
+}\n\
+\n\
+@group(0) @binding(0) var<uniform> uniforms: Uniforms;\n\
+@group(0) @binding(1) var<storage, read> boxes: array<Box>;\n\
+\n\
+// Corner c of the box has coordinates (c & 1, (c >> 1) & 1, (c >> 2) & 1)\n\
+var<private> cubeIndices: array<u32, 36> = array<u32, 36>(\n\
+    0u, 2u, 6u, 0u, 6u, 4u,\n\
+    1u, 5u, 7u, 1u, 7u, 3u,\n\
+    0u, 4u, 5u, 0u, 5u, 1u,\n\
+    2u, 3u, 7u, 2u, 7u, 6u,\n\
+    0u, 1u, 3u, 0u, 3u, 2u,\n\
+    4u, 6u, 7u, 4u, 7u, 5u,\n\
+);\n\
+\n\
+@vertex\n\
+fn vs_main(@builtin(vertex_index) in_vertex_index: u32, @builtin(instance_index) in_instance_index: u32) -> @builtin(position) vec4f {\n\
+    let c = cubeIndices[in_vertex_index];\n\
+    let corner = vec3f(f32(c & 1u), f32((c >> 1u) & 1u), f32((c >> 2u) & 1u));\n\
+    let box = boxes[in_instance_index];\n\
+    let p = mix(box.min.xyz, box.max.xyz, corner);\n\
+    return uniforms.viewProj * vec4f(p, 1.0);\n\
+}\n\
+\n\
+@fragment\n\
+fn fs_main() -> @location(0) vec4f {\n\
+    return vec4f(0.0);\n\
+}\n\
+";
+
+static WGPURenderPipeline createProxyPipeline(WGPUDevice device, WGPUTextureFormat colorFormat, WGPUTextureFormat depthFormat) {
+	WGPUShaderModule shaderModule = createWGSLShaderModule(device, proxyShaderSource, "Occlusion proxy shader");
+
+	WGPURenderPipelineDescriptor pipelineDesc = (WGPURenderPipelineDescriptor) {};
+	pipelineDesc.label = "Occlusion proxy pipeline";
+	pipelineDesc.vertex.module = shaderModule;
+	pipelineDesc.vertex.entryPoint = "vs_main";
+	pipelineDesc.vertex.bufferCount = 0;
+	pipelineDesc.vertex.buffers = NULL;
+
+	pipelineDesc.primitive.topology = WGPUPrimitiveTopology_TriangleList;
+	pipelineDesc.primitive.stripIndexFormat = WGPUIndexFormat_Undefined;
+	pipelineDesc.primitive.frontFace = WGPUFrontFace_CCW;
+	// Both faces so that the test still works when the box is seen from inside
+	pipelineDesc.primitive.cullMode = WGPUCullMode_None;
+
+	// Test against the depth of the occluders without modifying it
+	WGPUDepthStencilState depthStencilState = (WGPUDepthStencilState) {};
+	depthStencilState.format = depthFormat;
+	depthStencilState.depthWriteEnabled = false;
+	depthStencilState.depthCompare = WGPUCompareFunction_LessEqual;
+	depthStencilState.stencilFront.compare = WGPUCompareFunction_Always;
+	depthStencilState.stencilBack.compare = WGPUCompareFunction_Always;
+	depthStencilState.stencilReadMask = 0;
+	depthStencilState.stencilWriteMask = 0;
+	pipelineDesc.depthStencil = &depthStencilState;
+
+	WGPUColorTargetState colorTarget = (WGPUColorTargetState) {};
+	colorTarget.format = colorFormat;
+	colorTarget.blend = NULL;
+	colorTarget.writeMask = WGPUColorWriteMask_None;
+
+	WGPUFragmentState fragmentState = (WGPUFragmentState) {};
+	fragmentState.module = shaderModule;
+	fragmentState.entryPoint = "fs_main";
+	fragmentState.targetCount = 1;
+	fragmentState.targets = &colorTarget;
+	pipelineDesc.fragment = &fragmentState;
+
+	pipelineDesc.multisample.count = 1;
+	pipelineDesc.multisample.mask = ~0u;
+	pipelineDesc.multisample.alphaToCoverageEnabled = false;
+
+	pipelineDesc.layout = NULL;
+
+	WGPURenderPipeline pipeline = wgpuDeviceCreateRenderPipeline(device, &pipelineDesc);
+	wgpuShaderModuleRelease(shaderModule);
+	return pipeline;
+}
+
+struct OcclusionCulling * occlusionCullingCreate(WGPUDevice device, uint32_t maxObjects, WGPUTextureFormat colorFormat, WGPUTextureFormat depthFormat) {
+	if (maxObjects == 0) {
+		fprintf(stderr, "Occlusion culling needs at least one object\n");
+		return NULL;
+	}
+
+	struct OcclusionCulling * oc = (struct OcclusionCulling *)calloc(1, sizeof(struct OcclusionCulling));
+	oc->device = device;
+	oc->queue = wgpuDeviceGetQueue(device);
+	oc->maxObjects = maxObjects;
+	oc->hysteresisFrames = DEFAULT_HYSTERESIS_FRAMES;
+	oc->boxes = (struct OcclusionBox *)calloc(maxObjects, sizeof(struct OcclusionBox));
+	oc->states = (struct OcclusionObjectState *)calloc(maxObjects, sizeof(struct OcclusionObjectState));
+
+	WGPUQuerySetDescriptor querySetDesc = (WGPUQuerySetDescriptor) {};
+	querySetDesc.label = "Occlusion queries";
+	querySetDesc.type = WGPUQueryType_Occlusion;
+	querySetDesc.count = maxObjects;
+	querySetDesc.pipelineStatistics = NULL;
+	querySetDesc.pipelineStatisticsCount = 0;
+	oc->querySet = wgpuDeviceCreateQuerySet(device, &querySetDesc);
+
+	// Each query resolves to a 64-bit sample count
+	uint64_t resultSize = (uint64_t)maxObjects * sizeof(uint64_t);
+	oc->resolveBuffer = createBuffer(device, resultSize, WGPUBufferUsage_QueryResolve | WGPUBufferUsage_CopySrc, "Occlusion resolve");
+	for (int i = 0; i < OCCLUSION_CULLING_RING_SIZE; ++i) {
+		oc->ring[i].buffer = createBuffer(device, resultSize, WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst, "Occlusion readback");
+		oc->ring[i].oc = oc;
+	}
+
+	oc->uniformBuffer = createBuffer(device, 16 * sizeof(float), WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst, "Occlusion uniforms");
+	oc->boxBuffer = createBuffer(device, (uint64_t)maxObjects * sizeof(struct ProxyBox), WGPUBufferUsage_Storage | WGPUBufferUsage_CopyDst, "Occlusion boxes");
+
+	oc->proxyPipeline = createProxyPipeline(device, colorFormat, depthFormat);
+
+	WGPUBindGroupEntry bindings[2];
+	bindings[0] = bufferBindGroupEntry(0, oc->uniformBuffer, 0, 16 * sizeof(float));
+	bindings[1] = bufferBindGroupEntry(1, oc->boxBuffer, 0, (uint64_t)maxObjects * sizeof(struct ProxyBox));
+	WGPUBindGroupDescriptor bindGroupDesc = (WGPUBindGroupDescriptor) {};
+	bindGroupDesc.label = "Occlusion bind group";
+	bindGroupDesc.layout = wgpuRenderPipelineGetBindGroupLayout(oc->proxyPipeline, 0);
+	bindGroupDesc.entryCount = 2;
+	bindGroupDesc.entries = bindings;
+	oc->bindGroup = wgpuDeviceCreateBindGroup(device, &bindGroupDesc);
+	wgpuBindGroupLayoutRelease(bindGroupDesc.layout);
+
+	return oc;
+}
+
+void occlusionCullingSetBounds(struct OcclusionCulling * oc, struct OcclusionBox const * boxes, uint32_t objectCount) {
+	if (objectCount > oc->maxObjects) {
+		fprintf(stderr, "Occlusion culling: %u objects exceed the capacity of %u, extra objects are ignored\n", objectCount, oc->maxObjects);
+		objectCount = oc->maxObjects;
+	}
+	if (objectCount == 0) {
+		oc->objectCount = 0;
+		return;
+	}
+
+	memcpy(oc->boxes, boxes, objectCount * sizeof(struct OcclusionBox));
+	struct ProxyBox * proxyBoxes = (struct ProxyBox *)calloc(objectCount, sizeof(struct ProxyBox));
+	for (uint32_t i = 0; i < objectCount; ++i) {
+		memcpy(proxyBoxes[i].min, boxes[i].min, 3 * sizeof(float));
+		memcpy(proxyBoxes[i].max, boxes[i].max, 3 * sizeof(float));
+		oc->states[i].visible = true;
+		oc->states[i].occludedFrames = 0;
+	}
+	wgpuQueueWriteBuffer(oc->queue, oc->boxBuffer, 0, proxyBoxes, objectCount * sizeof(struct ProxyBox));
+	free(proxyBoxes);
+
+	oc->objectCount = objectCount;
+	oc->visibleCount = objectCount;
+}
+
+static bool isCameraInside(struct OcclusionBox const * box, float const cameraPosition[3]) {
+	for (int k = 0; k < 3; ++k) {
+		if (cameraPosition[k] < box->min[k] - CAMERA_INSIDE_MARGIN) return false;
+		if (cameraPosition[k] > box->max[k] + CAMERA_INSIDE_MARGIN) return false;
+	}
+	return true;
+}
+
+void occlusionCullingBeginFrame(struct OcclusionCulling * oc, float const viewProj[16], float const cameraPosition[3]) {
+	wgpuQueueWriteBuffer(oc->queue, oc->uniformBuffer, 0, viewProj, 16 * sizeof(float));
+
+	// Objects around the camera cannot be tested reliably
+	for (uint32_t i = 0; i < oc->objectCount; ++i) {
+		if (isCameraInside(&oc->boxes[i], cameraPosition)) {
+			oc->states[i].visible = true;
+			oc->states[i].occludedFrames = 0;
+		}
+	}
+
+	// Only issue queries if there is a readback slot to receive them, so
+	// that we never have to wait for a previous frame's results.
+	struct OcclusionReadbackSlot * slot = &oc->ring[oc->frame % OCCLUSION_CULLING_RING_SIZE];
+	oc->queriesThisFrame = !slot->inFlight && oc->objectCount > 0;
+}
+
+bool occlusionCullingIsVisible(struct OcclusionCulling const * oc, uint32_t i) {
+	return i >= oc->objectCount || oc->states[i].visible;
+}
+
+void occlusionCullingEncodeQueries(struct OcclusionCulling * oc, WGPURenderPassEncoder renderPass) {
+	if (!oc->queriesThisFrame) return;
+
+	wgpuRenderPassEncoderSetPipeline(renderPass, oc->proxyPipeline);
+	wgpuRenderPassEncoderSetBindGroup(renderPass, 0, oc->bindGroup, 0, NULL);
+	for (uint32_t i = 0; i < oc->objectCount; ++i) {
+		wgpuRenderPassEncoderBeginOcclusionQuery(renderPass, i);
+		// The instance index selects the box
+		wgpuRenderPassEncoderDraw(renderPass, 36, 1, 0, i);
+		wgpuRenderPassEncoderEndOcclusionQuery(renderPass);
+	}
+}
+
+void occlusionCullingResolve(struct OcclusionCulling * oc, WGPUCommandEncoder encoder) {
+	if (!oc->queriesThisFrame) return;
+
+	struct OcclusionReadbackSlot * slot = &oc->ring[oc->frame % OCCLUSION_CULLING_RING_SIZE];
+	uint64_t resultSize = (uint64_t)oc->objectCount * sizeof(uint64_t);
+	wgpuCommandEncoderResolveQuerySet(encoder, oc->querySet, 0, oc->objectCount, oc->resolveBuffer, 0);
+	wgpuCommandEncoderCopyBufferToBuffer(encoder, oc->resolveBuffer, 0, slot->buffer, 0, resultSize);
+	slot->objectCount = oc->objectCount;
+	slot->inFlight = true;
+	slot->pendingMap = true;
+}
+
+static void onOcclusionResultsMapped(WGPUBufferMapAsyncStatus status, void * pUserData) {
+	struct OcclusionReadbackSlot * slot = (struct OcclusionReadbackSlot *)pUserData;
+	struct OcclusionCulling * oc = slot->oc;
+	if (status == WGPUBufferMapAsyncStatus_Success) {
+		size_t resultSize = slot->objectCount * sizeof(uint64_t);
+		uint64_t const * samples = (uint64_t const *)wgpuBufferGetConstMappedRange(slot->buffer, 0, resultSize);
+		// Bounds may have changed since these queries were issued
+		uint32_t count = slot->objectCount < oc->objectCount ? slot->objectCount : oc->objectCount;
+		for (uint32_t i = 0; samples && i < count; ++i) {
+			struct OcclusionObjectState * state = &oc->states[i];
+			if (samples[i] > 0) {
+				state->visible = true;
+				state->occludedFrames = 0;
+			} else {
+				if (state->occludedFrames < 255) state->occludedFrames++;
+				if (state->occludedFrames >= oc->hysteresisFrames) state->visible = false;
+			}
+		}
+		wgpuBufferUnmap(slot->buffer);
+
+		uint32_t visibleCount = 0;
+		for (uint32_t i = 0; i < oc->objectCount; ++i) {
+			if (oc->states[i].visible) ++visibleCount;
+		}
+		oc->visibleCount = visibleCount;
+	}
+	slot->inFlight = false;
+}
+
+void occlusionCullingAfterSubmit(struct OcclusionCulling * oc) {
+	struct OcclusionReadbackSlot * slot = &oc->ring[oc->frame % OCCLUSION_CULLING_RING_SIZE];
+	if (slot->pendingMap) {
+		slot->pendingMap = false;
+		size_t resultSize = slot->objectCount * sizeof(uint64_t);
+		wgpuBufferMapAsync(slot->buffer, WGPUMapMode_Read, 0, resultSize, onOcclusionResultsMapped, (void *)slot);
+	}
+	oc->frame++;
+}
+
+void occlusionCullingRelease(struct OcclusionCulling * oc) {
+	if (!oc) return;
+	// Pending maps call back into the ring: cancel them by unmapping, then
+	// tick until their callbacks have run
+	for (int i = 0; i < OCCLUSION_CULLING_RING_SIZE; ++i) {
+		struct OcclusionReadbackSlot * slot = &oc->ring[i];
+		if (slot->pendingMap) {
+			slot->pendingMap = false;
+			slot->inFlight = false;
+		} else if (slot->inFlight) {
+			wgpuBufferUnmap(slot->buffer);
+		}
+	}
+	for (int i = 0; i < OCCLUSION_CULLING_RING_SIZE; ++i) {
+		while (oc->ring[i].inFlight) {
+#ifdef WEBGPU_BACKEND_DAWN
+			wgpuDeviceTick(oc->device);
+#endif
+		}
+	}
+	wgpuBindGroupRelease(oc->bindGroup);
+	wgpuRenderPipelineRelease(oc->proxyPipeline);
+	wgpuBufferRelease(oc->boxBuffer);
+	wgpuBufferRelease(oc->uniformBuffer);
+	for (int i = 0; i < OCCLUSION_CULLING_RING_SIZE; ++i) {
+		wgpuBufferRelease(oc->ring[i].buffer);
+	}
+	wgpuBufferRelease(oc->resolveBuffer);
+	wgpuQuerySetRelease(oc->querySet);
+	wgpuQueueRelease(oc->queue);
+	free(oc->states);
+	free(oc->boxes);
+	free(oc);
+}
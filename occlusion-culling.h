@@ -0,0 +1,127 @@
+/**
+ * Temporal occlusion culling driven by occlusion queries.
+ *
+ * Every frame, after the visible objects have been drawn, the bounding box
+ * of each object is rasterized against the depth buffer inside an occlusion
+ * query. Query results are resolved into a ring of readback buffers and only
+ * consumed once mapped, so the CPU never waits on the GPU: objects are
+ * skipped based on the results of a previous frame.
+ *
+ * To avoid popping, an object is hidden only after it has been reported
+ * occluded for `hysteresisFrames` results in a row, while a single passing
+ * sample makes it visible again.
+ *
+ * Typical frame:
+ *     occlusionCullingBeginFrame(oc, viewProj, cameraPosition);
+ *     // render pass created with occlusionQuerySet = oc->querySet
+ *     for each object i: if (occlusionCullingIsVisible(oc, i)) draw(i);
+ *     occlusionCullingEncodeQueries(oc, renderPass);
+ *     // end render pass
+ *     occlusionCullingResolve(oc, encoder);
+ *     wgpuQueueSubmit(...);
+ *     occlusionCullingAfterSubmit(oc);
+ */
+
+#ifndef _occlusion_culling_h_
+#define _occlusion_culling_h_
+
+#include <webgpu/webgpu.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OCCLUSION_CULLING_RING_SIZE 3
+
+struct OcclusionBox {
+	float min[3];
+	float max[3];
+};
+
+struct OcclusionObjectState {
+	bool visible;
+	uint8_t occludedFrames; // consecutive results reporting no sample passed
+};
+
+struct OcclusionReadbackSlot {
+	WGPUBuffer buffer;
+	uint32_t objectCount; // number of queries issued in the frame it holds
+	bool inFlight;
+	bool pendingMap;
+	struct OcclusionCulling * oc;
+};
+
+struct OcclusionCulling {
+	WGPUDevice device;
+	WGPUQueue queue;
+	uint32_t maxObjects;
+	uint32_t objectCount;
+	uint32_t hysteresisFrames;
+
+	WGPUQuerySet querySet;
+	WGPUBuffer resolveBuffer;
+	WGPUBuffer uniformBuffer;
+	WGPUBuffer boxBuffer;
+	WGPUBindGroup bindGroup;
+	WGPURenderPipeline proxyPipeline;
+
+	struct OcclusionBox * boxes;
+	struct OcclusionObjectState * states;
+
+	struct OcclusionReadbackSlot ring[OCCLUSION_CULLING_RING_SIZE];
+	uint32_t frame;
+	bool queriesThisFrame;
+
+	// Profiling counter, updated whenever a readback completes
+	uint32_t visibleCount;
+};
+
+/**
+ * Create the query set, readback ring and bounding box pipeline. The color
+ * and depth formats must match the render pass the queries are issued in.
+ * Returns NULL on failure.
+ */
+struct OcclusionCulling * occlusionCullingCreate(WGPUDevice device, uint32_t maxObjects, WGPUTextureFormat colorFormat, WGPUTextureFormat depthFormat);
+
+/**
+ * Set the world space bounding boxes of the objects. Objects start visible.
+ */
+void occlusionCullingSetBounds(struct OcclusionCulling * oc, struct OcclusionBox const * boxes, uint32_t objectCount);
+
+/**
+ * Upload the camera for this frame's bounding box queries. `viewProj` is a
+ * column-major matrix.
+ */
+void occlusionCullingBeginFrame(struct OcclusionCulling * oc, float const viewProj[16], float const cameraPosition[3]);
+
+/**
+ * Whether object `i` should be drawn this frame.
+ */
+bool occlusionCullingIsVisible(struct OcclusionCulling const * oc, uint32_t i);
+
+/**
+ * Rasterize the bounding box of every object inside an occlusion query.
+ * Must be called in a render pass using `oc->querySet`, after occluders
+ * have been drawn.
+ */
+void occlusionCullingEncodeQueries(struct OcclusionCulling * oc, WGPURenderPassEncoder renderPass);
+
+/**
+ * Resolve the queries of this frame into a readback slot. Must be called
+ * after the render pass has ended.
+ */
+void occlusionCullingResolve(struct OcclusionCulling * oc, WGPUCommandEncoder encoder);
+
+/**
+ * Must be called once the command buffer has been submitted, to start
+ * mapping this frame's results.
+ */
+void occlusionCullingAfterSubmit(struct OcclusionCulling * oc);
+
+void occlusionCullingRelease(struct OcclusionCulling * oc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _occlusion_culling_h_
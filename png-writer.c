@@ -0,0 +1,98 @@
+#include "png-writer.h"
+
+#include <tinycthread.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+struct BandQueue {
+	stbi_write_task * task;
+	void * taskData;
+	int count;
+	int next;
+	mtx_t mutex;
+};
+
+static int bandThread(void * arg) {
+	struct BandQueue * queue = (struct BandQueue *)arg;
+	for (;;) {
+		mtx_lock(&queue->mutex);
+		int i = queue->next++;
+		mtx_unlock(&queue->mutex);
+		if (i >= queue->count) break;
+		queue->task(queue->taskData, i);
+	}
+	return 0;
+}
+
+/**
+ * stbi_write_parallel_func running the bands on up to
+ * `*(uint32_t *)context` threads, the calling one included.
+ */
+static void runBands(void * context, stbi_write_task * task, void * taskData, int count) {
+	uint32_t threadCount = *(uint32_t *)context;
+	struct BandQueue queue = (struct BandQueue) {};
+	queue.task = task;
+	queue.taskData = taskData;
+	queue.count = count;
+	queue.next = 0;
+	mtx_init(&queue.mutex, mtx_plain);
+
+	thrd_t threads[PNG_WRITER_MAX_THREADS];
+	uint32_t started = 0;
+	for (; started + 1 < threadCount && started < (uint32_t)count; ++started) {
+		if (thrd_create(&threads[started], bandThread, &queue) != thrd_success) break;
+	}
+	bandThread(&queue);
+	for (uint32_t i = 0; i < started; ++i) {
+		thrd_join(threads[i], NULL);
+	}
+	mtx_destroy(&queue.mutex);
+}
+
+static uint32_t bandCount(uint32_t height, uint32_t * threadCount) {
+	uint32_t maxBands = height / PNG_WRITER_MIN_BAND_ROWS;
+	if (maxBands < 1) maxBands = 1;
+	if (*threadCount == 0 || *threadCount > PNG_WRITER_MAX_THREADS) *threadCount = PNG_WRITER_MAX_THREADS;
+	// A few bands per thread even out the cost of rows that compress
+	// differently
+	uint32_t bands = *threadCount * 4;
+	return bands < maxBands ? bands : maxBands;
+}
+
+bool pngWrite(char const * path, uint32_t width, uint32_t height, uint32_t channels, void const * pixels, uint32_t bytesPerRow, uint32_t threadCount) {
+	uint32_t bands = bandCount(height, &threadCount);
+	if (!stbi_write_png_parallel(path, (int)width, (int)height, (int)channels, pixels, (int)bytesPerRow, (int)bands, runBands, &threadCount)) {
+		fprintf(stderr, "Could not write PNG file '%s'\n", path);
+		return false;
+	}
+	return true;
+}
+
+struct EncodeTarget {
+	void * data;
+	size_t size;
+};
+
+static void storeEncoded(void * context, void * data, int size) {
+	struct EncodeTarget * target = (struct EncodeTarget *)context;
+	target->data = malloc((size_t)size);
+	if (!target->data) return;
+	memcpy(target->data, data, (size_t)size);
+	target->size = (size_t)size;
+}
+
+bool pngEncode(uint32_t width, uint32_t height, uint32_t channels, void const * pixels, uint32_t bytesPerRow, uint32_t threadCount, void ** data, size_t * size) {
+	uint32_t bands = bandCount(height, &threadCount);
+	struct EncodeTarget target = (struct EncodeTarget) {};
+	if (!stbi_write_png_to_func_parallel(storeEncoded, &target, (int)width, (int)height, (int)channels, pixels, (int)bytesPerRow, (int)bands, runBands, &threadCount) || !target.data) {
+		return false;
+	}
+	*data = target.data;
+	*size = target.size;
+	return true;
+}
@@ -0,0 +1,516 @@
+#include "procedural-geometry.h"
+#include "webgpu-utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WORKGROUP_EDGE 4
+#define MAX_TRIANGLES_PER_CELL 5
+#define TRIANGLE_TABLE_SIZE (256 + 256 * 3 * MAX_TRIANGLES_PER_CELL)
+#define COUNTERS_SIZE (8 * sizeof(uint32_t))
+
+// Must match struct Params in the shader
+struct ProceduralParams {
+	float boundsMin[3];
+	float iso;
+	float cellSize[3];
+	float time;
+	uint32_t resolution;
+	uint32_t maxVertices;
+	uint32_t maxIndices;
+	uint32_t _pad;
+};
+
+char const * const proceduralSdfSphere = "\
+fn sdf(p: vec3f, time: f32) -> f32 {\n\
+    return length(p) - 1.0;\n\
+}\n\
+";
+
+char const * const proceduralSdfGyroid = "\
+fn sdf(p: vec3f, time: f32) -> f32 {\n\
+    let q = p * 12.0 + vec3f(0.0, 0.0, time);\n\
+    let gyroid = abs(dot(sin(q), cos(q.yzx))) / 12.0 - 0.02;\n\
+    return max(gyroid, length(p) - 1.0);\n\
+}\n\
+";
+
+// The shader is split in chunks to stay under the string literal length
+// that compilers must support.
+static const char* proceduralShaderChunks[] = {
+"\
+struct Params {\n\
+    boundsMin: vec3f,\n\
+    iso: f32,\n\
+    cellSize: vec3f,\n\
+    time: f32,\n\
+    resolution: u32,\n\
+    maxVertices: u32,\n\
+    maxIndices: u32,\n\
+}\n\
+// Starts with DrawIndexedIndirect arguments\n\
+struct Counters {\n\
+    indexCount: atomic<u32>,\n\
+    instanceCount: u32,\n\
+    firstIndex: u32,\n\
+    baseVertex: i32,\n\
+    firstInstance: u32,\n\
+    vertexCount: atomic<u32>,\n\
+    requestedIndices: u32,\n\
+    requestedVertices: u32,\n\
+}\n\
+@group(0) @binding(0) var<uniform> params: Params;\n\
+// 256 triangle counts, then 15 edges per case\n\
+@group(0) @binding(1) var<storage, read> triangleTable: array<u32>;\n\
+@group(0) @binding(2) var<storage, read_write> field: array<f32>;\n\
+// Vertex of each grid edge, 3 per corner (one per axis)\n\
+@group(0) @binding(3) var<storage, read_write> edgeVertices: array<u32>;\n\
+@group(0) @binding(4) var<storage, read_write> vertices: array<f32>;\n\
+@group(0) @binding(5) var<storage, read_write> indices: array<u32>;\n\
+@group(0) @binding(6) var<storage, read_write> counters: Counters;\n\
+\n\
+const INVALID = 0xffffffffu;\n\
+\n\
+var<workgroup> localCount: atomic<u32>;\n\
+var<workgroup> globalBase: u32;\n\
+\n\
+fn cornerIndex(c: vec3u) -> u32 {\n\
+    let n = params.resolution + 1u;\n\
+    return (c.z * n + c.y) * n + c.x;\n\
+}\n\
+\n\
+fn gridToWorld(c: vec3f) -> vec3f {\n\
+    return params.boundsMin + c * params.cellSize;\n\
+}\n\
+\n\
+fn isInside(value: f32) -> bool {\n\
+    return value < params.iso;\n\
+}\n\
+\n\
+fn sdfNormal(p: vec3f) -> vec3f {\n\
+    let h = 0.5 * params.cellSize;\n\
+    let g = vec3f(\n\
+        sdf(p + vec3f(h.x, 0.0, 0.0), params.time) - sdf(p - vec3f(h.x, 0.0, 0.0), params.time),\n\
+        sdf(p + vec3f(0.0, h.y, 0.0), params.time) - sdf(p - vec3f(0.0, h.y, 0.0), params.time),\n\
+        sdf(p + vec3f(0.0, 0.0, h.z), params.time) - sdf(p - vec3f(0.0, 0.0, h.z), params.time),\n\
+    );\n\
+    let l = length(g);\n\
+    return select(vec3f(0.0, 0.0, 1.0), g / l, l > 0.0);\n\
+}\n\
+\n\
+// Edges of a cell are numbered axis * 4 + the 2 bits of the other axes\n\
+fn edgeSlot(cell: vec3u, edge: u32) -> u32 {\n\
+    let axis = edge / 4u;\n\
+    let a = edge & 1u;\n\
+    let b = (edge >> 1u) & 1u;\n\
+    var offset = vec3u(a, b, 0u);\n\
+    if (axis == 0u) {\n\
+        offset = vec3u(0u, a, b);\n\
+    } else if (axis == 1u) {\n\
+        offset = vec3u(a, 0u, b);\n\
+    }\n\
+    return cornerIndex(cell + offset) * 3u + axis;\n\
+}\n\
+\n\
+@compute @workgroup_size(1)\n\
+fn reset() {\n\
+    atomicStore(&counters.indexCount, 0u);\n\
+    counters.instanceCount = 1u;\n\
+    counters.firstIndex = 0u;\n\
+    counters.baseVertex = 0;\n\
+    counters.firstInstance = 0u;\n\
+    atomicStore(&counters.vertexCount, 0u);\n\
+}\n\
+\n\
+@compute @workgroup_size(4, 4, 4)\n\
+fn evaluateField(@builtin(global_invocation_id) gid: vec3u) {\n\
+    if (any(gid > vec3u(params.resolution))) {\n\
+        return;\n\
+    }\n\
+    field[cornerIndex(gid)] = sdf(gridToWorld(vec3f(gid)), params.time);\n\
+}\n\
+",
+"\
+// One vertex per edge leaving each corner along +x, +y and +z that crosses\n\
+// the surface. Slots are reserved with one global atomic per workgroup.\n\
+@compute @workgroup_size(4, 4, 4)\n\
+fn emitVertices(@builtin(global_invocation_id) gid: vec3u, @builtin(local_invocation_index) lid: u32) {\n\
+    let valid = all(gid <= vec3u(params.resolution));\n\
+    var crossings = 0u;\n\
+    var f0 = 0.0;\n\
+    if (valid) {\n\
+        f0 = field[cornerIndex(gid)];\n\
+        for (var axis = 0u; axis < 3u; axis++) {\n\
+            var next = gid;\n\
+            next[axis] += 1u;\n\
+            if (next[axis] <= params.resolution && isInside(f0) != isInside(field[cornerIndex(next)])) {\n\
+                crossings |= 1u << axis;\n\
+            }\n\
+        }\n\
+    }\n\
+    let offset = atomicAdd(&localCount, countOneBits(crossings));\n\
+    workgroupBarrier();\n\
+    if (lid == 0u) {\n\
+        globalBase = atomicAdd(&counters.vertexCount, atomicLoad(&localCount));\n\
+    }\n\
+    workgroupBarrier();\n\
+    var slot = globalBase + offset;\n\
+    for (var axis = 0u; axis < 3u; axis++) {\n\
+        if ((crossings & (1u << axis)) == 0u) {\n\
+            continue;\n\
+        }\n\
+        var index = INVALID;\n\
+        if (slot < params.maxVertices) {\n\
+            var next = gid;\n\
+            next[axis] += 1u;\n\
+            let f1 = field[cornerIndex(next)];\n\
+            var c = vec3f(gid);\n\
+            c[axis] += (params.iso - f0) / (f1 - f0);\n\
+            let p = gridToWorld(c);\n\
+            let n = sdfNormal(p);\n\
+            vertices[slot * 6u + 0u] = p.x;\n\
+            vertices[slot * 6u + 1u] = p.y;\n\
+            vertices[slot * 6u + 2u] = p.z;\n\
+            vertices[slot * 6u + 3u] = n.x;\n\
+            vertices[slot * 6u + 4u] = n.y;\n\
+            vertices[slot * 6u + 5u] = n.z;\n\
+            index = slot;\n\
+        }\n\
+        edgeVertices[cornerIndex(gid) * 3u + axis] = index;\n\
+        slot++;\n\
+    }\n\
+}\n\
+\n\
+@compute @workgroup_size(4, 4, 4)\n\
+fn emitTriangles(@builtin(global_invocation_id) gid: vec3u, @builtin(local_invocation_index) lid: u32) {\n\
+    let valid = all(gid < vec3u(params.resolution));\n\
+    var cubeCase = 0u;\n\
+    var triangleCount = 0u;\n\
+    if (valid) {\n\
+        for (var i = 0u; i < 8u; i++) {\n\
+            let corner = gid + vec3u(i & 1u, (i >> 1u) & 1u, i >> 2u);\n\
+            if (isInside(field[cornerIndex(corner)])) {\n\
+                cubeCase |= 1u << i;\n\
+            }\n\
+        }\n\
+        triangleCount = triangleTable[cubeCase];\n\
+    }\n\
+    let offset = atomicAdd(&localCount, triangleCount * 3u);\n\
+    workgroupBarrier();\n\
+    if (lid == 0u) {\n\
+        globalBase = atomicAdd(&counters.indexCount, atomicLoad(&localCount));\n\
+    }\n\
+    workgroupBarrier();\n\
+    let base = globalBase + offset;\n\
+    for (var t = 0u; t < triangleCount; t++) {\n\
+        var ids: array<u32, 3>;\n\
+        var complete = true;\n\
+        for (var k = 0u; k < 3u; k++) {\n\
+            let edge = triangleTable[256u + cubeCase * 15u + t * 3u + k];\n\
+            ids[k] = edgeVertices[edgeSlot(gid, edge)];\n\
+            complete = complete && ids[k] != INVALID;\n\
+        }\n\
+        // Triangles missing a vertex become degenerate\n\
+        for (var k = 0u; k < 3u; k++) {\n\
+            let slot = base + t * 3u + k;\n\
+            if (slot < params.maxIndices) {\n\
+                indices[slot] = select(0u, ids[k], complete);\n\
+            }\n\
+        }\n\
+    }\n\
+}\n\
+\n\
+@compute @workgroup_size(1)\n\
+fn finalize() {\n\
+    let requested = atomicLoad(&counters.indexCount);\n\
+    counters.requestedIndices = requested;\n\
+    counters.requestedVertices = atomicLoad(&counters.vertexCount);\n\
+    atomicStore(&counters.indexCount, min(requested, params.maxIndices - params.maxIndices % 3u));\n\
+}\n\
+",
+};
+
+// Triangle table
+
+// Corners of each face of a cell, counter-clockwise seen from outside.
+// Corner i is at (i & 1, (i >> 1) & 1, i >> 2).
+static const uint8_t cubeFaces[6][4] = {
+	{ 0, 4, 6, 2 }, // x = 0
+	{ 1, 3, 7, 5 }, // x = 1
+	{ 0, 1, 5, 4 }, // y = 0
+	{ 2, 6, 7, 3 }, // y = 1
+	{ 0, 2, 3, 1 }, // z = 0
+	{ 4, 5, 7, 6 }, // z = 1
+};
+
+/**
+ * Number of the edge between corners a and b, as decoded by edgeSlot in
+ * the shader.
+ */
+static uint32_t cellEdge(uint32_t a, uint32_t b) {
+	uint32_t corner = a < b ? a : b;
+	uint32_t axis = (a ^ b) == 1 ? 0 : (a ^ b) == 2 ? 1 : 2;
+	uint32_t x = corner & 1, y = (corner >> 1) & 1, z = corner >> 2;
+	uint32_t others = axis == 0 ? (y | z << 1) : axis == 1 ? (x | z << 1) : (x | y << 1);
+	return axis * 4 + others;
+}
+
+static bool isInsideCorner(uint32_t cubeCase, uint32_t corner) {
+	return (cubeCase >> corner) & 1;
+}
+
+/**
+ * Build the marching cubes table instead of embedding the classic one: on
+ * each face, the surface cuts off the runs of outside corners (so that
+ * ambiguous faces, with alternating corners, are split the same way by
+ * both cells sharing them), and the segments chain into polygons around
+ * the cell that are triangulated as fans. Faces agree between neighbors,
+ * so the surface is closed.
+ */
+static void buildTriangleTable(uint32_t * table) {
+	memset(table, 0, TRIANGLE_TABLE_SIZE * sizeof(uint32_t));
+	for (uint32_t cubeCase = 0; cubeCase < 256; ++cubeCase) {
+		// next[e] is the edge following e along the boundary of its polygon
+		int next[12];
+		for (int e = 0; e < 12; ++e) next[e] = -1;
+		for (int f = 0; f < 6; ++f) {
+			for (int k = 0; k < 4; ++k) {
+				uint32_t a = cubeFaces[f][k], b = cubeFaces[f][(k + 1) % 4];
+				if (!isInsideCorner(cubeCase, a) || isInsideCorner(cubeCase, b)) continue;
+				// Walk the run of outside corners to where the face goes back inside
+				int j = k + 1;
+				while (isInsideCorner(cubeCase, cubeFaces[f][j % 4]) || !isInsideCorner(cubeCase, cubeFaces[f][(j + 1) % 4])) ++j;
+				next[cellEdge(a, b)] = (int)cellEdge(cubeFaces[f][j % 4], cubeFaces[f][(j + 1) % 4]);
+			}
+		}
+
+		uint32_t * edges = table + 256 + cubeCase * 3 * MAX_TRIANGLES_PER_CELL;
+		uint32_t triangleCount = 0;
+		bool visited[12] = { false };
+		for (int start = 0; start < 12; ++start) {
+			if (next[start] < 0 || visited[start]) continue;
+			int polygon[12];
+			int n = 0;
+			int e = start;
+			do {
+				polygon[n++] = e;
+				visited[e] = true;
+				e = next[e];
+			} while (e != start);
+			// Polygons wind clockwise seen from outside, hence the swap
+			for (int i = 1; i + 1 < n; ++i) {
+				edges[3 * triangleCount + 0] = (uint32_t)polygon[0];
+				edges[3 * triangleCount + 1] = (uint32_t)polygon[i + 1];
+				edges[3 * triangleCount + 2] = (uint32_t)polygon[i];
+				++triangleCount;
+			}
+		}
+		table[cubeCase] = triangleCount;
+	}
+}
+
+// Surface
+
+static uint32_t ceilDiv(uint32_t a, uint32_t b) {
+	return (a + b - 1) / b;
+}
+
+struct ProceduralSurface * proceduralSurfaceCreate(WGPUDevice device, struct ProceduralSurfaceDesc const * desc) {
+	WGPUSupportedLimits supportedLimits = (WGPUSupportedLimits) {};
+	supportedLimits.nextInChain = NULL;
+	wgpuDeviceGetLimits(device, &supportedLimits);
+	uint64_t maxBinding = supportedLimits.limits.maxStorageBufferBindingSize;
+
+	uint64_t r = desc->resolution;
+	uint64_t cornerCount = (r + 1) * (r + 1) * (r + 1);
+	if (r == 0 || cornerCount * 3 * sizeof(uint32_t) > maxBinding) {
+		fprintf(stderr, "A procedural surface grid of %u cells per axis does not fit in storage buffers\n", desc->resolution);
+		return NULL;
+	}
+	// About twice the area of a sphere filling the bounds, in cells
+	uint64_t maxVertices = desc->maxVertices > 0 ? desc->maxVertices : 8 * r * r;
+	uint64_t maxIndices = desc->maxIndices > 0 ? desc->maxIndices : 6 * maxVertices;
+	if (maxVertices * PROCEDURAL_VERTEX_STRIDE > maxBinding) maxVertices = maxBinding / PROCEDURAL_VERTEX_STRIDE;
+	if (maxIndices * sizeof(uint32_t) > maxBinding) maxIndices = maxBinding / sizeof(uint32_t);
+
+	struct ProceduralSurface * surface = (struct ProceduralSurface *)calloc(1, sizeof(struct ProceduralSurface));
+	surface->device = device;
+	surface->queue = wgpuDeviceGetQueue(device);
+	surface->resolution = desc->resolution;
+	surface->maxVertices = (uint32_t)maxVertices;
+	surface->maxIndices = (uint32_t)maxIndices;
+	for (int i = 0; i < 3; ++i) {
+		surface->boundsMin[i] = desc->boundsMin[i];
+		surface->cellSize[i] = (desc->boundsMax[i] - desc->boundsMin[i]) / (float)desc->resolution;
+	}
+
+	WGPUBindGroupLayoutEntry entries[7];
+	entries[0] = bufferLayoutEntry(0, WGPUShaderStage_Compute, WGPUBufferBindingType_Uniform, false);
+	entries[1] = bufferLayoutEntry(1, WGPUShaderStage_Compute, WGPUBufferBindingType_ReadOnlyStorage, false);
+	for (uint32_t i = 2; i < 7; ++i) {
+		entries[i] = bufferLayoutEntry(i, WGPUShaderStage_Compute, WGPUBufferBindingType_Storage, false);
+	}
+	WGPUBindGroupLayoutDescriptor layoutDesc = (WGPUBindGroupLayoutDescriptor) {};
+	layoutDesc.nextInChain = NULL;
+	layoutDesc.label = "Procedural surface";
+	layoutDesc.entryCount = 7;
+	layoutDesc.entries = entries;
+	surface->layout = wgpuDeviceCreateBindGroupLayout(device, &layoutDesc);
+
+	size_t chunkCount = sizeof(proceduralShaderChunks) / sizeof(proceduralShaderChunks[0]);
+	size_t sourceSize = strlen(desc->sdfSource) + 1;
+	for (size_t i = 0; i < chunkCount; ++i) sourceSize += strlen(proceduralShaderChunks[i]);
+	char * source = (char *)malloc(sourceSize);
+	strcpy(source, desc->sdfSource);
+	for (size_t i = 0; i < chunkCount; ++i) strcat(source, proceduralShaderChunks[i]);
+	WGPUShaderModule module = createWGSLShaderModule(device, source, "Procedural surface");
+	free(source);
+	WGPUPipelineLayout pipelineLayout = createSingleGroupPipelineLayout(device, surface->layout, "Procedural surface");
+	surface->resetPipeline = createComputePipeline(device, pipelineLayout, module, "reset", "Procedural reset");
+	surface->fieldPipeline = createComputePipeline(device, pipelineLayout, module, "evaluateField", "Procedural field");
+	surface->verticesPipeline = createComputePipeline(device, pipelineLayout, module, "emitVertices", "Procedural vertices");
+	surface->trianglesPipeline = createComputePipeline(device, pipelineLayout, module, "emitTriangles", "Procedural triangles");
+	surface->finalizePipeline = createComputePipeline(device, pipelineLayout, module, "finalize", "Procedural finalize");
+	wgpuPipelineLayoutRelease(pipelineLayout);
+	wgpuShaderModuleRelease(module);
+
+	WGPUBufferUsageFlags storage = WGPUBufferUsage_Storage;
+	surface->uniformBuffer = createBuffer(device, sizeof(struct ProceduralParams), WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst, "Procedural params");
+	surface->triangleTableBuffer = createBuffer(device, TRIANGLE_TABLE_SIZE * sizeof(uint32_t), storage | WGPUBufferUsage_CopyDst, "Marching cubes table");
+	surface->fieldBuffer = createBuffer(device, cornerCount * sizeof(float), storage, "Procedural field");
+	surface->edgeVertexBuffer = createBuffer(device, cornerCount * 3 * sizeof(uint32_t), storage, "Procedural edge vertices");
+	surface->vertexBuffer = createBuffer(device, maxVertices * PROCEDURAL_VERTEX_STRIDE, storage | WGPUBufferUsage_Vertex, "Procedural vertices");
+	surface->indexBuffer = createBuffer(device, maxIndices * sizeof(uint32_t), storage | WGPUBufferUsage_Index, "Procedural indices");
+	surface->countersBuffer = createBuffer(device, COUNTERS_SIZE, storage | WGPUBufferUsage_Indirect | WGPUBufferUsage_CopySrc, "Procedural counters");
+	surface->readbackBuffer = createBuffer(device, COUNTERS_SIZE, WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst, "Procedural counters readback");
+
+	uint32_t * table = (uint32_t *)malloc(TRIANGLE_TABLE_SIZE * sizeof(uint32_t));
+	buildTriangleTable(table);
+	wgpuQueueWriteBuffer(surface->queue, surface->triangleTableBuffer, 0, table, TRIANGLE_TABLE_SIZE * sizeof(uint32_t));
+	free(table);
+
+	WGPUBindGroupEntry bindings[7];
+	bindings[0] = bufferBindGroupEntry(0, surface->uniformBuffer, 0, sizeof(struct ProceduralParams));
+	bindings[1] = bufferBindGroupEntry(1, surface->triangleTableBuffer, 0, TRIANGLE_TABLE_SIZE * sizeof(uint32_t));
+	bindings[2] = bufferBindGroupEntry(2, surface->fieldBuffer, 0, cornerCount * sizeof(float));
+	bindings[3] = bufferBindGroupEntry(3, surface->edgeVertexBuffer, 0, cornerCount * 3 * sizeof(uint32_t));
+	bindings[4] = bufferBindGroupEntry(4, surface->vertexBuffer, 0, maxVertices * PROCEDURAL_VERTEX_STRIDE);
+	bindings[5] = bufferBindGroupEntry(5, surface->indexBuffer, 0, maxIndices * sizeof(uint32_t));
+	bindings[6] = bufferBindGroupEntry(6, surface->countersBuffer, 0, COUNTERS_SIZE);
+	WGPUBindGroupDescriptor bindGroupDesc = (WGPUBindGroupDescriptor) {};
+	bindGroupDesc.nextInChain = NULL;
+	bindGroupDesc.layout = surface->layout;
+	bindGroupDesc.entryCount = 7;
+	bindGroupDesc.entries = bindings;
+	surface->bindGroup = wgpuDeviceCreateBindGroup(device, &bindGroupDesc);
+	return surface;
+}
+
+void proceduralSurfaceEncode(struct ProceduralSurface * surface, WGPUCommandEncoder encoder, float time, float iso) {
+	struct ProceduralParams params;
+	memset(&params, 0, sizeof(params));
+	memcpy(params.boundsMin, surface->boundsMin, sizeof(params.boundsMin));
+	memcpy(params.cellSize, surface->cellSize, sizeof(params.cellSize));
+	params.iso = iso;
+	params.time = time;
+	params.resolution = surface->resolution;
+	params.maxVertices = surface->maxVertices;
+	params.maxIndices = surface->maxIndices;
+	wgpuQueueWriteBuffer(surface->queue, surface->uniformBuffer, 0, &params, sizeof(params));
+
+	WGPUComputePassDescriptor passDesc = (WGPUComputePassDescriptor) {};
+	passDesc.nextInChain = NULL;
+	passDesc.label = "Procedural surface";
+	passDesc.timestampWriteCount = 0;
+	passDesc.timestampWrites = NULL;
+	WGPUComputePassEncoder pass = wgpuCommandEncoderBeginComputePass(encoder, &passDesc);
+	wgpuComputePassEncoderSetBindGroup(pass, 0, surface->bindGroup, 0, NULL);
+
+	uint32_t cornerGroups = ceilDiv(surface->resolution + 1, WORKGROUP_EDGE);
+	uint32_t cellGroups = ceilDiv(surface->resolution, WORKGROUP_EDGE);
+	wgpuComputePassEncoderSetPipeline(pass, surface->resetPipeline);
+	wgpuComputePassEncoderDispatchWorkgroups(pass, 1, 1, 1);
+	wgpuComputePassEncoderSetPipeline(pass, surface->fieldPipeline);
+	wgpuComputePassEncoderDispatchWorkgroups(pass, cornerGroups, cornerGroups, cornerGroups);
+	wgpuComputePassEncoderSetPipeline(pass, surface->verticesPipeline);
+	wgpuComputePassEncoderDispatchWorkgroups(pass, cornerGroups, cornerGroups, cornerGroups);
+	wgpuComputePassEncoderSetPipeline(pass, surface->trianglesPipeline);
+	wgpuComputePassEncoderDispatchWorkgroups(pass, cellGroups, cellGroups, cellGroups);
+	wgpuComputePassEncoderSetPipeline(pass, surface->finalizePipeline);
+	wgpuComputePassEncoderDispatchWorkgroups(pass, 1, 1, 1);
+
+	wgpuComputePassEncoderEnd(pass);
+	wgpuComputePassEncoderRelease(pass);
+}
+
+WGPUVertexBufferLayout proceduralSurfaceVertexLayout(WGPUVertexAttribute attributes[2]) {
+	attributes[0] = (WGPUVertexAttribute) {};
+	attributes[0].format = WGPUVertexFormat_Float32x3;
+	attributes[0].offset = 0;
+	attributes[0].shaderLocation = 0;
+	attributes[1] = (WGPUVertexAttribute) {};
+	attributes[1].format = WGPUVertexFormat_Float32x3;
+	attributes[1].offset = 3 * sizeof(float);
+	attributes[1].shaderLocation = 1;
+
+	WGPUVertexBufferLayout layout = (WGPUVertexBufferLayout) {};
+	layout.arrayStride = PROCEDURAL_VERTEX_STRIDE;
+	layout.stepMode = WGPUVertexStepMode_Vertex;
+	layout.attributeCount = 2;
+	layout.attributes = attributes;
+	return layout;
+}
+
+void proceduralSurfaceDraw(struct ProceduralSurface * surface, WGPURenderPassEncoder renderPass) {
+	wgpuRenderPassEncoderSetVertexBuffer(renderPass, 0, surface->vertexBuffer, 0, (uint64_t)surface->maxVertices * PROCEDURAL_VERTEX_STRIDE);
+	wgpuRenderPassEncoderSetIndexBuffer(renderPass, surface->indexBuffer, WGPUIndexFormat_Uint32, 0, (uint64_t)surface->maxIndices * sizeof(uint32_t));
+	wgpuRenderPassEncoderDrawIndexedIndirect(renderPass, surface->countersBuffer, 0);
+}
+
+static void onCountersMapped(WGPUBufferMapAsyncStatus status, void * pUserData) {
+	*(int *)pUserData = status == WGPUBufferMapAsyncStatus_Success ? 1 : -1;
+}
+
+bool proceduralSurfaceReadCounts(struct ProceduralSurface * surface, uint32_t * vertexCount, uint32_t * indexCount) {
+	WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(surface->device, NULL);
+	wgpuCommandEncoderCopyBufferToBuffer(encoder, surface->countersBuffer, 0, surface->readbackBuffer, 0, COUNTERS_SIZE);
+	WGPUCommandBuffer command = wgpuCommandEncoderFinish(encoder, NULL);
+	wgpuQueueSubmit(surface->queue, 1, &command);
+	wgpuCommandBufferRelease(command);
+	wgpuCommandEncoderRelease(encoder);
+
+	int mapped = 0;
+	wgpuBufferMapAsync(surface->readbackBuffer, WGPUMapMode_Read, 0, COUNTERS_SIZE, onCountersMapped, &mapped);
+	while (mapped == 0) {
+#ifdef WEBGPU_BACKEND_DAWN
+		wgpuDeviceTick(surface->device);
+#endif
+	}
+	if (mapped < 0) return false;
+	uint32_t const * counters = (uint32_t const *)wgpuBufferGetConstMappedRange(surface->readbackBuffer, 0, COUNTERS_SIZE);
+	*indexCount = counters[6];
+	*vertexCount = counters[7];
+	wgpuBufferUnmap(surface->readbackBuffer);
+	return true;
+}
+
+void proceduralSurfaceRelease(struct ProceduralSurface * surface) {
+	if (!surface) return;
+	wgpuBindGroupRelease(surface->bindGroup);
+	WGPUBuffer buffers[] = {
+		surface->uniformBuffer, surface->triangleTableBuffer, surface->fieldBuffer, surface->edgeVertexBuffer,
+		surface->vertexBuffer, surface->indexBuffer, surface->countersBuffer, surface->readbackBuffer,
+	};
+	for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); ++i) {
+		wgpuBufferRelease(buffers[i]);
+	}
+	wgpuComputePipelineRelease(surface->finalizePipeline);
+	wgpuComputePipelineRelease(surface->trianglesPipeline);
+	wgpuComputePipelineRelease(surface->verticesPipeline);
+	wgpuComputePipelineRelease(surface->fieldPipeline);
+	wgpuComputePipelineRelease(surface->resetPipeline);
+	wgpuBindGroupLayoutRelease(surface->layout);
+	wgpuQueueRelease(surface->queue);
+	free(surface);
+}
@@ -0,0 +1,124 @@
+/**
+ * Compute-generated procedural surfaces.
+ *
+ * Marching cubes over a signed distance field, entirely on the GPU: a
+ * compute pass evaluates the field at the corners of a grid, creates one
+ * vertex per grid edge crossing the surface and emits the triangles of
+ * each cell as indices into those shared vertices. Vertices and indices
+ * are appended to storage buffers through atomic counters, aggregated per
+ * workgroup, and the index counter is the first field of the
+ * DrawIndexedIndirect arguments of the surface, so drawing it never needs
+ * the CPU to know how many triangles were generated.
+ *
+ * The field is WGSL provided by the caller, defining
+ *     fn sdf(p: vec3f, time: f32) -> f32
+ * negative inside the surface. Triangles are counter-clockwise seen from
+ * outside, and normals are the normalized gradient of the field.
+ *
+ * Typical frame:
+ *     proceduralSurfaceEncode(surface, encoder, time, 0.0f);  // before the render pass
+ *     proceduralSurfaceDraw(surface, renderPass);             // inside the render pass
+ *
+ * Surfaces with more vertices or indices than the buffers hold lose the
+ * triangles that do not fit (they become degenerate).
+ */
+
+#ifndef _procedural_geometry_h_
+#define _procedural_geometry_h_
+
+#include <webgpu/webgpu.h>
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Position and normal, 3 floats each
+#define PROCEDURAL_VERTEX_STRIDE (6 * sizeof(float))
+
+/**
+ * Example fields: a sphere of radius 1, and a gyroid clipped by a sphere
+ * of radius 1 that slowly scrolls with time.
+ */
+extern char const * const proceduralSdfSphere;
+extern char const * const proceduralSdfGyroid;
+
+struct ProceduralSurfaceDesc {
+	char const * sdfSource;
+	// Number of cells along each axis of the grid
+	uint32_t resolution;
+	float boundsMin[3];
+	float boundsMax[3];
+	// 0 picks a default suited to a closed surface of the size of the bounds
+	uint32_t maxVertices;
+	uint32_t maxIndices;
+};
+
+struct ProceduralSurface {
+	WGPUDevice device;
+	WGPUQueue queue;
+	uint32_t resolution;
+	uint32_t maxVertices;
+	uint32_t maxIndices;
+	float boundsMin[3];
+	float cellSize[3];
+
+	WGPUBindGroupLayout layout;
+	WGPUBindGroup bindGroup;
+	WGPUComputePipeline resetPipeline;
+	WGPUComputePipeline fieldPipeline;
+	WGPUComputePipeline verticesPipeline;
+	WGPUComputePipeline trianglesPipeline;
+	WGPUComputePipeline finalizePipeline;
+
+	WGPUBuffer uniformBuffer;
+	WGPUBuffer triangleTableBuffer;
+	WGPUBuffer fieldBuffer;
+	WGPUBuffer edgeVertexBuffer;
+	WGPUBuffer vertexBuffer; // Vertex | Storage
+	WGPUBuffer indexBuffer; // Index | Storage, Uint32
+	WGPUBuffer countersBuffer; // DrawIndexedIndirect arguments, then counts
+	WGPUBuffer readbackBuffer;
+};
+
+/**
+ * Create the buffers and pipelines of a surface. Returns NULL if the grid
+ * does not fit in the device's storage buffer binding size.
+ */
+struct ProceduralSurface * proceduralSurfaceCreate(WGPUDevice device, struct ProceduralSurfaceDesc const * desc);
+
+/**
+ * Record the compute pass regenerating the surface `sdf(p, time) = iso`.
+ * Parameters are written with a queue write: encode at most once per
+ * submit.
+ */
+void proceduralSurfaceEncode(struct ProceduralSurface * surface, WGPUCommandEncoder encoder, float time, float iso);
+
+/**
+ * Layout of the vertex buffer, at shader locations 0 (position) and 1
+ * (normal). `attributes` is storage for 2 attributes that must outlive the
+ * pipeline creation.
+ */
+WGPUVertexBufferLayout proceduralSurfaceVertexLayout(WGPUVertexAttribute attributes[2]);
+
+/**
+ * Bind the vertex and index buffers and draw the surface indirectly. The
+ * caller sets the pipeline beforehand.
+ */
+void proceduralSurfaceDraw(struct ProceduralSurface * surface, WGPURenderPassEncoder renderPass);
+
+/**
+ * Wait for the GPU and read back the number of vertices and indices the
+ * last generation asked for, which may exceed the capacity of the
+ * buffers. Stalls: meant for tools and benchmarks.
+ */
+bool proceduralSurfaceReadCounts(struct ProceduralSurface * surface, uint32_t * vertexCount, uint32_t * indexCount);
+
+void proceduralSurfaceRelease(struct ProceduralSurface * surface);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _procedural_geometry_h_
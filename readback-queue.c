@@ -0,0 +1,274 @@
+#include "readback-queue.h"
+#include "webgpu-utils.h"
+
+#include <tinycthread.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+struct ReadbackWorker {
+	thrd_t thread;
+	// Guards the state of the slots, which the worker waits on
+	mtx_t mutex;
+	cnd_t slotMapped;
+	bool stopping;
+};
+
+static enum ReadbackSlotState getSlotState(struct ReadbackQueue * readback, struct ReadbackSlot * slot) {
+	mtx_lock(&readback->worker->mutex);
+	enum ReadbackSlotState state = slot->state;
+	mtx_unlock(&readback->worker->mutex);
+	return state;
+}
+
+static void setSlotState(struct ReadbackQueue * readback, struct ReadbackSlot * slot, enum ReadbackSlotState state) {
+	mtx_lock(&readback->worker->mutex);
+	slot->state = state;
+	mtx_unlock(&readback->worker->mutex);
+}
+
+/**
+ * Hand mapped slots to their callback, strictly in ring order so that
+ * results come out in the order they were requested.
+ */
+static int workerThread(void * arg) {
+	struct ReadbackQueue * readback = (struct ReadbackQueue *)arg;
+	struct ReadbackWorker * worker = readback->worker;
+	uint32_t next = 0;
+	mtx_lock(&worker->mutex);
+	for (;;) {
+		struct ReadbackSlot * slot = &readback->slots[next];
+		while (slot->state != ReadbackSlot_Mapped && !worker->stopping) {
+			cnd_wait(&worker->slotMapped, &worker->mutex);
+		}
+		if (slot->state != ReadbackSlot_Mapped) break;
+		mtx_unlock(&worker->mutex);
+
+		slot->callback(&slot->result, slot->userData);
+
+		mtx_lock(&worker->mutex);
+		slot->state = ReadbackSlot_Consumed;
+		next = (next + 1) % readback->slotCount;
+	}
+	mtx_unlock(&worker->mutex);
+	return 0;
+}
+
+struct ReadbackQueue * readbackQueueCreate(WGPUDevice device, struct SubmitScheduler * scheduler, uint32_t slotCount) {
+	struct ReadbackQueue * readback = (struct ReadbackQueue *)calloc(1, sizeof(struct ReadbackQueue));
+	readback->device = device;
+	readback->scheduler = scheduler;
+	readback->slotCount = slotCount > 0 ? slotCount : READBACK_QUEUE_DEFAULT_SLOT_COUNT;
+	readback->slots = (struct ReadbackSlot *)calloc(readback->slotCount, sizeof(struct ReadbackSlot));
+	for (uint32_t i = 0; i < readback->slotCount; ++i) {
+		readback->slots[i].readback = readback;
+	}
+
+	struct ReadbackWorker * worker = (struct ReadbackWorker *)calloc(1, sizeof(struct ReadbackWorker));
+	mtx_init(&worker->mutex, mtx_plain);
+	cnd_init(&worker->slotMapped);
+	readback->worker = worker;
+	if (thrd_create(&worker->thread, workerThread, (void *)readback) != thrd_success) {
+		fprintf(stderr, "Could not start the readback worker thread\n");
+		cnd_destroy(&worker->slotMapped);
+		mtx_destroy(&worker->mutex);
+		free(worker);
+		free(readback->slots);
+		free(readback);
+		return NULL;
+	}
+	return readback;
+}
+
+static void recycleConsumedSlots(struct ReadbackQueue * readback) {
+	for (uint32_t i = 0; i < readback->slotCount; ++i) {
+		struct ReadbackSlot * slot = &readback->slots[i];
+		if (getSlotState(readback, slot) != ReadbackSlot_Consumed) continue;
+		if (slot->result.data) {
+			wgpuBufferUnmap(slot->buffer);
+		}
+		setSlotState(readback, slot, ReadbackSlot_Free);
+	}
+}
+
+static void mapRecordedSlots(void * userData) {
+	readbackQueueAfterSubmit((struct ReadbackQueue *)userData);
+}
+
+/**
+ * Take the next slot of the ring and make sure its buffer holds `size`
+ * bytes, or return NULL if it is still in flight.
+ */
+static struct ReadbackSlot * acquireSlot(struct ReadbackQueue * readback, uint64_t size, ReadbackCallback callback, void * userData) {
+	readback->requestCount++;
+	recycleConsumedSlots(readback);
+	struct ReadbackSlot * slot = &readback->slots[readback->nextSlot];
+	if (getSlotState(readback, slot) != ReadbackSlot_Free) {
+		readback->droppedCount++;
+		return NULL;
+	}
+	if (slot->capacity < size) {
+		if (slot->buffer) {
+			wgpuBufferDestroy(slot->buffer);
+			wgpuBufferRelease(slot->buffer);
+		}
+		slot->capacity = alignUp(size, 256);
+		slot->buffer = createBuffer(readback->device, slot->capacity, WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst, "Readback ring");
+	}
+	readback->nextSlot = (readback->nextSlot + 1) % readback->slotCount;
+
+	slot->result = (struct ReadbackResult) {};
+	slot->result.size = size;
+	slot->result.frame = readback->frame;
+	slot->callback = callback;
+	slot->userData = userData;
+	setSlotState(readback, slot, ReadbackSlot_Recorded);
+
+	if (readback->scheduler && !readback->afterSubmitPending) {
+		readback->afterSubmitPending = true;
+		submitSchedulerAfterSubmit(readback->scheduler, mapRecordedSlots, (void *)readback);
+	}
+	return slot;
+}
+
+bool readbackQueueCopyTexture(struct ReadbackQueue * readback, WGPUCommandEncoder encoder, WGPUImageCopyTexture const * source, WGPUExtent3D size, ReadbackCallback callback, void * userData) {
+	WGPUTextureFormat format = wgpuTextureGetFormat(source->texture);
+	uint32_t bytesPerTexel = textureFormatBytesPerTexel(format);
+	if (bytesPerTexel == 0) {
+		fprintf(stderr, "Readback of texture format %d is not supported\n", format);
+		return false;
+	}
+	uint32_t bytesPerRow = (uint32_t)alignUp((uint64_t)size.width * bytesPerTexel, 256);
+	uint64_t bufferSize = (uint64_t)bytesPerRow * size.height * size.depthOrArrayLayers;
+	struct ReadbackSlot * slot = acquireSlot(readback, bufferSize, callback, userData);
+	if (!slot) return false;
+	slot->result.width = size.width;
+	slot->result.height = size.height;
+	slot->result.depthOrArrayLayers = size.depthOrArrayLayers;
+	slot->result.bytesPerRow = bytesPerRow;
+	slot->result.format = format;
+
+	WGPUImageCopyBuffer destination = (WGPUImageCopyBuffer) {};
+	destination.nextInChain = NULL;
+	destination.buffer = slot->buffer;
+	destination.layout.nextInChain = NULL;
+	destination.layout.offset = 0;
+	destination.layout.bytesPerRow = bytesPerRow;
+	destination.layout.rowsPerImage = size.height;
+	wgpuCommandEncoderCopyTextureToBuffer(encoder, source, &destination, &size);
+	return true;
+}
+
+bool readbackQueueCopyBuffer(struct ReadbackQueue * readback, WGPUCommandEncoder encoder, WGPUBuffer source, uint64_t offset, uint64_t size, ReadbackCallback callback, void * userData) {
+	struct ReadbackSlot * slot = acquireSlot(readback, size, callback, userData);
+	if (!slot) return false;
+	wgpuCommandEncoderCopyBufferToBuffer(encoder, source, offset, slot->buffer, 0, size);
+	return true;
+}
+
+bool readbackQueueIsFull(struct ReadbackQueue * readback) {
+	recycleConsumedSlots(readback);
+	return getSlotState(readback, &readback->slots[readback->nextSlot]) != ReadbackSlot_Free;
+}
+
+static void onSlotMapped(WGPUBufferMapAsyncStatus status, void * pUserData) {
+	struct ReadbackSlot * slot = (struct ReadbackSlot *)pUserData;
+	struct ReadbackWorker * worker = slot->readback->worker;
+	void const * data = NULL;
+	if (status == WGPUBufferMapAsyncStatus_Success) {
+		// Dawn objects are only used from this thread: the worker only gets
+		// the pointer
+		data = wgpuBufferGetConstMappedRange(slot->buffer, 0, (size_t)slot->result.size);
+	} else {
+		fprintf(stderr, "Could not map readback buffer (status %d)\n", status);
+	}
+	mtx_lock(&worker->mutex);
+	slot->result.data = data;
+	slot->state = ReadbackSlot_Mapped;
+	cnd_signal(&worker->slotMapped);
+	mtx_unlock(&worker->mutex);
+}
+
+void readbackQueueAfterSubmit(struct ReadbackQueue * readback) {
+	readback->afterSubmitPending = false;
+	// Slots are recorded in ring order, so map them in that order too
+	for (uint32_t i = 0; i < readback->slotCount; ++i) {
+		struct ReadbackSlot * slot = &readback->slots[(readback->nextSlot + i) % readback->slotCount];
+		if (getSlotState(readback, slot) != ReadbackSlot_Recorded) continue;
+		setSlotState(readback, slot, ReadbackSlot_Mapping);
+		wgpuBufferMapAsync(slot->buffer, WGPUMapMode_Read, 0, (size_t)slot->result.size, onSlotMapped, (void *)slot);
+	}
+}
+
+/**
+ * Hand copies recorded before this frame and still not submitted (their
+ * command buffer was dropped, or readbackQueueAfterSubmit never came) to
+ * the worker as failed, so that it does not wait on them forever and
+ * their slot gets recycled.
+ */
+static void abandonUnsubmittedSlots(struct ReadbackQueue * readback) {
+	struct ReadbackWorker * worker = readback->worker;
+	mtx_lock(&worker->mutex);
+	for (uint32_t i = 0; i < readback->slotCount; ++i) {
+		struct ReadbackSlot * slot = &readback->slots[i];
+		if (slot->state != ReadbackSlot_Recorded || slot->result.frame == readback->frame) continue;
+		slot->result.data = NULL;
+		slot->state = ReadbackSlot_Mapped;
+		readback->droppedCount++;
+		cnd_signal(&worker->slotMapped);
+	}
+	mtx_unlock(&worker->mutex);
+}
+
+void readbackQueuePoll(struct ReadbackQueue * readback) {
+	recycleConsumedSlots(readback);
+	abandonUnsubmittedSlots(readback);
+	readback->frame++;
+}
+
+void readbackQueueWait(struct ReadbackQueue * readback) {
+	if (readback->scheduler && readback->afterSubmitPending) {
+		submitSchedulerFlush(readback->scheduler);
+	}
+	for (;;) {
+		bool inFlight = false;
+		mtx_lock(&readback->worker->mutex);
+		for (uint32_t i = 0; i < readback->slotCount; ++i) {
+			enum ReadbackSlotState state = readback->slots[i].state;
+			// Copies that were never submitted cannot complete
+			if (state != ReadbackSlot_Free && state != ReadbackSlot_Recorded) inFlight = true;
+		}
+		mtx_unlock(&readback->worker->mutex);
+		if (!inFlight) break;
+
+#ifdef WEBGPU_BACKEND_DAWN
+		wgpuDeviceTick(readback->device);
+#endif
+		thrd_yield();
+		recycleConsumedSlots(readback);
+	}
+}
+
+void readbackQueueRelease(struct ReadbackQueue * readback) {
+	if (!readback) return;
+	readbackQueueWait(readback);
+
+	struct ReadbackWorker * worker = readback->worker;
+	mtx_lock(&worker->mutex);
+	worker->stopping = true;
+	cnd_signal(&worker->slotMapped);
+	mtx_unlock(&worker->mutex);
+	thrd_join(worker->thread, NULL);
+	cnd_destroy(&worker->slotMapped);
+	mtx_destroy(&worker->mutex);
+	free(worker);
+
+	for (uint32_t i = 0; i < readback->slotCount; ++i) {
+		if (readback->slots[i].buffer) {
+			wgpuBufferDestroy(readback->slots[i].buffer);
+			wgpuBufferRelease(readback->slots[i].buffer);
+		}
+	}
+	free(readback->slots);
+	free(readback);
+}
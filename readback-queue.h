@@ -0,0 +1,149 @@
+/**
+ * Non-blocking GPU readback.
+ *
+ * Copies of textures or buffers are recorded into a ring of MapRead
+ * buffers. Each buffer is mapped once the submit that fills it retires,
+ * and its content is handed to a callback on a worker thread, so neither
+ * the frame requesting the copy nor the one receiving it waits on the GPU
+ * or on the consumer (compressing a screenshot, writing telemetry...).
+ * When every buffer of the ring is still in flight, new requests are
+ * dropped and counted rather than stalling the frame.
+ *
+ * Typical frame:
+ *     readbackQueueCopyTexture(readback, encoder, &source, extent, onCapture, userData);
+ *     submitSchedulerEnqueue(scheduler, SubmitStage_Render, commands);
+ *     submitSchedulerEndFrame(scheduler);  // maps the buffers copied to this frame
+ *     wgpuDeviceTick(device);              // fires map callbacks
+ *     readbackQueuePoll(readback);         // recycles buffers the worker is done with
+ *
+ * Callbacks are called one at a time, in the order the copies were
+ * recorded. The data they receive is only valid during the call.
+ */
+
+#ifndef _readback_queue_h_
+#define _readback_queue_h_
+
+#include <webgpu/webgpu.h>
+#include "submit-scheduler.h"
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Enough for the frames the swap chain keeps in flight plus one being
+// consumed by the worker
+#define READBACK_QUEUE_DEFAULT_SLOT_COUNT 4
+
+struct ReadbackResult {
+	// NULL if mapping failed, e.g. the device was lost, or if the copy was
+	// not submitted by the frame after it was recorded
+	void const * data;
+	uint64_t size;
+	// Layout of texture copies, rows padded to 256 bytes; 0 for buffers
+	uint32_t width;
+	uint32_t height;
+	uint32_t depthOrArrayLayers;
+	uint32_t bytesPerRow;
+	WGPUTextureFormat format;
+	// Value of `frame` when the copy was recorded
+	uint64_t frame;
+};
+
+typedef void (*ReadbackCallback)(struct ReadbackResult const * result, void * userData);
+
+enum ReadbackSlotState {
+	ReadbackSlot_Free,
+	ReadbackSlot_Recorded, // copy recorded, not submitted yet
+	ReadbackSlot_Mapping,  // submitted, waiting for the GPU
+	ReadbackSlot_Mapped,   // waiting for, or in, the callback
+	ReadbackSlot_Consumed, // callback returned, to be unmapped
+};
+
+struct ReadbackSlot {
+	WGPUBuffer buffer;
+	uint64_t capacity;
+	enum ReadbackSlotState state;
+	struct ReadbackResult result;
+	ReadbackCallback callback;
+	void * userData;
+	struct ReadbackQueue * readback;
+};
+
+// Thread, mutex and condition variable, private to readback-queue.c
+struct ReadbackWorker;
+
+struct ReadbackQueue {
+	WGPUDevice device;
+	struct SubmitScheduler * scheduler; // may be NULL
+	struct ReadbackSlot * slots;
+	uint32_t slotCount;
+	// Slots are used in order, which keeps callbacks in request order
+	uint32_t nextSlot;
+	bool afterSubmitPending;
+	struct ReadbackWorker * worker;
+
+	// Incremented by readbackQueuePoll; copies are tagged with it
+	uint64_t frame;
+	uint64_t requestCount;
+	uint64_t droppedCount;
+};
+
+/**
+ * Create the ring and start the worker thread. Buffers are allocated on
+ * first use and grown as needed. If `scheduler` is not NULL, buffers are
+ * mapped after its next submit; otherwise call readbackQueueAfterSubmit
+ * after submitting the copies. `slotCount` 0 picks the default.
+ */
+struct ReadbackQueue * readbackQueueCreate(WGPUDevice device, struct SubmitScheduler * scheduler, uint32_t slotCount);
+
+/**
+ * Record a copy of `size` texels of `source` (an uncompressed color
+ * texture with CopySrc usage) into the next buffer of the ring. Returns
+ * false, without recording anything, if that buffer is still in flight.
+ */
+bool readbackQueueCopyTexture(struct ReadbackQueue * readback, WGPUCommandEncoder encoder, WGPUImageCopyTexture const * source, WGPUExtent3D size, ReadbackCallback callback, void * userData);
+
+/**
+ * Record a copy of `size` bytes of `source` (with CopySrc usage) from
+ * `offset`, both multiples of 4. Returns false if the ring is full.
+ */
+bool readbackQueueCopyBuffer(struct ReadbackQueue * readback, WGPUCommandEncoder encoder, WGPUBuffer source, uint64_t offset, uint64_t size, ReadbackCallback callback, void * userData);
+
+/**
+ * Whether the next copy would be dropped because its buffer is still in
+ * flight, for callers that would waste GPU work producing its source.
+ */
+bool readbackQueueIsFull(struct ReadbackQueue * readback);
+
+/**
+ * Start mapping the buffers of the copies recorded so far. The command
+ * buffers holding them must have been submitted. Only needed when the
+ * queue was created without a scheduler.
+ */
+void readbackQueueAfterSubmit(struct ReadbackQueue * readback);
+
+/**
+ * Unmap and recycle the buffers whose callback has returned, and give up
+ * on copies recorded in an earlier frame but never submitted. Call once
+ * per frame, after ticking the device.
+ */
+void readbackQueuePoll(struct ReadbackQueue * readback);
+
+/**
+ * Wait until every submitted copy went through its callback. Stalls:
+ * meant for shutdown or before changing device.
+ */
+void readbackQueueWait(struct ReadbackQueue * readback);
+
+/**
+ * Wait for submitted copies, stop the worker and release the buffers.
+ */
+void readbackQueueRelease(struct ReadbackQueue * readback);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _readback_queue_h_
@@ -0,0 +1,117 @@
+#include "submit-scheduler.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+struct SubmitScheduler * submitSchedulerCreate(WGPUDevice device) {
+	struct SubmitScheduler * scheduler = (struct SubmitScheduler *)calloc(1, sizeof(struct SubmitScheduler));
+	scheduler->queue = wgpuDeviceGetQueue(device);
+	return scheduler;
+}
+
+void submitSchedulerEnqueue(struct SubmitScheduler * scheduler, enum SubmitStage stage, WGPUCommandBuffer commands) {
+	assert(stage < SubmitStage_Count);
+	struct SubmitSchedulerStage * s = &scheduler->stages[stage];
+	if (s->commandCount == s->capacity) {
+		s->capacity = s->capacity ? 2 * s->capacity : 4;
+		s->commands = (WGPUCommandBuffer *)realloc(s->commands, s->capacity * sizeof(WGPUCommandBuffer));
+	}
+	s->commands[s->commandCount++] = commands;
+}
+
+void submitSchedulerAfterSubmit(struct SubmitScheduler * scheduler, SubmitCallback callback, void * userData) {
+	if (scheduler->afterSubmitCount == scheduler->afterSubmitCapacity) {
+		scheduler->afterSubmitCapacity = scheduler->afterSubmitCapacity ? 2 * scheduler->afterSubmitCapacity : 4;
+		scheduler->afterSubmit = (struct SubmitSchedulerCallback *)realloc(scheduler->afterSubmit, scheduler->afterSubmitCapacity * sizeof(struct SubmitSchedulerCallback));
+	}
+	scheduler->afterSubmit[scheduler->afterSubmitCount].callback = callback;
+	scheduler->afterSubmit[scheduler->afterSubmitCount].userData = userData;
+	scheduler->afterSubmitCount++;
+}
+
+static void runAfterSubmitCallbacks(struct SubmitScheduler * scheduler) {
+	// Callbacks may register new callbacks, which wait for the next submit
+	uint32_t count = scheduler->afterSubmitCount;
+	for (uint32_t i = 0; i < count; ++i) {
+		scheduler->afterSubmit[i].callback(scheduler->afterSubmit[i].userData);
+	}
+	for (uint32_t i = count; i < scheduler->afterSubmitCount; ++i) {
+		scheduler->afterSubmit[i - count] = scheduler->afterSubmit[i];
+	}
+	scheduler->afterSubmitCount -= count;
+}
+
+void submitSchedulerFlush(struct SubmitScheduler * scheduler) {
+	uint32_t total = 0;
+	for (int stage = 0; stage < SubmitStage_Count; ++stage) {
+		total += scheduler->stages[stage].commandCount;
+	}
+	if (total == 0) {
+		// Nothing was recorded, but maps requested after the submit can be
+		// issued right away.
+		runAfterSubmitCallbacks(scheduler);
+		return;
+	}
+
+	if (total > scheduler->batchCapacity) {
+		scheduler->batchCapacity = total;
+		scheduler->batch = (WGPUCommandBuffer *)realloc(scheduler->batch, total * sizeof(WGPUCommandBuffer));
+	}
+	uint32_t n = 0;
+	for (int stage = 0; stage < SubmitStage_Count; ++stage) {
+		struct SubmitSchedulerStage * s = &scheduler->stages[stage];
+		for (uint32_t i = 0; i < s->commandCount; ++i) {
+			scheduler->batch[n++] = s->commands[i];
+		}
+		s->commandCount = 0;
+	}
+
+	wgpuQueueSubmit(scheduler->queue, total, scheduler->batch);
+	for (uint32_t i = 0; i < total; ++i) {
+		wgpuCommandBufferRelease(scheduler->batch[i]);
+	}
+	scheduler->frameSubmitCount++;
+	scheduler->frameCommandCount += total;
+	scheduler->totalSubmitCount++;
+
+	runAfterSubmitCallbacks(scheduler);
+}
+
+uint32_t submitSchedulerEndFrame(struct SubmitScheduler * scheduler) {
+	submitSchedulerFlush(scheduler);
+	scheduler->lastFrameSubmitCount = scheduler->frameSubmitCount;
+	scheduler->lastFrameCommandCount = scheduler->frameCommandCount;
+	scheduler->frameSubmitCount = 0;
+	scheduler->frameCommandCount = 0;
+	scheduler->frameCount++;
+	return scheduler->lastFrameSubmitCount;
+}
+
+static void dropPending(struct SubmitScheduler * scheduler) {
+	for (int stage = 0; stage < SubmitStage_Count; ++stage) {
+		struct SubmitSchedulerStage * s = &scheduler->stages[stage];
+		for (uint32_t i = 0; i < s->commandCount; ++i) {
+			wgpuCommandBufferRelease(s->commands[i]);
+		}
+		s->commandCount = 0;
+	}
+}
+
+void submitSchedulerSetDevice(struct SubmitScheduler * scheduler, WGPUDevice device) {
+	dropPending(scheduler);
+	scheduler->afterSubmitCount = 0;
+	wgpuQueueRelease(scheduler->queue);
+	scheduler->queue = wgpuDeviceGetQueue(device);
+}
+
+void submitSchedulerRelease(struct SubmitScheduler * scheduler) {
+	if (!scheduler) return;
+	dropPending(scheduler);
+	for (int stage = 0; stage < SubmitStage_Count; ++stage) {
+		free(scheduler->stages[stage].commands);
+	}
+	free(scheduler->batch);
+	free(scheduler->afterSubmit);
+	wgpuQueueRelease(scheduler->queue);
+	free(scheduler);
+}
@@ -0,0 +1,119 @@
+/**
+ * Per-frame submission batching.
+ *
+ * Every call to wgpuQueueSubmit has a fixed CPU and driver cost, so rather
+ * than having each subsystem submit its own command buffers, producers hand
+ * them to the scheduler which submits everything recorded during the frame
+ * in a single call, ordered by stage (uploads, then compute, then the main
+ * render, then UI) and by enqueue order within a stage.
+ *
+ * Typical frame:
+ *     submitSchedulerEnqueue(scheduler, SubmitStage_Compute, computeCommands);
+ *     submitSchedulerEnqueue(scheduler, SubmitStage_Render, renderCommands);
+ *     submitSchedulerAfterSubmit(scheduler, startReadback, readbackState);
+ *     submitSchedulerEndFrame(scheduler);             // one wgpuQueueSubmit
+ *     wgpuSwapChainPresent(swapChain);
+ *
+ * Queue writes (wgpuQueueWriteBuffer/Texture) execute before the next
+ * submit, hence before every batched command buffer. A producer that writes
+ * a resource already used by a command buffer enqueued in the same frame
+ * must call submitSchedulerFlush first, and so must one that needs a
+ * command buffer to have been submitted before going on, for instance to
+ * call wgpuBufferMapAsync on its result.
+ */
+
+#ifndef _submit_scheduler_h_
+#define _submit_scheduler_h_
+
+#include <webgpu/webgpu.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Stages are submitted in this order, so a command buffer may depend on
+ * anything enqueued in an earlier stage or earlier in the same stage.
+ */
+enum SubmitStage {
+	SubmitStage_Upload,
+	SubmitStage_Compute,
+	SubmitStage_Render,
+	SubmitStage_UI,
+	SubmitStage_Count,
+};
+
+typedef void (*SubmitCallback)(void * userData);
+
+struct SubmitSchedulerCallback {
+	SubmitCallback callback;
+	void * userData;
+};
+
+struct SubmitSchedulerStage {
+	WGPUCommandBuffer * commands;
+	uint32_t commandCount;
+	uint32_t capacity;
+};
+
+struct SubmitScheduler {
+	WGPUQueue queue;
+	struct SubmitSchedulerStage stages[SubmitStage_Count];
+	// Contiguous copy of all stages handed to wgpuQueueSubmit
+	WGPUCommandBuffer * batch;
+	uint32_t batchCapacity;
+
+	struct SubmitSchedulerCallback * afterSubmit;
+	uint32_t afterSubmitCount;
+	uint32_t afterSubmitCapacity;
+
+	// Statistics, updated by submitSchedulerEndFrame
+	uint32_t frameSubmitCount;
+	uint32_t frameCommandCount;
+	uint32_t lastFrameSubmitCount;
+	uint32_t lastFrameCommandCount;
+	uint64_t totalSubmitCount;
+	uint64_t frameCount;
+};
+
+struct SubmitScheduler * submitSchedulerCreate(WGPUDevice device);
+
+/**
+ * Queue `commands` for submission in `stage`. The scheduler takes ownership
+ * of the command buffer and releases it once submitted.
+ */
+void submitSchedulerEnqueue(struct SubmitScheduler * scheduler, enum SubmitStage stage, WGPUCommandBuffer commands);
+
+/**
+ * Call `callback` right after the next submit, e.g. to map a buffer the
+ * submitted commands write to. Callbacks are called once, in the order
+ * they were added.
+ */
+void submitSchedulerAfterSubmit(struct SubmitScheduler * scheduler, SubmitCallback callback, void * userData);
+
+/**
+ * Submit everything enqueued so far now. This is only needed to order
+ * work before a queue write or a map; otherwise let submitSchedulerEndFrame
+ * batch the whole frame.
+ */
+void submitSchedulerFlush(struct SubmitScheduler * scheduler);
+
+/**
+ * Flush the frame and update statistics. Returns the number of submits
+ * issued during the frame.
+ */
+uint32_t submitSchedulerEndFrame(struct SubmitScheduler * scheduler);
+
+/**
+ * Use the queue of a new device, e.g. after device-loss recovery. Pending
+ * command buffers belong to the old device and are dropped.
+ */
+void submitSchedulerSetDevice(struct SubmitScheduler * scheduler, WGPUDevice device);
+
+void submitSchedulerRelease(struct SubmitScheduler * scheduler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _submit_scheduler_h_
@@ -0,0 +1,483 @@
+#include "texture-cache.h"
+#include "block-compression.h"
+#include "jpeg-decoder.h"
+#include "mipmap-generator.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const uint8_t ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+#define KTX2_WRITER "LearnWebGPU texture-cache"
+
+// Data Format Descriptor values of the Khronos Data Format specification
+#define DFD_MODEL_RGBSDA 1
+#define DFD_MODEL_BC1A 128
+#define DFD_MODEL_BC5 132
+#define DFD_MODEL_BC7 134
+#define DFD_MODEL_ETC2 161
+#define DFD_PRIMARIES_BT709 1
+#define DFD_TRANSFER_LINEAR 1
+#define DFD_TRANSFER_SRGB 2
+#define DFD_QUALIFIER_LINEAR 0x10
+#define DFD_MAX_SAMPLES 4
+
+struct DfdSample {
+	uint32_t bitOffset;
+	uint32_t bitLength;
+	uint32_t channel;
+};
+
+// Formats
+
+enum CacheFormatId {
+	CacheFormat_RGBA8,
+	CacheFormat_RGBA8Srgb,
+	CacheFormat_BC1Srgb,
+	CacheFormat_BC5,
+	CacheFormat_BC7,
+	CacheFormat_BC7Srgb,
+	CacheFormat_ETC2,
+	CacheFormat_ETC2Srgb,
+	CacheFormat_EACRG,
+	CacheFormat_Count,
+};
+
+struct CacheFormat {
+	WGPUTextureFormat format;
+	uint32_t vkFormat;
+	enum BlockFormat blockFormat; // BlockFormat_Count for RGBA8
+	bool srgb;
+	char const * extension;
+	uint32_t model;
+	uint32_t sampleCount;
+	struct DfdSample samples[DFD_MAX_SAMPLES];
+};
+
+static const struct CacheFormat cacheFormats[CacheFormat_Count] = {
+	{ WGPUTextureFormat_RGBA8Unorm, 37, BlockFormat_Count, false, ".rgba8.ktx2", DFD_MODEL_RGBSDA, 4, { { 0, 8, 0 }, { 8, 8, 1 }, { 16, 8, 2 }, { 24, 8, 15 } } },
+	{ WGPUTextureFormat_RGBA8UnormSrgb, 43, BlockFormat_Count, true, ".rgba8-srgb.ktx2", DFD_MODEL_RGBSDA, 4, { { 0, 8, 0 }, { 8, 8, 1 }, { 16, 8, 2 }, { 24, 8, 15 | DFD_QUALIFIER_LINEAR } } },
+	{ WGPUTextureFormat_BC1RGBAUnormSrgb, 134, BlockFormat_BC1, true, ".bc1-srgb.ktx2", DFD_MODEL_BC1A, 1, { { 0, 64, 1 } } },
+	{ WGPUTextureFormat_BC5RGUnorm, 141, BlockFormat_BC5, false, ".bc5.ktx2", DFD_MODEL_BC5, 2, { { 0, 64, 0 }, { 64, 64, 1 } } },
+	{ WGPUTextureFormat_BC7RGBAUnorm, 145, BlockFormat_BC7, false, ".bc7.ktx2", DFD_MODEL_BC7, 1, { { 0, 128, 0 } } },
+	{ WGPUTextureFormat_BC7RGBAUnormSrgb, 146, BlockFormat_BC7, true, ".bc7-srgb.ktx2", DFD_MODEL_BC7, 1, { { 0, 128, 0 } } },
+	{ WGPUTextureFormat_ETC2RGB8Unorm, 147, BlockFormat_ETC2RGB8, false, ".etc2.ktx2", DFD_MODEL_ETC2, 1, { { 0, 64, 2 } } },
+	{ WGPUTextureFormat_ETC2RGB8UnormSrgb, 148, BlockFormat_ETC2RGB8, true, ".etc2-srgb.ktx2", DFD_MODEL_ETC2, 1, { { 0, 64, 2 } } },
+	{ WGPUTextureFormat_EACRG11Unorm, 155, BlockFormat_EACRG11, false, ".eac-rg.ktx2", DFD_MODEL_ETC2, 2, { { 0, 64, 0 }, { 64, 64, 1 } } },
+};
+
+static const enum CacheFormatId kindFormats[TextureCacheKind_Count][TextureCompression_Count] = {
+	// None, ETC2, BC
+	{ CacheFormat_RGBA8Srgb, CacheFormat_ETC2Srgb, CacheFormat_BC7Srgb }, // Color
+	{ CacheFormat_RGBA8Srgb, CacheFormat_ETC2Srgb, CacheFormat_BC1Srgb }, // ColorCompact
+	{ CacheFormat_RGBA8, CacheFormat_ETC2, CacheFormat_BC7 }, // Linear
+	{ CacheFormat_RGBA8, CacheFormat_EACRG, CacheFormat_BC5 }, // Normal
+};
+
+static struct CacheFormat const * findVkFormat(uint32_t vkFormat) {
+	for (uint32_t i = 0; i < CacheFormat_Count; ++i) {
+		if (cacheFormats[i].vkFormat == vkFormat) return &cacheFormats[i];
+	}
+	return NULL;
+}
+
+static struct CacheFormat const * findFormat(WGPUTextureFormat format) {
+	for (uint32_t i = 0; i < CacheFormat_Count; ++i) {
+		if (cacheFormats[i].format == format) return &cacheFormats[i];
+	}
+	return NULL;
+}
+
+/**
+ * Format textures of `format` fall back to when their size is not a
+ * multiple of the block size.
+ */
+static struct CacheFormat const * uncompressedFormat(struct CacheFormat const * format) {
+	return &cacheFormats[format->srgb ? CacheFormat_RGBA8Srgb : CacheFormat_RGBA8];
+}
+
+static uint32_t levelSize(uint32_t size, uint32_t level) {
+	size >>= level;
+	return size > 0 ? size : 1;
+}
+
+static uint64_t levelBytes(struct CacheFormat const * format, uint32_t width, uint32_t height, uint32_t level) {
+	uint32_t levelWidth = levelSize(width, level);
+	uint32_t levelHeight = levelSize(height, level);
+	if (format->blockFormat == BlockFormat_Count) return (uint64_t)levelWidth * levelHeight * 4;
+	return blockCompressedSize(format->blockFormat, levelWidth, levelHeight);
+}
+
+enum TextureCompression textureCompressionOf(WGPUDevice device) {
+	if (wgpuDeviceHasFeature(device, WGPUFeatureName_TextureCompressionBC)) return TextureCompression_BC;
+	if (wgpuDeviceHasFeature(device, WGPUFeatureName_TextureCompressionETC2)) return TextureCompression_ETC2;
+	return TextureCompression_None;
+}
+
+WGPUTextureFormat textureCacheFormat(enum TextureCacheKind kind, enum TextureCompression compression) {
+	return cacheFormats[kindFormats[kind][compression]].format;
+}
+
+char const * textureCacheExtension(enum TextureCacheKind kind, enum TextureCompression compression) {
+	return cacheFormats[kindFormats[kind][compression]].extension;
+}
+
+// Cache files
+
+struct TextureCache * textureCacheOpen(char const * path) {
+	struct MappedFile * file = mappedFileOpen(path);
+	if (!file) return NULL;
+	struct TextureCache * cache = (struct TextureCache *)calloc(1, sizeof(struct TextureCache));
+	cache->file = file;
+	struct Ktx2Header const * header = (struct Ktx2Header const *)file->data;
+	struct CacheFormat const * format = header && file->size >= sizeof(struct Ktx2Header) ? findVkFormat(header->vkFormat) : NULL;
+	bool valid = format
+		&& memcmp(header->identifier, ktx2Identifier, sizeof(ktx2Identifier)) == 0
+		&& header->pixelWidth > 0 && header->pixelHeight > 0 && header->pixelDepth == 0
+		&& header->layerCount == 0 && header->faceCount == 1
+		&& header->levelCount > 0 && header->levelCount <= mipmapLevelCount(header->pixelWidth, header->pixelHeight)
+		&& header->supercompressionScheme == 0
+		&& sizeof(struct Ktx2Header) + (uint64_t)header->levelCount * sizeof(struct Ktx2Level) <= file->size
+		&& (uint64_t)header->kvdByteOffset + header->kvdByteLength <= file->size;
+	if (!valid) {
+		fprintf(stderr, "Invalid or unsupported texture cache %s\n", path);
+		textureCacheRelease(cache);
+		return NULL;
+	}
+	cache->header = header;
+	cache->format = format->format;
+	cache->width = header->pixelWidth;
+	cache->height = header->pixelHeight;
+	cache->levelCount = header->levelCount;
+
+	uint8_t const * bytes = (uint8_t const *)file->data;
+	struct Ktx2Level const * levels = (struct Ktx2Level const *)(bytes + sizeof(struct Ktx2Header));
+	for (uint32_t level = 0; level < cache->levelCount; ++level) {
+		struct Ktx2Level const * entry = &levels[level];
+		if (entry->byteLength != levelBytes(format, cache->width, cache->height, level)
+			|| entry->uncompressedByteLength != entry->byteLength
+			|| entry->byteOffset > file->size || entry->byteLength > file->size - entry->byteOffset) {
+			fprintf(stderr, "Invalid level %u in texture cache %s\n", level, path);
+			textureCacheRelease(cache);
+			return NULL;
+		}
+		cache->levels[level] = bytes + entry->byteOffset;
+		cache->levelSizes[level] = entry->byteLength;
+	}
+
+	// Key/value pairs: length, key and value, padded to 4 bytes
+	uint64_t offset = header->kvdByteOffset;
+	uint64_t end = offset + header->kvdByteLength;
+	while (offset + 4 <= end) {
+		uint32_t length;
+		memcpy(&length, bytes + offset, sizeof(length));
+		if (length > end - offset - 4) break;
+		char const * key = (char const *)(bytes + offset + 4);
+		if (length == sizeof(TEXTURE_CACHE_SOURCE_KEY) + sizeof(struct TextureCacheSource) && memcmp(key, TEXTURE_CACHE_SOURCE_KEY, sizeof(TEXTURE_CACHE_SOURCE_KEY)) == 0) {
+			cache->hasSource = true;
+			cache->sourceOffset = offset + 4 + sizeof(TEXTURE_CACHE_SOURCE_KEY);
+			memcpy(&cache->source, bytes + cache->sourceOffset, sizeof(cache->source));
+		}
+		offset += 4 + ((length + 3) & ~(uint64_t)3);
+	}
+	return cache;
+}
+
+void textureCacheRelease(struct TextureCache * cache) {
+	if (!cache) return;
+	mappedFileClose(cache->file);
+	free(cache);
+}
+
+/**
+ * Basic Data Format Descriptor block of `format`, with its total size
+ * first, as uint32 words. Returns the number of words.
+ */
+static uint32_t buildDfd(struct CacheFormat const * format, uint32_t * words) {
+	uint32_t blockSize = format->blockFormat == BlockFormat_Count ? 4 : blockFormatSize(format->blockFormat);
+	uint32_t blockDimension = format->blockFormat == BlockFormat_Count ? 0 : BLOCK_SIZE - 1;
+	uint32_t wordCount = 7 + 4 * format->sampleCount;
+	words[0] = 4 * wordCount;
+	words[1] = 0; // Khronos vendor, basic descriptor type
+	words[2] = 2 | ((4 * (wordCount - 1)) << 16); // version 2, block size
+	words[3] = format->model | (DFD_PRIMARIES_BT709 << 8) | ((format->srgb ? DFD_TRANSFER_SRGB : DFD_TRANSFER_LINEAR) << 16);
+	words[4] = blockDimension | (blockDimension << 8);
+	words[5] = blockSize;
+	words[6] = 0;
+	for (uint32_t i = 0; i < format->sampleCount; ++i) {
+		struct DfdSample const * sample = &format->samples[i];
+		uint32_t * out = words + 7 + 4 * i;
+		out[0] = sample->bitOffset | ((sample->bitLength - 1) << 16) | (sample->channel << 24);
+		out[1] = 0; // sample position
+		out[2] = 0;
+		out[3] = format->blockFormat == BlockFormat_Count ? 255 : UINT32_MAX;
+	}
+	return wordCount;
+}
+
+static bool writePadding(FILE * file, uint64_t size) {
+	static const uint8_t zeros[16] = { 0 };
+	while (size > 0) {
+		size_t chunk = size < sizeof(zeros) ? (size_t)size : sizeof(zeros);
+		if (fwrite(zeros, 1, chunk, file) != chunk) return false;
+		size -= chunk;
+	}
+	return true;
+}
+
+static uint64_t alignUp(uint64_t offset, uint64_t alignment) {
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * Write a KTX2 file at `path`, through a temporary file so that a cache
+ * is never seen half written. Levels are stored from the smallest up, as
+ * the specification requires.
+ */
+static bool writeCache(char const * path, struct CacheFormat const * format, uint32_t width, uint32_t height, uint32_t levelCount, uint8_t * const * levels, struct TextureCacheSource const * source) {
+	uint32_t dfd[7 + 4 * DFD_MAX_SAMPLES];
+	uint32_t dfdWords = buildDfd(format, dfd);
+	// Key/value data, sorted by key
+	static const char writerKey[] = "KTXwriter";
+	static const char writerValue[] = KTX2_WRITER;
+	uint32_t writerLength = sizeof(writerKey) + sizeof(writerValue);
+	uint32_t sourceLength = sizeof(TEXTURE_CACHE_SOURCE_KEY) + sizeof(struct TextureCacheSource);
+	uint32_t kvdLength = 4 + (uint32_t)alignUp(writerLength, 4) + 4 + (uint32_t)alignUp(sourceLength, 4);
+
+	struct Ktx2Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.identifier, ktx2Identifier, sizeof(ktx2Identifier));
+	header.vkFormat = format->vkFormat;
+	header.typeSize = 1;
+	header.pixelWidth = width;
+	header.pixelHeight = height;
+	header.faceCount = 1;
+	header.levelCount = levelCount;
+	header.dfdByteOffset = (uint32_t)(sizeof(header) + levelCount * sizeof(struct Ktx2Level));
+	header.dfdByteLength = 4 * dfdWords;
+	header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+	header.kvdByteLength = kvdLength;
+
+	// Levels are aligned to both their block size and 4 bytes
+	uint64_t alignment = format->blockFormat == BlockFormat_Count ? 4 : blockFormatSize(format->blockFormat);
+	struct Ktx2Level levelIndex[TEXTURE_CACHE_MAX_LEVELS];
+	uint64_t offset = header.kvdByteOffset + header.kvdByteLength;
+	for (uint32_t level = levelCount; level-- > 0;) {
+		offset = alignUp(offset, alignment);
+		levelIndex[level].byteOffset = offset;
+		levelIndex[level].byteLength = levelBytes(format, width, height, level);
+		levelIndex[level].uncompressedByteLength = levelIndex[level].byteLength;
+		offset += levelIndex[level].byteLength;
+	}
+
+	size_t pathLength = strlen(path);
+	char * temporaryPath = (char *)malloc(pathLength + 5);
+	memcpy(temporaryPath, path, pathLength);
+	memcpy(temporaryPath + pathLength, ".tmp", 5);
+	FILE * file = fopen(temporaryPath, "wb");
+	if (!file) {
+		fprintf(stderr, "Could not open %s for writing\n", temporaryPath);
+		free(temporaryPath);
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(levelIndex, sizeof(struct Ktx2Level), levelCount, file) == levelCount
+		&& fwrite(dfd, 4, dfdWords, file) == dfdWords
+		&& fwrite(&writerLength, 4, 1, file) == 1
+		&& fwrite(writerKey, sizeof(writerKey), 1, file) == 1
+		&& fwrite(writerValue, sizeof(writerValue), 1, file) == 1
+		&& writePadding(file, alignUp(writerLength, 4) - writerLength)
+		&& fwrite(&sourceLength, 4, 1, file) == 1
+		&& fwrite(TEXTURE_CACHE_SOURCE_KEY, sizeof(TEXTURE_CACHE_SOURCE_KEY), 1, file) == 1
+		&& fwrite(source, sizeof(*source), 1, file) == 1
+		&& writePadding(file, alignUp(sourceLength, 4) - sourceLength);
+	offset = header.kvdByteOffset + header.kvdByteLength;
+	for (uint32_t level = levelCount; ok && level-- > 0;) {
+		ok = writePadding(file, levelIndex[level].byteOffset - offset)
+			&& fwrite(levels[level], 1, (size_t)levelIndex[level].byteLength, file) == levelIndex[level].byteLength;
+		offset = levelIndex[level].byteOffset + levelIndex[level].byteLength;
+	}
+	ok = fclose(file) == 0 && ok;
+	// rename does not replace existing files on Windows
+	remove(path);
+	ok = ok && rename(temporaryPath, path) == 0;
+	if (!ok) {
+		fprintf(stderr, "Could not write texture cache %s\n", path);
+		remove(temporaryPath);
+	}
+	free(temporaryPath);
+	return ok;
+}
+
+// Import
+
+/**
+ * Decode the source, build its mip chain and encode each level, then
+ * write the cache.
+ */
+static bool importTexture(char const * sourcePath, char const * cachePath, struct CacheFormat const * format, struct TextureCacheSource const * source, uint32_t threadCount) {
+	struct MappedFile * file = mappedFileOpen(sourcePath);
+	if (!file) return false;
+	uint32_t width, height;
+	uint8_t * pixels = file->data ? jpegDecode(file->data, file->size, &width, &height) : NULL;
+	mappedFileClose(file);
+	uint8_t * chain = pixels ? (uint8_t *)realloc(pixels, (size_t)mipmapChainSize(width, height)) : NULL;
+	if (!chain) {
+		fprintf(stderr, "Could not decode %s\n", sourcePath);
+		free(pixels);
+		return false;
+	}
+	if (width % BLOCK_SIZE != 0 || height % BLOCK_SIZE != 0) {
+		format = uncompressedFormat(format);
+	}
+	mipmapBuildChain(chain, width, height, format->srgb);
+
+	uint32_t levelCount = mipmapLevelCount(width, height);
+	uint8_t * levels[TEXTURE_CACHE_MAX_LEVELS];
+	bool ok = true;
+	uint64_t offset = 0;
+	for (uint32_t level = 0; level < levelCount; ++level) {
+		uint8_t * texels = chain + offset;
+		offset += (uint64_t)levelSize(width, level) * levelSize(height, level) * 4;
+		if (format->blockFormat == BlockFormat_Count) {
+			levels[level] = texels;
+			continue;
+		}
+		levels[level] = (uint8_t *)malloc((size_t)levelBytes(format, width, height, level));
+		if (!levels[level]) {
+			levelCount = level;
+			ok = false;
+			break;
+		}
+		blockCompressImage(format->blockFormat, texels, levelSize(width, level), levelSize(height, level), levels[level], threadCount);
+	}
+	if (ok) {
+		ok = writeCache(cachePath, format, width, height, levelCount, levels, source);
+	} else {
+		fprintf(stderr, "Could not allocate the levels of texture cache %s\n", cachePath);
+	}
+	if (format->blockFormat != BlockFormat_Count) {
+		for (uint32_t level = 0; level < levelCount; ++level) free(levels[level]);
+	}
+	free(chain);
+	return ok;
+}
+
+/**
+ * Whether `cache` holds `format`, or its fallback for sizes that are not
+ * a multiple of the block size.
+ */
+static bool hasFormat(struct TextureCache const * cache, struct CacheFormat const * format) {
+	if (cache->format == format->format) return true;
+	bool unaligned = cache->width % BLOCK_SIZE != 0 || cache->height % BLOCK_SIZE != 0;
+	return unaligned && cache->format == uncompressedFormat(format)->format;
+}
+
+/**
+ * Rewrite the recorded modification time of a cache whose source was
+ * touched but not changed, so that the next loads skip hashing it.
+ */
+static void updateSourceModified(char const * path, uint64_t sourceOffset, int64_t modified) {
+	FILE * file = fopen(path, "r+b");
+	if (!file) return;
+	if (fseek(file, (long)(sourceOffset + offsetof(struct TextureCacheSource, modified)), SEEK_SET) == 0) {
+		fwrite(&modified, sizeof(modified), 1, file);
+	}
+	fclose(file);
+}
+
+struct TextureCache * textureCacheLoad(char const * sourcePath, enum TextureCacheKind kind, enum TextureCompression compression, uint32_t threadCount) {
+	struct CacheFormat const * format = &cacheFormats[kindFormats[kind][compression]];
+	size_t pathLength = strlen(sourcePath);
+	size_t extensionLength = strlen(format->extension);
+	char * cachePath = (char *)malloc(pathLength + extensionLength + 1);
+	memcpy(cachePath, sourcePath, pathLength);
+	memcpy(cachePath + pathLength, format->extension, extensionLength + 1);
+
+	struct TextureCacheSource source = (struct TextureCacheSource) {};
+	bool hasSource = mappedFileStat(sourcePath, &source.size, &source.modified);
+
+	// 1. Use the cache if it matches the source
+	uint64_t cacheSize = 0;
+	int64_t cacheModified = 0;
+	struct TextureCache * cache = mappedFileStat(cachePath, &cacheSize, &cacheModified) ? textureCacheOpen(cachePath) : NULL;
+	if (cache && !hasFormat(cache, format)) {
+		textureCacheRelease(cache);
+		cache = NULL;
+	}
+	if (cache && (!hasSource || (cache->hasSource && cache->source.size == source.size && cache->source.modified == source.modified))) {
+		free(cachePath);
+		return cache;
+	}
+	if (!hasSource) {
+		fprintf(stderr, "Could not find %s nor a valid cache of it\n", sourcePath);
+		free(cachePath);
+		return NULL;
+	}
+
+	// 2. Or if the content of the source did not change
+	struct MappedFile * sourceFile = mappedFileOpen(sourcePath);
+	if (!sourceFile) {
+		textureCacheRelease(cache);
+		free(cachePath);
+		return NULL;
+	}
+	source.hash = mappedFileHash(sourceFile->data, sourceFile->size);
+	mappedFileClose(sourceFile);
+	if (cache && cache->hasSource && cache->source.size == source.size && cache->source.hash == source.hash) {
+		uint64_t sourceOffset = cache->sourceOffset;
+		textureCacheRelease(cache);
+		updateSourceModified(cachePath, sourceOffset, source.modified);
+		cache = textureCacheOpen(cachePath);
+		free(cachePath);
+		return cache;
+	}
+	textureCacheRelease(cache);
+
+	// 3. Otherwise import the source again
+	bool written = importTexture(sourcePath, cachePath, format, &source, threadCount);
+	cache = written ? textureCacheOpen(cachePath) : NULL;
+	free(cachePath);
+	return cache;
+}
+
+// GPU textures
+
+WGPUTexture textureCacheCreateTexture(WGPUDevice device, WGPUQueue queue, struct TextureCache const * cache, char const * label) {
+	struct CacheFormat const * format = findFormat(cache->format);
+	WGPUTextureDescriptor desc = (WGPUTextureDescriptor) {};
+	desc.nextInChain = NULL;
+	desc.label = label;
+	desc.usage = WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst;
+	desc.dimension = WGPUTextureDimension_2D;
+	desc.size = (WGPUExtent3D) { cache->width, cache->height, 1 };
+	desc.format = cache->format;
+	desc.mipLevelCount = cache->levelCount;
+	desc.sampleCount = 1;
+	desc.viewFormatCount = 0;
+	desc.viewFormats = NULL;
+	WGPUTexture texture = wgpuDeviceCreateTexture(device, &desc);
+
+	bool compressed = format->blockFormat != BlockFormat_Count;
+	uint32_t blockDimension = compressed ? BLOCK_SIZE : 1;
+	uint32_t blockBytes = compressed ? blockFormatSize(format->blockFormat) : 4;
+	for (uint32_t level = 0; level < cache->levelCount; ++level) {
+		// Copies cover whole blocks, past the edges of levels smaller than
+		// a block
+		uint32_t blocksWide = (levelSize(cache->width, level) + blockDimension - 1) / blockDimension;
+		uint32_t blocksHigh = (levelSize(cache->height, level) + blockDimension - 1) / blockDimension;
+		WGPUImageCopyTexture destination = (WGPUImageCopyTexture) {};
+		destination.texture = texture;
+		destination.mipLevel = level;
+		destination.origin = (WGPUOrigin3D) { 0, 0, 0 };
+		destination.aspect = WGPUTextureAspect_All;
+		WGPUTextureDataLayout layout = (WGPUTextureDataLayout) {};
+		layout.offset = 0;
+		layout.bytesPerRow = blocksWide * blockBytes;
+		layout.rowsPerImage = blocksHigh;
+		WGPUExtent3D size = (WGPUExtent3D) { blocksWide * blockDimension, blocksHigh * blockDimension, 1 };
+		wgpuQueueWriteTexture(queue, &destination, cache->levels[level], (size_t)cache->levelSizes[level], &layout, &size);
+	}
+	return texture;
+}
@@ -0,0 +1,171 @@
+/**
+ * Block-compressed texture cache, so that textures live on the GPU in
+ * formats of 4 or 8 bits per texel rather than as RGBA8, and load without
+ * decoding on the next launches.
+ *
+ * A texture is imported for one of the compression families a device
+ * supports (see textureCompressionOf): its source JPEG (see
+ * jpeg-decoder.h) is decoded, its mip chain built on the CPU (see
+ * mipmapBuildChain) and each level encoded on worker threads (see
+ * block-compression.h). The result is cached as a KTX2 file next to the
+ * source, named after the format: `rock.jpg.bc7-srgb.ktx2`, so that the
+ * caches of several families can be shipped side by side. Loading maps
+ * the file and writes each level to the texture straight from the
+ * mapping, blocks as they are stored.
+ *
+ * The format depends on the kind of texture and on the family:
+ *
+ *     kind          BC          ETC2           none
+ *     Color         BC7 sRGB    ETC2 RGB8 sRGB  RGBA8 sRGB
+ *     ColorCompact  BC1 sRGB    ETC2 RGB8 sRGB  RGBA8 sRGB
+ *     Linear        BC7         ETC2 RGB8       RGBA8
+ *     Normal        BC5         EAC RG11        RGBA8
+ *
+ * Textures whose size is not a multiple of 4 cannot be block-compressed
+ * in WebGPU and are cached as RGBA8 whatever the family. ASTC is not
+ * encoded: the mobile GPUs that support it also support ETC2.
+ *
+ * A cache is up to date when the size and modification time of its
+ * source match the ones it recorded, else when the content hash of the
+ * source does, as for mesh caches (see mesh-cache.h). They are recorded
+ * in the key/value data of the file, under TEXTURE_CACHE_SOURCE_KEY.
+ *
+ * Typical use:
+ *     enum TextureCompression compression = textureCompressionOf(device);
+ *     struct TextureCache * cache = textureCacheLoad("rock.jpg", TextureCacheKind_Color, compression, 0);
+ *     WGPUTexture texture = textureCacheCreateTexture(device, queue, cache, "Rock");
+ *     textureCacheRelease(cache);
+ */
+
+#ifndef _texture_cache_h_
+#define _texture_cache_h_
+
+#include <webgpu/webgpu.h>
+#include "mapped-file.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Levels of the largest texture the decoder accepts (32768)
+#define TEXTURE_CACHE_MAX_LEVELS 16
+#define TEXTURE_CACHE_SOURCE_KEY "textureCacheSource"
+
+enum TextureCacheKind {
+	TextureCacheKind_Color, // sRGB albedo
+	TextureCacheKind_ColorCompact, // sRGB, half the size of Color with BC
+	TextureCacheKind_Linear, // data such as roughness or masks
+	TextureCacheKind_Normal, // XY in RG, Z rebuilt by shaders
+	TextureCacheKind_Count,
+};
+
+enum TextureCompression {
+	TextureCompression_None,
+	TextureCompression_ETC2,
+	TextureCompression_BC,
+	TextureCompression_Count,
+};
+
+/**
+ * Header of a KTX2 file, followed by one struct Ktx2Level per level.
+ */
+struct Ktx2Header {
+	uint8_t identifier[12];
+	uint32_t vkFormat;
+	uint32_t typeSize;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t layerCount;
+	uint32_t faceCount;
+	uint32_t levelCount;
+	uint32_t supercompressionScheme;
+	uint32_t dfdByteOffset;
+	uint32_t dfdByteLength;
+	uint32_t kvdByteOffset;
+	uint32_t kvdByteLength;
+	uint64_t sgdByteOffset;
+	uint64_t sgdByteLength;
+};
+
+struct Ktx2Level {
+	uint64_t byteOffset;
+	uint64_t byteLength;
+	uint64_t uncompressedByteLength;
+};
+
+/**
+ * Identity of the source of a cache, see TEXTURE_CACHE_SOURCE_KEY.
+ */
+struct TextureCacheSource {
+	uint64_t size;
+	int64_t modified; // nanoseconds since the epoch
+	uint64_t hash;
+};
+
+/**
+ * A cache, as mapped from its file. Pointers are into the mapping.
+ */
+struct TextureCache {
+	struct MappedFile * file;
+	struct Ktx2Header const * header;
+	WGPUTextureFormat format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	void const * levels[TEXTURE_CACHE_MAX_LEVELS]; // finest first
+	uint64_t levelSizes[TEXTURE_CACHE_MAX_LEVELS];
+	bool hasSource; // whether `source` was recorded
+	struct TextureCacheSource source;
+	uint64_t sourceOffset; // of `source` in the file
+};
+
+/**
+ * Best compression family of the features enabled on `device`.
+ */
+enum TextureCompression textureCompressionOf(WGPUDevice device);
+
+/**
+ * Format of the textures of `kind` for `compression`, when their size is
+ * a multiple of 4.
+ */
+WGPUTextureFormat textureCacheFormat(enum TextureCacheKind kind, enum TextureCompression compression);
+
+/**
+ * Extension of the cache files of `kind` for `compression`, appended to
+ * the path of their source.
+ */
+char const * textureCacheExtension(enum TextureCacheKind kind, enum TextureCompression compression);
+
+/**
+ * Map the cache of the JPEG file at `sourcePath` for `kind` and
+ * `compression`, importing it on `threadCount` threads (see
+ * blockCompressImage) and writing the cache first if it is missing or
+ * out of date. Returns NULL and prints why if neither the cache nor the
+ * source can be loaded.
+ */
+struct TextureCache * textureCacheLoad(char const * sourcePath, enum TextureCacheKind kind, enum TextureCompression compression, uint32_t threadCount);
+
+/**
+ * Map and validate the KTX2 file at `path`, without checking its source.
+ * Only files of the formats of the table above, 2D, without
+ * supercompression, are accepted.
+ */
+struct TextureCache * textureCacheOpen(char const * path);
+
+/**
+ * Create a texture with TextureBinding and CopyDst usages and all the
+ * levels of `cache`, and write them.
+ */
+WGPUTexture textureCacheCreateTexture(WGPUDevice device, WGPUQueue queue, struct TextureCache const * cache, char const * label);
+
+void textureCacheRelease(struct TextureCache * cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _texture_cache_h_
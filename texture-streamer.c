@@ -0,0 +1,469 @@
+#include "texture-streamer.h"
+#include "jpeg-decoder.h"
+#include "mapped-file.h"
+#include "mipmap-generator.h"
+
+#include <tinycthread.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Levels of the largest texture the decoder accepts (32768)
+#define MAX_LEVELS 16
+
+struct StreamedTextureData {
+	// Guarded by the workers' mutex until `decoded` is set
+	bool queued;
+	bool decoding;
+	bool decoded;
+	bool failed;
+	bool abandoned; // released while a worker decodes it
+	struct StreamedTexture * nextJob;
+
+	// Written by the worker, then owned by the main thread
+	uint8_t * pixels; // levels of the texture, finest first
+	uint64_t levelOffsets[MAX_LEVELS];
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	uint32_t skippedLevels;
+	uint64_t gpuBytes; // reserved in the memory budget
+	uint64_t stagingBytes; // reserved in the staging budget
+
+	// Upload progress, main thread only
+	bool created;
+	uint32_t uploadLevel;
+	uint32_t uploadedRows;
+	uint32_t viewLevel;
+};
+
+struct TextureStreamerWorkers {
+	thrd_t threads[TEXTURE_STREAMER_MAX_THREADS];
+	uint32_t threadCount;
+	mtx_t mutex;
+	// Signaled when files are queued, staging memory is freed or stopping
+	cnd_t changed;
+	struct StreamedTexture * queueHead;
+	struct StreamedTexture * queueTail;
+	uint64_t reservedBytes;
+	uint64_t stagingBytes;
+	bool stopping;
+	struct TextureStreamer * streamer;
+};
+
+static uint32_t levelSize(uint32_t size, uint32_t level) {
+	size >>= level;
+	return size > 0 ? size : 1;
+}
+
+static uint64_t levelBytes(uint32_t width, uint32_t height, uint32_t level) {
+	return (uint64_t)levelSize(width, level) * levelSize(height, level) * 4;
+}
+
+/**
+ * Bytes of the levels of an image from `firstLevel` to the end.
+ */
+static uint64_t chainBytes(uint32_t width, uint32_t height, uint32_t firstLevel) {
+	uint64_t bytes = 0;
+	for (uint32_t level = firstLevel; level < mipmapLevelCount(width, height); ++level) {
+		bytes += levelBytes(width, height, level);
+	}
+	return bytes;
+}
+
+static void freeTexture(struct StreamedTexture * texture) {
+	free(texture->data->pixels);
+	free(texture->data);
+	free(texture->path);
+	free(texture);
+}
+
+// Decoding
+
+/**
+ * Read and decode the file of `texture`, choose the levels that fit the
+ * memory budget and build them. Sets `failed` on error.
+ */
+static void decodeTexture(struct TextureStreamerWorkers * workers, struct StreamedTexture * texture) {
+	struct StreamedTextureData * data = texture->data;
+	struct MappedFile * file = mappedFileOpen(texture->path);
+	uint32_t width, height;
+	if (!file || !file->data || !jpegReadSize(file->data, file->size, &width, &height)) {
+		if (file) mappedFileClose(file);
+		data->failed = true;
+		return;
+	}
+
+	// Reserve the GPU memory of the levels that fit, then wait for
+	// uploads to make room for the decoded levels
+	uint32_t fileLevels = mipmapLevelCount(width, height);
+	mtx_lock(&workers->mutex);
+	uint32_t skipped = 0;
+	while (skipped + 1 < fileLevels && workers->reservedBytes + chainBytes(width, height, skipped) > workers->streamer->memoryBudget) {
+		++skipped;
+	}
+	data->gpuBytes = chainBytes(width, height, skipped);
+	workers->reservedBytes += data->gpuBytes;
+	// Level 0 is decoded whatever the levels kept
+	uint64_t staging = chainBytes(width, height, 0);
+	while (workers->stagingBytes > 0 && workers->stagingBytes + staging > TEXTURE_STREAMER_STAGING_SIZE && !workers->stopping) {
+		cnd_wait(&workers->changed, &workers->mutex);
+	}
+	workers->stagingBytes += staging;
+	data->stagingBytes = staging;
+	mtx_unlock(&workers->mutex);
+
+	uint8_t * pixels = jpegDecode(file->data, file->size, &width, &height);
+	mappedFileClose(file);
+	uint8_t * chain = pixels ? (uint8_t *)realloc(pixels, staging) : NULL;
+	if (!chain) {
+		free(pixels);
+		data->failed = true;
+		return;
+	}
+	mipmapBuildChain(chain, width, height, texture->srgb);
+	// Drop the levels over the budget, keeping the chain from `skipped`
+	uint64_t skippedBytes = staging - data->gpuBytes;
+	if (skippedBytes > 0) {
+		memmove(chain, chain + skippedBytes, data->gpuBytes);
+	}
+	data->pixels = chain;
+	data->width = levelSize(width, skipped);
+	data->height = levelSize(height, skipped);
+	data->levelCount = fileLevels - skipped;
+	data->skippedLevels = skipped;
+	uint64_t offset = 0;
+	for (uint32_t level = 0; level < data->levelCount; ++level) {
+		data->levelOffsets[level] = offset;
+		offset += levelBytes(data->width, data->height, level);
+	}
+}
+
+/**
+ * Give back the memory reserved for a texture. Called with the mutex held.
+ */
+static void unreserve(struct TextureStreamerWorkers * workers, struct StreamedTextureData * data) {
+	workers->reservedBytes -= data->gpuBytes;
+	workers->stagingBytes -= data->stagingBytes;
+	data->gpuBytes = 0;
+	data->stagingBytes = 0;
+	cnd_broadcast(&workers->changed);
+}
+
+static int workerThread(void * arg) {
+	struct TextureStreamerWorkers * workers = (struct TextureStreamerWorkers *)arg;
+	mtx_lock(&workers->mutex);
+	for (;;) {
+		while (!workers->queueHead && !workers->stopping) {
+			cnd_wait(&workers->changed, &workers->mutex);
+		}
+		if (workers->stopping) break;
+		struct StreamedTexture * texture = workers->queueHead;
+		workers->queueHead = texture->data->nextJob;
+		if (!workers->queueHead) workers->queueTail = NULL;
+		texture->data->queued = false;
+		texture->data->decoding = true;
+		mtx_unlock(&workers->mutex);
+
+		decodeTexture(workers, texture);
+
+		mtx_lock(&workers->mutex);
+		texture->data->decoding = false;
+		if (texture->data->abandoned) {
+			unreserve(workers, texture->data);
+			freeTexture(texture);
+		} else {
+			if (texture->data->failed) unreserve(workers, texture->data);
+			texture->data->decoded = true;
+		}
+	}
+	mtx_unlock(&workers->mutex);
+	return 0;
+}
+
+struct TextureStreamer * textureStreamerCreate(WGPUDevice device, uint32_t threadCount, uint64_t uploadBudget, uint64_t memoryBudget) {
+	if (threadCount == 0) threadCount = TEXTURE_STREAMER_DEFAULT_THREADS;
+	if (threadCount > TEXTURE_STREAMER_MAX_THREADS) threadCount = TEXTURE_STREAMER_MAX_THREADS;
+	struct TextureStreamer * streamer = (struct TextureStreamer *)calloc(1, sizeof(struct TextureStreamer));
+	streamer->device = device;
+	streamer->queue = wgpuDeviceGetQueue(device);
+	streamer->uploadBudget = uploadBudget > 0 ? uploadBudget : TEXTURE_STREAMER_DEFAULT_UPLOAD_BUDGET;
+	streamer->memoryBudget = memoryBudget > 0 ? memoryBudget : TEXTURE_STREAMER_DEFAULT_MEMORY_BUDGET;
+
+	WGPUTextureDescriptor placeholderDesc = (WGPUTextureDescriptor) {};
+	placeholderDesc.nextInChain = NULL;
+	placeholderDesc.label = "Streamed texture placeholder";
+	placeholderDesc.usage = WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst;
+	placeholderDesc.dimension = WGPUTextureDimension_2D;
+	placeholderDesc.size = (WGPUExtent3D) { 1, 1, 1 };
+	placeholderDesc.format = WGPUTextureFormat_RGBA8Unorm;
+	placeholderDesc.mipLevelCount = 1;
+	placeholderDesc.sampleCount = 1;
+	placeholderDesc.viewFormatCount = 0;
+	placeholderDesc.viewFormats = NULL;
+	streamer->placeholderTexture = wgpuDeviceCreateTexture(device, &placeholderDesc);
+	streamer->placeholderView = wgpuTextureCreateView(streamer->placeholderTexture, NULL);
+	uint8_t const gray[4] = { 128, 128, 128, 255 };
+	WGPUImageCopyTexture destination = (WGPUImageCopyTexture) {};
+	destination.texture = streamer->placeholderTexture;
+	destination.mipLevel = 0;
+	destination.origin = (WGPUOrigin3D) { 0, 0, 0 };
+	destination.aspect = WGPUTextureAspect_All;
+	WGPUTextureDataLayout layout = (WGPUTextureDataLayout) {};
+	layout.offset = 0;
+	layout.bytesPerRow = 4;
+	layout.rowsPerImage = 1;
+	wgpuQueueWriteTexture(streamer->queue, &destination, gray, sizeof(gray), &layout, &placeholderDesc.size);
+
+	struct TextureStreamerWorkers * workers = (struct TextureStreamerWorkers *)calloc(1, sizeof(struct TextureStreamerWorkers));
+	workers->streamer = streamer;
+	mtx_init(&workers->mutex, mtx_plain);
+	cnd_init(&workers->changed);
+	streamer->workers = workers;
+	for (; workers->threadCount < threadCount; ++workers->threadCount) {
+		if (thrd_create(&workers->threads[workers->threadCount], workerThread, (void *)workers) != thrd_success) break;
+	}
+	if (workers->threadCount == 0) {
+		fprintf(stderr, "Could not start the texture streaming threads\n");
+		textureStreamerRelease(streamer);
+		return NULL;
+	}
+	return streamer;
+}
+
+struct StreamedTexture * textureStreamerLoad(struct TextureStreamer * streamer, char const * path, bool srgb) {
+	struct StreamedTexture * texture = (struct StreamedTexture *)calloc(1, sizeof(struct StreamedTexture));
+	texture->data = (struct StreamedTextureData *)calloc(1, sizeof(struct StreamedTextureData));
+	size_t pathSize = strlen(path) + 1;
+	texture->path = (char *)malloc(pathSize);
+	memcpy(texture->path, path, pathSize);
+	texture->srgb = srgb;
+	texture->view = streamer->placeholderView;
+	texture->state = StreamedTexture_Loading;
+
+	// Keep request order, which is the upload order among equal levels
+	struct StreamedTexture ** last = &streamer->first;
+	while (*last) last = &(*last)->next;
+	*last = texture;
+	streamer->pendingCount++;
+
+	struct TextureStreamerWorkers * workers = streamer->workers;
+	mtx_lock(&workers->mutex);
+	texture->data->queued = true;
+	if (workers->queueTail) {
+		workers->queueTail->data->nextJob = texture;
+	} else {
+		workers->queueHead = texture;
+	}
+	workers->queueTail = texture;
+	cnd_signal(&workers->changed);
+	mtx_unlock(&workers->mutex);
+	return texture;
+}
+
+// Uploading
+
+static void createTexture(struct TextureStreamer * streamer, struct StreamedTexture * texture) {
+	struct StreamedTextureData * data = texture->data;
+	data->created = true;
+	if (data->failed) {
+		fprintf(stderr, "Could not load texture %s\n", texture->path);
+		texture->state = StreamedTexture_Failed;
+		streamer->pendingCount--;
+		return;
+	}
+	WGPUTextureDescriptor desc = (WGPUTextureDescriptor) {};
+	desc.nextInChain = NULL;
+	desc.label = texture->path;
+	desc.usage = WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst;
+	desc.dimension = WGPUTextureDimension_2D;
+	desc.size = (WGPUExtent3D) { data->width, data->height, 1 };
+	desc.format = texture->srgb ? WGPUTextureFormat_RGBA8UnormSrgb : WGPUTextureFormat_RGBA8Unorm;
+	desc.mipLevelCount = data->levelCount;
+	desc.sampleCount = 1;
+	desc.viewFormatCount = 0;
+	desc.viewFormats = NULL;
+	texture->texture = wgpuDeviceCreateTexture(streamer->device, &desc);
+	texture->width = data->width;
+	texture->height = data->height;
+	texture->levelCount = data->levelCount;
+	texture->skippedLevels = data->skippedLevels;
+	texture->residentLevel = data->levelCount;
+	texture->state = StreamedTexture_Streaming;
+	data->uploadLevel = data->levelCount - 1;
+	data->uploadedRows = 0;
+	data->viewLevel = data->levelCount;
+	streamer->residentBytes += data->gpuBytes;
+}
+
+/**
+ * Write the next rows of the level being uploaded, at least one and as
+ * many as `budget` allows. Returns the bytes written.
+ */
+static uint64_t uploadRows(struct TextureStreamer * streamer, struct StreamedTexture * texture, uint64_t budget) {
+	struct StreamedTextureData * data = texture->data;
+	uint32_t level = data->uploadLevel;
+	uint32_t width = levelSize(data->width, level);
+	uint32_t height = levelSize(data->height, level);
+	uint64_t rowBytes = (uint64_t)width * 4;
+	uint64_t rows = budget / rowBytes;
+	if (rows == 0) rows = 1;
+	if (rows > height - data->uploadedRows) rows = height - data->uploadedRows;
+
+	WGPUImageCopyTexture destination = (WGPUImageCopyTexture) {};
+	destination.texture = texture->texture;
+	destination.mipLevel = level;
+	destination.origin = (WGPUOrigin3D) { 0, data->uploadedRows, 0 };
+	destination.aspect = WGPUTextureAspect_All;
+	WGPUTextureDataLayout layout = (WGPUTextureDataLayout) {};
+	layout.offset = 0;
+	layout.bytesPerRow = (uint32_t)rowBytes;
+	layout.rowsPerImage = (uint32_t)rows;
+	WGPUExtent3D size = (WGPUExtent3D) { width, (uint32_t)rows, 1 };
+	uint8_t const * source = data->pixels + data->levelOffsets[level] + data->uploadedRows * rowBytes;
+	wgpuQueueWriteTexture(streamer->queue, &destination, source, rows * rowBytes, &layout, &size);
+	streamer->uploadedBytes += rows * rowBytes;
+
+	data->uploadedRows += (uint32_t)rows;
+	if (data->uploadedRows == height) {
+		texture->residentLevel = level;
+		data->uploadedRows = 0;
+		if (level > 0) {
+			data->uploadLevel = level - 1;
+		} else {
+			// All levels are in: the decoded ones are not needed anymore
+			texture->state = StreamedTexture_Resident;
+			streamer->pendingCount--;
+			free(data->pixels);
+			data->pixels = NULL;
+			mtx_lock(&streamer->workers->mutex);
+			streamer->workers->stagingBytes -= data->stagingBytes;
+			data->stagingBytes = 0;
+			cnd_broadcast(&streamer->workers->changed);
+			mtx_unlock(&streamer->workers->mutex);
+		}
+	}
+	return rows * rowBytes;
+}
+
+static void updateView(struct StreamedTexture * texture) {
+	struct StreamedTextureData * data = texture->data;
+	if (data->viewLevel == texture->residentLevel) return;
+	WGPUTextureViewDescriptor viewDesc = (WGPUTextureViewDescriptor) {};
+	viewDesc.nextInChain = NULL;
+	viewDesc.label = texture->path;
+	viewDesc.format = texture->srgb ? WGPUTextureFormat_RGBA8UnormSrgb : WGPUTextureFormat_RGBA8Unorm;
+	viewDesc.dimension = WGPUTextureViewDimension_2D;
+	viewDesc.baseMipLevel = texture->residentLevel;
+	viewDesc.mipLevelCount = texture->levelCount - texture->residentLevel;
+	viewDesc.baseArrayLayer = 0;
+	viewDesc.arrayLayerCount = 1;
+	viewDesc.aspect = WGPUTextureAspect_All;
+	WGPUTextureView view = wgpuTextureCreateView(texture->texture, &viewDesc);
+	// Bind groups still using the previous view keep it alive
+	if (data->viewLevel < texture->levelCount) wgpuTextureViewRelease(texture->view);
+	texture->view = view;
+	texture->generation++;
+	data->viewLevel = texture->residentLevel;
+}
+
+void textureStreamerUpdate(struct TextureStreamer * streamer) {
+	struct TextureStreamerWorkers * workers = streamer->workers;
+	mtx_lock(&workers->mutex);
+	for (struct StreamedTexture * texture = streamer->first; texture; texture = texture->next) {
+		// Decoded textures leave the workers for good
+		if (texture->data->decoded && !texture->data->created) {
+			mtx_unlock(&workers->mutex);
+			createTexture(streamer, texture);
+			mtx_lock(&workers->mutex);
+		}
+	}
+	mtx_unlock(&workers->mutex);
+
+	// Smallest pending level first, across all textures, so that every
+	// texture is usable before any gets sharper
+	uint64_t budget = streamer->uploadBudget;
+	while (budget > 0) {
+		struct StreamedTexture * next = NULL;
+		uint64_t nextBytes = UINT64_MAX;
+		for (struct StreamedTexture * texture = streamer->first; texture; texture = texture->next) {
+			if (texture->state != StreamedTexture_Streaming) continue;
+			uint64_t bytes = levelBytes(texture->data->width, texture->data->height, texture->data->uploadLevel);
+			if (bytes < nextBytes) {
+				next = texture;
+				nextBytes = bytes;
+			}
+		}
+		if (!next) break;
+		uint64_t written = uploadRows(streamer, next, budget);
+		budget = written < budget ? budget - written : 0;
+	}
+
+	for (struct StreamedTexture * texture = streamer->first; texture; texture = texture->next) {
+		if (texture->texture) updateView(texture);
+	}
+}
+
+void textureStreamerReleaseTexture(struct TextureStreamer * streamer, struct StreamedTexture * texture) {
+	struct StreamedTexture ** link = &streamer->first;
+	while (*link && *link != texture) link = &(*link)->next;
+	if (!*link) return;
+	*link = texture->next;
+	if (texture->state == StreamedTexture_Loading || texture->state == StreamedTexture_Streaming) {
+		streamer->pendingCount--;
+	}
+
+	struct StreamedTextureData * data = texture->data;
+	struct TextureStreamerWorkers * workers = streamer->workers;
+	mtx_lock(&workers->mutex);
+	if (data->queued) {
+		struct StreamedTexture ** job = &workers->queueHead;
+		struct StreamedTexture * previous = NULL;
+		while (*job != texture) {
+			previous = *job;
+			job = &(*job)->data->nextJob;
+		}
+		*job = data->nextJob;
+		if (workers->queueTail == texture) workers->queueTail = previous;
+	} else if (data->decoding) {
+		// The worker frees it when done
+		data->abandoned = true;
+		mtx_unlock(&workers->mutex);
+		return;
+	}
+	uint64_t gpuBytes = data->gpuBytes;
+	unreserve(workers, data);
+	mtx_unlock(&workers->mutex);
+
+	if (texture->texture) {
+		streamer->residentBytes -= gpuBytes;
+		if (texture->view != streamer->placeholderView) wgpuTextureViewRelease(texture->view);
+		wgpuTextureDestroy(texture->texture);
+		wgpuTextureRelease(texture->texture);
+	}
+	freeTexture(texture);
+}
+
+void textureStreamerRelease(struct TextureStreamer * streamer) {
+	if (!streamer) return;
+	struct TextureStreamerWorkers * workers = streamer->workers;
+	mtx_lock(&workers->mutex);
+	workers->stopping = true;
+	cnd_broadcast(&workers->changed);
+	mtx_unlock(&workers->mutex);
+	for (uint32_t i = 0; i < workers->threadCount; ++i) {
+		thrd_join(workers->threads[i], NULL);
+	}
+	while (streamer->first) {
+		textureStreamerReleaseTexture(streamer, streamer->first);
+	}
+	cnd_destroy(&workers->changed);
+	mtx_destroy(&workers->mutex);
+	free(workers);
+	wgpuTextureViewRelease(streamer->placeholderView);
+	wgpuTextureDestroy(streamer->placeholderTexture);
+	wgpuTextureRelease(streamer->placeholderTexture);
+	wgpuQueueRelease(streamer->queue);
+	free(streamer);
+}
@@ -0,0 +1,136 @@
+/**
+ * Asynchronous texture streaming, so that loading large textures (such as
+ * autumn_park_4k.jpg) never stalls a frame.
+ *
+ * Files are read and decoded (see jpeg-decoder.h) on worker threads, which
+ * also build the whole mip chain on the CPU, averaging in linear space for
+ * sRGB textures. The main thread then uploads the chain from its smallest
+ * level up, spending at most `uploadBudget` bytes of wgpuQueueWriteTexture
+ * per frame: large levels are written in bands of rows over several
+ * frames. The view of a texture only covers the levels uploaded so far,
+ * so it is complete and usable from the first frame its smallest levels
+ * are in, and gets sharper as finer levels arrive. Until then, the view is
+ * a 1x1 gray placeholder.
+ *
+ * The GPU memory of all the textures of a streamer stays within
+ * `memoryBudget`: a texture whose full chain does not fit is created
+ * without its finest levels. Decoded levels waiting for upload are kept
+ * below TEXTURE_STREAMER_STAGING_SIZE, workers waiting for uploads to
+ * catch up before decoding more.
+ *
+ * Typical frame:
+ *     textureStreamerUpdate(streamer);
+ *     if (texture->generation != boundGeneration) {
+ *         // recreate the bind group with texture->view
+ *         boundGeneration = texture->generation;
+ *     }
+ */
+
+#ifndef _texture_streamer_h_
+#define _texture_streamer_h_
+
+#include <webgpu/webgpu.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TEXTURE_STREAMER_DEFAULT_THREADS 4
+#define TEXTURE_STREAMER_MAX_THREADS 16
+// Enough to upload a 512x512 level and the chain below it in one frame
+#define TEXTURE_STREAMER_DEFAULT_UPLOAD_BUDGET (2 << 20)
+#define TEXTURE_STREAMER_DEFAULT_MEMORY_BUDGET (512 << 20)
+#define TEXTURE_STREAMER_STAGING_SIZE (256 << 20)
+
+enum StreamedTextureState {
+	StreamedTexture_Loading, // read and decoded by a worker
+	StreamedTexture_Streaming, // some levels uploaded
+	StreamedTexture_Resident, // all levels uploaded
+	StreamedTexture_Failed, // the file could not be read or decoded
+};
+
+// Decoded levels and upload progress, private to texture-streamer.c
+struct StreamedTextureData;
+
+struct StreamedTexture {
+	// Always valid: the placeholder while loading or if loading failed
+	WGPUTextureView view;
+	// Incremented each time `view` changes, to know when to rebind it
+	uint64_t generation;
+	enum StreamedTextureState state;
+	// Size of level 0 of `texture`, which may be smaller than the file
+	// to fit the memory budget
+	uint32_t width;
+	uint32_t height;
+	WGPUTexture texture; // NULL while loading
+	uint32_t levelCount;
+	// Finest level of `texture` uploaded, and first level of `view`
+	uint32_t residentLevel;
+	// Levels of the file dropped to fit the memory budget
+	uint32_t skippedLevels;
+
+	char * path;
+	bool srgb;
+	struct StreamedTextureData * data;
+	struct StreamedTexture * next;
+};
+
+// Threads, queue of files to decode and budget accounting, private to
+// texture-streamer.c
+struct TextureStreamerWorkers;
+
+struct TextureStreamer {
+	WGPUDevice device;
+	WGPUQueue queue;
+	uint64_t uploadBudget; // bytes per frame
+	uint64_t memoryBudget;
+	WGPUTexture placeholderTexture;
+	WGPUTextureView placeholderView;
+	// Textures being loaded or uploaded, in request order
+	struct StreamedTexture * first;
+	struct TextureStreamerWorkers * workers;
+
+	// Statistics
+	uint64_t uploadedBytes;
+	uint64_t residentBytes; // GPU memory of the textures
+	uint32_t pendingCount; // textures not resident nor failed yet
+};
+
+/**
+ * Start `threadCount` decoding threads, or TEXTURE_STREAMER_DEFAULT_THREADS
+ * when 0. A budget of 0 picks the default.
+ */
+struct TextureStreamer * textureStreamerCreate(WGPUDevice device, uint32_t threadCount, uint64_t uploadBudget, uint64_t memoryBudget);
+
+/**
+ * Start loading the JPEG file at `path` into an RGBA8Unorm(Srgb) texture
+ * with TextureBinding and CopyDst usages. The returned texture can be
+ * bound right away and belongs to the streamer.
+ */
+struct StreamedTexture * textureStreamerLoad(struct TextureStreamer * streamer, char const * path, bool srgb);
+
+/**
+ * Create the textures decoded since the last call and upload up to the
+ * upload budget of levels. Call once per frame.
+ */
+void textureStreamerUpdate(struct TextureStreamer * streamer);
+
+/**
+ * Release `texture`, whether it is still loading or not, and give its
+ * memory back to the budget.
+ */
+void textureStreamerReleaseTexture(struct TextureStreamer * streamer, struct StreamedTexture * texture);
+
+/**
+ * Stop the workers and release all textures.
+ */
+void textureStreamerRelease(struct TextureStreamer * streamer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _texture_streamer_h_
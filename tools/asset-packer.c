@@ -0,0 +1,96 @@
+/**
+ * Pack files into an asset archive (see asset-archive.h), or list the
+ * entries of one.
+ *
+ * Files are named in the archive by their path relative to the directory
+ * given with -C (the working directory by default), with '/' separators.
+ * --lz4 and --store set the compression of the files that follow them:
+ * files are compressed by default, and stored when it does not save
+ * enough. Zips must be extracted first, as their content is already
+ * compressed.
+ *
+ * Usage:
+ *     AssetPacker [-C directory] archive.wpak [--lz4 | --store] file...
+ *     AssetPacker -l archive.wpak
+ */
+
+#include "asset-archive.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char const * const compressionNames[AssetCompression_Count] = { "stored", "lz4" };
+
+static int usage(void) {
+	fprintf(stderr, "Usage: AssetPacker [-C directory] archive.wpak [--lz4 | --store] file...\n");
+	fprintf(stderr, "       AssetPacker -l archive.wpak\n");
+	return 1;
+}
+
+static int list(char const * path) {
+	struct AssetArchive * archive = assetArchiveOpen(path);
+	if (!archive) return 1;
+	uint64_t size = 0, uncompressedSize = 0;
+	printf("%12s %12s %-6s %s\n", "size", "stored", "", "name");
+	for (uint32_t i = 0; i < archive->header->entryCount; ++i) {
+		struct AssetArchiveEntry const * entry = &archive->entries[i];
+		printf("%12llu %12llu %-6s %s\n", (unsigned long long)entry->uncompressedSize, (unsigned long long)entry->size,
+			compressionNames[entry->compression], assetArchiveEntryName(archive, entry));
+		size += entry->size;
+		uncompressedSize += entry->uncompressedSize;
+	}
+	printf("%12llu %12llu        %u entries, %llu bytes in total\n", (unsigned long long)uncompressedSize, (unsigned long long)size,
+		archive->header->entryCount, (unsigned long long)archive->file->size);
+	assetArchiveClose(archive);
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	if (argc == 3 && strcmp(argv[1], "-l") == 0) return list(argv[2]);
+
+	int arg = 1;
+	char const * directory = NULL;
+	if (arg + 1 < argc && strcmp(argv[arg], "-C") == 0) {
+		directory = argv[arg + 1];
+		arg += 2;
+	}
+	if (arg >= argc) return usage();
+	char const * archivePath = argv[arg++];
+
+	struct AssetArchiveInput * inputs = (struct AssetArchiveInput *)calloc(argc, sizeof(struct AssetArchiveInput));
+	uint32_t inputCount = 0;
+	enum AssetCompression compression = AssetCompression_LZ4;
+	for (; arg < argc; ++arg) {
+		if (strcmp(argv[arg], "--lz4") == 0) {
+			compression = AssetCompression_LZ4;
+		} else if (strcmp(argv[arg], "--store") == 0) {
+			compression = AssetCompression_None;
+		} else {
+			char const * file = argv[arg];
+			size_t length = strlen(file);
+			size_t directoryLength = directory ? strlen(directory) : 0;
+			char * path = (char *)malloc(directoryLength + length + 2);
+			if (directory) {
+				memcpy(path, directory, directoryLength);
+				path[directoryLength++] = '/';
+			}
+			memcpy(path + directoryLength, file, length + 1);
+
+			while (file[0] == '.' && (file[1] == '/' || file[1] == '\\')) file += 2;
+			size_t nameLength = strlen(file);
+			char * name = (char *)malloc(nameLength + 1);
+			for (size_t i = 0; i <= nameLength; ++i) name[i] = file[i] == '\\' ? '/' : file[i];
+			inputs[inputCount++] = (struct AssetArchiveInput) { name, path, compression };
+		}
+	}
+	if (inputCount == 0) return usage();
+
+	bool ok = assetArchiveWrite(archivePath, inputs, inputCount);
+	for (uint32_t i = 0; i < inputCount; ++i) {
+		free((void *)inputs[i].name);
+		free((void *)inputs[i].path);
+	}
+	free(inputs);
+	return ok ? list(archivePath) : 1;
+}
@@ -0,0 +1,197 @@
+#include "vertex-quantization.h"
+#include "half-float.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SNORM16_MAX 32767.0f
+#define DEGREES_PER_RADIAN 57.29577951308232f
+
+static uint32_t const attributeSizes[VertexAttribute_Count] = { 8, 4, 8, 4 };
+static WGPUVertexFormat const attributeFormats[VertexAttribute_Count] = {
+	WGPUVertexFormat_Float16x4,
+	WGPUVertexFormat_Snorm16x2,
+	WGPUVertexFormat_Snorm16x4,
+	WGPUVertexFormat_Float16x2,
+};
+
+// Directions
+
+static float snorm16ToFloat(int16_t value) {
+	// As the GPU does: -32768 and -32767 both map to -1
+	return fmaxf((float)value / SNORM16_MAX, -1.0f);
+}
+
+static int16_t floatToSnorm16(float value) {
+	return (int16_t)lrintf(fminf(fmaxf(value, -1.0f), 1.0f) * SNORM16_MAX);
+}
+
+static float signNotZero(float value) {
+	return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+static void octDecode(int16_t const encoded[2], float direction[3]) {
+	float x = snorm16ToFloat(encoded[0]);
+	float y = snorm16ToFloat(encoded[1]);
+	float z = 1.0f - fabsf(x) - fabsf(y);
+	float t = fmaxf(-z, 0.0f);
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+	float length = sqrtf(x * x + y * y + z * z);
+	direction[0] = x / length;
+	direction[1] = y / length;
+	direction[2] = z / length;
+}
+
+static float angleBetween(float const a[3], float const b[3]) {
+	float cross[3] = {
+		a[1] * b[2] - a[2] * b[1],
+		a[2] * b[0] - a[0] * b[2],
+		a[0] * b[1] - a[1] * b[0],
+	};
+	float sine = sqrtf(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+	float cosine = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	return atan2f(sine, cosine) * DEGREES_PER_RADIAN;
+}
+
+/**
+ * Octahedral encoding of a direction, choosing among the 4 roundings of
+ * the projected point the one that decodes closest. Returns the angle
+ * between the direction and its decoding, in degrees.
+ */
+static float octEncode(float const direction[3], int16_t encoded[2]) {
+	float length = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+	if (length == 0.0f) {
+		encoded[0] = 0;
+		encoded[1] = 0;
+		return 0.0f;
+	}
+	float n[3] = { direction[0] / length, direction[1] / length, direction[2] / length };
+	float l1 = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+	float x = n[0] / l1;
+	float y = n[1] / l1;
+	if (n[2] < 0.0f) {
+		float folded = (1.0f - fabsf(y)) * signNotZero(x);
+		y = (1.0f - fabsf(x)) * signNotZero(y);
+		x = folded;
+	}
+	float bestError = INFINITY;
+	for (uint32_t i = 0; i < 4; ++i) {
+		int16_t candidate[2] = {
+			(int16_t)fminf(fmaxf((i & 1 ? ceilf(x * SNORM16_MAX) : floorf(x * SNORM16_MAX)), -SNORM16_MAX), SNORM16_MAX),
+			(int16_t)fminf(fmaxf((i & 2 ? ceilf(y * SNORM16_MAX) : floorf(y * SNORM16_MAX)), -SNORM16_MAX), SNORM16_MAX),
+		};
+		float decoded[3];
+		octDecode(candidate, decoded);
+		float error = angleBetween(n, decoded);
+		if (error < bestError) {
+			bestError = error;
+			encoded[0] = candidate[0];
+			encoded[1] = candidate[1];
+		}
+	}
+	return bestError;
+}
+
+// Quantization
+
+static float const * attributeOf(struct VertexQuantizationSource const * source, uint32_t v, enum VertexAttribute attribute) {
+	return (float const *)((char const *)source->vertices + (size_t)v * source->stride + source->offsets[attribute]);
+}
+
+struct QuantizedVertices * quantizeVertices(struct VertexQuantizationSource const * source) {
+	if (source->offsets[VertexAttribute_Position] == VERTEX_ATTRIBUTE_ABSENT) return NULL;
+
+	struct QuantizedVertices * q = (struct QuantizedVertices *)calloc(1, sizeof(struct QuantizedVertices));
+	if (!q) return NULL;
+	uint32_t attributeOffsets[VertexAttribute_Count];
+	for (uint32_t a = 0; a < VertexAttribute_Count; ++a) {
+		if (source->offsets[a] == VERTEX_ATTRIBUTE_ABSENT) continue;
+		attributeOffsets[a] = q->stride;
+		q->attributes[q->attributeCount++] = (WGPUVertexAttribute) { attributeFormats[a], q->stride, a };
+		q->stride += attributeSizes[a];
+	}
+	q->vertexCount = source->vertexCount;
+	q->data = calloc(q->vertexCount > 0 ? q->vertexCount : 1, q->stride);
+	if (!q->data) {
+		free(q);
+		return NULL;
+	}
+
+	for (uint32_t k = 0; k < 3; ++k) {
+		float halfExtent = 0.5f * (source->boundsMax[k] - source->boundsMin[k]);
+		q->positionOffset[k] = 0.5f * (source->boundsMin[k] + source->boundsMax[k]);
+		q->positionScale[k] = halfExtent > 0.0f ? halfExtent : 1.0f;
+	}
+
+	for (uint32_t v = 0; v < q->vertexCount; ++v) {
+		uint8_t * out = (uint8_t *)q->data + (size_t)v * q->stride;
+
+		float const * p = attributeOf(source, v, VertexAttribute_Position);
+		uint16_t position[4];
+		float squaredError = 0.0f;
+		for (uint32_t k = 0; k < 3; ++k) {
+			position[k] = floatToHalf((p[k] - q->positionOffset[k]) / q->positionScale[k]);
+			float d = q->positionOffset[k] + q->positionScale[k] * halfToFloat(position[k]) - p[k];
+			squaredError += d * d;
+		}
+		position[3] = floatToHalf(1.0f);
+		memcpy(out + attributeOffsets[VertexAttribute_Position], position, sizeof(position));
+		q->positionError = fmaxf(q->positionError, sqrtf(squaredError));
+
+		if (source->offsets[VertexAttribute_Normal] != VERTEX_ATTRIBUTE_ABSENT) {
+			int16_t normal[2];
+			q->normalError = fmaxf(q->normalError, octEncode(attributeOf(source, v, VertexAttribute_Normal), normal));
+			memcpy(out + attributeOffsets[VertexAttribute_Normal], normal, sizeof(normal));
+		}
+
+		if (source->offsets[VertexAttribute_Tangent] != VERTEX_ATTRIBUTE_ABSENT) {
+			float const * t = attributeOf(source, v, VertexAttribute_Tangent);
+			int16_t tangent[4];
+			q->tangentError = fmaxf(q->tangentError, octEncode(t, tangent));
+			tangent[2] = floatToSnorm16(signNotZero(t[3]));
+			tangent[3] = 0;
+			memcpy(out + attributeOffsets[VertexAttribute_Tangent], tangent, sizeof(tangent));
+		}
+
+		if (source->offsets[VertexAttribute_Texcoord] != VERTEX_ATTRIBUTE_ABSENT) {
+			float const * uv = attributeOf(source, v, VertexAttribute_Texcoord);
+			uint16_t texcoord[2] = { floatToHalf(uv[0]), floatToHalf(uv[1]) };
+			q->texcoordError = fmaxf(q->texcoordError, fabsf(halfToFloat(texcoord[0]) - uv[0]));
+			q->texcoordError = fmaxf(q->texcoordError, fabsf(halfToFloat(texcoord[1]) - uv[1]));
+			memcpy(out + attributeOffsets[VertexAttribute_Texcoord], texcoord, sizeof(texcoord));
+		}
+	}
+	return q;
+}
+
+struct QuantizedVertices * quantizeObjMesh(struct ObjMesh const * mesh) {
+	struct VertexQuantizationSource source = (struct VertexQuantizationSource) {};
+	source.vertices = mesh->vertices;
+	source.stride = sizeof(struct ObjVertex);
+	source.vertexCount = mesh->vertexCount;
+	source.offsets[VertexAttribute_Position] = offsetof(struct ObjVertex, position);
+	source.offsets[VertexAttribute_Normal] = offsetof(struct ObjVertex, normal);
+	source.offsets[VertexAttribute_Tangent] = VERTEX_ATTRIBUTE_ABSENT;
+	source.offsets[VertexAttribute_Texcoord] = mesh->hasTexcoords ? offsetof(struct ObjVertex, uv) : VERTEX_ATTRIBUTE_ABSENT;
+	memcpy(source.boundsMin, mesh->boundsMin, sizeof(source.boundsMin));
+	memcpy(source.boundsMax, mesh->boundsMax, sizeof(source.boundsMax));
+	return quantizeVertices(&source);
+}
+
+WGPUVertexBufferLayout quantizedVerticesLayout(struct QuantizedVertices const * q) {
+	WGPUVertexBufferLayout layout = (WGPUVertexBufferLayout) {};
+	layout.arrayStride = q->stride;
+	layout.stepMode = WGPUVertexStepMode_Vertex;
+	layout.attributeCount = q->attributeCount;
+	layout.attributes = q->attributes;
+	return layout;
+}
+
+void quantizedVerticesRelease(struct QuantizedVertices * q) {
+	if (!q) return;
+	free(q->data);
+	free(q);
+}
@@ -0,0 +1,121 @@
+/**
+ * Quantisation of vertex attributes, to halve the memory and the fetch
+ * bandwidth of meshes compared to 32-bit floats.
+ *
+ * Attributes are packed as follows, and the matching WebGPU vertex
+ * layout is generated along with them:
+ *   position  Float16x4 of the position relative to the mesh bounds, in
+ *             [-1, 1] (w = 1), so that halves keep 11 bits of precision
+ *             over the whole mesh whatever its size and offset
+ *   normal    Snorm16x2, octahedral encoding of the unit vector
+ *   tangent   Snorm16x4, octahedral encoding of the unit vector in xy and
+ *             the sign of the bitangent in z
+ *   texcoord  Float16x2
+ * The shader location of each attribute is its enum VertexAttribute. The
+ * shader reconstructs the position as positionOffset + positionScale * xyz
+ * and decodes directions with octDecode from VERTEX_QUANTIZATION_WGSL.
+ *
+ * Quantising decodes every vertex back to report the largest error of
+ * each attribute, so that a mesh whose error is too large for its use can
+ * keep full precision.
+ *
+ * Typical use:
+ *     struct QuantizedVertices * q = quantizeObjMesh(mesh);
+ *     WGPUVertexBufferLayout layout = quantizedVerticesLayout(q);
+ *     // pipeline with `layout`, uniforms with q->positionOffset/Scale
+ *     wgpuQueueWriteBuffer(queue, vertexBuffer, 0, q->data, (size_t)q->vertexCount * q->stride);
+ *     quantizedVerticesRelease(q);
+ */
+
+#ifndef _vertex_quantization_h_
+#define _vertex_quantization_h_
+
+#include <webgpu/webgpu.h>
+#include "obj-loader.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VERTEX_ATTRIBUTE_ABSENT SIZE_MAX
+
+/**
+ * Decoding of octahedral directions, to prepend to shaders reading
+ * quantized normals and tangents.
+ */
+#define VERTEX_QUANTIZATION_WGSL "\
+fn octDecode(e: vec2f) -> vec3f {\n\
+    var n = vec3f(e, 1.0 - abs(e.x) - abs(e.y));\n\
+    let t = max(-n.z, 0.0);\n\
+    n.x += select(t, -t, n.x >= 0.0);\n\
+    n.y += select(t, -t, n.y >= 0.0);\n\
+    return normalize(n);\n\
+}\n\
+"
+
+enum VertexAttribute {
+	VertexAttribute_Position,
+	VertexAttribute_Normal,
+	VertexAttribute_Tangent,
+	VertexAttribute_Texcoord,
+	VertexAttribute_Count,
+};
+
+/**
+ * Vertices with float attributes, as interleaved in any layout.
+ */
+struct VertexQuantizationSource {
+	void const * vertices;
+	size_t stride;
+	uint32_t vertexCount;
+	// Byte offset of each attribute in a vertex: position (3 floats),
+	// normal (3), tangent (4, w being the sign of the bitangent) and
+	// texcoord (2). VERTEX_ATTRIBUTE_ABSENT for missing ones but position.
+	size_t offsets[VertexAttribute_Count];
+	float boundsMin[3];
+	float boundsMax[3];
+};
+
+struct QuantizedVertices {
+	void * data;
+	uint32_t vertexCount;
+	uint32_t stride;
+	uint32_t attributeCount;
+	WGPUVertexAttribute attributes[VertexAttribute_Count];
+	// Position = positionOffset + positionScale * quantized position
+	float positionOffset[3];
+	float positionScale[3];
+	// Largest error over all vertices, 0 for absent attributes
+	float positionError; // distance, in the units of the mesh
+	float normalError; // degrees
+	float tangentError; // degrees
+	float texcoordError; // largest difference of a coordinate
+};
+
+/**
+ * Quantize vertices. Returns NULL if there are no positions or memory
+ * runs out.
+ */
+struct QuantizedVertices * quantizeVertices(struct VertexQuantizationSource const * source);
+
+/**
+ * Quantize the positions, normals and, if the file has them, texture
+ * coordinates of a loaded mesh.
+ */
+struct QuantizedVertices * quantizeObjMesh(struct ObjMesh const * mesh);
+
+/**
+ * Vertex buffer layout of quantized vertices, pointing into `q`.
+ */
+WGPUVertexBufferLayout quantizedVerticesLayout(struct QuantizedVertices const * q);
+
+void quantizedVerticesRelease(struct QuantizedVertices * q);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _vertex_quantization_h_
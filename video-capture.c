@@ -0,0 +1,266 @@
+#include "video-capture.h"
+#include "webgpu-utils.h"
+
+#include <stdlib.h>
+
+// Each invocation converts 8x2 pixels: 4 words of Y, 1 word of U and V
+#define PIXELS_PER_INVOCATION_X 8
+#define WORKGROUP_SIZE 8
+
+// Must match struct Params in the shader
+struct ConversionParams {
+	uint32_t width;
+	uint32_t height;
+	uint32_t lumaStride;
+	uint32_t chromaStride;
+	uint32_t chromaOffset;
+	uint32_t chromaPlaneSize;
+	uint32_t srgbInput;
+	uint32_t _pad;
+};
+
+static const char* yuvConversionShaderSource = "\
+struct Params {\n\
+    width: u32,\n\
+    height: u32,\n\
+    lumaStride: u32,\n\
+    chromaStride: u32,\n\
+    chromaOffset: u32,\n\
+    chromaPlaneSize: u32,\n\
+    srgbInput: u32,\n\
+    _pad: u32,\n\
+}\n\
+@group(0) @binding(0) var frame: texture_2d<f32>;\n\
+@group(0) @binding(1) var<uniform> params: Params;\n\
+@group(0) @binding(2) var<storage, read_write> yuv: array<u32>;\n\
+\n\
+const KR = 0.2126;\n\
+const KB = 0.0722;\n\
+\n\
+fn linearToSrgb(c: vec3f) -> vec3f {\n\
+    return select(1.055 * pow(c, vec3f(1.0 / 2.4)) - 0.055, 12.92 * c, c <= vec3f(0.0031308));\n\
+}\n\
+\n\
+fn loadRgb(x: i32, y: i32) -> vec3f {\n\
+    let p = min(vec2i(x, y), vec2i(i32(params.width) - 1, i32(params.height) - 1));\n\
+    var c = clamp(textureLoad(frame, p, 0).rgb, vec3f(0.0), vec3f(1.0));\n\
+    if (params.srgbInput != 0u) {\n\
+        c = linearToSrgb(c);\n\
+    }\n\
+    return c;\n\
+}\n\
+\n\
+fn lumaOf(c: vec3f) -> f32 {\n\
+    return dot(c, vec3f(KR, 1.0 - KR - KB, KB));\n\
+}\n\
+\n\
+fn pack4(v: vec4f) -> u32 {\n\
+    let b = vec4u(clamp(round(v), vec4f(0.0), vec4f(255.0)));\n\
+    return b.x | (b.y << 8u) | (b.z << 16u) | (b.w << 24u);\n\
+}\n\
+\n\
+@compute @workgroup_size(8, 8)\n\
+fn main(@builtin(global_invocation_id) id: vec3u) {\n\
+    if (id.x * 4u >= params.chromaStride || id.y * 2u >= params.height) {\n\
+        return;\n\
+    }\n\
+    let x0 = i32(id.x * 8u);\n\
+    let y0 = i32(id.y * 2u);\n\
+    // Two rows of 8 luma samples, then 4 chroma samples per plane\n\
+    var luma: array<vec4f, 4>;\n\
+    var u: vec4f;\n\
+    var v: vec4f;\n\
+    for (var i = 0; i < 4; i++) {\n\
+        var sum = vec3f(0.0);\n\
+        for (var dy = 0; dy < 2; dy++) {\n\
+            for (var dx = 0; dx < 2; dx++) {\n\
+                let c = loadRgb(x0 + 2 * i + dx, y0 + dy);\n\
+                sum += c;\n\
+                let k = 2 * i + dx;\n\
+                luma[dy * 2 + k / 4][k % 4] = 16.0 + 219.0 * lumaOf(c);\n\
+            }\n\
+        }\n\
+        let c = 0.25 * sum;\n\
+        let y = lumaOf(c);\n\
+        u[i] = 128.0 + 224.0 * (c.b - y) / (2.0 * (1.0 - KB));\n\
+        v[i] = 128.0 + 224.0 * (c.r - y) / (2.0 * (1.0 - KR));\n\
+    }\n\
+\n\
+    // The Y plane has an even number of rows, so the second one always exists\n\
+    let lumaWord = (u32(y0) * params.lumaStride + u32(x0)) / 4u;\n\
+    let nextRow = params.lumaStride / 4u;\n\
+    yuv[lumaWord] = pack4(luma[0]);\n\
+    yuv[lumaWord + 1u] = pack4(luma[1]);\n\
+    yuv[lumaWord + nextRow] = pack4(luma[2]);\n\
+    yuv[lumaWord + nextRow + 1u] = pack4(luma[3]);\n\
+    let chromaWord = (params.chromaOffset + id.y * params.chromaStride) / 4u + id.x;\n\
+    yuv[chromaWord] = pack4(u);\n\
+    yuv[chromaWord + params.chromaPlaneSize / 4u] = pack4(v);\n\
+}\n\
+";
+
+static bool isSrgbFormat(WGPUTextureFormat format) {
+	return format == WGPUTextureFormat_RGBA8UnormSrgb || format == WGPUTextureFormat_BGRA8UnormSrgb;
+}
+
+struct VideoCapture * videoCaptureCreate(WGPUDevice device, struct VideoCaptureDesc const * desc) {
+	FILE * file = fopen(desc->path, "wb");
+	if (!file) {
+		fprintf(stderr, "Could not create video capture file '%s'\n", desc->path);
+		return NULL;
+	}
+	uint32_t fpsNumerator = desc->fpsNumerator > 0 ? desc->fpsNumerator : 60;
+	uint32_t fpsDenominator = desc->fpsDenominator > 0 ? desc->fpsDenominator : 1;
+	fprintf(file, "YUV4MPEG2 W%u H%u F%u:%u Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n", desc->width, desc->height, fpsNumerator, fpsDenominator);
+
+	struct VideoCapture * capture = (struct VideoCapture *)calloc(1, sizeof(struct VideoCapture));
+	capture->device = device;
+	capture->queue = wgpuDeviceGetQueue(device);
+	capture->width = desc->width;
+	capture->height = desc->height;
+	capture->format = desc->format;
+	capture->file = file;
+
+	capture->lumaStride = (uint32_t)alignUp(desc->width, PIXELS_PER_INVOCATION_X);
+	capture->chromaStride = capture->lumaStride / 2;
+	uint64_t lumaRows = alignUp(desc->height, 2);
+	capture->chromaOffset = (uint64_t)capture->lumaStride * lumaRows;
+	capture->chromaPlaneSize = (uint64_t)capture->chromaStride * (lumaRows / 2);
+	capture->frameSize = capture->chromaOffset + 2 * capture->chromaPlaneSize;
+
+	struct ConversionParams params = (struct ConversionParams) {};
+	params.width = desc->width;
+	params.height = desc->height;
+	params.lumaStride = capture->lumaStride;
+	params.chromaStride = capture->chromaStride;
+	params.chromaOffset = (uint32_t)capture->chromaOffset;
+	params.chromaPlaneSize = (uint32_t)capture->chromaPlaneSize;
+	params.srgbInput = isSrgbFormat(desc->format) ? 1 : 0;
+	capture->uniformBuffer = createBuffer(device, sizeof(struct ConversionParams), WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst, "Video capture params");
+	wgpuQueueWriteBuffer(capture->queue, capture->uniformBuffer, 0, &params, sizeof(params));
+	capture->yuvBuffer = createBuffer(device, capture->frameSize, WGPUBufferUsage_Storage | WGPUBufferUsage_CopySrc, "Video capture YUV frame");
+
+	WGPUBindGroupLayoutEntry entries[3];
+	entries[0] = (WGPUBindGroupLayoutEntry) {};
+	entries[0].binding = 0;
+	entries[0].visibility = WGPUShaderStage_Compute;
+	entries[0].texture.sampleType = WGPUTextureSampleType_Float;
+	entries[0].texture.viewDimension = WGPUTextureViewDimension_2D;
+	entries[0].texture.multisampled = false;
+	entries[1] = bufferLayoutEntry(1, WGPUShaderStage_Compute, WGPUBufferBindingType_Uniform, false);
+	entries[2] = bufferLayoutEntry(2, WGPUShaderStage_Compute, WGPUBufferBindingType_Storage, false);
+	WGPUBindGroupLayoutDescriptor layoutDesc = (WGPUBindGroupLayoutDescriptor) {};
+	layoutDesc.nextInChain = NULL;
+	layoutDesc.label = "Video capture";
+	layoutDesc.entryCount = 3;
+	layoutDesc.entries = entries;
+	capture->layout = wgpuDeviceCreateBindGroupLayout(device, &layoutDesc);
+
+	WGPUShaderModule module = createWGSLShaderModule(device, yuvConversionShaderSource, "RGB to YUV");
+	WGPUPipelineLayout pipelineLayout = createSingleGroupPipelineLayout(device, capture->layout, "Video capture");
+	capture->pipeline = createComputePipeline(device, pipelineLayout, module, "main", "RGB to YUV");
+	wgpuPipelineLayoutRelease(pipelineLayout);
+	wgpuShaderModuleRelease(module);
+
+	capture->readback = readbackQueueCreate(device, desc->scheduler, VIDEO_CAPTURE_SLOT_COUNT);
+	if (!capture->readback) {
+		videoCaptureRelease(capture);
+		return NULL;
+	}
+	return capture;
+}
+
+static bool writePlane(FILE * file, uint8_t const * plane, uint32_t stride, uint32_t width, uint32_t rows) {
+	if (stride == width) {
+		return fwrite(plane, 1, (size_t)width * rows, file) == (size_t)width * rows;
+	}
+	for (uint32_t y = 0; y < rows; ++y) {
+		if (fwrite(plane + (size_t)y * stride, 1, width, file) != width) return false;
+	}
+	return true;
+}
+
+/**
+ * Called on the readback worker, which is the writer thread of the file.
+ */
+static void onFrameReadBack(struct ReadbackResult const * result, void * userData) {
+	struct VideoCapture * capture = (struct VideoCapture *)userData;
+	if (!result->data || capture->writeFailed) return;
+	uint8_t const * frame = (uint8_t const *)result->data;
+	uint32_t chromaWidth = (capture->width + 1) / 2;
+	uint32_t chromaHeight = (capture->height + 1) / 2;
+	bool ok = fwrite("FRAME\n", 1, 6, capture->file) == 6;
+	ok = ok && writePlane(capture->file, frame, capture->lumaStride, capture->width, capture->height);
+	ok = ok && writePlane(capture->file, frame + capture->chromaOffset, capture->chromaStride, chromaWidth, chromaHeight);
+	ok = ok && writePlane(capture->file, frame + capture->chromaOffset + capture->chromaPlaneSize, capture->chromaStride, chromaWidth, chromaHeight);
+	if (!ok) {
+		fprintf(stderr, "Could not write video capture frame, stopping capture\n");
+		capture->writeFailed = true;
+	}
+}
+
+bool videoCaptureEncodeFrame(struct VideoCapture * capture, WGPUCommandEncoder encoder, WGPUTextureView frame) {
+	// Drop the frame before converting it rather than after
+	if (readbackQueueIsFull(capture->readback)) {
+		capture->droppedFrames++;
+		return false;
+	}
+
+	WGPUBindGroupEntry bindings[3];
+	bindings[0] = (WGPUBindGroupEntry) {};
+	bindings[0].binding = 0;
+	bindings[0].textureView = frame;
+	bindings[1] = bufferBindGroupEntry(1, capture->uniformBuffer, 0, sizeof(struct ConversionParams));
+	bindings[2] = bufferBindGroupEntry(2, capture->yuvBuffer, 0, capture->frameSize);
+	WGPUBindGroupDescriptor bindGroupDesc = (WGPUBindGroupDescriptor) {};
+	bindGroupDesc.nextInChain = NULL;
+	bindGroupDesc.layout = capture->layout;
+	bindGroupDesc.entryCount = 3;
+	bindGroupDesc.entries = bindings;
+	// Swap chain views change every frame, so the bind group does too
+	WGPUBindGroup bindGroup = wgpuDeviceCreateBindGroup(capture->device, &bindGroupDesc);
+
+	WGPUComputePassDescriptor passDesc = (WGPUComputePassDescriptor) {};
+	passDesc.nextInChain = NULL;
+	passDesc.label = "RGB to YUV";
+	WGPUComputePassEncoder pass = wgpuCommandEncoderBeginComputePass(encoder, &passDesc);
+	wgpuComputePassEncoderSetPipeline(pass, capture->pipeline);
+	wgpuComputePassEncoderSetBindGroup(pass, 0, bindGroup, 0, NULL);
+	uint32_t invocationsX = capture->chromaStride / 4;
+	uint32_t invocationsY = (capture->height + 1) / 2;
+	wgpuComputePassEncoderDispatchWorkgroups(pass, (invocationsX + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, (invocationsY + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1);
+	wgpuComputePassEncoderEnd(pass);
+	wgpuComputePassEncoderRelease(pass);
+	wgpuBindGroupRelease(bindGroup);
+
+	if (!readbackQueueCopyBuffer(capture->readback, encoder, capture->yuvBuffer, 0, capture->frameSize, onFrameReadBack, (void *)capture)) {
+		capture->droppedFrames++;
+		return false;
+	}
+	capture->capturedFrames++;
+	return true;
+}
+
+void videoCaptureAfterSubmit(struct VideoCapture * capture) {
+	readbackQueueAfterSubmit(capture->readback);
+}
+
+void videoCapturePoll(struct VideoCapture * capture) {
+	readbackQueuePoll(capture->readback);
+}
+
+bool videoCaptureRelease(struct VideoCapture * capture) {
+	if (!capture) return false;
+	// Joins the writer thread, after which its fields can be read
+	readbackQueueRelease(capture->readback);
+	bool ok = !capture->writeFailed;
+	if (fclose(capture->file) != 0) ok = false;
+	if (capture->pipeline) wgpuComputePipelineRelease(capture->pipeline);
+	if (capture->layout) wgpuBindGroupLayoutRelease(capture->layout);
+	wgpuBufferDestroy(capture->yuvBuffer);
+	wgpuBufferRelease(capture->yuvBuffer);
+	wgpuBufferRelease(capture->uniformBuffer);
+	wgpuQueueRelease(capture->queue);
+	free(capture);
+	return ok;
+}
@@ -0,0 +1,119 @@
+/**
+ * Real-time video capture to a Y4M file.
+ *
+ * Every captured frame is converted to planar YUV 4:2:0 by a compute pass,
+ * which divides the data to read back by 2.7 compared to RGBA, then read
+ * back without stalling through a readback queue (see readback-queue.h)
+ * whose worker thread appends it to a raw .y4m stream. Y4M is
+ * uncompressed, so writing costs no CPU beyond the copy to the file, and
+ * the result can be played or encoded directly, e.g. with
+ *     ffmpeg -i capture.y4m -c:v libx264 capture.mp4
+ *
+ * Colors are converted with the BT.709 matrix in limited range, and chroma
+ * is the average of each 2x2 block of pixels (C420jpeg siting).
+ *
+ * Typical frame:
+ *     // encoder records the frame into `frameView`
+ *     videoCaptureEncodeFrame(capture, encoder, frameView);
+ *     // submit through the scheduler, present, tick the device
+ *     videoCapturePoll(capture);
+ *
+ * When the disk cannot keep up with the frame rate, frames are dropped
+ * and counted rather than slowing rendering down.
+ */
+
+#ifndef _video_capture_h_
+#define _video_capture_h_
+
+#include <webgpu/webgpu.h>
+#include "readback-queue.h"
+#include "submit-scheduler.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Frames that can be waiting for the GPU or the disk, about 100 ms at 60 Hz
+#define VIDEO_CAPTURE_SLOT_COUNT 6
+
+struct VideoCaptureDesc {
+	char const * path;
+	uint32_t width;
+	uint32_t height;
+	// Format of the captured texture views. sRGB formats are encoded back
+	// to sRGB before conversion.
+	WGPUTextureFormat format;
+	// Nominal frame rate written in the file
+	uint32_t fpsNumerator;
+	uint32_t fpsDenominator;
+	// Submits the conversion; may be NULL, see videoCaptureAfterSubmit
+	struct SubmitScheduler * scheduler;
+};
+
+struct VideoCapture {
+	WGPUDevice device;
+	WGPUQueue queue;
+	uint32_t width;
+	uint32_t height;
+	WGPUTextureFormat format;
+
+	// Layout of the converted frame: the Y plane then the U and V planes,
+	// with rows padded to 8 and 4 bytes
+	uint32_t lumaStride;
+	uint32_t chromaStride;
+	uint64_t chromaOffset;
+	uint64_t chromaPlaneSize;
+	uint64_t frameSize;
+
+	WGPUBindGroupLayout layout;
+	WGPUComputePipeline pipeline;
+	WGPUBuffer uniformBuffer;
+	WGPUBuffer yuvBuffer; // Storage | CopySrc
+	struct ReadbackQueue * readback;
+
+	FILE * file;
+	uint64_t capturedFrames;
+	uint64_t droppedFrames;
+	bool writeFailed; // set by the writer thread
+};
+
+/**
+ * Open the file, write the stream header and create the conversion
+ * pipeline. Returns NULL if the file cannot be created.
+ */
+struct VideoCapture * videoCaptureCreate(WGPUDevice device, struct VideoCaptureDesc const * desc);
+
+/**
+ * Record the conversion of `frame` (a view of a texture with TextureBinding
+ * usage, of the size and format given at creation) and its readback.
+ * Returns false, without recording anything, if the frame is dropped
+ * because the writer is behind.
+ */
+bool videoCaptureEncodeFrame(struct VideoCapture * capture, WGPUCommandEncoder encoder, WGPUTextureView frame);
+
+/**
+ * Start reading back the frames recorded so far, once their commands are
+ * submitted. Only needed when the capture was created without a scheduler.
+ */
+void videoCaptureAfterSubmit(struct VideoCapture * capture);
+
+/**
+ * Recycle the readback buffers already written to the file. Call once per
+ * frame, after ticking the device.
+ */
+void videoCapturePoll(struct VideoCapture * capture);
+
+/**
+ * Wait for the frames in flight to be written and close the file. Returns
+ * false if writing failed at some point.
+ */
+bool videoCaptureRelease(struct VideoCapture * capture);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _video_capture_h_
@@ -0,0 +1,120 @@
+#include "webgpu-utils.h"
+
+WGPUShaderModule createWGSLShaderModule(WGPUDevice device, char const * source, char const * label) {
+	WGPUShaderModuleWGSLDescriptor shaderCodeDesc = (WGPUShaderModuleWGSLDescriptor) {};
+	shaderCodeDesc.chain.next = NULL;
+	shaderCodeDesc.chain.sType = WGPUSType_ShaderModuleWGSLDescriptor;
+	shaderCodeDesc.source = source;
+
+	WGPUShaderModuleDescriptor shaderDesc = (WGPUShaderModuleDescriptor) {};
+	shaderDesc.nextInChain = &shaderCodeDesc.chain;
+	shaderDesc.label = label;
+	return wgpuDeviceCreateShaderModule(device, &shaderDesc);
+}
+
+WGPUBuffer createBuffer(WGPUDevice device, uint64_t size, WGPUBufferUsageFlags usage, char const * label) {
+	WGPUBufferDescriptor bufferDesc = (WGPUBufferDescriptor) {};
+	bufferDesc.nextInChain = NULL;
+	bufferDesc.label = label;
+	bufferDesc.usage = usage;
+	// Buffer sizes must be a multiple of 4 whenever they are copied or mapped
+	bufferDesc.size = alignUp(size, 4);
+	bufferDesc.mappedAtCreation = false;
+	return wgpuDeviceCreateBuffer(device, &bufferDesc);
+}
+
+WGPUComputePipeline createComputePipeline(WGPUDevice device, WGPUPipelineLayout layout, WGPUShaderModule module, char const * entryPoint, char const * label) {
+	WGPUComputePipelineDescriptor pipelineDesc = (WGPUComputePipelineDescriptor) {};
+	pipelineDesc.nextInChain = NULL;
+	pipelineDesc.label = label;
+	pipelineDesc.layout = layout;
+	pipelineDesc.compute.nextInChain = NULL;
+	pipelineDesc.compute.module = module;
+	pipelineDesc.compute.entryPoint = entryPoint;
+	pipelineDesc.compute.constantCount = 0;
+	pipelineDesc.compute.constants = NULL;
+	return wgpuDeviceCreateComputePipeline(device, &pipelineDesc);
+}
+
+WGPUPipelineLayout createSingleGroupPipelineLayout(WGPUDevice device, WGPUBindGroupLayout bindGroupLayout, char const * label) {
+	WGPUPipelineLayoutDescriptor layoutDesc = (WGPUPipelineLayoutDescriptor) {};
+	layoutDesc.nextInChain = NULL;
+	layoutDesc.label = label;
+	layoutDesc.bindGroupLayoutCount = 1;
+	layoutDesc.bindGroupLayouts = &bindGroupLayout;
+	return wgpuDeviceCreatePipelineLayout(device, &layoutDesc);
+}
+
+WGPUBindGroupLayoutEntry bufferLayoutEntry(uint32_t binding, WGPUShaderStageFlags visibility, WGPUBufferBindingType type, bool hasDynamicOffset) {
+	WGPUBindGroupLayoutEntry entry = (WGPUBindGroupLayoutEntry) {};
+	entry.nextInChain = NULL;
+	entry.binding = binding;
+	entry.visibility = visibility;
+	entry.buffer.type = type;
+	entry.buffer.hasDynamicOffset = hasDynamicOffset;
+	entry.buffer.minBindingSize = 0;
+	entry.sampler.type = WGPUSamplerBindingType_Undefined;
+	entry.texture.sampleType = WGPUTextureSampleType_Undefined;
+	entry.storageTexture.access = WGPUStorageTextureAccess_Undefined;
+	return entry;
+}
+
+WGPUBindGroupEntry bufferBindGroupEntry(uint32_t binding, WGPUBuffer buffer, uint64_t offset, uint64_t size) {
+	WGPUBindGroupEntry entry = (WGPUBindGroupEntry) {};
+	entry.nextInChain = NULL;
+	entry.binding = binding;
+	entry.buffer = buffer;
+	entry.offset = offset;
+	entry.size = size;
+	entry.sampler = NULL;
+	entry.textureView = NULL;
+	return entry;
+}
+
+uint32_t textureFormatBytesPerTexel(WGPUTextureFormat format) {
+	switch (format) {
+	case WGPUTextureFormat_R8Unorm:
+	case WGPUTextureFormat_R8Snorm:
+	case WGPUTextureFormat_R8Uint:
+	case WGPUTextureFormat_R8Sint:
+		return 1;
+	case WGPUTextureFormat_R16Uint:
+	case WGPUTextureFormat_R16Sint:
+	case WGPUTextureFormat_R16Float:
+	case WGPUTextureFormat_RG8Unorm:
+	case WGPUTextureFormat_RG8Snorm:
+	case WGPUTextureFormat_RG8Uint:
+	case WGPUTextureFormat_RG8Sint:
+		return 2;
+	case WGPUTextureFormat_R32Float:
+	case WGPUTextureFormat_R32Uint:
+	case WGPUTextureFormat_R32Sint:
+	case WGPUTextureFormat_RG16Uint:
+	case WGPUTextureFormat_RG16Sint:
+	case WGPUTextureFormat_RG16Float:
+	case WGPUTextureFormat_RGBA8Unorm:
+	case WGPUTextureFormat_RGBA8UnormSrgb:
+	case WGPUTextureFormat_RGBA8Snorm:
+	case WGPUTextureFormat_RGBA8Uint:
+	case WGPUTextureFormat_RGBA8Sint:
+	case WGPUTextureFormat_BGRA8Unorm:
+	case WGPUTextureFormat_BGRA8UnormSrgb:
+	case WGPUTextureFormat_RGB10A2Unorm:
+	case WGPUTextureFormat_RG11B10Ufloat:
+	case WGPUTextureFormat_RGB9E5Ufloat:
+		return 4;
+	case WGPUTextureFormat_RG32Float:
+	case WGPUTextureFormat_RG32Uint:
+	case WGPUTextureFormat_RG32Sint:
+	case WGPUTextureFormat_RGBA16Uint:
+	case WGPUTextureFormat_RGBA16Sint:
+	case WGPUTextureFormat_RGBA16Float:
+		return 8;
+	case WGPUTextureFormat_RGBA32Float:
+	case WGPUTextureFormat_RGBA32Uint:
+	case WGPUTextureFormat_RGBA32Sint:
+		return 16;
+	default:
+		return 0;
+	}
+}
@@ -0,0 +1,65 @@
+/**
+ * Small helpers shared by the App's subsystems to create the WebGPU objects
+ * they all need, so that each module does not have to repeat the descriptor
+ * boilerplate found in main.c.
+ */
+
+#ifndef _webgpu_utils_h_
+#define _webgpu_utils_h_
+
+#include <webgpu/webgpu.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Create a shader module from WGSL source code.
+ */
+WGPUShaderModule createWGSLShaderModule(WGPUDevice device, char const * source, char const * label);
+
+/**
+ * Create a buffer that is not mapped at creation.
+ */
+WGPUBuffer createBuffer(WGPUDevice device, uint64_t size, WGPUBufferUsageFlags usage, char const * label);
+
+/**
+ * Create a compute pipeline using the entry point `entryPoint` of `module`.
+ * If `layout` is NULL, the layout is inferred from the shader.
+ */
+WGPUComputePipeline createComputePipeline(WGPUDevice device, WGPUPipelineLayout layout, WGPUShaderModule module, char const * entryPoint, char const * label);
+
+/**
+ * Create a pipeline layout with a single bind group layout.
+ */
+WGPUPipelineLayout createSingleGroupPipelineLayout(WGPUDevice device, WGPUBindGroupLayout bindGroupLayout, char const * label);
+
+/**
+ * Fill a bind group layout entry describing a buffer binding.
+ */
+WGPUBindGroupLayoutEntry bufferLayoutEntry(uint32_t binding, WGPUShaderStageFlags visibility, WGPUBufferBindingType type, bool hasDynamicOffset);
+
+/**
+ * Fill a bind group entry binding a range of a buffer.
+ */
+WGPUBindGroupEntry bufferBindGroupEntry(uint32_t binding, WGPUBuffer buffer, uint64_t offset, uint64_t size);
+
+/**
+ * Size in bytes of a texel of an uncompressed color format, or 0 for
+ * depth/stencil and block-compressed formats.
+ */
+uint32_t textureFormatBytesPerTexel(WGPUTextureFormat format);
+
+/**
+ * Round `value` up to the next multiple of `alignment`, which must be a
+ * power of two.
+ */
+static inline uint64_t alignUp(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _webgpu_utils_h_